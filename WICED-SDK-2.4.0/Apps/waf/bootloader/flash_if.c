@@ -25,15 +25,27 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "flash_if.h"
+#include "string.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+#define FLASH_ERROR_FLAGS	(FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR | FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR)
+
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 extern uint32_t WR_StartAddr;
 extern uint32_t WR_EndAddr;
 extern uint32_t WR_FlashSize;
 
+/* Buffer handed over by FLASH_If_Queue() */
+static uint32_t FlashQueueStart;		/* Flash address of the first word */
+static uint32_t *FlashQueueSource;
+static uint32_t FlashQueueWords;		/* 0: nothing queued */
+static uint32_t FlashQueueAddress;		/* Next word to program */
+static uint32_t *FlashQueueData;
+static uint32_t FlashQueueLength;		/* Words not yet handed to the flash controller */
+static uint32_t FlashQueueStatus;
+
 /* Private function prototypes -----------------------------------------------*/
 static uint32_t GetSector(uint32_t Address);
 
@@ -85,24 +97,111 @@ uint32_t FLASH_If_Erase(uint32_t StartSector, uint32_t EndSector)
   * @retval 0: Data successfully written to Flash memory
   *         1: Error occurred while writing data in Flash memory
   *         2: Written Data in flash memory is different from expected one
+  *         3: Data buffer runs past the end of the user flash area, nothing written
   */
 uint32_t FLASH_If_Write(__IO uint32_t* FlashAddress, uint32_t* Data ,uint16_t DataLength)
 {
-	uint32_t i = 0;
+	uint32_t status;
 
-	for (i = 0; (i < DataLength) && (*FlashAddress <= (WR_EndAddr-4)); i++)
-	{
-		/* Device voltage range supposed to be [2.7V to 3.6V], the operation will be done by word */ 
-		if (FLASH_ProgramWord(*FlashAddress, *(uint32_t*)(Data+i)) == FLASH_COMPLETE) {
-			if (*(uint32_t*)*FlashAddress != *(uint32_t*)(Data+i)) 	/* Check the written value */
-				return(2);	/* Flash content doesn't match SRAM content */
-			*FlashAddress += 4;		/* Increment FLASH destination address */
-		} else return (1);	/* Error occurred while writing data in Flash memory */
-	}
+	status = FLASH_If_Queue(FlashAddress, Data, DataLength);
+	if (status != 0) return status;
+
+	return FLASH_If_Flush();
+}
+
+/**
+  * @brief  This function starts writing a data buffer in flash (data are 32-bit aligned)
+  *         and returns straight away. FLASH_If_Poll() feeds the buffer to the flash
+  *         controller a word at a time, so it is written while the caller waits for
+  *         something else, e.g. the next packet on the serial port.
+  * @note   The buffer must not be changed until FLASH_If_Flush() has returned. A buffer
+  *         queued earlier is flushed first.
+  * @param  FlashAddress: start address for writing data buffer, moved past the buffer
+  * @param  Data: pointer on data buffer
+  * @param  DataLength: length of data buffer (unit is 32-bit word)
+  * @retval 0: Data buffer queued
+  *         1, 2: The buffer queued earlier failed, as FLASH_If_Write()
+  *         3: Data buffer runs past the end of the user flash area, nothing queued
+  */
+uint32_t FLASH_If_Queue(__IO uint32_t* FlashAddress, uint32_t* Data, uint16_t DataLength)
+{
+	uint32_t status, room;
+
+	status = FLASH_If_Flush();
+	if (status != 0) return status;
+
+	/* Nothing is written past the end of the user flash area, and an image that does not fit is refused */
+	room = (*FlashAddress <= WR_EndAddr) ? ((WR_EndAddr + 1 - *FlashAddress) / 4) : 0;
+	if (DataLength > room) return (3);
+	if (DataLength == 0) return (0);
+
+	FlashQueueStart = FlashQueueAddress = *FlashAddress;
+	FlashQueueSource = FlashQueueData = Data;
+	FlashQueueWords = FlashQueueLength = DataLength;
+	*FlashAddress += DataLength * 4;
+
+	/* Device voltage range supposed to be [2.7V to 3.6V], the operation will be done by word.
+	   Double word parallelism needs an external Vpp, so a word is the widest there is.
+	   Program size and PG are set once for the whole buffer rather than for every word. */
+	FLASH->CR &= CR_PSIZE_MASK;
+	FLASH->CR |= FLASH_PSIZE_WORD;
+	FLASH->CR |= FLASH_CR_PG;
 
+	FLASH_If_Poll();
 	return (0);
 }
 
+/**
+  * @brief  Hands the next queued word to the flash controller if it is idle.
+  *         Cheap enough to be called between polls of the serial port.
+  * @param  None
+  * @retval None
+  */
+void FLASH_If_Poll(void)
+{
+	if ((FlashQueueLength == 0) || ((FLASH->SR & FLASH_FLAG_BSY) != 0)) return;
+
+	if ((FLASH->SR & FLASH_ERROR_FLAGS) != 0) {
+		FlashQueueStatus = 1;	/* Error occurred while writing data in Flash memory */
+		FlashQueueLength = 0;
+		return;
+	}
+
+	*(__IO uint32_t*)(uintptr_t)FlashQueueAddress = *FlashQueueData++;
+	FlashQueueAddress += 4;
+	FlashQueueLength--;
+}
+
+/**
+  * @brief  This function waits for the queued data buffer to be written in flash.
+  * @note   After writing data buffer, the flash content is checked.
+  * @param  None
+  * @retval 0: Data successfully written to Flash memory, or nothing queued
+  *         1: Error occurred while writing data in Flash memory
+  *         2: Written Data in flash memory is different from expected one
+  */
+uint32_t FLASH_If_Flush(void)
+{
+	uint32_t status;
+
+	if (FlashQueueWords == 0) return (0);
+
+	while (FlashQueueLength > 0) FLASH_If_Poll();
+
+	if (FLASH_WaitForLastOperation() != FLASH_COMPLETE) FlashQueueStatus = 1;
+	FLASH->CR &= (~FLASH_CR_PG);
+
+	/* Check the written values */
+	if ((FlashQueueStatus == 0) && (memcmp((void*)(uintptr_t)FlashQueueStart, FlashQueueSource, FlashQueueWords * 4) != 0))
+		FlashQueueStatus = 2;	/* Flash content doesn't match SRAM content */
+
+	status = FlashQueueStatus;
+	FlashQueueWords = 0;
+	FlashQueueStatus = 0;
+
+	return status;
+}
+
 ///**	// Disabled by MikeJ
 //  * @brief  Returns the write protection status of user flash area.
 //  * @param  None
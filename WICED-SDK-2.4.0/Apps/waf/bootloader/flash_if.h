@@ -57,6 +57,9 @@
 void FLASH_If_Init(void);
 uint32_t FLASH_If_Erase(uint32_t StartSector, uint32_t EndSector);
 uint32_t FLASH_If_Write(__IO uint32_t* FlashAddress, uint32_t* Data, uint16_t DataLength);
+uint32_t FLASH_If_Queue(__IO uint32_t* FlashAddress, uint32_t* Data, uint16_t DataLength);
+void FLASH_If_Poll(void);
+uint32_t FLASH_If_Flush(void);
 //uint16_t FLASH_If_GetWriteProtectionStatus(void);	// Disabled by MikeJ
 //uint32_t FLASH_If_DisableWriteProtection(void);		// Disabled by MikeJ
 
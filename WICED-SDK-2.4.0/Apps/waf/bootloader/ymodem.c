@@ -35,15 +35,23 @@
 /* Private define ------------------------------------------------------------*/
 //#define YMODEM_DEBUG	// kaizen 20130521 Removed log message
 
+#define PURGE_TIMEOUT           (NAK_TIMEOUT / 64)	/* Line is quiet, the rest of a bad packet is gone */
+#define PURGE_MAX_BYTES         (PACKET_1K_SIZE + PACKET_OVERHEAD)	/* The most a bad packet can leave behind */
+
+/* Packets start one byte into the buffer so their data, after the 3 byte header, is 32-bit aligned */
+#define PACKET_BUFFER_WORDS     ((1 + PACKET_1K_SIZE + PACKET_OVERHEAD + 3) / 4)
+
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 //extern uint8_t FileName[];
-uint8_t tab_1024[1024] = {0};
+/* One packet is received while the one before it is written in flash */
+static uint32_t packet_buffer[2][PACKET_BUFFER_WORDS];
 uint8_t FileName[FILE_NAME_LENGTH];
 uint32_t app_start_addr;
 uint32_t end_end_addr;
 
 /* Private function prototypes -----------------------------------------------*/
+static uint16_t UpdateCRC16(uint16_t crcIn, uint8_t byte);
 /* Private functions ---------------------------------------------------------*/
 
 uint32_t WR_StartAddr;
@@ -103,7 +111,7 @@ void SerialDownload(uint32_t StartSector, uint32_t EndSector)
 	SerialPutString("Waiting for the file to be sent ... (press 'a' to abort)\r\n");
 	FLASH_If_Init();
 
-	Size = Ymodem_Receive(&tab_1024[0]);
+	Size = Ymodem_Receive();
 
 	if (Size > 0) {
 		SerialPutString("\n\n\r Programming Completed Successfully!\n\r--------------------------------\r\n Name: ");
@@ -149,6 +157,7 @@ static  int32_t Receive_Byte (uint8_t *c, uint32_t timeout)
 {
 	while (timeout-- > 0) {
 		if (SerialKeyPressed(c) == 1) return 0;
+		FLASH_If_Poll();	/* Program the previous packet while waiting */
 	}
 
 	return -1;
@@ -174,12 +183,12 @@ static uint32_t Send_Byte (uint8_t c)
   *    -1: abort by sender
   *    >0: packet length
   * @retval 0: normally return
-  *        -1: timeout or packet error
+  *        -1: timeout, packet error or CRC error
   *         1: abort by user
   */
 static int32_t Receive_Packet (uint8_t *data, int32_t *length, uint32_t timeout)
 {
-	uint16_t i, packet_size;
+	uint16_t i, packet_size, crc = 0;
 	uint8_t c;
 	*length = 0;
 
@@ -209,25 +218,34 @@ static int32_t Receive_Packet (uint8_t *data, int32_t *length, uint32_t timeout)
 	*data = c;
 	for (i = 1; i < (packet_size + PACKET_OVERHEAD); i ++) {
 		if (Receive_Byte(data + i, timeout) != 0) return -1;
+		/* The CRC is worked out as the data comes in, between bytes */
+		if ((i >= PACKET_HEADER) && (i < (PACKET_HEADER + packet_size))) crc = UpdateCRC16(crc, data[i]);
 	}
 
 	if (data[PACKET_SEQNO_INDEX] != ((data[PACKET_SEQNO_COMP_INDEX] ^ 0xff) & 0xff))
 		return -1;
 
+	crc = UpdateCRC16(crc, 0);
+	crc = UpdateCRC16(crc, 0);
+	if (crc != ((data[PACKET_HEADER + packet_size] << 8) | data[PACKET_HEADER + packet_size + 1]))
+		return -1;
+
 	*length = packet_size;
 	return 0;
 }
 
 /**
   * @brief  Receive a file using the ymodem protocol.
-  * @param  buf: Address of the first byte.
+  * @note   A data packet is acknowledged once its CRC checks out and is written in
+  *         flash while the next one is received.
+  * @param  None
   * @retval The size of the file.
   */
-int32_t Ymodem_Receive (uint8_t *buf)
+int32_t Ymodem_Receive (void)
 {
-	uint8_t packet_data[PACKET_1K_SIZE + PACKET_OVERHEAD], file_size[FILE_SIZE_LENGTH], *file_ptr, *buf_ptr;
+	uint8_t file_size[FILE_SIZE_LENGTH], *file_ptr, *packet_data, c;
 	int32_t i, packet_length, session_done, file_done, packets_received, errors, session_begin, size = 0;
-	uint32_t flashdestination, ramsource;
+	uint32_t flashdestination, remaining = 0, buffer = 0, status;
 #if 1		// kaizen 20130521 ID1071 For checking about doing firmware update.
 	uint8_t flag = 1;
 #endif
@@ -237,7 +255,7 @@ int32_t Ymodem_Receive (uint8_t *buf)
 
 	for (session_done = 0, errors = 0, session_begin = 0; ;)
 	{
-		for (packets_received = 0, file_done = 0, buf_ptr = buf; ;)
+		for (packets_received = 0, file_done = 0; ;)
 		{
 			watchdog_kick();
 #if 1		// kaizen 20130521 ID1071 For checking about doing firmware update.
@@ -245,21 +263,37 @@ int32_t Ymodem_Receive (uint8_t *buf)
 			else 		  { GPIO_SetBits(GPIOC, GPIO_Pin_1);	flag = 0; }
 #endif
 
+			packet_data = (uint8_t*)packet_buffer[buffer] + 1;
+
 			switch (Receive_Packet(packet_data, &packet_length, NAK_TIMEOUT)) {
 			case 0:
 				errors = 0;
 				switch (packet_length) {
 				case - 1:	/* Abort by sender */
+					FLASH_If_Flush();
 					Send_Byte(ACK);
 					return 0;
 					/* End of transmission */
 				case 0:
+					/* Every packet acknowledged so far must be in flash before the file is */
+					if (FLASH_If_Flush() != 0) {
+						Send_Byte(CA);	/* End session */
+						Send_Byte(CA);
+						return -2;
+					}
+					/* Without a size in the header the file is as long as what was written, padding included */
+					if (size == 0) size = (int32_t)(flashdestination - WR_StartAddr);
 					Send_Byte(ACK);
+					Send_Byte(CRC16);	/* Ask for the next file header rather than wait for a timeout */
 					file_done = 1;
 					break;
 					/* Normal packet */
 				default:
-					if ((packet_data[PACKET_SEQNO_INDEX] & 0xff) != (packets_received & 0xff)) {
+					if ((packets_received > 0) && ((packet_data[PACKET_SEQNO_INDEX] & 0xff) == ((packets_received - 1) & 0xff))) {
+						/* Our ACK got lost and the sender repeated the packet, which is already taken */
+						Send_Byte(ACK);
+						if (packets_received == 1) Send_Byte(CRC16);
+					} else if ((packet_data[PACKET_SEQNO_INDEX] & 0xff) != (packets_received & 0xff)) {
 						Send_Byte(NAK);
 					} else {
 						if (packets_received == 0)
@@ -283,8 +317,15 @@ int32_t Ymodem_Receive (uint8_t *buf)
 									Send_Byte(CA);
 									return -1;
 								}
-								/* erase user application area */
-								FLASH_If_Erase(WR_StartAddr, WR_EndAddr);
+								/* erase the part of the user application area the image goes in */
+								if (FLASH_If_Erase(WR_StartAddr, (size > 0) ? (WR_StartAddr + size - 1) : WR_EndAddr) != 0) {
+									Send_Byte(CA);	/* End session */
+									Send_Byte(CA);
+									return -2;
+								}
+								/* Padding after the end of the file is not written. Without a size all of it is,
+								   and FLASH_If_Queue() refuses what would run past the user flash area */
+								remaining = (size > 0) ? (uint32_t)size : 0xFFFFFFFF;
 								Send_Byte(ACK);
 								Send_Byte(CRC16);
 							}
@@ -298,16 +339,18 @@ int32_t Ymodem_Receive (uint8_t *buf)
 						}
 						else	/* Data packet */
 						{
-							memcpy(buf_ptr, packet_data + PACKET_HEADER, packet_length);
-							ramsource = (uint32_t)buf;
-							
-							/* Write received data in Flash */
-							if (FLASH_If_Write(&flashdestination, (uint32_t*) ramsource, (uint16_t) packet_length/4)  == 0) {
+							i = ((uint32_t)packet_length < remaining) ? packet_length : (int32_t)remaining;
+							remaining -= i;
+
+							/* Write received data in Flash, once the packet before it is written */
+							status = FLASH_If_Queue(&flashdestination, (uint32_t*)(packet_data + PACKET_HEADER), (uint16_t)((i + 3)/4));
+							if (status == 0) {
 								Send_Byte(ACK);
-							} else { /* An error occurred while writing to Flash memory */
+								buffer ^= 1;
+							} else { /* An error occurred while writing to Flash memory, or the image does not fit */
 								Send_Byte(CA);	/* End session */
 								Send_Byte(CA);
-								return -2;
+								return (status == 3) ? -1 : -2;
 							}
 						}
 						packets_received ++;
@@ -316,17 +359,23 @@ int32_t Ymodem_Receive (uint8_t *buf)
 				}
 				break;
 			case 1:
+				FLASH_If_Flush();
 				Send_Byte(CA);
 				Send_Byte(CA);
 				return -3;
 			default:
 				if (session_begin > 0) errors ++;
 				if (errors > MAX_ERRORS) {
+					FLASH_If_Flush();
 					Send_Byte(CA);
 					Send_Byte(CA);
 					return 0;
 				}
-				Send_Byte(CRC16);
+				/* Let the rest of a damaged packet go by, then have it sent again; a line that never goes quiet is NAKed anyway */
+				for (i = 0; (i < PURGE_MAX_BYTES) && (Receive_Byte(&c, PURGE_TIMEOUT) == 0); i++) {
+					watchdog_kick();
+				}
+				Send_Byte((packets_received > 0) ? NAK : CRC16);
 			}
 			
 			if (file_done != 0) break;
@@ -418,24 +467,24 @@ int32_t Ymodem_Receive (uint8_t *buf)
   * @param  input byte
   * @retval None
   */
-//uint16_t UpdateCRC16(uint16_t crcIn, uint8_t byte)
-//{
-//	uint32_t crc = crcIn;
-//	uint32_t in = byte | 0x100;
-//
-//	do {
-//		crc <<= 1;
-//		in <<= 1;
-//		if(in & 0x100)
-//		++crc;
-//		if(crc & 0x10000)
-//		crc ^= 0x1021;
-//	}
-//
-//	while(!(in & 0x10000));
-//
-//	return crc & 0xffffu;
-//}
+static uint16_t UpdateCRC16(uint16_t crcIn, uint8_t byte)
+{
+	uint32_t crc = crcIn;
+	uint32_t in = byte | 0x100;
+
+	do {
+		crc <<= 1;
+		in <<= 1;
+		if(in & 0x100)
+		++crc;
+		if(crc & 0x10000)
+		crc ^= 0x1021;
+	}
+
+	while(!(in & 0x10000));
+
+	return crc & 0xffffu;
+}
 
 
 /**
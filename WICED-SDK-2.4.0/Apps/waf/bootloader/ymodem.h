@@ -57,7 +57,7 @@
 /* Exported functions ------------------------------------------------------- */
 void SerialDownload(uint32_t StartSector, uint32_t EndSector);
 //void SerialUpload(void);									// Disabled by MikeJ
-int32_t Ymodem_Receive (uint8_t *);
+int32_t Ymodem_Receive (void);
 //uint8_t Ymodem_Transmit (uint8_t *,const  uint8_t* , uint32_t );		// Disabled by MikeJ
 
 #endif  /* __YMODEM_H_ */
@@ -72,6 +72,8 @@
 #define GMMP_NETWORK_ALYWAYS_OFF 		0
 #define GMMP_NETWORK_ALYWAYS_ON 		1
 
+#define GMMP_ASYNC_MAX_PENDING			8
+
 #define GMMP_GW							0x01
 #define GMMP_Device  					0x02
 
@@ -46,6 +46,7 @@ callback_Reg g_CallFunctionRegRecv = NULL; ///< OMP�꽌踰꾨줈 遺��꽣
 
 void UnInitializaion()
 {
+	AsyncCancel(SERVER_DISCONNECT);
 	InitMemory();
 	GMMP_Log_Close();
 	CloseSocket();
@@ -96,6 +97,8 @@ int Initializaion(const char* pszServerIP, const int nPort, const char* pszDomai
 
 	SetTID(0);
 
+	AsyncInit();
+
 	return GMMP_SUCCESS;
 }
 
@@ -338,7 +341,7 @@ int GO_Delivery(const char* pszGWID, const char* pszDeviceID, const char cReport
 {
 	SetTID(GetTID()+1);
 
-	int nRet =	GMMP_SetDelivery(g_szAuthID, g_szAuthKey, g_szDomainCode, pszGWID, pszDeviceID, cReportType, cMediaType, pszMessageBody, nTotalCount, nCurrentCount, cEncryption);
+	int nRet =	GMMP_SetDelivery(g_szAuthID, g_szAuthKey, g_szDomainCode, pszGWID, pszDeviceID, cReportType, cMediaType, pszMessageBody, nTotalCount, nCurrentCount, cEncryption, GetTID());
 	if( GetNetworkType() == GMMP_NETWORK_ALYWAYS_ON || nRet != GMMP_SUCCESS)
 	{
 		return nRet;
@@ -358,6 +361,32 @@ int GO_Delivery(const char* pszGWID, const char* pszDeviceID, const char cReport
 	return nRet;
 }
 
+int GO_Delivery_Async(const char* pszGWID, const char* pszDeviceID, const char cReportType, const char cMediaType, const char* pszMessageBody, int nTotalCount, int nCurrentCount, const char cEncryption, const int nTimeout, GMMPAsyncCallback pCallback, void* pArg)
+{
+	// The response is read by the thread calling GetReadData, so the session has to stay open
+	if( GetNetworkType() != GMMP_NETWORK_ALYWAYS_ON)
+	{
+		return LIB_PARAM_ERROR;
+	}
+
+	// The T-ID is taken together with the slot, and passed down rather than read back from g_nTID
+	int nTID = 0;
+
+	int nRet = AsyncBegin(&nTID, OPERATION_DELIVERY_RSP, nTimeout, pCallback, pArg);
+	if(nRet != GMMP_SUCCESS)
+	{
+		return nRet;
+	}
+
+	nRet = GMMP_SetDelivery(g_szAuthID, g_szAuthKey, g_szDomainCode, pszGWID, pszDeviceID, cReportType, cMediaType, pszMessageBody, nTotalCount, nCurrentCount, cEncryption, nTID);
+	if(nRet != GMMP_SUCCESS)
+	{
+		AsyncEnd(nTID);
+	}
+
+	return nRet;
+}
+
 int GO_Control(const char* pszGWID, const char* pszDeviceID, int nTID, const char cControlType, const char cResultCode)
 {
 	SetTID(nTID);
@@ -814,11 +843,14 @@ int GetReadData(GMMPHeader* pstGMMPHeader, void** pBody)
 		}
 		else
 		{
+			// Nothing more will be read on this session
+			AsyncCancel(nRet);
 			return nRet;
 		}
 	}
 
 	GMMP_Recv(pstGMMPHeader, *pBody);
+	AsyncComplete(pstGMMPHeader, *pBody);
 
 	return nRet;
 }
@@ -168,6 +168,34 @@ int GO_Delivery(const char* pszGWID,
 		int nTotalCount,
 		int nCurrentCount,
 		const char cEncryption);
+
+/**
+ * @brief 응답을 기다리지 않고 주기 보고를 전송한다. TCP Always On 모드에서만 사용한다.\n
+ * 응답은 GetReadData를 호출하는 Thread에서 T-ID로 찾아 pCallback으로 전달되므로 여러 개의 보고를 연속으로 전송할 수 있다.
+ * @param pszGWID OMP로 제공 받은 GW ID값.
+ * @param pszDeviceID OMP로 제공 받은 Device ID값.
+ * @param cReportType Report Type\n @ref Define_Delivery.h 참조
+ * @param cMediaType Message Body의 미디어 타입을 의미 @ref Struct_Delivery.h 참조
+ * @param pszMessageBody Data[2048 Byte]
+ * @param nTotalCount 전체 메시지 개수
+ * @param nCurrentCount 현재 메시지의 순서
+ * @param cEncryption 암호화 데이터 유무 판단 Flag @ref GMMP_Encryption_Operation 참조
+ * @param nTimeout 응답 대기 시간(ms)
+ * @param pCallback 응답, 타임아웃 또는 연결 끊김 시 한 번 호출된다. @ref GMMPAsyncCallback 참조
+ * @param pArg pCallback에 전달할 값
+ * @return 성공 : GMMMP_SUCCESS, 실패 : @ref ErrorCode.h 참조 (실패 시 pCallback은 호출되지 않는다.)
+ */
+int GO_Delivery_Async(const char* pszGWID,
+		const char* pszDeviceID,
+		const char cReportType,
+		const char cMediaType,
+		const char* pszMessageBody,
+		int nTotalCount,
+		int nCurrentCount,
+		const char cEncryption,
+		const int nTimeout,
+		GMMPAsyncCallback pCallback,
+		void* pArg);
 /**
  * @}
  */
@@ -21,6 +21,22 @@
 
 //int g_socket = -1;
 
+// Requests sent in TCP Always On mode whose response is read by the receive thread
+typedef struct
+{
+	int bUsed;
+	int nTID;
+	char cResponseType;
+	wiced_time_t tDeadline;
+	GMMPAsyncCallback pCallback;
+	void* pArg;
+} AsyncRequest;
+
+static AsyncRequest g_stAsyncRequest[GMMP_ASYNC_MAX_PENDING];
+static wiced_mutex_t g_hAsyncMutex;
+static wiced_semaphore_t g_hAsyncFree;
+static int g_bAsyncInit = false;
+
 void CloseSocket()
 {
 	///////////////////////////////////////////////////////////////////////////
@@ -137,3 +153,152 @@ int ReadTCP(char* pBuf, const int nMaxlen)
 
 	return GMMP_SUCCESS;
 }
+
+void AsyncInit()
+{
+	if ( g_bAsyncInit )	return;
+
+	memset(g_stAsyncRequest, 0, sizeof(g_stAsyncRequest));
+	wiced_rtos_init_mutex(&g_hAsyncMutex);
+	wiced_rtos_init_semaphore(&g_hAsyncFree);
+	g_bAsyncInit = true;
+}
+
+int AsyncBegin(int* pnTID, const char cResponseType, int nTimeout, GMMPAsyncCallback pCallback, void* pArg)
+{
+	wiced_time_t tNow;
+	wiced_time_t tWaitEnd;
+	int i;
+
+	if ( !g_bAsyncInit || pnTID == NULL || pCallback == NULL || nTimeout <= 0 )	return LIB_PARAM_ERROR;
+
+	wiced_time_get_time(&tNow);
+	tWaitEnd = tNow + nTimeout;
+
+	while(1)
+	{
+		// A request whose response never came frees its slot here as well
+		AsyncCheckTimeout();
+
+		wiced_rtos_lock_mutex(&g_hAsyncMutex);
+		for(i = 0 ; i < GMMP_ASYNC_MAX_PENDING ; i++)
+		{
+			if ( !g_stAsyncRequest[i].bUsed )
+			{
+				// Taken under the lock so two senders can not get the same T-ID
+				*pnTID = GetTID()+1;
+				SetTID(*pnTID);
+
+				wiced_time_get_time(&tNow);
+				g_stAsyncRequest[i].bUsed = true;
+				g_stAsyncRequest[i].nTID = *pnTID;
+				g_stAsyncRequest[i].cResponseType = cResponseType;
+				g_stAsyncRequest[i].tDeadline = tNow + nTimeout;
+				g_stAsyncRequest[i].pCallback = pCallback;
+				g_stAsyncRequest[i].pArg = pArg;
+				wiced_rtos_unlock_mutex(&g_hAsyncMutex);
+				return GMMP_SUCCESS;
+			}
+		}
+		wiced_rtos_unlock_mutex(&g_hAsyncMutex);
+
+		wiced_time_get_time(&tNow);
+		if ( (int32_t)(tWaitEnd - tNow) <= 0 )
+		{
+			return SERVER_REQUEST_TIMEOUT;
+		}
+		wiced_rtos_get_semaphore(&g_hAsyncFree, MIN(tWaitEnd - tNow, 100));
+	}
+}
+
+void AsyncEnd(int nTID)
+{
+	int i;
+
+	if ( !g_bAsyncInit )	return;
+
+	wiced_rtos_lock_mutex(&g_hAsyncMutex);
+	for(i = 0 ; i < GMMP_ASYNC_MAX_PENDING ; i++)
+	{
+		if ( g_stAsyncRequest[i].bUsed && g_stAsyncRequest[i].nTID == nTID )
+		{
+			g_stAsyncRequest[i].bUsed = false;
+			wiced_rtos_set_semaphore(&g_hAsyncFree);
+			break;
+		}
+	}
+	wiced_rtos_unlock_mutex(&g_hAsyncMutex);
+}
+
+int AsyncComplete(GMMPHeader* pstGMMPHeader, void* pBody)
+{
+	AsyncRequest stRequest;
+	int nTID;
+	int i;
+
+	if ( !g_bAsyncInit )	return false;
+
+	nTID = Char2int((char*)pstGMMPHeader->usTID, sizeof(pstGMMPHeader->usTID));
+
+	stRequest.bUsed = false;
+	wiced_rtos_lock_mutex(&g_hAsyncMutex);
+	for(i = 0 ; i < GMMP_ASYNC_MAX_PENDING ; i++)
+	{
+		// A request from the server may carry the same T-ID, so the message type has to match as well
+		if ( g_stAsyncRequest[i].bUsed && g_stAsyncRequest[i].nTID == nTID && g_stAsyncRequest[i].cResponseType == pstGMMPHeader->ucMessageType )
+		{
+			stRequest = g_stAsyncRequest[i];
+			g_stAsyncRequest[i].bUsed = false;
+			wiced_rtos_set_semaphore(&g_hAsyncFree);
+			break;
+		}
+	}
+	wiced_rtos_unlock_mutex(&g_hAsyncMutex);
+
+	// Called without the lock, so the callback may send the next request
+	if ( !stRequest.bUsed )	return false;
+
+	stRequest.pCallback(nTID, GMMP_SUCCESS, pstGMMPHeader, pBody, stRequest.pArg);
+
+	return true;
+}
+
+static void AsyncFinish(int bAll, int nResult)
+{
+	AsyncRequest stFinished[GMMP_ASYNC_MAX_PENDING];
+	wiced_time_t tNow;
+	int nFinished = 0;
+	int i;
+
+	if ( !g_bAsyncInit )	return;
+
+	wiced_time_get_time(&tNow);
+
+	wiced_rtos_lock_mutex(&g_hAsyncMutex);
+	for(i = 0 ; i < GMMP_ASYNC_MAX_PENDING ; i++)
+	{
+		if ( g_stAsyncRequest[i].bUsed && (bAll || (int32_t)(tNow - g_stAsyncRequest[i].tDeadline) >= 0) )
+		{
+			stFinished[nFinished++] = g_stAsyncRequest[i];
+			g_stAsyncRequest[i].bUsed = false;
+			wiced_rtos_set_semaphore(&g_hAsyncFree);
+		}
+	}
+	wiced_rtos_unlock_mutex(&g_hAsyncMutex);
+
+	for(i = 0 ; i < nFinished ; i++)
+	{
+		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR, "TID[%d] Code[%d], %s\r\n", stFinished[i].nTID, nResult, GetStringtoErrorCode(nResult));
+		stFinished[i].pCallback(stFinished[i].nTID, nResult, NULL, NULL, stFinished[i].pArg);
+	}
+}
+
+void AsyncCheckTimeout()
+{
+	AsyncFinish(false, SERVER_REQUEST_TIMEOUT);
+}
+
+void AsyncCancel(int nResult)
+{
+	AsyncFinish(true, nResult);
+}
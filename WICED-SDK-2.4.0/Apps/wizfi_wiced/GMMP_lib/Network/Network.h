@@ -10,6 +10,17 @@
 #include "../Define/Define.h"
 #include "../Util/GMMP_Util.h"
 #include "../Log/GMMP_Log.h"
+#include "../Operation/Struct_Common.h"
+
+/**
+ * @brief 비동기 요청의 결과를 제공할 콜백함수 포인트
+ * @param nTID 요청의 T-ID
+ * @param nResult 응답 수신 : GMMP_SUCCESS, 타임아웃 : SERVER_REQUEST_TIMEOUT, 연결 끊김 : SERVER_DISCONNECT
+ * @param pstGMMPHeader 응답의 GMMP Header, 응답이 없으면 NULL
+ * @param pBody 응답의 Body, 응답이 없으면 NULL
+ * @param pArg 요청 시 전달한 값
+ */
+typedef void (*GMMPAsyncCallback)(int nTID, int nResult, GMMPHeader* pstGMMPHeader, void* pBody, void* pArg);
 
 
 /**
@@ -49,6 +60,48 @@ void ClearBuffer();
  * @return 성공 : GMMMP_SUCCESS, 실패 : @ref ErrorCode.h 참조
  */
 int CheckSocket();
+
+/**
+ * @brief 비동기 요청 테이블을 초기화한다. 여러 번 호출해도 된다.
+ */
+void AsyncInit();
+
+/**
+ * @brief 응답을 기다릴 요청을 등록하고 T-ID를 할당한다. 요청을 Write하기 전에 호출한다.\n
+ * 응답 대기 중인 요청이 GMMP_ASYNC_MAX_PENDING개이면 하나가 끝날 때까지 최대 nTimeout ms 기다린다.
+ * @param pnTID 할당된 T-ID. 요청의 Header에 이 값을 기록한다.
+ * @param cResponseType 기다릴 응답의 Message Type @ref Define_Operation.h 참조
+ * @param nTimeout 응답 대기 시간(ms)
+ * @param pCallback 응답, 타임아웃 또는 연결 끊김 시 한 번 호출된다.
+ * @param pArg pCallback에 전달할 값
+ * @return 성공 : GMMP_SUCCESS, 실패 : SERVER_REQUEST_TIMEOUT, LIB_PARAM_ERROR
+ */
+int AsyncBegin(int* pnTID, const char cResponseType, int nTimeout, GMMPAsyncCallback pCallback, void* pArg);
+
+/**
+ * @brief Write에 실패한 요청을 콜백 호출 없이 제거한다.
+ * @param nTID 요청의 T-ID
+ */
+void AsyncEnd(int nTID);
+
+/**
+ * @brief 수신한 메시지와 T-ID, 응답 Message Type이 같은 요청의 콜백을 호출한다.
+ * @param pstGMMPHeader 수신한 GMMP Header
+ * @param pBody 수신한 Body
+ * @return 요청을 찾으면 true, 없으면 false
+ */
+int AsyncComplete(GMMPHeader* pstGMMPHeader, void* pBody);
+
+/**
+ * @brief 응답 대기 시간이 지난 요청의 콜백을 SERVER_REQUEST_TIMEOUT으로 호출한다. 주기적으로 호출한다.
+ */
+void AsyncCheckTimeout();
+
+/**
+ * @brief 응답 대기 중인 모든 요청의 콜백을 nResult로 호출한다.
+ * @param nResult 콜백에 전달할 결과
+ */
+void AsyncCancel(int nResult);
 #endif /* NETWORK_H_ */
 
 
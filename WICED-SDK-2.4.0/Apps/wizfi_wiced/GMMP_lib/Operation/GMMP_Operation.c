@@ -413,78 +413,91 @@ int GMMP_SetDelivery(const char* pszAuthID,
 		const char* pszMessageBody,
 		const int nTotalCount,
 		const int nCurrentCount,
-		const char cEncryption)
+		const char cEncryption,
+		const int nTID)
 {
 	GMMP_Printf(GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_OPS,"[GW->OMP]GMMP_SetDelivery Start \r\n");
 
+	int nDomainCodeLen = StrLenMax(pszDomainCode, LEN_DOMAIN_CODE);
+	int nGWIDLen = StrLenMax(pszGWID, LEN_GW_ID);
+	int nDeviceIDLen = StrLenMax(pszDeviceID, LEN_DEVICE_ID);
+	int nMessageBodyLen = StrLenMax(pszMessageBody, MAX_MSG_BODY);
+
 	if(pszAuthID == NULL
 			|| pszAuthKey == NULL
 			|| pszDomainCode == NULL
 			|| pszGWID == NULL
-			|| strlen(pszAuthID) > LEN_AUTH_ID
-			|| strlen(pszAuthKey) > LEN_AUTH_KEY
-			|| strlen(pszDomainCode) > LEN_DOMAIN_CODE
-			|| strlen(pszGWID) > LEN_GW_ID
+			|| nDomainCodeLen > LEN_DOMAIN_CODE
+			|| nGWIDLen > LEN_GW_ID
 			|| cReportType < 0x00
 			|| cReportType > 0x04
 			|| cMediaType < 0x01
 			|| pszMessageBody == NULL
-			|| strlen(pszMessageBody) > MAX_MSG_BODY)
+			|| nMessageBodyLen > MAX_MSG_BODY)
 	{
 		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", LIB_PARAM_ERROR, GetStringtoErrorCode(LIB_PARAM_ERROR) );
 		return LIB_PARAM_ERROR;
 	}
 
-	int nMessageBodyLen = strlen(pszMessageBody);
+	if(nDeviceIDLen > LEN_DEVICE_ID) //Device ID is left empty
+	{
+		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", LIB_PARAM_ERROR, GetStringtoErrorCode(LIB_PARAM_ERROR) );
+		nDeviceIDLen = 0;
+		pszDeviceID = NULL;
+	}
 
 	int nRet = GMMP_SUCCESS;
 
-	Delivery_Req  stDelivery_Req;
+	int PacketSize = sizeof(Delivery_Req) - MAX_MSG_BODY + nMessageBodyLen ; //Message Body is optional
 
-	memset(&stDelivery_Req, 0 ,sizeof(stDelivery_Req) );
+	//one more byte keeps usMessageBody terminated for GMMP_Trace, it is not sent
+	Delivery_Req* pDelivery_Req = (Delivery_Req*)malloc(PacketSize + 1);
+	if(pDelivery_Req == NULL)
+	{
+		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", GMMP_MALLOC_ERROR, GetStringtoErrorCode(GMMP_MALLOC_ERROR) );
+		return GMMP_MALLOC_ERROR;
+	}
 
-	int PacketSize = sizeof(stDelivery_Req) - MAX_MSG_BODY + nMessageBodyLen ; //Message Body�쓽 �냽�꽦�� Optinal�씠�떎
+	GMMPEncoder stEncoder;
 
-	nRet = SetHeader((void*)&stDelivery_Req, PacketSize, nTotalCount,  nCurrentCount, OPERATION_DELIVERY_REQ, pszAuthID, pszAuthKey, cEncryption);
+	EncInit(&stEncoder, pDelivery_Req, PacketSize);
+
+	nRet = PutHeader(&stEncoder, PacketSize, nTotalCount,  nCurrentCount, OPERATION_DELIVERY_REQ, pszAuthID, pszAuthKey, cEncryption, nTID);
 	if(nRet != GMMP_SUCCESS)
 	{
 		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", nRet, GetStringtoErrorCode(nRet) );
+		free(pDelivery_Req);
 		return nRet;
 	}
 
-	memcpy(stDelivery_Req.body.usDomainCode, pszDomainCode, strlen(pszDomainCode) );
-	memcpy(stDelivery_Req.body.usGWID, pszGWID, strlen(pszGWID) );
+	EncPutField(&stEncoder, pszDomainCode, nDomainCodeLen, LEN_DOMAIN_CODE);
+	EncPutField(&stEncoder, pszGWID, nGWIDLen, LEN_GW_ID);
+	EncPutField(&stEncoder, pszDeviceID, nDeviceIDLen, LEN_DEVICE_ID);
+	EncPutByte(&stEncoder, cReportType);
+	EncPutByte(&stEncoder, cMediaType);
+	EncPutBytes(&stEncoder, pszMessageBody, nMessageBodyLen);
 
-	if(pszDeviceID != NULL) //Device �뙋�떒
+	if(EncGetLength(&stEncoder) != PacketSize)
 	{
-		if( strlen(pszDeviceID) > LEN_DEVICE_ID) //Device ID 湲몄씠 �솗�씤
-		{
-			GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", LIB_PARAM_ERROR, GetStringtoErrorCode(LIB_PARAM_ERROR) );
-		}
-		else
-		{
-			memcpy(stDelivery_Req.body.usDeviceID, pszDeviceID, strlen(pszDeviceID) );
-		}
+		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", LIB_PARAM_ERROR, GetStringtoErrorCode(LIB_PARAM_ERROR) );
+		free(pDelivery_Req);
+		return LIB_PARAM_ERROR;
 	}
 
-	stDelivery_Req.body.ucReportType = cReportType;
-	stDelivery_Req.body.ucMediaType = cMediaType;
-
-	if(nMessageBodyLen > 0)
-	{
-		memcpy(stDelivery_Req.body.usMessageBody, pszMessageBody, nMessageBodyLen );
-	}
+	((char*)pDelivery_Req)[PacketSize] = 0;
 
 	GMMP_Printf(GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_REQ, "\r\n");
 
-	GMMP_Trace(&stDelivery_Req.header, &stDelivery_Req.body);
+	GMMP_Trace(&pDelivery_Req->header, &pDelivery_Req->body);
 
-	nRet =  GMMP_Delivery_Req(&stDelivery_Req, PacketSize);
+	nRet =  GMMP_Delivery_Req(pDelivery_Req, PacketSize);
 	if(nRet != GMMP_SUCCESS)
 	{
 		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", nRet, GetStringtoErrorCode(nRet) );
 	}
 
+	free(pDelivery_Req);
+
 	GMMP_Printf(GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_NOT, "[GW->OMP]GMMP_SetDelivery End \r\n");
 
 	return nRet;
@@ -494,50 +507,54 @@ int GMMP_SetDelivery(const char* pszAuthID,
 //�젣�뼱 �닔�떊 蹂닿퀬  Response
 int GMMP_SetControl(const char* pszAuthID, const char* pszAuthKey, const char* pszDomainCode, const char* pszGWID, const char* pszDeviceID, const char cControlType, const char cResultCode)
 {
+	int nDomainCodeLen = StrLenMax(pszDomainCode, LEN_DOMAIN_CODE);
+	int nGWIDLen = StrLenMax(pszGWID, LEN_GW_ID);
+	int nDeviceIDLen = StrLenMax(pszDeviceID, LEN_DEVICE_ID);
+
 	if(pszAuthID == NULL
 			|| pszAuthKey == NULL
 			|| pszDomainCode == NULL
 			|| pszGWID ==NULL
-			|| strlen(pszAuthID) > LEN_AUTH_ID
-			|| strlen(pszAuthKey) > LEN_AUTH_KEY
-			|| strlen(pszDomainCode) > LEN_DOMAIN_CODE
-			|| strlen(pszGWID) > LEN_GW_ID)
+			|| nDomainCodeLen > LEN_DOMAIN_CODE
+			|| nGWIDLen > LEN_GW_ID)
 	{
 		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", LIB_PARAM_ERROR, GetStringtoErrorCode(LIB_PARAM_ERROR) );
 		return LIB_PARAM_ERROR;
 	}
 
+	if(nDeviceIDLen > LEN_DEVICE_ID) //Device ID is left empty
+	{
+		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", LIB_PARAM_ERROR, GetStringtoErrorCode(LIB_PARAM_ERROR) );
+		nDeviceIDLen = 0;
+		pszDeviceID = NULL;
+	}
+
 	int nRet = GMMP_SUCCESS;
 
 	Control_Rsp stControl_Rsp;
+	GMMPEncoder stEncoder;
 
-	memset(&stControl_Rsp, 0 ,sizeof(stControl_Rsp) );
+	EncInit(&stEncoder, &stControl_Rsp, sizeof(stControl_Rsp) );
 
-	nRet = SetHeader((void*)&stControl_Rsp, sizeof(stControl_Rsp), 1,  1, OPERATION_CONTROL_RSP, pszAuthID, pszAuthKey, GMMP_ENCRYPTION_NOT);
+	nRet = PutHeader(&stEncoder, sizeof(stControl_Rsp), 1,  1, OPERATION_CONTROL_RSP, pszAuthID, pszAuthKey, GMMP_ENCRYPTION_NOT, GetTID());
 	if(nRet != GMMP_SUCCESS)
 	{
 		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", nRet, GetStringtoErrorCode(nRet) );
 		return nRet;
 	}
 
-	memcpy(stControl_Rsp.body.usDomainCode, pszDomainCode, strlen(pszDomainCode) );
-	memcpy(stControl_Rsp.body.usGWID, pszGWID, strlen(pszGWID) );
+	EncPutField(&stEncoder, pszDomainCode, nDomainCodeLen, LEN_DOMAIN_CODE);
+	EncPutField(&stEncoder, pszGWID, nGWIDLen, LEN_GW_ID);
+	EncPutField(&stEncoder, pszDeviceID, nDeviceIDLen, LEN_DEVICE_ID);
+	EncPutByte(&stEncoder, cControlType);
+	EncPutByte(&stEncoder, cResultCode);
 
-	if(pszDeviceID != NULL) //Device �뙋�떒
+	if(EncGetLength(&stEncoder) != sizeof(stControl_Rsp) )
 	{
-		if( strlen(pszDeviceID) > LEN_DEVICE_ID) //Device ID 湲몄씠 �솗�씤
-		{
-			GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", LIB_PARAM_ERROR, GetStringtoErrorCode(LIB_PARAM_ERROR) );
-		}
-		else
-		{
-			memcpy(stControl_Rsp.body.usDeviceID, pszDeviceID, strlen(pszDeviceID) );
-		}
+		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", LIB_PARAM_ERROR, GetStringtoErrorCode(LIB_PARAM_ERROR) );
+		return LIB_PARAM_ERROR;
 	}
 
-	stControl_Rsp.body.ucControlType = cControlType;
-	stControl_Rsp.body.ucResultCode = cResultCode;
-
 	GMMP_Printf(GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_RSP,"\r\n");
 
 	GMMP_Trace(&stControl_Rsp.header, &stControl_Rsp.body);
@@ -569,75 +586,83 @@ int GMMP_SetNotifi(const char* pszAuthID,
 {
 	GMMP_Printf(GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_OPS,"[GW->OMP]GMMP_SetNotifi Start \r\n");
 
+	int nDomainCodeLen = StrLenMax(pszDomainCode, LEN_DOMAIN_CODE);
+	int nGWIDLen = StrLenMax(pszGWID, LEN_GW_ID);
+	int nDeviceIDLen = StrLenMax(pszDeviceID, LEN_DEVICE_ID);
+
 	if(pszAuthID == NULL
 			|| pszAuthKey == NULL
 			|| pszDomainCode == NULL
 			|| pszGWID ==NULL
-			|| strlen(pszAuthID) > LEN_AUTH_ID
-			|| strlen(pszAuthKey) > LEN_AUTH_KEY
-			|| strlen(pszDomainCode) > LEN_DOMAIN_CODE
-			|| strlen(pszGWID) > LEN_GW_ID)
+			|| nDomainCodeLen > LEN_DOMAIN_CODE
+			|| nGWIDLen > LEN_GW_ID
+			|| nMessageSize < 0
+			|| nMessageSize > MAX_MSG_BODY)
 	{
 		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", LIB_PARAM_ERROR, GetStringtoErrorCode(LIB_PARAM_ERROR) );
 		return LIB_PARAM_ERROR;
 	}
 
+	if(nDeviceIDLen > LEN_DEVICE_ID) //Device ID is left empty
+	{
+		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", LIB_PARAM_ERROR, GetStringtoErrorCode(LIB_PARAM_ERROR) );
+		nDeviceIDLen = 0;
+		pszDeviceID = NULL;
+	}
+
 	int nRet = GMMP_SUCCESS;
 
-	Notifi_Req stNotifi_Req;
+	int PacketSize =sizeof(Notifi_Req) - MAX_MSG_BODY + nMessageSize ; //Message Body is optional
 
-	memset(&stNotifi_Req, 0 ,sizeof(stNotifi_Req) );
+	//one more byte keeps usMessageBody terminated for GMMP_Trace, it is not sent
+	Notifi_Req* pNotifi_Req = (Notifi_Req*)malloc(PacketSize + 1);
+	if(pNotifi_Req == NULL)
+	{
+		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", GMMP_MALLOC_ERROR, GetStringtoErrorCode(GMMP_MALLOC_ERROR) );
+		return GMMP_MALLOC_ERROR;
+	}
 
-	int PacketSize =sizeof(stNotifi_Req) - MAX_MSG_BODY + nMessageSize ; //Message Body�쓽 �냽�꽦�� Optinal�씠�떎
+	GMMPEncoder stEncoder;
 
-	nRet = SetHeader((void*)&stNotifi_Req, PacketSize, 1,  1, OPERATION_NOTIFICATION_REQ, pszAuthID, pszAuthKey, GMMP_ENCRYPTION_NOT);
+	EncInit(&stEncoder, pNotifi_Req, PacketSize);
+
+	nRet = PutHeader(&stEncoder, PacketSize, 1,  1, OPERATION_NOTIFICATION_REQ, pszAuthID, pszAuthKey, GMMP_ENCRYPTION_NOT, GetTID());
 	if(nRet != GMMP_SUCCESS)
 	{
 		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", nRet, GetStringtoErrorCode(nRet) );
+		free(pNotifi_Req);
 		return nRet;
 	}
 
-	memcpy(stNotifi_Req.body.usDomainCode, pszDomainCode, strlen(pszDomainCode) );
-	memcpy(stNotifi_Req.body.usGWID, pszGWID, strlen(pszGWID) );
+	EncPutField(&stEncoder, pszDomainCode, nDomainCodeLen, LEN_DOMAIN_CODE);
+	EncPutField(&stEncoder, pszGWID, nGWIDLen, LEN_GW_ID);
+	EncPutField(&stEncoder, pszDeviceID, nDeviceIDLen, LEN_DEVICE_ID);
+	EncPutByte(&stEncoder, cControlType);
+	EncPutByte(&stEncoder, cResultCode);
+	EncPutBytes(&stEncoder, pszMessageBody, nMessageSize); //NULL Message Body is sent as 0x00
 
-	if(pszDeviceID != NULL) //Device �뙋�떒
+	if(EncGetLength(&stEncoder) != PacketSize)
 	{
-		if( strlen(pszDeviceID) > LEN_DEVICE_ID) //Device ID 湲몄씠 �솗�씤
-		{
-			GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", LIB_PARAM_ERROR, GetStringtoErrorCode(LIB_PARAM_ERROR) );
-		}
-		else
-		{
-			memcpy(stNotifi_Req.body.usDeviceID, pszDeviceID, strlen(pszDeviceID) );
-		}
+		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", LIB_PARAM_ERROR, GetStringtoErrorCode(LIB_PARAM_ERROR) );
+		free(pNotifi_Req);
+		return LIB_PARAM_ERROR;
 	}
 
-	stNotifi_Req.body.ucControlType = cControlType;
-	stNotifi_Req.body.ucResultCode = cResultCode;
-
-	if(pszMessageBody != NULL) //Message �궗�슜 �뙋�떒
-	{
-		if(nMessageSize > MAX_MSG_BODY)
-		{
-			GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", LIB_PARAM_ERROR, GetStringtoErrorCode(LIB_PARAM_ERROR) );
-		}
-		else
-		{
-			memcpy(stNotifi_Req.body.usMessageBody, pszMessageBody, nMessageSize);
-		}
-	}
+	((char*)pNotifi_Req)[PacketSize] = 0;
 
 	GMMP_Printf(GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_REQ, "\r\n");
 
-	GMMP_Trace(&stNotifi_Req.header, &stNotifi_Req.body);
+	GMMP_Trace(&pNotifi_Req->header, &pNotifi_Req->body);
 
-	nRet =  GMMP_Notifi_Req(&stNotifi_Req, PacketSize);
+	nRet =  GMMP_Notifi_Req(pNotifi_Req, PacketSize);
 
 	if(nRet != GMMP_SUCCESS)
 	{
 		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", nRet, GetStringtoErrorCode(nRet) );
 	}
 
+	free(pNotifi_Req);
+
 	GMMP_Printf(GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_NOT, "[GW->OMP]GMMP_SetNotifi End \r\n");
 
 	return nRet;
@@ -650,14 +675,15 @@ int GMMP_SetHB(const char* pszAuthID,
 {
 	GMMP_Printf(GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_OPS,"[GW->OMP]GMMP_SetHB Start \r\n");
 
+	int nDomainCodeLen = StrLenMax(pszDomainCode, LEN_DOMAIN_CODE);
+	int nGWIDLen = StrLenMax(pszGWID, LEN_GW_ID);
+
 	if(pszAuthID == NULL
 			|| pszAuthKey == NULL
 			|| pszDomainCode == NULL
 			|| pszGWID ==NULL
-			|| strlen(pszAuthID) > LEN_AUTH_ID
-			|| strlen(pszAuthKey) > LEN_AUTH_KEY
-			|| strlen(pszDomainCode) > LEN_DOMAIN_CODE
-			|| strlen(pszGWID) > LEN_GW_ID)
+			|| nDomainCodeLen > LEN_DOMAIN_CODE
+			|| nGWIDLen > LEN_GW_ID)
 	{
 		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR, "Code[%d], %s\r\n", LIB_PARAM_ERROR, GetStringtoErrorCode(LIB_PARAM_ERROR) );
 		return LIB_PARAM_ERROR;
@@ -666,18 +692,25 @@ int GMMP_SetHB(const char* pszAuthID,
 	int nRet = GMMP_SUCCESS;
 
 	HB_Req stHB_Req;
+	GMMPEncoder stEncoder;
 
-	memset(&stHB_Req, 0 ,sizeof(stHB_Req) );
+	EncInit(&stEncoder, &stHB_Req, sizeof(stHB_Req) );
 
-	nRet = SetHeader((void*)&stHB_Req, sizeof(stHB_Req), 1,  1, OPERATION_HEARTBEAT_REQ, pszAuthID, pszAuthKey, GMMP_ENCRYPTION_NOT);
+	nRet = PutHeader(&stEncoder, sizeof(stHB_Req), 1,  1, OPERATION_HEARTBEAT_REQ, pszAuthID, pszAuthKey, GMMP_ENCRYPTION_NOT, GetTID());
 	if(nRet != GMMP_SUCCESS)
 	{
 		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", nRet, GetStringtoErrorCode(nRet) );
 		return nRet;
 	}
 
-	memcpy(stHB_Req.body.usDomainCode, pszDomainCode, strlen(pszDomainCode) );
-	memcpy(stHB_Req.body.usGWID, pszGWID, strlen(pszGWID) );
+	EncPutField(&stEncoder, pszDomainCode, nDomainCodeLen, LEN_DOMAIN_CODE);
+	EncPutField(&stEncoder, pszGWID, nGWIDLen, LEN_GW_ID);
+
+	if(EncGetLength(&stEncoder) != sizeof(stHB_Req) )
+	{
+		GMMP_Printf(GMMP_ERROR_LEVEL_ERROR, GMMP_LOG_MARKET_ERR,"Code[%d], %s\r\n", LIB_PARAM_ERROR, GetStringtoErrorCode(LIB_PARAM_ERROR) );
+		return LIB_PARAM_ERROR;
+	}
 
 	GMMP_Printf(GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_REQ, "\r\n");
 
@@ -1867,6 +1900,59 @@ int SetHeader(void* pData,
 	return GMMP_SUCCESS;
 }
 
+//protected
+int PutHeader(GMMPEncoder* pEncoder,
+		int nPacketSize,
+		int nTotalCount,
+		int nCurrentCount,
+		const char cMessageType,
+		const char* pszAuthID,
+		const char* pszAuthKey,
+		const char cEncryption,
+		const int nTID)
+{
+	int nAuthIDLen = StrLenMax(pszAuthID, LEN_AUTH_ID);
+	int nAuthKeyLen = StrLenMax(pszAuthKey, LEN_AUTH_KEY);
+
+	if(pEncoder == NULL || pszAuthID == NULL || nAuthIDLen > LEN_AUTH_ID || nAuthKeyLen > LEN_AUTH_KEY)
+	{
+		return LIB_PARAM_ERROR;
+	}
+
+	GMMPHeader* pHeader = (GMMPHeader*)EncReserve(pEncoder, sizeof(GMMPHeader) );
+	if(pHeader == NULL)
+	{
+		return LIB_PARAM_ERROR;
+	}
+
+	// sekim 20151222 TimeStamp in GMMP with host_rtos_get_time()
+	unsigned int time_current = host_rtos_get_time()*1000;
+
+	//every field is written once, multi-byte values in network byte order
+	pHeader->ucVersion = GMMP_VERSION;
+	pHeader->usMessageLength[0] = (U8)(nPacketSize >> 8);
+	pHeader->usMessageLength[1] = (U8)nPacketSize;
+	pHeader->ucMessageType = cMessageType;
+	pHeader->unOriginTimeStamp[0] = (U8)(time_current >> 24);
+	pHeader->unOriginTimeStamp[1] = (U8)(time_current >> 16);
+	pHeader->unOriginTimeStamp[2] = (U8)(time_current >> 8);
+	pHeader->unOriginTimeStamp[3] = (U8)time_current;
+	pHeader->usTotalCount[0] = (U8)(nTotalCount >> 8);
+	pHeader->usTotalCount[1] = (U8)nTotalCount;
+	pHeader->usCurrentCount[0] = (U8)(nCurrentCount >> 8);
+	pHeader->usCurrentCount[1] = (U8)nCurrentCount;
+	FillField(pHeader->usAuthID, pszAuthID, nAuthIDLen, LEN_AUTH_ID);
+	FillField(pHeader->usAuthKey, pszAuthKey, nAuthKeyLen, LEN_AUTH_KEY);
+	pHeader->usTID[0] = (U8)((unsigned int)nTID >> 24);
+	pHeader->usTID[1] = (U8)((unsigned int)nTID >> 16);
+	pHeader->usTID[2] = (U8)((unsigned int)nTID >> 8);
+	pHeader->usTID[3] = (U8)nTID;
+	pHeader->ucReserved1 = cEncryption;
+	pHeader->ucReserved2 = 0;
+
+	return GMMP_SUCCESS;
+}
+
 int SetIntiSocket()
 {
 	// sekim 20151222 not try to connect when Initializaion
@@ -172,6 +172,7 @@ int GMMP_GetProfile(Profile_Rsp* pstProfile_Rsp);
  * @param nTotalCount
  * @param nCurrentCount
  * @param cEncryption
+ * @param nTID 요청의 T-ID
  * @return
  */
 int GMMP_SetDelivery(const char* pszAuthID,
@@ -184,7 +185,8 @@ int GMMP_SetDelivery(const char* pszAuthID,
 		const char* pszMessageBody,
 		const int nTotalCount,
 		const int nCurrentCount,
-		const char cEncryption);
+		const char cEncryption,
+		const int nTID);
 /**
  *
  * @param pstDelivery_Rsp
@@ -486,6 +488,29 @@ int SetHeader(void* pData,
 		const char* pszAuthKey,
 		const char cEncryption);
 
+/**
+ * @brief GMMP Header를 Encoder에 기록한다. 고정 길이 필드 외의 빈 공간을 memset 하지 않는다.
+ * @param pEncoder 송신 버퍼의 Encoder
+ * @param nPacketSize Header를 포함한 전체 메시지 길이
+ * @param nTotalCount
+ * @param nCurrentCount
+ * @param cMessageType
+ * @param pszAuthID
+ * @param pszAuthKey NULL이면 0x00
+ * @param cEncryption
+ * @param nTID Header에 기록할 T-ID. g_nTID를 읽지 않으므로 다른 Thread의 요청과 섞이지 않는다.
+ * @return 성공 : GMMP_SUCCESS, 실패 : LIB_PARAM_ERROR
+ */
+int PutHeader(GMMPEncoder* pEncoder,
+		int nPacketSize,
+		int nTotalCount,
+		int nCurrentCount,
+		const char cMessageType,
+		const char* pszAuthID,
+		const char* pszAuthKey,
+		const char cEncryption,
+		const int nTID);
+
 /**
  *
  * @return
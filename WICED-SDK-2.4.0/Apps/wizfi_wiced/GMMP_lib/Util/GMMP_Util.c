@@ -84,3 +84,113 @@ int _ltobi(const int nInt)
 
 	return (nVal0 | nVal1 | nVal2 | nVal3);
 }
+
+int StrLenMax(const char* pszValue, const int nMax)
+{
+	const char* pszEnd = NULL;
+
+	if(pszValue == NULL)
+	{
+		return 0;
+	}
+
+	//memchr stops at the terminator, so short strings are not read past their end
+	pszEnd = (const char*)memchr(pszValue, 0, nMax + 1);
+	if(pszEnd == NULL)
+	{
+		return nMax + 1;
+	}
+
+	return pszEnd - pszValue;
+}
+
+void EncInit(GMMPEncoder* pEnc, void* pBuf, const int nSize)
+{
+	pEnc->pBuf = (unsigned char*)pBuf;
+	pEnc->nSize = nSize;
+	pEnc->nPos = 0;
+	pEnc->bOverflow = 0;
+}
+
+unsigned char* EncReserve(GMMPEncoder* pEnc, const int nLen)
+{
+	unsigned char* pPos = NULL;
+
+	if(pEnc->bOverflow != 0 || nLen < 0 || nLen > pEnc->nSize - pEnc->nPos)
+	{
+		pEnc->bOverflow = 1;
+		return NULL;
+	}
+
+	pPos = pEnc->pBuf + pEnc->nPos;
+	pEnc->nPos += nLen;
+
+	return pPos;
+}
+
+void EncPutByte(GMMPEncoder* pEnc, const unsigned char cValue)
+{
+	unsigned char* pPos = EncReserve(pEnc, 1);
+
+	if(pPos != NULL)
+	{
+		pPos[0] = cValue;
+	}
+}
+
+void EncPutBytes(GMMPEncoder* pEnc, const void* pData, const int nLen)
+{
+	unsigned char* pPos = EncReserve(pEnc, nLen);
+
+	if(pPos == NULL || nLen == 0)
+	{
+		return;
+	}
+
+	if(pData != NULL)
+	{
+		memcpy(pPos, pData, nLen);
+	}
+	else
+	{
+		memset(pPos, 0, nLen);
+	}
+}
+
+void EncPutField(GMMPEncoder* pEnc, const char* pszValue, const int nLen, const int nFieldLen)
+{
+	unsigned char* pPos = NULL;
+
+	if(nLen > nFieldLen)
+	{
+		pEnc->bOverflow = 1;
+		return;
+	}
+
+	pPos = EncReserve(pEnc, nFieldLen);
+	if(pPos != NULL)
+	{
+		FillField(pPos, pszValue, nLen, nFieldLen);
+	}
+}
+
+void FillField(unsigned char* pDest, const char* pszValue, const int nLen, const int nFieldLen)
+{
+	int nCopy = (pszValue != NULL) ? nLen : 0;
+
+	if(nCopy > 0)
+	{
+		memcpy(pDest, pszValue, nCopy);
+	}
+	memset(pDest + nCopy, 0, nFieldLen - nCopy);
+}
+
+int EncGetLength(const GMMPEncoder* pEnc)
+{
+	if(pEnc->bOverflow != 0)
+	{
+		return -1;
+	}
+
+	return pEnc->nPos;
+}
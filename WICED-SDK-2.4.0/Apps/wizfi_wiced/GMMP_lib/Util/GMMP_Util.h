@@ -50,4 +50,81 @@ int 		btoli(const int nInt);
  */
 int 		_ltobi(const int nInt);
 
+/**
+ * @struct GMMPEncoder
+ * @brief 송신 버퍼에 GMMP 메시지를 순서대로 기록하는 Encoder\n
+ * 버퍼 크기를 넘는 기록은 하지 않고 bOverflow를 설정한다.
+ */
+typedef struct
+{
+	unsigned char*	pBuf;
+	int				nSize;
+	int				nPos;
+	int				bOverflow;
+}GMMPEncoder;
+
+/**
+ * @brief 문자열의 길이를 최대 nMax + 1 까지만 확인한다.
+ * @param pszValue 문자열, NULL이면 0
+ * @param nMax 허용 최대 길이
+ * @return 문자열 길이, nMax보다 길면 nMax + 1
+ */
+int		StrLenMax(const char* pszValue, const int nMax);
+
+/**
+ * @brief Encoder가 pBuf의 nSize 바이트에 기록하도록 초기화 한다.
+ * @param pEnc Encoder
+ * @param pBuf 송신 버퍼
+ * @param nSize 송신 버퍼 크기
+ */
+void	EncInit(GMMPEncoder* pEnc, void* pBuf, const int nSize);
+
+/**
+ * @brief nLen 바이트의 기록 위치를 확보한다. 확보한 영역은 호출자가 모두 채워야 한다.
+ * @param pEnc Encoder
+ * @param nLen 확보할 길이
+ * @return 기록 위치, 버퍼 크기를 넘으면 NULL
+ */
+unsigned char*	EncReserve(GMMPEncoder* pEnc, const int nLen);
+
+/**
+ * @brief 1 byte를 기록한다.
+ * @param pEnc Encoder
+ * @param cValue 기록할 값
+ */
+void	EncPutByte(GMMPEncoder* pEnc, const unsigned char cValue);
+
+/**
+ * @brief nLen 바이트를 기록한다.
+ * @param pEnc Encoder
+ * @param pData 기록할 데이터, NULL이면 0x00으로 채운다.
+ * @param nLen 기록할 길이
+ */
+void	EncPutBytes(GMMPEncoder* pEnc, const void* pData, const int nLen);
+
+/**
+ * @brief nLen 길이의 문자열을 기록하고 고정 길이 필드의 빈자리는 0x00(NULL)로 채운다.
+ * @param pEnc Encoder
+ * @param pszValue 문자열, NULL이면 빈 필드
+ * @param nLen 문자열 길이, @ref StrLenMax 결과
+ * @param nFieldLen 필드 길이
+ */
+void	EncPutField(GMMPEncoder* pEnc, const char* pszValue, const int nLen, const int nFieldLen);
+
+/**
+ * @brief 고정 길이 필드에 nLen 길이의 문자열을 복사하고 빈자리는 0x00(NULL)로 채운다.
+ * @param pDest 필드 위치
+ * @param pszValue 문자열, NULL이면 빈 필드
+ * @param nLen 문자열 길이, nFieldLen 이하
+ * @param nFieldLen 필드 길이
+ */
+void	FillField(unsigned char* pDest, const char* pszValue, const int nLen, const int nFieldLen);
+
+/**
+ * @brief 기록된 길이를 확인한다.
+ * @param pEnc Encoder
+ * @return 기록된 길이, 버퍼 크기를 넘는 기록이 있었으면 -1
+ */
+int		EncGetLength(const GMMPEncoder* pEnc);
+
 #endif /* GMMP_UTIL_H_ */
@@ -26,6 +26,20 @@ uint32_t g_nGMMPTCPBufferLen = 0;
 
 uint8_t g_nGMMPThreadCount = 0;
 
+#define GMMP_DELIVERY_TIMEOUT	10000
+
+void GW_DeliveryResult(int nTID, int nResult, GMMPHeader* pstGMMPHeader, void* pBody, void* pArg)
+{
+	if ( nResult!=GMMP_SUCCESS )
+	{
+		W_DBG("GW_DeliveryResult : TID %d error (%d)", nTID, nResult);
+	}
+	else if ( ((stPacketDeliveryRspHdr*)pBody)->ucResultCode!=0x00 )
+	{
+		W_DBG("GW_DeliveryResult : TID %d result code (%d)", nTID, ((stPacketDeliveryRspHdr*)pBody)->ucResultCode);
+	}
+}
+
 int GW_Delivery()
 {
 	int nRet = 0;
@@ -68,7 +82,11 @@ int GW_Delivery()
 
 		memcpy(szMessage, g_pszMessage+nMessagePos, nSendLen);
 
-		nRet = GO_Delivery(GetGWID(), NULL, DELIVERY_COLLECT_DATA,  0x01, szMessage, nTotalCount, nLoop, GMMP_ENCRYPTION_NOT);
+		// With the session kept open the parts go out back to back and GmmpRecvThread matches the responses
+		if ( GetNetworkType()==GMMP_NETWORK_ALYWAYS_ON )
+			nRet = GO_Delivery_Async(GetGWID(), NULL, DELIVERY_COLLECT_DATA,  0x01, szMessage, nTotalCount, nLoop, GMMP_ENCRYPTION_NOT, GMMP_DELIVERY_TIMEOUT, GW_DeliveryResult, NULL);
+		else
+			nRet = GO_Delivery(GetGWID(), NULL, DELIVERY_COLLECT_DATA,  0x01, szMessage, nTotalCount, nLoop, GMMP_ENCRYPTION_NOT);
 
 		if(nRet < 0)
 		{
@@ -92,6 +110,8 @@ void GmmpSendThread(uint32_t arg)
 	{
 		wiced_rtos_delay_milliseconds(1000);
 
+		AsyncCheckTimeout();
+
 		if ( !WXLink_IsWiFiLinked() )
 		{
 			continue;
@@ -15,6 +15,8 @@ $(NAME)_SOURCES :=  mqtt_network.c  \
                     mqtt_connection.c \
                     mqtt_manager.c  \
                     mqtt_session.c \
+                    mqtt_topic.c \
+                    mqtt_store.c \
                     mqtt_api.c
 #make it visible for the applications which take advantage of this lib
 GLOBAL_INCLUDES := .
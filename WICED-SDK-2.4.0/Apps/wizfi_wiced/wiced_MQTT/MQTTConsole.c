@@ -414,6 +414,7 @@ wiced_result_t mqtt_connection_event_cb( wiced_mqtt_object_t mqtt_object, wiced_
         case WICED_MQTT_EVENT_TYPE_CONNECT_REQ_STATUS:
         case WICED_MQTT_EVENT_TYPE_DISCONNECTED:
         case WICED_MQTT_EVENT_TYPE_PUBLISHED:
+        case WICED_MQTT_EVENT_TYPE_PUBLISH_FAILED:
         case WICED_MQTT_EVENT_TYPE_SUBCRIBED:
         case WICED_MQTT_EVENT_TYPE_UNSUBSCRIBED:
         {
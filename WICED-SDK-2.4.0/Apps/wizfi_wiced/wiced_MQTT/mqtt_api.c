@@ -139,6 +139,30 @@ wiced_mqtt_msgid_t wiced_mqtt_subscribe( wiced_mqtt_object_t mqtt_obj, char *top
     args.topic_filter.str = (uint8_t*) topic;
     args.topic_filter.len = (uint16_t) strlen( topic );
     args.qos = qos;
+    args.subscriptions = NULL;
+    args.count = 1;
+    args.packet_id = ( ++conn->packet_id );
+    if ( mqtt_subscribe( conn, &args ) != WICED_SUCCESS )
+    {
+        return 0;
+    }
+    return args.packet_id;
+}
+
+wiced_mqtt_msgid_t wiced_mqtt_subscribe_multiple( wiced_mqtt_object_t mqtt_obj, const wiced_mqtt_subscription_t *subscriptions, uint8_t count )
+{
+    mqtt_connection_t *conn = (mqtt_connection_t*) mqtt_obj;
+    mqtt_subscribe_arg_t args;
+
+    if ( ( subscriptions == NULL ) || ( count == 0 ) )
+    {
+        return 0;
+    }
+    args.topic_filter.str = NULL;
+    args.topic_filter.len = 0;
+    args.qos = MQTT_QOS_DELIVER_AT_MOST_ONCE;
+    args.subscriptions = subscriptions;
+    args.count = count;
     args.packet_id = ( ++conn->packet_id );
     if ( mqtt_subscribe( conn, &args ) != WICED_SUCCESS )
     {
@@ -154,6 +178,29 @@ wiced_mqtt_msgid_t wiced_mqtt_unsubscribe( wiced_mqtt_object_t mqtt_obj, char *t
 
     args.topic_filter.str = (uint8_t*) topic;
     args.topic_filter.len = (uint16_t) ( strlen( topic ) );
+    args.topics = NULL;
+    args.count = 1;
+    args.packet_id = ( ++conn->packet_id );
+    if ( mqtt_unsubscribe( conn, &args ) != WICED_SUCCESS )
+    {
+        return 0;
+    }
+    return args.packet_id;
+}
+
+wiced_mqtt_msgid_t wiced_mqtt_unsubscribe_multiple( wiced_mqtt_object_t mqtt_obj, char * const *topics, uint8_t count )
+{
+    mqtt_connection_t *conn = (mqtt_connection_t*) mqtt_obj;
+    mqtt_unsubscribe_arg_t args;
+
+    if ( ( topics == NULL ) || ( count == 0 ) )
+    {
+        return 0;
+    }
+    args.topic_filter.str = NULL;
+    args.topic_filter.len = 0;
+    args.topics = topics;
+    args.count = count;
     args.packet_id = ( ++conn->packet_id );
     if ( mqtt_unsubscribe( conn, &args ) != WICED_SUCCESS )
     {
@@ -170,13 +217,119 @@ wiced_mqtt_msgid_t wiced_mqtt_publish( wiced_mqtt_object_t mqtt_obj, uint8_t *to
     args.topic.len = (uint16_t) strlen( (char*) topic );
     args.data = (uint8_t*) data;
     args.data_len = data_len;
+    args.reader = NULL;
+    args.reader_arg = NULL;
     args.dup = 0;
     args.qos = qos;
     args.retain = 0;
     args.packet_id = ( ++conn->packet_id );
+    if ( ( conn->store != NULL ) && ( conn->connected == WICED_FALSE ) )
+    {
+        if ( mqtt_store_append( conn->store, &args ) != WICED_SUCCESS )
+        {
+            return 0;
+        }
+        return args.packet_id;
+    }
     if ( mqtt_publish( conn, &args ) != WICED_SUCCESS )
     {
         return 0;
     }
     return args.packet_id;
 }
+
+wiced_result_t wiced_mqtt_get_session_statistics( wiced_mqtt_object_t mqtt_obj, wiced_mqtt_session_statistics_t *statistics )
+{
+    mqtt_connection_t *conn = (mqtt_connection_t*) mqtt_obj;
+
+    if ( conn->session == NULL )
+    {
+        memset( statistics, 0, sizeof( *statistics ) );
+        return WICED_NOTUP;
+    }
+    *statistics = conn->session->statistics;
+    return WICED_SUCCESS;
+}
+
+wiced_mqtt_msgid_t wiced_mqtt_publish_stream( wiced_mqtt_object_t mqtt_obj, uint8_t *topic, uint32_t data_len, uint8_t qos, wiced_mqtt_payload_reader_t reader, void *reader_arg )
+{
+    mqtt_publish_arg_t args;
+    mqtt_connection_t *conn = (mqtt_connection_t*) mqtt_obj;
+    if ( reader == NULL )
+    {
+        return 0;
+    }
+    args.topic.str = (uint8_t*) topic;
+    args.topic.len = (uint16_t) strlen( (char*) topic );
+    args.data = NULL;
+    args.data_len = data_len;
+    args.reader = reader;
+    args.reader_arg = reader_arg;
+    args.dup = 0;
+    args.qos = qos;
+    args.retain = 0;
+    args.packet_id = ( ++conn->packet_id );
+    if ( mqtt_publish( conn, &args ) != WICED_SUCCESS )
+    {
+        return 0;
+    }
+    return args.packet_id;
+}
+
+wiced_result_t wiced_mqtt_store_init( wiced_mqtt_object_t mqtt_obj, const wiced_mqtt_store_config_t *config )
+{
+    mqtt_connection_t *conn = (mqtt_connection_t*) mqtt_obj;
+    mqtt_store_t *store;
+    wiced_result_t result;
+
+    if ( conn->store != NULL )
+    {
+        return WICED_ERROR;
+    }
+    store = (mqtt_store_t*) malloc_named( "mqtt_store", sizeof(mqtt_store_t) );
+    if ( store == NULL )
+    {
+        return WICED_NOMEM;
+    }
+    result = mqtt_store_init( store, config );
+    if ( result != WICED_SUCCESS )
+    {
+        free( store );
+        return result;
+    }
+    conn->store = store;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_mqtt_store_deinit( wiced_mqtt_object_t mqtt_obj )
+{
+    mqtt_connection_t *conn = (mqtt_connection_t*) mqtt_obj;
+    mqtt_store_t *store = conn->store;
+
+    if ( store == NULL )
+    {
+        return WICED_NOTUP;
+    }
+    if ( ( conn->connected == WICED_TRUE ) || ( store->drain_packet_id != 0 ) )
+    {
+        /* The MQTT thread may be draining it; a message waiting on the Broker stays in flash */
+        return WICED_PENDING;
+    }
+    conn->store = NULL;
+    mqtt_store_deinit( store );
+    free( store );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_mqtt_store_get_statistics( wiced_mqtt_object_t mqtt_obj, wiced_mqtt_store_statistics_t *statistics )
+{
+    mqtt_connection_t *conn = (mqtt_connection_t*) mqtt_obj;
+
+    if ( conn->store == NULL )
+    {
+        memset( statistics, 0, sizeof( *statistics ) );
+        return WICED_NOTUP;
+    }
+    *statistics = conn->store->statistics;
+    return WICED_SUCCESS;
+}
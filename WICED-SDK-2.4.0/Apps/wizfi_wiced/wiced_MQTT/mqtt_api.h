@@ -95,6 +95,8 @@ wiced_result_t wiced_mqtt_disconnect( wiced_mqtt_object_t mqtt_obj );
  * NOTE:
  *      This is an asynchronous API. Publish status will be notified using using callback function.
  *      WICED_MQTT_EVENT_TYPE_PUBLISHED event will be sent using callback function
+ *      WICED_MQTT_EVENT_TYPE_PUBLISH_FAILED event is sent instead if MQTT_SESSION_WINDOW_SIZE QoS 1/2
+ *      messages are already waiting for acknowledgement; the message is not sent and may be published again
  *
  * @param[in] mqtt_obj          : Contains address of a memory location which is passed during MQTT init
  * @param[in] topic             : Contains the topic on which the message to be published
@@ -104,12 +106,37 @@ wiced_result_t wiced_mqtt_disconnect( wiced_mqtt_object_t mqtt_obj );
  *
  * @return wiced_mqtt_msgid_t   : ID for the message being published
  * NOTE: Allocate memory for topic, data in non-stack area.
- *       And free/resuse them after getting event WICED_MQTT_EVENT_TYPE_PUBLISHED
+ *       And free/resuse them after getting event WICED_MQTT_EVENT_TYPE_PUBLISHED, WICED_MQTT_EVENT_TYPE_PUBLISH_FAILED
  *       or WICED_MQTT_EVENT_TYPE_DISCONNECTED for given message ID (wiced_mqtt_msgid_t)
+ * NOTE: While the offline store is enabled and the Broker is not connected the message is
+ *       copied to serial flash and topic, data may be reused as soon as this returns.
+ *       It is sent after the next CONNACK under a new message ID.
  */
 wiced_mqtt_msgid_t wiced_mqtt_publish( wiced_mqtt_object_t mqtt_obj, uint8_t *topic, uint8_t *data, uint32_t data_len, uint8_t qos );
 
 
+/** Publish a message whose payload is supplied piece by piece by the application
+ *
+ * NOTE:
+ *      This is an asynchronous API. Publish status will be notified using using callback function.
+ *      The payload is read into network packets as they are filled, so it never has to be held
+ *      in RAM as a whole. Use this for payloads too large to publish with wiced_mqtt_publish().
+ *      A full session window is reported with WICED_MQTT_EVENT_TYPE_PUBLISH_FAILED as for wiced_mqtt_publish().
+ *
+ * @param[in] mqtt_obj          : Contains address of a memory location which is passed during MQTT init
+ * @param[in] topic             : Contains the topic on which the message to be published
+ * @param[in] data_len          : Length of the message
+ * @param[in] qos               : QoS level to be used for publishing the given message
+ * @param[in] reader            : Function called from the MQTT thread to read the message
+ * @param[in] reader_arg        : Argument passed to the reader
+ *
+ * @return wiced_mqtt_msgid_t   : ID for the message being published
+ * NOTE: The reader must be able to supply the message again until WICED_MQTT_EVENT_TYPE_PUBLISHED,
+ *       WICED_MQTT_EVENT_TYPE_PUBLISH_FAILED or WICED_MQTT_EVENT_TYPE_DISCONNECTED is received for the given message ID (wiced_mqtt_msgid_t)
+ */
+wiced_mqtt_msgid_t wiced_mqtt_publish_stream( wiced_mqtt_object_t mqtt_obj, uint8_t *topic, uint32_t data_len, uint8_t qos, wiced_mqtt_payload_reader_t reader, void *reader_arg );
+
+
 /** Subscribe for a topic with MQTT Broker
  *
  * NOTE:
@@ -128,6 +155,29 @@ wiced_mqtt_msgid_t wiced_mqtt_publish( wiced_mqtt_object_t mqtt_obj, uint8_t *to
 wiced_mqtt_msgid_t wiced_mqtt_subscribe( wiced_mqtt_object_t mqtt_obj, char *topic, uint8_t qos );
 
 
+/** Subscribe for several topic filters with MQTT Broker in one request
+ *
+ * NOTE:
+ *      This is an asynchronous API. Subscribe status will be notified using using callback function.
+ *      WICED_MQTT_EVENT_TYPE_SUBCRIBED event will be sent once for the whole request; if the Broker
+ *      refused any of the filters the request is reported as failed.
+ *      Messages matching a filter given with a callback are passed to that callback instead of being
+ *      sent as WICED_MQTT_EVENT_TYPE_PUBLISH_MSG_RECEIVED events. A filter may contain '+' and '#' wildcards.
+ *      Subscribing again to a filter replaces its callback and argument, as the Broker replaces the
+ *      subscription; a filter has at most one callback.
+ *
+ * @param[in] mqtt_obj          : Contains address of a memory location which is passed during MQTT init
+ * @param[in] subscriptions     : Topic filters to be subscribed to
+ * @param[in] count             : Number of entries in subscriptions
+ *
+ * @return wiced_mqtt_msgid_t   : ID for the message being subscribed
+ * NOTE: Allocate memory for subscriptions and their topics in non-stack area.
+ *       And free/resuse them after getting event WICED_MQTT_EVENT_TYPE_SUBCRIBED
+ *       or WICED_MQTT_EVENT_TYPE_DISCONNECTED for given message ID (wiced_mqtt_msgid_t)
+ */
+wiced_mqtt_msgid_t wiced_mqtt_subscribe_multiple( wiced_mqtt_object_t mqtt_obj, const wiced_mqtt_subscription_t *subscriptions, uint8_t count );
+
+
 /** Unsubscribe the topic from MQTT Broker
  *
  * NOTE:
@@ -144,6 +194,74 @@ wiced_mqtt_msgid_t wiced_mqtt_subscribe( wiced_mqtt_object_t mqtt_obj, char *top
  */
 wiced_mqtt_msgid_t wiced_mqtt_unsubscribe( wiced_mqtt_object_t mqtt_obj, char *topic );
 
+
+/** Unsubscribe several topic filters from MQTT Broker in one request
+ *
+ * NOTE:
+ *      This is an asynchronous API. Unsubscribe status will be notified using using callback function.
+ *      WICED_MQTT_EVENT_TYPE_UNSUBCRIBED event will be sent using callback function.
+ *      Callbacks registered for the filters stop being called once the request is sent.
+ *
+ * @param[in] mqtt_obj          : Contains address of a memory location which is passed during MQTT init
+ * @param[in] topics            : Topic filters to be unsubscribed
+ * @param[in] count             : Number of entries in topics
+ *
+ * @return wiced_mqtt_msgid_t   : ID for the message being unsubscribed
+ * NOTE: Allocate memory for topics in non-stack area.
+ *       And free/resuse them after getting event WICED_MQTT_EVENT_TYPE_UNSUBSCRIBED
+ *       or WICED_MQTT_EVENT_TYPE_DISCONNECTED for given message ID (wiced_mqtt_msgid_t)
+ */
+wiced_mqtt_msgid_t wiced_mqtt_unsubscribe_multiple( wiced_mqtt_object_t mqtt_obj, char * const *topics, uint8_t count );
+
+
+/** Reads the number of messages in flight in each state of the QoS 1/2 exchanges
+ *
+ * @param[in]  mqtt_obj         : Contains address of a memory location which is passed during MQTT init
+ * @param[out] statistics       : Receives the counters
+ *
+ * @return @ref wiced_result_t
+ */
+wiced_result_t wiced_mqtt_get_session_statistics( wiced_mqtt_object_t mqtt_obj, wiced_mqtt_session_statistics_t *statistics );
+
+
+/** Keeps messages published while disconnected in serial flash and sends them after reconnecting
+ *
+ * NOTE:
+ *      Call after wiced_mqtt_init. Messages already in the area from before a reset are kept.
+ *      The area is used as a log of 4K sectors, erased in turn so wear is spread across all of them.
+ *      Stored messages are sent in the order they were published, one QoS 1/2 message at a time,
+ *      at no more than config->drain_rate messages per second.
+ *      Messages published with wiced_mqtt_publish_stream are never stored.
+ *
+ * @param[in] mqtt_obj          : Contains address of a memory location which is passed during MQTT init
+ * @param[in] config            : Serial flash area reserved for the store and how it is drained
+ *
+ * @return @ref wiced_result_t
+ */
+wiced_result_t wiced_mqtt_store_init( wiced_mqtt_object_t mqtt_obj, const wiced_mqtt_store_config_t *config );
+
+
+/** Stops storing messages. Messages still in serial flash are kept for the next wiced_mqtt_store_init
+ *
+ * NOTE: wiced_mqtt_deinit stops the store as well. The store is drained from the MQTT thread
+ *       while the Broker is connected, so it can only be stopped while disconnected.
+ *
+ * @param[in] mqtt_obj          : Contains address of a memory location which is passed during MQTT init
+ *
+ * @return @ref wiced_result_t  : WICED_PENDING while connected or while a stored message waits for its acknowledgement
+ */
+wiced_result_t wiced_mqtt_store_deinit( wiced_mqtt_object_t mqtt_obj );
+
+
+/** Reads the offline store counters
+ *
+ * @param[in]  mqtt_obj         : Contains address of a memory location which is passed during MQTT init
+ * @param[out] statistics       : Receives the counters
+ *
+ * @return @ref wiced_result_t
+ */
+wiced_result_t wiced_mqtt_store_get_statistics( wiced_mqtt_object_t mqtt_obj, wiced_mqtt_store_statistics_t *statistics );
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -59,6 +59,7 @@ typedef enum wiced_mqtt_event_s
     WICED_MQTT_EVENT_TYPE_SUBCRIBED,                            /* Event sent when broker accepts SUBSCRIBED request */
     WICED_MQTT_EVENT_TYPE_UNSUBSCRIBED,                         /* Event sent when broker accepts UNSUBSCRIBED request */
     WICED_MQTT_EVENT_TYPE_PUBLISH_MSG_RECEIVED,                 /* Event sent when PUBLISH message is received from the broker for a subscribed topic */
+    WICED_MQTT_EVENT_TYPE_PUBLISH_FAILED,                       /* Event sent for QOS-1 and QOS-2 when the message was not sent because too many messages await acknowledgement */
     WICED_MQTT_EVENT_TYPE_UNKNOWN                               /* Event type not known */
 } wiced_mqtt_event_type_t;
 
@@ -107,7 +108,7 @@ typedef struct wiced_mqtt_event_info_s
     union
     {
         wiced_mqtt_conn_err_code_t      err_code;               /* Valid only for WICED_MQTT_EVENT_TYPE_CONNECT_REQ_STATUS event. Indicates the error identified while connecting to Broker */
-        wiced_mqtt_msgid_t              msgid;                  /* Valid only for WICED_MQTT_EVENT_TYPE_PUBLISHED, WICED_MQTT_EVENT_TYPE_SUBCRIBED, WICED_MQTT_EVENT_TYPE_UNSUBSCRIBED events. Indicates message ID */
+        wiced_mqtt_msgid_t              msgid;                  /* Valid only for WICED_MQTT_EVENT_TYPE_PUBLISHED, WICED_MQTT_EVENT_TYPE_PUBLISH_FAILED, WICED_MQTT_EVENT_TYPE_SUBCRIBED, WICED_MQTT_EVENT_TYPE_UNSUBSCRIBED events. Indicates message ID */
         wiced_mqtt_topic_msg_t          pub_recvd;              /* Valid only for WICED_MQTT_EVENT_TYPE_PUBLISH_MSG_RECEIVED event. Indicates the message received from Broker */
     }                                   data;                   /* Event data */
 } wiced_mqtt_event_info_t;
@@ -126,6 +127,41 @@ typedef struct wiced_mqtt_pkt_connect_s
     uint8_t*    password;                                       /* Password to connect to Broker */
 } wiced_mqtt_pkt_connect_t;
 
+/**
+ * Messages held by the session, by the step of the QoS 1/2 exchange they are waiting for
+ */
+typedef struct wiced_mqtt_session_statistics_s
+{
+    uint16_t    publish;                                        /* Sent QoS 1/2 PUBLISH waiting for PUBACK or PUBREC */
+    uint16_t    pubrel;                                         /* Sent PUBREL waiting for PUBCOMP */
+    uint16_t    pubrec;                                         /* Received QoS 2 PUBLISH waiting for PUBREL */
+    uint16_t    subscribe;                                      /* SUBSCRIBE waiting for SUBACK */
+    uint16_t    unsubscribe;                                    /* UNSUBSCRIBE waiting for UNSUBACK */
+    uint32_t    retransmissions;                                /* Messages resent, on a timeout or after reconnecting */
+    uint32_t    window_full;                                    /* Messages not sent, or QoS 2 messages received and left for the Broker to resend, because the in-flight window was full */
+} wiced_mqtt_session_statistics_t;
+
+/**
+ * Serial flash area holding messages published while the Broker is unreachable
+ */
+typedef struct wiced_mqtt_store_config_s
+{
+    uint32_t        sflash_address;                             /* Start of the area, aligned to a 4K sector */
+    uint32_t        sflash_size;                                /* Size of the area, at least two 4K sectors */
+    uint16_t        drain_rate;                                 /* Stored messages sent per second once reconnected, 0 for no limit */
+    wiced_bool_t    drop_oldest;                                /* When the area is full, erase the oldest messages instead of refusing new ones */
+} wiced_mqtt_store_config_t;
+
+typedef struct wiced_mqtt_store_statistics_s
+{
+    uint32_t    queued;                                         /* Messages waiting in flash */
+    uint32_t    stored;                                         /* Messages written to flash */
+    uint32_t    delivered;                                      /* Stored messages sent and acknowledged */
+    uint32_t    dropped;                                        /* Stored messages erased unsent because the area was full */
+    uint32_t    corrupted;                                      /* Damaged records skipped, left by a power loss while writing */
+    uint32_t    max_erase_count;                                /* Highest erase count of the sectors in the area */
+} wiced_mqtt_store_statistics_t;
+
 typedef struct wiced_mqtt_security_s
 {
     const char* ca_cert;                                        /* CA certificate, common between client and MQTT Broker */
@@ -142,6 +178,41 @@ typedef struct wiced_mqtt_security_s
  */
 typedef wiced_result_t (*wiced_mqtt_callback_t)( wiced_mqtt_object_t mqtt_object, wiced_mqtt_event_info_t *event );
 
+/** Call-back function supplying the payload of a streamed PUBLISH message
+ *
+ * Called from the MQTT thread each time a network packet is filled. The same offset
+ * may be read again when a QoS 1 or QoS 2 message is resent.
+ *
+ * @param[in]  arg              : Argument passed to wiced_mqtt_publish_stream()
+ * @param[in]  offset           : Offset of the first payload byte wanted
+ * @param[out] buffer           : Buffer to receive the payload bytes
+ * @param[in]  length           : Number of bytes to write to the buffer
+ *
+ * @return @ref wiced_result_t
+ */
+typedef wiced_result_t (*wiced_mqtt_payload_reader_t)( void *arg, uint32_t offset, uint8_t *buffer, uint16_t length );
+
+/** Call-back function for PUBLISH messages matching a subscription's topic filter
+ *
+ * Called from the MQTT thread, once for each matching subscription.
+ *
+ * @param[in] mqtt_obj          : Contains address of a memory location which is passed during MQTT init
+ * @param[in] message           : Message received from the Broker
+ * @param[in] arg               : Argument given with the subscription
+ */
+typedef void (*wiced_mqtt_message_callback_t)( wiced_mqtt_object_t mqtt_object, wiced_mqtt_topic_msg_t *message, void *arg );
+
+/**
+ * One topic filter of a SUBSCRIBE request
+ */
+typedef struct wiced_mqtt_subscription_s
+{
+    char*                           topic;                      /* Topic filter, may contain '+' and '#' wildcards */
+    uint8_t                         qos;                        /* QoS level to be used for receiving the message on the given topic */
+    wiced_mqtt_message_callback_t   callback;                   /* Called for messages matching the filter. NULL to receive them as WICED_MQTT_EVENT_TYPE_PUBLISH_MSG_RECEIVED events */
+    void*                           arg;                        /* Argument passed to the callback */
+} wiced_mqtt_subscription_t;
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
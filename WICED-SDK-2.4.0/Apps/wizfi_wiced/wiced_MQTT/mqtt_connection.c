@@ -43,6 +43,7 @@
 /******************************************************
  *               Static Function Declarations
  ******************************************************/
+static wiced_result_t mqtt_connection_send_frame( mqtt_frame_t *frame, wiced_result_t put_result, mqtt_connection_t *conn );
 
 /******************************************************
  *               Variable Definitions
@@ -157,6 +158,31 @@ wiced_result_t mqtt_connection_deinit( mqtt_connection_t *conn )
 /******************************************************
  *      Backend functions called from mqtt_queue
  ******************************************************/
+/* Sends the rest of a frame, or frees it if it could not be built.
+ * Once part of a frame is on the wire the stream cannot be resynchronised,
+ * so any failure after that drops the connection.
+ */
+static wiced_result_t mqtt_connection_send_frame( mqtt_frame_t *frame, wiced_result_t put_result, mqtt_connection_t *conn )
+{
+    wiced_result_t ret = put_result;
+
+    if ( ret == WICED_SUCCESS )
+    {
+        ret = mqtt_frame_send( frame, &conn->socket );
+    }
+    else
+    {
+        mqtt_frame_delete( frame );
+    }
+
+    if ( ( ret != WICED_SUCCESS ) && ( frame->packets_sent != 0 ) )
+    {
+        WPRINT_LIB_ERROR( ("[MQTT] Frame cut short after %u packets, disconnecting.\n ", (unsigned int) frame->packets_sent ) );
+        mqtt_network_disconnect( &conn->socket );
+    }
+    return ret;
+}
+
 wiced_result_t mqtt_backend_put_connect( const mqtt_connect_arg_t *args, mqtt_connection_t *conn )
 {
     wiced_result_t ret;
@@ -178,19 +204,19 @@ wiced_result_t mqtt_backend_put_connect( const mqtt_connect_arg_t *args, mqtt_co
     }
 
     /* Send Protocol Header */
-    ret = mqtt_frame_create( MQTT_CONNECTION_FRAME_MAX, &frame, &conn->socket );
+    ret = mqtt_frame_create( mqtt_frame_length( MQTT_PACKET_TYPE_CONNECT, &final_args ), &frame, &conn->socket );
     if ( ret != WICED_SUCCESS )
     {
         return ret;
     }
-    mqtt_frame_put_connect( &frame, &final_args );
-    return mqtt_frame_send( &frame, &conn->socket );
+    ret = mqtt_frame_put_connect( &frame, &final_args );
+    return mqtt_connection_send_frame( &frame, ret, conn );
 }
 
 wiced_result_t mqtt_backend_get_connack( mqtt_connack_arg_t *args, mqtt_connection_t *conn )
 {
-    wiced_result_t ret = WICED_SUCCESS;
-    UNUSED_PARAMETER(args);
+    wiced_result_t ret;
+    ret = mqtt_manager( MQTT_EVENT_RECV_CONNACK, args, conn );
     if ( ret == WICED_SUCCESS )
     {
         /* Publish is an async method (we don't get an OK), so we simulate the OK after sending it */
@@ -214,13 +240,13 @@ wiced_result_t mqtt_backend_put_publish( const mqtt_publish_arg_t *args, mqtt_co
     mqtt_publish_arg_t final_args = *args;
 
     /* Send Protocol Header */
-    ret = mqtt_frame_create( MQTT_CONNECTION_FRAME_MAX, &frame, &conn->socket );
+    ret = mqtt_frame_create( mqtt_frame_length( MQTT_PACKET_TYPE_PUBLISH, &final_args ), &frame, &conn->socket );
     if ( ret != WICED_SUCCESS )
     {
         return ret;
     }
-    mqtt_frame_put_publish( &frame, &final_args );
-    return mqtt_frame_send( &frame, &conn->socket );
+    ret = mqtt_frame_put_publish( &frame, &final_args );
+    return mqtt_connection_send_frame( &frame, ret, conn );
 }
 
 wiced_result_t mqtt_backend_get_publish( mqtt_publish_arg_t *args, mqtt_connection_t *conn )
@@ -230,14 +256,15 @@ wiced_result_t mqtt_backend_get_publish( mqtt_publish_arg_t *args, mqtt_connecti
     ret = mqtt_manager( MQTT_EVENT_RECV_PUBLISH, args, conn );
     if ( ( ret == WICED_SUCCESS ) && ( args->data != NULL ) )
     {
-        /* Publish is an async method (we don't get an OK), so we simulate the OK after sending it */
-        if ( conn->callbacks != NULL )
+        event.type = WICED_MQTT_EVENT_TYPE_PUBLISH_MSG_RECEIVED;
+        event.data.pub_recvd.topic = args->topic.str;
+        event.data.pub_recvd.topic_len = args->topic.len;
+        event.data.pub_recvd.data = args->data;
+        event.data.pub_recvd.data_len = args->data_len;
+
+        /* Messages no subscription callback takes go to the connection callback */
+        if ( ( mqtt_topic_tree_dispatch( &conn->topics, (void*) conn, &event.data.pub_recvd ) == 0 ) && ( conn->callbacks != NULL ) )
         {
-            event.type = WICED_MQTT_EVENT_TYPE_PUBLISH_MSG_RECEIVED;
-            event.data.pub_recvd.topic = args->topic.str;
-            event.data.pub_recvd.topic_len = args->topic.len;
-            event.data.pub_recvd.data = args->data;
-            event.data.pub_recvd.data_len = args->data_len;
             conn->callbacks( (void*) conn, &event );
         }
     }
@@ -250,13 +277,13 @@ wiced_result_t mqtt_backend_put_puback( const mqtt_puback_arg_t *args, mqtt_conn
     mqtt_frame_t frame;
 
     /* Send Protocol Header */
-    ret = mqtt_frame_create( MQTT_CONNECTION_FRAME_MAX, &frame, &conn->socket );
+    ret = mqtt_frame_create( mqtt_frame_length( MQTT_PACKET_TYPE_PUBACK, args ), &frame, &conn->socket );
     if ( ret != WICED_SUCCESS )
     {
         return ret;
     }
-    mqtt_frame_put_puback( &frame, args );
-    return mqtt_frame_send( &frame, &conn->socket );
+    ret = mqtt_frame_put_puback( &frame, args );
+    return mqtt_connection_send_frame( &frame, ret, conn );
 }
 
 wiced_result_t mqtt_backend_get_puback( mqtt_puback_arg_t *args, mqtt_connection_t *conn )
@@ -282,13 +309,13 @@ wiced_result_t mqtt_backend_put_pubrec( const mqtt_pubrec_arg_t *args, mqtt_conn
     mqtt_frame_t frame;
 
     /* Send Protocol Header */
-    ret = mqtt_frame_create( MQTT_CONNECTION_FRAME_MAX, &frame, &conn->socket );
+    ret = mqtt_frame_create( mqtt_frame_length( MQTT_PACKET_TYPE_PUBREC, args ), &frame, &conn->socket );
     if ( ret != WICED_SUCCESS )
     {
         return ret;
     }
-    mqtt_frame_put_pubrec( &frame, args );
-    return mqtt_frame_send( &frame, &conn->socket );
+    ret = mqtt_frame_put_pubrec( &frame, args );
+    return mqtt_connection_send_frame( &frame, ret, conn );
 }
 
 wiced_result_t mqtt_backend_get_pubrec( mqtt_pubrec_arg_t *args, mqtt_connection_t *conn )
@@ -316,13 +343,13 @@ wiced_result_t mqtt_backend_put_pubrel( const mqtt_pubrel_arg_t *args, mqtt_conn
     mqtt_frame_t frame;
 
     /* Send Protocol Header */
-    ret = mqtt_frame_create( MQTT_CONNECTION_FRAME_MAX, &frame, &conn->socket );
+    ret = mqtt_frame_create( mqtt_frame_length( MQTT_PACKET_TYPE_PUBREL, args ), &frame, &conn->socket );
     if ( ret != WICED_SUCCESS )
     {
         return ret;
     }
-    mqtt_frame_put_pubrel( &frame, args );
-    return mqtt_frame_send( &frame, &conn->socket );
+    ret = mqtt_frame_put_pubrel( &frame, args );
+    return mqtt_connection_send_frame( &frame, ret, conn );
 }
 
 wiced_result_t mqtt_backend_get_pubrel( mqtt_pubrel_arg_t *args, mqtt_connection_t *conn )
@@ -349,13 +376,13 @@ wiced_result_t mqtt_backend_put_pubcomp( const mqtt_pubcomp_arg_t *args, mqtt_co
     mqtt_frame_t frame;
 
     /* Send Protocol Header */
-    ret = mqtt_frame_create( MQTT_CONNECTION_FRAME_MAX, &frame, &conn->socket );
+    ret = mqtt_frame_create( mqtt_frame_length( MQTT_PACKET_TYPE_PUBCOMP, args ), &frame, &conn->socket );
     if ( ret != WICED_SUCCESS )
     {
         return ret;
     }
-    mqtt_frame_put_pubcomp( &frame, args );
-    return mqtt_frame_send( &frame, &conn->socket );
+    ret = mqtt_frame_put_pubcomp( &frame, args );
+    return mqtt_connection_send_frame( &frame, ret, conn );
 }
 
 wiced_result_t mqtt_backend_get_pubcomp( mqtt_pubcomp_arg_t *args, mqtt_connection_t *conn )
@@ -384,13 +411,13 @@ wiced_result_t mqtt_backend_put_subscribe( const mqtt_subscribe_arg_t *args, mqt
     mqtt_subscribe_arg_t final_args = *args;
 
     /* Send Protocol Header */
-    ret = mqtt_frame_create( MQTT_CONNECTION_FRAME_MAX, &frame, &conn->socket );
+    ret = mqtt_frame_create( mqtt_frame_length( MQTT_PACKET_TYPE_SUBSCRIBE, &final_args ), &frame, &conn->socket );
     if ( ret != WICED_SUCCESS )
     {
         return ret;
     }
-    mqtt_frame_put_subscribe( &frame, &final_args );
-    return mqtt_frame_send( &frame, &conn->socket );
+    ret = mqtt_frame_put_subscribe( &frame, &final_args );
+    return mqtt_connection_send_frame( &frame, ret, conn );
 }
 
 wiced_result_t mqtt_backend_get_suback( wiced_mqtt_suback_arg_t *args, mqtt_connection_t *conn )
@@ -424,13 +451,13 @@ wiced_result_t mqtt_backend_put_unsubscribe( const mqtt_unsubscribe_arg_t *args,
     // final_args.packet_id = conn->packet_id++;
 
     /* Send Protocol Header */
-    ret = mqtt_frame_create( MQTT_CONNECTION_FRAME_MAX, &frame, &conn->socket );
+    ret = mqtt_frame_create( mqtt_frame_length( MQTT_PACKET_TYPE_UNSUBSCRIBE, &final_args ), &frame, &conn->socket );
     if ( ret != WICED_SUCCESS )
     {
         return ret;
     }
-    mqtt_frame_put_unsubscribe( &frame, &final_args );
-    return mqtt_frame_send( &frame, &conn->socket );
+    ret = mqtt_frame_put_unsubscribe( &frame, &final_args );
+    return mqtt_connection_send_frame( &frame, ret, conn );
 }
 
 wiced_result_t mqtt_backend_get_unsuback( mqtt_unsuback_arg_t *args, mqtt_connection_t *conn )
@@ -458,13 +485,13 @@ wiced_result_t mqtt_backend_put_disconnect( mqtt_connection_t *conn )
     wiced_result_t ret;
     mqtt_frame_t frame;
 
-    ret = mqtt_frame_create( MQTT_CONNECTION_FRAME_MAX, &frame, &conn->socket );
+    ret = mqtt_frame_create( mqtt_frame_length( MQTT_PACKET_TYPE_DISCONNECT, NULL ), &frame, &conn->socket );
     if ( ret != WICED_SUCCESS )
     {
         return ret;
     }
-    mqtt_frame_put_disconnect( &frame );
-    return mqtt_frame_send( &frame, &conn->socket );
+    ret = mqtt_frame_put_disconnect( &frame );
+    return mqtt_connection_send_frame( &frame, ret, conn );
 }
 
 wiced_result_t mqtt_backend_connection_close( mqtt_connection_t *conn )
@@ -491,13 +518,13 @@ wiced_result_t mqtt_backend_put_pingreq( mqtt_connection_t *conn )
     wiced_result_t ret;
     mqtt_frame_t frame;
 
-    ret = mqtt_frame_create( MQTT_CONNECTION_FRAME_MAX, &frame, &conn->socket );
+    ret = mqtt_frame_create( mqtt_frame_length( MQTT_PACKET_TYPE_PINGREQ, NULL ), &frame, &conn->socket );
     if ( ret != WICED_SUCCESS )
     {
         return ret;
     }
-    mqtt_frame_put_pingreq( &frame );
-    return mqtt_frame_send( &frame, &conn->socket );
+    ret = mqtt_frame_put_pingreq( &frame );
+    return mqtt_connection_send_frame( &frame, ret, conn );
 }
 
 wiced_result_t mqtt_backend_get_pingres( mqtt_connection_t *conn )
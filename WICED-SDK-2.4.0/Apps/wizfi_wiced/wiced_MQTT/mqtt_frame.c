@@ -204,6 +204,8 @@
 #define MQTT_PACKET_CONNECT_STR_VER3         "MQIsdp"
 #define MQTT_PACKET_CONNECT_STR_VER4         "MQTT"
 
+#define MQTT_FRAME_FIXED_HEADER_MAX          (5)     /* Type octet and at most four remaining length octets */
+
 /******************************************************
  *                   Enumerations
  ******************************************************/
@@ -219,6 +221,13 @@
 /******************************************************
  *               Static Function Declarations
  ******************************************************/
+static uint32_t       mqtt_frame_remaining_length( mqtt_frame_type_t type, const void *args );
+static wiced_result_t mqtt_frame_next_packet( mqtt_frame_t *frame, uint32_t length );
+static wiced_result_t mqtt_frame_reserve( mqtt_frame_t *frame, uint16_t length );
+static wiced_result_t mqtt_frame_put_data( mqtt_frame_t *frame, const uint8_t *data, wiced_mqtt_payload_reader_t reader, void *reader_arg, uint32_t length );
+static wiced_result_t mqtt_frame_put_string( mqtt_frame_t *frame, const mqtt_string_t *string );
+static uint8_t        mqtt_frame_subscribe_filter( const mqtt_subscribe_arg_t *args, uint8_t index, mqtt_string_t *filter, mqtt_qos_t *qos );
+static uint8_t        mqtt_frame_unsubscribe_filter( const mqtt_unsubscribe_arg_t *args, uint8_t index, mqtt_string_t *filter );
 
 /******************************************************
  *               Variable Definitions
@@ -353,20 +362,42 @@ wiced_result_t  mqtt_frame_recv( wiced_mqtt_buffer_t *buffer, void *p_user, uint
     return result;
 }
 
-wiced_result_t  mqtt_frame_create( uint16_t max_size, mqtt_frame_t *frame, mqtt_socket_t *socket )
+uint32_t mqtt_frame_length( mqtt_frame_type_t type, const void *args )
+{
+    uint32_t remaining_length = mqtt_frame_remaining_length( type, args );
+    uint32_t length           = 1 + remaining_length;
+
+    /* Add the octets used to encode the remaining length */
+    do
+    {
+        length++;
+        remaining_length /= 128;
+    } while ( remaining_length > 0 );
+    return length;
+}
+
+wiced_result_t  mqtt_frame_create( uint32_t size, mqtt_frame_t *frame, mqtt_socket_t *socket )
 {
     wiced_result_t ret;
-    ret = mqtt_network_create_buffer( &frame->buffer, max_size, socket );
+
+    /* Frames are built in pool packets; anything larger than one packet is sent in pieces as it is written */
+    ret = mqtt_network_create_buffer( &frame->buffer, (uint16_t) MIN( size, 0xFFFF ), socket );
     if ( ret == WICED_SUCCESS )
     {
         frame->size     = 0;
         frame->start    = frame->buffer.data;
+        frame->socket   = socket;
+        frame->packets_sent = 0;
     }
     return ret;
 }
 
 wiced_result_t  mqtt_frame_delete( mqtt_frame_t *frame )
 {
+    if ( frame->buffer.packet == NULL )
+    {
+        return WICED_SUCCESS;
+    }
     return mqtt_network_delete_buffer( &frame->buffer );
 }
 
@@ -378,24 +409,173 @@ wiced_result_t  mqtt_frame_send( mqtt_frame_t *frame, mqtt_socket_t *socket )
 /******************************************************
  *               Connect frame
  ******************************************************/
-wiced_result_t mqtt_frame_put_connect( mqtt_frame_t *frame, const mqtt_connect_arg_t *args )
+static uint32_t mqtt_frame_remaining_length( mqtt_frame_type_t type, const void *args )
 {
-    uint32_t size = (uint32_t) (                       args->client_id.len    + sizeof( args->client_id.len    )     ) + /* Client ID */
-                    (uint32_t) ( args->will_flag     ? args->will_message.len + sizeof( args->will_message.len ) : 0 ) + /* will message if sent */
-                    (uint32_t) ( args->will_flag     ? args->will_topic.len   + sizeof( args->will_topic.len   ) : 0 ) + /* will topic if sent */
-                    (uint32_t) ( args->username_flag ? args->username.len     + sizeof( args->username.len     ) : 0 ) + /* username if sent */
-                    (uint32_t) ( args->password_flag ? args->password.len     + sizeof( args->password.len     ) : 0 );  /* password if sent */
-
-    /* MQTT string + protocol level + connect flags + Keep alive */
-    /* variable depending on MQTT or MQIsdp */
-    if ( args->mqtt_version == WICED_MQTT_PROTOCOL_VER4 )
+    switch ( type )
     {
-        size = size + (uint32_t) MQTT_CONNECT_PKT_VARIABLE_HEADER_LEN_VER4;
+        case MQTT_PACKET_TYPE_CONNECT:
+        {
+            const mqtt_connect_arg_t *connect_args = (const mqtt_connect_arg_t *) args;
+            uint32_t size = (uint32_t) (                               connect_args->client_id.len    + sizeof( connect_args->client_id.len    )     ) + /* Client ID */
+                            (uint32_t) ( connect_args->will_flag     ? connect_args->will_message.len + sizeof( connect_args->will_message.len ) : 0 ) + /* will message if sent */
+                            (uint32_t) ( connect_args->will_flag     ? connect_args->will_topic.len   + sizeof( connect_args->will_topic.len   ) : 0 ) + /* will topic if sent */
+                            (uint32_t) ( connect_args->username_flag ? connect_args->username.len     + sizeof( connect_args->username.len     ) : 0 ) + /* username if sent */
+                            (uint32_t) ( connect_args->password_flag ? connect_args->password.len     + sizeof( connect_args->password.len     ) : 0 );  /* password if sent */
+
+            /* MQTT string + protocol level + connect flags + Keep alive */
+            /* variable depending on MQTT or MQIsdp */
+            if ( connect_args->mqtt_version == WICED_MQTT_PROTOCOL_VER4 )
+            {
+                return size + (uint32_t) MQTT_CONNECT_PKT_VARIABLE_HEADER_LEN_VER4;
+            }
+            return size + (uint32_t) MQTT_CONNECT_PKT_VARIABLE_HEADER_LEN_VER3;
+        }
+        case MQTT_PACKET_TYPE_PUBLISH:
+        {
+            const mqtt_publish_arg_t *publish_args = (const mqtt_publish_arg_t *) args;
+            return ( uint32_t ) ( publish_args->qos == MQTT_QOS_DELIVER_AT_MOST_ONCE ? 0 : 2)   /* Packet identifier  */
+                   + ( uint32_t ) ( publish_args->topic.len + sizeof(publish_args->topic.len))  /* will topic if sent */
+                   + ( uint32_t ) publish_args->data_len;                                       /* size of message    */
+        }
+        case MQTT_PACKET_TYPE_SUBSCRIBE:
+        {
+            const mqtt_subscribe_arg_t *subscribe_args = (const mqtt_subscribe_arg_t *) args;
+            mqtt_string_t filter;
+            mqtt_qos_t    qos;
+            uint8_t       count = mqtt_frame_subscribe_filter( subscribe_args, 0, &filter, &qos );
+            uint8_t       index;
+            uint32_t      size = 2;                                                   /* Packet identifier  */
+
+            for ( index = 0; index < count; index++ )
+            {
+                mqtt_frame_subscribe_filter( subscribe_args, index, &filter, &qos );
+                size += (uint32_t) LENGTH_OF_STRING( filter ) + 1;                     /* Topic filter + QOS */
+            }
+            return size;
+        }
+        case MQTT_PACKET_TYPE_UNSUBSCRIBE:
+        {
+            const mqtt_unsubscribe_arg_t *unsubscribe_args = (const mqtt_unsubscribe_arg_t *) args;
+            mqtt_string_t filter;
+            uint8_t       count = mqtt_frame_unsubscribe_filter( unsubscribe_args, 0, &filter );
+            uint8_t       index;
+            uint32_t      size = 2;                                                   /* Packet identifier  */
+
+            for ( index = 0; index < count; index++ )
+            {
+                mqtt_frame_unsubscribe_filter( unsubscribe_args, index, &filter );
+                size += (uint32_t) LENGTH_OF_STRING( filter );                         /* Topic filter       */
+            }
+            return size;
+        }
+        case MQTT_PACKET_TYPE_PUBACK:
+        case MQTT_PACKET_TYPE_PUBREC:
+        case MQTT_PACKET_TYPE_PUBREL:
+        case MQTT_PACKET_TYPE_PUBCOMP:
+            return 2;   /* Packet identifier */
+
+        case MQTT_PACKET_TYPE_PINGREQ:
+        case MQTT_PACKET_TYPE_DISCONNECT:
+        default:
+            return 0;
     }
-    else
+}
+
+/* Sends the packet filled so far and continues the frame in a new one */
+static wiced_result_t mqtt_frame_next_packet( mqtt_frame_t *frame, uint32_t length )
+{
+    wiced_result_t ret;
+
+    /* The packet belongs to the network stack once sent, and is freed by it if sending fails */
+    ret = mqtt_network_send_buffer( &frame->buffer, frame->socket );
+    frame->buffer.packet = NULL;
+    if ( ret != WICED_SUCCESS )
+    {
+        return ret;
+    }
+    frame->packets_sent++;
+    return mqtt_network_create_buffer( &frame->buffer, (uint16_t) MIN( length, 0xFFFF ), frame->socket );
+}
+
+/* Makes sure the next length octets can be written contiguously */
+static wiced_result_t mqtt_frame_reserve( mqtt_frame_t *frame, uint16_t length )
+{
+    if ( frame->buffer.data + length <= frame->buffer.end )
     {
-        size = size + (uint32_t) MQTT_CONNECT_PKT_VARIABLE_HEADER_LEN_VER3;
+        return WICED_SUCCESS;
     }
+    WICED_VERIFY( mqtt_frame_next_packet( frame, length ) );
+    return ( frame->buffer.data + length <= frame->buffer.end ) ? WICED_SUCCESS : WICED_ERROR;
+}
+
+/* Copies data, or reads it from the reader, into as many packets as it takes */
+static wiced_result_t mqtt_frame_put_data( mqtt_frame_t *frame, const uint8_t *data, wiced_mqtt_payload_reader_t reader, void *reader_arg, uint32_t length )
+{
+    uint32_t offset = 0;
+
+    while ( offset < length )
+    {
+        uint16_t chunk;
+
+        if ( frame->buffer.data >= frame->buffer.end )
+        {
+            WICED_VERIFY( mqtt_frame_next_packet( frame, length - offset ) );
+        }
+        chunk = (uint16_t) MIN( length - offset, (uint32_t) ( frame->buffer.end - frame->buffer.data ) );
+        if ( reader != NULL )
+        {
+            WICED_VERIFY( reader( reader_arg, offset, frame->buffer.data, chunk ) );
+        }
+        else
+        {
+            memcpy( frame->buffer.data, data + offset, chunk );
+        }
+        frame->buffer.data += chunk;
+        offset += chunk;
+    }
+    return WICED_SUCCESS;
+}
+
+static wiced_result_t mqtt_frame_put_string( mqtt_frame_t *frame, const mqtt_string_t *string )
+{
+    WICED_VERIFY( mqtt_frame_reserve( frame, 2 ) );
+    MQTT_BUFFER_PUT_SHORT( &frame->buffer, string->len );
+    return mqtt_frame_put_data( frame, string->str, NULL, NULL, string->len );
+}
+
+/* Returns the number of topic filters in the request and the filter at the given index */
+static uint8_t mqtt_frame_subscribe_filter( const mqtt_subscribe_arg_t *args, uint8_t index, mqtt_string_t *filter, mqtt_qos_t *qos )
+{
+    if ( args->subscriptions == NULL )
+    {
+        *filter = args->topic_filter;
+        *qos    = args->qos;
+        return 1;
+    }
+    filter->str = (uint8_t*) args->subscriptions[ index ].topic;
+    filter->len = (uint16_t) strlen( args->subscriptions[ index ].topic );
+    *qos        = (mqtt_qos_t) args->subscriptions[ index ].qos;
+    return args->count;
+}
+
+static uint8_t mqtt_frame_unsubscribe_filter( const mqtt_unsubscribe_arg_t *args, uint8_t index, mqtt_string_t *filter )
+{
+    if ( args->topics == NULL )
+    {
+        *filter = args->topic_filter;
+        return 1;
+    }
+    filter->str = (uint8_t*) args->topics[ index ];
+    filter->len = (uint16_t) strlen( args->topics[ index ] );
+    return args->count;
+}
+
+wiced_result_t mqtt_frame_put_connect( mqtt_frame_t *frame, const mqtt_connect_arg_t *args )
+{
+    uint32_t size = mqtt_frame_remaining_length( MQTT_PACKET_TYPE_CONNECT, args );
+
+    /* Fixed header, protocol name and level, connect flags and keep alive */
+    WICED_VERIFY( mqtt_frame_reserve( frame, MQTT_FRAME_FIXED_HEADER_MAX + MQTT_CONNECT_PKT_VARIABLE_HEADER_LEN_VER3 ) );
 
     /* A long value carrying string MQTT */MQTT_BUFFER_PUT_4BIT( &frame->buffer, 0, 0, 0 ); /* Reserved */
     MQTT_BUFFER_PUT_4BIT( &frame->buffer, MQTT_PACKET_TYPE_CONNECT, 4, 1 );
@@ -418,22 +598,22 @@ wiced_result_t mqtt_frame_put_connect( mqtt_frame_t *frame, const mqtt_connect_a
     MQTT_BUFFER_PUT_BIT( &frame->buffer, args->username_flag, 6, 0 );
     MQTT_BUFFER_PUT_BIT( &frame->buffer, args->password_flag, 7, 1 );
     MQTT_BUFFER_PUT_SHORT( &frame->buffer, 0 ); /* Keep alive for now */
-    MQTT_BUFFER_PUT_STRING( &frame->buffer, args->client_id.str, args->client_id.len );
+    WICED_VERIFY( mqtt_frame_put_string( frame, &args->client_id ) );
     if ( args->will_flag )
     {
-        MQTT_BUFFER_PUT_STRING( &frame->buffer, args->will_topic.str, args->will_topic.len );
+        WICED_VERIFY( mqtt_frame_put_string( frame, &args->will_topic ) );
     }
     if ( args->will_flag )
     {
-        MQTT_BUFFER_PUT_STRING( &frame->buffer, args->will_message.str, args->will_message.len );
+        WICED_VERIFY( mqtt_frame_put_string( frame, &args->will_message ) );
     }
     if ( args->username_flag )
     {
-        MQTT_BUFFER_PUT_STRING( &frame->buffer, args->username.str, args->username.len );
+        WICED_VERIFY( mqtt_frame_put_string( frame, &args->username ) );
     }
     if ( args->password_flag )
     {
-        MQTT_BUFFER_PUT_STRING( &frame->buffer, args->password.str, args->password.len );
+        WICED_VERIFY( mqtt_frame_put_string( frame, &args->password ) );
     }
     return WICED_SUCCESS;
 }
@@ -458,24 +638,29 @@ wiced_result_t mqtt_frame_get_connack( mqtt_frame_t *frame, mqtt_connack_arg_t *
 
 wiced_result_t mqtt_frame_put_publish( mqtt_frame_t *frame, const mqtt_publish_arg_t *args )
 {
-    uint32_t    size = ( uint32_t ) ( args->qos == MQTT_QOS_DELIVER_AT_MOST_ONCE ? 0 : 2)   /* Packet identifier  */
-                       + ( uint32_t ) ( args->topic.len + sizeof(args->topic.len))          /* will topic if sent */
-                       + ( uint32_t ) args->data_len;                                       /* size of message    */
+    uint32_t    size = mqtt_frame_remaining_length( MQTT_PACKET_TYPE_PUBLISH, args );
+
+    if ( size > MQTT_FRAME_MAXIMUM_REMAINING_LENGTH )
+    {
+        return WICED_BADARG;
+    }
 
     /* A long value carrying string MQTT */
+    WICED_VERIFY( mqtt_frame_reserve( frame, MQTT_FRAME_FIXED_HEADER_MAX ) );
     MQTT_BUFFER_PUT_BIT( &frame->buffer, args->retain, 0, 0 );
     MQTT_BUFFER_PUT_2BIT( &frame->buffer, args->qos, 1, 0 );
     MQTT_BUFFER_PUT_BIT( &frame->buffer, args->dup, 3, 0 );
     MQTT_BUFFER_PUT_4BIT( &frame->buffer, MQTT_PACKET_TYPE_PUBLISH, 4, 1 );
     MQTT_BUFFER_PUT_VARIABLE_LENGTH( &frame->buffer, size, frame->size );
-    MQTT_BUFFER_PUT_STRING( &frame->buffer, args->topic.str, args->topic.len );
+    WICED_VERIFY( mqtt_frame_put_string( frame, &args->topic ) );
     if ( args->qos != MQTT_QOS_DELIVER_AT_MOST_ONCE )
     {
+        WICED_VERIFY( mqtt_frame_reserve( frame, 2 ) );
         MQTT_BUFFER_PUT_SHORT( &frame->buffer, args->packet_id );
     }
-    memcpy( frame->buffer.data, args->data, args->data_len );
-    frame->buffer.data += args->data_len;
-    return WICED_SUCCESS;
+
+    /* The payload goes straight into the packets, so it is never staged as a whole */
+    return mqtt_frame_put_data( frame, args->data, args->reader, args->reader_arg, args->data_len );
 }
 
 wiced_result_t mqtt_frame_get_publish( mqtt_frame_t *frame, mqtt_publish_arg_t *args )
@@ -500,6 +685,8 @@ wiced_result_t mqtt_frame_get_publish( mqtt_frame_t *frame, mqtt_publish_arg_t *
     }
     args->data = frame->buffer.data;
     args->data_len = size - ( args->qos != MQTT_QOS_DELIVER_AT_MOST_ONCE ? 2 : 0) - args->topic.len - 2;
+    args->reader = NULL;
+    args->reader_arg = NULL;
     return WICED_SUCCESS;
 }
 
@@ -613,25 +800,34 @@ wiced_result_t mqtt_frame_get_pubcomp( mqtt_frame_t *frame, mqtt_pubcomp_arg_t *
 
 wiced_result_t mqtt_frame_put_subscribe( mqtt_frame_t *frame, const mqtt_subscribe_arg_t *args )
 {
-    uint32_t    size = ( uint32_t ) 2                                                            /* Packet identifier  */
-                       + ( uint32_t ) ( args->topic_filter.len + sizeof(args->topic_filter.len)) /* will topic if sent */
-                       + ( uint32_t ) 1;                                                         /* QOS                */
+    uint32_t      size = mqtt_frame_remaining_length( MQTT_PACKET_TYPE_SUBSCRIBE, args );
+    mqtt_string_t filter;
+    mqtt_qos_t    qos;
+    uint8_t       count = mqtt_frame_subscribe_filter( args, 0, &filter, &qos );
+    uint8_t       index;
 
     /* A long value carrying string MQTT */
+    WICED_VERIFY( mqtt_frame_reserve( frame, MQTT_FRAME_FIXED_HEADER_MAX + 2 ) );
     MQTT_BUFFER_PUT_4BIT( &frame->buffer, 0x2, 0, 0 );    /* Reserved */
     MQTT_BUFFER_PUT_4BIT( &frame->buffer, MQTT_PACKET_TYPE_SUBSCRIBE, 4, 1 );
     MQTT_BUFFER_PUT_VARIABLE_LENGTH( &frame->buffer, size, frame->size );
     MQTT_BUFFER_PUT_SHORT( &frame->buffer, args->packet_id );
-    MQTT_BUFFER_PUT_STRING( &frame->buffer, args->topic_filter.str, args->topic_filter.len );
-    MQTT_BUFFER_PUT_OCTET( &frame->buffer, args->qos );
+    for ( index = 0; index < count; index++ )
+    {
+        mqtt_frame_subscribe_filter( args, index, &filter, &qos );
+        WICED_VERIFY( mqtt_frame_put_string( frame, &filter ) );
+        WICED_VERIFY( mqtt_frame_reserve( frame, 1 ) );
+        MQTT_BUFFER_PUT_OCTET( &frame->buffer, qos );
+    }
     return WICED_SUCCESS;
 }
 
 
 wiced_result_t mqtt_frame_get_suback( mqtt_frame_t *frame, wiced_mqtt_suback_arg_t *args )
 {
-    uint8_t type;
-    uint8_t size;
+    uint8_t  type;
+    uint32_t size;
+    uint8_t  return_code;
 
     (void)size;
     (void)type;
@@ -639,24 +835,41 @@ wiced_result_t mqtt_frame_get_suback( mqtt_frame_t *frame, wiced_mqtt_suback_arg
     MQTT_BUFFER_GET_OCTET( &frame->buffer, type );    /* Type-Reserved */
     type = ( type & 0xF0 ) >> 4;
     wiced_assert("[MQTT] CONNACT type mismatch.", type == MQTT_PACKET_TYPE_SUBACK );
-    MQTT_BUFFER_GET_OCTET( &frame->buffer, size );
-    wiced_assert("[MQTT] CONNACT size mismatch.", size == 3 );
+    MQTT_BUFFER_GET_VARIABLE_LENGTH( &frame->buffer, size );
+    wiced_assert("[MQTT] CONNACT size mismatch.", size >= 3 );
     MQTT_BUFFER_GET_SHORT( &frame->buffer, args->packet_id );
     MQTT_BUFFER_GET_OCTET( &frame->buffer, args->return_code );
+
+    /* One return code per topic filter; report a failure if any filter was refused */
+    for ( ; size > 3; size-- )
+    {
+        MQTT_BUFFER_GET_OCTET( &frame->buffer, return_code );
+        if ( return_code == MQTT_QOS_DELIVER_FAILURE )
+        {
+            args->return_code = (mqtt_return_code_t) return_code;
+        }
+    }
     return WICED_SUCCESS;
 }
 
 wiced_result_t mqtt_frame_put_unsubscribe( mqtt_frame_t *frame, const mqtt_unsubscribe_arg_t *args )
 {
-    uint32_t    size = ( uint32_t ) 2                                                            /* Packet identifier  */
-                       + ( uint32_t ) ( args->topic_filter.len + sizeof(args->topic_filter.len)); /* will topic if sent */
+    uint32_t      size = mqtt_frame_remaining_length( MQTT_PACKET_TYPE_UNSUBSCRIBE, args );
+    mqtt_string_t filter;
+    uint8_t       count = mqtt_frame_unsubscribe_filter( args, 0, &filter );
+    uint8_t       index;
 
     /* A long value carrying string MQTT */
+    WICED_VERIFY( mqtt_frame_reserve( frame, MQTT_FRAME_FIXED_HEADER_MAX + 2 ) );
     MQTT_BUFFER_PUT_4BIT( &frame->buffer, 0x2, 0, 0 );    /* Reserved */
     MQTT_BUFFER_PUT_4BIT( &frame->buffer, MQTT_PACKET_TYPE_UNSUBSCRIBE, 4, 1 );
     MQTT_BUFFER_PUT_VARIABLE_LENGTH( &frame->buffer, size, frame->size );
     MQTT_BUFFER_PUT_SHORT( &frame->buffer, args->packet_id );
-    MQTT_BUFFER_PUT_STRING( &frame->buffer, args->topic_filter.str, args->topic_filter.len );
+    for ( index = 0; index < count; index++ )
+    {
+        mqtt_frame_unsubscribe_filter( args, index, &filter );
+        WICED_VERIFY( mqtt_frame_put_string( frame, &filter ) );
+    }
     return WICED_SUCCESS;
 }
 
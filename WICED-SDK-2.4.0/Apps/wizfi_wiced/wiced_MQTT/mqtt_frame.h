@@ -29,6 +29,8 @@ extern "C" {
 /******************************************************
  *                    Constants
  ******************************************************/
+#define MQTT_FRAME_MAXIMUM_REMAINING_LENGTH     (268435455)     /* Largest value the four octet remaining length can hold */
+
 #define MQTT_FRAME_CLASS_CONNECTION     (10)
 #define MQTT_FRAME_CLASS_CHANNEL        (20)
 #define MQTT_FRAME_CLASS_EXCHANGE       (40)
@@ -156,6 +158,8 @@ typedef struct mqtt_frame_s
     uint16_t                size;
     uint8_t                *start;
     wiced_mqtt_buffer_t     buffer;
+    mqtt_socket_t          *socket;     /* Used to send a full packet when a frame spans several */
+    uint16_t                packets_sent;   /* Packets of this frame already handed to the network stack */
 } mqtt_frame_t;
 
 /******************************************************
@@ -203,6 +207,8 @@ typedef struct mqtt_publish_arg_s
     mqtt_string_t               topic;
     uint8_t                    *data;
     uint32_t                    data_len;
+    wiced_mqtt_payload_reader_t reader;         /* When not NULL the payload is read from here instead of data */
+    void                       *reader_arg;
 } mqtt_publish_arg_t;
 
 typedef struct mqtt_subscribe_arg_s
@@ -210,12 +216,16 @@ typedef struct mqtt_subscribe_arg_s
     uint16_t                    packet_id;
     mqtt_string_t               topic_filter;
     mqtt_qos_t                  qos;
+    const wiced_mqtt_subscription_t *subscriptions; /* When not NULL the filters are taken from here instead of topic_filter and qos */
+    uint8_t                     count;
 } mqtt_subscribe_arg_t;
 
 typedef struct mqtt_unsubscribe_arg_s
 {
     uint16_t                    packet_id;
     mqtt_string_t               topic_filter;
+    char * const               *topics;         /* When not NULL the filters are taken from here instead of topic_filter */
+    uint8_t                     count;
 } mqtt_unsubscribe_arg_t;
 
 typedef struct wiced_mqtt_suback_arg_s
@@ -258,7 +268,8 @@ typedef mqtt_unsuback_arg_t mqtt_pubcomp_arg_t;
  *               Function Definitions
  ******************************************************/
 
-wiced_result_t  mqtt_frame_create( uint16_t max_size, mqtt_frame_t *frame, mqtt_socket_t *socket );
+uint32_t        mqtt_frame_length( mqtt_frame_type_t type, const void *args );
+wiced_result_t  mqtt_frame_create( uint32_t size, mqtt_frame_t *frame, mqtt_socket_t *socket );
 wiced_result_t  mqtt_frame_send  ( mqtt_frame_t *frame, mqtt_socket_t *socket );
 wiced_result_t  mqtt_frame_recv  ( wiced_mqtt_buffer_t *buffer, void *p_user, uint32_t *size );
 wiced_result_t  mqtt_frame_delete( mqtt_frame_t *frame );
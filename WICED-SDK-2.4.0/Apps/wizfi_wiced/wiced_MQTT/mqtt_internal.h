@@ -18,6 +18,8 @@
 #include "mqtt_frame.h"
 #include "mqtt_network.h"
 #include "mqtt_session.h"
+#include "mqtt_topic.h"
+#include "mqtt_store.h"
 
 
 #ifdef __cplusplus
@@ -28,8 +30,7 @@ extern "C" {
 /******************************************************
  *                    Macros
  ******************************************************/
-#define MQTT_CONNECTION_FRAME_MAX                     (4 * 1024)        /* Maximum frame size for a connection          */
-#define MQTT_CONNECTION_DATA_SIZE_MAX                 (MQTT_CONNECTION_FRAME_MAX - 8) /* Maximum size to put in a frame */
+#define MQTT_CONNECTION_FRAME_MAX                     (4 * 1024)        /* Maximum size of a received frame             */
 
 /******************************************************
  *                   Enumerations
@@ -95,6 +96,9 @@ typedef struct mqtt_connection_s
     wiced_mqtt_callback_t           callbacks;
     mqtt_heartbeat_t                heartbeat;
     mqtt_session_t*                 session;
+    mqtt_topic_tree_t               topics;
+    uint8_t                         connected;          /* Broker accepted the CONNECT and the connection has not closed since */
+    mqtt_store_t*                   store;              /* Offline publish store, NULL when not enabled */
 } mqtt_connection_t;
 
 typedef struct mqtt_send_context_t
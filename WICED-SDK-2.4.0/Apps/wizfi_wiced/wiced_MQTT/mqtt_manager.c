@@ -51,6 +51,10 @@ inline static void mqtt_manager_heartbeat_recv_reset( mqtt_heartbeat_t *heartbea
 inline static wiced_result_t mqtt_manager_heartbeat_send_step( mqtt_heartbeat_t *heartbeat );
 inline static wiced_result_t mqtt_manager_heartbeat_recv_step( mqtt_heartbeat_t *heartbeat );
 static void mqtt_manager_heartbeat_deinit( mqtt_heartbeat_t *heartbeat );
+static void mqtt_manager_add_subscriptions( const mqtt_subscribe_arg_t *args, mqtt_connection_t *conn );
+static void mqtt_manager_remove_subscriptions( const mqtt_unsubscribe_arg_t *args, mqtt_connection_t *conn );
+static void mqtt_manager_store_drain( mqtt_connection_t *conn );
+static void mqtt_manager_store_acknowledged( uint16_t packet_id, mqtt_connection_t *conn );
 
 /******************************************************
  *               Variable Definitions
@@ -60,25 +64,19 @@ static void mqtt_manager_heartbeat_deinit( mqtt_heartbeat_t *heartbeat );
  *               Function Definitions
  ******************************************************/
 
+/* Runs on the networking worker thread. The session, the store and the socket belong to the
+ * MQTT thread, so the tick is only posted to its queue and handled there like any other event.
+ * A tick dropped on a full queue just delays the heartbeat and resends by one step.
+ */
 static wiced_result_t mqtt_manager_tick( void* arg )
 {
     mqtt_connection_t *conn = (mqtt_connection_t *) arg;
-    if ( mqtt_manager( MQTT_EVENT_TICK, NULL, conn ) != WICED_SUCCESS )
-    {
-
-        /* Publish is an async method (we don't get an OK), so we simulate the OK after sending it */
-        if ( conn->callbacks != NULL )
-        {
-
-            wiced_mqtt_event_info_t event;
-            event.type = WICED_MQTT_EVENT_TYPE_DISCONNECTED;
-            event.data.err_code = WICED_MQTT_CONN_ERR_CODE_INVALID;
-            conn->callbacks( (void*) conn, &event );
-        }
+    mqtt_event_message_t current_event;
 
-        return WICED_ERROR;
-    }
-    return WICED_SUCCESS;
+    current_event.send_context.event_t = MQTT_EVENT_TICK;
+    current_event.send_context.conn = conn;
+    current_event.event_type = MQTT_SEND_EVENT;
+    return wiced_rtos_push_to_queue( &conn->socket.queue, &current_event, WICED_NO_WAIT );
 }
 
 static wiced_result_t mqtt_manager_heartbeat_init( uint16_t keep_alive, void *p_user, mqtt_heartbeat_t *heartbeat )
@@ -161,6 +159,8 @@ wiced_result_t mqtt_manager( mqtt_event_t event, void *args, mqtt_connection_t *
 
         case MQTT_EVENT_SEND_SUBSCRIBE:
         {
+            /* Callbacks are registered before sending so messages arriving right after the SUBACK are not missed */
+            mqtt_manager_add_subscriptions( args, conn );
             mqtt_backend_put_subscribe( args, conn );
             mqtt_manager_heartbeat_send_reset( &conn->heartbeat );
             if ( mqtt_session_add_item( MQTT_PACKET_TYPE_SUBSCRIBE, args, conn->session ) != WICED_SUCCESS )
@@ -173,6 +173,7 @@ wiced_result_t mqtt_manager( mqtt_event_t event, void *args, mqtt_connection_t *
 
         case MQTT_EVENT_SEND_UNSUBSCRIBE:
         {
+            mqtt_manager_remove_subscriptions( args, conn );
             mqtt_backend_put_unsubscribe( args, conn );
             mqtt_manager_heartbeat_send_reset( &conn->heartbeat );
             if ( mqtt_session_add_item( MQTT_PACKET_TYPE_UNSUBSCRIBE, args, conn->session ) != WICED_SUCCESS )
@@ -186,10 +187,21 @@ wiced_result_t mqtt_manager( mqtt_event_t event, void *args, mqtt_connection_t *
         case MQTT_EVENT_SEND_PUBLISH:
         {
             mqtt_publish_arg_t *publish_args = (mqtt_publish_arg_t *) args;
-            if ( mqtt_session_add_item( MQTT_PACKET_TYPE_PUBLISH, args, conn->session ) != WICED_SUCCESS )
+
+            /* Only QoS 1/2 messages are held for acknowledgement; on a full window the message is
+             * dropped and the application told, so it can publish it again once PUBLISHED events free slots */
+            if ( ( publish_args->qos != MQTT_QOS_DELIVER_AT_MOST_ONCE ) && ( mqtt_session_add_item( MQTT_PACKET_TYPE_PUBLISH, args, conn->session ) != WICED_SUCCESS ) )
             {
-                /* TODO : error handling */
-                WPRINT_LIB_ERROR( ("[MQTT] Adding publish to session queue fail.\n ") );
+                WPRINT_LIB_ERROR( ("[MQTT] Session window full, publish %d not sent.\n ", publish_args->packet_id) );
+                if ( conn->callbacks != NULL )
+                {
+                    wiced_mqtt_event_info_t callback_event;
+                    callback_event.type = WICED_MQTT_EVENT_TYPE_PUBLISH_FAILED;
+                    callback_event.data.msgid = publish_args->packet_id;
+                    conn->callbacks( (void*) conn, &callback_event );
+                }
+                result = WICED_ERROR;
+                break;
             }
             result = mqtt_backend_put_publish( args, conn );
             if ( ( publish_args->qos != MQTT_QOS_DELIVER_AT_MOST_ONCE ) )
@@ -199,11 +211,6 @@ wiced_result_t mqtt_manager( mqtt_event_t event, void *args, mqtt_connection_t *
 
             if ( publish_args->qos == MQTT_QOS_DELIVER_AT_MOST_ONCE )
             {
-                if ( mqtt_session_remove_item( MQTT_PACKET_TYPE_PUBLISH, publish_args->packet_id, conn->session ) != WICED_SUCCESS )
-                {
-                    /* TODO : error handling */
-                    WPRINT_LIB_ERROR(( "[MQTT] publish with Qos level 0 %d not in session queue.\n ", publish_args->packet_id ));
-                }
                 if ( ( result == WICED_SUCCESS ) & ( conn->callbacks != NULL ) )
                 {
                     wiced_mqtt_event_info_t callback_event;
@@ -229,15 +236,15 @@ wiced_result_t mqtt_manager( mqtt_event_t event, void *args, mqtt_connection_t *
             {
                 mqtt_pubrec_arg_t pubrec_args;
                 pubrec_args.packet_id = publish_args->packet_id;
-                mqtt_backend_put_pubrec( &pubrec_args, conn );
-                mqtt_manager_heartbeat_send_reset( &conn->heartbeat );
                 if ( mqtt_session_item_exist( MQTT_PACKET_TYPE_PUBREC, publish_args->packet_id, conn->session ) != WICED_SUCCESS )
                 {
-                    /* new publish packet */
+                    /* new publish packet. Without an item to recognise its resends by, it is neither
+                     * acknowledged nor passed to user, so the Broker sends it again later */
                     if ( mqtt_session_add_item( MQTT_PACKET_TYPE_PUBREC, &pubrec_args, conn->session ) != WICED_SUCCESS )
                     {
-                        /* TODO : error handling */
-                        WPRINT_LIB_ERROR( ("[MQTT] Adding pubrec to session queue fail.\n ") );
+                        WPRINT_LIB_ERROR( ("[MQTT] Session window full, publish %d not acknowledged.\n ", publish_args->packet_id) );
+                        publish_args->data = NULL;
+                        break;
                     }
                 }
                 else
@@ -245,6 +252,8 @@ wiced_result_t mqtt_manager( mqtt_event_t event, void *args, mqtt_connection_t *
                     /* This item is already received before shouldn't be passed to user */
                     publish_args->data = NULL;
                 }
+                mqtt_backend_put_pubrec( &pubrec_args, conn );
+                mqtt_manager_heartbeat_send_reset( &conn->heartbeat );
             }
         }
             break;
@@ -282,6 +291,7 @@ wiced_result_t mqtt_manager( mqtt_event_t event, void *args, mqtt_connection_t *
                 /* TODO : error handling */
                 WPRINT_LIB_ERROR( ("[MQTT] puback %d not in session queue.\n ", puback_args->packet_id) );
             }
+            mqtt_manager_store_acknowledged( puback_args->packet_id, conn );
         }
             break;
 
@@ -297,6 +307,9 @@ wiced_result_t mqtt_manager( mqtt_event_t event, void *args, mqtt_connection_t *
                 WPRINT_LIB_ERROR( ("[MQTT] publish %d not in session queue.\n ", pubrec_args->packet_id) );
             }
 
+            /* The Broker holds a QoS 2 message once it has sent PUBREC */
+            mqtt_manager_store_acknowledged( pubrec_args->packet_id, conn );
+
             mqtt_backend_put_pubrel( &pubrel_args, conn );
             mqtt_manager_heartbeat_send_reset( &conn->heartbeat );
             if ( mqtt_session_item_exist( MQTT_PACKET_TYPE_PUBREL, pubrel_args.packet_id, conn->session ) != WICED_SUCCESS )
@@ -341,15 +354,30 @@ wiced_result_t mqtt_manager( mqtt_event_t event, void *args, mqtt_connection_t *
             break;
 
         case MQTT_EVENT_RECV_PINGRES:
+        {
+            mqtt_manager_heartbeat_recv_reset( &conn->heartbeat );
+        }
+            break;
+
         case MQTT_EVENT_RECV_CONNACK:
         {
+            mqtt_connack_arg_t *connack_args = (mqtt_connack_arg_t *) args;
             mqtt_manager_heartbeat_recv_reset( &conn->heartbeat );
+            if ( connack_args->return_code != WICED_MQTT_RETURN_CODE_ACCEPTED )
+            {
+                break;
+            }
+            conn->connected = WICED_TRUE;
+
             /* Resend any thing in the session */
             if ( mqtt_session_iterate_through_items( mqtt_manager_resend_packet, conn, conn->session ) != WICED_SUCCESS )
             {
                 /* TODO : error handling */
                 WPRINT_LIB_ERROR( ("[MQTT] Error resending session messages.\n " ) );
             }
+
+            /* Then what was published while the Broker could not be reached */
+            mqtt_manager_store_drain( conn );
         }
             break;
 
@@ -359,6 +387,13 @@ wiced_result_t mqtt_manager( mqtt_event_t event, void *args, mqtt_connection_t *
             {
                 /* Reset counter timed out and we didn't receive any thing from broker */
                 mqtt_network_disconnect( &conn->socket );
+                if ( conn->callbacks != NULL )
+                {
+                    wiced_mqtt_event_info_t event;
+                    event.type = WICED_MQTT_EVENT_TYPE_DISCONNECTED;
+                    event.data.err_code = WICED_MQTT_CONN_ERR_CODE_INVALID;
+                    conn->callbacks( (void*) conn, &event );
+                }
                 result = WICED_ERROR;
             }
             else
@@ -368,12 +403,28 @@ wiced_result_t mqtt_manager( mqtt_event_t event, void *args, mqtt_connection_t *
                     mqtt_backend_put_pingreq( conn );
                     mqtt_manager_heartbeat_send_reset( &conn->heartbeat );
                 }
+
+                /* Resend whatever has waited too long for its acknowledgement */
+                if ( ( conn->session != NULL ) && ( mqtt_session_iterate_expired_items( mqtt_manager_resend_packet, conn, conn->session ) != WICED_SUCCESS ) )
+                {
+                    WPRINT_LIB_ERROR( ("[MQTT] Error resending expired session messages.\n " ) );
+                }
+                mqtt_manager_store_drain( conn );
             }
         }
             break;
 
         case MQTT_EVENT_CONNECTION_CLOSE:
         {
+            conn->connected = WICED_FALSE;
+
+            /* A stored message not yet acknowledged stays in flash and is sent again after reconnecting */
+            if ( ( conn->store != NULL ) && ( conn->store->drain_packet_id != 0 ) )
+            {
+                mqtt_session_remove_item( MQTT_PACKET_TYPE_PUBLISH, conn->store->drain_packet_id, conn->session );
+                conn->store->drain_packet_id = 0;
+                mqtt_store_cancel( conn->store );
+            }
             /* TODO : add implementations here, or add fall-through to default */
             mqtt_connection_deinit(conn);
         }
@@ -409,7 +460,10 @@ static wiced_result_t mqtt_manager_resend_packet( mqtt_frame_type_t type, void *
             break;
         case MQTT_PACKET_TYPE_PUBLISH:
         {
-            result = mqtt_backend_put_publish( arg, conn );
+            /* A resent PUBLISH carries the DUP flag */
+            mqtt_publish_arg_t publish_args = *( (mqtt_publish_arg_t *) arg );
+            publish_args.dup = 1;
+            result = mqtt_backend_put_publish( &publish_args, conn );
         }
             break;
         case MQTT_PACKET_TYPE_PUBREC:
@@ -436,3 +490,99 @@ static wiced_result_t mqtt_manager_resend_packet( mqtt_frame_type_t type, void *
     }
     return result;
 }
+
+static void mqtt_manager_add_subscriptions( const mqtt_subscribe_arg_t *args, mqtt_connection_t *conn )
+{
+    uint8_t index;
+
+    if ( args->subscriptions == NULL )
+    {
+        return;
+    }
+    for ( index = 0; index < args->count; index++ )
+    {
+        const wiced_mqtt_subscription_t *subscription = &args->subscriptions[ index ];
+
+        if ( subscription->callback == NULL )
+        {
+            /* Resubscribing without a callback sends the filter's messages as events again */
+            mqtt_topic_tree_remove( &conn->topics, (const uint8_t*) subscription->topic, (uint16_t) strlen( subscription->topic ) );
+            continue;
+        }
+        if ( mqtt_topic_tree_add( &conn->topics, (const uint8_t*) subscription->topic, (uint16_t) strlen( subscription->topic ), subscription->callback, subscription->arg ) != WICED_SUCCESS )
+        {
+            WPRINT_LIB_ERROR( ("[MQTT] Registering callback for %s fail.\n ", subscription->topic) );
+        }
+    }
+}
+
+static void mqtt_manager_remove_subscriptions( const mqtt_unsubscribe_arg_t *args, mqtt_connection_t *conn )
+{
+    uint8_t index;
+
+    if ( args->topics == NULL )
+    {
+        mqtt_topic_tree_remove( &conn->topics, args->topic_filter.str, args->topic_filter.len );
+        return;
+    }
+    for ( index = 0; index < args->count; index++ )
+    {
+        mqtt_topic_tree_remove( &conn->topics, (const uint8_t*) args->topics[ index ], (uint16_t) strlen( args->topics[ index ] ) );
+    }
+}
+
+/* Sends stored messages one at a time, as fast as the drain rate allows.
+ * Only ever runs on the MQTT thread: on CONNACK, on an acknowledgement and on the tick. */
+static void mqtt_manager_store_drain( mqtt_connection_t *conn )
+{
+    mqtt_store_t *store = conn->store;
+    mqtt_publish_arg_t publish_args;
+
+    if ( ( store == NULL ) || ( conn->session == NULL ) )
+    {
+        return;
+    }
+    while ( ( conn->connected == WICED_TRUE ) && ( store->drain_packet_id == 0 ) && ( mqtt_store_read( store, &publish_args ) == WICED_SUCCESS ) )
+    {
+        if ( ++conn->packet_id == 0 )
+        {
+            ++conn->packet_id;
+        }
+        publish_args.packet_id = conn->packet_id;
+
+        if ( publish_args.qos == MQTT_QOS_DELIVER_AT_MOST_ONCE )
+        {
+            if ( mqtt_backend_put_publish( &publish_args, conn ) == WICED_SUCCESS )
+            {
+                mqtt_store_release( store );
+            }
+            else
+            {
+                mqtt_store_cancel( store );
+                return;
+            }
+            continue;
+        }
+
+        /* The session resends it from the store's buffer until it is acknowledged */
+        if ( mqtt_session_add_item( MQTT_PACKET_TYPE_PUBLISH, &publish_args, conn->session ) != WICED_SUCCESS )
+        {
+            mqtt_store_cancel( store );
+            return;
+        }
+        store->drain_packet_id = publish_args.packet_id;
+        mqtt_backend_put_publish( &publish_args, conn );
+        mqtt_manager_heartbeat_send_reset( &conn->heartbeat );
+    }
+}
+
+static void mqtt_manager_store_acknowledged( uint16_t packet_id, mqtt_connection_t *conn )
+{
+    if ( ( conn->store == NULL ) || ( conn->store->drain_packet_id == 0 ) || ( conn->store->drain_packet_id != packet_id ) )
+    {
+        return;
+    }
+    conn->store->drain_packet_id = 0;
+    mqtt_store_release( conn->store );
+    mqtt_manager_store_drain( conn );
+}
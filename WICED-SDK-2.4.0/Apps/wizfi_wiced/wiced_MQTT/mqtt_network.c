@@ -21,7 +21,7 @@
 #include "mqtt_manager.h"
 #include "wiced_tls.h"
 
-#include "mqttconsole.h"
+#include "MQTTConsole.h"
 
 /******************************************************
  *                      Macros
@@ -30,6 +30,8 @@
 /******************************************************
  *                    Constants
  ******************************************************/
+#define MQTT_DECODER_MAXIMUM_HEADER_LENGTH      (5)     /* Type octet and a remaining length of at most four octets */
+#define MQTT_DECODER_MAXIMUM_FRAME_LENGTH       MQTT_CONNECTION_FRAME_MAX
 
 /******************************************************
  *                   Enumerations
@@ -59,6 +61,9 @@ static wiced_result_t mqtt_disconnect_callback( void *socket );
 
 static void mqtt_thread_main( uint32_t arg );
 static void wiced_process_mqtt_request( void *arg );
+static wiced_result_t mqtt_network_decode( mqtt_socket_t *socket, wiced_packet_t *packet, uint8_t *data, uint16_t length );
+static void mqtt_network_dispatch_frame( mqtt_socket_t *socket, wiced_packet_t *packet, uint8_t *start );
+static void mqtt_network_reset_decoder( mqtt_socket_t *socket );
 
 /******************************************************
  *               Variable Definitions
@@ -84,13 +89,24 @@ wiced_result_t mqtt_core_init( mqtt_connection_t *conn )
         goto ERROR_SEMAPHORE_INIT;
     }
 
-    if ( ( result = wiced_rtos_create_thread( &mqtt_socket->net_thread, 10, "Mqttmain", mqtt_thread_main, 3100, mqtt_socket ) ) != WICED_SUCCESS )
+    if ( ( result = mqtt_topic_tree_init( &conn->topics ) ) != WICED_SUCCESS )
     {
         goto ERROR_QUEUE_THREAD;
     }
+
+    if ( ( result = wiced_rtos_create_thread( &mqtt_socket->net_thread, 10, "Mqttmain", mqtt_thread_main, 3100, mqtt_socket ) ) != WICED_SUCCESS )
+    {
+        goto ERROR_TOPIC_TREE;
+    }
     conn->session_init = WICED_TRUE;
+    conn->session = NULL;
+    conn->connected = WICED_FALSE;
+    conn->store = NULL;
     return result;
 
+ERROR_TOPIC_TREE:
+    mqtt_topic_tree_deinit( &conn->topics );
+
 ERROR_QUEUE_THREAD:
     wiced_rtos_deinit_queue( &mqtt_socket->queue );
 
@@ -117,6 +133,13 @@ wiced_result_t mqtt_core_deinit( mqtt_connection_t *conn )
     }
 
     wiced_rtos_deinit_queue( &mqtt_socket->queue );
+    mqtt_topic_tree_deinit( &conn->topics );
+    if ( conn->store != NULL )
+    {
+        mqtt_store_deinit( conn->store );
+        free( conn->store );
+        conn->store = NULL;
+    }
 
     //daniel 160630 modify original source
 	g_mqtt_thread_is_running = 0;
@@ -180,6 +203,7 @@ wiced_result_t mqtt_network_init( const wiced_ip_address_t *server_ip_address, u
     }
 
     socket->p_user = p_user;
+    memset( &socket->decoder, 0, sizeof( socket->decoder ) );
     socket->server_ip_address = *server_ip_address;
     socket->portnumber = portnumber;
     conn->net_init_ok = WICED_TRUE;
@@ -230,6 +254,7 @@ wiced_result_t mqtt_network_deinit( mqtt_socket_t *socket )
 {
 
     mqtt_network_disconnect( socket );
+    mqtt_network_reset_decoder( socket );
     if ( socket->socket.tls_context != NULL )
     {
         wiced_tls_reset_context( socket->socket.tls_context );
@@ -245,7 +270,7 @@ wiced_result_t mqtt_network_deinit( mqtt_socket_t *socket )
 
 static void mqtt_thread_main( uint32_t arg )
 {
-    mqtt_socket_t *socket = (mqtt_socket_t*) arg;
+    mqtt_socket_t *socket = (mqtt_socket_t*) (uintptr_t) arg;
     mqtt_event_message_t current_event;
     wiced_result_t result = WICED_SUCCESS;
     while ( 1 )
@@ -284,37 +309,183 @@ static void mqtt_thread_main( uint32_t arg )
 
 static void wiced_process_mqtt_request( void *arg )
 {
-    wiced_result_t result;
     mqtt_socket_t* socket = (mqtt_socket_t*) arg;
-
-    uint8_t *data;
     wiced_packet_t *packet;
 
-    /*Receive the query from the TCP client*/
-    result = wiced_tcp_receive( &socket->socket, &packet, WICED_NO_WAIT );
-    if ( result == WICED_SUCCESS )
+    /* Drain every packet queued on the socket; frames may span packets or share one */
+    while ( wiced_tcp_receive( &socket->socket, &packet, WICED_NO_WAIT ) == WICED_SUCCESS )
     {
+        uint8_t *data;
+        uint16_t offset = 0;
         uint16_t rx_data_length;
         uint16_t available_data_length;
-        uint16_t current_size = 0;
-        wiced_mqtt_buffer_t buffer;
+        wiced_result_t result = WICED_SUCCESS;
 
-        /*Process the client request*/
-        wiced_packet_get_data( packet, 0, (uint8_t**) ( &data ), &rx_data_length, &available_data_length );
-        while ( current_size < rx_data_length )
+        /* Walk each fragment of a chained packet */
+        do
         {
-            uint32_t size;
-            buffer.packet = packet;
-            buffer.data = data + current_size;
-            if ( mqtt_frame_recv( &buffer, socket->p_user, &size ) != WICED_SUCCESS )
+            if ( wiced_packet_get_data( packet, offset, &data, &rx_data_length, &available_data_length ) != WICED_SUCCESS || rx_data_length == 0 )
             {
                 break;
             }
-            current_size = (uint16_t) ( current_size + size );
-        }
+            result = mqtt_network_decode( socket, packet, data, rx_data_length );
+            offset = (uint16_t) ( offset + rx_data_length );
+        } while ( ( result == WICED_SUCCESS ) && ( rx_data_length < available_data_length ) );
+
         /*Delete the packet, we're done with it*/
-        wiced_packet_delete( buffer.packet );
+        wiced_packet_delete( packet );
+
+        if ( result != WICED_SUCCESS )
+        {
+            /* The stream can not be resynchronised after a malformed header, so drop the connection */
+            mqtt_network_reset_decoder( socket );
+            mqtt_frame_recv( NULL, socket->p_user, NULL );
+            return;
+        }
+    }
+}
+
+/*
+ * Feeds received bytes to the frame decoder. Frames held entirely in the packet are
+ * handed to the framing layer in place; anything else is gathered in the decoder
+ * until the frame is complete.
+ */
+static wiced_result_t mqtt_network_decode( mqtt_socket_t *socket, wiced_packet_t *packet, uint8_t *data, uint16_t length )
+{
+    mqtt_decoder_t *decoder = &socket->decoder;
+
+    while ( length > 0 )
+    {
+        switch ( decoder->state )
+        {
+            case MQTT_DECODER_STATE_HEADER:
+            {
+                uint32_t remaining_length = 0;
+                uint32_t multiplier       = 1;
+                uint16_t header_length    = 1;
+
+                /* Fast path: decode the remaining length straight from the packet. A frame over
+                 * the limit takes the slow path and is dropped, as it would be across packets */
+                while ( ( header_length < length ) && ( header_length < MQTT_DECODER_MAXIMUM_HEADER_LENGTH ) )
+                {
+                    remaining_length += ( data[ header_length ] & 127 ) * multiplier;
+                    multiplier *= 128;
+                    if ( ( data[ header_length++ ] & 128 ) == 0 )
+                    {
+                        if ( ( remaining_length <= (uint32_t) ( length - header_length ) ) && ( header_length + remaining_length <= MQTT_DECODER_MAXIMUM_FRAME_LENGTH ) )
+                        {
+                            mqtt_network_dispatch_frame( socket, packet, data );
+                            data   += header_length + remaining_length;
+                            length  = (uint16_t) ( length - ( header_length + remaining_length ) );
+                            header_length = 0;
+                        }
+                        break;
+                    }
+                }
+                if ( header_length == 0 )
+                {
+                    break;
+                }
+
+                decoder->header[ 0 ]      = *data++;
+                decoder->header_length    = 1;
+                decoder->remaining_length = 0;
+                decoder->multiplier       = 1;
+                decoder->state            = MQTT_DECODER_STATE_LENGTH;
+                length--;
+                break;
+            }
+
+            case MQTT_DECODER_STATE_LENGTH:
+            {
+                uint8_t octet = *data++;
+                length--;
+
+                decoder->header[ decoder->header_length++ ] = octet;
+                decoder->remaining_length += ( octet & 127 ) * decoder->multiplier;
+                decoder->multiplier *= 128;
+                if ( ( octet & 128 ) != 0 )
+                {
+                    if ( decoder->header_length == MQTT_DECODER_MAXIMUM_HEADER_LENGTH )
+                    {
+                        WPRINT_LIB_ERROR(("[MQTT LIB] Malformed remaining length\n"));
+                        return WICED_ERROR;
+                    }
+                    break;
+                }
+
+                decoder->frame_length = decoder->header_length + decoder->remaining_length;
+                decoder->received     = decoder->header_length;
+                if ( decoder->remaining_length == 0 )
+                {
+                    mqtt_network_dispatch_frame( socket, NULL, decoder->header );
+                    decoder->state = MQTT_DECODER_STATE_HEADER;
+                    break;
+                }
+
+                decoder->frame = ( decoder->frame_length <= MQTT_DECODER_MAXIMUM_FRAME_LENGTH ) ? malloc_named( "mqtt_frame", decoder->frame_length ) : NULL;
+                if ( decoder->frame == NULL )
+                {
+                    WPRINT_LIB_ERROR(("[MQTT LIB] Dropping %u byte frame\n", (unsigned int) decoder->frame_length));
+                    decoder->state = MQTT_DECODER_STATE_DISCARD;
+                    break;
+                }
+                memcpy( decoder->frame, decoder->header, decoder->header_length );
+                decoder->state = MQTT_DECODER_STATE_BODY;
+                break;
+            }
+
+            case MQTT_DECODER_STATE_BODY:
+            case MQTT_DECODER_STATE_DISCARD:
+            {
+                uint16_t chunk = (uint16_t) MIN( (uint32_t) length, decoder->frame_length - decoder->received );
+
+                if ( decoder->state == MQTT_DECODER_STATE_BODY )
+                {
+                    memcpy( decoder->frame + decoder->received, data, chunk );
+                }
+                decoder->received += chunk;
+                data   += chunk;
+                length  = (uint16_t) ( length - chunk );
+
+                if ( decoder->received == decoder->frame_length )
+                {
+                    if ( decoder->state == MQTT_DECODER_STATE_BODY )
+                    {
+                        mqtt_network_dispatch_frame( socket, NULL, decoder->frame );
+                    }
+                    mqtt_network_reset_decoder( socket );
+                }
+                break;
+            }
+
+            default:
+                mqtt_network_reset_decoder( socket );
+                break;
+        }
+    }
+    return WICED_SUCCESS;
+}
+
+static void mqtt_network_dispatch_frame( mqtt_socket_t *socket, wiced_packet_t *packet, uint8_t *start )
+{
+    wiced_mqtt_buffer_t buffer;
+    uint32_t size;
+
+    buffer.packet = packet;
+    buffer.data   = start;
+
+    /* The decoder already knows where the next frame starts, so a frame the framing layer rejects is simply skipped */
+    mqtt_frame_recv( &buffer, socket->p_user, &size );
+}
+
+static void mqtt_network_reset_decoder( mqtt_socket_t *socket )
+{
+    if ( socket->decoder.frame != NULL )
+    {
+        free( socket->decoder.frame );
     }
+    memset( &socket->decoder, 0, sizeof( socket->decoder ) );
 }
 
 wiced_result_t mqtt_network_connect( mqtt_socket_t *socket )
@@ -341,9 +512,15 @@ wiced_result_t mqtt_network_disconnect( mqtt_socket_t *socket )
 wiced_result_t mqtt_network_create_buffer( wiced_mqtt_buffer_t *buffer, uint16_t size, mqtt_socket_t *socket )
 {
     uint16_t available_data_length;
+    wiced_result_t result;
 
     /* Create the TCP packet. Memory for the tx_data is automatically allocated */
-    return wiced_packet_create_tcp( &socket->socket, size, &buffer->packet, &buffer->data, &available_data_length );
+    result = wiced_packet_create_tcp( &socket->socket, size, &buffer->packet, &buffer->data, &available_data_length );
+    if ( result == WICED_SUCCESS )
+    {
+        buffer->end = buffer->data + available_data_length;
+    }
+    return result;
 }
 
 wiced_result_t mqtt_network_delete_buffer( wiced_mqtt_buffer_t *buffer )
@@ -33,6 +33,13 @@ extern "C" {
 /******************************************************
  *                   Enumerations
  ******************************************************/
+typedef enum
+{
+    MQTT_DECODER_STATE_HEADER,                  /* Waiting for the type and flags octet          */
+    MQTT_DECODER_STATE_LENGTH,                  /* Reading the remaining length octets           */
+    MQTT_DECODER_STATE_BODY,                    /* Copying the rest of the frame                 */
+    MQTT_DECODER_STATE_DISCARD,                 /* Skipping a frame too large to be reassembled  */
+} mqtt_decoder_state_t;
 
 /******************************************************
  *                 Type Definitions
@@ -42,6 +49,19 @@ extern "C" {
  *                    Structures
  ******************************************************/
 
+/* Keeps a partly received frame between TCP packets */
+typedef struct
+{
+    mqtt_decoder_state_t            state;
+    uint8_t                         header[5];          /* Type octet and at most four remaining length octets */
+    uint8_t                         header_length;
+    uint32_t                        remaining_length;
+    uint32_t                        multiplier;
+    uint8_t*                        frame;              /* Reassembly buffer holding the whole frame */
+    uint32_t                        frame_length;
+    uint32_t                        received;
+}mqtt_decoder_t;
+
 typedef struct
 {
     wiced_tcp_socket_t              socket;
@@ -52,12 +72,14 @@ typedef struct
     void*                           p_user;
     wiced_tls_context_t             tls_context;
     wiced_tls_identity_t            tls_identity;
+    mqtt_decoder_t                  decoder;
 }mqtt_socket_t;
 
 typedef struct wiced_mqtt_buffer_s
 {
     wiced_packet_t*                 packet;
     uint8_t*                        data;
+    uint8_t*                        end;                /* End of the space available for writing */
 }wiced_mqtt_buffer_t;
 
 /******************************************************
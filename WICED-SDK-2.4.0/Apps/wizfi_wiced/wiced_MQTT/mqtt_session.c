@@ -41,6 +41,8 @@
 /******************************************************
  *               Static Function Declarations
  ******************************************************/
+static wiced_mqtt_session_item_t* mqtt_session_find_item( mqtt_frame_type_t type, uint16_t packet_id, mqtt_session_t *session );
+static void mqtt_session_count_item( mqtt_frame_type_t type, int delta, mqtt_session_t *session );
 
 /******************************************************
  *               Variable Definitions
@@ -50,6 +52,48 @@
  *               Function Definitions
  ******************************************************/
 
+static wiced_mqtt_session_item_t* mqtt_session_find_item( mqtt_frame_type_t type, uint16_t packet_id, mqtt_session_t *session )
+{
+    uint8_t index = session->hash[ packet_id & ( MQTT_SESSION_HASH_SIZE - 1 ) ];
+
+    while ( index != MQTT_SESSION_NO_ITEM )
+    {
+        wiced_mqtt_session_item_t *item = &session->items[ index ];
+        if ( ( item->packet_id == packet_id ) && ( item->type == type ) )
+        {
+            return item;
+        }
+        index = item->next;
+    }
+    return NULL;
+}
+
+static void mqtt_session_count_item( mqtt_frame_type_t type, int delta, mqtt_session_t *session )
+{
+    wiced_mqtt_session_statistics_t *statistics = &session->statistics;
+
+    switch ( type )
+    {
+        case MQTT_PACKET_TYPE_PUBLISH:
+            statistics->publish = (uint16_t) ( statistics->publish + delta );
+            break;
+        case MQTT_PACKET_TYPE_PUBREL:
+            statistics->pubrel = (uint16_t) ( statistics->pubrel + delta );
+            break;
+        case MQTT_PACKET_TYPE_PUBREC:
+            statistics->pubrec = (uint16_t) ( statistics->pubrec + delta );
+            break;
+        case MQTT_PACKET_TYPE_SUBSCRIBE:
+            statistics->subscribe = (uint16_t) ( statistics->subscribe + delta );
+            break;
+        case MQTT_PACKET_TYPE_UNSUBSCRIBE:
+            statistics->unsubscribe = (uint16_t) ( statistics->unsubscribe + delta );
+            break;
+        default:
+            break;
+    }
+}
+
 /******************************************************
  *               Interface functions
  ******************************************************/
@@ -60,6 +104,8 @@ wiced_result_t mqtt_session_init( mqtt_session_t *session )
     /* Initialize both list heads used and non used */
     INIT_LIST_HEAD( &session->used_list );
     INIT_LIST_HEAD( &session->nonused_list );
+    memset( session->hash, MQTT_SESSION_NO_ITEM, sizeof( session->hash ) );
+    memset( &session->statistics, 0, sizeof( session->statistics ) );
 
     /* Add all items to non used list */
     for ( index = 0; index < sizeof(session->items) / sizeof(session->items[0]); index++ )
@@ -73,127 +119,155 @@ wiced_result_t mqtt_session_init( mqtt_session_t *session )
 wiced_result_t mqtt_session_add_item( mqtt_frame_type_t type, void *args, mqtt_session_t *session)
 {
     wiced_mqtt_session_item_t *item;
+    uint8_t *chain;
 
     /* Check if there are any non used slots to grab */
     if ( list_empty( &session->nonused_list ) )
     {
+        session->statistics.window_full++;
         return WICED_ERROR;
     }
 
     /* Get first item in the empty list */
     item = list_entry( session->nonused_list.next, wiced_mqtt_session_item_t, list );
-    list_del( &item->list );
 
     /* Fill data */
-    item->type = type;
     if ( type == MQTT_PACKET_TYPE_PUBLISH )
     {
         item->args.publish = *((mqtt_publish_arg_t *) args);
+        item->packet_id = item->args.publish.packet_id;
     }
     else if ( type == MQTT_PACKET_TYPE_SUBSCRIBE )
     {
         item->args.subscribe = *((mqtt_subscribe_arg_t *) args);
+        item->packet_id = item->args.subscribe.packet_id;
     }
     else if ( type == MQTT_PACKET_TYPE_UNSUBSCRIBE )
     {
         item->args.unsubscribe = *((mqtt_unsubscribe_arg_t *) args);
+        item->packet_id = item->args.unsubscribe.packet_id;
     }
     else if ( type == MQTT_PACKET_TYPE_PUBREC )
     {
         item->args.pubrec = *((mqtt_pubrec_arg_t *) args);
+        item->packet_id = item->args.pubrec.packet_id;
     }
     else if ( type == MQTT_PACKET_TYPE_PUBREL )
     {
         item->args.pubrel = *((mqtt_pubrel_arg_t *) args);
+        item->packet_id = item->args.pubrel.packet_id;
     }
     else
     {
-        list_add( &item->list, &session->nonused_list );
         return WICED_ERROR;
     }
+    list_del( &item->list );
+    item->type = type;
 
-    /* Add it to the used list */
+    /* Link it into its hash chain */
+    chain = &session->hash[ item->packet_id & ( MQTT_SESSION_HASH_SIZE - 1 ) ];
+    item->next = *chain;
+    *chain = (uint8_t) ( item - session->items );
+
+    /* Add it to the used list, which stays in resend order as the timeout is the same for every item */
+    wiced_time_get_time( &item->resend_time );
+    item->resend_time += MQTT_SESSION_RETRANSMIT_TIMEOUT;
     list_add_tail( &item->list, &session->used_list );
+    mqtt_session_count_item( type, 1, session );
 
     return WICED_SUCCESS;
 }
 
 wiced_result_t mqtt_session_remove_item( mqtt_frame_type_t type, uint16_t packet_id, mqtt_session_t *session)
 {
-    struct list_head *pos, *q;
-    wiced_mqtt_session_item_t *item = NULL;
+    wiced_mqtt_session_item_t *item = mqtt_session_find_item( type, packet_id, session );
+    uint8_t *chain;
 
-    if ( list_empty( &session->used_list ) )
+    if ( item == NULL )
     {
+        /* No match */
         return WICED_ERROR;
     }
 
-    list_for_each_safe( pos, q, &session->used_list )
+    /* Unlink it from its hash chain */
+    chain = &session->hash[ packet_id & ( MQTT_SESSION_HASH_SIZE - 1 ) ];
+    while ( &session->items[ *chain ] != item )
     {
-        item = list_entry( pos, wiced_mqtt_session_item_t, list );
-        if ( ( ( type == MQTT_PACKET_TYPE_PUBLISH     ) && ( item->args.publish.packet_id     == packet_id ) ) ||
-             ( ( type == MQTT_PACKET_TYPE_SUBSCRIBE   ) && ( item->args.subscribe.packet_id   == packet_id ) ) ||
-             ( ( type == MQTT_PACKET_TYPE_UNSUBSCRIBE ) && ( item->args.unsubscribe.packet_id == packet_id ) ) ||
-             ( ( type == MQTT_PACKET_TYPE_PUBREC      ) && ( item->args.pubrec.packet_id      == packet_id ) ) ||
-             ( ( type == MQTT_PACKET_TYPE_PUBREL      ) && ( item->args.pubrel.packet_id      == packet_id ) ) )
-        {
-            /* Remove item from used lists */
-            list_del( &item->list );
-            /* Add Item to non used list */
-            list_add( &item->list, &session->nonused_list );
-
-            return WICED_SUCCESS;
-        }
+        chain = &session->items[ *chain ].next;
     }
-    /* No match */
-    return WICED_ERROR;
+    *chain = item->next;
+
+    /* Remove item from used lists */
+    list_del( &item->list );
+    /* Add Item to non used list */
+    list_add( &item->list, &session->nonused_list );
+    mqtt_session_count_item( type, -1, session );
+
+    return WICED_SUCCESS;
 }
 
 
 wiced_result_t mqtt_session_item_exist( mqtt_frame_type_t type, uint16_t packet_id, mqtt_session_t *session)
+{
+    return ( mqtt_session_find_item( type, packet_id, session ) != NULL ) ? WICED_SUCCESS : WICED_ERROR;
+}
+
+wiced_result_t mqtt_session_iterate_through_items( wiced_result_t (*iter_func)(mqtt_frame_type_t type, void *arg, void *p_user ), void* p_user, mqtt_session_t *session)
 {
     struct list_head *pos;
     wiced_mqtt_session_item_t *item = NULL;
+    wiced_time_t current_time;
 
     if ( list_empty( &session->used_list ) )
     {
-        return WICED_ERROR;
+        return WICED_SUCCESS;
     }
 
+    wiced_time_get_time( &current_time );
     list_for_each( pos, &session->used_list )
     {
         item = list_entry( pos, wiced_mqtt_session_item_t, list );
-        if ( ( ( type == MQTT_PACKET_TYPE_PUBLISH     ) && ( item->args.publish.packet_id == packet_id     ) ) ||
-             ( ( type == MQTT_PACKET_TYPE_SUBSCRIBE   ) && ( item->args.subscribe.packet_id == packet_id   ) ) ||
-             ( ( type == MQTT_PACKET_TYPE_UNSUBSCRIBE ) && ( item->args.unsubscribe.packet_id == packet_id ) ) ||
-             ( ( type == MQTT_PACKET_TYPE_PUBREC      ) && ( item->args.pubrec.packet_id == packet_id      ) ) ||
-             ( ( type == MQTT_PACKET_TYPE_PUBREL      ) && ( item->args.pubrel.packet_id == packet_id      ) ) )
+        if ( iter_func( item->type, &item->args, p_user ) != WICED_SUCCESS )
         {
-            return WICED_SUCCESS;
+            return WICED_ERROR;
         }
+        item->resend_time = current_time + MQTT_SESSION_RETRANSMIT_TIMEOUT;
+        session->statistics.retransmissions++;
     }
     /* No match */
-    return WICED_ERROR;
+    return WICED_SUCCESS;
 }
 
-wiced_result_t mqtt_session_iterate_through_items( wiced_result_t (*iter_func)(mqtt_frame_type_t type, void *arg, void *p_user ), void* p_user, mqtt_session_t *session)
+wiced_result_t mqtt_session_iterate_expired_items( wiced_result_t (*iter_func)(mqtt_frame_type_t type, void *arg, void *p_user ), void* p_user, mqtt_session_t *session)
 {
-    struct list_head *pos;
-    wiced_mqtt_session_item_t *item = NULL;
+    wiced_time_t current_time;
+    uint8_t count;
 
-    if ( list_empty( &session->used_list ) )
-    {
-        return WICED_SUCCESS;
-    }
+    wiced_time_get_time( &current_time );
 
-    list_for_each( pos, &session->used_list )
+    /* The list is in resend order, so stop at the first item not yet due. Each item is looked at once. */
+    for ( count = 0; ( count < MQTT_SESSION_WINDOW_SIZE ) && !list_empty( &session->used_list ); count++ )
     {
-        item = list_entry( pos, wiced_mqtt_session_item_t, list );
+        wiced_mqtt_session_item_t *item = list_entry( session->used_list.next, wiced_mqtt_session_item_t, list );
+
+        if ( (int32_t) ( current_time - item->resend_time ) < 0 )
+        {
+            break;
+        }
+
+        item->resend_time = current_time + MQTT_SESSION_RETRANSMIT_TIMEOUT;
+        list_move_tail( &item->list, &session->used_list );
+
+        /* The broker drives a received QoS 2 message on, so there is nothing to resend for it */
+        if ( item->type == MQTT_PACKET_TYPE_PUBREC )
+        {
+            continue;
+        }
         if ( iter_func( item->type, &item->args, p_user ) != WICED_SUCCESS )
         {
             return WICED_ERROR;
         }
+        session->statistics.retransmissions++;
     }
-    /* No match */
     return WICED_SUCCESS;
 }
@@ -30,7 +30,16 @@ extern "C" {
 /******************************************************
  *                    Constants
  ******************************************************/
-#define     SESSION_ITEMS_SIZE      (WICED_MQTT_QUEUE_SIZE * 2)
+#ifndef MQTT_SESSION_WINDOW_SIZE
+#define     MQTT_SESSION_WINDOW_SIZE            (32)        /* Messages in flight at once, at most 255 */
+#endif
+
+#ifndef MQTT_SESSION_RETRANSMIT_TIMEOUT
+#define     MQTT_SESSION_RETRANSMIT_TIMEOUT     (20000)     /* Milliseconds before an unacknowledged message is resent */
+#endif
+
+#define     MQTT_SESSION_HASH_SIZE              (64)        /* Packet identifier hash chains, a power of two */
+#define     MQTT_SESSION_NO_ITEM                (0xFF)
 
 /******************************************************
  *                   Enumerations
@@ -50,16 +59,21 @@ typedef union wiced_mqtt_session_item_agrs_u
 
 typedef struct mqtt_session_item_s
 {
-    struct list_head                list;
-    mqtt_frame_type_t         type;
+    struct list_head                list;           /* Position in the retransmit order, or in the free list */
+    mqtt_frame_type_t               type;
+    uint16_t                        packet_id;
+    uint8_t                         next;           /* Next item in the same hash chain */
+    wiced_time_t                    resend_time;
     wiced_mqtt_session_item_args_t  args;
 }wiced_mqtt_session_item_t;
 
 typedef struct mqtt_session_s
 {
-    struct list_head used_list;
+    struct list_head used_list;                     /* Items in the order they are due to be resent */
     struct list_head nonused_list;
-    wiced_mqtt_session_item_t items[SESSION_ITEMS_SIZE];
+    uint8_t          hash[MQTT_SESSION_HASH_SIZE];
+    wiced_mqtt_session_statistics_t statistics;
+    wiced_mqtt_session_item_t items[MQTT_SESSION_WINDOW_SIZE];
 }mqtt_session_t;
 /******************************************************
  *             Content Frame Type Definitions
@@ -85,6 +99,7 @@ wiced_result_t mqtt_session_add_item             ( mqtt_frame_type_t type, void
 wiced_result_t mqtt_session_remove_item          ( mqtt_frame_type_t type, uint16_t packet_id                   , mqtt_session_t *session );
 wiced_result_t mqtt_session_item_exist           ( mqtt_frame_type_t type, uint16_t packet_id                   , mqtt_session_t *session );
 wiced_result_t mqtt_session_iterate_through_items( wiced_result_t (*iter_func)(mqtt_frame_type_t type, void *arg , void *p_user ), void* p_user, mqtt_session_t *session);
+wiced_result_t mqtt_session_iterate_expired_items( wiced_result_t (*iter_func)(mqtt_frame_type_t type, void *arg , void *p_user ), void* p_user, mqtt_session_t *session);
 
 #ifdef __cplusplus
 } /* extern "C" */
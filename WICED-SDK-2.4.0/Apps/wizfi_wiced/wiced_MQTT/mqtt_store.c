@@ -0,0 +1,846 @@
+/*
+ * Copyright 2015, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  Offline publish store
+ *
+ *  Keeps messages published while the Broker is unreachable in an area of the
+ *  serial flash until they can be sent. Each sector of the area is a log: a
+ *  header giving the order the sector was started in, then records appended one
+ *  after the other. A record is only ever programmed once, apart from its state
+ *  byte which is cleared when the Broker acknowledges the message. A sector is
+ *  erased for reuse once it holds nothing undelivered, the least erased free
+ *  sector being taken first. The erase runs in the background as soon as the
+ *  sector is free, so a publish that needs a new sector does not wait for it.
+ *
+ *  The erase count half of the header is written as soon as the erase is done
+ *  and the sequence half when the sector is started, so a free sector keeps its
+ *  count across a restart and is not erased again.
+ *
+ *  Every record carries a CRC. A record damaged by a power loss while it was
+ *  being written fails the check at start-up; it is skipped along with the rest
+ *  of its sector, which then takes no more appends.
+ */
+
+#include <stddef.h>
+#include "wiced.h"
+#include "wiced_utilities.h"
+#include "mqtt_internal.h"
+#include "mqtt_store.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+#define MQTT_STORE_ALIGN( size )                        ( ( (size) + 3 ) & ~3 )
+#define MQTT_STORE_RECORD_SIZE( topic_length, data_length ) \
+    ( (uint32_t) MQTT_STORE_ALIGN( sizeof(mqtt_store_record_t) + (uint32_t) (topic_length) + (uint32_t) (data_length) ) )
+#define MQTT_STORE_SECTOR_ADDRESS( store, sector )      ( (store)->address + (uint32_t) (sector) * MQTT_STORE_SECTOR_SIZE )
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define MQTT_STORE_SECTOR_MAGIC         (0x5254534DUL)  /* "MSTR" */
+#define MQTT_STORE_RECORD_MAGIC         (0x5352)
+#define MQTT_STORE_ERASED_MAGIC         (0xFFFF)
+#define MQTT_STORE_ERASED_WORD          (0xFFFFFFFF)
+#define MQTT_STORE_RECORD_PENDING       (0xFF)
+#define MQTT_STORE_RECORD_DELIVERED     (0x00)
+#define MQTT_STORE_RECORD_QOS_MASK      (0x03)
+#define MQTT_STORE_RECORD_RETAIN        (0x04)
+#define MQTT_STORE_FIRST_RECORD         ( sizeof(mqtt_store_sector_header_t) )
+#define MQTT_STORE_CHECK_CHUNK          (64)
+#define MQTT_STORE_UNKNOWN_ERASE_COUNT  (0xFFFFFFFF)
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct
+{
+    uint32_t    magic;
+    uint32_t    erase_count;
+    uint32_t    erase_crc;          /* Over magic and erase_count, written once the sector is erased */
+    uint32_t    sequence;
+    uint32_t    sequence_crc;       /* Over sequence, written when the sector is started */
+} mqtt_store_sector_header_t;
+
+typedef struct
+{
+    uint16_t    magic;
+    uint8_t     state;              /* Cleared once delivered, so not covered by the CRC */
+    uint8_t     flags;              /* QoS and retain */
+    uint16_t    topic_length;
+    uint16_t    data_length;
+    uint32_t    crc;                /* Over flags, lengths, topic and data */
+} mqtt_store_record_t;
+
+/******************************************************
+ *               Static Function Declarations
+ ******************************************************/
+static uint32_t       mqtt_store_crc( uint32_t crc, const void *data, uint32_t length );
+static uint32_t       mqtt_store_record_crc( const mqtt_store_record_t *record );
+static wiced_result_t mqtt_store_check_record( mqtt_store_t *store, uint16_t sector, uint16_t offset, mqtt_store_record_t *record );
+static wiced_bool_t   mqtt_store_is_blank( mqtt_store_t *store, uint16_t sector, uint32_t offset );
+static void           mqtt_store_scan_sector( mqtt_store_t *store, uint16_t sector );
+static uint16_t       mqtt_store_oldest_sector( mqtt_store_t *store );
+static wiced_result_t mqtt_store_start_sector( mqtt_store_t *store );
+static int            mqtt_store_write_header( mqtt_store_t *store, uint16_t sector, wiced_bool_t start );
+static void           mqtt_store_mark_delivered( mqtt_store_t *store, uint16_t sector, uint16_t offset );
+static void           mqtt_store_count_erase( mqtt_store_t *store, uint16_t sector );
+static void           mqtt_store_erase_next( mqtt_store_t *store );
+static void           mqtt_store_erase_done( void *arg, int status );
+static wiced_bool_t   mqtt_store_may_send( mqtt_store_t *store );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static const uint32_t mqtt_store_crc_table[ 16 ] =
+{
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+wiced_result_t mqtt_store_init( mqtt_store_t *store, const wiced_mqtt_store_config_t *config )
+{
+    uint32_t sector_count = config->sflash_size / MQTT_STORE_SECTOR_SIZE;
+    uint32_t max_sequence = 0;
+    uint16_t newest       = MQTT_STORE_NO_SECTOR;
+    uint16_t sector;
+
+    if ( ( ( config->sflash_address % MQTT_STORE_SECTOR_SIZE ) != 0 ) || ( sector_count < 2 ) || ( sector_count >= MQTT_STORE_NO_SECTOR ) )
+    {
+        return WICED_BADARG;
+    }
+
+    memset( store, 0, sizeof( *store ) );
+    if ( init_sflash( &store->sflash, PLATFORM_SFLASH_PERIPHERAL_ID, SFLASH_WRITE_ALLOWED ) != 0 )
+    {
+        return WICED_ERROR;
+    }
+    store->sectors = (mqtt_store_sector_t*) malloc_named( "mqtt_store", sector_count * sizeof(mqtt_store_sector_t) );
+    if ( store->sectors == NULL )
+    {
+        return WICED_NOMEM;
+    }
+    if ( wiced_rtos_create_worker_thread( &store->erase_worker, MQTT_STORE_WORKER_PRIORITY, MQTT_STORE_WORKER_STACK_SIZE, MQTT_STORE_WORKER_QUEUE_SIZE ) != WICED_SUCCESS )
+    {
+        free( store->sectors );
+        store->sectors = NULL;
+        return WICED_ERROR;
+    }
+    if ( sflash_async_init( &store->flash, &store->sflash, &store->erase_worker ) != WICED_SUCCESS )
+    {
+        wiced_rtos_delete_worker_thread( &store->erase_worker );
+        free( store->sectors );
+        store->sectors = NULL;
+        return WICED_ERROR;
+    }
+    store->address         = config->sflash_address;
+    store->sector_count    = (uint16_t) sector_count;
+    store->write_sector    = MQTT_STORE_NO_SECTOR;
+    store->drain_sector    = MQTT_STORE_NO_SECTOR;
+    store->erase_sector    = MQTT_STORE_NO_SECTOR;
+    store->drop_oldest     = config->drop_oldest;
+    store->drain_rate      = config->drain_rate;
+    store->drain_credit    = (uint32_t) config->drain_rate * 1000;
+    wiced_time_get_time( &store->drain_time );
+
+    /* Rebuild the state of every sector from what is in flash */
+    for ( sector = 0; sector < store->sector_count; sector++ )
+    {
+        mqtt_store_sector_t *info = &store->sectors[ sector ];
+
+        mqtt_store_scan_sector( store, sector );
+        if ( info->erase_count != MQTT_STORE_UNKNOWN_ERASE_COUNT )
+        {
+            store->statistics.max_erase_count = MAX( store->statistics.max_erase_count, info->erase_count );
+        }
+        if ( info->state != MQTT_STORE_SECTOR_ACTIVE )
+        {
+            continue;
+        }
+        store->statistics.queued += info->records;
+        if ( ( newest == MQTT_STORE_NO_SECTOR ) || ( info->sequence > max_sequence ) )
+        {
+            newest       = sector;
+            max_sequence = info->sequence;
+        }
+    }
+    store->next_sequence = max_sequence + 1;
+
+    /* Appends carry on in the newest sector if it has room left */
+    if ( ( newest != MQTT_STORE_NO_SECTOR ) && ( store->sectors[ newest ].sealed == 0 ) )
+    {
+        store->write_sector = newest;
+    }
+    for ( sector = 0; sector < store->sector_count; sector++ )
+    {
+        mqtt_store_sector_t *info = &store->sectors[ sector ];
+
+        if ( ( info->state == MQTT_STORE_SECTOR_ACTIVE ) && ( info->records == 0 ) && ( sector != store->write_sector ) )
+        {
+            info->state = MQTT_STORE_SECTOR_FREE;
+        }
+
+        /* A sector whose header was lost is assumed to be as worn as the most worn one */
+        if ( info->erase_count == MQTT_STORE_UNKNOWN_ERASE_COUNT )
+        {
+            info->erase_count = store->statistics.max_erase_count;
+        }
+    }
+
+    if ( wiced_rtos_init_mutex( &store->mutex ) != WICED_SUCCESS )
+    {
+        sflash_async_deinit( &store->flash );
+        wiced_rtos_delete_worker_thread( &store->erase_worker );
+        free( store->sectors );
+        store->sectors = NULL;
+        return WICED_ERROR;
+    }
+
+    /* Free sectors found blank are used as they are, the others are erased in the background */
+    wiced_rtos_lock_mutex( &store->mutex );
+    mqtt_store_erase_next( store );
+    wiced_rtos_unlock_mutex( &store->mutex );
+    return WICED_SUCCESS;
+}
+
+void mqtt_store_deinit( mqtt_store_t *store )
+{
+    if ( store->sectors == NULL )
+    {
+        return;
+    }
+    sflash_async_deinit( &store->flash );
+    wiced_rtos_delete_worker_thread( &store->erase_worker );
+    wiced_rtos_deinit_mutex( &store->mutex );
+    if ( store->drain_buffer != NULL )
+    {
+        free( store->drain_buffer );
+    }
+    free( store->sectors );
+    memset( store, 0, sizeof( *store ) );
+}
+
+wiced_result_t mqtt_store_append( mqtt_store_t *store, const mqtt_publish_arg_t *args )
+{
+    mqtt_store_record_t record;
+    mqtt_store_sector_t *info;
+    uint32_t size = MQTT_STORE_RECORD_SIZE( args->topic.len, args->data_len );
+    uint32_t address;
+
+    if ( ( size > MQTT_STORE_SECTOR_SIZE - MQTT_STORE_FIRST_RECORD ) || ( ( args->data == NULL ) && ( args->data_len != 0 ) ) )
+    {
+        return WICED_BADARG;
+    }
+
+    record.magic        = MQTT_STORE_RECORD_MAGIC;
+    record.state        = MQTT_STORE_RECORD_PENDING;
+    record.flags        = (uint8_t) ( ( args->qos & MQTT_STORE_RECORD_QOS_MASK ) | ( ( args->retain != 0 ) ? MQTT_STORE_RECORD_RETAIN : 0 ) );
+    record.topic_length = args->topic.len;
+    record.data_length  = (uint16_t) args->data_len;
+    record.crc          = mqtt_store_record_crc( &record );
+    record.crc          = mqtt_store_crc( record.crc, args->topic.str, args->topic.len );
+    record.crc          = mqtt_store_crc( record.crc, args->data, args->data_len );
+
+    wiced_rtos_lock_mutex( &store->mutex );
+    info = ( store->write_sector != MQTT_STORE_NO_SECTOR ) ? &store->sectors[ store->write_sector ] : NULL;
+    if ( ( info == NULL ) || ( info->sealed != 0 ) || ( info->end_offset + size > MQTT_STORE_SECTOR_SIZE ) )
+    {
+        if ( mqtt_store_start_sector( store ) != WICED_SUCCESS )
+        {
+            wiced_rtos_unlock_mutex( &store->mutex );
+            return WICED_ERROR;
+        }
+        info = &store->sectors[ store->write_sector ];
+    }
+
+    /* The header goes first: should power fail part way, the damaged record is found at start-up */
+    address = MQTT_STORE_SECTOR_ADDRESS( store, store->write_sector ) + info->end_offset;
+    sflash_async_lock( &store->flash );
+    if ( ( sflash_write( &store->sflash, address, &record, sizeof( record ) ) != 0 ) ||
+         ( sflash_write( &store->sflash, address + sizeof( record ), args->topic.str, args->topic.len ) != 0 ) ||
+         ( sflash_write( &store->sflash, address + sizeof( record ) + args->topic.len, args->data, (int) args->data_len ) != 0 ) )
+    {
+        sflash_async_unlock( &store->flash );
+        info->sealed = 1;
+        wiced_rtos_unlock_mutex( &store->mutex );
+        return WICED_ERROR;
+    }
+    sflash_async_unlock( &store->flash );
+
+    /* Only now, so that the record is not held up behind it: a sector left behind may have become free */
+    mqtt_store_erase_next( store );
+
+    if ( info->records == 0 )
+    {
+        info->read_offset = info->end_offset;
+    }
+    info->records++;
+    info->end_offset = (uint16_t) ( info->end_offset + size );
+    store->statistics.stored++;
+    store->statistics.queued++;
+    wiced_rtos_unlock_mutex( &store->mutex );
+    return WICED_SUCCESS;
+}
+
+/*
+ * Reads the oldest undelivered message into a buffer held by the store until
+ * mqtt_store_release() or mqtt_store_cancel() is called. Returns WICED_PENDING
+ * while the message read last is still held or the drain rate allows no more
+ * just now, and WICED_NOTFOUND when nothing is queued.
+ */
+wiced_result_t mqtt_store_read( mqtt_store_t *store, mqtt_publish_arg_t *args )
+{
+    mqtt_store_record_t record;
+    uint16_t sector;
+    uint16_t offset;
+    uint32_t address;
+    uint8_t *buffer;
+
+    wiced_rtos_lock_mutex( &store->mutex );
+    if ( store->drain_buffer != NULL )
+    {
+        wiced_rtos_unlock_mutex( &store->mutex );
+        return WICED_PENDING;
+    }
+    if ( store->statistics.queued == 0 )
+    {
+        wiced_rtos_unlock_mutex( &store->mutex );
+        return WICED_NOTFOUND;
+    }
+    if ( mqtt_store_may_send( store ) == WICED_FALSE )
+    {
+        wiced_rtos_unlock_mutex( &store->mutex );
+        return WICED_PENDING;
+    }
+    while ( ( sector = mqtt_store_oldest_sector( store ) ) != MQTT_STORE_NO_SECTOR )
+    {
+        offset  = store->sectors[ sector ].read_offset;
+        address = MQTT_STORE_SECTOR_ADDRESS( store, sector ) + offset;
+        sflash_async_read( &store->flash, address, &record, sizeof( record ) );
+
+        /* Checked when written or at start-up, so a bad record here means the flash itself has failed */
+        if ( ( record.magic != MQTT_STORE_RECORD_MAGIC ) ||
+             ( offset + MQTT_STORE_RECORD_SIZE( record.topic_length, record.data_length ) > MQTT_STORE_SECTOR_SIZE ) )
+        {
+            store->statistics.corrupted++;
+            mqtt_store_mark_delivered( store, sector, offset );
+            continue;
+        }
+
+        buffer = (uint8_t*) malloc_named( "mqtt_store", (uint32_t) record.topic_length + record.data_length + 1 );
+        if ( buffer == NULL )
+        {
+            wiced_rtos_unlock_mutex( &store->mutex );
+            return WICED_NOMEM;
+        }
+        sflash_async_read( &store->flash, address + sizeof( record ), buffer, (unsigned int) record.topic_length + record.data_length );
+
+        if ( mqtt_store_crc( mqtt_store_record_crc( &record ), buffer, (uint32_t) record.topic_length + record.data_length ) != record.crc )
+        {
+            free( buffer );
+            store->statistics.corrupted++;
+            mqtt_store_mark_delivered( store, sector, offset );
+            continue;
+        }
+
+        memset( args, 0, sizeof( *args ) );
+        args->topic.str = buffer;
+        args->topic.len = record.topic_length;
+        args->data      = buffer + record.topic_length;
+        args->data_len  = record.data_length;
+        args->qos       = (mqtt_qos_t) ( record.flags & MQTT_STORE_RECORD_QOS_MASK );
+        args->retain    = ( record.flags & MQTT_STORE_RECORD_RETAIN ) ? 1 : 0;
+
+        store->drain_buffer = buffer;
+        store->drain_sector = sector;
+        store->drain_offset = offset;
+        wiced_rtos_unlock_mutex( &store->mutex );
+        return WICED_SUCCESS;
+    }
+    wiced_rtos_unlock_mutex( &store->mutex );
+    return WICED_NOTFOUND;
+}
+
+/* The message read last has been delivered */
+void mqtt_store_release( mqtt_store_t *store )
+{
+    wiced_rtos_lock_mutex( &store->mutex );
+
+    /* The sector is gone if it was erased to make room while the message was in flight */
+    if ( store->drain_sector != MQTT_STORE_NO_SECTOR )
+    {
+        mqtt_store_mark_delivered( store, store->drain_sector, store->drain_offset );
+        store->statistics.delivered++;
+    }
+    wiced_rtos_unlock_mutex( &store->mutex );
+    mqtt_store_cancel( store );
+}
+
+/* The message read last was not delivered; it is read again next time */
+void mqtt_store_cancel( mqtt_store_t *store )
+{
+    wiced_rtos_lock_mutex( &store->mutex );
+    if ( store->drain_buffer != NULL )
+    {
+        free( store->drain_buffer );
+        store->drain_buffer = NULL;
+    }
+    store->drain_sector = MQTT_STORE_NO_SECTOR;
+    wiced_rtos_unlock_mutex( &store->mutex );
+}
+
+/* Token bucket allowing drain_rate messages a second, in bursts of up to a second's worth. Called with the mutex held */
+static wiced_bool_t mqtt_store_may_send( mqtt_store_t *store )
+{
+    wiced_time_t now;
+    uint32_t elapsed;
+
+    if ( store->drain_rate == 0 )
+    {
+        return WICED_TRUE;
+    }
+    wiced_time_get_time( &now );
+    elapsed = MIN( (uint32_t) ( now - store->drain_time ), 1000 );
+    store->drain_time   = now;
+    store->drain_credit = MIN( store->drain_credit + elapsed * store->drain_rate, (uint32_t) store->drain_rate * 1000 );
+    if ( store->drain_credit < 1000 )
+    {
+        return WICED_FALSE;
+    }
+    store->drain_credit -= 1000;
+    return WICED_TRUE;
+}
+
+/* CRC-32 (IEEE 802.3), a nibble at a time to keep the table small */
+static uint32_t mqtt_store_crc( uint32_t crc, const void *data, uint32_t length )
+{
+    const uint8_t *bytes = (const uint8_t*) data;
+
+    crc = ~crc;
+    while ( length-- > 0 )
+    {
+        crc ^= *bytes++;
+        crc = ( crc >> 4 ) ^ mqtt_store_crc_table[ crc & 0x0F ];
+        crc = ( crc >> 4 ) ^ mqtt_store_crc_table[ crc & 0x0F ];
+    }
+    return ~crc;
+}
+
+static uint32_t mqtt_store_record_crc( const mqtt_store_record_t *record )
+{
+    return mqtt_store_crc( 0, &record->flags, offsetof( mqtt_store_record_t, crc ) - offsetof( mqtt_store_record_t, flags ) );
+}
+
+/*
+ * Returns WICED_SUCCESS for a good record, WICED_NOTFOUND where nothing has been
+ * written yet and WICED_ERROR for a damaged record.
+ */
+static wiced_result_t mqtt_store_check_record( mqtt_store_t *store, uint16_t sector, uint16_t offset, mqtt_store_record_t *record )
+{
+    uint8_t  chunk[ MQTT_STORE_CHECK_CHUNK ];
+    uint32_t address = MQTT_STORE_SECTOR_ADDRESS( store, sector ) + offset;
+    uint32_t remaining;
+    uint32_t crc;
+
+    sflash_async_read( &store->flash, address, record, sizeof( *record ) );
+    if ( record->magic == MQTT_STORE_ERASED_MAGIC )
+    {
+        const uint8_t *bytes = (const uint8_t*) record;
+        uint32_t index;
+
+        for ( index = 0; index < sizeof( *record ); index++ )
+        {
+            if ( bytes[ index ] != 0xFF )
+            {
+                return WICED_ERROR;
+            }
+        }
+        return WICED_NOTFOUND;
+    }
+    if ( ( record->magic != MQTT_STORE_RECORD_MAGIC ) ||
+         ( offset + MQTT_STORE_RECORD_SIZE( record->topic_length, record->data_length ) > MQTT_STORE_SECTOR_SIZE ) )
+    {
+        return WICED_ERROR;
+    }
+
+    crc = mqtt_store_record_crc( record );
+    address += sizeof( *record );
+    for ( remaining = (uint32_t) record->topic_length + record->data_length; remaining > 0; )
+    {
+        uint32_t size = MIN( remaining, sizeof( chunk ) );
+
+        sflash_async_read( &store->flash, address, chunk, size );
+        crc = mqtt_store_crc( crc, chunk, size );
+        address   += size;
+        remaining -= size;
+    }
+    return ( crc == record->crc ) ? WICED_SUCCESS : WICED_ERROR;
+}
+
+/* Whether the sector reads as erased from offset to its end */
+static wiced_bool_t mqtt_store_is_blank( mqtt_store_t *store, uint16_t sector, uint32_t offset )
+{
+    uint8_t  chunk[ MQTT_STORE_CHECK_CHUNK ];
+    uint32_t index;
+    uint32_t size;
+
+    for ( ; offset < MQTT_STORE_SECTOR_SIZE; offset += size )
+    {
+        size = MIN( MQTT_STORE_SECTOR_SIZE - offset, sizeof( chunk ) );
+        sflash_async_read( &store->flash, MQTT_STORE_SECTOR_ADDRESS( store, sector ) + offset, chunk, size );
+        for ( index = 0; index < size; index++ )
+        {
+            if ( chunk[ index ] != 0xFF )
+            {
+                return WICED_FALSE;
+            }
+        }
+    }
+    return WICED_TRUE;
+}
+
+static void mqtt_store_scan_sector( mqtt_store_t *store, uint16_t sector )
+{
+    mqtt_store_sector_t *info = &store->sectors[ sector ];
+    mqtt_store_sector_header_t header;
+    mqtt_store_record_t record;
+    uint16_t offset = MQTT_STORE_FIRST_RECORD;
+    wiced_result_t result;
+
+    memset( info, 0, sizeof( *info ) );
+    info->state       = MQTT_STORE_SECTOR_FREE;
+    info->erase_count = MQTT_STORE_UNKNOWN_ERASE_COUNT;
+
+    sflash_async_read( &store->flash, MQTT_STORE_SECTOR_ADDRESS( store, sector ), &header, sizeof( header ) );
+    if ( ( header.magic != MQTT_STORE_SECTOR_MAGIC ) || ( header.erase_crc != mqtt_store_crc( 0, &header, offsetof( mqtt_store_sector_header_t, erase_crc ) ) ) )
+    {
+        /* Never used, or the erase or the header write was cut short */
+        info->erased = ( mqtt_store_is_blank( store, sector, 0 ) == WICED_TRUE ) ? 1 : 0;
+        return;
+    }
+    info->erase_count = header.erase_count;
+
+    /* The CRC of an erased sequence is itself all ones, so that is checked for first */
+    if ( ( header.sequence == MQTT_STORE_ERASED_WORD ) || ( header.sequence_crc != mqtt_store_crc( 0, &header.sequence, sizeof( header.sequence ) ) ) )
+    {
+        /* Erased and not started since, unless starting it was cut short */
+        if ( ( header.sequence == MQTT_STORE_ERASED_WORD ) && ( header.sequence_crc == MQTT_STORE_ERASED_WORD ) && ( mqtt_store_is_blank( store, sector, offset ) == WICED_TRUE ) )
+        {
+            info->erased  = 1;
+            info->counted = 1;
+        }
+        return;
+    }
+    info->state       = MQTT_STORE_SECTOR_ACTIVE;
+    info->sequence    = header.sequence;
+    info->end_offset  = offset;
+
+    while ( offset + sizeof( record ) <= MQTT_STORE_SECTOR_SIZE )
+    {
+        result = mqtt_store_check_record( store, sector, offset, &record );
+        if ( result == WICED_NOTFOUND )
+        {
+            return;
+        }
+        if ( result != WICED_SUCCESS )
+        {
+            /* Where the next record would start cannot be trusted, so the sector takes no more appends */
+            info->sealed = 1;
+            store->statistics.corrupted++;
+            return;
+        }
+        if ( record.state == MQTT_STORE_RECORD_PENDING )
+        {
+            if ( info->records == 0 )
+            {
+                info->read_offset = offset;
+            }
+            info->records++;
+        }
+        offset = (uint16_t) ( offset + MQTT_STORE_RECORD_SIZE( record.topic_length, record.data_length ) );
+        info->end_offset = offset;
+    }
+    info->sealed = 1;
+}
+
+static uint16_t mqtt_store_oldest_sector( mqtt_store_t *store )
+{
+    uint16_t oldest = MQTT_STORE_NO_SECTOR;
+    uint16_t sector;
+
+    for ( sector = 0; sector < store->sector_count; sector++ )
+    {
+        const mqtt_store_sector_t *info = &store->sectors[ sector ];
+
+        if ( ( info->state == MQTT_STORE_SECTOR_ACTIVE ) && ( info->records > 0 ) &&
+             ( ( oldest == MQTT_STORE_NO_SECTOR ) || ( info->sequence < store->sectors[ oldest ].sequence ) ) )
+        {
+            oldest = sector;
+        }
+    }
+    return oldest;
+}
+
+static wiced_result_t mqtt_store_start_sector( mqtt_store_t *store )
+{
+    mqtt_store_sector_t *info;
+    uint16_t chosen = MQTT_STORE_NO_SECTOR;
+    uint16_t sector;
+
+    /* The sector being left takes no more appends, and is free as soon as everything in it is delivered */
+    if ( store->write_sector != MQTT_STORE_NO_SECTOR )
+    {
+        info = &store->sectors[ store->write_sector ];
+        info->sealed = 1;
+        if ( info->records == 0 )
+        {
+            info->state = MQTT_STORE_SECTOR_FREE;
+        }
+        store->write_sector = MQTT_STORE_NO_SECTOR;
+    }
+
+    /* Of the free sectors take one already erased, then the one erased least often */
+    for ( sector = 0; sector < store->sector_count; sector++ )
+    {
+        const mqtt_store_sector_t *candidate = &store->sectors[ sector ];
+
+        if ( ( candidate->state == MQTT_STORE_SECTOR_FREE ) &&
+             ( ( chosen == MQTT_STORE_NO_SECTOR ) ||
+               ( candidate->erased > store->sectors[ chosen ].erased ) ||
+               ( ( candidate->erased == store->sectors[ chosen ].erased ) && ( candidate->erase_count < store->sectors[ chosen ].erase_count ) ) ) )
+        {
+            chosen = sector;
+        }
+    }
+
+    /* Failing that the one being erased, rather than wait for that erase and then erase another */
+    if ( ( chosen != MQTT_STORE_NO_SECTOR ) && ( store->sectors[ chosen ].erased == 0 ) &&
+         ( store->erase_sector != MQTT_STORE_NO_SECTOR ) && ( store->sectors[ store->erase_sector ].state == MQTT_STORE_SECTOR_FREE ) )
+    {
+        chosen = store->erase_sector;
+    }
+
+    if ( chosen == MQTT_STORE_NO_SECTOR )
+    {
+        if ( store->drop_oldest == WICED_FALSE )
+        {
+            return WICED_ERROR;
+        }
+        chosen = mqtt_store_oldest_sector( store );
+        if ( chosen == MQTT_STORE_NO_SECTOR )
+        {
+            return WICED_ERROR;
+        }
+        info = &store->sectors[ chosen ];
+        store->statistics.dropped += info->records;
+        store->statistics.queued  -= info->records;
+        info->records = 0;
+        info->state   = MQTT_STORE_SECTOR_FREE;
+
+        /* An acknowledgement for the message in flight no longer has a record to mark */
+        if ( store->drain_sector == chosen )
+        {
+            store->drain_sector = MQTT_STORE_NO_SECTOR;
+        }
+    }
+
+    info = &store->sectors[ chosen ];
+    info->sequence = store->next_sequence++;
+
+    /* A background erase of this sector that has not begun is done here instead */
+    if ( ( chosen == store->erase_sector ) && ( sflash_async_cancel( &store->flash, &store->erase_request ) == WICED_SUCCESS ) )
+    {
+        info->erase_count--;
+        store->erase_sector = MQTT_STORE_NO_SECTOR;
+    }
+
+    /* Waits for any erase in progress, so one of this sector that has begun is complete after this */
+    sflash_async_lock( &store->flash );
+
+    /* Erased here unless found blank or erased in the background */
+    if ( ( info->erased == 0 ) && ( ( chosen != store->erase_sector ) || ( store->erase_request.status != 0 ) ) )
+    {
+        mqtt_store_count_erase( store, chosen );
+        if ( sflash_sector_erase( &store->sflash, MQTT_STORE_SECTOR_ADDRESS( store, chosen ) ) != 0 )
+        {
+            sflash_async_unlock( &store->flash );
+            return WICED_ERROR;
+        }
+    }
+    /* Including an erase that finished in the background but whose count is not written yet */
+    if ( info->erased == 0 )
+    {
+        info->counted = 0;
+    }
+
+    if ( mqtt_store_write_header( store, chosen, WICED_TRUE ) != 0 )
+    {
+        sflash_async_unlock( &store->flash );
+        return WICED_ERROR;
+    }
+    sflash_async_unlock( &store->flash );
+
+    info->state      = MQTT_STORE_SECTOR_ACTIVE;
+    info->end_offset = MQTT_STORE_FIRST_RECORD;
+    info->records    = 0;
+    info->sealed     = 0;
+    info->erased     = 0;
+    info->counted    = 0;
+    store->write_sector = chosen;
+    return WICED_SUCCESS;
+}
+
+/*
+ * Writes the erase count half of the header of a blank sector, or to start the
+ * sector, whichever halves are still missing. Called with the chip held.
+ */
+static int mqtt_store_write_header( mqtt_store_t *store, uint16_t sector, wiced_bool_t start )
+{
+    const mqtt_store_sector_t *info = &store->sectors[ sector ];
+    mqtt_store_sector_header_t header;
+    uint32_t address = MQTT_STORE_SECTOR_ADDRESS( store, sector );
+    uint32_t begin   = ( info->counted != 0 ) ? offsetof( mqtt_store_sector_header_t, sequence ) : 0;
+    uint32_t end     = ( start == WICED_TRUE ) ? sizeof( header ) : offsetof( mqtt_store_sector_header_t, sequence );
+
+    header.magic        = MQTT_STORE_SECTOR_MAGIC;
+    header.erase_count  = info->erase_count;
+    header.erase_crc    = mqtt_store_crc( 0, &header, offsetof( mqtt_store_sector_header_t, erase_crc ) );
+    header.sequence     = info->sequence;
+    header.sequence_crc = mqtt_store_crc( 0, &header.sequence, sizeof( header.sequence ) );
+
+    if ( begin >= end )
+    {
+        return 0;
+    }
+    return sflash_write( &store->sflash, address + begin, (const uint8_t*) &header + begin, (int) ( end - begin ) );
+}
+
+static void mqtt_store_mark_delivered( mqtt_store_t *store, uint16_t sector, uint16_t offset )
+{
+    mqtt_store_sector_t *info = &store->sectors[ sector ];
+    uint32_t address = MQTT_STORE_SECTOR_ADDRESS( store, sector );
+    const uint8_t delivered = MQTT_STORE_RECORD_DELIVERED;
+    mqtt_store_record_t record;
+
+    /* Only clears bits, so no erase is needed; a write cut short leaves the message to be sent again */
+    sflash_async_write( &store->flash, address + offset + offsetof( mqtt_store_record_t, state ), &delivered, sizeof( delivered ) );
+    info->records--;
+    store->statistics.queued--;
+
+    if ( info->records == 0 )
+    {
+        if ( sector != store->write_sector )
+        {
+            info->state = MQTT_STORE_SECTOR_FREE;
+            mqtt_store_erase_next( store );
+        }
+        return;
+    }
+
+    /* Messages are delivered in order, so the next undelivered record follows this one */
+    do
+    {
+        sflash_async_read( &store->flash, address + offset, &record, sizeof( record ) );
+        offset = (uint16_t) ( offset + MQTT_STORE_RECORD_SIZE( record.topic_length, record.data_length ) );
+        sflash_async_read( &store->flash, address + offset, &record, sizeof( record ) );
+    } while ( ( offset < info->end_offset ) && ( record.state != MQTT_STORE_RECORD_PENDING ) );
+    info->read_offset = offset;
+}
+
+static void mqtt_store_count_erase( mqtt_store_t *store, uint16_t sector )
+{
+    mqtt_store_sector_t *info = &store->sectors[ sector ];
+
+    info->erase_count++;
+    store->statistics.max_erase_count = MAX( store->statistics.max_erase_count, info->erase_count );
+}
+
+/* Starts erasing the least worn free sector not known to be blank, unless an erase is already under way */
+static void mqtt_store_erase_next( mqtt_store_t *store )
+{
+    uint16_t chosen = MQTT_STORE_NO_SECTOR;
+    uint16_t sector;
+
+    if ( store->erase_sector != MQTT_STORE_NO_SECTOR )
+    {
+        return;
+    }
+    for ( sector = 0; sector < store->sector_count; sector++ )
+    {
+        const mqtt_store_sector_t *info = &store->sectors[ sector ];
+
+        if ( ( info->state == MQTT_STORE_SECTOR_FREE ) && ( info->erased == 0 ) &&
+             ( ( chosen == MQTT_STORE_NO_SECTOR ) || ( info->erase_count < store->sectors[ chosen ].erase_count ) ) )
+        {
+            chosen = sector;
+        }
+    }
+    if ( chosen == MQTT_STORE_NO_SECTOR )
+    {
+        return;
+    }
+
+    mqtt_store_count_erase( store, chosen );
+    store->erase_sector = chosen;
+    sflash_async_sector_erase( &store->flash, &store->erase_request, MQTT_STORE_SECTOR_ADDRESS( store, chosen ), mqtt_store_erase_done, store );
+}
+
+/* Runs on the store's own worker thread, which may wait here while a publish erases a sector itself */
+static void mqtt_store_erase_done( void *arg, int status )
+{
+    mqtt_store_t *store = (mqtt_store_t*) arg;
+    mqtt_store_sector_t *info;
+    uint16_t sector;
+
+    wiced_rtos_lock_mutex( &store->mutex );
+    sector = store->erase_sector;
+    store->erase_sector = MQTT_STORE_NO_SECTOR;
+
+    /* The sector may have been started meanwhile, after waiting for this erase to finish */
+    if ( ( sector != MQTT_STORE_NO_SECTOR ) && ( store->sectors[ sector ].state == MQTT_STORE_SECTOR_FREE ) )
+    {
+        info = &store->sectors[ sector ];
+        if ( status != 0 )
+        {
+            /* Left to be erased when the sector is started */
+            info->erase_count--;
+        }
+        else
+        {
+            /* Recorded at once, so the count survives a restart before the sector is used */
+            sflash_async_lock( &store->flash );
+            status = mqtt_store_write_header( store, sector, WICED_FALSE );
+            sflash_async_unlock( &store->flash );
+            if ( status == 0 )
+            {
+                info->erased  = 1;
+                info->counted = 1;
+            }
+        }
+    }
+    if ( status == 0 )
+    {
+        mqtt_store_erase_next( store );
+    }
+    wiced_rtos_unlock_mutex( &store->mutex );
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2015, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  Offline publish store.
+ *
+ *  Internal types not to be included directly by applications.
+ */
+#pragma once
+
+#include "wiced.h"
+#include "spi_flash.h"
+#include "spi_flash_async.h"
+#include "mqtt_common.h"
+#include "mqtt_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define MQTT_STORE_SECTOR_SIZE          (4096)      /* Serial flash erase unit */
+#define MQTT_STORE_NO_SECTOR            (0xFFFF)
+
+/* Thread the background erases are polled and completed on */
+#ifndef MQTT_STORE_WORKER_PRIORITY
+#define MQTT_STORE_WORKER_PRIORITY      (WICED_DEFAULT_WORKER_PRIORITY)
+#endif
+#define MQTT_STORE_WORKER_STACK_SIZE    (1024)
+#define MQTT_STORE_WORKER_QUEUE_SIZE    (2)
+
+#ifndef PLATFORM_SFLASH_PERIPHERAL_ID
+#define PLATFORM_SFLASH_PERIPHERAL_ID   (0)
+#endif
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+typedef enum
+{
+    MQTT_STORE_SECTOR_FREE,                     /* Holds nothing undelivered, erased before reuse */
+    MQTT_STORE_SECTOR_ACTIVE,                   /* Written since its last erase                   */
+} mqtt_store_sector_state_t;
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/* RAM copy of what the sector holds, rebuilt from flash by mqtt_store_init() */
+typedef struct
+{
+    uint32_t                        sequence;           /* Order in which sectors were started */
+    uint32_t                        erase_count;
+    uint16_t                        end_offset;         /* End of the last good record */
+    uint16_t                        read_offset;        /* First undelivered record, valid while records > 0 */
+    uint16_t                        records;            /* Undelivered records */
+    uint8_t                         state;
+    uint8_t                         sealed;             /* No more appends, the sector is full or its tail is damaged */
+    uint8_t                         erased;             /* Free and blank, so ready to be started */
+    uint8_t                         counted;            /* Erase count written since the last erase */
+} mqtt_store_sector_t;
+
+typedef struct
+{
+    sflash_handle_t                 sflash;
+    sflash_async_t                  flash;              /* Every access to sflash goes through here */
+    wiced_worker_thread_t           erase_worker;       /* Its own, as completing an erase waits for the mutex */
+    sflash_async_erase_t            erase_request;
+    uint16_t                        erase_sector;       /* Free sector being erased in the background */
+    wiced_mutex_t                   mutex;
+    uint32_t                        address;
+    uint16_t                        sector_count;
+    uint16_t                        write_sector;
+    uint32_t                        next_sequence;
+    wiced_bool_t                    drop_oldest;
+    mqtt_store_sector_t*            sectors;
+    wiced_mqtt_store_statistics_t   statistics;
+
+    /* Message being drained; only one is in flight at a time so they are delivered in order.
+     * drain_packet_id is only used from the MQTT thread, the rest under the mutex. */
+    uint16_t                        drain_rate;
+    uint32_t                        drain_credit;       /* Thousandths of a message that may be sent now */
+    wiced_time_t                    drain_time;
+    uint16_t                        drain_packet_id;
+    uint16_t                        drain_sector;
+    uint16_t                        drain_offset;
+    uint8_t*                        drain_buffer;
+} mqtt_store_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+wiced_result_t mqtt_store_init    ( mqtt_store_t *store, const wiced_mqtt_store_config_t *config );
+void           mqtt_store_deinit  ( mqtt_store_t *store );
+wiced_result_t mqtt_store_append  ( mqtt_store_t *store, const mqtt_publish_arg_t *args );
+wiced_result_t mqtt_store_read    ( mqtt_store_t *store, mqtt_publish_arg_t *args );
+void           mqtt_store_release ( mqtt_store_t *store );
+void           mqtt_store_cancel  ( mqtt_store_t *store );
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
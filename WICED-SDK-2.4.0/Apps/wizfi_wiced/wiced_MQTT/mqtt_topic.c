@@ -0,0 +1,426 @@
+/*
+ * Copyright 2015, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  Topic filter tree
+ *
+ *  Holds the topic filters subscribed to, one node per level, and matches the
+ *  topic of a received PUBLISH against them following the MQTT 3.1.1 wildcard
+ *  rules. Children are looked up through a hash table keyed on the parent node
+ *  and level name, so matching costs a few lookups per topic level however many
+ *  filters are subscribed.
+ */
+
+#include "wiced.h"
+#include "mqtt_topic.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define MQTT_TOPIC_LEVEL_SEPARATOR      '/'
+#define MQTT_TOPIC_SINGLE_LEVEL         '+'
+#define MQTT_TOPIC_MULTI_LEVEL          '#'
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/******************************************************
+ *               Static Function Declarations
+ ******************************************************/
+static uint32_t           mqtt_topic_hash( const mqtt_topic_node_t *parent, const uint8_t *level, uint16_t length );
+static mqtt_topic_node_t* mqtt_topic_find_child( mqtt_topic_tree_t *tree, mqtt_topic_node_t *parent, const uint8_t *level, uint16_t length );
+static mqtt_topic_node_t* mqtt_topic_add_child( mqtt_topic_tree_t *tree, mqtt_topic_node_t *parent, const uint8_t *level, uint16_t length );
+static void               mqtt_topic_grow( mqtt_topic_tree_t *tree );
+static void               mqtt_topic_prune( mqtt_topic_tree_t *tree, mqtt_topic_node_t *node );
+static mqtt_topic_node_t* mqtt_topic_find_filter( mqtt_topic_tree_t *tree, const uint8_t *filter, uint16_t filter_length );
+static wiced_result_t     mqtt_topic_validate_filter( const uint8_t *filter, uint16_t filter_length );
+static uint32_t           mqtt_topic_deliver( mqtt_topic_node_t *node, wiced_mqtt_object_t mqtt_object, wiced_mqtt_topic_msg_t *message );
+static uint32_t           mqtt_topic_match( mqtt_topic_tree_t *tree, mqtt_topic_node_t *node, const uint8_t *level, const uint8_t *end, wiced_mqtt_object_t mqtt_object, wiced_mqtt_topic_msg_t *message );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static const uint8_t single_level_wildcard[] = { MQTT_TOPIC_SINGLE_LEVEL };
+static const uint8_t multi_level_wildcard[]  = { MQTT_TOPIC_MULTI_LEVEL };
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+wiced_result_t mqtt_topic_tree_init( mqtt_topic_tree_t *tree )
+{
+    memset( tree, 0, sizeof( *tree ) );
+    tree->buckets = (mqtt_topic_node_t**) malloc_named( "mqtt_topic", MQTT_TOPIC_INITIAL_BUCKETS * sizeof(mqtt_topic_node_t*) );
+    if ( tree->buckets == NULL )
+    {
+        return WICED_NOMEM;
+    }
+    memset( tree->buckets, 0, MQTT_TOPIC_INITIAL_BUCKETS * sizeof(mqtt_topic_node_t*) );
+    tree->bucket_count = MQTT_TOPIC_INITIAL_BUCKETS;
+    return WICED_SUCCESS;
+}
+
+void mqtt_topic_tree_deinit( mqtt_topic_tree_t *tree )
+{
+    uint32_t bucket;
+
+    if ( tree->buckets == NULL )
+    {
+        return;
+    }
+    for ( bucket = 0; bucket < tree->bucket_count; bucket++ )
+    {
+        while ( tree->buckets[ bucket ] != NULL )
+        {
+            mqtt_topic_node_t *node = tree->buckets[ bucket ];
+            tree->buckets[ bucket ] = node->hash_next;
+            while ( node->subscriptions != NULL )
+            {
+                mqtt_topic_subscription_t *subscription = node->subscriptions;
+                node->subscriptions = subscription->next;
+                free( subscription );
+            }
+            free( node );
+        }
+    }
+    while ( tree->root.subscriptions != NULL )
+    {
+        mqtt_topic_subscription_t *subscription = tree->root.subscriptions;
+        tree->root.subscriptions = subscription->next;
+        free( subscription );
+    }
+    free( tree->buckets );
+    memset( tree, 0, sizeof( *tree ) );
+}
+
+wiced_result_t mqtt_topic_tree_add( mqtt_topic_tree_t *tree, const uint8_t *filter, uint16_t filter_length, wiced_mqtt_message_callback_t callback, void *arg )
+{
+    mqtt_topic_node_t *node = &tree->root;
+    mqtt_topic_subscription_t *subscription;
+    const uint8_t *level = filter;
+    const uint8_t *end   = filter + filter_length;
+
+    WICED_VERIFY( mqtt_topic_validate_filter( filter, filter_length ) );
+    if ( tree->buckets == NULL )
+    {
+        return WICED_NOTUP;
+    }
+
+    /* Walk down the tree, creating the levels that are missing */
+    while ( level != NULL )
+    {
+        const uint8_t *level_end = memchr( level, MQTT_TOPIC_LEVEL_SEPARATOR, (size_t) ( end - level ) );
+        mqtt_topic_node_t *child;
+
+        if ( level_end == NULL )
+        {
+            level_end = end;
+        }
+        child = mqtt_topic_find_child( tree, node, level, (uint16_t) ( level_end - level ) );
+        if ( child == NULL )
+        {
+            child = mqtt_topic_add_child( tree, node, level, (uint16_t) ( level_end - level ) );
+            if ( child == NULL )
+            {
+                mqtt_topic_prune( tree, node );
+                return WICED_NOMEM;
+            }
+        }
+        node  = child;
+        level = ( level_end < end ) ? level_end + 1 : NULL;
+    }
+
+    /* The Broker keeps one subscription per filter, so subscribing again to the same filter
+     * replaces the callback of the earlier subscription rather than adding a second one */
+    if ( node->subscriptions != NULL )
+    {
+        node->subscriptions->callback = callback;
+        node->subscriptions->arg      = arg;
+        return WICED_SUCCESS;
+    }
+
+    subscription = (mqtt_topic_subscription_t*) malloc_named( "mqtt_topic", sizeof(mqtt_topic_subscription_t) );
+    if ( subscription == NULL )
+    {
+        mqtt_topic_prune( tree, node );
+        return WICED_NOMEM;
+    }
+    subscription->callback = callback;
+    subscription->arg      = arg;
+    subscription->next     = NULL;
+    node->subscriptions    = subscription;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t mqtt_topic_tree_remove( mqtt_topic_tree_t *tree, const uint8_t *filter, uint16_t filter_length )
+{
+    mqtt_topic_node_t *node = mqtt_topic_find_filter( tree, filter, filter_length );
+
+    /* A node without subscriptions is only a level of longer filters */
+    if ( ( node == NULL ) || ( node->subscriptions == NULL ) )
+    {
+        return WICED_NOTFOUND;
+    }
+    while ( node->subscriptions != NULL )
+    {
+        mqtt_topic_subscription_t *subscription = node->subscriptions;
+        node->subscriptions = subscription->next;
+        free( subscription );
+    }
+    mqtt_topic_prune( tree, node );
+    return WICED_SUCCESS;
+}
+
+uint32_t mqtt_topic_tree_dispatch( mqtt_topic_tree_t *tree, wiced_mqtt_object_t mqtt_object, wiced_mqtt_topic_msg_t *message )
+{
+    if ( ( tree->buckets == NULL ) || ( tree->node_count == 0 ) )
+    {
+        return 0;
+    }
+    return mqtt_topic_match( tree, &tree->root, message->topic, message->topic + message->topic_len, mqtt_object, message );
+}
+
+static uint32_t mqtt_topic_hash( const mqtt_topic_node_t *parent, const uint8_t *level, uint16_t length )
+{
+    /* FNV-1a over the level name, seeded with the parent */
+    uint32_t hash = 2166136261u ^ (uint32_t) (uintptr_t) parent;
+
+    while ( length-- > 0 )
+    {
+        hash = ( hash ^ *level++ ) * 16777619u;
+    }
+    return hash;
+}
+
+static mqtt_topic_node_t* mqtt_topic_find_child( mqtt_topic_tree_t *tree, mqtt_topic_node_t *parent, const uint8_t *level, uint16_t length )
+{
+    mqtt_topic_node_t *node;
+
+    if ( parent->children == 0 )
+    {
+        return NULL;
+    }
+    node = tree->buckets[ mqtt_topic_hash( parent, level, length ) & ( tree->bucket_count - 1 ) ];
+    while ( node != NULL )
+    {
+        if ( ( node->parent == parent ) && ( node->level_length == length ) && ( memcmp( node->level, level, length ) == 0 ) )
+        {
+            return node;
+        }
+        node = node->hash_next;
+    }
+    return NULL;
+}
+
+static mqtt_topic_node_t* mqtt_topic_add_child( mqtt_topic_tree_t *tree, mqtt_topic_node_t *parent, const uint8_t *level, uint16_t length )
+{
+    mqtt_topic_node_t *node;
+    mqtt_topic_node_t **bucket;
+
+    if ( tree->node_count >= 2 * tree->bucket_count )
+    {
+        mqtt_topic_grow( tree );
+    }
+
+    node = (mqtt_topic_node_t*) malloc_named( "mqtt_topic", sizeof(mqtt_topic_node_t) + length );
+    if ( node == NULL )
+    {
+        return NULL;
+    }
+    memset( node, 0, sizeof(mqtt_topic_node_t) );
+    node->parent       = parent;
+    node->level_length = length;
+    memcpy( node->level, level, length );
+
+    bucket = &tree->buckets[ mqtt_topic_hash( parent, level, length ) & ( tree->bucket_count - 1 ) ];
+    node->hash_next = *bucket;
+    *bucket = node;
+    parent->children++;
+    tree->node_count++;
+    return node;
+}
+
+/* Doubles the hash table. If memory is short the tree keeps working with longer chains. */
+static void mqtt_topic_grow( mqtt_topic_tree_t *tree )
+{
+    uint32_t new_count = tree->bucket_count * 2;
+    mqtt_topic_node_t **new_buckets = (mqtt_topic_node_t**) malloc_named( "mqtt_topic", new_count * sizeof(mqtt_topic_node_t*) );
+    uint32_t bucket;
+
+    if ( new_buckets == NULL )
+    {
+        return;
+    }
+    memset( new_buckets, 0, new_count * sizeof(mqtt_topic_node_t*) );
+    for ( bucket = 0; bucket < tree->bucket_count; bucket++ )
+    {
+        while ( tree->buckets[ bucket ] != NULL )
+        {
+            mqtt_topic_node_t *node = tree->buckets[ bucket ];
+            mqtt_topic_node_t **new_bucket = &new_buckets[ mqtt_topic_hash( node->parent, node->level, node->level_length ) & ( new_count - 1 ) ];
+            tree->buckets[ bucket ] = node->hash_next;
+            node->hash_next = *new_bucket;
+            *new_bucket = node;
+        }
+    }
+    free( tree->buckets );
+    tree->buckets      = new_buckets;
+    tree->bucket_count = new_count;
+}
+
+/* Frees the node and any ancestors left with neither subscriptions nor children */
+static void mqtt_topic_prune( mqtt_topic_tree_t *tree, mqtt_topic_node_t *node )
+{
+    while ( ( node != &tree->root ) && ( node->subscriptions == NULL ) && ( node->children == 0 ) )
+    {
+        mqtt_topic_node_t *parent = node->parent;
+        mqtt_topic_node_t **link  = &tree->buckets[ mqtt_topic_hash( parent, node->level, node->level_length ) & ( tree->bucket_count - 1 ) ];
+
+        while ( *link != node )
+        {
+            link = &( *link )->hash_next;
+        }
+        *link = node->hash_next;
+        parent->children--;
+        tree->node_count--;
+        free( node );
+        node = parent;
+    }
+}
+
+static mqtt_topic_node_t* mqtt_topic_find_filter( mqtt_topic_tree_t *tree, const uint8_t *filter, uint16_t filter_length )
+{
+    mqtt_topic_node_t *node = &tree->root;
+    const uint8_t *level = filter;
+    const uint8_t *end   = filter + filter_length;
+
+    if ( ( tree->buckets == NULL ) || ( filter_length == 0 ) )
+    {
+        return NULL;
+    }
+    while ( ( level != NULL ) && ( node != NULL ) )
+    {
+        const uint8_t *level_end = memchr( level, MQTT_TOPIC_LEVEL_SEPARATOR, (size_t) ( end - level ) );
+
+        if ( level_end == NULL )
+        {
+            level_end = end;
+        }
+        node  = mqtt_topic_find_child( tree, node, level, (uint16_t) ( level_end - level ) );
+        level = ( level_end < end ) ? level_end + 1 : NULL;
+    }
+    return node;
+}
+
+/* Wildcards must fill a whole level, and '#' must be the last level */
+static wiced_result_t mqtt_topic_validate_filter( const uint8_t *filter, uint16_t filter_length )
+{
+    uint16_t index;
+
+    if ( filter_length == 0 )
+    {
+        return WICED_BADARG;
+    }
+    for ( index = 0; index < filter_length; index++ )
+    {
+        if ( ( filter[ index ] == MQTT_TOPIC_SINGLE_LEVEL ) || ( filter[ index ] == MQTT_TOPIC_MULTI_LEVEL ) )
+        {
+            if ( ( index > 0 ) && ( filter[ index - 1 ] != MQTT_TOPIC_LEVEL_SEPARATOR ) )
+            {
+                return WICED_BADARG;
+            }
+            if ( ( index + 1 < filter_length ) && ( ( filter[ index ] == MQTT_TOPIC_MULTI_LEVEL ) || ( filter[ index + 1 ] != MQTT_TOPIC_LEVEL_SEPARATOR ) ) )
+            {
+                return WICED_BADARG;
+            }
+        }
+    }
+    return WICED_SUCCESS;
+}
+
+static uint32_t mqtt_topic_deliver( mqtt_topic_node_t *node, wiced_mqtt_object_t mqtt_object, wiced_mqtt_topic_msg_t *message )
+{
+    mqtt_topic_subscription_t *subscription;
+    uint32_t delivered = 0;
+
+    for ( subscription = node->subscriptions; subscription != NULL; subscription = subscription->next )
+    {
+        subscription->callback( mqtt_object, message, subscription->arg );
+        delivered++;
+    }
+    return delivered;
+}
+
+/*
+ * Matches the topic levels from 'level' onwards against the filters below 'node'.
+ * 'level' is NULL once every level of the topic has been matched.
+ */
+static uint32_t mqtt_topic_match( mqtt_topic_tree_t *tree, mqtt_topic_node_t *node, const uint8_t *level, const uint8_t *end, wiced_mqtt_object_t mqtt_object, wiced_mqtt_topic_msg_t *message )
+{
+    const uint8_t *level_end;
+    const uint8_t *next_level;
+    mqtt_topic_node_t *child;
+    uint32_t delivered = 0;
+
+    if ( level == NULL )
+    {
+        delivered += mqtt_topic_deliver( node, mqtt_object, message );
+
+        /* "sport/#" also matches "sport" */
+        if ( ( child = mqtt_topic_find_child( tree, node, multi_level_wildcard, 1 ) ) != NULL )
+        {
+            delivered += mqtt_topic_deliver( child, mqtt_object, message );
+        }
+        return delivered;
+    }
+
+    level_end = memchr( level, MQTT_TOPIC_LEVEL_SEPARATOR, (size_t) ( end - level ) );
+    if ( level_end == NULL )
+    {
+        level_end = end;
+    }
+    next_level = ( level_end < end ) ? level_end + 1 : NULL;
+
+    /* Topics starting with '$' are not matched by a wildcard in the first level */
+    if ( ( node != &tree->root ) || ( level == end ) || ( *level != '$' ) )
+    {
+        if ( ( child = mqtt_topic_find_child( tree, node, multi_level_wildcard, 1 ) ) != NULL )
+        {
+            delivered += mqtt_topic_deliver( child, mqtt_object, message );
+        }
+        if ( ( child = mqtt_topic_find_child( tree, node, single_level_wildcard, 1 ) ) != NULL )
+        {
+            delivered += mqtt_topic_match( tree, child, next_level, end, mqtt_object, message );
+        }
+    }
+
+    /* A level that is itself '+' or '#' was matched by the wildcard lookups above */
+    if ( ( level_end - level != 1 ) || ( ( *level != MQTT_TOPIC_SINGLE_LEVEL ) && ( *level != MQTT_TOPIC_MULTI_LEVEL ) ) )
+    {
+        if ( ( child = mqtt_topic_find_child( tree, node, level, (uint16_t) ( level_end - level ) ) ) != NULL )
+        {
+            delivered += mqtt_topic_match( tree, child, next_level, end, mqtt_object, message );
+        }
+    }
+    return delivered;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2015, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  Topic filter tree.
+ *
+ *  Internal types not to be included directly by applications.
+ */
+#pragma once
+
+#include "wiced.h"
+#include "mqtt_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define MQTT_TOPIC_INITIAL_BUCKETS      (16)    /* Hash buckets for tree edges, doubled as the tree grows */
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct mqtt_topic_subscription_s
+{
+    struct mqtt_topic_subscription_s*   next;
+    wiced_mqtt_message_callback_t       callback;
+    void*                               arg;
+} mqtt_topic_subscription_t;
+
+/* One level of a topic filter. Children are found through the tree's hash table, keyed on parent and level */
+typedef struct mqtt_topic_node_s
+{
+    struct mqtt_topic_node_s*           parent;
+    struct mqtt_topic_node_s*           hash_next;
+    mqtt_topic_subscription_t*          subscriptions;  /* At most one per filter; subscribing again replaces it */
+    uint16_t                            children;
+    uint16_t                            level_length;
+    uint8_t                             level[1];       /* Allocated to level_length */
+} mqtt_topic_node_t;
+
+typedef struct mqtt_topic_tree_s
+{
+    mqtt_topic_node_t                   root;
+    mqtt_topic_node_t**                 buckets;
+    uint32_t                            bucket_count;
+    uint32_t                            node_count;
+} mqtt_topic_tree_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+wiced_result_t mqtt_topic_tree_init    ( mqtt_topic_tree_t *tree );
+void           mqtt_topic_tree_deinit  ( mqtt_topic_tree_t *tree );
+wiced_result_t mqtt_topic_tree_add     ( mqtt_topic_tree_t *tree, const uint8_t *filter, uint16_t filter_length, wiced_mqtt_message_callback_t callback, void *arg );
+wiced_result_t mqtt_topic_tree_remove  ( mqtt_topic_tree_t *tree, const uint8_t *filter, uint16_t filter_length );
+uint32_t       mqtt_topic_tree_dispatch( mqtt_topic_tree_t *tree, wiced_mqtt_object_t mqtt_object, wiced_mqtt_topic_msg_t *message );
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
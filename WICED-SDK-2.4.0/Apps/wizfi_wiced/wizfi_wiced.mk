@@ -49,6 +49,8 @@ $(NAME)_SOURCES := wiced_init.c \
                    wiced_MQTT/mqtt_connection.c \
                    wiced_MQTT/mqtt_manager.c  \
                    wiced_MQTT/mqtt_session.c \
+                   wiced_MQTT/mqtt_topic.c \
+                   wiced_MQTT/mqtt_store.c \
                    wiced_MQTT/mqtt_api.c
 
                   
@@ -70,6 +72,12 @@ GLOBAL_DEFINES += APPLICATION_WATCHDOG_TIMEOUT_SECONDS=20
 # sekim 20130311 add REPLACE_WPRINT
 GLOBAL_DEFINES += REPLACE_WPRINT=1
 
+# Serial flash read cache (8 x 32 bytes) for the small header reads of the MQTT offline store
+GLOBAL_DEFINES += SFLASH_READ_CACHE_LINES=8
+
+# Every SCID registers its socket callbacks with WICED (8 SCIDs + MQTT + spare), the default list holds 5
+GLOBAL_DEFINES += WICED_MAXIMUM_NUMBER_OF_SOCKETS_WITH_CALLBACKS=12
+
 # kaizen XXX 20130110 APPLICATION_DCT := wizfi_dct.c
 APPLICATION_DCT := wizfi_dct.c
 
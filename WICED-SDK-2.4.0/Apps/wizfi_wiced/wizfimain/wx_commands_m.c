@@ -33,9 +33,8 @@ UINT8 WXCmd_MPROF(UINT8 *ptr)
 
 	if ( strcmp((char*)ptr, "S") == 0 || strcmp((char*)ptr, "s") == 0 )
 	{
-		Save_Profile();
 		// kaizen 20130404
-		Apply_To_Wifi_Dct();
+		Save_Profile_And_Wifi_Dct();
 		return WXCODE_SUCCESS;
 	}
 
@@ -123,8 +122,7 @@ UINT8 WXCmd_MMAC(UINT8 *ptr)
 	wiced_wifi_set_mac_address(mac);
 
 	// kaizen 20130404
-	Save_Profile();
-	Apply_To_Wifi_Dct();
+	Save_Profile_And_Wifi_Dct();
 
 #if 1	// kaizen 20130611 ID1076 - When execute command to need system reset, WizFi250 should print [OK] message.
 	WXS2w_StatusNotify(WXCODE_SUCCESS, 0);
@@ -591,8 +589,16 @@ void Default_Profile()
     }
 }
 
+static int Is_Profile_Saved()
+{
+	return memcmp( wiced_dct_get_app_section(), &g_wxProfile, sizeof(WT_PROFILE) ) == 0;
+}
+
 void Save_Profile()
 {
+	// Every DCT write erases a whole flash sector, so skip it if nothing has changed
+	if ( Is_Profile_Saved() )	return;
+
 	// sekim 20133081 USART_Cmd(USART1, DISABLE) in wiced_dct_write_xxxx
 	USART_Cmd(USART1, DISABLE);
 	wiced_dct_write_app_section( &g_wxProfile, sizeof(WT_PROFILE) );
@@ -653,16 +659,15 @@ void Apply_To_APP_Dct()
 }
 #endif
 
-void Apply_To_Wifi_Dct()
+static void Build_Wifi_Dct(platform_dct_wifi_config_t* wifi_config)
 {
-	platform_dct_wifi_config_t	wifi_config;
 	wiced_config_ap_entry_t *	station_entry;
 	wiced_config_soft_ap_t *	ap_entry;
 
 
-	wiced_dct_read_wifi_config_section( &wifi_config );
-	station_entry	= &wifi_config.stored_ap_list[0];
-	ap_entry		= &wifi_config.soft_ap_settings;
+	wiced_dct_read_wifi_config_section( wifi_config );
+	station_entry	= &wifi_config->stored_ap_list[0];
+	ap_entry		= &wifi_config->soft_ap_settings;
 
 	// Station Mode ϱ   wifi_config_dct ݿ
 #if 1 //MikeJ 130408 ID1012 - Allow 32 characters SSID
@@ -727,9 +732,16 @@ void Apply_To_Wifi_Dct()
 
 
 	// kaizen 20130404
-	wifi_config.country_code = MK_CNTRY(g_wxProfile.wifi_countrycode[0],g_wxProfile.wifi_countrycode[1],0);
-	wifi_config.mac_address  = g_wxProfile.mac;
+	wifi_config->country_code = MK_CNTRY(g_wxProfile.wifi_countrycode[0],g_wxProfile.wifi_countrycode[1],0);
+	wifi_config->mac_address  = g_wxProfile.mac;
+}
+
+void Apply_To_Wifi_Dct()
+{
+	platform_dct_wifi_config_t	wifi_config;
 
+	Build_Wifi_Dct( &wifi_config );
+	if ( memcmp( wiced_dct_get_wifi_config_section(), &wifi_config, sizeof(wifi_config) ) == 0 )	return;
 
 	// sekim 20133081 USART_Cmd(USART1, DISABLE) in wiced_dct_write_xxxx
 	USART_Cmd(USART1, DISABLE);
@@ -737,6 +749,27 @@ void Apply_To_Wifi_Dct()
 	USART_Cmd(USART1, ENABLE);
 }
 
+// Save_Profile() followed by Apply_To_Wifi_Dct(), but with a single DCT write when both sections changed
+void Save_Profile_And_Wifi_Dct()
+{
+	platform_dct_wifi_config_t	wifi_config;
+	int bProfileSaved;
+	int bWifiSaved;
+
+	Build_Wifi_Dct( &wifi_config );
+	bProfileSaved = Is_Profile_Saved();
+	bWifiSaved = ( memcmp( wiced_dct_get_wifi_config_section(), &wifi_config, sizeof(wifi_config) ) == 0 );
+
+	if ( bProfileSaved && bWifiSaved )	return;
+
+	// sekim 20133081 USART_Cmd(USART1, DISABLE) in wiced_dct_write_xxxx
+	USART_Cmd(USART1, DISABLE);
+	if ( bWifiSaved )			wiced_dct_write_app_section( &g_wxProfile, sizeof(WT_PROFILE) );
+	else if ( bProfileSaved )	wiced_dct_write_wifi_config_section( &wifi_config );
+	else						wiced_dct_write_wifi_config_and_app_section( &wifi_config, &g_wxProfile, sizeof(WT_PROFILE) );
+	USART_Cmd(USART1, ENABLE);
+}
+
 // kaizen 20130424 1046 Modified Display Format
 void DisplayWTProfile(WT_PROFILE* pProfile)
 {
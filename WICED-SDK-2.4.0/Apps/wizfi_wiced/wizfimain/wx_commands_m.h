@@ -43,6 +43,7 @@ void Load_Profile();
 void Apply_To_APP_Dct();
 #endif
 void Apply_To_Wifi_Dct();
+void Save_Profile_And_Wifi_Dct();
 void DisplayWTProfile(WT_PROFILE* pProfile);
 
 #define DCTD_MSGLEVEL               2
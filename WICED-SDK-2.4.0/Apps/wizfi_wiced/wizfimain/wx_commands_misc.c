@@ -426,8 +426,7 @@ UINT8 WXCmd_MSPI(UINT8 *ptr)
 	g_wxProfile.spi_mode = buff_value2;
 
 	// Reset 
-	Save_Profile();
-	Apply_To_Wifi_Dct();
+	Save_Profile_And_Wifi_Dct();
 	WXS2w_StatusNotify(WXCODE_SUCCESS, 0);
 	WXS2w_SystemReset();
 
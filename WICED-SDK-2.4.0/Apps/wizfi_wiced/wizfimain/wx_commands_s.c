@@ -584,11 +584,6 @@ UINT8 WXCmd_SOPT1(UINT8 *ptr)
 	{
 		WDUMPEXT((UINT8*)buff3, buff4);
 	}
-	else if ( buff1 == 35 )
-	{
-		extern UINT16 g_socket_open_thread_stack_xxx;
-		g_socket_open_thread_stack_xxx = buff2;
-	}
 	// sekim XXX Test Function : WXCmd_SOPT1
 	else if ( buff1 == 41 )
 	{
@@ -608,15 +603,6 @@ UINT8 WXCmd_SOPT1(UINT8 *ptr)
 	{
 		wiced_network_down( WICED_STA_INTERFACE );
 	}
-	else if ( buff1 == 44 )
-	{
-		UINT8 scid = 0;
-	    if ( wiced_rtos_is_current_thread(&g_socketopen_thread[scid])!=WICED_SUCCESS )
-	    {
-	    	if ( wiced_rtos_delete_thread(&g_socketopen_thread[scid])!=WICED_SUCCESS )
-	    		W_DBG("ProcessWizFiQueue : wiced_rtos_delete_thread error");
-	    }
-	}
 	else if ( buff1 == 45 )
 	{
 		WXS2w_LEDIndication(buff2, 0, 0, 0, 0, buff3);
@@ -467,6 +467,7 @@ UINT8 WXLink_Disassociate(UINT8 bForced, UINT8 bNotify, wiced_interface_t interf
 
 	// call the status notification function
 	g_scTxIndex = 0;
+	WXNetwork_NetTxDiscard();
 
 	g_isAutoconnected = 0;
 	g_wxModeState = WX_MODE_COMMAND;
@@ -1720,8 +1721,7 @@ UINT8 WXCmd_WREG(UINT8 *ptr)
 
 	// sekim need to reboot
 	// kaizen 20130408
-	Save_Profile();
-	Apply_To_Wifi_Dct();
+	Save_Profile_And_Wifi_Dct();
 	NVIC_SystemReset();
 
 	return WXCODE_SUCCESS;
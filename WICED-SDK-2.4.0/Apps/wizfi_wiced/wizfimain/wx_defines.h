@@ -142,13 +142,19 @@
 
 
 #define WX_INVALID_SCID		0xff
+// number of SCIDs, all of them are served by one socket service thread
+#ifndef WX_MAX_SCID_RANGE
 #define WX_MAX_SCID_RANGE	8
+#endif
 
 #define WX_CMDBUF_SIZE		256
 #define WX_DATABUFFER_SIZE	1500
 
 #define WX_MAX_PRINT_LEN	256
 
+// Largest span WXS2w_SerialInput pulls from the USART ring buffer in one call
+#define WX_SERIAL_RX_CHUNK_SIZE	512
+
 // kaizen
 #define WX_WORD_SIZE		4
 #define WX_IPv4_ADDR_SIZE	16
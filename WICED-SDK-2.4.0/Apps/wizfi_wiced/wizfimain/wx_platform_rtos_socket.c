@@ -3,11 +3,52 @@
 #include "bootloader_app.h"
 #include "wiced_tcpip.h"
 #include "wiced_dct.h"
+#include "dns.h"
 
 WT_SCLIST g_scList[WX_MAX_SCID_RANGE];
-wiced_thread_t g_socketopen_thread[WX_MAX_SCID_RANGE];
 UINT8 g_scRxBuffer[WX_DATABUFFER_SIZE];
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Socket service : a single thread drives open/accept/receive/close of every SCID.
+// Socket callbacks and DNS answers only wake the thread, the thread then polls the slots.
+// Nothing in a pass may block : DNS, connect and the TLS handshake are all advanced step by step.
+#define WX_SC_STATE_IDLE			0
+#define WX_SC_STATE_OPEN			1		// AT+SCON accepted, socket not yet created
+#define WX_SC_STATE_LISTEN			2		// TCP server waiting for a client
+#define WX_SC_STATE_CONNECT			3		// TCP client waiting for SYN/ACK
+#define WX_SC_STATE_ESTABLISHED		4
+#define WX_SC_STATE_RESOLVE			5		// waiting for the DNS answer for AT+SDNAME
+#define WX_SC_STATE_HANDSHAKE		6		// TCP connected, TLS handshake in progress
+
+#define WX_SOCKET_SERVICE_STACK_SIZE	(1024*4)
+#define WX_SOCKET_SERVICE_POLL_TIME		100		// ms, bounds connect timeout accuracy
+
+typedef struct
+{
+	union
+	{
+		wiced_tcp_socket_t	tcp;
+		wiced_udp_socket_t	udp;
+	} sock;
+	WT_SCLIST			info;			// AT+SCON parameters, kept to restart a TCP server
+	uint32_t			connect_time;	// also the start of the TLS handshake
+	UINT8				command_mode_when_disconnected;
+	UINT8				handshake_idle;	// last TLS step made no progress, wait for more data
+	volatile UINT8		state;
+	volatile UINT8		evtOpen;
+	volatile UINT8		evtClose;
+	volatile UINT8		resolve_done;	// the lookup always answers, on timeout too
+	UINT8				resolve_seq;	// tags the lookup, an answer to an earlier one is dropped
+	wiced_result_t		resolve_result;
+	wiced_ip_address_t	resolve_ip;
+} WT_SCSERVICE;
+
+static WT_SCSERVICE g_scService[WX_MAX_SCID_RANGE];
+static wiced_semaphore_t g_scServiceSemaphore;
+static wiced_thread_t g_scServiceThread;
+
+static void WXNetwork_SocketService(uint32_t arguments);
+
 wiced_ip_address_t g_UDP_last_packet_ip;
 UINT16 g_UDP_last_packet_port;
 
@@ -15,6 +56,8 @@ UINT16 g_UDP_last_packet_port;
 uint32_t g_time_lastdata;
 
 #define TCP_CLIENT_CONNECT_TIMEOUT        5000
+#define TLS_HANDSHAKE_TIMEOUT             10000
+#define SCON_DNS_LOOKUP_TIMEOUT           5000
 
 #if 0	// kaizen	20130520 ID1068 - Modified for using dct_security_section
 static const char brcm_server_certificate[] =
@@ -69,6 +112,12 @@ void WXNetwork_Initialize()
 		wifi_config.device_configured = WICED_FALSE;
 		wiced_dct_write_wifi_config_section( &wifi_config );
 	}
+
+	wiced_rtos_init_semaphore(&g_scServiceSemaphore);
+	if ( wiced_rtos_create_thread(&g_scServiceThread, WICED_APPLICATION_PRIORITY + 3, "Socket Service", WXNetwork_SocketService, WX_SOCKET_SERVICE_STACK_SIZE, NULL)!=WICED_SUCCESS )
+	{
+		W_DBG("wiced_rtos_create_thread : WXNetwork_SocketService error");
+	}
 }
 
 char g_BuffIPString[16];
@@ -108,33 +157,15 @@ UINT8 WXNetwork_ClearSCList(UINT8 scid)
 
 UINT8 WXNetwork_CloseSCList(UINT8 scid)
 {
-	wiced_result_t result;
-
 	if ( scid >= WX_MAX_SCID_RANGE )		return WXCODE_EBADCID;
-	if ( g_scList[scid].pSocket==0 )		return WXCODE_EBADCID;
 
-	if ( g_scList[scid].conType==WX_SC_CONTYPE_TCP )
-	{
-	    if ( (result=wiced_tcp_disconnect(g_scList[scid].pSocket))!=WICED_SUCCESS )
-	    {
+	// an SCID still opening (AT+SDNAME lookup, TCP server restart) has no socket yet but can be closed
+	if ( g_scList[scid].pSocket==0 && g_scService[scid].state==WX_SC_STATE_IDLE && !g_scService[scid].evtOpen )
+		return WXCODE_EBADCID;
 
-	    	if ( g_scList[scid].conMode==WX_SC_MODE_CLIENT )
-	    	{
-	    		W_DBG("WXNetwork_CloseSCList : error 110 (%d)", result);
-	    	}
-	    }
-	    if ( (result=wiced_tcp_delete_socket(g_scList[scid].pSocket))!=WICED_SUCCESS )
-	    {
-	    	W_DBG("WXNetwork_CloseSCList : error 120 (%d)", result);
-	    }
-	}
-	else
-	{
-	    if ( (result=wiced_udp_delete_socket(g_scList[scid].pSocket))!=WICED_SUCCESS )
-	    {
-	    	W_DBG("WXNetwork_CloseSCList : error 130 (%d)", result);
-	    }
-	}
+	// the socket is owned by the socket service thread, which disconnects and deletes it
+	g_scService[scid].evtClose = 1;
+	wiced_rtos_set_semaphore(&g_scServiceSemaphore);
 
 	return WXCODE_SUCCESS;
 }
@@ -176,11 +207,46 @@ UINT8 WXNetwork_ScidGet(VOID)
 	UINT32 i;
 	for(i = 0; i < WX_MAX_SCID_RANGE; i++)
 	{
-		if ( g_scList[i].pSocket==0 )	return i;
+		if ( g_scList[i].pSocket==0 && g_scService[i].state==WX_SC_STATE_IDLE && !g_scService[i].evtOpen )	return i;
 	}
 	return WX_INVALID_SCID;
 }
 
+// Receive header formatting : {SCID,IP,port,len} is built for every packet, so no sprintf/strcat here.
+// A NUL delimiter in xrdf_data is skipped, as "%c" + strcat did.
+#define WX_RX_HEADER_MAX_LEN	48
+
+static UINT8* WXNetwork_PutChar(UINT8* p, UINT8 ch)
+{
+	if ( ch )	*p++ = ch;
+	return p;
+}
+
+static UINT8* WXNetwork_PutUInt(UINT8* p, UINT32 value, UINT8 base)
+{
+	UINT8 digits[10];
+	UINT8 count = 0;
+
+	do
+	{
+		digits[count++] = "0123456789abcdef"[value % base];
+		value /= base;
+	} while ( value );
+
+	while ( count )	*p++ = digits[--count];
+	return p;
+}
+
+static UINT8* WXNetwork_PutIPv4(UINT8* p, wiced_ip_address_t* ip)
+{
+	uint32_t addr = GET_IPV4_ADDRESS(*ip);
+
+	p = WXNetwork_PutUInt(p, (uint8_t)(addr >> 24), 10);	*p++ = '.';
+	p = WXNetwork_PutUInt(p, (uint8_t)(addr >> 16), 10);	*p++ = '.';
+	p = WXNetwork_PutUInt(p, (uint8_t)(addr >> 8), 10);		*p++ = '.';
+	return WXNetwork_PutUInt(p, (uint8_t)(addr >> 0), 10);
+}
+
 #if 0 //MikeJ 130806 ID1112 - Target IP/Port shouldn't be changed when packet was received on UDP Client
 UINT8 WXNetwork_NetRx(UINT8 scid, VOID *buf, UINT32 len)
 #else
@@ -189,8 +255,10 @@ UINT8 WXNetwork_NetRx(UINT8 scid, VOID *buf, UINT32 len, wiced_ip_address_t* rmt
 {
 	UINT8 *p = (UINT8 *) buf;
 
-	char szUartBuff[256] = { 0, };
-	char xrdfbuff[30] =	{ 0, };
+	UINT8 header[WX_RX_HEADER_MAX_LEN];
+	UINT8 trailer[WX_RX_HEADER_MAX_LEN];
+	UINT8 *h = header;
+	UINT8 *t = trailer;
 
 	// sekim 20140625 ID1176 add option to clear tcp-idle-connection
 	g_scList[scid].tcp_time_lastdata = host_rtos_get_time();
@@ -205,41 +273,28 @@ UINT8 WXNetwork_NetRx(UINT8 scid, VOID *buf, UINT32 len, wiced_ip_address_t* rmt
 	}
 
 	// sekim 20120405 Output <Received Data> {1,192.168.1.23,5000,1}0123456789
-	if ( g_wxProfile.xrdf_main[0] == '1' )	{ sprintf(szUartBuff, "%c", g_wxProfile.xrdf_data[0]); }
-	if ( g_wxProfile.xrdf_main[1] == '1' )	{ sprintf(xrdfbuff, "%x", scid); strcat(szUartBuff, xrdfbuff); }
-	if ( g_wxProfile.xrdf_main[2] == '1' )	{ sprintf(xrdfbuff, "%c", g_wxProfile.xrdf_data[1]); strcat(szUartBuff, xrdfbuff); }
-#if 0 //MikeJ 130806 ID1112 - Target IP/Port shouldn't be changed when packet was received on UDP Client
-	if ( g_wxProfile.xrdf_main[3] == '1' )	{ sprintf(xrdfbuff, "%s", (char*)WXNetwork_WicedV4IPToString(0, g_scList[scid].remoteIp)); strcat(szUartBuff, xrdfbuff); }
-	if ( g_wxProfile.xrdf_main[2] == '1' )	{ sprintf(xrdfbuff, "%c", g_wxProfile.xrdf_data[1]); strcat(szUartBuff, xrdfbuff);	}
-	if ( g_wxProfile.xrdf_main[4] == '1' )	{ sprintf(xrdfbuff, "%d", g_scList[scid].remotePort); strcat(szUartBuff, xrdfbuff);	}
-#else
-	if ( g_wxProfile.xrdf_main[3] == '1' )	{
-		if(rmtIP != NULL)
-			sprintf(xrdfbuff, "%s", (char*)WXNetwork_WicedV4IPToString(0, *rmtIP));
-		else sprintf(xrdfbuff, "%s", (char*)WXNetwork_WicedV4IPToString(0, g_scList[scid].remoteIp));
-		strcat(szUartBuff, xrdfbuff); 
-	}
-	if ( g_wxProfile.xrdf_main[2] == '1' )	{ sprintf(xrdfbuff, "%c", g_wxProfile.xrdf_data[1]); strcat(szUartBuff, xrdfbuff);	}
-	if ( g_wxProfile.xrdf_main[4] == '1' )	{
-		if(rmtPort != NULL) 
-			sprintf(xrdfbuff, "%d", *rmtPort); 
-		else sprintf(xrdfbuff, "%d", g_scList[scid].remotePort); 
-		strcat(szUartBuff, xrdfbuff);
-	}
-#endif
-	if ( g_wxProfile.xrdf_main[2] == '1' )	{ sprintf(xrdfbuff, "%c", g_wxProfile.xrdf_data[1]); strcat(szUartBuff, xrdfbuff);	}
-	if ( g_wxProfile.xrdf_main[5] == '1' )	{ sprintf(xrdfbuff, "%d", len); strcat(szUartBuff, xrdfbuff);	}
-	if ( g_wxProfile.xrdf_main[6] == '1' )	{ sprintf(xrdfbuff, "%c", g_wxProfile.xrdf_data[2]); strcat(szUartBuff, xrdfbuff);	}
+	if ( g_wxProfile.xrdf_main[0] == '1' )	{ h = WXNetwork_PutChar(h, g_wxProfile.xrdf_data[0]); }
+	if ( g_wxProfile.xrdf_main[1] == '1' )	{ h = WXNetwork_PutUInt(h, scid, 16); }
+	if ( g_wxProfile.xrdf_main[2] == '1' )	{ h = WXNetwork_PutChar(h, g_wxProfile.xrdf_data[1]); }
+	//MikeJ 130806 ID1112 - Target IP/Port shouldn't be changed when packet was received on UDP Client
+	if ( g_wxProfile.xrdf_main[3] == '1' )	{ h = WXNetwork_PutIPv4(h, (rmtIP != NULL) ? rmtIP : &g_scList[scid].remoteIp); }
+	if ( g_wxProfile.xrdf_main[2] == '1' )	{ h = WXNetwork_PutChar(h, g_wxProfile.xrdf_data[1]); }
+	if ( g_wxProfile.xrdf_main[4] == '1' )	{ h = WXNetwork_PutUInt(h, (rmtPort != NULL) ? *rmtPort : g_scList[scid].remotePort, 10); }
+	if ( g_wxProfile.xrdf_main[2] == '1' )	{ h = WXNetwork_PutChar(h, g_wxProfile.xrdf_data[1]); }
+	if ( g_wxProfile.xrdf_main[5] == '1' )	{ h = WXNetwork_PutUInt(h, len, 10); }
+	if ( g_wxProfile.xrdf_main[6] == '1' )	{ h = WXNetwork_PutChar(h, g_wxProfile.xrdf_data[2]); }
+
+	// without xrdf_main[7] the trailer has always started with a copy of the header
+	if ( g_wxProfile.xrdf_main[7] == '1' )	{ t = WXNetwork_PutChar(t, g_wxProfile.xrdf_data[3]); }
+	else									{ memcpy(t, header, h - header); t += h - header; }
+	if ( g_wxProfile.xrdf_main[8] == '1' )	{ t = WXNetwork_PutChar(t, g_wxProfile.xrdf_data[4]); }
 
 	extern wiced_mutex_t g_upart_type1_wizmutex;
 	wiced_rtos_lock_mutex(&g_upart_type1_wizmutex);
 
-	WXHal_CharNPut(szUartBuff, strlen(szUartBuff));
+	WXHal_CharNPut(header, h - header);
 	WXHal_CharNPut(p, len);
-
-	if ( g_wxProfile.xrdf_main[7] == '1' )	{ sprintf(szUartBuff, "%c", g_wxProfile.xrdf_data[3]); }
-	if ( g_wxProfile.xrdf_main[8] == '1' )	{ sprintf(xrdfbuff, "%c", g_wxProfile.xrdf_data[4]); strcat(szUartBuff, xrdfbuff);	}
-	WXHal_CharNPut(szUartBuff, strlen(szUartBuff));
+	WXHal_CharNPut(trailer, t - trailer);
 
 	wiced_rtos_unlock_mutex(&g_upart_type1_wizmutex);
 	return WXCODE_SUCCESS;
@@ -308,456 +363,701 @@ UINT8 WXNetwork_NetTx(UINT8 scid, VOID *buf, UINT32 len)
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
-WT_SCLIST g_SocketOpenSCInfo;
-UINT8 g_SocketOpenSCList;
-extern wiced_mutex_t g_socketopen_wizmutex;
+// Data mode transmit : UART bytes are written straight into a packet taken from the TX pool and that
+// packet is sent as is, instead of being collected in g_scTxBuffer and copied again by
+// wiced_tcp_send_buffer. One packet is staged at a time; callers serialize on g_s2w_wizmutex.
+extern wiced_mutex_t g_s2w_wizmutex;
+
+static wiced_packet_t*	g_scTxPacket = 0;
+static UINT8			g_scTxPacketScid;
+static UINT8*			g_scTxPacketStart;
+static UINT8*			g_scTxPacketData;
+static UINT16			g_scTxPacketSpace;
+
+UINT32 WXNetwork_NetTxAppend(UINT8 scid, UINT8 *data, UINT32 len)
+{
+	wiced_result_t result;
+	UINT32 copyLen;
 
-void ClearSocketOpenThread(UINT8 scid)
+	if ( scid >= WX_MAX_SCID_RANGE )	return 0;
+	if ( g_scList[scid].pSocket==0 )	return 0;
+
+	if ( g_scTxPacket && g_scTxPacketScid!=scid )
+	{
+		W_DBG("WXNetwork_NetTxAppend : staged data of scid %d dropped", g_scTxPacketScid);
+		WXNetwork_NetTxDiscard();
+	}
+
+	if ( g_scTxPacket==0 )
+	{
+		if ( g_scList[scid].conType==WX_SC_CONTYPE_TCP )
+			result = wiced_packet_create_tcp(g_scList[scid].pSocket, WX_MAX_PACKET_SIZE, &g_scTxPacket, &g_scTxPacketData, &g_scTxPacketSpace);
+		else
+			result = wiced_packet_create_udp(g_scList[scid].pSocket, WX_MAX_PACKET_SIZE, &g_scTxPacket, &g_scTxPacketData, &g_scTxPacketSpace);
+
+		if ( result!=WICED_SUCCESS )
+		{
+			W_DBG("WXNetwork_NetTxAppend : tx packet creation failed (%d)", result);
+			g_scTxPacket = 0;
+			return 0;
+		}
+
+		g_scTxPacketScid = scid;
+		g_scTxPacketStart = g_scTxPacketData;
+	}
+
+	copyLen = MIN(len, g_scTxPacketSpace);
+	memcpy(g_scTxPacketData, data, copyLen);
+	g_scTxPacketData += copyLen;
+	g_scTxPacketSpace -= copyLen;
+
+	return copyLen;
+}
+
+UINT8* WXNetwork_NetTxStaged(UINT32 *len)
 {
-	struct WizFiQueue buffMessage;
+	if ( g_scTxPacket==0 )
+	{
+		*len = 0;
+		return 0;
+	}
 
-	buffMessage.queue_id = 111;
-	buffMessage.queue_opt = scid;
+	*len = g_scTxPacketData - g_scTxPacketStart;
+	return g_scTxPacketStart;
+}
 
-	extern wiced_queue_t g_queue_handle_wizfiqueue;
-	wiced_rtos_push_to_queue(&g_queue_handle_wizfiqueue, (void*)&buffMessage, WICED_NO_WAIT);
+UINT32 WXNetwork_NetTxSpace(VOID)
+{
+	return g_scTxPacket ? g_scTxPacketSpace : 0;
 }
 
-void SocketOpenProcess(uint32_t arguments)
+UINT8 WXNetwork_NetTxFlush(VOID)
 {
-    wiced_result_t result;
-	wiced_packet_t* rx_packet;
-	wiced_tcp_socket_t socket_tcp;
-	wiced_udp_socket_t socket_udp;
+	UINT8 scid = g_scTxPacketScid;
+	wiced_packet_t* packet = g_scTxPacket;
 
-    char* rx_data;
-	uint16_t rx_data_length;
-	uint16_t available_data_length;
-	uint8_t tcp_restart_check = 0;
-	uint8_t command_mode_when_disconnected = 0;
+	if ( packet==0 )	return WXCODE_SUCCESS;
+	g_scTxPacket = 0;
+
+	if ( g_scList[scid].pSocket==0 )
+	{
+		wiced_packet_delete(packet);
+		return WXCODE_EBADCID;
+	}
 
-	UINT8 scid = g_SocketOpenSCList;
-	WT_SCLIST buff_SocketOpenSCInfo;
-	memcpy(&buff_SocketOpenSCInfo, &g_SocketOpenSCInfo, sizeof(g_SocketOpenSCInfo));
+	wiced_packet_set_data_end(packet, g_scTxPacketData);
 
-	////////////////////////////////////////////////////////////////////////////////////////////////////////
-	// sekim 20150616 add AT+SDNAME
-	if ( strcmp(WXNetwork_WicedV4IPToString(0, buff_SocketOpenSCInfo.remoteIp), "0.0.0.0")==0 )
+	g_scList[scid].tcp_time_lastdata = host_rtos_get_time();
+	g_time_lastdata = g_scList[scid].tcp_time_lastdata;
+
+	if ( g_scList[scid].conType==WX_SC_CONTYPE_TCP )
 	{
-		if ( strlen(g_wxProfile.domainname_for_scon)>3 )
+		// if TCP/Server and not yet accept, then drop the data
+		if ( g_scList[scid].conMode==WX_SC_MODE_SERVER && g_scList[scid].bAccepted==0 )
 		{
-			wiced_ip_address_t buff_ip_address;
-			if ( wiced_hostname_lookup((char*)g_wxProfile.domainname_for_scon, &buff_ip_address, 5000 )==WICED_SUCCESS )
-			{
-				memcpy(&buff_SocketOpenSCInfo.remoteIp, &buff_ip_address, sizeof(wiced_ip_address_t));
-			}
-			else
-			{
-				W_DBG("SocketProcess : wiced_hostname_lookup failed (%s)", g_wxProfile.domainname_for_scon);
-			}
+			wiced_packet_delete(packet);
+			return WXCODE_SUCCESS;
+		}
+
+		if ( wiced_tcp_send_packet(g_scList[scid].pSocket, packet)!=WICED_SUCCESS )
+		{
+			W_DBG("WXNetwork_NetTxFlush : wiced_tcp_send_packet error %s:%d/%d", WXNetwork_WicedV4IPToString(0, g_scList[scid].remoteIp), g_scList[scid].remotePort, g_scList[scid].localPort);
+			wiced_packet_delete(packet);
+			return WXCODE_TCPSENDERROR;
+		}
+	}
+	else
+	{
+		if ( wiced_udp_send(g_scList[scid].pSocket, &g_scList[scid].remoteIp, g_scList[scid].remotePort, packet)!=WICED_SUCCESS )
+		{
+			W_DBG("UDP tx packet failed");
+			wiced_packet_delete(packet);
+			return WXCODE_FAILURE;
 		}
 	}
-	////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+	return WXCODE_SUCCESS;
+}
 
-	wiced_rtos_unlock_mutex(&g_socketopen_wizmutex);
+// Also called on disconnect from other threads, so it takes the (recursive) data mode mutex itself
+VOID WXNetwork_NetTxDiscard(VOID)
+{
+	wiced_rtos_lock_mutex(&g_s2w_wizmutex);
+	if ( g_scTxPacket )
+	{
+		wiced_packet_delete(g_scTxPacket);
+		g_scTxPacket = 0;
+	}
+	wiced_rtos_unlock_mutex(&g_s2w_wizmutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+extern wiced_mutex_t g_socketopen_wizmutex;
+
+// receive/disconnect/connect callbacks registered with WICED, run on the networking worker thread
+static wiced_result_t WXNetwork_SocketCallback(void* socket)
+{
+	wiced_rtos_set_semaphore(&g_scServiceSemaphore);
+	return WICED_SUCCESS;
+}
 
-	while(1)
+// WICED has no establish callback, this one is set on the NetX_Duo socket directly
+static void WXNetwork_SocketNotifyEstablished(NX_TCP_SOCKET* socket_ptr)
+{
+	wiced_rtos_set_semaphore(&g_scServiceSemaphore);
+}
+
+static VOID WXNetwork_SocketNotifyListen(NX_TCP_SOCKET* socket_ptr, UINT port)
+{
+	wiced_rtos_set_semaphore(&g_scServiceSemaphore);
+}
+
+// Runs on the DNS resolver thread, or inline from WXNetwork_SocketResolve() when the cache answers
+static void WXNetwork_SocketResolved(void* arg, const char* hostname, wiced_result_t result, const wiced_ip_address_t* address)
+{
+	WT_SCSERVICE* sc = &g_scService[(UINT32)arg & 0xFF];
+
+	// the SCID was closed during the lookup, and may be resolving another name by now
+	if ( sc->resolve_seq!=(UINT8)((UINT32)arg >> 8) )	return;
+
+	sc->resolve_result = result;
+	if ( result==WICED_SUCCESS )	memcpy(&sc->resolve_ip, address, sizeof(wiced_ip_address_t));
+	sc->resolve_done = 1;
+
+	wiced_rtos_set_semaphore(&g_scServiceSemaphore);
+}
+
+static wiced_result_t WXNetwork_SocketListen(wiced_tcp_socket_t* socket, UINT16 port)
+{
+	NX_IP* ip_ptr = socket->socket.nx_tcp_socket_ip_ptr;
+	struct NX_TCP_LISTEN_STRUCT* listen_ptr;
+
+	if ( ip_ptr->nx_ip_driver_link_up==0 )	return WICED_NOTUP;
+
+	// another SCID is already listening on this port (socket_ext_option9), let WICED re-listen
+	listen_ptr = ip_ptr->nx_ip_tcp_active_listen_requests;
+	if ( listen_ptr )
 	{
-		tcp_restart_check = 0;
-		UINT8 bTCP = (buff_SocketOpenSCInfo.conType==WX_SC_CONTYPE_TCP)?1:0;
-		UINT8 bServer = (buff_SocketOpenSCInfo.conMode==WX_SC_MODE_SERVER)?1:0;
+		do
+		{
+			if ( listen_ptr->nx_tcp_listen_port==port )	return wiced_tcp_listen(socket, port);
+			listen_ptr = listen_ptr->nx_tcp_listen_next;
+		} while ( listen_ptr!=ip_ptr->nx_ip_tcp_active_listen_requests );
+	}
 
-		//W_DBG("SocketOpenProcess : Start %s:%d/%d", WXNetwork_WicedV4IPToString(0, g_scList[scid].remoteIp), g_scList[scid].remotePort, g_scList[scid].localPort);
+	if ( nx_tcp_server_socket_listen(ip_ptr, port, &socket->socket, WICED_DEFAULT_TCP_LISTEN_QUEUE_SIZE, WXNetwork_SocketNotifyListen)!=NX_SUCCESS )
+		return WICED_ERROR;
 
-		//////////////////////////////////////////////////////////////////////////////////////////
-		// sekim 20130404 AP? STA?   
-		// Create Socket
-		//if ( bTCP )	result = wiced_tcp_create_socket(&socket_tcp, WICED_STA_INTERFACE);
-		//else		result = wiced_udp_create_socket(&socket_udp, buff_SocketOpenSCInfo.localPort, WICED_STA_INTERFACE);
-		wiced_interface_t interface = (g_wxProfile.wifi_mode==AP_MODE)?WICED_AP_INTERFACE:WICED_STA_INTERFACE;
-		if ( bTCP )	result = wiced_tcp_create_socket(&socket_tcp, interface);
-#if 0 //MikeJ 130624 ID1084 - Modified local-port checking part
-		else		result = wiced_udp_create_socket(&socket_udp, buff_SocketOpenSCInfo.localPort, interface);
-#else
-		else {
-			result = wiced_udp_create_socket(&socket_udp, buff_SocketOpenSCInfo.localPort, interface);
-			g_scList[scid].localPort = socket_udp.socket.nx_udp_socket_port;
+	return WICED_SUCCESS;
+}
+
+static void WXNetwork_SocketEnableTLS(UINT8 scid)
+{
+	wiced_result_t result;
+
+	// sekim 20130311 2.2.1 Migration, about TLS
+	g_scList[scid].pTLSContext = malloc_named("TLS-Context", sizeof(wiced_tls_advanced_context_t));
+	memset(g_scList[scid].pTLSContext, 0, sizeof(wiced_tls_advanced_context_t));
+	((wiced_tls_advanced_context_t*)g_scList[scid].pTLSContext)->context_type = WICED_TLS_ADVANCED_CONTEXT;
+
+	// kaizen 20130520 ID1068 - Modified for using dct_security_section
+	platform_dct_security_t const* dct_security = wiced_dct_get_security_section( );
+	if ( (result=wiced_tls_init_advanced_context(g_scList[scid].pTLSContext, dct_security->certificate, dct_security->private_key))!=WICED_SUCCESS )
+		W_DBG("SocketProcess : wiced_tls_init_context failed (%d)", result);
+	if ( (result=wiced_tcp_enable_tls(&g_scService[scid].sock.tcp, g_scList[scid].pTLSContext))!=WICED_SUCCESS )
+		W_DBG("SocketProcess : wiced_tcp_enable_tls failed (%d)", result);
+}
+
+// Tear down a socket that never reached WX_SC_STATE_ESTABLISHED
+static void WXNetwork_SocketAbort(UINT8 scid)
+{
+	if ( g_scService[scid].info.conType==WX_SC_CONTYPE_TCP )	wiced_tcp_delete_socket(&g_scService[scid].sock.tcp);
+	else														wiced_udp_delete_socket(&g_scService[scid].sock.udp);
+
+	WXNetwork_ClearSCList(scid);
+	g_scService[scid].state = WX_SC_STATE_IDLE;
+}
+
+static void WXNetwork_SocketConnected(UINT8 scid)
+{
+	WT_SCSERVICE* sc = &g_scService[scid];
+
+	// sekim 201506 After connected, switch into data mode
+	// daniel 20160630 After connected, switch into data mode in UDP mode
+	if ( sc->info.dataMode==1 )
+	{
+		g_isAutoconnected = 1;
+		g_currentScid = scid;
+
+		// sekim 20130801 TCP Serve/Data mode -> Command Mode -> Disconnect -> To be Command mode
+		if ( sc->command_mode_when_disconnected==0 )
+		{
+			g_wxModeState = WX_MODE_DATA;
+			WXS2w_LEDIndication(2, 0, 0, 0, 0, 1);
 		}
-#endif
-		//////////////////////////////////////////////////////////////////////////////////////////
+	}
 
-		if ( result!=WICED_SUCCESS )
+	WXS2w_StatusNotify(WXCODE_CON_SUCCESS, scid);
+
+	if ( sc->info.conType==WX_SC_CONTYPE_TCP )
+	{
+		// sekim 20140625 ID1176 add option to clear tcp-idle-connection
+		g_scList[scid].tcp_time_lastdata = host_rtos_get_time();
+		// sekim 20140929 ID1188 Data-Idle-Auto-Reset (Autonix)
+		g_time_lastdata = g_scList[scid].tcp_time_lastdata;
+	}
+
+	sc->state = WX_SC_STATE_ESTABLISHED;
+}
+
+// Create the socket and start listen/connect, the result is picked up by the next service passes
+static void WXNetwork_SocketStart(UINT8 scid)
+{
+	WT_SCSERVICE* sc = &g_scService[scid];
+	wiced_tcp_socket_t* socket_tcp = &sc->sock.tcp;
+	wiced_udp_socket_t* socket_udp = &sc->sock.udp;
+	wiced_result_t result;
+	UINT8 bTCP = (sc->info.conType==WX_SC_CONTYPE_TCP)?1:0;
+	UINT8 bServer = (sc->info.conMode==WX_SC_MODE_SERVER)?1:0;
+
+	// sekim 20130404 AP? STA?
+	wiced_interface_t interface = (g_wxProfile.wifi_mode==AP_MODE)?WICED_AP_INTERFACE:WICED_STA_INTERFACE;
+	if ( bTCP )	result = wiced_tcp_create_socket(socket_tcp, interface);
+	else
+	{
+		//MikeJ 130624 ID1084 - Modified local-port checking part
+		result = wiced_udp_create_socket(socket_udp, sc->info.localPort, interface);
+		g_scList[scid].localPort = socket_udp->socket.nx_udp_socket_port;
+	}
+
+	if ( result!=WICED_SUCCESS )
+	{
+		W_DBG("SocketProcess : socket creation failed (%d)", result);
+		sc->state = WX_SC_STATE_IDLE;
+		return;
+	}
+
+	g_scList[scid].pSocket = (bTCP)?(void*)socket_tcp:(void*)socket_udp;
+
+	g_scList[scid].conType = sc->info.conType;
+	g_scList[scid].conMode = sc->info.conMode;
+	g_scList[scid].dataMode = sc->info.dataMode;
+	g_scList[scid].tlsMode = sc->info.tlsMode;
+	if ( bTCP )	g_scList[scid].localPort = sc->info.localPort;
+	g_scList[scid].remotePort = sc->info.remotePort;
+	memcpy(&g_scList[scid].remoteIp, &sc->info.remoteIp, sizeof(sc->info.remoteIp));
+
+	if ( !bTCP )
+	{
+		wiced_udp_register_callbacks(socket_udp, WXNetwork_SocketCallback);
+		WXNetwork_SocketConnected(scid);
+		return;
+	}
+
+	// the slots are static, registering the same socket again reuses its entry in the WICED list
+	wiced_tcp_register_callbacks(socket_tcp, WXNetwork_SocketCallback, WXNetwork_SocketCallback, WXNetwork_SocketCallback);
+	nx_tcp_socket_establish_notify(&socket_tcp->socket, WXNetwork_SocketNotifyEstablished);
+
+	if ( bServer )
+	{
+		if ( WXNetwork_SocketListen(socket_tcp, g_scList[scid].localPort)!=WICED_SUCCESS )
 		{
-			W_DBG("SocketProcess : socket creation failed (%d)", result);
-			// sekim 20140526 WXNetwork_ClearSCList if wiced_tcp_create_socket
-			WXNetwork_ClearSCList(scid);
-			ClearSocketOpenThread(scid);
+			W_DBG("SocketOpenProcess : listen error %d, %d", scid, g_scList[scid].localPort);
+			WXNetwork_SocketAbort(scid);
 			return;
 		}
 
-		g_scList[scid].pSocket = (bTCP)?(void*)(&socket_tcp):(void*)(&socket_udp);
+		if ( g_scList[scid].tlsMode=='S' )	WXNetwork_SocketEnableTLS(scid);
 
-		g_scList[scid].conType = buff_SocketOpenSCInfo.conType;
-		g_scList[scid].conMode = buff_SocketOpenSCInfo.conMode;
-		g_scList[scid].dataMode = buff_SocketOpenSCInfo.dataMode;
-		g_scList[scid].tlsMode = buff_SocketOpenSCInfo.tlsMode;
-#if 0 //MikeJ 130624 ID1084 - Modified local-port checking part
-		g_scList[scid].localPort = buff_SocketOpenSCInfo.localPort;
-#else
-		if(bTCP) g_scList[scid].localPort = buff_SocketOpenSCInfo.localPort;
-#endif
-		g_scList[scid].remotePort = buff_SocketOpenSCInfo.remotePort;
-		memcpy(&g_scList[scid].remoteIp, &buff_SocketOpenSCInfo.remoteIp, sizeof(buff_SocketOpenSCInfo.remoteIp));
+		// kaizen 20140529
+		if ( g_wxProfile.enable_listen_msg )
+			WXS2w_StatusNotify(WXCODE_LISTEN, scid);
 
-		// sekim 201506 After connected, switch into data mode
-		/*
-		if ( buff_SocketOpenSCInfo.dataMode==1 )
-		{
-			g_isAutoconnected = 1;
-			g_currentScid = scid;
+		sc->state = WX_SC_STATE_LISTEN;
+	}
+	else
+	{
+		// kaizen 20140428 ID1088 Modified to connect to TCP Server using exchanging certificate.
+		if ( g_scList[scid].tlsMode=='S' )	WXNetwork_SocketEnableTLS(scid);
 
-			// sekim 20130801 TCP Serve/Data mode -> Command Mode -> Disconnect -> To be Command mode
-			if ( command_mode_when_disconnected==0 )
-			{
-				g_wxModeState = WX_MODE_DATA;
-				WXS2w_LEDIndication(2, 0, 0, 0, 0, 1);
-			}
+		////////////////////////////////////////////////////////////////////////////////
+		// sekim 20150416 TCP client random local port
+		static uint16_t tcp_client_port_add = 0;
+		if ( tcp_client_port_add==0 )
+		{
+			uint16_t random_value = 0;
+			extern wiced_result_t wiced_wifi_get_random( uint16_t* val );
+			wiced_wifi_get_random(&random_value);
+			tcp_client_port_add = random_value%10000 + 1;
+		}
+		if ( g_scList[scid].localPort==0 )
+		{
+			g_scList[scid].localPort = NX_SEARCH_PORT_START + tcp_client_port_add++;
 		}
-		*/
+		////////////////////////////////////////////////////////////////////////////////
+
+		wiced_tcp_bind(socket_tcp, g_scList[scid].localPort);
+		g_scList[scid].localPort = socket_tcp->socket.nx_tcp_socket_port;
 
-		if ( bTCP )
+		// don't wait for the handshake here, WX_SC_STATE_CONNECT is checked on every service pass
+		UINT nx_result = nxd_tcp_client_socket_connect(&socket_tcp->socket, (NXD_ADDRESS*)&g_scList[scid].remoteIp, g_scList[scid].remotePort, NX_NO_WAIT);
+		if ( nx_result!=NX_SUCCESS && nx_result!=NX_IN_PROGRESS )
 		{
-			if ( bServer )
-			{
-				if ( wiced_tcp_listen(&socket_tcp, g_scList[scid].localPort)!=WICED_SUCCESS )
-				{
-					W_DBG("SocketOpenProcess : listen error %d, %d", scid, g_scList[scid].localPort);
-					wiced_tcp_delete_socket(&socket_tcp);
-					WXNetwork_ClearSCList(scid);
-					ClearSocketOpenThread(scid);
-					return;
-				}
+			W_DBG("SocketOpenProcess : connect error %s, %d", WXNetwork_WicedV4IPToString(0, g_scList[scid].remoteIp), g_scList[scid].localPort);
+			WXNetwork_SocketAbort(scid);
+			return;
+		}
 
-				if ( g_scList[scid].tlsMode=='S' )
-				{
-					// sekim 20130311 2.2.1 Migration, about TLS
-					g_scList[scid].pTLSContext = malloc_named("TLS-Context", sizeof(wiced_tls_advanced_context_t));
-					memset(g_scList[scid].pTLSContext, 0, sizeof(wiced_tls_advanced_context_t));
-					((wiced_tls_advanced_context_t*)g_scList[scid].pTLSContext)->context_type = WICED_TLS_ADVANCED_CONTEXT;
-
-#if 1 // kaizen	20130520 ID1068 - Modified for using dct_security_section
-					platform_dct_security_t const* dct_security = wiced_dct_get_security_section( );
-					if ((result=wiced_tls_init_advanced_context(g_scList[scid].pTLSContext, dct_security->certificate, dct_security->private_key ))!=WICED_SUCCESS )
-						W_DBG("SocketProcess : wiced_tls_init_context failed (%d)", result);
-					if ( (result=wiced_tcp_enable_tls(&socket_tcp, g_scList[scid].pTLSContext))!=WICED_SUCCESS )
-						W_DBG("SocketProcess : wiced_tcp_enable_tls failed (%d)", result);
+		sc->connect_time = host_rtos_get_time();
+		sc->state = WX_SC_STATE_CONNECT;
+	}
+}
 
-#else
-					if ( (result=wiced_tls_init_advanced_context(g_scList[scid].pTLSContext, brcm_server_certificate, brcm_server_rsa_key))!=WICED_SUCCESS )
-						W_DBG("SocketProcess : wiced_tls_init_context failed (%d)", result);
-					if ( (result=wiced_tcp_enable_tls(&socket_tcp, g_scList[scid].pTLSContext))!=WICED_SUCCESS )
-						W_DBG("SocketProcess : wiced_tcp_enable_tls failed (%d)", result);
-#endif
-				}
+// TCP is up : start the TLS handshake if the SCID uses TLS, WX_SC_STATE_HANDSHAKE then steps it
+static UINT8 WXNetwork_SocketStartTLS(UINT8 scid, wiced_tls_endpoint_type_t type)
+{
+	WT_SCSERVICE* sc = &g_scService[scid];
 
-				// kaizen 20140529
-				if ( g_wxProfile.enable_listen_msg )
-					WXS2w_StatusNotify(WXCODE_LISTEN, scid);
+	if ( sc->sock.tcp.tls_context==NULL )	return 0;
 
-				while (1)
-				{
-					wiced_result_t result = wiced_tcp_accept(&socket_tcp);
-
-					if ( result==WICED_TIMEOUT )	continue;
-					else
-					{
-						if ( result!=WICED_SUCCESS )
-						{
-							W_DBG("SocketOpenProcess : accept error %d, %d, %d", result, scid, g_scList[scid].localPort);
-							wiced_tcp_delete_socket(&socket_tcp);
-							WXNetwork_ClearSCList(scid);
-							ClearSocketOpenThread(scid);
-							return;
-						}
-						else
-						{
-							break;
-						}
-					}
-				}
+	if ( wiced_tcp_start_tls_async(&sc->sock.tcp, type, WICED_TLS_DEFAULT_VERIFICATION)!=WICED_SUCCESS )
+	{
+		W_DBG("SocketOpenProcess : TLS error, %d, %d", scid, g_scList[scid].localPort);
+		WXNetwork_SocketAbort(scid);
+		return 1;
+	}
 
-				g_scList[scid].bAccepted = 1;
+	sc->connect_time = host_rtos_get_time();
+	sc->handshake_idle = 0;
+	sc->state = WX_SC_STATE_HANDSHAKE;
+	wiced_rtos_set_semaphore(&g_scServiceSemaphore);
+	return 1;
+}
 
-				/////////////////////////////////////////////////////////////////////////////////
-				// sekim 20130131 Accepted Client Information(IP, Port) Using NetX API
-				ULONG peer_ip_address = 0;
-				ULONG peer_port = 0;
-				if ( NX_SUCCESS!=nx_tcp_socket_peer_info_get(&socket_tcp.socket, &peer_ip_address, &peer_port) )
-				{
-					W_DBG("SocketProcess : nx_tcp_socket_peer_info_get error");
-				}
-				else
-				{
-					SET_IPV4_ADDRESS(g_scList[scid].remoteIp, peer_ip_address);
-					g_scList[scid].remotePort = peer_port;
-				}
-				/////////////////////////////////////////////////////////////////////////////////
-			}
-			else
-			{
-				if ( g_scList[scid].tlsMode=='S' )
-				{
-#if 1				// kaizen 20140428 ID1088 Modified to connect to TCP Server using exchanging certificate.
-					g_scList[scid].pTLSContext = malloc_named("TLS-Context", sizeof(wiced_tls_advanced_context_t));
-					memset(g_scList[scid].pTLSContext, 0, sizeof(wiced_tls_advanced_context_t));
-					((wiced_tls_advanced_context_t*)g_scList[scid].pTLSContext)->context_type = WICED_TLS_ADVANCED_CONTEXT;
+static void WXNetwork_SocketAccepted(UINT8 scid)
+{
+	wiced_tcp_socket_t* socket_tcp = &g_scService[scid].sock.tcp;
 
-					platform_dct_security_t const* dct_security = wiced_dct_get_security_section( );
+	g_scList[scid].bAccepted = 1;
 
-					if ((result=wiced_tls_init_advanced_context(g_scList[scid].pTLSContext, dct_security->certificate, dct_security->private_key ))!=WICED_SUCCESS )
-						W_DBG("SocketProcess : wiced_tls_init_context failed (%d)", result);
-					if ( (result=wiced_tcp_enable_tls(&socket_tcp, g_scList[scid].pTLSContext))!=WICED_SUCCESS )
-						W_DBG("SocketProcess : wiced_tcp_enable_tls failed (%d)", result);
-#else
-					// sekim 20130311 2.2.1 Migration, about TLS
-					g_scList[scid].pTLSContext = malloc_named("TLS-Context", sizeof(wiced_tls_simple_context_t));
-					memset(g_scList[scid].pTLSContext, 0, sizeof(wiced_tls_simple_context_t));
-					((wiced_tls_simple_context_t*)g_scList[scid].pTLSContext)->context_type = WICED_TLS_SIMPLE_CONTEXT;
-					if ( (result=wiced_tls_init_simple_context(g_scList[scid].pTLSContext))!=WICED_SUCCESS )
-						W_DBG("SocketProcess : wiced_tls_init_context failed (%d)", result);
-					if ( (result=wiced_tcp_enable_tls(&socket_tcp, g_scList[scid].pTLSContext))!=WICED_SUCCESS )
-						W_DBG("SocketProcess : wiced_tcp_enable_tls failed (%d)", result);
-#endif
-				}
+	/////////////////////////////////////////////////////////////////////////////////
+	// sekim 20130131 Accepted Client Information(IP, Port) Using NetX API
+	ULONG peer_ip_address = 0;
+	ULONG peer_port = 0;
+	if ( NX_SUCCESS!=nx_tcp_socket_peer_info_get(&socket_tcp->socket, &peer_ip_address, &peer_port) )
+	{
+		W_DBG("SocketProcess : nx_tcp_socket_peer_info_get error");
+	}
+	else
+	{
+		SET_IPV4_ADDRESS(g_scList[scid].remoteIp, peer_ip_address);
+		g_scList[scid].remotePort = peer_port;
+	}
+	/////////////////////////////////////////////////////////////////////////////////
 
-#if 0 //MikeJ 130624 ID1084 - Modified local-port checking part
-				wiced_tcp_bind(&socket_tcp, WICED_ANY_PORT);
-				g_scList[scid].localPort = 0;
-#else
-				////////////////////////////////////////////////////////////////////////////////
-				// sekim 20150416 TCP client random local port
-				static uint16_t tcp_client_port_add = 0;
-			    if ( tcp_client_port_add==0 )
-			    {
-			    	uint16_t random_value = 0;
-			    	extern wiced_result_t wiced_wifi_get_random( uint16_t* val );
-			    	wiced_wifi_get_random(&random_value);
-			    	tcp_client_port_add = random_value%10000 + 1;
-			    }
-				if ( g_scList[scid].localPort==0 )
-				{
-					g_scList[scid].localPort = NX_SEARCH_PORT_START + tcp_client_port_add++;
-				}
-				////////////////////////////////////////////////////////////////////////////////
+	WXNetwork_SocketConnected(scid);
+}
 
+static void WXNetwork_SocketAccept(UINT8 scid)
+{
+	wiced_tcp_socket_t* socket_tcp = &g_scService[scid].sock.tcp;
+	UINT state = socket_tcp->socket.nx_tcp_socket_state;
 
-				wiced_tcp_bind(&socket_tcp, g_scList[scid].localPort);
-				g_scList[scid].localPort = socket_tcp.socket.nx_tcp_socket_port;
-#endif
+	if ( socket_tcp->socket.nx_tcp_socket_ip_ptr->nx_ip_driver_link_up==0 || state==NX_TCP_CLOSED )
+	{
+		W_DBG("SocketOpenProcess : accept error %d, %d, %d", state, scid, g_scList[scid].localPort);
+		WXNetwork_SocketAbort(scid);
+		return;
+	}
 
-				result = wiced_tcp_connect(&socket_tcp, &g_scList[scid].remoteIp, g_scList[scid].remotePort, TCP_CLIENT_CONNECT_TIMEOUT);
-				if ( result!=WICED_SUCCESS )
-				{
-					W_DBG("SocketOpenProcess : connect error %s, %d", WXNetwork_WicedV4IPToString(0, g_scList[scid].remoteIp), g_scList[scid].localPort);
-					wiced_tcp_delete_socket(&socket_tcp);
-					WXNetwork_ClearSCList(scid);
-					ClearSocketOpenThread(scid);
-					return;
-				}
-				//W_DBG("SocketOpenProcess : connect OK %s, %d", WXNetwork_WicedV4IPToString(0, g_scList[scid].remoteIp), g_scList[scid].localPort);
-			}
+	if ( state==NX_TCP_LISTEN_STATE || state==NX_TCP_SYN_RECEIVED )
+	{
+		// answers a queued connection request without blocking, succeeds once it is established
+		if ( nx_tcp_server_socket_accept(&socket_tcp->socket, NX_NO_WAIT)!=NX_SUCCESS )	return;
+	}
 
-			// sekim 201506 After connected, switch into data mode
-			if ( buff_SocketOpenSCInfo.dataMode==1 )
-			{
-				g_isAutoconnected = 1;
-				g_currentScid = scid;
+	if ( WXNetwork_SocketStartTLS(scid, WICED_TLS_AS_SERVER) )	return;
 
-				// sekim 20130801 TCP Serve/Data mode -> Command Mode -> Disconnect -> To be Command mode
-				if ( command_mode_when_disconnected==0 )
-				{
-					g_wxModeState = WX_MODE_DATA;
-					WXS2w_LEDIndication(2, 0, 0, 0, 0, 1);
-				}
-			}
+	WXNetwork_SocketAccepted(scid);
+}
 
-			WXS2w_StatusNotify(WXCODE_CON_SUCCESS, scid);
+static void WXNetwork_SocketConnect(UINT8 scid)
+{
+	wiced_tcp_socket_t* socket_tcp = &g_scService[scid].sock.tcp;
+	UINT state = socket_tcp->socket.nx_tcp_socket_state;
 
-			// sekim 20140625 ID1176 add option to clear tcp-idle-connection
-			g_scList[scid].tcp_time_lastdata = host_rtos_get_time();
-			// sekim 20140929 ID1188 Data-Idle-Auto-Reset (Autonix)
-			g_time_lastdata = g_scList[scid].tcp_time_lastdata;
+	if ( state==NX_TCP_SYN_SENT )
+	{
+		if ( (host_rtos_get_time() - g_scService[scid].connect_time) < TCP_CLIENT_CONNECT_TIMEOUT )	return;
+	}
+	else if ( state==NX_TCP_ESTABLISHED )
+	{
+		if ( WXNetwork_SocketStartTLS(scid, WICED_TLS_AS_CLIENT) )	return;
 
-			while(1)
-			{
-				result = wiced_tcp_receive(&socket_tcp, &rx_packet, WICED_WAIT_FOREVER);
+		WXNetwork_SocketConnected(scid);
+		return;
+	}
 
-				//W_DBG("SocketOpenProcess : wiced_tcp_receive %d, %d", result, socket_tcp.socket.nx_tcp_socket_state);
+	W_DBG("SocketOpenProcess : connect error %s, %d", WXNetwork_WicedV4IPToString(0, g_scList[scid].remoteIp), g_scList[scid].localPort);
+	WXNetwork_SocketAbort(scid);
+}
 
-				if ( result!=WICED_SUCCESS )
-				{
-					// sekim wiced_tcp_receive return value processing
-					if ( result==WICED_PENDING )
-					{
-						/*
-						if ( socket_tcp.socket.nx_tcp_socket_state!=NX_TCP_CLOSED &&
-							 socket_tcp.socket.nx_tcp_socket_state!=NX_TCP_FIN_WAIT_1 &&
-							 socket_tcp.socket.nx_tcp_socket_state!=NX_TCP_FIN_WAIT_2 )
-							 */
-						if ( socket_tcp.socket.nx_tcp_socket_state==NX_TCP_ESTABLISHED )
-							continue;
-					}
-
-					//W_DBG("SocketOpenProcess : Disconnect (%d, %d) %s, %d", result, socket_tcp.socket.nx_tcp_socket_state, WXNetwork_WicedV4IPToString(0, g_scList[scid].remoteIp), g_scList[scid].localPort);
-
-					////////////////////////////////////////////////////////////////////////////////////
-					// sekim 20140625 ID1176 add option to clear tcp-idle-connection
-					/*
-					////////////////////////////////////////////////////////////////////////////////////
-					// sekim 20130411 tcp_restart_check
-					tcp_restart_check = 1;
-#if 1 // sekim 20130416 ID1050
-					if ( !bServer || (result==2 && socket_tcp.socket.nx_tcp_socket_state==7) )
-#else
-					if ( result==2 && socket_tcp.socket.nx_tcp_socket_state==7 )
-#endif
-					{
-						tcp_restart_check = 0;
-					}
-					////////////////////////////////////////////////////////////////////////////////////
-					 */
-					if ( bServer )	tcp_restart_check = 1;
-					else 			tcp_restart_check = 0;
-					if ( g_scList[scid].notRestartTCPServer )	tcp_restart_check = 0;
-					////////////////////////////////////////////////////////////////////////////////////
-
-					if ( g_wxModeState==WX_MODE_COMMAND )	command_mode_when_disconnected = 1;
-					else									command_mode_when_disconnected = 0;
-
-					wiced_packet_delete(rx_packet);
-					wiced_tcp_disconnect(&socket_tcp);
-					wiced_tcp_delete_socket(&socket_tcp);
-					WXNetwork_ClearSCList(scid);
-					break;
-				}
+// One handshake step per pass so the other SCIDs keep being served between the RSA operations.
+// A step that made no progress is waiting on the peer : the next one waits for received data.
+static void WXNetwork_SocketHandshake(UINT8 scid)
+{
+	WT_SCSERVICE* sc = &g_scService[scid];
+	wiced_tcp_socket_t* socket_tcp = &sc->sock.tcp;
+	wiced_tls_simple_context_t* tls_context = (wiced_tls_simple_context_t*)socket_tcp->tls_context;
+	wiced_result_t result;
+	int prev_state;
 
-				wiced_packet_get_data(rx_packet, 0, (uint8_t**)&rx_data, &rx_data_length, &available_data_length);
-#if 0 //MikeJ 130806 ID1112 - Target IP/Port shouldn't be changed when packet was received on UDP Client
-				WXNetwork_NetRx(scid, rx_data, rx_data_length);
-#else
-				WXNetwork_NetRx(scid, rx_data, rx_data_length, NULL, NULL);
-#endif
-				wiced_packet_delete(rx_packet);
-			}
-		}
-		else
-		{
-#if 1 //MikeJ 130806 ID1112 - Target IP/Port shouldn't be changed when packet was received on UDP Client
-			wiced_ip_address_t rmtIp;
-			UINT16 rmtPort;
-#endif
+	if ( socket_tcp->socket.nx_tcp_socket_state!=NX_TCP_ESTABLISHED || (host_rtos_get_time() - sc->connect_time) >= TLS_HANDSHAKE_TIMEOUT )
+	{
+		W_DBG("SocketOpenProcess : TLS handshake error, %d, %d", scid, g_scList[scid].localPort);
+		wiced_tcp_tls_handshake_abort(socket_tcp);
+		WXNetwork_SocketAbort(scid);
+		return;
+	}
 
-			// daniel 20160630 After connected, switch into data mode in UDP mode
-			if ( buff_SocketOpenSCInfo.dataMode==1 )
-			{
-				g_isAutoconnected = 1;
-				g_currentScid = scid;
+	if ( sc->handshake_idle && socket_tcp->socket.nx_tcp_socket_receive_queue_count==0 )	return;
 
-				// sekim 20130801 TCP Serve/Data mode -> Command Mode -> Disconnect -> To be Command mode
-				if ( command_mode_when_disconnected==0 )
-				{
-					g_wxModeState = WX_MODE_DATA;
-					WXS2w_LEDIndication(2, 0, 0, 0, 0, 1);
-				}
-			}
-			/////
+	prev_state = tls_context->context.state;
+	result = wiced_tcp_tls_handshake_step(socket_tcp);
+	if ( result==WICED_PENDING )
+	{
+		sc->handshake_idle = (tls_context->context.state==prev_state)?1:0;
+		if ( !sc->handshake_idle )	wiced_rtos_set_semaphore(&g_scServiceSemaphore);
+		return;
+	}
 
-			WXS2w_StatusNotify(WXCODE_CON_SUCCESS, scid);
+	if ( result!=WICED_SUCCESS )
+	{
+		W_DBG("SocketOpenProcess : TLS handshake error, %d, %d", scid, g_scList[scid].localPort);
+		WXNetwork_SocketAbort(scid);
+		return;
+	}
 
-			while(1)
-			{
-				result = wiced_udp_receive(&socket_udp, &rx_packet, WICED_WAIT_FOREVER);
-				if ( result!=WICED_SUCCESS )
-				{
-					//W_DBG("SocketOpenProcess : Disconnect (%d) %s, %d", result, WXNetwork_WicedV4IPToString(0, g_scList[scid].remoteIp), g_scList[scid].localPort);
+	if ( sc->info.conMode==WX_SC_MODE_SERVER )	WXNetwork_SocketAccepted(scid);
+	else										WXNetwork_SocketConnected(scid);
+}
 
-					wiced_packet_delete(rx_packet);
-					wiced_udp_delete_socket(&socket_udp);
-					WXNetwork_ClearSCList(scid);
-					break;
-				}
+// AT+SDNAME : look the name up without waiting, WX_SC_STATE_RESOLVE picks the answer up
+static void WXNetwork_SocketResolve(UINT8 scid)
+{
+	WT_SCSERVICE* sc = &g_scService[scid];
+	UINT32 ip[4];
+	char tail;
+	wiced_result_t result;
 
-#if 0 //MikeJ 130806 ID1112 - Target IP/Port shouldn't be changed when packet was received on UDP Client
-				wiced_udp_packet_get_info(rx_packet, &g_scList[scid].remoteIp, &g_scList[scid].remotePort);
+	// a dotted address needs no query
+	if ( sscanf(g_wxProfile.domainname_for_scon, "%u.%u.%u.%u%c", &ip[0], &ip[1], &ip[2], &ip[3], &tail)==4 )
+	{
+		SET_IPV4_ADDRESS(sc->info.remoteIp, MAKE_IPV4_ADDRESS(ip[0], ip[1], ip[2], ip[3]));
+		return;
+	}
 
-				wiced_packet_get_data(rx_packet, 0, (uint8_t**)&rx_data, &rx_data_length, &available_data_length);
-				WXNetwork_NetRx(scid, rx_data, rx_data_length);
-				wiced_packet_delete(rx_packet);
-#else
-				wiced_packet_get_data(rx_packet, 0, (uint8_t**)&rx_data, &rx_data_length, &available_data_length);
-				if ( bServer ) {
-					wiced_udp_packet_get_info(rx_packet, &g_scList[scid].remoteIp, &g_scList[scid].remotePort);
-					WXNetwork_NetRx(scid, rx_data, rx_data_length, NULL, NULL);
-				} else {
-					wiced_udp_packet_get_info(rx_packet, &rmtIp, &rmtPort);
-					WXNetwork_NetRx(scid, rx_data, rx_data_length, &rmtIp, &rmtPort);
-				}
-				wiced_packet_delete(rx_packet);
-#endif
-			}
-		}
+	sc->resolve_done = 0;
+	sc->resolve_seq++;
+	sc->state = WX_SC_STATE_RESOLVE;
+	result = dns_client_hostname_lookup_async(g_wxProfile.domainname_for_scon, SCON_DNS_LOOKUP_TIMEOUT, WXNetwork_SocketResolved, (void*)(((UINT32)sc->resolve_seq << 8) | scid));
+	if ( result!=WICED_SUCCESS )
+	{
+		sc->resolve_result = result;
+		sc->resolve_done = 1;
+	}
+}
 
-		if ( tcp_restart_check==0 )		break;
+static void WXNetwork_SocketResolveDone(UINT8 scid)
+{
+	WT_SCSERVICE* sc = &g_scService[scid];
+
+	if ( !sc->resolve_done )	return;
 
-		///////////////////////////////////////////////////////////////////////////////////////////
-		// sekim 20130709 ID1089 if Socket Close by AT Command, don't restart <TCP Server>
-		if ( g_scList[scid].notRestartTCPServer==1 )
+	if ( sc->resolve_result==WICED_SUCCESS )
+	{
+		memcpy(&sc->info.remoteIp, &sc->resolve_ip, sizeof(wiced_ip_address_t));
+	}
+	else
+	{
+		W_DBG("SocketProcess : wiced_hostname_lookup failed (%s)", g_wxProfile.domainname_for_scon);
+	}
+
+	sc->state = WX_SC_STATE_OPEN;
+	WXNetwork_SocketStart(scid);
+}
+
+// Connection lost or closed : release the SCID, or listen again if it was a TCP server
+static void WXNetwork_SocketDisconnected(UINT8 scid)
+{
+	WT_SCSERVICE* sc = &g_scService[scid];
+	UINT8 tcp_restart_check = 0;
+
+	if ( sc->info.conType!=WX_SC_CONTYPE_TCP )
+	{
+		wiced_udp_delete_socket(&sc->sock.udp);
+		WXNetwork_ClearSCList(scid);
+		sc->state = WX_SC_STATE_IDLE;
+		return;
+	}
+
+	// sekim 20140625 ID1176 add option to clear tcp-idle-connection
+	if ( sc->info.conMode==WX_SC_MODE_SERVER )	tcp_restart_check = 1;
+	if ( g_scList[scid].notRestartTCPServer )		tcp_restart_check = 0;
+
+	// sekim XXXX 20160119 Add socket_ext_option9 for TCP Server Multi-Connection
+	if ( g_wxProfile.socket_ext_option9==1 )		tcp_restart_check = 0;
+
+	if ( g_wxModeState==WX_MODE_COMMAND )	sc->command_mode_when_disconnected = 1;
+	else									sc->command_mode_when_disconnected = 0;
+
+	wiced_tcp_disconnect(&sc->sock.tcp);
+	wiced_tcp_delete_socket(&sc->sock.tcp);
+	WXNetwork_ClearSCList(scid);
+
+	// the slot stays reserved while a TCP server restarts, WXNetwork_ScidGet() skips it
+	sc->state = (tcp_restart_check)?WX_SC_STATE_OPEN:WX_SC_STATE_IDLE;
+}
+
+static void WXNetwork_SocketReceive(UINT8 scid)
+{
+	WT_SCSERVICE* sc = &g_scService[scid];
+	wiced_result_t result;
+	wiced_packet_t* rx_packet;
+	char* rx_data;
+	uint16_t rx_data_length;
+	uint16_t available_data_length;
+
+	if ( sc->info.conType==WX_SC_CONTYPE_TCP )
+	{
+		while ( (result=wiced_tcp_receive(&sc->sock.tcp, &rx_packet, WICED_NO_WAIT))==WICED_SUCCESS )
 		{
-			g_scList[scid].notRestartTCPServer = 0;
-			break;
+			wiced_packet_get_data(rx_packet, 0, (uint8_t**)&rx_data, &rx_data_length, &available_data_length);
+			WXNetwork_NetRx(scid, rx_data, rx_data_length, NULL, NULL);
+			wiced_packet_delete(rx_packet);
 		}
-		///////////////////////////////////////////////////////////////////////////////////////////
 
-		// sekim XXXX 20160119 Add socket_ext_option9 for TCP Server Multi-Connection
-		if ( bTCP & bServer )
+		if ( result==WICED_NOTUP || sc->sock.tcp.socket.nx_tcp_socket_state!=NX_TCP_ESTABLISHED )
+			WXNetwork_SocketDisconnected(scid);
+	}
+	else
+	{
+		//MikeJ 130806 ID1112 - Target IP/Port shouldn't be changed when packet was received on UDP Client
+		wiced_ip_address_t rmtIp;
+		UINT16 rmtPort;
+
+		while ( (result=wiced_udp_receive(&sc->sock.udp, &rx_packet, WICED_NO_WAIT))==WICED_SUCCESS )
 		{
-			if ( g_wxProfile.socket_ext_option9==1 )		break;
+			wiced_packet_get_data(rx_packet, 0, (uint8_t**)&rx_data, &rx_data_length, &available_data_length);
+			if ( sc->info.conMode==WX_SC_MODE_SERVER ) {
+				wiced_udp_packet_get_info(rx_packet, &g_scList[scid].remoteIp, &g_scList[scid].remotePort);
+				WXNetwork_NetRx(scid, rx_data, rx_data_length, NULL, NULL);
+			} else {
+				wiced_udp_packet_get_info(rx_packet, &rmtIp, &rmtPort);
+				WXNetwork_NetRx(scid, rx_data, rx_data_length, &rmtIp, &rmtPort);
+			}
+			wiced_packet_delete(rx_packet);
 		}
 
+		if ( result==WICED_NOTUP )	WXNetwork_SocketDisconnected(scid);
 	}
+}
+
+static void WXNetwork_SocketService(uint32_t arguments)
+{
+	UINT8 scid;
+
+	while ( 1 )
+	{
+		wiced_rtos_get_semaphore(&g_scServiceSemaphore, WX_SOCKET_SERVICE_POLL_TIME);
+
+		for ( scid=0; scid<WX_MAX_SCID_RANGE; scid++ )
+		{
+			WT_SCSERVICE* sc = &g_scService[scid];
+
+			if ( sc->evtOpen )
+			{
+				// LaunchSocketOpen() fills sc->info under this mutex; the slot only becomes OPEN here,
+				// so no pass can start the socket before the AT+SDNAME lookup below is made
+				wiced_rtos_lock_mutex(&g_socketopen_wizmutex);
+				sc->state = WX_SC_STATE_OPEN;
+				sc->evtOpen = 0;
+				wiced_rtos_unlock_mutex(&g_socketopen_wizmutex);
+
+				// sekim 20150616 add AT+SDNAME
+				if ( GET_IPV4_ADDRESS(sc->info.remoteIp)==0 && strlen(g_wxProfile.domainname_for_scon)>3 )
+					WXNetwork_SocketResolve(scid);
+			}
 
-	ClearSocketOpenThread(scid);
+			if ( sc->evtClose )
+			{
+				sc->evtClose = 0;
+
+				if ( sc->state==WX_SC_STATE_HANDSHAKE )
+				{
+					wiced_tcp_tls_handshake_abort(&sc->sock.tcp);
+					WXNetwork_SocketAbort(scid);
+					continue;
+				}
+				if ( sc->state==WX_SC_STATE_LISTEN || sc->state==WX_SC_STATE_CONNECT )
+				{
+					WXNetwork_SocketAbort(scid);
+					continue;
+				}
+				if ( sc->state==WX_SC_STATE_ESTABLISHED )
+				{
+					WXNetwork_SocketDisconnected(scid);
+					continue;
+				}
+				if ( sc->state==WX_SC_STATE_OPEN || sc->state==WX_SC_STATE_RESOLVE )
+				{
+					// no socket yet; a lookup still running is answered into a released slot and dropped
+					sc->resolve_seq++;
+					sc->state = WX_SC_STATE_IDLE;
+					continue;
+				}
+			}
 
-	return;
+			switch ( sc->state )
+			{
+			case WX_SC_STATE_OPEN:			WXNetwork_SocketStart(scid);	break;
+			case WX_SC_STATE_LISTEN:		WXNetwork_SocketAccept(scid);	break;
+			case WX_SC_STATE_CONNECT:		WXNetwork_SocketConnect(scid);	break;
+			case WX_SC_STATE_ESTABLISHED:	WXNetwork_SocketReceive(scid);	break;
+			case WX_SC_STATE_RESOLVE:		WXNetwork_SocketResolveDone(scid);	break;
+			case WX_SC_STATE_HANDSHAKE:		WXNetwork_SocketHandshake(scid);	break;
+			default:														break;
+			}
+		}
+	}
 }
 
-UINT16 g_socket_open_thread_stack_xxx = 4;
 void LaunchSocketOpen(UINT8 scid, UINT8 bTCP, UINT8 bServer, UINT8 tlsMode, wiced_ip_address_t remote_ip, UINT16 remote_port, UINT16 local_port, UINT8 bDataMode)
 {
+	WT_SCSERVICE* sc;
+
+	if ( scid >= WX_MAX_SCID_RANGE )	return;
+	sc = &g_scService[scid];
+
 	wiced_rtos_lock_mutex(&g_socketopen_wizmutex);
 
-	g_SocketOpenSCList = scid;
+	memset(&sc->info, 0, sizeof(sc->info));
+	sc->info.conType = (bTCP)?WX_SC_CONTYPE_TCP:WX_SC_CONTYPE_UDP;
+	sc->info.conMode = (bServer)?WX_SC_MODE_SERVER:WX_SC_MODE_CLIENT;
+	sc->info.dataMode = bDataMode;
+	sc->info.tlsMode = tlsMode;
+	sc->info.localPort = local_port;
+	sc->info.remotePort = remote_port;
+	memcpy(&sc->info.remoteIp, &remote_ip, sizeof(remote_ip));
+	sc->command_mode_when_disconnected = 0;
+	sc->evtClose = 0;
 
-	g_SocketOpenSCInfo.conType = (bTCP)?WX_SC_CONTYPE_TCP:WX_SC_CONTYPE_UDP;
-	g_SocketOpenSCInfo.conMode = (bServer)?WX_SC_MODE_SERVER:WX_SC_MODE_CLIENT;
-	g_SocketOpenSCInfo.dataMode = bDataMode;
-	g_SocketOpenSCInfo.tlsMode = tlsMode;
-	g_SocketOpenSCInfo.localPort = local_port;
-	g_SocketOpenSCInfo.remotePort = remote_port;
-	memcpy(&g_SocketOpenSCInfo.remoteIp, &remote_ip, sizeof(remote_ip));
+	// reserves the slot, the socket service thread moves it to OPEN and creates the socket
+	sc->evtOpen = 1;
 
-	wiced_result_t result;
-	char szThread[20];
-	sprintf(szThread, "Socket-%d", scid);
-	// sekim 20130208 SocketOpen Thread Optimizing (g_socket_open_thread_stack_xxx)
-	if ( (result=wiced_rtos_create_thread((wiced_thread_t*)&g_socketopen_thread[scid], WICED_APPLICATION_PRIORITY + 3, szThread, SocketOpenProcess, 1024*g_socket_open_thread_stack_xxx, NULL))!=WICED_SUCCESS )
-	{
-		W_DBG("wiced_rtos_create_thread : SocketOpenProcess error %d (rebooting?)", result);
-	}
+	wiced_rtos_unlock_mutex(&g_socketopen_wizmutex);
 
-	// sekim 20130816 ID1114, ID1124 add delay() in successive socket process
-	wiced_rtos_delay_milliseconds(100);
+	wiced_rtos_set_semaphore(&g_scServiceSemaphore);
 }
 
 // sekim XXXX 20160119 Add socket_ext_option9 for TCP Server Multi-Connection
@@ -783,8 +1083,7 @@ void check_tcp_idle_time()
 
 			if ( (diff_seconds/1000)>=g_wxProfile.socket_ext_option5 )
 			{
-				//WXNetwork_CloseSCList(index_scid);
-				wiced_tcp_disconnect((wiced_tcp_socket_t*)g_scList[index_scid].pSocket);
+				WXNetwork_CloseSCList(index_scid);
 			}
 		}
 	}
@@ -2,7 +2,6 @@
 #define WX_PLATFORM_RTOS_SOCKET_H
 
 extern WT_SCLIST g_scList[WX_MAX_SCID_RANGE];
-extern wiced_thread_t g_socketopen_thread[WX_MAX_SCID_RANGE];
 extern UINT8 g_scRxBuffer[WX_DATABUFFER_SIZE];
 
 // sekim 20140929 ID1188 Data-Idle-Auto-Reset (Autonix)
@@ -22,8 +21,12 @@ UINT8 WXNetwork_NetRx(UINT8 scid, VOID *buf, UINT32 len);
 UINT8 WXNetwork_NetRx(UINT8 scid, VOID *buf, UINT32 len, wiced_ip_address_t* rmtIP, UINT16* rmtPort);
 #endif
 UINT8 WXNetwork_NetTx(UINT8 scid, VOID *buf, UINT32 len);
+UINT32 WXNetwork_NetTxAppend(UINT8 scid, UINT8 *data, UINT32 len);
+UINT8* WXNetwork_NetTxStaged(UINT32 *len);
+UINT32 WXNetwork_NetTxSpace(VOID);
+UINT8 WXNetwork_NetTxFlush(VOID);
+VOID WXNetwork_NetTxDiscard(VOID);
 
-void SocketOpenProcess(uint32_t arguments);
 void LaunchSocketOpen(UINT8 scid, UINT8 bTCP, UINT8 bServer, UINT8 tlsMode, wiced_ip_address_t remote_ip, UINT16 remote_port, UINT16 local_port, UINT8 bDataMode);
 
 void check_tcp_idle_time();
@@ -422,6 +422,7 @@ VOID WXS2w_StatusNotify(UINT8 status, UINT32 arg)
 		WXS2w_LEDIndication(2, 0, 0, 0, 0, 0);
 
 		g_scTxIndex = 0;
+		WXNetwork_NetTxDiscard();
 	}
 }
 
@@ -482,6 +483,8 @@ VOID WXS2w_SerialInput(VOID)
 	static char esc[4] = { '+', '+', '+', '+' };
 	static UINT8 inited;
 	static UINT8 prev = 0;
+	static UINT8 rxbuf[WX_SERIAL_RX_CHUNK_SIZE];
+	UINT32 rxlen, rxpos, span, more;
 	UINT8 ch;
 
 	if ( prev == 0 )
@@ -509,8 +512,21 @@ VOID WXS2w_SerialInput(VOID)
 		{
 			wiced_update_system_monitor(&wizfi_task_monitor_item, MAXIMUM_ALLOWED_INTERVAL_BETWEEN_WIZFIMAINTASK);
 
-			if ( wiced_uart_receive_bytes(WICED_UART_1, &ch, 1, 100)==WICED_SUCCESS )
+			rxlen = 1;
+			if ( wiced_uart_receive_available_bytes(WICED_UART_1, rxbuf, &rxlen, 100)==WICED_SUCCESS && rxlen>0 )
 			{
+				// In data mode, drain everything else the USART ring buffer holds in the same pass.
+				// Command mode stays byte by byte: AT+SSEND, AT+MQTTPUB and AT+MCERT read their payload
+				// straight from the UART, so nothing past a command's CR may be taken out of it here.
+				// The mode is checked once the first byte is in, as an escape may end data mode meanwhile.
+				if ( g_wxModeState == WX_MODE_DATA )
+				{
+					more = sizeof(rxbuf) - 1;
+					if ( wiced_uart_receive_available_bytes(WICED_UART_1, &rxbuf[1], &more, 0)==WICED_SUCCESS )
+					{
+						rxlen += more;
+					}
+				}
 				break;
 			}
 
@@ -543,65 +559,82 @@ VOID WXS2w_SerialInput(VOID)
 		}
 		//////////////////////////////////////////////////////////////////////////////////////////
 
-#if 1 //MikeJ 130410 ID1034 - Add ECHO on/off function
-		if ( g_wxModeState == WX_MODE_COMMAND && g_wxProfile.echo_mode == TRUE )
+		for (rxpos=0; rxpos<rxlen; )
 		{
-			if(ch == 0x0d) {
-				WXHal_CharPut(0x0d);
-				WXHal_CharPut(0x0a);
-			} else if(ch != 0x0a) {
-				WXHal_CharPut(ch);
-			}
-		}
-#else
-		if ( (g_wxModeState == WX_MODE_COMMAND) )
-		{
-			WXHal_CharPut(ch);
-		}
-#endif
+			// In data mode, a run of bytes that cannot start or extend an escape sequence goes to the packetizer in one span
+			if ( g_wxModeState == WX_MODE_DATA && g_auto_esc == 0 && rxbuf[rxpos] != '+' )
+			{
+				span = 1;
+				while ( (rxpos + span) < rxlen && rxbuf[rxpos + span] != '+' )	span++;
 
-		switch (g_wxModeState)
-		{
-		case WX_MODE_COMMAND:
-			WXS2w_CommandCharProcess(ch);
-			break;
+				WXS2w_DataSpanProcess(&rxbuf[rxpos], span);
+				rxpos += span;
+				prev = rxbuf[rxpos - 1];
+				continue;
+			}
 
-		case WX_MODE_DATA:
+			ch = rxbuf[rxpos++];
 
-			// Handle auto connect mode escape sequence.
-			if ( ch == '+' && g_auto_esc < 3 )
+#if 1 //MikeJ 130410 ID1034 - Add ECHO on/off function
+			if ( g_wxModeState == WX_MODE_COMMAND && g_wxProfile.echo_mode == TRUE )
 			{
-				g_auto_esc++;
-
-		    	wiced_rtos_stop_timer(&g_autoesc_timer.timer);
-		    	wiced_rtos_reload_timer(&g_autoesc_timer.timer);
-		    	wiced_rtos_start_timer(&g_autoesc_timer.timer);
+				if(ch == 0x0d) {
+					WXHal_CharPut(0x0d);
+					WXHal_CharPut(0x0a);
+				} else if(ch != 0x0a) {
+					WXHal_CharPut(ch);
+				}
 			}
-			else if ( g_auto_esc )
+#else
+			if ( (g_wxModeState == WX_MODE_COMMAND) )
 			{
-				UINT8 i;
+				WXHal_CharPut(ch);
+			}
+#endif
 
-				esc[g_auto_esc] = ch;
+			switch (g_wxModeState)
+			{
+			case WX_MODE_COMMAND:
+				WXS2w_CommandCharProcess(ch);
+				break;
+
+			case WX_MODE_DATA:
 
-				i = 0;
-				while (i <= g_auto_esc)
+				// Handle auto connect mode escape sequence.
+				if ( ch == '+' && g_auto_esc < 3 )
 				{
-					WXS2w_DataCharProcess(esc[i++]);
+					g_auto_esc++;
+
+			    	wiced_rtos_stop_timer(&g_autoesc_timer.timer);
+			    	wiced_rtos_reload_timer(&g_autoesc_timer.timer);
+			    	wiced_rtos_start_timer(&g_autoesc_timer.timer);
 				}
+				else if ( g_auto_esc )
+				{
+					UINT8 i;
 
-				esc[g_auto_esc] = '+';
-				g_auto_esc = 0;
-			}
-			else
-			{
-				g_auto_esc = 0;
-				WXS2w_DataCharProcess(ch);
-			}
+					esc[g_auto_esc] = ch;
 
-			break;
+					i = 0;
+					while (i <= g_auto_esc)
+					{
+						WXS2w_DataCharProcess(esc[i++]);
+					}
+
+					esc[g_auto_esc] = '+';
+					g_auto_esc = 0;
+				}
+				else
+				{
+					g_auto_esc = 0;
+					WXS2w_DataCharProcess(ch);
+				}
+
+				break;
 
+			}
+			prev = ch;
 		}
-		prev = ch;
 	}
 }
 
@@ -673,11 +706,11 @@ VOID WXS2w_LoadConfiguration(VOID)
 	if( strcmp((char*)g_wxProfile.fw_version,WIZFI250_FW_VERSION) != 0 )
 	{
 		Default_Profile();
-		Save_Profile();
 	}
 #endif
 
-	Apply_To_Wifi_Dct();
+	// Only touches the flash when the profile was reset or the Wi-Fi config is out of date
+	Save_Profile_And_Wifi_Dct();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -700,6 +733,8 @@ static wiced_result_t f_bckup_recovery_timer(void *arg)
 
 VOID WXS2w_Initialize(VOID)
 {
+	WXS2w_BuildCommandIndex();
+
 	Create_Queue_Timer();
 
 	// kaizen
@@ -854,11 +889,20 @@ VOID WXS2w_CommandCharProcess(UINT8 ch)
 	}
 }
 
+// Sends the data mode bytes staged in a TX packet, then whatever a command left in g_scTxBuffer.
 UINT8 WXS2w_DataBufferTransmit(VOID)
 {
-	UINT8 status;
+	UINT8 status = WXCODE_SUCCESS;
+	UINT8 *txData;
+	UINT32 stagedLen;
 
-	if ( !g_scTxIndex )
+	txData = WXNetwork_NetTxStaged(&stagedLen);
+	if ( !stagedLen )
+	{
+		txData = g_scTxBuffer;
+	}
+
+	if ( !stagedLen && !g_scTxIndex )
 	{
 		return WXCODE_SUCCESS;
 	}
@@ -872,7 +916,7 @@ UINT8 WXS2w_DataBufferTransmit(VOID)
 	// sekim 20150508 Coway ReSend <Connect Event Message>
 	if ( g_wxProfile.cowaya_check_time>0 )
 	{
-		if ( memcmp(g_scTxBuffer, g_wxProfile.cowaya_check_data, strlen(g_wxProfile.cowaya_check_data))==0 )
+		if ( memcmp(txData, g_wxProfile.cowaya_check_data, strlen(g_wxProfile.cowaya_check_data))==0 )
 		{
 			extern UINT8 g_cowaya_recv_checkdata;
 			g_cowaya_recv_checkdata = 1;
@@ -881,7 +925,14 @@ UINT8 WXS2w_DataBufferTransmit(VOID)
 	////////////////////////////////////////////////////////////////////////
 
 
-	status = WXNetwork_NetTx(g_currentScid, g_scTxBuffer, g_scTxIndex);
+	if ( stagedLen )
+	{
+		status = WXNetwork_NetTxFlush();
+	}
+	if ( g_scTxIndex && status == WXCODE_SUCCESS )
+	{
+		status = WXNetwork_NetTx(g_currentScid, g_scTxBuffer, g_scTxIndex);
+	}
 	if ( status != WXCODE_SUCCESS )
 	{
 		//W_DBG("WXS2w_DataBufferTransmit : WXNetwork_NetTx error");
@@ -916,34 +967,22 @@ void ProcessWizFiQueue(uint32_t arguments)
 
 			wiced_rtos_unlock_mutex(&g_s2w_wizmutex);
 		}
-		else if ( buffWizFiQueue.queue_id == 111 )
-		{
-			wiced_result_t result;
-			UINT8 scid = buffWizFiQueue.queue_opt;
-    		int kill_count;
-    		for (kill_count=0; kill_count<10; kill_count++)
-    		{
-    			wiced_rtos_delay_milliseconds(10);
-    		    if ( (result=wiced_rtos_is_current_thread(&g_socketopen_thread[scid]))!=WICED_SUCCESS )
-    		    {
-    		    	if ( (result=wiced_rtos_delete_thread(&g_socketopen_thread[scid]))!=WICED_SUCCESS )
-    		    		W_DBG("ProcessWizFiQueue : wiced_rtos_delete_thread error (%d) %d", kill_count, result);
-    		    	else
-    		    		break;
-    		    }
-    		    else
-    		    {
-    		    	W_DBG("ProcessWizFiQueue : wiced_rtos_is_current_thread error %d", result);
-    		    }
-    		}
-		}
 	}
 }
 
 
 VOID WXS2w_DataCharProcess(UINT8 ch)
+{
+	WXS2w_DataSpanProcess(&ch, 1);
+}
+
+// Same packetizing rules as the former per-byte path: transmit once the staged data passes
+// WX_MAX_PACKET_SIZE (or fills the TX packet), and (re)start the Nagle timer on the first byte
+// and every 100th byte. Bytes go straight into the TX packet, not through g_scTxBuffer.
+VOID WXS2w_DataSpanProcess(UINT8 *data, UINT32 len)
 {
 	UINT8 status;
+	UINT32 prevIndex, txIndex, copyLen;
 
 	if ( g_wxModeState == WX_MODE_DATA )
 	{
@@ -958,34 +997,36 @@ VOID WXS2w_DataCharProcess(UINT8 ch)
 		// Locking to avoid race with expiry timer and send task
 		wiced_rtos_lock_mutex(&g_s2w_wizmutex);
 
-		g_scTxBuffer[g_scTxIndex] = ch;
-		g_scTxIndex++;
-
-		////////////////////////////////////////////////////////////////////////////////////
-		// sekim Nagle Timer   Transmit
-#if 1	// kaizen	20130514 ID 1062 - Fixed Bug that WizFi250 was hang up when set <UDP data mode> and send file more than 2Kbyte
-		if ( g_scTxIndex > WX_MAX_PACKET_SIZE )
-#else
-		if ( g_scTxIndex > sizeof(g_scTxBuffer))
-#endif
+		while ( len > 0 )
 		{
-			status = WXS2w_DataBufferTransmit();
-			if ( status != WXCODE_SUCCESS )
+			WXNetwork_NetTxStaged(&prevIndex);
+			copyLen = WXNetwork_NetTxAppend(g_currentScid, data, MIN(len, (WX_MAX_PACKET_SIZE + 1) - prevIndex));
+			if ( copyLen == 0 )
 			{
-				W_DBG("WXS2w_DataCharProcess : error 211");
-				WXS2w_StatusNotify(status, 0);
+				W_DBG("WXS2w_DataCharProcess : error 212");
+				WXS2w_StatusNotify(WXCODE_FAILURE, 0);
+				break;
 			}
-		}
-		else
-		{
-			if ( (g_scTxIndex == 1) || ((g_scTxIndex % 100) == 0) )
+			txIndex = prevIndex + copyLen;
+			data += copyLen;
+			len -= copyLen;
+
+			if ( txIndex > WX_MAX_PACKET_SIZE || WXNetwork_NetTxSpace() == 0 )
+			{
+				status = WXS2w_DataBufferTransmit();
+				if ( status != WXCODE_SUCCESS )
+				{
+					W_DBG("WXS2w_DataCharProcess : error 211");
+					WXS2w_StatusNotify(status, 0);
+				}
+			}
+			else if ( (prevIndex == 0) || ((txIndex / 100) != (prevIndex / 100)) )
 			{
-		    	wiced_rtos_stop_timer(&g_nagle_timer.timer);
-		    	wiced_rtos_reload_timer(&g_nagle_timer.timer);
-		    	wiced_rtos_start_timer(&g_nagle_timer.timer);
+				wiced_rtos_stop_timer(&g_nagle_timer.timer);
+				wiced_rtos_reload_timer(&g_nagle_timer.timer);
+				wiced_rtos_start_timer(&g_nagle_timer.timer);
 			}
 		}
-		////////////////////////////////////////////////////////////////////////////////////
 
 		wiced_rtos_unlock_mutex(&g_s2w_wizmutex);
 	}
@@ -995,6 +1036,108 @@ VOID WXS2w_DataCharProcess(UINT8 ch)
 	}
 }
 
+////////////////////////////////////////////////////////////////////////////////////
+// AT command lookup
+// g_WXCmdTable entries are matched as a case-insensitive prefix of the input, first entry wins.
+// The hash index is keyed by the command name (the part before '=' or '?'), so a normal command
+// is found in a few probes. Input that is only matched through prefix rules (e.g. "+WJOINX")
+// misses the index and falls back to the original linear scan.
+#define WX_CMD_HASH_SIZE	128		// power of 2, at least twice the number of commands
+#define WX_CMD_NOT_FOUND	0xFFFFFFFF
+
+static UINT8 g_wxCmdHash[WX_CMD_HASH_SIZE];		// g_WXCmdTable index + 1, 0 is an empty slot
+static UINT8 g_wxCmdHashReady = 0;
+
+static UINT32 WXS2w_CommandNameLen(const char *str)
+{
+	UINT32 len = 0;
+
+	while ( str[len] != '\0' && str[len] != '=' && str[len] != '?' )	len++;
+
+	return len;
+}
+
+static UINT32 WXS2w_CommandHash(const char *str, UINT32 len)
+{
+	UINT32 hash = 5381;
+
+	while ( len-- )
+	{
+		hash = (hash * 33) ^ (UINT8)toupper((UINT8)*str++);
+	}
+
+	return hash & (WX_CMD_HASH_SIZE - 1);
+}
+
+VOID WXS2w_BuildCommandIndex(VOID)
+{
+	UINT32 i, j, slot;
+
+	memset(g_wxCmdHash, 0, sizeof(g_wxCmdHash));
+
+	for (i = 0; g_WXCmdTable[i].cmd != NULL; i++)
+	{
+		if ( i >= 0xFF )
+		{
+			W_DBG("WXS2w_BuildCommandIndex : too many commands");
+			return;
+		}
+
+		// An entry shadowed by an earlier, shorter entry is never reached by the linear scan either
+		for (j = 0; j < i; j++)
+		{
+			if ( !WXParse_StrnCaseCmp(g_WXCmdTable[i].cmd, g_WXCmdTable[j].cmd, strlen(g_WXCmdTable[j].cmd)) )	break;
+		}
+		if ( j < i )	continue;
+
+		slot = WXS2w_CommandHash(g_WXCmdTable[i].cmd, WXS2w_CommandNameLen(g_WXCmdTable[i].cmd));
+		while ( g_wxCmdHash[slot] )
+		{
+			slot = (slot + 1) & (WX_CMD_HASH_SIZE - 1);
+		}
+		g_wxCmdHash[slot] = (UINT8)(i + 1);
+	}
+
+	g_wxCmdHashReady = 1;
+}
+
+UINT32 WXS2w_FindCommand(UINT8 *ptr)
+{
+	UINT32 i, slot, nameLen;
+	UINT32 found = WX_CMD_NOT_FOUND;
+
+	if ( g_wxCmdHashReady )
+	{
+		nameLen = WXS2w_CommandNameLen((char *) ptr);
+		slot = WXS2w_CommandHash((char *) ptr, nameLen);
+
+		// Entries sharing a name (e.g. "+XXX" and "+XXX=") sit in the same cluster; keep the first one in table order
+		while ( g_wxCmdHash[slot] )
+		{
+			i = g_wxCmdHash[slot] - 1;
+			if ( i < found && WXS2w_CommandNameLen(g_WXCmdTable[i].cmd) == nameLen
+				&& !WXParse_StrnCaseCmp((char *) ptr, g_WXCmdTable[i].cmd, strlen(g_WXCmdTable[i].cmd)) )
+			{
+				found = i;
+			}
+			slot = (slot + 1) & (WX_CMD_HASH_SIZE - 1);
+		}
+
+		if ( found != WX_CMD_NOT_FOUND )	return found;
+	}
+
+	for (i = 0; g_WXCmdTable[i].cmd != NULL; i++)
+	{
+		if ( !WXParse_StrnCaseCmp((char *) ptr, g_WXCmdTable[i].cmd, strlen(g_WXCmdTable[i].cmd)) )
+		{
+			return i;
+		}
+	}
+
+	return WX_CMD_NOT_FOUND;
+}
+////////////////////////////////////////////////////////////////////////////////////
+
 VOID WXS2w_Process(UINT8 *cmd)
 {
 	UINT8 status = WXCODE_EINVAL;
@@ -1018,15 +1161,10 @@ VOID WXS2w_Process(UINT8 *cmd)
 	}
 	ptr = (cmd + 2);
 
-	for(i = 0; i < sizeof(g_WXCmdTable) / sizeof(g_WXCmdTable[0]); i++)
+	i = WXS2w_FindCommand(ptr);
+	if ( i != WX_CMD_NOT_FOUND )
 	{
-		UINT32 len = strlen(g_WXCmdTable[i].cmd);
-
-		if ( !WXParse_StrnCaseCmp((char *) ptr, g_WXCmdTable[i].cmd, len) )
-		{
-			status = g_WXCmdTable[i].process(ptr + len);
-			break;
-		}
+		status = g_WXCmdTable[i].process(ptr + strlen(g_WXCmdTable[i].cmd));
 	}
 
 	WXS2w_StatusNotify(status, 0);
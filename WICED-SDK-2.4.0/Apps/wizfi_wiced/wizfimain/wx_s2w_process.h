@@ -32,8 +32,11 @@ UINT8 WXS2w_DataBufferTransmit(VOID);
 VOID WXS2w_LoadConfiguration(VOID);
 VOID WXS2w_Initialize(VOID);
 VOID WXS2w_Process(UINT8 *cmd);
+VOID WXS2w_BuildCommandIndex(VOID);
+UINT32 WXS2w_FindCommand(UINT8 *ptr);
 VOID WXS2w_CommandCharProcess(UINT8 ch);
 VOID WXS2w_DataCharProcess(UINT8 ch);
+VOID WXS2w_DataSpanProcess(UINT8 *data, UINT32 len);
 VOID WXS2w_SerialInput(VOID);
 VOID WXS2w_LEDIndication(UINT8 ledType, UINT8 init, UINT8 repeat, UINT8 delay1, UINT8 delay2, UINT8 on);
 
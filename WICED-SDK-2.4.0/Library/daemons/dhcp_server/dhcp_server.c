@@ -24,7 +24,26 @@
  *                    Constants
  ******************************************************/
 
-#define DHCP_IP_ADDRESS_CACHE_MAX       (5)
+/* Number of clients which can hold an address at once. Each lease owns one address of the pool */
+#ifndef DHCP_SERVER_MAXIMUM_LEASES
+#define DHCP_SERVER_MAXIMUM_LEASES      (32)
+#endif
+
+#if DHCP_SERVER_MAXIMUM_LEASES > 254
+#error "DHCP_SERVER_MAXIMUM_LEASES must fit the 8-bit lease hash chains"
+#endif
+
+/* Number of MAC address hash chains */
+#ifndef DHCP_LEASE_HASH_SIZE
+#define DHCP_LEASE_HASH_SIZE            (DHCP_SERVER_MAXIMUM_LEASES)
+#endif
+
+#define DHCP_NO_LEASE                   (0xFF)
+
+/* Lease times in seconds. DHCP_LEASE_TIME must match lease_time_option_buff */
+#define DHCP_LEASE_TIME                 (24 * 60 * 60)
+#define DHCP_OFFER_HOLD_TIME            (60)      /* Address kept for a client which has been offered it */
+#define DHCP_DECLINE_HOLD_TIME          (10 * 60) /* Address kept out of use after a client found it taken */
 
 #define DHCP_THREAD_PRIORITY (WICED_DEFAULT_LIBRARY_PRIORITY)
 #define DHCP_SERVER_RECEIVE_TIMEOUT (500)
@@ -55,14 +74,19 @@ static const uint8_t dhcp_magic_cookie[]           = { 0x63, 0x82, 0x53, 0x63 };
 
 #define WPAD_SAMPLE_URL "http://xxx.xxx.xxx.xxx/wpad.dat"
 
-static const wiced_mac_t const empty_cache = { .octet = {0} };
-static wiced_mac_t             cached_mac_addresses[DHCP_IP_ADDRESS_CACHE_MAX];
-static wiced_ip_address_t      cached_ip_addresses [DHCP_IP_ADDRESS_CACHE_MAX];
-
 /******************************************************
  *                   Enumerations
  ******************************************************/
 
+typedef enum
+{
+    DHCP_LEASE_FREE,     /* Address has never been given out, or has been reclaimed */
+    DHCP_LEASE_OFFERED,  /* Address offered to the client, waiting for its REQUEST */
+    DHCP_LEASE_BOUND,    /* Address acknowledged to the client */
+    DHCP_LEASE_EXPIRED,  /* Lease ran out or was released. Client gets the address back unless it has been reclaimed */
+    DHCP_LEASE_DECLINED, /* Client reported the address already in use. Not tied to any client */
+} dhcp_lease_state_t;
+
 /******************************************************
  *                 Type Definitions
  ******************************************************/
@@ -71,6 +95,25 @@ static wiced_ip_address_t      cached_ip_addresses [DHCP_IP_ADDRESS_CACHE_MAX];
  *                    Structures
  ******************************************************/
 
+/* A lease is stored at the same index as its address in the pool */
+typedef struct
+{
+    wiced_mac_t  client_mac_address;
+    uint8_t      state;          /* dhcp_lease_state_t */
+    uint8_t      next;           /* Next lease in the same hash chain, or DHCP_NO_LEASE */
+    wiced_time_t expiry_time;
+} dhcp_lease_t;
+
+/* Addresses handed out, counting up from the one after the server's own and wrapping round the subnet */
+typedef struct
+{
+    uint32_t subnet;
+    uint32_t host_mask;
+    uint32_t server_host;        /* Host part of the server's address */
+    uint32_t host_count;         /* Usable host addresses in the subnet */
+    uint32_t size;               /* Addresses in the pool, at most DHCP_SERVER_MAXIMUM_LEASES */
+} dhcp_address_pool_t;
+
 /* DHCP data structure */
 typedef struct
 {
@@ -98,14 +141,24 @@ typedef struct
 
 static void           dhcp_thread                      ( uint32_t thread_input );
 static uint8_t*       find_option                      ( dhcp_header_t* request, uint8_t option_num );
-static wiced_result_t get_client_ip_address_from_cache ( const wiced_mac_t* client_mac_address, wiced_ip_address_t* client_ip_address );
-static wiced_result_t add_client_to_cache              ( const wiced_mac_t* client_mac_address, const wiced_ip_address_t* client_ip_address );
 static void           ipv4_to_string                   ( char* buffer, uint32_t ipv4_address );
+static dhcp_lease_t*  find_lease                       ( const wiced_mac_t* client_mac_address );
+static dhcp_lease_t*  allocate_lease                   ( const wiced_mac_t* client_mac_address, uint32_t requested_address );
+static void           unlink_lease                     ( dhcp_lease_t* lease );
+static void           free_lease                       ( dhcp_lease_t* lease );
+static void           expire_leases                    ( wiced_time_t current_time );
+static uint32_t       lease_address                    ( const dhcp_lease_t* lease );
+static uint8_t        mac_address_hash                 ( const wiced_mac_t* mac_address );
 
 /******************************************************
  *               Variables Definitions
  ******************************************************/
 
+static dhcp_lease_t        leases[DHCP_SERVER_MAXIMUM_LEASES];
+static uint8_t             lease_hash[DHCP_LEASE_HASH_SIZE];
+static uint32_t            leases_in_use[( DHCP_SERVER_MAXIMUM_LEASES + 31 ) / 32]; /* Bitmap of pool addresses with a lease which is not free */
+static dhcp_address_pool_t address_pool;
+
 /******************************************************
  *               Function Definitions
  ******************************************************/
@@ -114,9 +167,10 @@ wiced_result_t wiced_start_dhcp_server(wiced_dhcp_server_t* server, wiced_interf
 {
     server->interface = interface;
 
-    /* Clear cache */
-    memset( cached_mac_addresses, 0, sizeof( cached_mac_addresses ) );
-    memset( cached_ip_addresses,  0, sizeof( cached_ip_addresses  ) );
+    /* Clear lease table */
+    memset( leases,        0,             sizeof( leases ) );
+    memset( lease_hash,    DHCP_NO_LEASE, sizeof( lease_hash ) );
+    memset( leases_in_use, 0,             sizeof( leases_in_use ) );
 
     /* Create DHCP socket */
     WICED_VERIFY(wiced_udp_create_socket(&server->socket, IPPORT_DHCPS, interface));
@@ -139,11 +193,12 @@ wiced_result_t wiced_stop_dhcp_server(wiced_dhcp_server_t* server)
 }
 
 /**
- *  Implements a very simple DHCP server.
+ *  Implements a simple DHCP server.
  *
- *  Server will always offer next available address to a DISCOVER command
- *  Server will NAK any REQUEST command which is not requesting the next available address
- *  Server will ACK any REQUEST command which is for the next available address, and then increment the next available address
+ *  Server will offer a client the address it already holds, or else reserve the next free address, to a DISCOVER command
+ *  Server will ACK any REQUEST command which is for the client's reserved address, or for a free address in the pool
+ *  Server will NAK any other REQUEST command
+ *  DECLINE takes the address out of use for a while, RELEASE lets the address be reclaimed
  *
  * @param my_addr : local IP address for binding of server port.
  */
@@ -153,12 +208,10 @@ static void dhcp_thread( uint32_t thread_input )
     wiced_packet_t*      transmit_packet;
     wiced_ip_address_t   local_ip_address;
     wiced_ip_address_t   netmask;
-    uint32_t             next_available_ip_addr;
     uint32_t             ip_mask;
-    uint32_t             subnet;
     uint32_t             netmask_htobe;
     char*                option_ptr;
-    wiced_dhcp_server_t* server                       = (wiced_dhcp_server_t*)thread_input;
+    wiced_dhcp_server_t* server                       = (wiced_dhcp_server_t*) (uintptr_t) thread_input;
     uint8_t              subnet_option_buff[]         = { 1, 4, 0, 0, 0, 0 };
     uint8_t              server_ip_addr_option_buff[] = { 54, 4, 0, 0, 0, 0 };
     uint32_t*            server_ip_addr_ptr           = (uint32_t*)&server_ip_addr_option_buff[2];
@@ -174,8 +227,12 @@ static void dhcp_thread( uint32_t thread_input )
     netmask_htobe = htobe32( GET_IPV4_ADDRESS(netmask) );
     memcpy(&subnet_option_buff[2], &netmask_htobe, 4);
 
-    subnet = GET_IPV4_ADDRESS(local_ip_address) & GET_IPV4_ADDRESS(netmask);
-    next_available_ip_addr = subnet | ((GET_IPV4_ADDRESS(local_ip_address) + 1) & ip_mask);
+    /* The pool is the subnet less its network and broadcast addresses and the server's own address */
+    address_pool.subnet      = GET_IPV4_ADDRESS(local_ip_address) & GET_IPV4_ADDRESS(netmask);
+    address_pool.host_mask   = ip_mask;
+    address_pool.server_host = GET_IPV4_ADDRESS(local_ip_address) & ip_mask;
+    address_pool.host_count  = ( ip_mask > 1 ) ? ip_mask - 1 : 0;
+    address_pool.size        = ( address_pool.host_count > 1 ) ? MIN( address_pool.host_count - 1, DHCP_SERVER_MAXIMUM_LEASES ) : 0;
 
     /* Prepare wpad_option_buff */
     memcpy(&wpad_option_buff[2], WPAD_SAMPLE_URL, sizeof(WPAD_SAMPLE_URL)-1);
@@ -189,9 +246,16 @@ static void dhcp_thread( uint32_t thread_input )
         uint16_t       data_length;
         uint16_t       available_data_length;
         dhcp_header_t* request_header;
+        wiced_time_t   current_time;
+        wiced_result_t result;
+
+        /* Sleep until data is received from socket. Wake up regularly so leases which have run out are noticed */
+        result = wiced_udp_receive( &server->socket, &received_packet, DHCP_SERVER_RECEIVE_TIMEOUT );
+
+        wiced_time_get_time( &current_time );
+        expire_leases( current_time );
 
-        /* Sleep until data is received from socket. */
-        if ( wiced_udp_receive( &server->socket, &received_packet, WICED_WAIT_FOREVER ) != WICED_SUCCESS )
+        if ( result != WICED_SUCCESS )
         {
             continue;
         }
@@ -206,9 +270,35 @@ static void dhcp_thread( uint32_t thread_input )
                 dhcp_header_t*     reply_header;
                 uint16_t           available_space;
                 wiced_mac_t        client_mac_address;
-                wiced_ip_address_t client_ip_address;
+                dhcp_lease_t*      lease;
                 uint32_t           temp;
 
+                /* Record client MAC address */
+                memcpy( &client_mac_address, request_header->client_hardware_addr, sizeof( client_mac_address ) );
+
+                /* Offer the address the client already has, otherwise reserve a free one */
+                lease = find_lease( &client_mac_address );
+                if ( lease == NULL )
+                {
+                    lease = allocate_lease( &client_mac_address, 0 );
+                }
+                if ( lease == NULL )
+                {
+                    /* Every address is in use. Stay silent */
+                    wiced_packet_delete( received_packet );
+                    break;
+                }
+                if ( lease->state != DHCP_LEASE_BOUND )
+                {
+                    lease->state       = DHCP_LEASE_OFFERED;
+                    lease->expiry_time = current_time + DHCP_OFFER_HOLD_TIME * 1000;
+                }
+                else if ( (int32_t) ( lease->expiry_time - current_time ) < DHCP_OFFER_HOLD_TIME * 1000 )
+                {
+                    /* A lease about to run out must still be there when the client asks for it */
+                    lease->expiry_time = current_time + DHCP_OFFER_HOLD_TIME * 1000;
+                }
+
                 /* Create reply and free received packet */
                 if ( wiced_packet_create_udp( &server->socket, sizeof(dhcp_header_t), &transmit_packet, (uint8_t**) &reply_header, &available_space ) != WICED_SUCCESS )
                 {
@@ -225,19 +315,8 @@ static void dhcp_thread( uint32_t thread_input )
                 /* Clear the DHCP options list */
                 memset( &reply_header->options, 0, sizeof( reply_header->options ) );
 
-                /* Record client MAC address */
-                memcpy( &client_mac_address, request_header->client_hardware_addr, sizeof( client_mac_address ) );
-
-                /* Check whether device is already cached */
-                if ( get_client_ip_address_from_cache( &client_mac_address, &client_ip_address ) != WICED_SUCCESS )
-                {
-                    /* Address not found in cache. Use next available IP address */
-                    client_ip_address.version = WICED_IPV4;
-                    client_ip_address.ip.v4   = next_available_ip_addr;
-                }
-
                 /* Create the IP address for the Offer */
-                temp = htonl(client_ip_address.ip.v4);
+                temp = htonl( lease_address( lease ) );
                 memcpy( reply_header->your_ip_addr, &temp, sizeof( temp ) );
 
                 /* Copy the magic DHCP number */
@@ -274,18 +353,40 @@ static void dhcp_thread( uint32_t thread_input )
                 /* REQUEST command - send back ACK or NAK */
                 uint32_t           temp;
                 uint32_t*          server_id_req;
+                uint32_t*          requested_ip_addr_option;
                 dhcp_header_t*     reply_header;
                 uint16_t           available_space;
                 wiced_mac_t        client_mac_address;
-                wiced_ip_address_t given_ip_address;
-                wiced_ip_address_t requested_ip_address;
-                wiced_bool_t       next_avail_ip_address_used = WICED_FALSE;
+                uint32_t           requested_ip_address;
+                dhcp_lease_t*      lease;
+
+                /* Record client MAC address */
+                memcpy( &client_mac_address, request_header->client_hardware_addr, sizeof( client_mac_address ) );
 
                 /* Check that the REQUEST is for this server */
                 server_id_req = (uint32_t*) find_option( request_header, 54 );
                 if ( ( server_id_req != NULL ) && ( GET_IPV4_ADDRESS( local_ip_address ) != htobe32(*server_id_req) ) )
                 {
-                    break; /* Server ID does not match local IP address */
+                    /* Server ID does not match local IP address. The client took another server's offer */
+                    lease = find_lease( &client_mac_address );
+                    if ( lease != NULL && lease->state == DHCP_LEASE_OFFERED )
+                    {
+                        free_lease( lease );
+                    }
+                    wiced_packet_delete( received_packet );
+                    break;
+                }
+
+                /* Locate the requested address in the options. A renewing client puts it in the header instead */
+                requested_ip_addr_option = (uint32_t*) find_option( request_header, 50 );
+                if ( requested_ip_addr_option != NULL )
+                {
+                    requested_ip_address = ntohl( *requested_ip_addr_option );
+                }
+                else
+                {
+                    memcpy( &temp, request_header->client_ip_addr, sizeof( temp ) );
+                    requested_ip_address = ntohl( temp );
                 }
 
                 /* Create reply and free received packet */
@@ -297,13 +398,6 @@ static void dhcp_thread( uint32_t thread_input )
 
                 memcpy(reply_header, request_header, sizeof(dhcp_header_t) - sizeof(reply_header->options));
 
-                /* Record client MAC address */
-                memcpy( &client_mac_address, request_header->client_hardware_addr, sizeof( client_mac_address ) );
-
-                /* Locate the requested address in the options and keep requested address */
-                requested_ip_address.version = WICED_IPV4;
-                requested_ip_address.ip.v4   = ntohl(*(uint32_t*)find_option( request_header, 50 ));
-
                 /* Delete received packet. We don't need it anymore */
                 wiced_packet_delete( received_packet );
 
@@ -317,18 +411,16 @@ static void dhcp_thread( uint32_t thread_input )
 
                 option_ptr = (char *) &reply_header->options;
 
-                /* Check if device is cache. If it is, give the previous IP address. Otherwise give the next available IP address */
-                if ( get_client_ip_address_from_cache( &client_mac_address, &given_ip_address ) != WICED_SUCCESS )
+                /* Check if the client holds an address. If not, it may have one from before the server restarted which is still free */
+                lease = find_lease( &client_mac_address );
+                if ( lease == NULL && requested_ip_address != 0 )
                 {
-                    /* Address not found in cache. Use next available IP address */
-                    next_avail_ip_address_used = WICED_TRUE;
-                    given_ip_address.version   = WICED_IPV4;
-                    given_ip_address.ip.v4     = next_available_ip_addr;
+                    lease = allocate_lease( &client_mac_address, requested_ip_address );
                 }
 
-                if ( memcmp( &requested_ip_address, &given_ip_address, sizeof( requested_ip_address ) ) != 0 )
+                if ( lease == NULL || lease_address( lease ) != requested_ip_address )
                 {
-                    /* Request is not for next available IP - force client to take next available IP by sending NAK */
+                    /* Request is not for the client's address - force client to start again by sending NAK */
                     /* Add appropriate options */
                     option_ptr = (char*)MEMCAT( option_ptr, dhcp_nak_option_buff, 3 );             /* DHCP message type */
                     option_ptr = (char*)MEMCAT( option_ptr, server_ip_addr_option_buff, 6 );       /* Server identifier */
@@ -336,7 +428,7 @@ static void dhcp_thread( uint32_t thread_input )
                 }
                 else
                 {
-                    /* Request is for next available IP */
+                    /* Request is for the client's address */
                     /* Add appropriate options */
                     option_ptr     = (char*)MEMCAT( option_ptr, dhcp_ack_option_buff, 3 );                              /* DHCP message type            */
                     option_ptr     = (char*)MEMCAT( option_ptr, server_ip_addr_option_buff, 6 );                        /* Server identifier            */
@@ -352,21 +444,12 @@ static void dhcp_thread( uint32_t thread_input )
                     option_ptr     = (char*)MEMCAT( option_ptr, mtu_option_buff, 4 );                                   /* Interface MTU                */
 
                     /* Create the IP address for the Offer */
-                    temp = htonl(given_ip_address.ip.v4);
+                    temp = htonl( requested_ip_address );
                     memcpy( reply_header->your_ip_addr, &temp, sizeof( temp ) );
 
-                    /* Increment next available IP address only if not found in cache */
-                    if ( next_avail_ip_address_used == WICED_TRUE )
-                    {
-                        do
-                        {
-                            next_available_ip_addr = subnet | ( ( next_available_ip_addr + 1 ) & ip_mask );
-                        } while ( next_available_ip_addr == GET_IPV4_ADDRESS(local_ip_address) );
-                    }
-
-                    /* Cache client */
-                    add_client_to_cache( &client_mac_address, &given_ip_address );
-
+                    /* Bind the lease */
+                    lease->state       = DHCP_LEASE_BOUND;
+                    lease->expiry_time = current_time + DHCP_LEASE_TIME * 1000;
                 }
 
                 option_ptr[0] = (char) 0xff; /* end options */
@@ -382,6 +465,60 @@ static void dhcp_thread( uint32_t thread_input )
             }
                 break;
 
+            case DHCPDECLINE:
+            case DHCPRELEASE:
+            {
+                uint32_t*     server_id_req;
+                uint32_t*     requested_ip_addr_option;
+                uint32_t      client_ip_address;
+                wiced_mac_t   client_mac_address;
+                dhcp_lease_t* lease;
+
+                server_id_req = (uint32_t*) find_option( request_header, 54 );
+                if ( ( server_id_req != NULL ) && ( GET_IPV4_ADDRESS( local_ip_address ) != htobe32(*server_id_req) ) )
+                {
+                    wiced_packet_delete( received_packet );
+                    break; /* Server ID does not match local IP address */
+                }
+
+                memcpy( &client_mac_address, request_header->client_hardware_addr, sizeof( client_mac_address ) );
+
+                /* DECLINE names the address in an option, RELEASE in the header */
+                requested_ip_addr_option = (uint32_t*) find_option( request_header, 50 );
+                if ( request_header->options[2] == DHCPDECLINE && requested_ip_addr_option != NULL )
+                {
+                    client_ip_address = ntohl( *requested_ip_addr_option );
+                }
+                else
+                {
+                    memcpy( &client_ip_address, request_header->client_ip_addr, sizeof( client_ip_address ) );
+                    client_ip_address = ntohl( client_ip_address );
+                }
+
+                lease = find_lease( &client_mac_address );
+                if ( lease != NULL && lease_address( lease ) == client_ip_address )
+                {
+                    if ( request_header->options[2] == DHCPDECLINE )
+                    {
+                        /* Another device is using the address. Keep it out of the pool for a while and let the client start again */
+                        unlink_lease( lease );
+                        memset( &lease->client_mac_address, 0, sizeof( lease->client_mac_address ) );
+                        lease->state       = DHCP_LEASE_DECLINED;
+                        lease->expiry_time = current_time + DHCP_DECLINE_HOLD_TIME * 1000;
+                    }
+                    else
+                    {
+                        /* Keep the client's address for it until the address is needed by someone else */
+                        lease->state       = DHCP_LEASE_EXPIRED;
+                        lease->expiry_time = current_time;
+                    }
+                }
+
+                /* No reply is sent to DECLINE or RELEASE */
+                wiced_packet_delete( received_packet );
+            }
+                break;
+
             default:
                 wiced_packet_delete(received_packet);
                 break;
@@ -422,65 +559,201 @@ static uint8_t* find_option( dhcp_header_t* request, uint8_t option_num )
 
 }
 
-static wiced_result_t get_client_ip_address_from_cache( const wiced_mac_t* client_mac_address, wiced_ip_address_t* client_ip_address )
+/**
+ *  Finds the lease held by a client
+ *
+ * @param client_mac_address : The client's MAC address
+ *
+ * @return The client's lease, or NULL if it has none
+ */
+static dhcp_lease_t* find_lease( const wiced_mac_t* client_mac_address )
 {
-    uint32_t a;
+    uint8_t index;
 
-    /* Check whether device is already cached */
-    for ( a = 0; a < DHCP_IP_ADDRESS_CACHE_MAX; a++ )
+    for ( index = lease_hash[mac_address_hash( client_mac_address )]; index != DHCP_NO_LEASE; index = leases[index].next )
     {
-        if ( memcmp( &cached_mac_addresses[ a ], client_mac_address, sizeof( *client_mac_address ) ) == 0 )
+        if ( memcmp( &leases[index].client_mac_address, client_mac_address, sizeof( *client_mac_address ) ) == 0 )
         {
-            *client_ip_address = cached_ip_addresses[ a ];
-            return WICED_SUCCESS;
+            return &leases[index];
         }
     }
 
-    return WICED_NOTFOUND;
+    return NULL;
 }
 
-static wiced_result_t add_client_to_cache( const wiced_mac_t* client_mac_address, const wiced_ip_address_t* client_ip_address )
+/**
+ *  Gives a client a lease on an address of the pool
+ *
+ *  Free addresses are used before the addresses of expired leases, so that returning
+ *  clients get their old address back for as long as possible.
+ *
+ * @param client_mac_address : The client's MAC address. The client must not already hold a lease
+ * @param requested_address  : Address the client must have, or 0 for any address
+ *
+ * @return The new lease in the DHCP_LEASE_FREE state, or NULL if the address is not available
+ */
+static dhcp_lease_t* allocate_lease( const wiced_mac_t* client_mac_address, uint32_t requested_address )
 {
-    uint32_t a;
-    uint32_t first_empty_slot;
-    uint32_t cached_slot;
+    dhcp_lease_t* lease = NULL;
+    uint32_t      index;
+
+    if ( requested_address != 0 )
+    {
+        /* Find the pool index of the address. The pool starts just after the server's own address */
+        uint32_t host = requested_address & address_pool.host_mask;
+
+        if ( address_pool.size == 0 || ( requested_address & ~address_pool.host_mask ) != address_pool.subnet ||
+             host == 0 || host > address_pool.host_count || host == address_pool.server_host )
+        {
+            return NULL;
+        }
+        index = ( host + address_pool.host_count - 1 - address_pool.server_host ) % address_pool.host_count;
+        if ( index >= address_pool.size )
+        {
+            return NULL;
+        }
 
-    /* Search for empty slot in cache */
-    for ( a = 0, first_empty_slot = DHCP_IP_ADDRESS_CACHE_MAX, cached_slot = DHCP_IP_ADDRESS_CACHE_MAX; a < DHCP_IP_ADDRESS_CACHE_MAX; a++ )
+        if ( ( leases_in_use[index / 32] & ( 1u << ( index % 32 ) ) ) == 0 )
+        {
+            lease = &leases[index];
+        }
+        else if ( leases[index].state == DHCP_LEASE_EXPIRED )
+        {
+            lease = &leases[index];
+            unlink_lease( lease );
+        }
+    }
+    else
     {
-        /* Check for matching MAC address */
-        if ( memcmp( &cached_mac_addresses[ a ], client_mac_address, sizeof( *client_mac_address ) ) == 0 )
+        /* Take the first free address */
+        for ( index = 0; index < address_pool.size && lease == NULL; index += 32 )
         {
-            /* Cached device found */
-            cached_slot = a;
-            break;
+            uint32_t free_addresses = ~leases_in_use[index / 32];
+            uint32_t bit;
+
+            for ( bit = 0; free_addresses != 0 && index + bit < address_pool.size; bit++ )
+            {
+                if ( free_addresses & ( 1u << bit ) )
+                {
+                    lease = &leases[index + bit];
+                    break;
+                }
+            }
         }
-        else if ( first_empty_slot == DHCP_IP_ADDRESS_CACHE_MAX && memcmp( &cached_mac_addresses[ a ], &empty_cache, sizeof(wiced_mac_t) ) == 0 )
+
+        /* Otherwise reclaim the lease which expired longest ago */
+        if ( lease == NULL )
         {
-            /* Device not found in cache. Return the first empty slot */
-            first_empty_slot = a;
+            for ( index = 0; index < address_pool.size; index++ )
+            {
+                dhcp_lease_t* candidate = &leases[index];
+
+                if ( candidate->state == DHCP_LEASE_EXPIRED && ( lease == NULL || (int32_t) ( candidate->expiry_time - lease->expiry_time ) < 0 ) )
+                {
+                    lease = candidate;
+                }
+            }
+            if ( lease != NULL )
+            {
+                unlink_lease( lease );
+            }
         }
     }
 
-    if ( cached_slot != DHCP_IP_ADDRESS_CACHE_MAX )
+    if ( lease == NULL )
     {
-        /* Update IP address of cached device */
-        cached_ip_addresses[cached_slot] = *client_ip_address;
+        return NULL;
     }
-    else if ( first_empty_slot != DHCP_IP_ADDRESS_CACHE_MAX )
+
+    index = (uint32_t) ( lease - leases );
+    leases_in_use[index / 32] |= ( 1u << ( index % 32 ) );
+
+    lease->client_mac_address = *client_mac_address;
+    lease->state              = DHCP_LEASE_FREE;
+    lease->next               = lease_hash[mac_address_hash( client_mac_address )];
+    lease_hash[mac_address_hash( client_mac_address )] = (uint8_t) index;
+
+    return lease;
+}
+
+/**
+ *  Removes a lease from its MAC address hash chain
+ */
+static void unlink_lease( dhcp_lease_t* lease )
+{
+    uint8_t* link = &lease_hash[mac_address_hash( &lease->client_mac_address )];
+
+    while ( *link != DHCP_NO_LEASE )
     {
-        /* Add device to the first empty slot */
-        cached_mac_addresses[ first_empty_slot ] = *client_mac_address;
-        cached_ip_addresses [ first_empty_slot ] = *client_ip_address;
+        if ( &leases[*link] == lease )
+        {
+            *link       = lease->next;
+            lease->next = DHCP_NO_LEASE;
+            return;
+        }
+        link = &leases[*link].next;
     }
-    else
+}
+
+/**
+ *  Returns the address of a lease to the pool
+ */
+static void free_lease( dhcp_lease_t* lease )
+{
+    uint32_t index = (uint32_t) ( lease - leases );
+
+    if ( lease->state != DHCP_LEASE_DECLINED )
     {
-        /* Cache is full. Add device to slot 0 */
-        cached_mac_addresses[ 0 ] = *client_mac_address;
-        cached_ip_addresses [ 0 ] = *client_ip_address;
+        unlink_lease( lease );
     }
+    memset( lease, 0, sizeof( *lease ) );
+    leases_in_use[index / 32] &= ~( 1u << ( index % 32 ) );
+}
 
-    return WICED_SUCCESS;
+/**
+ *  Moves leases on whose time has run out
+ *
+ *  Offers and declined addresses go back to the pool. Bound leases are kept for their
+ *  client until the address is reclaimed. Checking regularly keeps expiry times from
+ *  being misread once the millisecond timer wraps.
+ */
+static void expire_leases( wiced_time_t current_time )
+{
+    uint32_t index;
+
+    for ( index = 0; index < address_pool.size; index++ )
+    {
+        dhcp_lease_t* lease = &leases[index];
+
+        if ( ( lease->state == DHCP_LEASE_OFFERED || lease->state == DHCP_LEASE_BOUND || lease->state == DHCP_LEASE_DECLINED ) &&
+             (int32_t) ( lease->expiry_time - current_time ) <= 0 )
+        {
+            if ( lease->state == DHCP_LEASE_BOUND )
+            {
+                lease->state = DHCP_LEASE_EXPIRED;
+            }
+            else
+            {
+                free_lease( lease );
+            }
+        }
+    }
+}
+
+/**
+ *  Returns the IPv4 address of a lease in host byte order
+ */
+static uint32_t lease_address( const dhcp_lease_t* lease )
+{
+    uint32_t index = (uint32_t) ( lease - leases );
+
+    return address_pool.subnet | ( 1 + ( address_pool.server_host + index ) % address_pool.host_count );
+}
+
+static uint8_t mac_address_hash( const wiced_mac_t* mac_address )
+{
+    /* The last three octets are assigned by the manufacturer per device */
+    return (uint8_t) ( ( ( (uint32_t) mac_address->octet[3] << 16 ) | ( (uint32_t) mac_address->octet[4] << 8 ) | mac_address->octet[5] ) % DHCP_LEASE_HASH_SIZE );
 }
 
 static void ipv4_to_string( char* buffer, uint32_t ipv4_address )
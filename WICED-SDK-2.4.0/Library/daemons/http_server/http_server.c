@@ -15,6 +15,7 @@
 
 #include <string.h>
 #include "http_server.h"
+#include "inflate.h"
 #include "wwd_assert.h"
 #include "wiced.h"
 
@@ -26,28 +27,43 @@
  *                    Constants
  ******************************************************/
 #define HTTP_SERVER_THREAD_PRIORITY (WICED_DEFAULT_LIBRARY_PRIORITY)
+#ifndef HTTP_SERVER_REQUEST_BUFFER_SIZE
+#define HTTP_SERVER_REQUEST_BUFFER_SIZE (1024) /* Largest request head which can be parsed; also holds pipelined requests */
+#endif
 #if (defined(WPRINT_ENABLE_WEBSERVER) && (defined(WPRINT_ENABLE_DEBUG) || defined(WPRINT_ENABLE_ERROR)))
-#define HTTP_SERVER_STACK_SIZE      (5000) /* printf requires 4K of stack */
+#define HTTP_SERVER_STACK_SIZE      (5000 + HTTP_SERVER_REQUEST_BUFFER_SIZE) /* printf requires 4K of stack */
 #else
-#define HTTP_SERVER_STACK_SIZE      (2500)
+#define HTTP_SERVER_STACK_SIZE      (2500 + HTTP_SERVER_REQUEST_BUFFER_SIZE)
 #endif
 #define SSL_LISTEN_PORT              (443)
-#define HTTP_SERVER_RECEIVE_TIMEOUT (2000)
+#define HTTP_SERVER_RECEIVE_TIMEOUT (2000) /* Also the idle timeout of a kept-alive connection */
+#define HTTPS_SERVER_MAX_CONNECTIONS (1)   /* Each TLS session needs its own context and the HTTPS server has only one */
 
 static const char ok_header[] =
-    "HTTP/1.0 200 OK\r\n"
+    "HTTP/1.1 200 OK\r\n"
     "Content-Type: ";
 
+static const char content_length_header[] = "\r\nContent-Length: ";
+
+static const char connection_close_header[] = "\r\nConnection: close";
+
+static const char gzip_encoding_header[] = "\r\nContent-Encoding: gzip";
+
+static const char vary_encoding_header[] = "\r\nVary: Accept-Encoding";
+
 static const char crlfcrlf[] ="\r\n\r\n";
 
 #ifndef USE_404
 
-static const char not_found_header[] = "HTTP/1.0 301\r\nLocation: /\r\n\r\n";
+static const char not_found_header[] = "HTTP/1.1 301 Moved Permanently\r\nLocation: /";
+static const char not_found_body[]   = "";
 
 #else /* ifndef USE_404 */
 static const char not_found_header[] =
-    "HTTP/1.0 404 Not Found\r\n"
-    "Content-Type: text/html\r\n\r\n"
+    "HTTP/1.1 404 Not Found\r\n"
+    "Content-Type: text/html";
+
+static const char not_found_body[] =
     "<!doctype html>\n"
     "<html><head><title>404 - WICED Web Server</title></head><body>\n"
     "<h1>Address not found on WICED Web Server</h1>\n"
@@ -116,13 +132,33 @@ static const char brcm_server_rsa_key[] =
  *                    Structures
  ******************************************************/
 
+typedef struct
+{
+    wiced_tcp_stream_t stream;
+    wiced_packet_t*    packet;         /* Received packet which has not been completely copied into the request buffer */
+    uint16_t           packet_offset;
+    uint16_t           request_length;
+    wiced_bool_t       keep_alive;
+    wiced_bool_t       accepts_gzip;
+    char               request[HTTP_SERVER_REQUEST_BUFFER_SIZE];
+} http_connection_state_t;
+
 /******************************************************
  *               Function Declarations
  ******************************************************/
 
-static wiced_result_t http_server_process_packet(const wiced_http_page_t* page_database, wiced_tcp_socket_t* socket, wiced_packet_t* packet);
-static wiced_result_t process_url_request( wiced_tcp_socket_t* socket, const wiced_http_page_t* server_url_list, char * url, int url_len );
-static void http_server_thread_main(uint32_t arg);
+static wiced_result_t http_server_start( wiced_http_server_t* server, uint16_t port, const wiced_http_page_t* page_database, wiced_interface_t interface, uint8_t connection_count, wiced_tls_advanced_context_t* tls_context );
+static void           http_server_serve_connection( wiced_http_server_t* server, wiced_tcp_socket_t* socket, http_connection_state_t* state );
+static wiced_result_t http_server_receive_request_data( wiced_tcp_socket_t* socket, http_connection_state_t* state );
+static wiced_result_t http_server_process_request( const wiced_http_page_t* page_database, http_connection_state_t* state, uint16_t* consumed );
+static wiced_result_t process_url_request( wiced_tcp_stream_t* stream, const wiced_http_page_t* server_url_list, char * url, int url_len, wiced_bool_t accepts_gzip, wiced_bool_t* keep_alive );
+static wiced_result_t http_server_write_header_end( wiced_tcp_stream_t* stream, uint32_t content_length, wiced_bool_t keep_alive );
+static wiced_result_t http_server_write_content( wiced_tcp_stream_t* stream, const uint8_t* data, uint32_t length );
+static wiced_result_t http_server_write_inflated_content( void* stream, const uint8_t* data, uint16_t length );
+static uint16_t       http_server_find_end_of_headers( const char* request, uint16_t request_length );
+static const char*    http_server_find_header( const char* headers, const char* end_of_headers, const char* name );
+static void           http_server_thread_main(uint32_t arg);
+static wiced_bool_t   http_server_is_connection_thread( wiced_http_server_t* server );
 static uint16_t escaped_string_copy(char* output, uint16_t output_length, const char* input, int16_t input_length);
 
 /******************************************************
@@ -135,25 +171,29 @@ static uint16_t escaped_string_copy(char* output, uint16_t output_length, const
 
 wiced_result_t wiced_http_server_start( wiced_http_server_t* server, uint16_t port, const wiced_http_page_t* page_database, wiced_interface_t interface )
 {
-    memset( server, 0, sizeof( *server ) );
+    return wiced_http_server_start_with_connections( server, port, page_database, interface, 1 );
+}
 
-    /* Create the TCP socket */
-    WICED_VERIFY(wiced_tcp_create_socket( &server->socket, interface ));
-    if (wiced_tcp_listen( (wiced_tcp_socket_t*) &server->socket, port ) != WICED_SUCCESS)
-    {
-        wiced_tcp_delete_socket(&server->socket);
-        return WICED_ERROR;
-    }
+wiced_result_t wiced_http_server_start_with_connections( wiced_http_server_t* server, uint16_t port, const wiced_http_page_t* page_database, wiced_interface_t interface, uint8_t max_connections )
+{
+    memset( server, 0, sizeof( *server ) );
 
-    server->page_database = page_database;
-    return wiced_rtos_create_thread(&server->thread, HTTP_SERVER_THREAD_PRIORITY, "HTTPserver", http_server_thread_main, HTTP_SERVER_STACK_SIZE, server);
+    max_connections = (uint8_t) MIN( MAX( max_connections, 1 ), HTTP_SERVER_MAX_CONNECTIONS );
+    return http_server_start( server, port, page_database, interface, max_connections, NULL );
 }
 
 wiced_result_t wiced_http_server_stop (wiced_http_server_t* server)
 {
     server->quit = WICED_TRUE;
-    if ( wiced_rtos_is_current_thread( &server->thread ) != WICED_SUCCESS )
+
+    /* A page handler may stop the server; its connection thread then exits once the reply has been sent */
+    if ( http_server_is_connection_thread( server ) != WICED_TRUE )
     {
+        uint8_t a;
+        for ( a = 1; a < server->connection_count; a++ )
+        {
+            wiced_rtos_thread_force_awake( &server->connection[a].thread );
+        }
         wiced_rtos_thread_force_awake( &server->thread );
         wiced_rtos_thread_join( &server->thread );
         wiced_rtos_delete_thread( &server->thread );
@@ -161,156 +201,408 @@ wiced_result_t wiced_http_server_stop (wiced_http_server_t* server)
     return WICED_SUCCESS;
 }
 
+wiced_result_t wiced_https_server_stop (wiced_https_server_t* server)
+{
+    return wiced_http_server_stop( (wiced_http_server_t*) server );
+}
 
-static void http_server_thread_main(uint32_t arg)
+wiced_result_t wiced_https_server_start(wiced_https_server_t* server, uint16_t port, const wiced_http_page_t* page_database, const char* server_cert, const char* server_key, wiced_interface_t interface )
 {
-    wiced_http_server_t* server = (wiced_http_server_t*) arg;
+    memset( server, 0, sizeof( *server ) );
 
-    while ( server->quit != WICED_TRUE )
+    /* Load our security data */
+#ifdef USE_SELF_SIGNED_TLS_CERT
+    if (server_cert == NULL || server_key == NULL )
     {
-        wiced_packet_t* temp_packet = NULL;
+        wiced_tls_init_advanced_context(&server->tls_context, brcm_server_certificate, brcm_server_rsa_key );
+    }
+    else
+#endif
+    {
+        wiced_tls_init_advanced_context(&server->tls_context, server_cert, server_key );
+    }
 
-        /* Wait for a connection */
-        wiced_result_t result = wiced_tcp_accept( &server->socket );
-        if ( result == WICED_SUCCESS )
+    return http_server_start( (wiced_http_server_t*) server, port, page_database, interface, HTTPS_SERVER_MAX_CONNECTIONS, &server->tls_context );
+}
+
+static wiced_result_t http_server_start( wiced_http_server_t* server, uint16_t port, const wiced_http_page_t* page_database, wiced_interface_t interface, uint8_t connection_count, wiced_tls_advanced_context_t* tls_context )
+{
+    uint8_t a;
+
+    server->page_database = page_database;
+    server->port          = port;
+
+    /* Create the TCP sockets */
+    for ( a = 0; a < connection_count; a++ )
+    {
+        if ( wiced_tcp_create_socket( &server->connection[a].socket, interface ) != WICED_SUCCESS )
         {
-            /* Receive the query */
-            if (wiced_tcp_receive( &server->socket, &temp_packet, WICED_WAIT_FOREVER ) == WICED_SUCCESS)
+            break;
+        }
+        server->connection[a].server = server;
+    }
+    server->connection_count = a;
+
+    if ( server->connection_count == 0 )
+    {
+        return WICED_ERROR;
+    }
+
+    if ( tls_context != NULL )
+    {
+        wiced_tcp_enable_tls( &server->connection[0].socket, tls_context );
+    }
+
+    /* Only the first connection listens now. The others join the port's listen request when they get their accept turn */
+    if ( wiced_tcp_listen( &server->connection[0].socket, port ) != WICED_SUCCESS )
+    {
+        goto delete_sockets;
+    }
+
+    if ( wiced_rtos_init_semaphore( &server->accept_turn ) != WICED_SUCCESS )
+    {
+        goto delete_sockets;
+    }
+
+    for ( a = 1; a < server->connection_count; a++ )
+    {
+        if ( wiced_rtos_create_thread( &server->connection[a].thread, HTTP_SERVER_THREAD_PRIORITY, "HTTPconnection", http_server_thread_main, HTTP_SERVER_STACK_SIZE, &server->connection[a] ) != WICED_SUCCESS )
+        {
+            /* Serve with the connections which could be started */
+            uint8_t b;
+            for ( b = a; b < server->connection_count; b++ )
             {
-                /* Process the request */
-                http_server_process_packet( server->page_database, &server->socket, temp_packet );
-                /* Cleanup */
-                wiced_packet_delete( temp_packet );
+                wiced_tcp_delete_socket( &server->connection[b].socket );
             }
-
-            wiced_tcp_disconnect( &server->socket );
+            server->connection_count = a;
+            break;
         }
     }
 
-    wiced_tcp_delete_socket( &server->socket );
-    WICED_END_OF_THREAD(server->thread);
-}
+    if ( wiced_rtos_create_thread( &server->thread, HTTP_SERVER_THREAD_PRIORITY, "HTTPserver", http_server_thread_main, HTTP_SERVER_STACK_SIZE, &server->connection[0] ) == WICED_SUCCESS )
+    {
+        return WICED_SUCCESS;
+    }
 
+    server->quit = WICED_TRUE;
+    for ( a = 1; a < server->connection_count; a++ )
+    {
+        wiced_rtos_thread_force_awake( &server->connection[a].thread );
+        wiced_rtos_thread_join( &server->connection[a].thread );
+        wiced_rtos_delete_thread( &server->connection[a].thread );
+    }
+    wiced_rtos_deinit_semaphore( &server->accept_turn );
 
-wiced_result_t wiced_https_server_stop (wiced_https_server_t* server)
+delete_sockets:
+    for ( a = 0; a < server->connection_count; a++ )
+    {
+        wiced_tcp_delete_socket( &server->connection[a].socket );
+    }
+    return WICED_ERROR;
+}
+
+static wiced_bool_t http_server_is_connection_thread( wiced_http_server_t* server )
 {
-    server->quit = WICED_TRUE;
-    if ( wiced_rtos_is_current_thread( &server->thread ) != WICED_SUCCESS )
+    uint8_t a;
+
+    if ( wiced_rtos_is_current_thread( &server->thread ) == WICED_SUCCESS )
     {
-        wiced_rtos_thread_force_awake( &server->thread );
-        wiced_rtos_thread_join( &server->thread );
-        wiced_rtos_delete_thread( &server->thread );
+        return WICED_TRUE;
     }
-    return WICED_SUCCESS;
+    for ( a = 1; a < server->connection_count; a++ )
+    {
+        if ( wiced_rtos_is_current_thread( &server->connection[a].thread ) == WICED_SUCCESS )
+        {
+            return WICED_TRUE;
+        }
+    }
+    return WICED_FALSE;
 }
 
-wiced_result_t wiced_https_server_start(wiced_https_server_t* server, uint16_t port, const wiced_http_page_t* page_database, const char* server_cert, const char* server_key, wiced_interface_t interface )
+static void http_server_thread_main(uint32_t arg)
 {
-    /* Create the TLS socket */
-    if (wiced_tcp_create_socket( &server->socket, interface ) != WICED_SUCCESS)
+    wiced_http_connection_t* connection = (wiced_http_connection_t*) arg;
+    wiced_http_server_t*     server     = (wiced_http_server_t*) connection->server;
+    http_connection_state_t  state;
+
+    /* Only one socket can listen on a port at a time, so idle connections take turns to accept.
+     * The first connection was put into listen by the start function and has the first turn */
+    wiced_bool_t has_accept_turn = ( connection == &server->connection[0] ) ? WICED_TRUE : WICED_FALSE;
+    wiced_bool_t listening       = has_accept_turn;
+
+    while ( server->quit != WICED_TRUE )
     {
-        return WICED_ERROR;
+        if ( has_accept_turn == WICED_FALSE )
+        {
+            if ( wiced_rtos_get_semaphore( &server->accept_turn, HTTP_SERVER_RECEIVE_TIMEOUT ) != WICED_SUCCESS )
+            {
+                continue;
+            }
+            has_accept_turn = WICED_TRUE;
+        }
+
+        if ( listening == WICED_FALSE )
+        {
+            if ( wiced_tcp_listen( &connection->socket, server->port ) != WICED_SUCCESS )
+            {
+                continue;
+            }
+            listening = WICED_TRUE;
+        }
+
+        /* Wait for a connection */
+        if ( wiced_tcp_accept( &connection->socket ) != WICED_SUCCESS )
+        {
+            continue;
+        }
+
+        /* Let the next idle connection listen while this client is served */
+        has_accept_turn = WICED_FALSE;
+        wiced_rtos_set_semaphore( &server->accept_turn );
+
+        http_server_serve_connection( server, &connection->socket, &state );
+
+        wiced_tcp_disconnect( &connection->socket );
     }
 
-    if ( wiced_tcp_listen( &server->socket, port ) != WICED_SUCCESS)
+    if ( connection != &server->connection[0] )
     {
-        wiced_tcp_delete_socket(&server->socket);
-        return WICED_ERROR;
+        WICED_END_OF_THREAD( connection->thread );
+        return;
     }
 
-    /* Load our security data */
-#ifdef USE_SELF_SIGNED_TLS_CERT
-    if (server_cert == NULL || server_key == NULL )
+    /* The server thread is what callers wait on, so it finishes last */
     {
-        wiced_tls_init_advanced_context(&server->tls_context, brcm_server_certificate, brcm_server_rsa_key );
+        uint8_t a;
+        for ( a = 1; a < server->connection_count; a++ )
+        {
+            wiced_rtos_thread_join( &server->connection[a].thread );
+            wiced_rtos_delete_thread( &server->connection[a].thread );
+        }
+        for ( a = 0; a < server->connection_count; a++ )
+        {
+            wiced_tcp_delete_socket( &server->connection[a].socket );
+        }
     }
-    else
-#endif
+    wiced_rtos_deinit_semaphore( &server->accept_turn );
+    WICED_END_OF_THREAD(server->thread);
+}
+
+static void http_server_serve_connection( wiced_http_server_t* server, wiced_tcp_socket_t* socket, http_connection_state_t* state )
+{
+    wiced_tcp_stream_init( &state->stream, socket );
+    state->packet         = NULL;
+    state->packet_offset  = 0;
+    state->request_length = 0;
+    state->keep_alive     = WICED_TRUE;
+
+    while ( server->quit != WICED_TRUE )
     {
-        wiced_tls_init_advanced_context(&server->tls_context, server_cert, server_key );
+        uint16_t       consumed = 0;
+        wiced_result_t result   = http_server_process_request( server->page_database, state, &consumed );
+
+        /* Keep any pipelined requests which follow */
+        state->request_length = (uint16_t) ( state->request_length - consumed );
+        memmove( state->request, &state->request[consumed], state->request_length );
+
+        if ( result == WICED_SUCCESS )
+        {
+            if ( state->keep_alive == WICED_FALSE )
+            {
+                break;
+            }
+            continue;
+        }
+        else if ( result != WICED_PENDING )
+        {
+            break;
+        }
+
+        /* Send the replies to all buffered requests before waiting for more data */
+        if ( wiced_tcp_stream_flush( &state->stream ) != WICED_SUCCESS )
+        {
+            break;
+        }
+
+        if ( http_server_receive_request_data( socket, state ) != WICED_SUCCESS )
+        {
+            break;
+        }
     }
 
-    wiced_tcp_enable_tls(&server->socket, &server->tls_context);
-    server->page_database = page_database;
-    return wiced_rtos_create_thread(&server->thread, HTTP_SERVER_THREAD_PRIORITY, "HTTPserver", http_server_thread_main, HTTP_SERVER_STACK_SIZE, server);
-}
+    wiced_tcp_stream_flush( &state->stream );
+    wiced_assert( "Connection finished with data still in stream", state->stream.packet == NULL );
 
+    if ( state->packet != NULL )
+    {
+        wiced_packet_delete( state->packet );
+    }
+}
 
-static wiced_result_t http_server_process_packet(const wiced_http_page_t* page_database, wiced_tcp_socket_t* socket, wiced_packet_t* packet)
+static wiced_result_t http_server_receive_request_data( wiced_tcp_socket_t* socket, http_connection_state_t* state )
 {
-    char* request_string;
-    uint16_t request_length;
-    char* start_of_url;
-    char* end_of_url;
-    wiced_result_t result = WICED_ERROR;
-    int orig_url_length;
-    int new_url_length;
+    if ( state->packet == NULL )
+    {
+        /* Idle clients are disconnected when nothing arrives in time */
+        WICED_VERIFY( wiced_tcp_receive( socket, &state->packet, HTTP_SERVER_RECEIVE_TIMEOUT ) );
+        state->packet_offset = 0;
+    }
 
-    if (packet == NULL)
+    /* Copy as much as fits. The rest of the packet is kept until the requests ahead of it have been served */
+    while ( state->request_length < HTTP_SERVER_REQUEST_BUFFER_SIZE )
     {
-        return WICED_ERROR;
+        uint8_t* data;
+        uint16_t fragment_length;
+        uint16_t available_data_length;
+        uint16_t copy_length;
+
+        if ( ( wiced_packet_get_data( state->packet, state->packet_offset, &data, &fragment_length, &available_data_length ) != WICED_SUCCESS ) || ( fragment_length == 0 ) )
+        {
+            wiced_packet_delete( state->packet );
+            state->packet = NULL;
+            break;
+        }
+
+        copy_length = (uint16_t) MIN( fragment_length, HTTP_SERVER_REQUEST_BUFFER_SIZE - state->request_length );
+        memcpy( &state->request[state->request_length], data, copy_length );
+        state->request_length = (uint16_t) ( state->request_length + copy_length );
+        state->packet_offset  = (uint16_t) ( state->packet_offset + copy_length );
     }
 
-    uint16_t available_data_length;
-    wiced_packet_get_data( packet, 0, (uint8_t**) &request_string, &request_length, &available_data_length );
+    return WICED_SUCCESS;
+}
 
-    /* Verify we have enough data to start processing */
-    if (request_length < 5)  // TODO : MAGIC NUMBER
+static wiced_result_t http_server_process_request( const wiced_http_page_t* page_database, http_connection_state_t* state, uint16_t* consumed )
+{
+    char*       request = state->request;
+    uint16_t    request_length = state->request_length;
+    uint16_t    header_length;
+    uint32_t    content_length = 0;
+    char*       start_of_url;
+    char*       end_of_url;
+    char*       end_of_headers;
+    const char* value;
+    uint16_t    skipped = 0;
+    int         orig_url_length;
+    int         new_url_length;
+
+    /* Skip empty lines left between pipelined requests */
+    while ( ( skipped < request_length ) && ( ( request[skipped] == '\r' ) || ( request[skipped] == '\n' ) ) )
     {
-        return WICED_ERROR;
+        ++skipped;
+    }
+    request        += skipped;
+    request_length  = (uint16_t) ( request_length - skipped );
+
+    header_length = http_server_find_end_of_headers( request, request_length );
+    if ( header_length == 0 )
+    {
+        if ( state->request_length < HTTP_SERVER_REQUEST_BUFFER_SIZE )
+        {
+            *consumed = skipped;
+            return WICED_PENDING;
+        }
+
+        /* The headers do not fit. Serve from the request line alone and close the connection afterwards */
+        header_length     = request_length;
+        state->keep_alive = WICED_FALSE;
     }
+    end_of_headers = &request[header_length];
 
-    /* Check that this is a GET request */
-    if ( strstr( request_string, "GET " ) != 0 )
+    /* Check that this is a GET or POST request */
+    if ( ( header_length > 4 ) && ( strncmp( request, "GET ", 4 ) == 0 ) )
     {
-        request_string[3] = '\x00';
-        start_of_url = &request_string[4];
+        start_of_url = &request[4];
     }
-    else if ( strstr( request_string, "POST " ) != 0 )
+    else if ( ( header_length > 5 ) && ( strncmp( request, "POST ", 5 ) == 0 ) )
     {
-        request_string[4] = '\x00';
-        start_of_url = &request_string[5];
+        start_of_url = &request[5];
     }
     else
     {
-        result = WICED_ERROR;
-        goto cleanup;
+        return WICED_ERROR;
     }
 
     end_of_url = start_of_url;
-    /* Find the end of the request path ( space, newline, null, or end of packet ) */
-    while ( ( *end_of_url != ' ' ) && ( *end_of_url != '\n' ) && ( *end_of_url != '\x00' ) )
+    /* Find the end of the request path ( space, newline or end of headers ) */
+    while ( ( *end_of_url != ' ' ) && ( *end_of_url != '\r' ) && ( *end_of_url != '\n' ) )
     {
         ++end_of_url;
 
-        /* Check if we've run out of data */
-        if ( end_of_url > &request_string[request_length] )
+        if ( end_of_url >= end_of_headers )
         {
-            /* Can't find end of URL, perhaps only part of the request*/
             return WICED_ERROR;
         }
     }
 
-    /* Set the end of url character to a newline  */
-    *end_of_url = '\n';
+    /* HTTP/1.1 connections persist unless the client asks otherwise; older clients get one reply */
+    if ( ( *end_of_url != ' ' ) || ( end_of_url + 9 > end_of_headers ) || ( strncmp( end_of_url + 1, "HTTP/1.1", 8 ) != 0 ) )
+    {
+        state->keep_alive = WICED_FALSE;
+    }
 
-    orig_url_length = (int) end_of_url - (int) start_of_url;
-    new_url_length = escaped_string_copy(start_of_url, orig_url_length, start_of_url, orig_url_length);
-    /* Check if the url has "shrunk" due to escaped character replacement */
-    if (new_url_length != orig_url_length)
+    value = http_server_find_header( end_of_url, end_of_headers, "Connection:" );
+    if ( ( value != NULL ) && ( ( *value == 'c' ) || ( *value == 'C' ) ) )
+    {
+        state->keep_alive = WICED_FALSE;
+    }
+
+    value = http_server_find_header( end_of_url, end_of_headers, "Content-Length:" );
+    if ( value != NULL )
+    {
+        while ( ( value < end_of_headers ) && ( *value >= '0' ) && ( *value <= '9' ) )
+        {
+            content_length = content_length * 10 + (uint32_t) ( *value - '0' );
+            ++value;
+        }
+    }
+
+    /* Compressed resources are sent as they are stored only to clients which accept gzip */
+    state->accepts_gzip = WICED_FALSE;
+    value = http_server_find_header( end_of_url, end_of_headers, "Accept-Encoding:" );
+    while ( ( value != NULL ) && ( value + 4 <= end_of_headers ) && ( *value != '\r' ) && ( *value != '\n' ) )
     {
-        /* Set the "extra" characters to null  */
-        memset(start_of_url + new_url_length, '\x00', orig_url_length - new_url_length);
+        if ( strncmp( value, "gzip", 4 ) == 0 )
+        {
+            state->accepts_gzip = WICED_TRUE;
+            break;
+        }
+        ++value;
+    }
+
+    if ( http_server_find_header( end_of_url, end_of_headers, "Transfer-Encoding:" ) != NULL )
+    {
+        /* Chunked request bodies are not supported, so the end of this request can not be found */
+        state->keep_alive = WICED_FALSE;
+    }
+
+    /* Wait for the request body so that the next request starts in the right place */
+    if ( ( state->keep_alive == WICED_TRUE ) && ( content_length != 0 ) )
+    {
+        if ( (uint32_t) skipped + header_length + content_length > HTTP_SERVER_REQUEST_BUFFER_SIZE )
+        {
+            state->keep_alive = WICED_FALSE;
+        }
+        else if ( (uint32_t) header_length + content_length > request_length )
+        {
+            *consumed = skipped;
+            return WICED_PENDING;
+        }
+        else
+        {
+            header_length = (uint16_t) ( header_length + content_length );
+        }
     }
-    process_url_request( (wiced_tcp_socket_t*)socket, page_database, start_of_url, new_url_length );
+    *consumed = ( state->keep_alive == WICED_TRUE ) ? (uint16_t) ( skipped + header_length ) : state->request_length;
 
-    result = WICED_SUCCESS;
+    orig_url_length = (int) end_of_url - (int) start_of_url;
+    new_url_length = escaped_string_copy(start_of_url, orig_url_length, start_of_url, orig_url_length);
+    start_of_url[new_url_length] = '\x00';
 
-cleanup:
-    return result;
+    return process_url_request( &state->stream, page_database, start_of_url, new_url_length, state->accepts_gzip, &state->keep_alive );
 }
 
-static wiced_result_t process_url_request( wiced_tcp_socket_t* socket, const wiced_http_page_t* server_url_list, char * url, int url_len )
+static wiced_result_t process_url_request( wiced_tcp_stream_t* stream, const wiced_http_page_t* server_url_list, char * url, int url_len, wiced_bool_t accepts_gzip, wiced_bool_t* keep_alive )
 {
     /* Search the url to find the question mark if there is one */
     char * params = url;
@@ -323,17 +615,16 @@ static wiced_result_t process_url_request( wiced_tcp_socket_t* socket, const wic
     }
 
     /* terminate the path part of the string with a null - will replace the question mark */
-    *params = '\x00';
+    if ( params_len > 0 )
+    {
+        *params = '\x00';
 
-    /* increment the pointer to the parameter query part of the url to skip over the null which was just written */
-    params++;
+        /* increment the pointer to the parameter query part of the url to skip over the null which was just written */
+        params++;
+    }
 
     WPRINT_WEBSERVER_DEBUG(("Processing request for: %s\r\n", url));
 
-    /* Init the tcp stream */
-    wiced_tcp_stream_t stream;
-    wiced_tcp_stream_init(&stream, socket);
-
     /* Search URL list to determine if request matches one of our pages */
     wiced_bool_t found = WICED_FALSE;
     while ( server_url_list[i].url != NULL )
@@ -348,19 +639,47 @@ static wiced_result_t process_url_request( wiced_tcp_socket_t* socket, const wic
             switch (server_url_list[i].url_content_type)
             {
                 case WICED_DYNAMIC_URL_CONTENT:
-                    wiced_http_write_reply_header(&stream, server_url_list[i].mime_type, WICED_TRUE);
+                    wiced_http_write_reply_header(stream, server_url_list[i].mime_type, WICED_TRUE);
                     /* Fall through */
                 case WICED_RAW_DYNAMIC_URL_CONTENT:
-                    server_url_list[i].url_content.dynamic_data.generator( params, &stream, server_url_list[i].url_content.dynamic_data.arg );
-                    wiced_tcp_stream_flush(&stream);
+                    /* The length of generated content is not known, so the end of the connection marks its end */
+                    *keep_alive = WICED_FALSE;
+                    server_url_list[i].url_content.dynamic_data.generator( params, stream, server_url_list[i].url_content.dynamic_data.arg );
                     break;
 
                 case WICED_STATIC_URL_CONTENT:
-                    wiced_http_write_reply_header(&stream, server_url_list[i].mime_type, WICED_FALSE);
-                    /* Fall through */
+                    wiced_tcp_stream_write(stream, ok_header, sizeof(ok_header)-1);
+                    wiced_tcp_stream_write(stream, server_url_list[i].mime_type, strlen(server_url_list[i].mime_type));
+                    http_server_write_header_end(stream, server_url_list[i].url_content.static_data.length, *keep_alive);
+                    http_server_write_content(stream, server_url_list[i].url_content.static_data.ptr, server_url_list[i].url_content.static_data.length);
+                    break;
+
+                case WICED_STATIC_GZIP_URL_CONTENT:
+                    wiced_tcp_stream_write(stream, ok_header, sizeof(ok_header)-1);
+                    wiced_tcp_stream_write(stream, server_url_list[i].mime_type, strlen(server_url_list[i].mime_type));
+                    wiced_tcp_stream_write(stream, vary_encoding_header, sizeof(vary_encoding_header)-1);
+                    if ( accepts_gzip == WICED_TRUE )
+                    {
+                        wiced_tcp_stream_write(stream, gzip_encoding_header, sizeof(gzip_encoding_header)-1);
+                        http_server_write_header_end(stream, server_url_list[i].url_content.static_data.length, *keep_alive);
+                        http_server_write_content(stream, server_url_list[i].url_content.static_data.ptr, server_url_list[i].url_content.static_data.length);
+                    }
+                    else
+                    {
+                        /* Decompress while sending. The length is known from the gzip trailer */
+                        http_server_write_header_end(stream, inflate_gzip_length(server_url_list[i].url_content.static_data.ptr, server_url_list[i].url_content.static_data.length), *keep_alive);
+                        if ( inflate_gzip(server_url_list[i].url_content.static_data.ptr, server_url_list[i].url_content.static_data.length, WICED_GZIP_RESOURCE_WINDOW_BITS, http_server_write_inflated_content, stream) != WICED_SUCCESS )
+                        {
+                            /* The reply is shorter than its Content-Length, so the client can only detect the end by the connection closing */
+                            *keep_alive = WICED_FALSE;
+                        }
+                    }
+                    break;
+
                 case WICED_RAW_STATIC_URL_CONTENT:
-                    wiced_tcp_stream_write(&stream, server_url_list[i].url_content.static_data.ptr, server_url_list[i].url_content.static_data.length);
-                    wiced_tcp_stream_flush(&stream);
+                    /* Raw content carries its own headers, which do not give its length */
+                    *keep_alive = WICED_FALSE;
+                    wiced_tcp_stream_write(stream, server_url_list[i].url_content.static_data.ptr, server_url_list[i].url_content.static_data.length);
                     break;
             }
             break;
@@ -372,12 +691,11 @@ static wiced_result_t process_url_request( wiced_tcp_socket_t* socket, const wic
     if ( found == WICED_FALSE )
     {
         /* Send back 404 */
-        wiced_tcp_stream_write(&stream, not_found_header, sizeof(not_found_header)-1);
-        wiced_tcp_stream_flush(&stream);
+        wiced_tcp_stream_write(stream, not_found_header, sizeof(not_found_header)-1);
+        http_server_write_header_end(stream, sizeof(not_found_body)-1, *keep_alive);
+        wiced_tcp_stream_write(stream, not_found_body, sizeof(not_found_body)-1);
     }
 
-    wiced_assert( "Page Serve finished with data still in stream", stream.packet == NULL );
-
     return WICED_SUCCESS;
 }
 
@@ -395,12 +713,109 @@ wiced_result_t wiced_http_write_reply_header(wiced_tcp_stream_t* stream, const c
         wiced_tcp_stream_write( stream, NO_CACHE_HEADER, sizeof( NO_CACHE_HEADER ) - 1 );
     }
 
+    /* Content which follows this header has no length, so it ends with the connection */
+    wiced_tcp_stream_write( stream, connection_close_header, sizeof( connection_close_header ) - 1 );
+
     /* Add double carriage return, line feed */
     wiced_tcp_stream_write( stream, crlfcrlf, sizeof( crlfcrlf ) - 1 );
 
     return WICED_SUCCESS;
 }
 
+static wiced_result_t http_server_write_header_end( wiced_tcp_stream_t* stream, uint32_t content_length, wiced_bool_t keep_alive )
+{
+    char    length_string[10];
+    uint8_t start = sizeof( length_string );
+
+    do
+    {
+        length_string[--start] = (char) ( '0' + content_length % 10 );
+        content_length /= 10;
+    } while ( content_length != 0 );
+
+    wiced_tcp_stream_write( stream, content_length_header, sizeof( content_length_header ) - 1 );
+    wiced_tcp_stream_write( stream, &length_string[start], (uint16_t) ( sizeof( length_string ) - start ) );
+
+    if ( keep_alive == WICED_FALSE )
+    {
+        wiced_tcp_stream_write( stream, connection_close_header, sizeof( connection_close_header ) - 1 );
+    }
+
+    return wiced_tcp_stream_write( stream, crlfcrlf, sizeof( crlfcrlf ) - 1 );
+}
+
+static wiced_result_t http_server_write_content( wiced_tcp_stream_t* stream, const uint8_t* data, uint32_t length )
+{
+    /* Stream writes are limited to 64KB */
+    while ( length != 0 )
+    {
+        uint16_t write_length = (uint16_t) MIN( length, 0x8000 );
+        WICED_VERIFY( wiced_tcp_stream_write( stream, data, write_length ) );
+        data   += write_length;
+        length -= write_length;
+    }
+    return WICED_SUCCESS;
+}
+
+static wiced_result_t http_server_write_inflated_content( void* stream, const uint8_t* data, uint16_t length )
+{
+    return wiced_tcp_stream_write( (wiced_tcp_stream_t*) stream, data, length );
+}
+
+/* Returns the length of the request head including the blank line which ends it, or zero if it is incomplete */
+static uint16_t http_server_find_end_of_headers( const char* request, uint16_t request_length )
+{
+    uint16_t a;
+
+    for ( a = 3; a < request_length; a++ )
+    {
+        if ( ( request[a] == '\n' ) && ( request[a - 1] == '\r' ) && ( request[a - 2] == '\n' ) && ( request[a - 3] == '\r' ) )
+        {
+            return (uint16_t) ( a + 1 );
+        }
+    }
+    return 0;
+}
+
+/* Returns the start of the named header's value, or NULL. Header names are matched without regard to case */
+static const char* http_server_find_header( const char* headers, const char* end_of_headers, const char* name )
+{
+    uint16_t name_length = (uint16_t) strlen( name );
+
+    while ( headers < end_of_headers )
+    {
+        /* Move to the start of the next line */
+        while ( ( headers < end_of_headers ) && ( *headers != '\n' ) )
+        {
+            ++headers;
+        }
+        ++headers;
+
+        if ( headers + name_length <= end_of_headers )
+        {
+            uint16_t a;
+            for ( a = 0; a < name_length; a++ )
+            {
+                if ( ( headers[a] | 0x20 ) != ( name[a] | 0x20 ) )
+                {
+                    break;
+                }
+            }
+
+            if ( a == name_length )
+            {
+                const char* value = headers + name_length;
+                while ( ( value < end_of_headers ) && ( *value == ' ' ) )
+                {
+                    ++value;
+                }
+                return value;
+            }
+        }
+    }
+    return NULL;
+}
+
 static uint16_t escaped_string_copy(char* output, uint16_t output_length, const char* input, int16_t input_length)
 {
     uint16_t bytes_copied;
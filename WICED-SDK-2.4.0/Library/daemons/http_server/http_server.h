@@ -48,6 +48,15 @@ extern "C" {
 
 #define IOS_CAPTIVE_PORTAL_ADDRESS    "/library/test/success.html"
 
+/* Window used to compress resources (see Tools/text_to_c/text_to_c.pl) and to decompress them for clients without gzip support */
+#define WICED_GZIP_RESOURCE_WINDOW_BITS  (11)
+
+/* Most clients an HTTP server can be started to serve simultaneously, see wiced_http_server_start_with_connections().
+ * Each connection has its own socket and thread, the RAM is only used by the connections actually started */
+#ifndef HTTP_SERVER_MAX_CONNECTIONS
+#define HTTP_SERVER_MAX_CONNECTIONS   (3)
+#endif
+
 /******************************************************
  *                   Enumerations
  ******************************************************/
@@ -71,7 +80,8 @@ typedef struct
         WICED_STATIC_URL_CONTENT,
         WICED_DYNAMIC_URL_CONTENT,
         WICED_RAW_STATIC_URL_CONTENT,
-        WICED_RAW_DYNAMIC_URL_CONTENT
+        WICED_RAW_DYNAMIC_URL_CONTENT,
+        WICED_STATIC_GZIP_URL_CONTENT   /* static_data holds a resource listed in <name>_COMPRESSED_RESOURCES */
     } url_content_type;
     union
     {
@@ -90,18 +100,31 @@ typedef struct
 
 typedef struct
 {
-    wiced_tcp_socket_t       socket;
+    wiced_tcp_socket_t socket;
+    wiced_thread_t     thread;  /* Not used by the first connection, which is served by the server thread */
+    void*              server;
+} wiced_http_connection_t;
+
+typedef struct
+{
     volatile wiced_bool_t    quit;
-    wiced_thread_t           thread;
+    wiced_thread_t           thread;            /* Finishes only after every connection has closed */
     const wiced_http_page_t* page_database;
+    wiced_semaphore_t        accept_turn;
+    uint16_t                 port;
+    uint8_t                  connection_count;
+    wiced_http_connection_t  connection[HTTP_SERVER_MAX_CONNECTIONS];
 } wiced_http_server_t;
 
 typedef struct
 {
-    wiced_tcp_socket_t         socket;
     volatile wiced_bool_t      quit;
     wiced_thread_t             thread;
     const wiced_http_page_t*   page_database;
+    wiced_semaphore_t          accept_turn;
+    uint16_t                   port;
+    uint8_t                    connection_count;
+    wiced_http_connection_t    connection[HTTP_SERVER_MAX_CONNECTIONS];
     wiced_tls_advanced_context_t tls_context;
 } wiced_https_server_t;
 
@@ -114,6 +137,11 @@ typedef struct
  ******************************************************/
 
 wiced_result_t wiced_http_server_start (wiced_http_server_t* server, uint16_t port, const wiced_http_page_t* page_database, wiced_interface_t interface);
+
+/* Like wiced_http_server_start(), which serves one client at a time, but serves up to max_connections clients at once
+ * (capped at HTTP_SERVER_MAX_CONNECTIONS). Every connection beyond the first costs another thread with a
+ * 3.5 KB stack (2500 bytes + the 1 KB request buffer, 6 KB with web server debug prints) and another TCP socket */
+wiced_result_t wiced_http_server_start_with_connections (wiced_http_server_t* server, uint16_t port, const wiced_http_page_t* page_database, wiced_interface_t interface, uint8_t max_connections);
 wiced_result_t wiced_http_server_stop (wiced_http_server_t* server);
 
 wiced_result_t wiced_https_server_start (wiced_https_server_t* server, uint16_t port, const wiced_http_page_t* page_database, const char* server_cert, const char* server_key, wiced_interface_t interface );
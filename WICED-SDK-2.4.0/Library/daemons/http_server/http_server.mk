@@ -10,5 +10,6 @@
 
 NAME := Lib_http_server
 
-$(NAME)_SOURCES := http_server.c
+$(NAME)_SOURCES := http_server.c \
+                   inflate.c
 GLOBAL_INCLUDES := .
@@ -0,0 +1,536 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  Small gzip decompressor (RFC 1951 / RFC 1952) for data held in flash
+ *
+ *  Decoding tables and the output window are allocated only while decompressing.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "inflate.h"
+#include "wiced_utilities.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+#define GZIP_HEADER_LENGTH     (10)
+#define GZIP_TRAILER_LENGTH    (8)
+#define GZIP_METHOD_DEFLATE    (8)
+#define GZIP_FLAG_HCRC         (0x02)
+#define GZIP_FLAG_EXTRA        (0x04)
+#define GZIP_FLAG_NAME         (0x08)
+#define GZIP_FLAG_COMMENT      (0x10)
+
+#define MAX_CODE_BITS          (15)
+#define MAX_LITERAL_LENGTH_CODES (286)
+#define MAX_DISTANCE_CODES     (30)
+#define FIXED_LITERAL_LENGTH_CODES (288)
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+typedef struct
+{
+    uint16_t count[MAX_CODE_BITS + 1];  /* Number of codes of each length */
+    uint16_t* symbol;                   /* Symbols ordered by code */
+} huffman_table_t;
+
+typedef struct
+{
+    /* Input */
+    const uint8_t* in;
+    uint32_t       in_length;
+    uint32_t       in_position;
+    uint32_t       bit_buffer;
+    uint8_t        bit_count;
+
+    /* Output */
+    uint8_t*                  window;
+    uint16_t                  window_mask;
+    uint16_t                  window_position;
+    uint32_t                  total_out;
+    inflate_output_function_t output;
+    void*                     arg;
+
+    /* Decoding tables */
+    huffman_table_t literal_length;
+    huffman_table_t distance;
+    uint16_t        literal_length_symbols[FIXED_LITERAL_LENGTH_CODES];
+    uint16_t        distance_symbols[MAX_DISTANCE_CODES];
+    uint16_t        code_lengths[FIXED_LITERAL_LENGTH_CODES + MAX_DISTANCE_CODES];
+} inflate_state_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+static wiced_result_t inflate_get_bits( inflate_state_t* state, uint8_t bit_count, uint16_t* value );
+static wiced_result_t inflate_put_byte( inflate_state_t* state, uint8_t byte );
+static wiced_result_t inflate_stored_block( inflate_state_t* state );
+static wiced_result_t inflate_build_table( huffman_table_t* table, const uint16_t* lengths, uint16_t code_count );
+static wiced_result_t inflate_decode_symbol( inflate_state_t* state, const huffman_table_t* table, uint16_t* symbol );
+static wiced_result_t inflate_codes( inflate_state_t* state );
+static wiced_result_t inflate_fixed_block( inflate_state_t* state );
+static wiced_result_t inflate_dynamic_block( inflate_state_t* state );
+
+/******************************************************
+ *                 Static Variables
+ ******************************************************/
+
+static const uint16_t length_base[29] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t length_extra_bits[29] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t distance_base[30] =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t distance_extra_bits[30] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/* Order in which code length code lengths are sent in a dynamic block */
+static const uint8_t code_length_order[19] =
+{
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+uint32_t inflate_gzip_length( const uint8_t* gzip_data, uint32_t gzip_length )
+{
+    const uint8_t* trailer;
+
+    if ( ( gzip_length < GZIP_HEADER_LENGTH + GZIP_TRAILER_LENGTH ) || ( gzip_data[0] != 0x1f ) || ( gzip_data[1] != 0x8b ) )
+    {
+        return 0;
+    }
+
+    /* ISIZE is the last field of the trailer, stored little endian */
+    trailer = &gzip_data[gzip_length - 4];
+    return (uint32_t) trailer[0] | ( (uint32_t) trailer[1] << 8 ) | ( (uint32_t) trailer[2] << 16 ) | ( (uint32_t) trailer[3] << 24 );
+}
+
+wiced_result_t inflate_gzip( const uint8_t* gzip_data, uint32_t gzip_length, uint8_t window_bits, inflate_output_function_t output, void* arg )
+{
+    inflate_state_t* state;
+    uint32_t         position = GZIP_HEADER_LENGTH;
+    uint8_t          flags;
+    uint16_t         last_block = 0;
+    wiced_result_t   result     = WICED_SUCCESS;
+
+    if ( ( gzip_length < GZIP_HEADER_LENGTH + GZIP_TRAILER_LENGTH ) || ( gzip_data[0] != 0x1f ) || ( gzip_data[1] != 0x8b ) || ( gzip_data[2] != GZIP_METHOD_DEFLATE ) )
+    {
+        return WICED_BADARG;
+    }
+
+    /* Skip the optional header fields */
+    flags = gzip_data[3];
+    if ( flags & GZIP_FLAG_EXTRA )
+    {
+        position += 2 + ( (uint32_t) gzip_data[position] | ( (uint32_t) gzip_data[position + 1] << 8 ) );
+    }
+    if ( flags & GZIP_FLAG_NAME )
+    {
+        while ( ( position < gzip_length ) && ( gzip_data[position++] != 0 ) )
+        {
+        }
+    }
+    if ( flags & GZIP_FLAG_COMMENT )
+    {
+        while ( ( position < gzip_length ) && ( gzip_data[position++] != 0 ) )
+        {
+        }
+    }
+    if ( flags & GZIP_FLAG_HCRC )
+    {
+        position += 2;
+    }
+    if ( position + GZIP_TRAILER_LENGTH > gzip_length )
+    {
+        return WICED_BADARG;
+    }
+
+    state = (inflate_state_t*) malloc( sizeof(inflate_state_t) + ( 1u << window_bits ) );
+    if ( state == NULL )
+    {
+        return WICED_NOMEM;
+    }
+    memset( state, 0, sizeof(inflate_state_t) );
+
+    state->in                     = &gzip_data[position];
+    state->in_length              = gzip_length - position - GZIP_TRAILER_LENGTH;
+    state->window                 = (uint8_t*) &state[1];
+    state->window_mask            = (uint16_t) ( ( 1u << window_bits ) - 1 );
+    state->output                 = output;
+    state->arg                    = arg;
+    state->literal_length.symbol  = state->literal_length_symbols;
+    state->distance.symbol        = state->distance_symbols;
+
+    while ( ( last_block == 0 ) && ( result == WICED_SUCCESS ) )
+    {
+        uint16_t block_type;
+
+        result = inflate_get_bits( state, 1, &last_block );
+        if ( result == WICED_SUCCESS )
+        {
+            result = inflate_get_bits( state, 2, &block_type );
+        }
+        if ( result != WICED_SUCCESS )
+        {
+            break;
+        }
+
+        switch ( block_type )
+        {
+            case 0:
+                result = inflate_stored_block( state );
+                break;
+            case 1:
+                result = inflate_fixed_block( state );
+                break;
+            case 2:
+                result = inflate_dynamic_block( state );
+                break;
+            default:
+                result = WICED_ERROR;
+                break;
+        }
+    }
+
+    /* Send whatever is left in the window */
+    if ( ( result == WICED_SUCCESS ) && ( state->window_position != 0 ) )
+    {
+        result = state->output( state->arg, state->window, state->window_position );
+    }
+
+    free( state );
+    return result;
+}
+
+static wiced_result_t inflate_get_bits( inflate_state_t* state, uint8_t bit_count, uint16_t* value )
+{
+    while ( state->bit_count < bit_count )
+    {
+        if ( state->in_position == state->in_length )
+        {
+            return WICED_ERROR;
+        }
+        state->bit_buffer |= (uint32_t) state->in[state->in_position++] << state->bit_count;
+        state->bit_count = (uint8_t) ( state->bit_count + 8 );
+    }
+
+    *value = (uint16_t) ( state->bit_buffer & ( ( 1u << bit_count ) - 1 ) );
+    state->bit_buffer >>= bit_count;
+    state->bit_count = (uint8_t) ( state->bit_count - bit_count );
+    return WICED_SUCCESS;
+}
+
+static wiced_result_t inflate_put_byte( inflate_state_t* state, uint8_t byte )
+{
+    state->window[state->window_position] = byte;
+    state->window_position = (uint16_t) ( ( state->window_position + 1 ) & state->window_mask );
+    state->total_out++;
+
+    /* Window is full; pass it on. It stays valid for back references until it is overwritten */
+    if ( state->window_position == 0 )
+    {
+        return state->output( state->arg, state->window, (uint16_t) ( state->window_mask + 1 ) );
+    }
+    return WICED_SUCCESS;
+}
+
+static wiced_result_t inflate_stored_block( inflate_state_t* state )
+{
+    uint16_t length;
+    uint16_t inverse_length;
+
+    /* Stored blocks start on a byte boundary */
+    state->bit_buffer = 0;
+    state->bit_count  = 0;
+
+    if ( state->in_position + 4 > state->in_length )
+    {
+        return WICED_ERROR;
+    }
+    length         = (uint16_t) ( state->in[state->in_position]     | ( state->in[state->in_position + 1] << 8 ) );
+    inverse_length = (uint16_t) ( state->in[state->in_position + 2] | ( state->in[state->in_position + 3] << 8 ) );
+    state->in_position += 4;
+
+    if ( ( ( length ^ inverse_length ) != 0xFFFF ) || ( state->in_position + length > state->in_length ) )
+    {
+        return WICED_ERROR;
+    }
+
+    while ( length-- != 0 )
+    {
+        WICED_VERIFY( inflate_put_byte( state, state->in[state->in_position++] ) );
+    }
+    return WICED_SUCCESS;
+}
+
+static wiced_result_t inflate_build_table( huffman_table_t* table, const uint16_t* lengths, uint16_t code_count )
+{
+    uint16_t offsets[MAX_CODE_BITS + 1];
+    uint16_t symbol;
+    uint16_t length;
+    int32_t  codes_left = 1;
+
+    memset( table->count, 0, sizeof( table->count ) );
+    for ( symbol = 0; symbol < code_count; symbol++ )
+    {
+        table->count[lengths[symbol]]++;
+    }
+
+    /* Reject over-subscribed code sets */
+    for ( length = 1; length <= MAX_CODE_BITS; length++ )
+    {
+        codes_left = ( codes_left << 1 ) - table->count[length];
+        if ( codes_left < 0 )
+        {
+            return WICED_ERROR;
+        }
+    }
+
+    offsets[1] = 0;
+    for ( length = 1; length < MAX_CODE_BITS; length++ )
+    {
+        offsets[length + 1] = (uint16_t) ( offsets[length] + table->count[length] );
+    }
+
+    for ( symbol = 0; symbol < code_count; symbol++ )
+    {
+        if ( lengths[symbol] != 0 )
+        {
+            table->symbol[offsets[lengths[symbol]]++] = symbol;
+        }
+    }
+    return WICED_SUCCESS;
+}
+
+static wiced_result_t inflate_decode_symbol( inflate_state_t* state, const huffman_table_t* table, uint16_t* symbol )
+{
+    int32_t  code  = 0;   /* Code bits read so far */
+    int32_t  first = 0;   /* First code of the current length */
+    int32_t  index = 0;   /* Index of the first code of the current length in the symbol table */
+    uint16_t length;
+
+    for ( length = 1; length <= MAX_CODE_BITS; length++ )
+    {
+        uint16_t bit;
+        int32_t  count;
+
+        WICED_VERIFY( inflate_get_bits( state, 1, &bit ) );
+        code |= bit;
+        count = table->count[length];
+        if ( code - count < first )
+        {
+            *symbol = table->symbol[index + ( code - first )];
+            return WICED_SUCCESS;
+        }
+        index += count;
+        first  = ( first + count ) << 1;
+        code <<= 1;
+    }
+    return WICED_ERROR;
+}
+
+static wiced_result_t inflate_codes( inflate_state_t* state )
+{
+    uint16_t symbol;
+
+    while ( 1 )
+    {
+        uint16_t length;
+        uint16_t distance;
+        uint16_t extra;
+
+        WICED_VERIFY( inflate_decode_symbol( state, &state->literal_length, &symbol ) );
+
+        if ( symbol < 256 )
+        {
+            WICED_VERIFY( inflate_put_byte( state, (uint8_t) symbol ) );
+            continue;
+        }
+        if ( symbol == 256 )
+        {
+            return WICED_SUCCESS;
+        }
+
+        symbol = (uint16_t) ( symbol - 257 );
+        if ( symbol >= 29 )
+        {
+            return WICED_ERROR;
+        }
+        WICED_VERIFY( inflate_get_bits( state, length_extra_bits[symbol], &extra ) );
+        length = (uint16_t) ( length_base[symbol] + extra );
+
+        WICED_VERIFY( inflate_decode_symbol( state, &state->distance, &symbol ) );
+        if ( symbol >= 30 )
+        {
+            return WICED_ERROR;
+        }
+        WICED_VERIFY( inflate_get_bits( state, distance_extra_bits[symbol], &extra ) );
+        distance = (uint16_t) ( distance_base[symbol] + extra );
+
+        /* Data was compressed with a larger window than is kept here */
+        if ( ( distance > state->total_out ) || ( distance > state->window_mask + 1 ) )
+        {
+            return WICED_ERROR;
+        }
+
+        while ( length-- != 0 )
+        {
+            WICED_VERIFY( inflate_put_byte( state, state->window[( state->window_position - distance ) & state->window_mask] ) );
+        }
+    }
+}
+
+static wiced_result_t inflate_fixed_block( inflate_state_t* state )
+{
+    uint16_t symbol;
+
+    for ( symbol = 0; symbol < 144; symbol++ )
+    {
+        state->code_lengths[symbol] = 8;
+    }
+    for ( ; symbol < 256; symbol++ )
+    {
+        state->code_lengths[symbol] = 9;
+    }
+    for ( ; symbol < 280; symbol++ )
+    {
+        state->code_lengths[symbol] = 7;
+    }
+    for ( ; symbol < FIXED_LITERAL_LENGTH_CODES; symbol++ )
+    {
+        state->code_lengths[symbol] = 8;
+    }
+    inflate_build_table( &state->literal_length, state->code_lengths, FIXED_LITERAL_LENGTH_CODES );
+
+    for ( symbol = 0; symbol < MAX_DISTANCE_CODES; symbol++ )
+    {
+        state->code_lengths[symbol] = 5;
+    }
+    inflate_build_table( &state->distance, state->code_lengths, MAX_DISTANCE_CODES );
+
+    return inflate_codes( state );
+}
+
+static wiced_result_t inflate_dynamic_block( inflate_state_t* state )
+{
+    uint16_t literal_length_count;
+    uint16_t distance_count;
+    uint16_t code_length_count;
+    uint16_t index;
+
+    WICED_VERIFY( inflate_get_bits( state, 5, &literal_length_count ) );
+    WICED_VERIFY( inflate_get_bits( state, 5, &distance_count ) );
+    WICED_VERIFY( inflate_get_bits( state, 4, &code_length_count ) );
+    literal_length_count = (uint16_t) ( literal_length_count + 257 );
+    distance_count       = (uint16_t) ( distance_count + 1 );
+    code_length_count    = (uint16_t) ( code_length_count + 4 );
+
+    if ( ( literal_length_count > MAX_LITERAL_LENGTH_CODES ) || ( distance_count > MAX_DISTANCE_CODES ) )
+    {
+        return WICED_ERROR;
+    }
+
+    /* Read the code length code, decoded through the distance table which is free until the end of this function */
+    memset( state->code_lengths, 0, 19 * sizeof( state->code_lengths[0] ) );
+    for ( index = 0; index < code_length_count; index++ )
+    {
+        WICED_VERIFY( inflate_get_bits( state, 3, &state->code_lengths[code_length_order[index]] ) );
+    }
+    WICED_VERIFY( inflate_build_table( &state->distance, state->code_lengths, 19 ) );
+
+    /* Read the literal/length and distance code lengths */
+    index = 0;
+    while ( index < literal_length_count + distance_count )
+    {
+        uint16_t symbol;
+        uint16_t repeat;
+        uint16_t length = 0;
+
+        WICED_VERIFY( inflate_decode_symbol( state, &state->distance, &symbol ) );
+        if ( symbol < 16 )
+        {
+            state->code_lengths[index++] = symbol;
+            continue;
+        }
+
+        if ( symbol == 16 )
+        {
+            if ( index == 0 )
+            {
+                return WICED_ERROR;
+            }
+            length = state->code_lengths[index - 1];
+            WICED_VERIFY( inflate_get_bits( state, 2, &repeat ) );
+            repeat = (uint16_t) ( repeat + 3 );
+        }
+        else if ( symbol == 17 )
+        {
+            WICED_VERIFY( inflate_get_bits( state, 3, &repeat ) );
+            repeat = (uint16_t) ( repeat + 3 );
+        }
+        else
+        {
+            WICED_VERIFY( inflate_get_bits( state, 7, &repeat ) );
+            repeat = (uint16_t) ( repeat + 11 );
+        }
+
+        if ( index + repeat > literal_length_count + distance_count )
+        {
+            return WICED_ERROR;
+        }
+        while ( repeat-- != 0 )
+        {
+            state->code_lengths[index++] = length;
+        }
+    }
+
+    /* A block must be able to end */
+    if ( state->code_lengths[256] == 0 )
+    {
+        return WICED_ERROR;
+    }
+
+    WICED_VERIFY( inflate_build_table( &state->literal_length, state->code_lengths, literal_length_count ) );
+    WICED_VERIFY( inflate_build_table( &state->distance, &state->code_lengths[literal_length_count], distance_count ) );
+
+    return inflate_codes( state );
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "wwd_constants.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/* Receives decompressed data in pieces of up to the window size */
+typedef wiced_result_t (*inflate_output_function_t)( void* arg, const uint8_t* data, uint16_t length );
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/******************************************************
+ *                 Global Variables
+ ******************************************************/
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/** Decompresses gzip data held in memory
+ *
+ * Only the last window_bits worth of output is kept, so the data must have been
+ * compressed with a window no larger than that (e.g. by text_to_c.pl --gzip).
+ *
+ * @param[in] gzip_data   : the complete gzip file
+ * @param[in] gzip_length : length of the gzip file in bytes
+ * @param[in] window_bits : log2 of the window size to allocate
+ * @param[in] output      : function that receives the decompressed data
+ * @param[in] arg         : argument passed to the output function
+ *
+ * @return @ref wiced_result_t
+ */
+wiced_result_t inflate_gzip( const uint8_t* gzip_data, uint32_t gzip_length, uint8_t window_bits, inflate_output_function_t output, void* arg );
+
+/** Returns the decompressed length recorded in the trailer of gzip data, or zero if the data is not gzip */
+uint32_t inflate_gzip_length( const uint8_t* gzip_data, uint32_t gzip_length );
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
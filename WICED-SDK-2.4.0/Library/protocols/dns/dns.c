@@ -17,8 +17,10 @@
 #include "wiced_network.h"
 #include "wiced_tcpip.h"
 #include "wwd_debug.h"
+#include "wwd_crypto.h"
 #include <wiced_utilities.h>
 #include "wiced_time.h"
+#include "wiced_rtos.h"
 
 /**************************************************************************************************************
  * CONSTANTS
@@ -30,6 +32,55 @@
 #define WICED_MAXIMUM_STORED_DNS_SERVERS (2)
 #endif
 
+/* Number of hostnames remembered by the resolver cache. Set to 0 to disable the cache */
+#ifndef DNS_CACHE_SIZE
+#define DNS_CACHE_SIZE (8)
+#endif
+
+/* Longest hostname that is cached. Longer names are always looked up */
+#ifndef DNS_CACHE_MAXIMUM_HOSTNAME_LENGTH
+#define DNS_CACHE_MAXIMUM_HOSTNAME_LENGTH (63)
+#endif
+
+/* Upper bound on the TTL honoured by the cache, in seconds. Also keeps expiry times clear of timer wrap-around */
+#ifndef DNS_CACHE_MAXIMUM_TTL
+#define DNS_CACHE_MAXIMUM_TTL (24 * 60 * 60)
+#endif
+
+/* Time a name that does not exist (NXDOMAIN) is remembered, in seconds */
+#ifndef DNS_CACHE_NEGATIVE_TTL
+#define DNS_CACHE_NEGATIVE_TTL (30)
+#endif
+
+/* Number of asynchronous lookups which can be outstanding at once */
+#ifndef DNS_RESOLVER_MAXIMUM_QUERIES
+#define DNS_RESOLVER_MAXIMUM_QUERIES (8)
+#endif
+
+#ifndef DNS_RESOLVER_THREAD_STACK_SIZE
+#define DNS_RESOLVER_THREAD_STACK_SIZE (2048)
+#endif
+
+#ifndef DNS_RESOLVER_THREAD_PRIORITY
+#define DNS_RESOLVER_THREAD_PRIORITY WICED_DEFAULT_LIBRARY_PRIORITY
+#endif
+
+/* Round trip time assumed for a server until it has answered, in milliseconds */
+#define DNS_RESOLVER_INITIAL_RTT          (250)
+
+/* Bounds on the time waited for an answer before asking the next server, in milliseconds */
+#define DNS_RESOLVER_MINIMUM_RETRANSMIT   (200)
+#define DNS_RESOLVER_MAXIMUM_RETRANSMIT   (3000)
+
+/* A server which does not answer is avoided for this long, doubling with each further miss up to the maximum */
+#define DNS_RESOLVER_BACKOFF_TIME         (1000)
+#define DNS_RESOLVER_MAXIMUM_BACKOFF_TIME (32000)
+
+/* Longest chain of CNAME records followed */
+#define DNS_RESOLVER_MAXIMUM_ALIASES      (8)
+
+#define DNS_NO_SERVER                     (0xFF)
+
 /* Change to 1 to turn debug trace */
 #define WICED_DNS_DEBUG   (0)
 
@@ -37,10 +88,56 @@
  * STRUCTURES
  **************************************************************************************************************/
 
+typedef struct
+{
+    char               hostname[DNS_CACHE_MAXIMUM_HOSTNAME_LENGTH + 1]; /* Empty when the entry is unused */
+    wiced_ip_address_t address;                                         /* WICED_INVALID_IP for a name that does not exist */
+    wiced_time_t       expiry_time;
+    uint32_t           last_used;
+} dns_cache_entry_t;
+
+typedef struct
+{
+    uint32_t     smoothed_rtt;  /* Milliseconds */
+    uint32_t     misses;        /* Queries left unanswered since the last answer */
+    wiced_time_t backoff_until;
+} dns_server_state_t;
+
+typedef struct
+{
+    dns_client_lookup_callback_t callback;        /* NULL when the entry is unused */
+    void*                        arg;
+    char*                        hostname;        /* Copy of the name asked for */
+    char*                        alias;           /* Name currently queried while following a CNAME, otherwise NULL */
+    uint32_t                     ttl;             /* Smallest TTL seen so far along the CNAME chain */
+    uint16_t                     id;              /* Transaction ID of the current name */
+    uint8_t                      server;          /* Server the last query was sent to */
+    uint8_t                      transmissions;   /* Queries sent for the current name */
+    uint8_t                      alias_count;
+    wiced_time_t                 sent_time;
+    wiced_time_t                 retransmit_time;
+    wiced_time_t                 deadline;
+} dns_query_t;
+
 /**************************************************************************************************************
  * FUNCTION DECLARATIONS
  **************************************************************************************************************/
 
+static wiced_result_t dns_cache_find                ( const char* hostname, wiced_ip_address_t* address );
+static void           dns_cache_store               ( const char* hostname, const wiced_ip_address_t* address, uint32_t ttl );
+#if DNS_CACHE_SIZE > 0
+static wiced_bool_t   dns_cache_hostname_matches    ( const char* cached, const char* hostname );
+#endif
+static void           dns_resolver_thread_main      ( uint32_t arg );
+static void           dns_resolver_send_query       ( dns_query_t* query, wiced_time_t current_time );
+static void           dns_resolver_process_response ( wiced_packet_t* packet, wiced_time_t current_time );
+static void           dns_resolver_complete         ( dns_query_t* query, wiced_result_t result, const wiced_ip_address_t* address, uint32_t ttl );
+static uint8_t        dns_resolver_choose_server    ( wiced_time_t current_time, uint8_t previous_server );
+static void           dns_resolver_server_missed    ( uint8_t server, uint32_t waited, wiced_time_t current_time );
+static uint16_t       dns_client_new_id             ( void );
+static uint8_t        dns_client_find_server        ( const wiced_ip_address_t* address );
+static wiced_bool_t   dns_client_response_is_valid  ( wiced_packet_t* packet, dns_message_iterator_t* iter, const uint8_t* end, const char* name, const char* other_name );
+
 /**************************************************************************************************************
  * VARIABLES
  **************************************************************************************************************/
@@ -48,6 +145,25 @@
 static wiced_ip_address_t dns_server_address_array[WICED_MAXIMUM_STORED_DNS_SERVERS];
 static uint32_t           dns_server_address_count = 0;
 
+static dns_server_state_t dns_server_state[WICED_MAXIMUM_STORED_DNS_SERVERS];
+
+/* Protects the cache, the server state and the asynchronous queries */
+static wiced_mutex_t      dns_client_mutex;
+static wiced_bool_t       dns_client_initialised   = WICED_FALSE;
+
+#if DNS_CACHE_SIZE > 0
+static dns_cache_entry_t  dns_cache[DNS_CACHE_SIZE];
+static uint32_t           dns_cache_use_count      = 0;
+#endif
+static dns_cache_statistics_t dns_cache_statistics;
+
+static dns_query_t        dns_queries[DNS_RESOLVER_MAXIMUM_QUERIES];
+static wiced_udp_socket_t dns_resolver_socket;
+static wiced_thread_t     dns_resolver_thread;
+static wiced_bool_t       dns_resolver_running     = WICED_FALSE;
+static wiced_bool_t       dns_resolver_thread_used = WICED_FALSE;
+static uint16_t           dns_resolver_next_id;
+
 /**************************************************************************************************************
  * FUNCTION DEFINITIONS
  **************************************************************************************************************/
@@ -60,14 +176,42 @@ wiced_result_t dns_client_add_server_address( wiced_ip_address_t address )
         return WICED_ERROR;
     }
 
-    dns_server_address_array[dns_server_address_count++] = address;
+    /* Servers are added while the network is brought up, before anyone resolves names */
+    if ( dns_client_initialised == WICED_FALSE )
+    {
+        wiced_time_t current_time;
+
+        WICED_VERIFY( wiced_rtos_init_mutex( &dns_client_mutex ) );
+        wiced_time_get_time( &current_time );
+        dns_resolver_next_id   = (uint16_t) current_time;   /* Only used if the WLAN cannot supply random numbers */
+        dns_client_initialised = WICED_TRUE;
+    }
+
+    wiced_rtos_lock_mutex( &dns_client_mutex );
+    wiced_time_get_time( &dns_server_state[dns_server_address_count].backoff_until );
+    dns_server_state[dns_server_address_count].smoothed_rtt = DNS_RESOLVER_INITIAL_RTT;
+    dns_server_state[dns_server_address_count].misses       = 0;
+    dns_server_address_array[dns_server_address_count++]    = address;
+    wiced_rtos_unlock_mutex( &dns_client_mutex );
     return WICED_SUCCESS;
 }
 
 wiced_result_t dns_client_remove_all_server_addresses( void )
 {
+    if ( dns_client_initialised == WICED_TRUE )
+    {
+        wiced_rtos_lock_mutex( &dns_client_mutex );
+    }
     memset( dns_server_address_array, 0, sizeof( dns_server_address_array ) );
     dns_server_address_count = 0;
+#if DNS_CACHE_SIZE > 0
+    /* Answers from the previous servers may not hold on the new network (split-horizon, captive portals) */
+    memset( dns_cache, 0, sizeof( dns_cache ) );
+#endif
+    if ( dns_client_initialised == WICED_TRUE )
+    {
+        wiced_rtos_unlock_mutex( &dns_client_mutex );
+    }
     return WICED_SUCCESS;
 }
 
@@ -82,8 +226,23 @@ wiced_result_t dns_client_hostname_lookup( const char* hostname, wiced_ip_addres
     wiced_ip_address_t     resolved_ipv6_address  = { WICED_INVALID_IP };
     wiced_bool_t           ipv4_address_found     = WICED_FALSE;
     wiced_bool_t           ipv6_address_found     = WICED_FALSE;
+    wiced_bool_t           name_does_not_exist    = WICED_FALSE;
+    uint32_t               ttl                    = DNS_CACHE_MAXIMUM_TTL;
     char*                  temp_hostname          = (char*)hostname;
     uint16_t               hostname_length        = (uint16_t) strlen( hostname );
+    uint16_t               id;
+    wiced_result_t         result;
+
+    result = dns_cache_find( hostname, address );
+    if ( result == WICED_SUCCESS )
+    {
+        return WICED_SUCCESS;
+    }
+    else if ( result == WICED_DOES_NOT_EXIST )
+    {
+        /* Recently told that this name does not exist */
+        return WICED_ERROR;
+    }
 
 #if WICED_DNS_DEBUG
     wiced_time_t time;
@@ -97,8 +256,11 @@ wiced_result_t dns_client_hostname_lookup( const char* hostname, wiced_ip_addres
         return WICED_ERROR;
     }
 
-    while ( ipv4_address_found == WICED_FALSE && remaining_time > 0)
+    while ( ipv4_address_found == WICED_FALSE && name_does_not_exist == WICED_FALSE && remaining_time > 0)
     {
+        /* A fresh unpredictable ID each round, so a spoofed answer has to guess it */
+        id = dns_client_new_id( );
+
         /* Send DNS query messages */
         for ( a = 0; a < dns_server_address_count; a++ )
         {
@@ -112,7 +274,7 @@ wiced_result_t dns_client_hostname_lookup( const char* hostname, wiced_ip_addres
             }
 
             iter.iter = (uint8_t*) ( iter.header ) + sizeof(dns_message_header_t);
-            dns_write_header( &iter, 0, 0x100, 1, 0, 0, 0 );
+            dns_write_header( &iter, id, 0x100, 1, 0, 0, 0 );
             dns_write_question( &iter, temp_hostname, RR_CLASS_IN, RR_TYPE_A );
             wiced_packet_set_data_end( packet, iter.iter );
 
@@ -133,7 +295,7 @@ wiced_result_t dns_client_hostname_lookup( const char* hostname, wiced_ip_addres
                 }
 
                 iter.iter = (uint8_t*) ( iter.header ) + sizeof(dns_message_header_t);
-                dns_write_header( &iter, 0, 0x100, 1, 0, 0, 0 );
+                dns_write_header( &iter, id, 0x100, 1, 0, 0, 0 );
                 dns_write_question( &iter, temp_hostname, RR_CLASS_IN, RR_TYPE_AAAA );
                 wiced_packet_set_data_end( packet, iter.iter );
 
@@ -147,7 +309,7 @@ wiced_result_t dns_client_hostname_lookup( const char* hostname, wiced_ip_addres
         }
 
         /* Attempt to receive response packets */
-        while ( ipv4_address_found == WICED_FALSE && remaining_time > 0 )
+        while ( ipv4_address_found == WICED_FALSE && name_does_not_exist == WICED_FALSE && remaining_time > 0 )
         {
             uint32_t current_time;
             uint32_t last_time;
@@ -164,18 +326,23 @@ wiced_result_t dns_client_hostname_lookup( const char* hostname, wiced_ip_addres
                 wiced_packet_get_data( packet, 0, (uint8_t**) &iter.header, &data_length, &available_data_length );
                 iter.iter = (uint8_t*) ( iter.header ) + sizeof(dns_message_header_t);
 
+                /* Ignore anything which is not an answer to this round's queries. The original name is also
+                 * accepted while following an alias, since its answer may carry the whole CNAME chain */
+                if ( data_length < sizeof(dns_message_header_t) ||
+                     htobe16( iter.header->id ) != id ||
+                     dns_client_response_is_valid( packet, &iter, (uint8_t*) iter.header + data_length, temp_hostname, hostname ) == WICED_FALSE )
+                {
+                    /* Nothing to do */
+                }
                 /* Check if the message is a response (otherwise its a query) */
-                if ( htobe16( iter.header->flags ) & DNS_MESSAGE_IS_A_RESPONSE )
+                else if ( ( htobe16( iter.header->flags ) & DNS_MESSAGE_IS_A_RESPONSE ) && ( htobe16( iter.header->flags ) & DNS_MESSAGE_RESPONSE_CODE ) == DNS_NAME_ERROR )
                 {
-                    /* Skip all the questions */
-                    for ( a = 0; a < htobe16( iter.header->question_count ); ++a )
-                    {
-                        /* Skip the name */
-                        dns_skip_name( &iter );
-
-                        /* Skip the type and class */
-                        iter.iter += 4;
-                    }
+                    /* The server says the name does not exist. No point waiting for the other servers */
+                    name_does_not_exist = WICED_TRUE;
+                }
+                else if ( htobe16( iter.header->flags ) & DNS_MESSAGE_IS_A_RESPONSE )
+                {
+                    /* The iterator has been left after the question by the check above */
 
                     /* Process the answer */
                     for ( a = 0; answer_found == WICED_FALSE && a < htobe16( iter.header->answer_count ); ++a )
@@ -188,6 +355,9 @@ wiced_result_t dns_client_hostname_lookup( const char* hostname, wiced_ip_addres
                         switch ( record.type )
                         {
                             case RR_TYPE_CNAME:
+                                /* The address can only be cached for as long as every alias leading to it */
+                                ttl = MIN( ttl, record.ttl );
+
                                 /* Received an alias for our queried name. Restart DNS query for the new name */
                                 //
                                 if ( temp_hostname != hostname )
@@ -210,6 +380,7 @@ wiced_result_t dns_client_hostname_lookup( const char* hostname, wiced_ip_addres
                                 /* IP address found! */
                                 answer_found       = WICED_TRUE;
                                 ipv4_address_found = WICED_TRUE;
+                                ttl                = MIN( ttl, record.ttl );
 
                                 SET_IPV4_ADDRESS( resolved_ipv4_address, htonl(*(uint32_t*)record.rdata) );
 
@@ -310,6 +481,7 @@ wiced_result_t dns_client_hostname_lookup( const char* hostname, wiced_ip_addres
 
     if ( ipv4_address_found == WICED_TRUE )
     {
+        dns_cache_store( hostname, &resolved_ipv4_address, ttl );
         *address = resolved_ipv4_address;
         return WICED_SUCCESS;
     }
@@ -318,10 +490,722 @@ wiced_result_t dns_client_hostname_lookup( const char* hostname, wiced_ip_addres
         *address = resolved_ipv6_address;
         return WICED_SUCCESS;
     }
+    else if ( name_does_not_exist == WICED_TRUE )
+    {
+        dns_cache_store( hostname, &resolved_ipv4_address, DNS_CACHE_NEGATIVE_TTL );
+    }
 
     return WICED_ERROR;
 }
 
+wiced_result_t dns_client_hostname_lookup_async( const char* hostname, uint32_t timeout_ms, dns_client_lookup_callback_t callback, void* arg )
+{
+    wiced_ip_address_t address;
+    wiced_result_t     result;
+    wiced_time_t       current_time;
+    dns_query_t*       query = NULL;
+    uint32_t           a;
+
+    if ( callback == NULL )
+    {
+        return WICED_BADARG;
+    }
+
+    if ( dns_client_initialised == WICED_FALSE )
+    {
+        return WICED_NOTUP;
+    }
+
+    result = dns_cache_find( hostname, &address );
+    if ( result == WICED_SUCCESS )
+    {
+        callback( arg, hostname, WICED_SUCCESS, &address );
+        return WICED_SUCCESS;
+    }
+    else if ( result == WICED_DOES_NOT_EXIST )
+    {
+        callback( arg, hostname, WICED_ERROR, NULL );
+        return WICED_SUCCESS;
+    }
+
+    wiced_rtos_lock_mutex( &dns_client_mutex );
+
+    for ( a = 0; a < DNS_RESOLVER_MAXIMUM_QUERIES; a++ )
+    {
+        if ( dns_queries[a].callback == NULL )
+        {
+            query = &dns_queries[a];
+            break;
+        }
+    }
+
+    if ( query == NULL )
+    {
+        wiced_rtos_unlock_mutex( &dns_client_mutex );
+        return WICED_NORESOURCE;
+    }
+
+    query->hostname = malloc_named( "dns", strlen( hostname ) + 1 );
+    if ( query->hostname == NULL )
+    {
+        wiced_rtos_unlock_mutex( &dns_client_mutex );
+        return WICED_NOMEM;
+    }
+    strcpy( query->hostname, hostname );
+
+    /* Start the thread which waits for the answers. The previous one may still be finishing */
+    if ( dns_resolver_running == WICED_FALSE )
+    {
+        if ( dns_resolver_thread_used == WICED_TRUE )
+        {
+            wiced_rtos_thread_join( &dns_resolver_thread );
+            wiced_rtos_delete_thread( &dns_resolver_thread );
+            dns_resolver_thread_used = WICED_FALSE;
+        }
+
+        if ( wiced_udp_create_socket( &dns_resolver_socket, WICED_ANY_PORT, WICED_STA_INTERFACE ) != WICED_SUCCESS )
+        {
+            free( query->hostname );
+            query->hostname = NULL;
+            wiced_rtos_unlock_mutex( &dns_client_mutex );
+            return WICED_ERROR;
+        }
+
+        if ( wiced_rtos_create_thread( &dns_resolver_thread, DNS_RESOLVER_THREAD_PRIORITY, "DNSresolver", dns_resolver_thread_main, DNS_RESOLVER_THREAD_STACK_SIZE, NULL ) != WICED_SUCCESS )
+        {
+            wiced_udp_delete_socket( &dns_resolver_socket );
+            free( query->hostname );
+            query->hostname = NULL;
+            wiced_rtos_unlock_mutex( &dns_client_mutex );
+            return WICED_ERROR;
+        }
+
+        dns_resolver_running     = WICED_TRUE;
+        dns_resolver_thread_used = WICED_TRUE;
+    }
+
+    wiced_time_get_time( &current_time );
+    query->callback      = callback;
+    query->arg           = arg;
+    query->alias         = NULL;
+    query->ttl           = DNS_CACHE_MAXIMUM_TTL;
+    query->id            = dns_client_new_id( );
+    query->transmissions = 0;
+    query->alias_count   = 0;
+    query->deadline      = current_time + timeout_ms;
+
+    /* Ask straight away rather than waiting for the resolver thread to notice */
+    dns_resolver_send_query( query, current_time );
+
+    wiced_rtos_unlock_mutex( &dns_client_mutex );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t dns_client_flush_cache( void )
+{
+#if DNS_CACHE_SIZE > 0
+    if ( dns_client_initialised == WICED_TRUE )
+    {
+        wiced_rtos_lock_mutex( &dns_client_mutex );
+        memset( dns_cache, 0, sizeof( dns_cache ) );
+        wiced_rtos_unlock_mutex( &dns_client_mutex );
+    }
+#endif
+    return WICED_SUCCESS;
+}
+
+wiced_result_t dns_client_get_cache_statistics( dns_cache_statistics_t* statistics )
+{
+    *statistics = dns_cache_statistics;
+    return WICED_SUCCESS;
+}
+
+/*
+ * Looks up a hostname in the resolver cache
+ * @return WICED_SUCCESS if the address is cached, WICED_DOES_NOT_EXIST if the name is cached as
+ *         not existing, WICED_NOTFOUND if the name has to be looked up
+ */
+static wiced_result_t dns_cache_find( const char* hostname, wiced_ip_address_t* address )
+{
+#if DNS_CACHE_SIZE > 0
+    wiced_result_t result = WICED_NOTFOUND;
+    wiced_time_t   current_time;
+    uint32_t       a;
+
+    if ( dns_client_initialised == WICED_FALSE )
+    {
+        return WICED_NOTFOUND;
+    }
+
+    wiced_time_get_time( &current_time );
+    wiced_rtos_lock_mutex( &dns_client_mutex );
+
+    for ( a = 0; a < DNS_CACHE_SIZE; a++ )
+    {
+        dns_cache_entry_t* entry = &dns_cache[a];
+
+        if ( entry->hostname[0] == '\0' || dns_cache_hostname_matches( entry->hostname, hostname ) == WICED_FALSE )
+        {
+            continue;
+        }
+
+        if ( (int32_t) ( entry->expiry_time - current_time ) <= 0 )
+        {
+            /* Expired, free the entry for reuse */
+            entry->hostname[0] = '\0';
+            break;
+        }
+
+        entry->last_used = ++dns_cache_use_count;
+        if ( entry->address.version == WICED_INVALID_IP )
+        {
+            result = WICED_DOES_NOT_EXIST;
+        }
+        else
+        {
+            *address = entry->address;
+            result   = WICED_SUCCESS;
+        }
+        break;
+    }
+
+    if ( result == WICED_NOTFOUND )
+    {
+        dns_cache_statistics.misses++;
+    }
+    else
+    {
+        dns_cache_statistics.hits++;
+    }
+
+    wiced_rtos_unlock_mutex( &dns_client_mutex );
+    return result;
+#else
+    UNUSED_PARAMETER( hostname );
+    UNUSED_PARAMETER( address );
+    dns_cache_statistics.misses++;
+    return WICED_NOTFOUND;
+#endif
+}
+
+#if DNS_CACHE_SIZE > 0
+/* Hostnames are case insensitive */
+static wiced_bool_t dns_cache_hostname_matches( const char* cached, const char* hostname )
+{
+    while ( *cached != '\0' )
+    {
+        char b = *cached++;
+        char c = *hostname++;
+        if ( b >= 'a' && b <= 'z' )
+        {
+            b -= ( 'a' - 'A' );
+        }
+        if ( c >= 'a' && c <= 'z' )
+        {
+            c -= ( 'a' - 'A' );
+        }
+        if ( b != c )
+        {
+            return WICED_FALSE;
+        }
+    }
+    return ( *hostname == '\0' ) ? WICED_TRUE : WICED_FALSE;
+}
+#endif
+
+/*
+ * Remembers the address of a hostname for ttl seconds, replacing the least recently used entry if the cache is full
+ * An address of WICED_INVALID_IP records that the name does not exist
+ */
+static void dns_cache_store( const char* hostname, const wiced_ip_address_t* address, uint32_t ttl )
+{
+#if DNS_CACHE_SIZE > 0
+    dns_cache_entry_t* entry = NULL;
+    wiced_time_t       current_time;
+    uint32_t           a;
+
+    if ( dns_client_initialised == WICED_FALSE || ttl == 0 || strlen( hostname ) > DNS_CACHE_MAXIMUM_HOSTNAME_LENGTH )
+    {
+        return;
+    }
+
+    wiced_time_get_time( &current_time );
+    wiced_rtos_lock_mutex( &dns_client_mutex );
+
+    /* Prefer an entry for the same name, then an unused or expired one, then the least recently used */
+    for ( a = 0; a < DNS_CACHE_SIZE; a++ )
+    {
+        dns_cache_entry_t* candidate = &dns_cache[a];
+
+        if ( candidate->hostname[0] != '\0' && dns_cache_hostname_matches( candidate->hostname, hostname ) == WICED_TRUE )
+        {
+            entry = candidate;
+            break;
+        }
+
+        if ( candidate->hostname[0] == '\0' || (int32_t) ( candidate->expiry_time - current_time ) <= 0 )
+        {
+            candidate->hostname[0] = '\0';
+            candidate->last_used   = 0;
+        }
+
+        if ( entry == NULL || candidate->last_used < entry->last_used )
+        {
+            entry = candidate;
+        }
+    }
+
+    strcpy( entry->hostname, hostname );
+    entry->address     = *address;
+    entry->expiry_time = current_time + MIN( ttl, DNS_CACHE_MAXIMUM_TTL ) * 1000;
+    entry->last_used   = ++dns_cache_use_count;
+
+    wiced_rtos_unlock_mutex( &dns_client_mutex );
+#else
+    UNUSED_PARAMETER( hostname );
+    UNUSED_PARAMETER( address );
+    UNUSED_PARAMETER( ttl );
+#endif
+}
+
+/*
+ * Resolver thread. Retransmits and times out the asynchronous queries and processes the answers.
+ * Exits once no queries are left; the next lookup starts it again.
+ */
+static void dns_resolver_thread_main( uint32_t arg )
+{
+    wiced_packet_t* packet;
+    wiced_time_t    current_time;
+    uint32_t        wait_time;
+    wiced_bool_t    pending;
+    uint32_t        a;
+
+    UNUSED_PARAMETER( arg );
+
+    wiced_rtos_lock_mutex( &dns_client_mutex );
+
+    while ( 1 )
+    {
+        /* New queries may be due sooner than any seen here, so never sleep longer than the shortest retransmit interval */
+        wait_time = DNS_RESOLVER_MINIMUM_RETRANSMIT;
+
+        wiced_time_get_time( &current_time );
+        for ( a = 0; a < DNS_RESOLVER_MAXIMUM_QUERIES; a++ )
+        {
+            dns_query_t* query = &dns_queries[a];
+
+            if ( query->callback == NULL )
+            {
+                continue;
+            }
+
+            if ( (int32_t) ( query->deadline - current_time ) <= 0 )
+            {
+                dns_resolver_complete( query, WICED_TIMEOUT, NULL, 0 );
+                continue;
+            }
+
+            if ( (int32_t) ( query->retransmit_time - current_time ) <= 0 )
+            {
+                if ( query->transmissions != 0 )
+                {
+                    dns_resolver_server_missed( query->server, ( query->transmissions == 1 ) ? current_time - query->sent_time : 0, current_time );
+                }
+                dns_resolver_send_query( query, current_time );
+            }
+
+            wait_time = MIN( wait_time, query->retransmit_time - current_time );
+            wait_time = MIN( wait_time, query->deadline - current_time );
+        }
+
+        /* Callbacks may have started new lookups, so look again before deciding to exit */
+        pending = WICED_FALSE;
+        for ( a = 0; a < DNS_RESOLVER_MAXIMUM_QUERIES; a++ )
+        {
+            if ( dns_queries[a].callback != NULL )
+            {
+                pending = WICED_TRUE;
+            }
+        }
+        if ( pending == WICED_FALSE )
+        {
+            dns_resolver_running = WICED_FALSE;
+            break;
+        }
+
+        wiced_rtos_unlock_mutex( &dns_client_mutex );
+
+        if ( wiced_udp_receive( &dns_resolver_socket, &packet, wait_time ) == WICED_SUCCESS )
+        {
+            wiced_rtos_lock_mutex( &dns_client_mutex );
+            wiced_time_get_time( &current_time );
+            dns_resolver_process_response( packet, current_time );
+            wiced_packet_delete( packet );
+        }
+        else
+        {
+            wiced_rtos_lock_mutex( &dns_client_mutex );
+        }
+    }
+
+    wiced_rtos_unlock_mutex( &dns_client_mutex );
+
+    wiced_udp_delete_socket( &dns_resolver_socket );
+
+    WICED_END_OF_THREAD( dns_resolver_thread );
+}
+
+/*
+ * Sends a query for the current name of an asynchronous lookup to the most promising server
+ * Must be called with the DNS client mutex held
+ */
+static void dns_resolver_send_query( dns_query_t* query, wiced_time_t current_time )
+{
+    const char*            name = ( query->alias != NULL ) ? query->alias : query->hostname;
+    dns_message_iterator_t iter;
+    wiced_packet_t*        packet;
+    uint16_t               available_space;
+    uint8_t                server;
+    uint32_t               retransmit_interval;
+
+    /* Whatever happens below, try again later if no answer arrives */
+    query->retransmit_time = current_time + DNS_RESOLVER_MINIMUM_RETRANSMIT;
+
+    server = dns_resolver_choose_server( current_time, ( query->transmissions != 0 ) ? query->server : DNS_NO_SERVER );
+    if ( server == DNS_NO_SERVER )
+    {
+        return;
+    }
+
+    if ( wiced_packet_create_udp( &dns_resolver_socket, (uint16_t) ( sizeof(dns_message_header_t) + sizeof(dns_question_t) + strlen( name ) + 2 ), &packet, (uint8_t**) &iter.header, &available_space ) != WICED_SUCCESS )
+    {
+        return;
+    }
+
+    iter.iter = (uint8_t*) ( iter.header ) + sizeof(dns_message_header_t);
+    dns_write_header( &iter, query->id, DNS_MESSAGE_RECURSION_DESIRED, 1, 0, 0, 0 );
+    dns_write_question( &iter, name, RR_CLASS_IN, RR_TYPE_A );
+    wiced_packet_set_data_end( packet, iter.iter );
+
+    if ( wiced_udp_send( &dns_resolver_socket, &dns_server_address_array[server], DNS_PORT, packet ) != WICED_SUCCESS )
+    {
+        wiced_packet_delete( packet );
+        return;
+    }
+
+    /* Allow twice the server's usual round trip, doubling each time this name has to be asked again */
+    retransmit_interval = MAX( 2 * dns_server_state[server].smoothed_rtt, DNS_RESOLVER_MINIMUM_RETRANSMIT );
+    retransmit_interval = MIN( retransmit_interval << MIN( query->transmissions, 4 ), DNS_RESOLVER_MAXIMUM_RETRANSMIT );
+
+    query->server          = server;
+    query->sent_time       = current_time;
+    query->retransmit_time = current_time + retransmit_interval;
+    if ( query->transmissions != 0xFF )
+    {
+        query->transmissions++;
+    }
+}
+
+/*
+ * Matches an answer to an asynchronous lookup by transaction ID, server and question
+ * Must be called with the DNS client mutex held
+ */
+static void dns_resolver_process_response( wiced_packet_t* packet, wiced_time_t current_time )
+{
+    dns_message_iterator_t iter;
+    dns_query_t*           query = NULL;
+    wiced_ip_address_t     source;
+    wiced_ip_address_t     address;
+    uint16_t               source_port;
+    uint8_t                server;
+    uint16_t               data_length;
+    uint16_t               available_data_length;
+    uint16_t               flags;
+    uint8_t*               end;
+    char*                  alias = NULL;
+    uint32_t               ttl;
+    uint32_t               a;
+
+    wiced_packet_get_data( packet, 0, (uint8_t**) &iter.header, &data_length, &available_data_length );
+    if ( data_length < sizeof(dns_message_header_t) )
+    {
+        return;
+    }
+    end   = (uint8_t*) iter.header + data_length;
+    flags = htobe16( iter.header->flags );
+
+    if ( ( flags & DNS_MESSAGE_IS_A_RESPONSE ) == 0 )
+    {
+        return;
+    }
+
+    for ( a = 0; a < DNS_RESOLVER_MAXIMUM_QUERIES; a++ )
+    {
+        if ( dns_queries[a].callback != NULL && dns_queries[a].id == htobe16( iter.header->id ) )
+        {
+            query = &dns_queries[a];
+            break;
+        }
+    }
+
+    if ( query == NULL )
+    {
+        /* Late answer to a lookup which has finished or moved on to an alias */
+        return;
+    }
+
+    /* Anything else may be spoofed. This also leaves the iterator after the question */
+    if ( dns_client_response_is_valid( packet, &iter, end, ( query->alias != NULL ) ? query->alias : query->hostname, NULL ) == WICED_FALSE )
+    {
+        return;
+    }
+
+    if ( ( flags & DNS_MESSAGE_RESPONSE_CODE ) != DNS_NO_ERROR && ( flags & DNS_MESSAGE_RESPONSE_CODE ) != DNS_NAME_ERROR )
+    {
+        /* Server failure or refusal. Ask another server now */
+        query->retransmit_time = current_time;
+        return;
+    }
+
+    /* The server is working. Only time the round trip if the answer cannot be to an earlier transmission */
+    wiced_udp_packet_get_info( packet, &source, &source_port );
+    server = dns_client_find_server( &source );
+    dns_server_state[server].misses        = 0;
+    dns_server_state[server].backoff_until = current_time;
+    if ( query->server == server && query->transmissions == 1 )
+    {
+        dns_server_state[server].smoothed_rtt = ( 7 * dns_server_state[server].smoothed_rtt + ( current_time - query->sent_time ) ) / 8;
+    }
+
+    if ( ( flags & DNS_MESSAGE_RESPONSE_CODE ) == DNS_NAME_ERROR )
+    {
+        dns_resolver_complete( query, WICED_ERROR, NULL, DNS_CACHE_NEGATIVE_TTL );
+        return;
+    }
+
+    /* Look for the address, following any aliases the server has already resolved for us */
+    ttl = query->ttl;
+    for ( a = 0; a < htobe16( iter.header->answer_count ) && iter.iter < end; ++a )
+    {
+        dns_name_t   name;
+        dns_record_t record;
+
+        dns_get_next_record( &iter, &record, &name );
+
+        if ( record.type == RR_TYPE_A && record.rd_length == 4 )
+        {
+            if ( alias != NULL )
+            {
+                free( alias );
+            }
+            SET_IPV4_ADDRESS( address, dns_read_uint32( record.rdata ) );
+            dns_resolver_complete( query, WICED_SUCCESS, &address, MIN( ttl, record.ttl ) );
+            return;
+        }
+        else if ( record.type == RR_TYPE_CNAME )
+        {
+            if ( alias != NULL )
+            {
+                free( alias );
+            }
+            alias = dns_read_name( record.rdata, (dns_message_header_t*) name.start_of_packet );
+            ttl   = MIN( ttl, record.ttl );
+        }
+    }
+
+    if ( alias == NULL || query->alias_count >= DNS_RESOLVER_MAXIMUM_ALIASES )
+    {
+        /* The name exists but has no IPv4 address */
+        if ( alias != NULL )
+        {
+            free( alias );
+        }
+        dns_resolver_complete( query, WICED_ERROR, NULL, 0 );
+        return;
+    }
+
+    /* Restart the lookup for the alias. A new ID stops late answers for the old name being mistaken for it */
+    if ( query->alias != NULL )
+    {
+        free( query->alias );
+    }
+    query->alias         = alias;
+    query->alias_count++;
+    query->ttl           = ttl;
+    query->id            = dns_client_new_id( );
+    query->transmissions = 0;
+    dns_resolver_send_query( query, current_time );
+}
+
+/*
+ * Frees an asynchronous lookup, caches the result and calls the callback
+ * A NULL address with a non-zero TTL caches the name as not existing
+ * Must be called with the DNS client mutex held. The mutex is released during the callback so it can start new lookups
+ */
+static void dns_resolver_complete( dns_query_t* query, wiced_result_t result, const wiced_ip_address_t* address, uint32_t ttl )
+{
+    dns_client_lookup_callback_t callback = query->callback;
+    void*                        arg      = query->arg;
+    char*                        hostname = query->hostname;
+    wiced_ip_address_t           missing  = { WICED_INVALID_IP };
+
+    if ( query->alias != NULL )
+    {
+        free( query->alias );
+    }
+    memset( query, 0, sizeof( *query ) );
+
+    wiced_rtos_unlock_mutex( &dns_client_mutex );
+
+    dns_cache_store( hostname, ( address != NULL ) ? address : &missing, ttl );
+    callback( arg, hostname, result, address );
+    free( hostname );
+
+    wiced_rtos_lock_mutex( &dns_client_mutex );
+}
+
+/*
+ * Picks the server to query: the fastest one which is not backing off, preferring a different
+ * server to the one which just failed to answer. Returns DNS_NO_SERVER if there are no servers
+ */
+static uint8_t dns_resolver_choose_server( wiced_time_t current_time, uint8_t previous_server )
+{
+    uint8_t  best_server = DNS_NO_SERVER;
+    uint32_t best_cost   = 0;
+    uint8_t  a;
+
+    for ( a = 0; a < dns_server_address_count; a++ )
+    {
+        dns_server_state_t* state = &dns_server_state[a];
+        uint32_t            cost  = state->smoothed_rtt;
+
+        if ( a == previous_server )
+        {
+            cost += DNS_RESOLVER_MAXIMUM_RETRANSMIT;
+        }
+
+        if ( (int32_t) ( state->backoff_until - current_time ) > 0 )
+        {
+            cost += DNS_RESOLVER_MAXIMUM_BACKOFF_TIME + ( state->backoff_until - current_time );
+        }
+
+        if ( best_server == DNS_NO_SERVER || cost < best_cost )
+        {
+            best_server = a;
+            best_cost   = cost;
+        }
+    }
+
+    /* Let the estimates of the servers passed over drift down, so one which was slow is tried again in time */
+    for ( a = 0; a < dns_server_address_count; a++ )
+    {
+        if ( a != best_server )
+        {
+            dns_server_state[a].smoothed_rtt -= dns_server_state[a].smoothed_rtt >> 5;
+        }
+    }
+
+    return best_server;
+}
+
+/*
+ * Records that a server did not answer in time. It is avoided for a while, for longer each time it misses again
+ */
+static void dns_resolver_server_missed( uint8_t server, uint32_t waited, wiced_time_t current_time )
+{
+    dns_server_state_t* state = &dns_server_state[server];
+
+    if ( server >= dns_server_address_count )
+    {
+        return;
+    }
+
+    if ( state->misses < 16 )
+    {
+        state->misses++;
+    }
+
+    /* Its round trip is at least as long as the wait. Answers to retransmissions are not timed, so
+     * without this a server which has become slower would keep its old estimate and be chosen again */
+    if ( waited > state->smoothed_rtt )
+    {
+        state->smoothed_rtt = ( 7 * state->smoothed_rtt + waited ) / 8;
+    }
+    state->backoff_until = current_time + MIN( (uint32_t) DNS_RESOLVER_BACKOFF_TIME << ( state->misses - 1 ), DNS_RESOLVER_MAXIMUM_BACKOFF_TIME );
+}
+
+/*
+ * Returns an unpredictable transaction ID from the WLAN random number generator
+ */
+static uint16_t dns_client_new_id( void )
+{
+    uint16_t id;
+
+    if ( wiced_wifi_get_random( &id ) != WICED_SUCCESS )
+    {
+        id = dns_resolver_next_id++;
+    }
+    return id;
+}
+
+/*
+ * Returns the index of the configured server with the given address, or DNS_NO_SERVER
+ */
+static uint8_t dns_client_find_server( const wiced_ip_address_t* address )
+{
+    uint8_t a;
+
+    for ( a = 0; a < dns_server_address_count; a++ )
+    {
+        wiced_ip_address_t* server_address = &dns_server_address_array[a];
+
+        if ( address->version == server_address->version &&
+             ( ( address->version == WICED_IPV4 && address->ip.v4 == server_address->ip.v4 ) ||
+               ( address->version == WICED_IPV6 && memcmp( address->ip.v6, server_address->ip.v6, sizeof( address->ip.v6 ) ) == 0 ) ) )
+        {
+            return a;
+        }
+    }
+    return DNS_NO_SERVER;
+}
+
+/*
+ * Checks that a response came from the DNS port of a configured server and that its single question
+ * is for the given name (or other_name, if not NULL). The ID has to be checked by the caller.
+ * On success the iterator is left after the question section
+ */
+static wiced_bool_t dns_client_response_is_valid( wiced_packet_t* packet, dns_message_iterator_t* iter, const uint8_t* end, const char* name, const char* other_name )
+{
+    wiced_ip_address_t source;
+    uint16_t           source_port;
+    dns_question_t     question;
+    dns_name_t         question_name;
+
+    wiced_udp_packet_get_info( packet, &source, &source_port );
+    if ( source_port != DNS_PORT || dns_client_find_server( &source ) == DNS_NO_SERVER )
+    {
+        return WICED_FALSE;
+    }
+
+    if ( htobe16( iter->header->question_count ) != 1 )
+    {
+        return WICED_FALSE;
+    }
+
+    iter->iter = (uint8_t*) ( iter->header ) + sizeof(dns_message_header_t);
+    dns_get_next_question( iter, &question, &question_name );
+    if ( iter->iter > end || question.class != RR_CLASS_IN )
+    {
+        return WICED_FALSE;
+    }
+
+    if ( dns_compare_name_to_string( &question_name, name ) == WICED_TRUE )
+    {
+        return WICED_TRUE;
+    }
+    return ( other_name != NULL ) ? dns_compare_name_to_string( &question_name, other_name ) : WICED_FALSE;
+}
+
 /*********************************
  * DNS packet creation functions
  *********************************/
@@ -167,6 +167,15 @@ typedef struct
 
 #pragma pack()
 
+typedef struct
+{
+    uint32_t hits;   /* Lookups answered from the cache, including names cached as not existing */
+    uint32_t misses; /* Lookups that had to query a DNS server */
+} dns_cache_statistics_t;
+
+/* Called when an asynchronous lookup finishes. address is NULL unless result is WICED_SUCCESS */
+typedef void (*dns_client_lookup_callback_t)( void* arg, const char* hostname, wiced_result_t result, const wiced_ip_address_t* address );
+
 /**************************************************************************************************************
  * VARIABLES
  **************************************************************************************************************/
@@ -179,6 +188,9 @@ typedef struct
 wiced_result_t dns_client_add_server_address( wiced_ip_address_t address );
 wiced_result_t dns_client_remove_all_server_addresses( void );
 wiced_result_t dns_client_hostname_lookup( const char* hostname, wiced_ip_address_t* address, uint32_t timeout_ms );
+wiced_result_t dns_client_hostname_lookup_async( const char* hostname, uint32_t timeout_ms, dns_client_lookup_callback_t callback, void* arg );
+wiced_result_t dns_client_flush_cache( void );
+wiced_result_t dns_client_get_cache_statistics( dns_cache_statistics_t* statistics );
 
 /* Functions to generate a custom DNS query */
 void     dns_write_question(dns_message_iterator_t* iter, const char* target, uint16_t class, uint16_t type);
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  AT command lookup against the linear scan it replaced
+ *
+ *  The command table, WXS2w_FindCommand() and WXS2w_Process() are cut out
+ *  of wx_s2w_process.c by the Makefile. Every table entry is looked up with
+ *  and without arguments, with '=' and '?' suffixes, in other letter cases
+ *  and with characters appended, and then random input built from pieces
+ *  of command names is looked up.
+ *
+ *  Fails if the hash lookup picks a different entry from the linear scan,
+ *  or if a handler is not given the text after its table name. The time
+ *  of each lookup is reported for both.
+ *
+ *  Usage: at_command_test [random_inputs [seed]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include "s2w_host.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define NOT_FOUND           (0xFFFFFFFF)
+#define MAX_INPUT_LENGTH    (64)
+#define TIMING_ROUNDS       (20000)
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+extern const struct WX_COMMAND g_WXCmdTable[];
+
+static const char* handler_ptr;
+static unsigned    checked;
+static unsigned    mismatches;
+static unsigned    bad_arguments;
+
+/******************************************************
+ *               Rest of the application
+ ******************************************************/
+
+UINT8 host_command( const char* name, UINT8* ptr )
+{
+    (void) name;
+    handler_ptr = (const char*) ptr;
+    return WXCODE_SUCCESS;
+}
+
+VOID WXS2w_StatusNotify( UINT8 status, UINT32 arg )
+{
+    (void) status;
+    (void) arg;
+}
+
+/******************************************************
+ *               Test
+ ******************************************************/
+
+/* The lookup WXS2w_Process() made before the hash index */
+static UINT32 linear_find( const char* input )
+{
+    UINT32 i;
+
+    for ( i = 0; g_WXCmdTable[ i ].cmd != NULL; i++ )
+    {
+        if ( !WXParse_StrnCaseCmp( input, g_WXCmdTable[ i ].cmd, strlen( g_WXCmdTable[ i ].cmd ) ) )
+        {
+            return i;
+        }
+    }
+    return NOT_FOUND;
+}
+
+static void check( const char* input )
+{
+    UINT8  command[ MAX_INPUT_LENGTH + 3 ];
+    UINT32 expected = linear_find( input );
+    UINT32 found    = WXS2w_FindCommand( (UINT8*) input );
+
+    checked++;
+    if ( found != expected )
+    {
+        if ( mismatches++ < 10 )
+        {
+            printf( "\"%s\": hash lookup gives entry %d, linear scan %d\n", input, (int) found, (int) expected );
+        }
+        return;
+    }
+
+    /* Through WXS2w_Process(), a stub handler sees the text after the table name */
+    snprintf( (char*) command, sizeof( command ), "AT%s", input );
+    handler_ptr = NULL;
+    WXS2w_Process( command );
+    if ( ( expected != NOT_FOUND ) &&
+         ( ( handler_ptr == NULL ) || ( strcmp( handler_ptr, input + strlen( g_WXCmdTable[ expected ].cmd ) ) != 0 ) ) )
+    {
+        if ( bad_arguments++ < 10 )
+        {
+            printf( "\"%s\": handler not given \"%s\"\n", input, input + strlen( g_WXCmdTable[ expected ].cmd ) );
+        }
+    }
+}
+
+static void check_variants( const char* cmd )
+{
+    static const char* suffixes[] = { "", "=", "?", "=?", "=1", "=0,TCP,192.168.1.1,5000", "X", "1", " " };
+    char     name[ MAX_INPUT_LENGTH ];
+    char     input[ MAX_INPUT_LENGTH ];
+    size_t   length;
+    unsigned s;
+    size_t   i;
+
+    snprintf( name, sizeof( name ), "%s", cmd );
+    length = strlen( name );
+    if ( ( length > 0 ) && ( ( name[ length - 1 ] == '=' ) || ( name[ length - 1 ] == '?' ) ) )
+    {
+        name[ --length ] = '\0';
+    }
+
+    for ( s = 0; s < sizeof( suffixes ) / sizeof( suffixes[ 0 ] ); s++ )
+    {
+        snprintf( input, sizeof( input ), "%s%s", name, suffixes[ s ] );
+        check( input );
+        for ( i = 0; input[ i ] != '\0'; i++ )
+        {
+            input[ i ] = (char) tolower( (unsigned char) input[ i ] );
+        }
+        check( input );
+        for ( i = 0; input[ i ] != '\0'; i += 2 )
+        {
+            input[ i ] = (char) toupper( (unsigned char) input[ i ] );
+        }
+        check( input );
+    }
+
+    /* Every shorter prefix of the name */
+    for ( i = 0; i < length; i++ )
+    {
+        snprintf( input, sizeof( input ), "%.*s", (int) i, name );
+        check( input );
+    }
+}
+
+/* Pieces of command names joined with random characters */
+static void check_random( unsigned count )
+{
+    static const char alphabet[] = "+=?,0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    unsigned entries;
+    unsigned n;
+
+    for ( entries = 0; g_WXCmdTable[ entries ].cmd != NULL; entries++ )
+    {
+    }
+    for ( n = 0; n < count; n++ )
+    {
+        char   input[ MAX_INPUT_LENGTH ];
+        size_t length = 0;
+
+        while ( ( length < 24 ) && ( rand( ) % 4 != 0 ) )
+        {
+            if ( rand( ) % 2 == 0 )
+            {
+                const char* cmd  = g_WXCmdTable[ rand( ) % entries ].cmd;
+                size_t      take = 1 + rand( ) % strlen( cmd );
+
+                take = MIN( take, sizeof( input ) - 1 - length );
+                memcpy( input + length, cmd, take );
+                length += take;
+            }
+            else
+            {
+                input[ length++ ] = alphabet[ rand( ) % ( sizeof( alphabet ) - 1 ) ];
+            }
+        }
+        input[ length ] = '\0';
+        check( input );
+    }
+}
+
+static double now_ns( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+/* Mean time of one lookup of each command, given an argument if it takes one, and of the slowest */
+static void time_lookups( void )
+{
+    volatile UINT32 sink = 0;
+    double          linear_total = 0, hash_total = 0, linear_worst = 0, hash_worst = 0;
+    unsigned        entries;
+    unsigned        round;
+
+    for ( entries = 0; g_WXCmdTable[ entries ].cmd != NULL; entries++ )
+    {
+        char   input[ MAX_INPUT_LENGTH ];
+        double start, linear_ns, hash_ns;
+
+        const char* cmd = g_WXCmdTable[ entries ].cmd;
+
+        snprintf( input, sizeof( input ), "%s%s", cmd, ( cmd[ strlen( cmd ) - 1 ] == '=' ) ? "1" : "" );
+
+        start = now_ns( );
+        for ( round = 0; round < TIMING_ROUNDS; round++ )
+        {
+            sink += linear_find( input );
+        }
+        linear_ns = ( now_ns( ) - start ) / TIMING_ROUNDS;
+
+        start = now_ns( );
+        for ( round = 0; round < TIMING_ROUNDS; round++ )
+        {
+            sink += WXS2w_FindCommand( (UINT8*) input );
+        }
+        hash_ns = ( now_ns( ) - start ) / TIMING_ROUNDS;
+
+        linear_total += linear_ns;
+        hash_total   += hash_ns;
+        linear_worst  = ( linear_ns > linear_worst ) ? linear_ns : linear_worst;
+        hash_worst    = ( hash_ns > hash_worst ) ? hash_ns : hash_worst;
+    }
+    (void) sink;
+    printf( "lookup of each of %u commands on this host: linear scan %.0f ns mean, %.0f ns worst; hash %.0f ns mean, %.0f ns worst\n",
+            entries, linear_total / entries, linear_worst, hash_total / entries, hash_worst );
+}
+
+int main( int argc, char** argv )
+{
+    unsigned random_inputs = ( argc > 1 ) ? (unsigned) atoi( argv[ 1 ] ) : 100000;
+    int      seed          = ( argc > 2 ) ? atoi( argv[ 2 ] ) : 1;
+    unsigned i;
+
+    srand( seed );
+    WXS2w_BuildCommandIndex( );
+
+    for ( i = 0; g_WXCmdTable[ i ].cmd != NULL; i++ )
+    {
+        check_variants( g_WXCmdTable[ i ].cmd );
+    }
+    check( "" );
+    check( "+" );
+    check( "+NOSUCHCOMMAND" );
+    check_random( random_inputs );
+
+    printf( "%u inputs looked up: %u differ from the linear scan, %u handlers given the wrong arguments\n",
+            checked, mismatches, bad_arguments );
+    time_lookups( );
+
+    printf( ( mismatches != 0 || bad_arguments != 0 ) ? "FAIL\n" : "PASS\n" );
+    return ( mismatches != 0 || bad_arguments != 0 );
+}
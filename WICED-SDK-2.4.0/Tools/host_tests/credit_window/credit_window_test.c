@@ -0,0 +1,748 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  WWD thread send path against a simulated WLAN and its bus credits
+ *
+ *  The WICED thread of wwd_thread.c and SDPCM.c run unchanged on a virtual
+ *  clock, which the RTOS model advances whenever the thread waits on its
+ *  semaphore and the bus model advances by the time of each transfer. An
+ *  application sends bursty TCP traffic: bursts of full size segments with
+ *  random gaps between them. The WLAN model holds a few frames for the air,
+ *  gives the host a bus credit as each one goes out, and tells the host in
+ *  a credit update frame. It returns TCP acks, which carry credits too.
+ *  Some of its interrupts are lost, and until the host reads the interrupt
+ *  status no new frame raises another; a poke raises a missed one again.
+ *
+ *  Fails if the host sends outside the credit window, if a frame is lost,
+ *  reordered or sent twice, if the WLAN's frame queue overflows, if a frame
+ *  is never sent, if a buffer leaks, or if the thread sits out of credits for longer than
+ *  WICED_THREAD_CREDIT_WAIT_MAX_MS after the WLAN has granted more. The
+ *  throughput, the time the air sits idle with frames waiting in the host,
+ *  and the latency from send to the bus are reported.
+ *
+ *  Built twice: as wwd_thread.c is, and with a fixed 100 ms credit wait,
+ *  which is expected to fail.
+ *
+ *  Usage: credit_window_test [seconds [lost_interrupt_one_in [seed]]]
+ */
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "internal/SDPCM.h"
+#include "wwd_rtos.h"
+#include "wwd_buffer.h"
+#include "internal/wwd_internal.h"
+#include "internal/wwd_thread.h"
+#include "RTOS/wwd_rtos_interface.h"
+#include "Network/wwd_buffer_interface.h"
+#include "Network/wwd_network_interface.h"
+#include "Network/wwd_network_constants.h"
+#include "Platform/wwd_bus_interface.h"
+#include "internal/Bus_protocols/wwd_bus_protocol_interface.h"
+#include "chip_constants.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+/* As in wwd_thread.c */
+#ifndef WICED_THREAD_CREDIT_WAIT_MIN_MS
+#define WICED_THREAD_CREDIT_WAIT_MIN_MS  (2)
+#endif
+#ifndef WICED_THREAD_CREDIT_WAIT_MAX_MS
+#define WICED_THREAD_CREDIT_WAIT_MAX_MS  (100)
+#endif
+
+/* As in SDPCM.c */
+#define SDPCM_HEADER_LENGTH     (12)
+#define BDC_HEADER_LENGTH       (4)
+#define CHANNEL_CONTROL         (0)
+#define CHANNEL_DATA            (2)
+
+#define NS_PER_US               (1000ULL)
+#define NS_PER_MS               (1000000ULL)
+#define NEVER                   (~0ULL)
+
+/* Traffic: bursts of TCP segments, as a window opening */
+#define SEGMENT_LENGTH          (1514)
+#define SEGMENT_ID_OFFSET       (54)        /* First byte of the TCP payload */
+#define BURST_MIN_SEGMENTS      (2)
+#define BURST_MAX_SEGMENTS      (44)
+#define BURST_GAP_MEAN_NS       (3 * NS_PER_MS)   /* Idle time after the air time of a burst */
+#define ACK_LENGTH              (60)
+#define SEGMENTS_PER_ACK        (2)
+#define ACK_DELAY_NS            (2 * NS_PER_MS)
+#define MAX_ACKS_IN_FLIGHT      (1024)
+
+/* WLAN: frames it holds for the air, and air time of a frame */
+#define WLAN_TX_SLOTS           (7)         /* A credit update may move by at most CHIP_MAX_BUS_DATA_CREDIT_DIFF */
+#define AIR_NS_PER_BYTE         (333)       /* 24 Mbit/s */
+#define AIR_NS_PER_FRAME        (120 * NS_PER_US)
+#define SEGMENT_AIR_NS          ( AIR_NS_PER_FRAME + SEGMENT_LENGTH * AIR_NS_PER_BYTE )
+#define TO_HOST_FIFO_FRAMES     (256)
+
+/* SDIO: 4 bit at 25 MHz */
+#define BUS_NS_PER_COMMAND      (15 * NS_PER_US)
+#define BUS_NS_PER_BYTE         (80)
+#define BUS_NS_PER_REGISTER     (10 * NS_PER_US)
+#define BUS_WAKE_NS             (300 * NS_PER_US)
+#define IRQ_LATENCY_NS          (20 * NS_PER_US)
+#define FRAME_READ_TRANSACTIONS (2)     /* wiced_read_frame() reads the frametag, then the rest of the frame */
+
+#define STALL_LIMIT_NS          ( ( WICED_THREAD_CREDIT_WAIT_MAX_MS + 1 ) * NS_PER_MS )
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+struct NX_PACKET_STRUCT
+{
+    uint8_t* data;
+    uint16_t size;
+    uint16_t capacity;
+    uint8_t  storage[ 1 ];
+};
+
+typedef struct
+{
+    uint64_t queued_ns;
+    uint64_t on_bus_ns;
+    int      sent;
+} segment_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+/* Defined next to SDPCM.c on the target */
+wiced_bool_t        monitor_mode_enabled = WICED_FALSE;
+wiced_wlan_status_t wiced_wlan_status;
+
+static jmp_buf  simulation_end;
+static void     (*thread_function)( uint32_t arg );
+static uint64_t now_ns;
+static uint64_t end_of_traffic_ns;
+static unsigned lost_interrupt_one_in;
+static long     buffers_outstanding;
+static unsigned errors;
+
+/* Traffic */
+static segment_t* segments;
+static unsigned   segment_capacity;
+static unsigned   segments_queued;
+static unsigned   segments_on_bus;
+static uint64_t   next_burst_ns;
+
+/* WLAN */
+static uint8_t  wlan_credit;            /* Sequence number the host may not yet send */
+static uint8_t  wlan_expected_sequence;
+static unsigned wlan_slots[ WLAN_TX_SLOTS ];
+static unsigned wlan_slot_head;
+static unsigned wlan_slot_count;
+static uint64_t air_done_ns = NEVER;
+static uint64_t air_busy_ns;
+static uint64_t acks_due_ns[ MAX_ACKS_IN_FLIGHT ];
+static unsigned ack_head;
+static unsigned ack_count;
+static int      to_host_fifo[ TO_HOST_FIFO_FRAMES ];    /* Lengths; 0 for a credit update */
+static unsigned to_host_head;
+static unsigned to_host_count;
+static int      credit_update_queued;
+static uint8_t  to_host_sequence;
+static int      interrupt_status;       /* Set until the host reads it; no new interrupt meanwhile */
+static uint64_t irq_due_ns = NEVER;
+static int      bus_asleep = 1;
+
+/* Measurements */
+static unsigned interrupts_lost;
+static unsigned credit_updates;
+static unsigned window_violations;
+static unsigned order_errors;
+static unsigned slot_overflows;
+static uint64_t stall_ns;
+static uint64_t stall_started_ns = NEVER;
+static uint64_t longest_stall_ns;
+static uint64_t idle_air_with_work_ns;
+static uint64_t frames_on_air;
+
+/******************************************************
+ *               Buffer and RTOS models
+ ******************************************************/
+
+static wiced_buffer_t new_buffer( uint16_t headroom, uint16_t size )
+{
+    wiced_buffer_t buffer = malloc( sizeof( struct NX_PACKET_STRUCT ) + headroom + size );
+
+    buffer->data     = buffer->storage + headroom;
+    buffer->size     = size;
+    buffer->capacity = (uint16_t) ( headroom + size );
+    buffers_outstanding++;
+    return buffer;
+}
+
+wiced_result_t host_buffer_get( wiced_buffer_t* buffer, wiced_buffer_dir_t direction, unsigned short size, wiced_bool_t wait )
+{
+    (void) direction;
+    (void) wait;
+    *buffer = new_buffer( 0, size );
+    return WICED_SUCCESS;
+}
+
+void host_buffer_release( wiced_buffer_t buffer, wiced_buffer_dir_t direction )
+{
+    (void) direction;
+    free( buffer );
+    buffers_outstanding--;
+}
+
+uint8_t* host_buffer_get_current_piece_data_pointer( wiced_buffer_t buffer )
+{
+    return buffer->data;
+}
+
+uint16_t host_buffer_get_current_piece_size( wiced_buffer_t buffer )
+{
+    return buffer->size;
+}
+
+wiced_result_t host_buffer_add_remove_at_front( wiced_buffer_t* buffer, int32_t add_remove_amount )
+{
+    wiced_buffer_t b = *buffer;
+
+    if ( ( b->data + add_remove_amount < b->storage ) || ( add_remove_amount > (int32_t) b->size ) )
+    {
+        return WICED_ERROR;
+    }
+    b->data += add_remove_amount;
+    b->size  = (uint16_t) ( b->size - add_remove_amount );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_buffer_set_data_end( wiced_buffer_t buffer, uint8_t* end_of_data )
+{
+    buffer->size = (uint16_t) ( end_of_data - buffer->data );
+    return WICED_SUCCESS;
+}
+
+static void run_events_until( uint64_t time_ns );
+static uint64_t next_event_ns( void );
+
+wiced_result_t host_rtos_init_semaphore( host_semaphore_type_t* semaphore )
+{
+    semaphore->tx_semaphore_count = 0;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_rtos_deinit_semaphore( host_semaphore_type_t* semaphore )
+{
+    (void) semaphore;
+    return WICED_SUCCESS;
+}
+
+/* Only the WICED thread waits, so while it does the rest of the world runs */
+wiced_result_t host_rtos_get_semaphore( host_semaphore_type_t* semaphore, uint32_t timeout_ms, wiced_bool_t will_set_in_isr )
+{
+    uint64_t deadline_ns = ( timeout_ms == NEVER_TIMEOUT ) ? NEVER : now_ns + timeout_ms * NS_PER_MS;
+
+    (void) will_set_in_isr;
+    while ( semaphore->tx_semaphore_count == 0 )
+    {
+        uint64_t next_ns = next_event_ns( );
+
+        if ( ( next_ns == NEVER ) && ( deadline_ns == NEVER ) )
+        {
+            longjmp( simulation_end, 1 );
+        }
+        if ( now_ns > end_of_traffic_ns + 10000 * NS_PER_MS )
+        {
+            /* Frames still queued ten seconds after the traffic stopped */
+            longjmp( simulation_end, 1 );
+        }
+        if ( next_ns > deadline_ns )
+        {
+            run_events_until( deadline_ns );
+            return WICED_TIMEOUT;
+        }
+        run_events_until( next_ns );
+    }
+    semaphore->tx_semaphore_count--;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_rtos_set_semaphore( host_semaphore_type_t* semaphore, wiced_bool_t called_from_ISR )
+{
+    (void) called_from_ISR;
+    semaphore->tx_semaphore_count++;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_rtos_create_thread( host_thread_type_t* thread, void(*entry_function)( uint32_t arg ), const char* name, void* stack, uint32_t stack_size, uint32_t priority )
+{
+    (void) thread;
+    (void) name;
+    (void) stack;
+    (void) stack_size;
+    (void) priority;
+    thread_function = entry_function;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_rtos_finish_thread( host_thread_type_t* thread )
+{
+    (void) thread;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_rtos_delete_terminated_thread( host_thread_type_t* thread )
+{
+    (void) thread;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_rtos_delay_milliseconds( uint32_t num_ms )
+{
+    run_events_until( now_ns + num_ms * NS_PER_MS );
+    return WICED_SUCCESS;
+}
+
+wiced_bool_t wiced_wifi_is_packet_from_ap( uint8_t flags2 )
+{
+    (void) flags2;
+    return WICED_FALSE;
+}
+
+/* The network stack end of the receive path */
+void host_network_process_ethernet_data( wiced_buffer_t buffer, wiced_interface_t interface )
+{
+    (void) interface;
+    if ( buffer->size != ACK_LENGTH )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "ack of %u bytes reached the network stack\n", buffer->size );
+        }
+    }
+    host_buffer_release( buffer, WICED_NETWORK_RX );
+}
+
+/******************************************************
+ *               WLAN model
+ ******************************************************/
+
+static void send_interrupt( void )
+{
+    interrupt_status = 1;
+    if ( irq_due_ns != NEVER )
+    {
+        return;
+    }
+    if ( ( lost_interrupt_one_in != 0 ) && ( rand( ) % lost_interrupt_one_in == 0 ) )
+    {
+        interrupts_lost++;
+        return;
+    }
+    irq_due_ns = now_ns + IRQ_LATENCY_NS;
+}
+
+static void raise_interrupt( void )
+{
+    if ( !interrupt_status )
+    {
+        send_interrupt( );
+    }
+}
+
+static void queue_to_host( int length )
+{
+    if ( to_host_count == TO_HOST_FIFO_FRAMES )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "WLAN to host FIFO overflowed\n" );
+        }
+        return;
+    }
+    to_host_fifo[ ( to_host_head + to_host_count++ ) % TO_HOST_FIFO_FRAMES ] = length;
+    raise_interrupt( );
+}
+
+static void start_air( void )
+{
+    if ( ( air_done_ns == NEVER ) && ( wlan_slot_count != 0 ) )
+    {
+        air_done_ns = now_ns + SEGMENT_AIR_NS;
+    }
+}
+
+static void air_done( void )
+{
+    wlan_slot_head = ( wlan_slot_head + 1 ) % WLAN_TX_SLOTS;
+    wlan_slot_count--;
+    air_done_ns = NEVER;
+    frames_on_air++;
+    if ( frames_on_air % SEGMENTS_PER_ACK == 0 )
+    {
+        acks_due_ns[ ( ack_head + ack_count++ ) % MAX_ACKS_IN_FLIGHT ] = now_ns + ACK_DELAY_NS;
+    }
+
+    /* The slot is free: one more credit, told in an update frame unless one is already waiting */
+    wlan_credit++;
+    if ( !credit_update_queued )
+    {
+        credit_update_queued = 1;
+        queue_to_host( 0 );
+    }
+    start_air( );
+}
+
+static void send_burst( void )
+{
+    unsigned count = BURST_MIN_SEGMENTS + (unsigned) rand( ) % ( BURST_MAX_SEGMENTS - BURST_MIN_SEGMENTS + 1 );
+    unsigned i;
+
+    for ( i = 0; i < count; i++ )
+    {
+        wiced_buffer_t buffer;
+
+        if ( segments_queued == segment_capacity )
+        {
+            segment_capacity = segment_capacity * 2 + 1024;
+            segments         = realloc( segments, segment_capacity * sizeof( segment_t ) );
+        }
+        segments[ segments_queued ].queued_ns = now_ns;
+        segments[ segments_queued ].sent      = 0;
+
+        buffer = new_buffer( WICED_LINK_OVERHEAD_BELOW_ETHERNET_FRAME, SEGMENT_LENGTH );
+        memset( buffer->data, 0, SEGMENT_LENGTH );
+        memcpy( buffer->data + SEGMENT_ID_OFFSET, &segments_queued, sizeof( segments_queued ) );
+        segments_queued++;
+        wiced_network_send_ethernet_data( buffer, WICED_STA_INTERFACE );
+    }
+
+    next_burst_ns = now_ns + count * SEGMENT_AIR_NS + (uint64_t) ( -log( ( rand( ) + 1.0 ) / ( RAND_MAX + 2.0 ) ) * BURST_GAP_MEAN_NS );
+    if ( next_burst_ns >= end_of_traffic_ns )
+    {
+        next_burst_ns = NEVER;
+    }
+}
+
+static uint64_t next_event_ns( void )
+{
+    uint64_t next = next_burst_ns;
+
+    next = ( air_done_ns < next ) ? air_done_ns : next;
+    next = ( irq_due_ns < next ) ? irq_due_ns : next;
+    if ( ( ack_count != 0 ) && ( acks_due_ns[ ack_head ] < next ) )
+    {
+        next = acks_due_ns[ ack_head ];
+    }
+    return next;
+}
+
+/* Moves the clock, accounting for credit stalls and idle air as it goes */
+static void advance_clock( uint64_t time_ns )
+{
+    unsigned waiting  = segments_queued - segments_on_bus;
+    int      stalled  = ( waiting != 0 ) && ( wiced_get_available_bus_credits( ) == 0 ) && ( wlan_credit != wlan_expected_sequence );
+
+    if ( time_ns <= now_ns )
+    {
+        return;
+    }
+    if ( stalled )
+    {
+        stall_ns += time_ns - now_ns;
+    }
+    if ( ( waiting != 0 ) && ( wlan_slot_count == 0 ) )
+    {
+        idle_air_with_work_ns += time_ns - now_ns;
+    }
+    if ( wlan_slot_count != 0 )
+    {
+        air_busy_ns += time_ns - now_ns;
+    }
+    now_ns = time_ns;
+}
+
+static void note_stall( void )
+{
+    int stalled = ( segments_queued != segments_on_bus ) && ( wiced_get_available_bus_credits( ) == 0 ) && ( wlan_credit != wlan_expected_sequence );
+
+    if ( stalled && ( stall_started_ns == NEVER ) )
+    {
+        stall_started_ns = now_ns;
+    }
+    else if ( !stalled && ( stall_started_ns != NEVER ) )
+    {
+        if ( now_ns - stall_started_ns > longest_stall_ns )
+        {
+            longest_stall_ns = now_ns - stall_started_ns;
+        }
+        stall_started_ns = NEVER;
+    }
+}
+
+static void run_events_until( uint64_t time_ns )
+{
+    uint64_t next;
+
+    while ( ( next = next_event_ns( ) ) <= time_ns )
+    {
+        advance_clock( next );
+        if ( next == irq_due_ns )
+        {
+            irq_due_ns = NEVER;
+            wiced_platform_notify_irq( );
+        }
+        else if ( next == air_done_ns )
+        {
+            air_done( );
+        }
+        else if ( next == next_burst_ns )
+        {
+            send_burst( );
+        }
+        else
+        {
+            ack_head = ( ack_head + 1 ) % MAX_ACKS_IN_FLIGHT;
+            ack_count--;
+            queue_to_host( ACK_LENGTH );
+        }
+        note_stall( );
+    }
+    advance_clock( time_ns );
+    note_stall( );
+}
+
+/* Time on the bus; whatever happens meanwhile happens first */
+static void bus_busy( uint64_t duration_ns )
+{
+    if ( bus_asleep )
+    {
+        bus_asleep   = 0;
+        duration_ns += BUS_WAKE_NS;
+    }
+    run_events_until( now_ns + duration_ns );
+}
+
+/******************************************************
+ *               Bus model
+ ******************************************************/
+
+wiced_result_t wiced_bus_ensure_wlan_bus_is_up( void )
+{
+    bus_busy( 0 );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_bus_allow_wlan_bus_to_sleep( void )
+{
+    bus_asleep = 1;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_bus_poke_wlan( void )
+{
+    bus_busy( BUS_NS_PER_REGISTER );
+    if ( to_host_count != 0 )
+    {
+        send_interrupt( );
+    }
+    return WICED_SUCCESS;
+}
+
+uint32_t wiced_bus_process_interrupt( void )
+{
+    bus_busy( BUS_NS_PER_REGISTER );
+    interrupt_status = 0;
+    return ( to_host_count != 0 ) ? FRAME_AVAILABLE_MASK : 0;
+}
+
+wiced_result_t wiced_bus_set_flow_control( uint8_t value )
+{
+    (void) value;
+    return WICED_SUCCESS;
+}
+
+wiced_bool_t wiced_bus_is_flow_controlled( void )
+{
+    return WICED_FALSE;
+}
+
+/* A frame from the WLAN, carrying the credit as it stands when read */
+wiced_result_t wiced_read_frame( wiced_buffer_t* buffer )
+{
+    int      length;
+    uint16_t size;
+    uint16_t inverse;
+    uint8_t* frame;
+
+    if ( to_host_count == 0 )
+    {
+        bus_busy( BUS_NS_PER_REGISTER );
+        return WICED_ERROR;
+    }
+    length       = to_host_fifo[ to_host_head ];
+    to_host_head = ( to_host_head + 1 ) % TO_HOST_FIFO_FRAMES;
+    to_host_count--;
+    if ( length == 0 )
+    {
+        credit_update_queued = 0;
+        credit_updates++;
+    }
+
+    size    = (uint16_t) ( ( length == 0 ) ? SDPCM_HEADER_LENGTH : SDPCM_HEADER_LENGTH + BDC_HEADER_LENGTH + length );
+    inverse = (uint16_t) ~size;
+    bus_busy( FRAME_READ_TRANSACTIONS * BUS_NS_PER_COMMAND + size * BUS_NS_PER_BYTE );
+
+    *buffer = new_buffer( 0, (uint16_t) ( sizeof( wiced_buffer_header_t ) + size ) );
+    frame   = ( *buffer )->data + sizeof( wiced_buffer_header_t );
+    memset( frame, 0, size );
+    memcpy( frame, &size, 2 );
+    memcpy( frame + 2, &inverse, 2 );
+    frame[ 4 ] = to_host_sequence++;
+    frame[ 5 ] = ( length == 0 ) ? CHANNEL_CONTROL : CHANNEL_DATA;
+    frame[ 7 ] = SDPCM_HEADER_LENGTH;
+    frame[ 9 ] = wlan_credit;
+    return WICED_SUCCESS;
+}
+
+/* Only frames go to the WLAN in this simulation */
+wiced_result_t wiced_bus_transfer_buffer( bus_transfer_direction_t direction, bus_function_t function, uint32_t address, wiced_buffer_t buffer )
+{
+    const uint8_t* frame = buffer->data + sizeof( wiced_buffer_t );
+    uint16_t       size;
+    uint8_t        sequence;
+    unsigned       id;
+
+    (void) direction;
+    (void) function;
+    (void) address;
+    memcpy( &size, frame, 2 );
+    sequence = frame[ 4 ];
+    memcpy( &id, buffer->data + WICED_LINK_OVERHEAD_BELOW_ETHERNET_FRAME + SEGMENT_ID_OFFSET, sizeof( id ) );
+
+    /* The credit is the first sequence number the host may not send */
+    if ( (uint8_t) ( wlan_credit - sequence ) == 0 || (uint8_t) ( wlan_credit - sequence ) > WLAN_TX_SLOTS )
+    {
+        if ( window_violations++ < 10 )
+        {
+            printf( "frame %u sent with sequence %u, credit %u\n", id, sequence, wlan_credit );
+        }
+    }
+    if ( ( sequence != wlan_expected_sequence ) || ( id != segments_on_bus ) || ( id >= segments_queued ) || segments[ id ].sent ||
+         ( frame[ 5 ] != CHANNEL_DATA ) || ( buffer->size - sizeof( wiced_buffer_t ) != size ) )
+    {
+        if ( order_errors++ < 10 )
+        {
+            printf( "frame %u sent with sequence %u, frame %u with sequence %u expected\n", id, sequence, segments_on_bus, wlan_expected_sequence );
+        }
+        return WICED_ERROR;
+    }
+
+    bus_busy( BUS_NS_PER_COMMAND + size * BUS_NS_PER_BYTE );
+    wlan_expected_sequence++;
+    segments[ id ].sent      = 1;
+    segments[ id ].on_bus_ns = now_ns;
+    segments_on_bus++;
+
+    if ( wlan_slot_count == WLAN_TX_SLOTS )
+    {
+        if ( slot_overflows++ < 10 )
+        {
+            printf( "frame %u sent while the WLAN holds %u frames\n", id, wlan_slot_count );
+        }
+        return WICED_SUCCESS;
+    }
+    wlan_slots[ ( wlan_slot_head + wlan_slot_count++ ) % WLAN_TX_SLOTS ] = id;
+    start_air( );
+    return WICED_SUCCESS;
+}
+
+/******************************************************
+ *               Test
+ ******************************************************/
+
+static int compare_u64( const void* a, const void* b )
+{
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+
+    return ( x > y ) - ( x < y );
+}
+
+int main( int argc, char** argv )
+{
+    unsigned  seconds = ( argc > 1 ) ? (unsigned) atoi( argv[ 1 ] ) : 20;
+    int       seed    = ( argc > 3 ) ? atoi( argv[ 3 ] ) : 1;
+    uint64_t* latency;
+    uint64_t  finished_ns;
+    unsigned  unsent = 0;
+    unsigned  i;
+    int       failed;
+
+    lost_interrupt_one_in = ( argc > 2 ) ? (unsigned) atoi( argv[ 2 ] ) : 20;
+    srand( seed );
+    end_of_traffic_ns = seconds * 1000 * NS_PER_MS;
+
+    if ( wiced_thread_init( ) != WICED_SUCCESS )
+    {
+        printf( "wiced_thread_init failed\nFAIL\n" );
+        return 1;
+    }
+
+    /* The WLAN comes up with a window of credits to announce */
+    wlan_credit   = WLAN_TX_SLOTS;
+    next_burst_ns = 0;
+    credit_update_queued = 1;
+    queue_to_host( 0 );
+
+    if ( setjmp( simulation_end ) == 0 )
+    {
+        thread_function( 0 );
+    }
+    finished_ns = now_ns;
+    note_stall( );
+
+    latency = malloc( ( segments_on_bus + 1 ) * sizeof( uint64_t ) );
+    for ( i = 0; i < segments_queued; i++ )
+    {
+        if ( !segments[ i ].sent )
+        {
+            unsent++;
+            continue;
+        }
+        latency[ i ] = segments[ i ].on_bus_ns - segments[ i ].queued_ns;
+    }
+    qsort( latency, segments_on_bus, sizeof( uint64_t ), compare_u64 );
+
+    printf( "credit wait %u..%u ms, 1 in %u interrupts lost: %u segments in %.1f s, %u credit updates, %u interrupts lost\n",
+            WICED_THREAD_CREDIT_WAIT_MIN_MS, WICED_THREAD_CREDIT_WAIT_MAX_MS, lost_interrupt_one_in,
+            segments_queued, finished_ns / 1e9, credit_updates, interrupts_lost );
+    printf( "throughput %.2f Mbit/s; air busy %.1f%%; air idle with frames waiting in the host %.1f%% of the time\n",
+            frames_on_air * SEGMENT_LENGTH * 8.0 / ( finished_ns / 1e3 ), 100.0 * air_busy_ns / finished_ns, 100.0 * idle_air_with_work_ns / finished_ns );
+    if ( segments_on_bus != 0 )
+    {
+        printf( "send to bus latency: median %.2f ms, 99%% %.2f ms, 99.9%% %.2f ms, max %.2f ms\n",
+                latency[ segments_on_bus / 2 ] / 1e6, latency[ segments_on_bus * 99 / 100 ] / 1e6,
+                latency[ segments_on_bus * 999 / 1000 ] / 1e6, latency[ segments_on_bus - 1 ] / 1e6 );
+    }
+    printf( "out of credits with credits granted: %.1f ms in all, %.2f ms at the longest\n", stall_ns / 1e6, longest_stall_ns / 1e6 );
+    printf( "%u sent outside the credit window, %u out of order, %u WLAN queue overflows, %u never sent, %ld buffers leaked, %u other errors\n",
+            window_violations, order_errors, slot_overflows, unsent, buffers_outstanding, errors );
+    free( latency );
+    free( segments );
+
+    failed = ( window_violations != 0 ) || ( order_errors != 0 ) || ( slot_overflows != 0 ) || ( unsent != 0 ) || ( buffers_outstanding != 0 ) || ( errors != 0 ) ||
+             ( longest_stall_ns > STALL_LIMIT_NS );
+    printf( failed ? "FAIL\n" : "PASS\n" );
+    return failed;
+}
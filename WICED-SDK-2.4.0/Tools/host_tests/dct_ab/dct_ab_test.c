@@ -0,0 +1,335 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  DCT A/B copy writes, before and after skipping unchanged data
+ *
+ *  platform_get_dct(), platform_write_dct(), the bootloader's DCT write
+ *  calls and the wiced_dct_* calls run against the two DCT sectors mapped
+ *  at their STM32F2xx addresses. The Makefile cuts them out of their files.
+ *
+ *  A workload of profile changes, each followed by a reboot, is run with the
+ *  previous save path (app section, then Wi-Fi config, then the Wi-Fi config
+ *  again at boot, every write a full copy) and with the current one (only
+ *  changed sections, both together in one copy). Then the power is cut at
+ *  every step of a combined write.
+ *
+ *  Fails if the sections read back differ from the last save, or if a power
+ *  cut leaves one section old and the other new.
+ *
+ *  Usage: dct_ab_test [changes [seed]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <sys/mman.h>
+#include "wiced_utilities.h"
+#include "wiced_dct.h"
+#include "platform_dct.h"
+#include "platform_bootloader.h"
+#include "bootloader_app.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+/* Set by Wiced.mk in a target build */
+#define BOOTLOADER_MAGIC_NUMBER  (0x4d435242)
+
+#define DCT_SECTOR_SIZE     (0x4000)
+#define DCT1_START_ADDR     (0x08008000)
+#define DCT2_START_ADDR     (0x0800C000)
+#define DCT1_SIZE           (DCT_SECTOR_SIZE)
+#define FLASH_Sector_2      ((uint16_t)0x0010)
+#define FLASH_Sector_3      ((uint16_t)0x0018)
+
+#define PLATFORM_DCT_COPY1_START_SECTOR      ( FLASH_Sector_2  )
+#define PLATFORM_DCT_COPY1_START_ADDRESS     ( DCT1_START_ADDR )
+#define PLATFORM_DCT_COPY1_END_SECTOR        ( FLASH_Sector_2 )
+#define PLATFORM_DCT_COPY1_END_ADDRESS       ( DCT1_START_ADDR + DCT1_SIZE )
+#define PLATFORM_DCT_COPY2_START_SECTOR      ( FLASH_Sector_3  )
+#define PLATFORM_DCT_COPY2_START_ADDRESS     ( DCT2_START_ADDR )
+#define PLATFORM_DCT_COPY2_END_SECTOR        ( FLASH_Sector_3 )
+#define PLATFORM_DCT_COPY2_END_ADDRESS       ( DCT1_START_ADDR + DCT1_SIZE )
+
+#define ERASE_DCT_1()              platform_erase_flash(PLATFORM_DCT_COPY1_START_SECTOR, PLATFORM_DCT_COPY1_END_SECTOR)
+#define ERASE_DCT_2()              platform_erase_flash(PLATFORM_DCT_COPY2_START_SECTOR, PLATFORM_DCT_COPY2_END_SECTOR)
+
+/* STM32F2xx 16 KB sector erase and 32-bit word program, typical */
+#define ERASE_TIME_US       (250000)
+#define WORD_TIME_US        (16)
+
+/* Size of the WizFi250 profile in the app section */
+#define APP_SIZE            (1052)
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static uint8_t* flash;
+static uint32_t erases;
+static uint64_t busy_us;
+static long     steps_left = -1;   /* Flash steps before the power is cut, -1 for never */
+static jmp_buf  power_cut;
+
+static int (*dct_writer)( uint16_t data_start_offset, const void* data, uint16_t data_length, int8_t app_valid, void (*func)(void) );
+
+/******************************************************
+ *               Flash in RAM
+ ******************************************************/
+
+static void step( void )
+{
+    if ( steps_left >= 0 && steps_left-- == 0 )
+    {
+        longjmp( power_cut, 1 );
+    }
+}
+
+int platform_erase_flash( uint16_t start_sector, uint16_t end_sector )
+{
+    uint8_t* sector = flash + ( ( start_sector == FLASH_Sector_2 ) ? 0 : DCT_SECTOR_SIZE );
+
+    (void) end_sector;
+    if ( steps_left == 0 )
+    {
+        /* Cut part way through the erase */
+        memset( sector, 0xFF, rand( ) % DCT_SECTOR_SIZE );
+    }
+    step( );
+    memset( sector, 0xFF, DCT_SECTOR_SIZE );
+    erases++;
+    busy_us += ERASE_TIME_US;
+    return 0;
+}
+
+int platform_write_flash_chunk( uint32_t address, const uint8_t* data, uint32_t size )
+{
+    uint8_t* target = flash + ( address - DCT1_START_ADDR );
+    uint32_t i;
+
+    for ( i = 0; i < size; i++ )
+    {
+        step( );
+        target[ i ] &= data[ i ];
+    }
+    busy_us += WORD_TIME_US * ( ( size + 3 ) / 4 );
+    return 0;
+}
+
+/******************************************************
+ *               Code under test
+ ******************************************************/
+
+/* The app's bootloader_api is the table the bootloader places at a fixed address */
+static const bootloader_api_t test_bootloader_api;
+
+#undef  bootloader_api
+#define bootloader_api (&test_bootloader_api)
+
+#include "dct_ab_functions.c"
+
+static const bootloader_api_t test_bootloader_api =
+{
+    .write_app_config_dct  = write_app_config_dct,
+    .write_wifi_config_dct = write_wifi_config_dct,
+    .get_app_config_dct    = get_app_config_dct,
+    .get_wifi_config_dct   = get_wifi_config_dct,
+};
+
+/* The save paths of wx_commands_m.c around those calls */
+static void previous_save( const platform_dct_wifi_config_t* wifi, const uint8_t* app )
+{
+    dct_writer = previous_platform_write_dct;
+    wiced_dct_write_app_section( app, APP_SIZE );
+    wiced_dct_write_wifi_config_section( wifi );
+}
+
+static void previous_boot( void )
+{
+    platform_dct_wifi_config_t wifi;
+
+    dct_writer = previous_platform_write_dct;
+    memcpy( &wifi, wiced_dct_get_wifi_config_section( ), sizeof( wifi ) );
+    wiced_dct_write_wifi_config_section( &wifi );
+}
+
+static void current_save( const platform_dct_wifi_config_t* wifi, const uint8_t* app )
+{
+    int profile_saved = ( memcmp( wiced_dct_get_app_section( ), app, APP_SIZE ) == 0 );
+    int wifi_saved    = ( memcmp( wiced_dct_get_wifi_config_section( ), wifi, sizeof( *wifi ) ) == 0 );
+
+    dct_writer = platform_write_dct;
+    if ( profile_saved && wifi_saved )
+    {
+        return;
+    }
+    if ( wifi_saved )
+    {
+        wiced_dct_write_app_section( app, APP_SIZE );
+    }
+    else if ( profile_saved )
+    {
+        wiced_dct_write_wifi_config_section( wifi );
+    }
+    else
+    {
+        wiced_dct_write_wifi_config_and_app_section( wifi, app, APP_SIZE );
+    }
+}
+
+static void current_boot( void )
+{
+    platform_dct_wifi_config_t wifi;
+    uint8_t                    app[ APP_SIZE ];
+
+    memcpy( &wifi, wiced_dct_get_wifi_config_section( ), sizeof( wifi ) );
+    memcpy( app, wiced_dct_get_app_section( ), APP_SIZE );
+    current_save( &wifi, app );
+}
+
+/******************************************************
+ *               Test
+ ******************************************************/
+
+static void format_flash( void )
+{
+    memset( flash, 0xFF, 2 * DCT_SECTOR_SIZE );
+    steps_left = -1;
+    platform_get_dct( );
+    erases  = 0;
+    busy_us = 0;
+}
+
+static int sections_are( const platform_dct_wifi_config_t* wifi, const uint8_t* app )
+{
+    return ( memcmp( wiced_dct_get_wifi_config_section( ), wifi, sizeof( *wifi ) ) == 0 ) &&
+           ( memcmp( wiced_dct_get_app_section( ), app, APP_SIZE ) == 0 );
+}
+
+/* Returns the number of times the sections read back differ from the last save */
+static int run_workload( int changes, int current )
+{
+    platform_dct_wifi_config_t wifi;
+    uint8_t                    app[ APP_SIZE ];
+    int                        errors = 0;
+    int                        i;
+
+    format_flash( );
+    memcpy( &wifi, wiced_dct_get_wifi_config_section( ), sizeof( wifi ) );
+    memcpy( app, wiced_dct_get_app_section( ), APP_SIZE );
+
+    for ( i = 0; i < changes; i++ )
+    {
+        int kind = rand( ) % 10;
+
+        if ( kind < 5 )
+        {
+            /* An option only in the profile, e.g. a socket or timer setting */
+            app[ 100 + rand( ) % ( APP_SIZE - 100 ) ] = (uint8_t) rand( );
+        }
+        else if ( kind < 9 )
+        {
+            /* SSID or key: in the profile and in the Wi-Fi config */
+            app[ rand( ) % 100 ] = (uint8_t) rand( );
+            ( (uint8_t*) &wifi )[ rand( ) % sizeof( wifi ) ] = (uint8_t) rand( );
+        }
+        /* Otherwise a command saves the profile unchanged */
+
+        if ( current )
+        {
+            current_save( &wifi, app );
+            current_boot( );
+        }
+        else
+        {
+            previous_save( &wifi, app );
+            previous_boot( );
+        }
+        errors += !sections_are( &wifi, app );
+    }
+    return errors;
+}
+
+/* Returns the number of cuts after which one section is old and the other new */
+static int run_power_cuts( long* cuts )
+{
+    platform_dct_wifi_config_t old_wifi, new_wifi;
+    uint8_t                    old_app[ APP_SIZE ], new_app[ APP_SIZE ];
+    long                       cut;
+    int                        mixed = 0;
+    size_t                     i;
+
+    for ( cut = 0; ; cut++ )
+    {
+        format_flash( );
+        memcpy( &old_wifi, wiced_dct_get_wifi_config_section( ), sizeof( old_wifi ) );
+        memcpy( old_app, wiced_dct_get_app_section( ), APP_SIZE );
+        for ( i = 0; i < sizeof( new_wifi ); i++ )
+        {
+            ( (uint8_t*) &new_wifi )[ i ] = (uint8_t) rand( );
+        }
+        for ( i = 0; i < APP_SIZE; i++ )
+        {
+            new_app[ i ] = (uint8_t) rand( );
+        }
+
+        steps_left = cut;
+        if ( setjmp( power_cut ) == 0 )
+        {
+            current_save( &new_wifi, new_app );
+            steps_left = -1;
+            break;
+        }
+        steps_left = -1;
+
+        if ( !sections_are( &old_wifi, old_app ) && !sections_are( &new_wifi, new_app ) )
+        {
+            mixed++;
+        }
+    }
+    *cuts = cut;
+    return mixed;
+}
+
+int main( int argc, char** argv )
+{
+    int      changes = ( argc > 1 ) ? atoi( argv[ 1 ] ) : 1000;
+    int      seed    = ( argc > 2 ) ? atoi( argv[ 2 ] ) : 1;
+    int      errors;
+    int      mixed;
+    long     cuts;
+    uint32_t previous_erases;
+    uint64_t previous_busy_us;
+
+    flash = mmap( (void*) DCT1_START_ADDR, 2 * DCT_SECTOR_SIZE, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0 );
+    if ( flash != (uint8_t*) DCT1_START_ADDR )
+    {
+        printf( "FAIL: cannot map the DCT at 0x%08X\n", DCT1_START_ADDR );
+        return 1;
+    }
+
+    srand( seed );
+    errors = run_workload( changes, 0 );
+    previous_erases  = erases;
+    previous_busy_us = busy_us;
+    srand( seed );
+    errors += run_workload( changes, 1 );
+    printf( "%d changes with a reboot after each: erases %u before, %u after; flash busy %.1f s before, %.1f s after\n",
+            changes, previous_erases, erases, previous_busy_us / 1e6, busy_us / 1e6 );
+
+    mixed = run_power_cuts( &cuts );
+    printf( "power cut at each of %ld steps of a combined write: %d left the sections mixed\n", cuts, mixed );
+    printf( "sections read back wrong %d times\n", errors );
+
+    printf( ( errors != 0 || mixed != 0 ) ? "FAIL\n" : "PASS\n" );
+    return ( errors != 0 || mixed != 0 );
+}
@@ -0,0 +1,870 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  DHCP server lease table under a storm of clients
+ *
+ *  dhcp_server.c is included here so its lease table can be checked. Its
+ *  thread runs on the test's thread: each wiced_udp_receive() checks the
+ *  reply to the previous request, moves a simulated clock on by up to 20 s
+ *  and hands over the next request, from one of a few hundred clients
+ *  sharing a pool of DHCP_SERVER_MAXIMUM_LEASES addresses. The clock starts
+ *  an hour before wiced_time_t wraps. The Makefile builds the test with the
+ *  default 32 leases, and with one for every address of the /24.
+ *
+ *  Clients DISCOVER, REQUEST what they were offered, take another server's
+ *  offer, renew, RELEASE, DECLINE, leave without a word, and come back
+ *  asking for their old address (INIT-REBOOT) or one outside the subnet.
+ *  The test keeps its own record of every address it was told a client
+ *  holds, and for how long.
+ *
+ *  Fails if an address is ACKed or offered while another client holds it,
+ *  if a client is given a second address, if a declined address comes back
+ *  within ten minutes, if a client holding or just offered an address is
+ *  refused it, if the server stays silent with addresses free, or if the
+ *  lease bitmap or hash chains disagree with the leases.
+ *
+ *  Usage: dhcp_storm_test [rounds [clients [seed]]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "wiced.h"
+#include "dhcp_server.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define SERVER_ADDRESS          (0xC0A80001)        /* 192.168.0.1 */
+#define OTHER_SERVER_ADDRESS    (0xC0A80002)
+#define NETMASK                 (0xFFFFFF00)
+#define OUTSIDE_ADDRESS         (0x0A000005)        /* 10.0.0.5 */
+
+#define MAXIMUM_CLIENTS         (1000)
+#define ROUND_TIME_MS           (20 * 1000)         /* Most time between requests */
+#define START_BEFORE_WRAP_MS    (60 * 60 * 1000)
+
+/* As dhcp_server.c, in milliseconds */
+#define LEASE_TIME_MS           (24 * 60 * 60 * 1000ull)
+#define OFFER_HOLD_TIME_MS      (60 * 1000ull)
+#define DECLINE_HOLD_TIME_MS    (10 * 60 * 1000ull)
+
+#define NO_CLIENT               (-1)
+#define PACKET_CAPACITY         (1500)
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+typedef enum
+{
+    CLIENT_INIT,
+    CLIENT_SELECTING,   /* Offered an address */
+    CLIENT_BOUND,
+} client_state_t;
+
+typedef enum
+{
+    SENT_DISCOVER,
+    SENT_SELECTING,     /* REQUEST for an offer of this server */
+    SENT_OTHER_SERVER,  /* REQUEST for another server's offer */
+    SENT_RENEW,
+    SENT_INIT_REBOOT,
+    SENT_RELEASE,
+    SENT_DECLINE,
+} sent_t;
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct
+{
+    wiced_mac_t    mac;
+    client_state_t state;
+    uint32_t       address;         /* Offered or bound, host order */
+    uint32_t       remembered;      /* Last address bound, for INIT-REBOOT */
+    uint64_t       offered_until;
+    uint64_t       bound_until;
+    uint64_t       away_until;      /* Off the network until then */
+    wiced_bool_t   returning;       /* Speaks first once back */
+} client_t;
+
+/* What the test knows of each address of the subnet */
+typedef struct
+{
+    int          holder;            /* Client with an unexpired ACK, or NO_CLIENT */
+    uint64_t     held_until;
+    int          offered_to;
+    uint64_t     offered_until;
+    wiced_bool_t offered_bound;     /* Offered to a client whose lease had not run out */
+    uint64_t     declined_until;
+} address_record_t;
+
+typedef struct
+{
+    NX_PACKET packet;
+    uint8_t   storage[ PACKET_CAPACITY ];
+} host_packet_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+static host_packet_t* storm_round( void );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static client_t            clients[ MAXIMUM_CLIENTS ];
+static address_record_t    addresses[ 256 ];
+static uint32_t            client_count = 300;
+static uint32_t            rounds       = 20000;
+static uint32_t            rounds_done;
+static uint64_t            now_ms       = ( 1ull << 32 ) - START_BEFORE_WRAP_MS;
+static uint32_t            random_state = 1;
+static unsigned            errors;
+
+static wiced_dhcp_server_t server;
+static wiced_thread_function_t server_function;
+static void*               server_arg;
+
+static host_packet_t*      reply;
+static int                 sent_client  = NO_CLIENT;
+static int                 last_offered = NO_CLIENT;
+static sent_t              sent_kind;
+static uint32_t            sent_address;
+static uint32_t            sent_xid;
+static uint32_t            packets_outstanding;
+
+/* Statistics */
+static uint32_t            sent_counts[ SENT_DECLINE + 1 ];
+static uint32_t            offers;
+static uint32_t            acks;
+static uint32_t            naks;
+static uint32_t            silent_when_full;
+static uint32_t            expired_reclaimed;
+static uint32_t            most_holders;
+static uint64_t            lookup_probes;
+static uint32_t            lookups;
+static uint32_t            longest_lookup;
+static uint32_t            longest_chain;
+static uint64_t            server_ns;
+static uint64_t            receive_returned_ns;
+
+const wiced_ip_address_t INITIALISER_IPV4_ADDRESS( wiced_ip_broadcast, 0xFFFFFFFF );
+
+/******************************************************
+ *               Code under test
+ ******************************************************/
+
+#include "dhcp_server.c"
+
+/******************************************************
+ *               Network, RTOS and clock models
+ ******************************************************/
+
+static uint64_t now_ns( void )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+static host_packet_t* packet_new( void )
+{
+    host_packet_t* packet = calloc( 1, sizeof( host_packet_t ) );
+
+    packet->packet.nx_packet_prepend_ptr = packet->storage;
+    packet->packet.nx_packet_append_ptr  = packet->storage;
+    packets_outstanding++;
+    return packet;
+}
+
+wiced_result_t wiced_packet_create_udp( wiced_udp_socket_t* socket, uint16_t content_length, wiced_packet_t** packet, uint8_t** data, uint16_t* available_space )
+{
+    UNUSED_PARAMETER( socket );
+
+    if ( content_length > PACKET_CAPACITY )
+    {
+        return WICED_ERROR;
+    }
+    *packet          = &packet_new( )->packet;
+    *data            = ( *packet )->nx_packet_prepend_ptr;
+    *available_space = PACKET_CAPACITY;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_packet_set_data_end( wiced_packet_t* packet, uint8_t* data_end )
+{
+    packet->nx_packet_append_ptr = data_end;
+    packet->nx_packet_length     = (ULONG) ( data_end - packet->nx_packet_prepend_ptr );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_packet_get_data( wiced_packet_t* packet, uint16_t offset, uint8_t** data, uint16_t* data_length, uint16_t* available_data_length )
+{
+    *data                  = packet->nx_packet_prepend_ptr + offset;
+    *data_length           = (uint16_t) ( packet->nx_packet_length - offset );
+    *available_data_length = *data_length;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_packet_delete( wiced_packet_t* packet )
+{
+    free( packet );
+    packets_outstanding--;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_udp_create_socket( wiced_udp_socket_t* socket, uint16_t port, wiced_interface_t interface )
+{
+    UNUSED_PARAMETER( socket );
+    UNUSED_PARAMETER( interface );
+    return ( port == IPPORT_DHCPS ) ? WICED_SUCCESS : WICED_ERROR;
+}
+
+wiced_result_t wiced_udp_delete_socket( wiced_udp_socket_t* socket )
+{
+    UNUSED_PARAMETER( socket );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_udp_send( wiced_udp_socket_t* socket, const wiced_ip_address_t* address, uint16_t port, wiced_packet_t* packet )
+{
+    UNUSED_PARAMETER( socket );
+
+    if ( reply != NULL || GET_IPV4_ADDRESS( *address ) != 0xFFFFFFFF || port != IPPORT_DHCPC )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "round %u: second reply, or reply to %08x port %u\n", (unsigned) rounds_done, (unsigned) GET_IPV4_ADDRESS( *address ), port );
+        }
+    }
+    if ( reply != NULL )
+    {
+        wiced_packet_delete( &reply->packet );
+    }
+    reply = (host_packet_t*) packet;
+    return WICED_SUCCESS;
+}
+
+/* Drives the storm: checks the reply to the last request and hands the server the next one */
+wiced_result_t wiced_udp_receive( wiced_udp_socket_t* socket, wiced_packet_t** packet, uint32_t timeout )
+{
+    uint64_t       start_ns = now_ns( );
+    host_packet_t* request;
+
+    UNUSED_PARAMETER( socket );
+    UNUSED_PARAMETER( timeout );
+
+    if ( receive_returned_ns != 0 )
+    {
+        server_ns += start_ns - receive_returned_ns;
+    }
+
+    request = storm_round( );
+    if ( rounds_done > rounds )
+    {
+        server.quit = WICED_TRUE;
+    }
+    receive_returned_ns = now_ns( );
+    if ( request == NULL )
+    {
+        return WICED_TIMEOUT;
+    }
+
+    *packet = &request->packet;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_ip_get_ipv4_address( wiced_interface_t interface, wiced_ip_address_t* ipv4_address )
+{
+    UNUSED_PARAMETER( interface );
+    SET_IPV4_ADDRESS( *ipv4_address, SERVER_ADDRESS );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_ip_get_netmask( wiced_interface_t interface, wiced_ip_address_t* ipv4_address )
+{
+    UNUSED_PARAMETER( interface );
+    SET_IPV4_ADDRESS( *ipv4_address, NETMASK );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_time_get_time( wiced_time_t* time )
+{
+    *time = (wiced_time_t) now_ms;
+    return WICED_SUCCESS;
+}
+
+/* The server thread is run by main() once wiced_start_dhcp_server() returns */
+wiced_result_t wiced_rtos_create_thread( wiced_thread_t* thread, uint8_t priority, const char* name, wiced_thread_function_t function, uint32_t stack_size, void* arg )
+{
+    UNUSED_PARAMETER( thread );
+    UNUSED_PARAMETER( priority );
+    UNUSED_PARAMETER( name );
+    UNUSED_PARAMETER( stack_size );
+    server_function = function;
+    server_arg      = arg;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_is_current_thread( wiced_thread_t* thread )
+{
+    UNUSED_PARAMETER( thread );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_thread_force_awake( wiced_thread_t* thread )
+{
+    UNUSED_PARAMETER( thread );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_thread_join( wiced_thread_t* thread )
+{
+    UNUSED_PARAMETER( thread );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_delete_thread( wiced_thread_t* thread )
+{
+    UNUSED_PARAMETER( thread );
+    return WICED_SUCCESS;
+}
+
+/******************************************************
+ *               Clients
+ ******************************************************/
+
+static uint32_t test_random( void )
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static void put_be32( uint8_t* out, uint32_t value )
+{
+    out[ 0 ] = (uint8_t) ( value >> 24 );
+    out[ 1 ] = (uint8_t) ( value >> 16 );
+    out[ 2 ] = (uint8_t) ( value >> 8 );
+    out[ 3 ] = (uint8_t) value;
+}
+
+static uint32_t get_be32( const uint8_t* in )
+{
+    return ( (uint32_t) in[ 0 ] << 24 ) | ( (uint32_t) in[ 1 ] << 16 ) | ( (uint32_t) in[ 2 ] << 8 ) | in[ 3 ];
+}
+
+static wiced_bool_t in_pool( uint32_t address )
+{
+    uint32_t host = address & ~NETMASK;
+
+    return ( ( address & NETMASK ) == ( SERVER_ADDRESS & NETMASK ) && host != 0 && host != 0xFF && address != SERVER_ADDRESS ) ? WICED_TRUE : WICED_FALSE;
+}
+
+/* Address held by someone other than the client, by an ACK, an offer or a DECLINE */
+static wiced_bool_t held_by_other( uint32_t address, int client, wiced_bool_t count_offers )
+{
+    address_record_t* record = &addresses[ address & 0xFF ];
+
+    if ( record->holder != NO_CLIENT && record->holder != client && record->held_until > now_ms )
+    {
+        return WICED_TRUE;
+    }
+    if ( count_offers && record->offered_to != NO_CLIENT && record->offered_to != client && record->offered_until > now_ms )
+    {
+        return WICED_TRUE;
+    }
+    return ( record->declined_until > now_ms ) ? WICED_TRUE : WICED_FALSE;
+}
+
+/* Number of pool addresses nobody else can be given */
+static uint32_t addresses_unavailable( int client )
+{
+    uint32_t count = 0;
+    uint32_t host;
+
+    for ( host = 1; host < 0xFF; host++ )
+    {
+        uint32_t address = ( SERVER_ADDRESS & NETMASK ) | host;
+
+        if ( address != SERVER_ADDRESS && held_by_other( address, client, WICED_TRUE ) )
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+static void end_binding( client_t* client )
+{
+    address_record_t* record = &addresses[ client->address & 0xFF ];
+
+    if ( record->holder == (int) ( client - clients ) )
+    {
+        record->holder = NO_CLIENT;
+    }
+    client->remembered = client->address;
+    client->state      = CLIENT_INIT;
+}
+
+/* Writes a request from a client into a packet the size of a dhcp_header_t */
+static host_packet_t* build_request( int index, uint8_t type, uint32_t client_address, uint32_t requested_address, uint32_t server_address )
+{
+    host_packet_t* packet = packet_new( );
+    dhcp_header_t* header = (dhcp_header_t*) packet->storage;
+    uint8_t*       option = header->options;
+
+    sent_xid               = test_random( );
+    header->opcode         = BOOTP_OP_REQUEST;
+    header->hardware_type  = 1;
+    header->hardware_addr_len = 6;
+    header->transaction_id = sent_xid;
+    put_be32( header->client_ip_addr, client_address );
+    memcpy( header->client_hardware_addr, &clients[ index ].mac, sizeof( wiced_mac_t ) );
+    memcpy( header->magic, dhcp_magic_cookie, sizeof( dhcp_magic_cookie ) );
+
+    *option++ = 53;
+    *option++ = 1;
+    *option++ = type;
+    if ( requested_address != 0 )
+    {
+        *option++ = 50;
+        *option++ = 4;
+        put_be32( option, requested_address );
+        option += 4;
+    }
+    if ( server_address != 0 )
+    {
+        *option++ = 54;
+        *option++ = 4;
+        put_be32( option, server_address );
+        option += 4;
+    }
+    *option++ = 0xFF;
+
+    wiced_packet_set_data_end( &packet->packet, packet->storage + sizeof( dhcp_header_t ) );
+    sent_client  = index;
+    sent_address = requested_address;
+    return packet;
+}
+
+/* Counts the hash chain entries find_lease() looks at for a client */
+static void count_lookup( const wiced_mac_t* mac )
+{
+    uint32_t probes = 0;
+    uint8_t  index;
+
+    for ( index = lease_hash[ mac_address_hash( mac ) ]; index != DHCP_NO_LEASE && probes <= DHCP_SERVER_MAXIMUM_LEASES; index = leases[ index ].next )
+    {
+        probes++;
+        if ( memcmp( &leases[ index ].client_mac_address, mac, sizeof( *mac ) ) == 0 )
+        {
+            break;
+        }
+    }
+    lookup_probes += probes;
+    lookups++;
+    longest_lookup = MAX( longest_lookup, probes );
+}
+
+/* Picks what a random client does next and writes it into a request */
+static host_packet_t* next_request( void )
+{
+    int       index;
+    client_t* client;
+    uint32_t  choice;
+
+    /* Clients mostly take up an offer straight away, and speak as soon as they are back */
+    index = ( last_offered != NO_CLIENT && test_random( ) % 100 < 70 ) ? last_offered : (int) ( test_random( ) % client_count );
+    for ( choice = 0; choice < client_count; choice++ )
+    {
+        if ( clients[ choice ].returning && clients[ choice ].away_until <= now_ms )
+        {
+            clients[ choice ].returning = WICED_FALSE;
+            index                       = (int) choice;
+            break;
+        }
+    }
+    client       = &clients[ index ];
+    choice       = test_random( ) % 100;
+    last_offered = NO_CLIENT;
+    if ( client->away_until > now_ms )
+    {
+        return NULL;
+    }
+
+    count_lookup( &client->mac );
+
+    if ( client->state == CLIENT_BOUND && client->bound_until <= now_ms )
+    {
+        end_binding( client );
+    }
+
+    switch ( client->state )
+    {
+        case CLIENT_SELECTING:
+            if ( choice < 80 )
+            {
+                sent_kind = SENT_SELECTING;
+                return build_request( index, DHCPREQUEST, 0, client->address, SERVER_ADDRESS );
+            }
+            if ( choice < 90 )
+            {
+                /* Took another server's offer. The server keeps a lease which had not run out */
+                if ( addresses[ client->address & 0xFF ].offered_to == index && addresses[ client->address & 0xFF ].offered_bound == WICED_FALSE )
+                {
+                    addresses[ client->address & 0xFF ].offered_to = NO_CLIENT;
+                }
+                client->state = CLIENT_INIT;
+                sent_kind     = SENT_OTHER_SERVER;
+                return build_request( index, DHCPREQUEST, 0, ( OTHER_SERVER_ADDRESS & NETMASK ) | 200, OTHER_SERVER_ADDRESS );
+            }
+            break;
+
+        case CLIENT_BOUND:
+            if ( choice < 60 )
+            {
+                sent_kind = SENT_RENEW;
+                return build_request( index, DHCPREQUEST, client->address, 0, 0 );
+            }
+            if ( choice < 85 )
+            {
+                /* Leaves the network politely */
+                end_binding( client );
+                client->away_until = now_ms + test_random( ) % LEASE_TIME_MS;
+                client->returning  = WICED_TRUE;
+                sent_kind = SENT_RELEASE;
+                return build_request( index, DHCPRELEASE, client->remembered, 0, SERVER_ADDRESS );
+            }
+            if ( choice < 88 )
+            {
+                end_binding( client );
+                addresses[ client->remembered & 0xFF ].declined_until = now_ms + DECLINE_HOLD_TIME_MS;
+                sent_kind = SENT_DECLINE;
+                return build_request( index, DHCPDECLINE, 0, client->remembered, SERVER_ADDRESS );
+            }
+
+            /* Leaves the network without a word, still holding the address, for up to two lease times.
+             * Some come back in the last minute of the lease */
+            client->remembered = client->address;
+            client->state      = CLIENT_INIT;
+            client->away_until = ( choice < 92 ) ? client->bound_until - test_random( ) % OFFER_HOLD_TIME_MS : now_ms + test_random( ) % ( 2 * LEASE_TIME_MS );
+            client->returning  = WICED_TRUE;
+            return NULL;
+
+        case CLIENT_INIT:
+        default:
+            if ( choice < 15 && client->remembered != 0 )
+            {
+                sent_kind = SENT_INIT_REBOOT;
+                return build_request( index, DHCPREQUEST, 0, ( choice < 2 ) ? OUTSIDE_ADDRESS : client->remembered, 0 );
+            }
+            break;
+    }
+
+    sent_kind = SENT_DISCOVER;
+    return build_request( index, DHCPDISCOVER, 0, 0, 0 );
+}
+
+/* Checks the reply, if any, to the request last sent */
+static void check_reply( void )
+{
+    client_t*         client = &clients[ sent_client ];
+    dhcp_header_t*    header;
+    uint32_t          address;
+    uint8_t           type;
+    address_record_t* record;
+    wiced_bool_t      must_ack;
+
+    if ( reply == NULL )
+    {
+        if ( sent_kind == SENT_DISCOVER )
+        {
+            if ( addresses_unavailable( sent_client ) < address_pool.size )
+            {
+                if ( errors++ < 10 )
+                {
+                    printf( "round %u: DISCOVER unanswered with %u of %u addresses held\n", (unsigned) rounds_done,
+                            (unsigned) addresses_unavailable( sent_client ), (unsigned) address_pool.size );
+                }
+            }
+            silent_when_full++;
+        }
+        else if ( sent_kind == SENT_SELECTING || sent_kind == SENT_RENEW || sent_kind == SENT_INIT_REBOOT )
+        {
+            if ( errors++ < 10 )
+            {
+                printf( "round %u: REQUEST unanswered\n", (unsigned) rounds_done );
+            }
+        }
+        return;
+    }
+
+    header  = (dhcp_header_t*) reply->storage;
+    address = get_be32( header->your_ip_addr );
+    type    = header->options[ 2 ];
+    record  = &addresses[ address & 0xFF ];
+
+    if ( header->transaction_id != sent_xid || memcmp( header->client_hardware_addr, &client->mac, sizeof( wiced_mac_t ) ) != 0 ||
+         header->opcode != BOOTP_OP_REPLY || memcmp( header->magic, dhcp_magic_cookie, sizeof( dhcp_magic_cookie ) ) != 0 )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "round %u: reply does not match its request\n", (unsigned) rounds_done );
+        }
+    }
+
+    switch ( sent_kind )
+    {
+        case SENT_DISCOVER:
+            if ( type != DHCPOFFER || in_pool( address ) == WICED_FALSE || held_by_other( address, sent_client, WICED_TRUE ) ||
+                 ( addresses[ client->remembered & 0xFF ].holder == sent_client && addresses[ client->remembered & 0xFF ].held_until > now_ms && address != client->remembered ) )
+            {
+                if ( errors++ < 10 )
+                {
+                    printf( "round %u: DISCOVER answered with type %u for %08x, held by %d\n", (unsigned) rounds_done, type, (unsigned) address, record->holder );
+                }
+                break;
+            }
+            offers++;
+            if ( record->holder != NO_CLIENT && record->holder != sent_client )
+            {
+                expired_reclaimed++;
+            }
+            record->offered_bound  = ( record->holder == sent_client && record->held_until > now_ms ) ? WICED_TRUE : WICED_FALSE;
+            record->offered_to     = sent_client;
+            record->offered_until  = now_ms + OFFER_HOLD_TIME_MS;
+            client->state          = CLIENT_SELECTING;
+            client->address        = address;
+            client->offered_until  = now_ms + OFFER_HOLD_TIME_MS;
+            last_offered           = sent_client;
+            break;
+
+        case SENT_SELECTING:
+        case SENT_RENEW:
+        case SENT_INIT_REBOOT:
+            must_ack = ( sent_kind == SENT_SELECTING && client->offered_until > now_ms ) ||
+                       ( sent_kind == SENT_RENEW ) ||
+                       ( sent_kind == SENT_INIT_REBOOT && addresses[ sent_address & 0xFF ].holder == sent_client && addresses[ sent_address & 0xFF ].held_until > now_ms && sent_address != OUTSIDE_ADDRESS );
+            if ( type == DHCPNAK )
+            {
+                naks++;
+                if ( must_ack || address != 0 )
+                {
+                    if ( errors++ < 10 )
+                    {
+                        printf( "round %u: client %d refused %08x (request %u)\n", (unsigned) rounds_done, sent_client, (unsigned) ( client->address | sent_address ), sent_kind );
+                    }
+                }
+                if ( client->state != CLIENT_BOUND )
+                {
+                    client->state = CLIENT_INIT;
+                }
+                break;
+            }
+            if ( type != DHCPACK || in_pool( address ) == WICED_FALSE || held_by_other( address, sent_client, WICED_TRUE ) ||
+                 address != ( ( sent_kind == SENT_RENEW ) ? client->address : sent_address ) )
+            {
+                if ( errors++ < 10 )
+                {
+                    printf( "round %u: client %d given %08x (type %u, request %u), held by %d\n", (unsigned) rounds_done, sent_client, (unsigned) address, type,
+                            sent_kind, record->holder );
+                }
+                break;
+            }
+            acks++;
+            if ( addresses[ client->remembered & 0xFF ].holder == sent_client && client->remembered != address && addresses[ client->remembered & 0xFF ].held_until > now_ms )
+            {
+                if ( errors++ < 10 )
+                {
+                    printf( "round %u: client %d given %08x while holding %08x\n", (unsigned) rounds_done, sent_client, (unsigned) address, (unsigned) client->remembered );
+                }
+            }
+            if ( record->holder != NO_CLIENT && record->holder != sent_client )
+            {
+                expired_reclaimed++;
+            }
+            record->holder      = sent_client;
+            record->held_until  = now_ms + LEASE_TIME_MS;
+            record->offered_to  = NO_CLIENT;
+            client->state       = CLIENT_BOUND;
+            client->address     = address;
+            client->remembered  = address;
+            client->bound_until = record->held_until;
+            break;
+
+        default:
+            if ( errors++ < 10 )
+            {
+                printf( "round %u: request %u answered\n", (unsigned) rounds_done, sent_kind );
+            }
+            break;
+    }
+}
+
+/* Checks the lease table against itself and against what clients were told */
+static void check_tables( void )
+{
+    uint32_t chained = 0;
+    uint32_t linked  = 0;
+    uint32_t holders = 0;
+    uint32_t index;
+
+    for ( index = 0; index < DHCP_LEASE_HASH_SIZE; index++ )
+    {
+        uint32_t length = 0;
+        uint8_t  lease;
+
+        for ( lease = lease_hash[ index ]; lease != DHCP_NO_LEASE && length <= DHCP_SERVER_MAXIMUM_LEASES; lease = leases[ lease ].next )
+        {
+            length++;
+            if ( lease >= address_pool.size || mac_address_hash( &leases[ lease ].client_mac_address ) != index )
+            {
+                errors++;
+            }
+        }
+        chained      += length;
+        longest_chain = MAX( longest_chain, length );
+    }
+
+    for ( index = 0; index < address_pool.size; index++ )
+    {
+        dhcp_lease_t*     lease   = &leases[ index ];
+        wiced_bool_t      in_use  = ( leases_in_use[ index / 32 ] & ( 1u << ( index % 32 ) ) ) ? WICED_TRUE : WICED_FALSE;
+        address_record_t* record  = &addresses[ lease_address( lease ) & 0xFF ];
+
+        if ( in_use != ( lease->state != DHCP_LEASE_FREE ) )
+        {
+            if ( errors++ < 10 )
+            {
+                printf( "round %u: lease %u in state %u is %s the bitmap\n", (unsigned) rounds_done, (unsigned) index, lease->state, in_use ? "in" : "not in" );
+            }
+        }
+        if ( lease->state == DHCP_LEASE_OFFERED || lease->state == DHCP_LEASE_BOUND || lease->state == DHCP_LEASE_EXPIRED )
+        {
+            linked++;
+            if ( find_lease( &lease->client_mac_address ) != lease )
+            {
+                errors++;
+            }
+        }
+        if ( record->holder != NO_CLIENT && record->held_until > now_ms )
+        {
+            holders++;
+            if ( lease->state != DHCP_LEASE_BOUND || memcmp( &lease->client_mac_address, &clients[ record->holder ].mac, sizeof( wiced_mac_t ) ) != 0 )
+            {
+                if ( errors++ < 10 )
+                {
+                    printf( "round %u: %08x is held by client %d but its lease is in state %u\n", (unsigned) rounds_done, (unsigned) lease_address( lease ),
+                            record->holder, lease->state );
+                }
+            }
+        }
+    }
+
+    if ( chained != linked )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "round %u: %u leases in hash chains, %u should be\n", (unsigned) rounds_done, (unsigned) chained, (unsigned) linked );
+        }
+    }
+    most_holders = MAX( most_holders, holders );
+}
+
+/* Checks the outcome of the last round and starts the next. Returns the request to hand the server, if any */
+static host_packet_t* storm_round( void )
+{
+    host_packet_t* request;
+
+    if ( sent_client != NO_CLIENT )
+    {
+        check_reply( );
+    }
+    check_tables( );
+    if ( reply != NULL )
+    {
+        wiced_packet_delete( &reply->packet );
+        reply = NULL;
+    }
+
+    rounds_done++;
+    if ( rounds_done > rounds )
+    {
+        return NULL;
+    }
+    now_ms     += test_random( ) % ROUND_TIME_MS;
+    sent_client = NO_CLIENT;
+    request     = next_request( );
+    if ( request != NULL )
+    {
+        sent_counts[ sent_kind ]++;
+    }
+    return request;
+}
+
+/******************************************************
+ *               Test
+ ******************************************************/
+
+int main( int argc, char* argv[ ] )
+{
+    uint32_t seed;
+    uint32_t index;
+    int      failed;
+
+    rounds       = ( argc > 1 ) ? (uint32_t) atoi( argv[ 1 ] ) : rounds;
+    client_count = ( argc > 2 ) ? (uint32_t) atoi( argv[ 2 ] ) : client_count;
+    seed         = ( argc > 3 ) ? (uint32_t) atoi( argv[ 3 ] ) : 1;
+    client_count = MAX( MIN( client_count, MAXIMUM_CLIENTS ), 1 );
+    random_state = ( seed != 0 ) ? seed : 1;
+
+    /* Stations from a handful of vendors, so the vendor octets say little */
+    for ( index = 0; index < client_count; index++ )
+    {
+        uint32_t device = test_random( );
+
+        clients[ index ].mac.octet[ 0 ] = 0x00;
+        clients[ index ].mac.octet[ 1 ] = 0x1A + (uint8_t) ( index % 4 );
+        clients[ index ].mac.octet[ 2 ] = 0x11;
+        clients[ index ].mac.octet[ 3 ] = (uint8_t) ( device >> 16 );
+        clients[ index ].mac.octet[ 4 ] = (uint8_t) ( device >> 8 );
+        clients[ index ].mac.octet[ 5 ] = (uint8_t) device;
+    }
+    for ( index = 0; index < 256; index++ )
+    {
+        addresses[ index ].holder     = NO_CLIENT;
+        addresses[ index ].offered_to = NO_CLIENT;
+    }
+
+    wiced_start_dhcp_server( &server, WICED_AP_INTERFACE );
+    server_function( (uint32_t) (uintptr_t) server_arg );
+
+    printf( "%u rounds from %u clients over %.1f hours: %u DISCOVER, %u REQUEST, %u for another server, %u renewals, %u INIT-REBOOT, %u RELEASE, %u DECLINE\n",
+            (unsigned) rounds, (unsigned) client_count, (double) ( now_ms - ( ( 1ull << 32 ) - START_BEFORE_WRAP_MS ) ) / 3600000.0,
+            (unsigned) sent_counts[ SENT_DISCOVER ], (unsigned) sent_counts[ SENT_SELECTING ], (unsigned) sent_counts[ SENT_OTHER_SERVER ],
+            (unsigned) sent_counts[ SENT_RENEW ], (unsigned) sent_counts[ SENT_INIT_REBOOT ], (unsigned) sent_counts[ SENT_RELEASE ],
+            (unsigned) sent_counts[ SENT_DECLINE ] );
+    printf( "%u offers, %u ACKs, %u NAKs, %u DISCOVERs unanswered with the pool full, %u addresses reclaimed from lapsed clients, at most %u of %u held\n",
+            (unsigned) offers, (unsigned) acks, (unsigned) naks, (unsigned) silent_when_full, (unsigned) expired_reclaimed, (unsigned) most_holders,
+            (unsigned) address_pool.size );
+    printf( "lookup cost: %.2f hash chain entries per request, at most %u; longest chain %u of %u; %.0f ns per request in the server\n",
+            (double) lookup_probes / lookups, (unsigned) longest_lookup, (unsigned) longest_chain, DHCP_LEASE_HASH_SIZE,
+            (double) server_ns / rounds );
+    printf( "%u packets left over, %u errors\n", (unsigned) packets_outstanding, errors );
+
+    failed = ( errors != 0 ) || ( packets_outstanding != 0 ) || ( acks == 0 ) || ( expired_reclaimed == 0 );
+    printf( failed ? "FAIL\n" : "PASS\n" );
+    return failed;
+}
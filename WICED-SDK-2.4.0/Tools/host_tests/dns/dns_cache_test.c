@@ -0,0 +1,409 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  DNS client cache against canned answers on a simulated clock
+ *
+ *  dns.c is built with its default cache of DNS_CACHE_SIZE (8) names and
+ *  looks names up with dns_client_hostname_lookup() through two fake
+ *  servers (dns/dns_host.c). The zone holds plain A records, a chain of
+ *  CNAMEs whose first link has the shortest TTL, a name whose address
+ *  changes, TTLs of zero and of a week, and a name longer than the cache
+ *  keeps. Each step looks a name up and says whether the answer must come
+ *  from the cache, which is told by whether a server was asked. The clock
+ *  starts 100 s before wiced_time_t wraps, so expiry times cross the wrap.
+ *
+ *  Then several threads look up more names than the cache holds at once,
+ *  with random pauses, against servers with jitter.
+ *
+ *  Fails if an address is wrong or stale, if an answer comes from the cache
+ *  when it must not or the other way round, if the hit and miss counters
+ *  disagree with the lookups made, or if a packet or socket leaks.
+ *
+ *  Usage: dns_cache_test [lookups_per_thread [seed]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "dns.h"
+#include "dns_host.h"
+#include "wiced_defaults.h"
+#include "wiced_rtos.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define LOOKUP_TIMEOUT_MS       (1000)
+#define CACHE_SIZE              (8)                 /* DNS_CACHE_SIZE, as built */
+#define NEGATIVE_TTL_S          (30)                /* DNS_CACHE_NEGATIVE_TTL */
+#define MAXIMUM_TTL_S           (24 * 60 * 60)      /* DNS_CACHE_MAXIMUM_TTL */
+
+#define SERVER_1                (0x0A000001)        /* 10.0.0.1 */
+#define SERVER_2                (0x0A000002)        /* 10.0.0.2 */
+
+#define LOOKUP_THREADS          (6)
+#define SHARED_NAMES            (20)
+
+#define IPV4( a, b, c, d )      ( ( (uint32_t) (a) << 24 ) | ( (uint32_t) (b) << 16 ) | ( (uint32_t) (c) << 8 ) | (uint32_t) (d) )
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct
+{
+    wiced_thread_t thread;
+    uint32_t       seed;
+    uint32_t       lookups;
+    uint32_t       from_cache;
+    uint64_t       total_ms;
+} lookup_thread_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static const char long_name[] = "a-name-longer-than-the-sixty-three-characters-the-cache-keeps.example.com";
+
+/* Changed between steps by the test */
+static dns_host_record_t zone[] =
+{
+    { "www.example.com",        300,           IPV4( 93, 184, 216, 34 ), NULL                   },
+    { "alias.example.com",      60,            0,                        "cdn.example.net"      },
+    { "cdn.example.net",        600,           0,                        "edge.cdn.example.net" },
+    { "edge.cdn.example.net",   120,           IPV4( 1, 2, 3, 4 ),       NULL                   },
+    { "short.example.com",      5,             IPV4( 10, 1, 1, 1 ),      NULL                   },
+    { "zero.example.com",       0,             IPV4( 10, 1, 1, 2 ),      NULL                   },
+    { "week.example.com",       7 * 86400,     IPV4( 10, 1, 1, 3 ),      NULL                   },
+    { long_name,                3600,          IPV4( 10, 1, 1, 4 ),      NULL                   },
+    { "n1.example.org",         3600,          IPV4( 10, 2, 0, 1 ),      NULL                   },
+    { "n2.example.org",         3600,          IPV4( 10, 2, 0, 2 ),      NULL                   },
+    { "n3.example.org",         3600,          IPV4( 10, 2, 0, 3 ),      NULL                   },
+    { "n4.example.org",         3600,          IPV4( 10, 2, 0, 4 ),      NULL                   },
+    { "n5.example.org",         3600,          IPV4( 10, 2, 0, 5 ),      NULL                   },
+    { "n6.example.org",         3600,          IPV4( 10, 2, 0, 6 ),      NULL                   },
+    { "n7.example.org",         3600,          IPV4( 10, 2, 0, 7 ),      NULL                   },
+    { "n8.example.org",         3600,          IPV4( 10, 2, 0, 8 ),      NULL                   },
+    { "n9.example.org",         3600,          IPV4( 10, 2, 0, 9 ),      NULL                   },
+};
+#define SHORT_RECORD            (4)
+
+static char              shared_names[ SHARED_NAMES ][ 32 ];
+static dns_host_record_t shared_zone[ SHARED_NAMES ];
+
+static unsigned        errors;
+static uint32_t        lookups_made;
+static uint32_t        lookups_from_cache;
+static lookup_thread_t lookup_threads[ LOOKUP_THREADS ];
+static uint32_t        lookup_threads_done;
+static uint32_t        lookups_per_thread;
+
+/******************************************************
+ *               Lookups
+ ******************************************************/
+
+static uint32_t server_queries( void )
+{
+    uint32_t queries = 0;
+    uint32_t i;
+
+    dns_host_lock( );
+    for ( i = 0; i < dns_host_server_count; i++ )
+    {
+        queries += dns_host_servers[ i ].queries;
+    }
+    dns_host_unlock( );
+    return queries;
+}
+
+/*
+ * Looks a name up and checks the answer. An expected address of zero means the name does not exist.
+ * The answer must come from the cache, without asking a server or taking any time, if from_cache is set.
+ */
+static void check_lookup( const char* step, const char* name, uint32_t expected_address, wiced_bool_t from_cache )
+{
+    wiced_ip_address_t address = { WICED_INVALID_IP };
+    uint32_t           queries = server_queries( );
+    uint64_t           start   = dns_host_elapsed_ms( );
+    wiced_result_t     result;
+    uint64_t           taken;
+
+    result  = dns_client_hostname_lookup( name, &address, LOOKUP_TIMEOUT_MS );
+    taken   = dns_host_elapsed_ms( ) - start;
+    queries = server_queries( ) - queries;
+
+    lookups_made++;
+    lookups_from_cache += ( from_cache == WICED_TRUE ) ? 1 : 0;
+
+    if ( ( expected_address != 0 ) ? ( ( result != WICED_SUCCESS ) || ( address.version != WICED_IPV4 ) || ( address.ip.v4 != expected_address ) )
+                                    : ( result == WICED_SUCCESS ) )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "%s: %s gave result %d, address %08x, expected %08x\n", step, name, result, (unsigned) address.ip.v4, (unsigned) expected_address );
+        }
+    }
+    if ( ( from_cache == WICED_TRUE ) ? ( ( queries != 0 ) || ( taken != 0 ) ) : ( queries == 0 ) )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "%s: %s %s from the cache, %u queries in %u ms\n", step, name, from_cache ? "not answered" : "answered",
+                    (unsigned) queries, (unsigned) taken );
+        }
+    }
+}
+
+static void add_servers( void )
+{
+    wiced_ip_address_t address;
+    uint32_t           i;
+
+    for ( i = 0; i < dns_host_server_count; i++ )
+    {
+        SET_IPV4_ADDRESS( address, dns_host_servers[ i ].address );
+        dns_client_add_server_address( address );
+    }
+}
+
+/******************************************************
+ *               Steps
+ ******************************************************/
+
+static void check_ttls( void )
+{
+    /* Hits take no time; a miss takes a round trip to the faster server */
+    check_lookup( "first lookup", "www.example.com", IPV4( 93, 184, 216, 34 ), WICED_FALSE );
+    check_lookup( "repeat", "www.example.com", IPV4( 93, 184, 216, 34 ), WICED_TRUE );
+    check_lookup( "other case", "WWW.Example.COM", IPV4( 93, 184, 216, 34 ), WICED_TRUE );
+
+    /* The chain is cached for its shortest TTL, the first CNAME's 60 s, across the wrap of the clock */
+    check_lookup( "CNAME chain", "alias.example.com", IPV4( 1, 2, 3, 4 ), WICED_FALSE );
+    dns_host_sleep( 59 * 1000 );
+    check_lookup( "CNAME chain after 59 s", "alias.example.com", IPV4( 1, 2, 3, 4 ), WICED_TRUE );
+    dns_host_sleep( 2 * 1000 );
+    check_lookup( "CNAME chain after 61 s", "alias.example.com", IPV4( 1, 2, 3, 4 ), WICED_FALSE );
+
+    /* A changed address is served until the TTL runs out, then the new one */
+    check_lookup( "short TTL", "short.example.com", IPV4( 10, 1, 1, 1 ), WICED_FALSE );
+    zone[ SHORT_RECORD ].address = IPV4( 10, 1, 1, 9 );
+    dns_host_sleep( 4 * 1000 );
+    check_lookup( "short TTL after 4 s", "short.example.com", IPV4( 10, 1, 1, 1 ), WICED_TRUE );
+    dns_host_sleep( 2 * 1000 );
+    check_lookup( "short TTL after 6 s", "short.example.com", IPV4( 10, 1, 1, 9 ), WICED_FALSE );
+
+    check_lookup( "zero TTL", "zero.example.com", IPV4( 10, 1, 1, 2 ), WICED_FALSE );
+    check_lookup( "zero TTL again", "zero.example.com", IPV4( 10, 1, 1, 2 ), WICED_FALSE );
+
+    check_lookup( "long name", long_name, IPV4( 10, 1, 1, 4 ), WICED_FALSE );
+    check_lookup( "long name again", long_name, IPV4( 10, 1, 1, 4 ), WICED_FALSE );
+
+    /* A week's TTL is held to a day */
+    dns_client_flush_cache( );
+    check_lookup( "week TTL", "week.example.com", IPV4( 10, 1, 1, 3 ), WICED_FALSE );
+    dns_host_sleep( ( MAXIMUM_TTL_S - 1 ) * 1000 );
+    check_lookup( "week TTL after a day less 1 s", "week.example.com", IPV4( 10, 1, 1, 3 ), WICED_TRUE );
+    dns_host_sleep( 2 * 1000 );
+    check_lookup( "week TTL after a day and 1 s", "week.example.com", IPV4( 10, 1, 1, 3 ), WICED_FALSE );
+}
+
+static void check_missing_names( void )
+{
+    uint64_t start = dns_host_elapsed_ms( );
+
+    /* NXDOMAIN ends the lookup without waiting out the timeout */
+    check_lookup( "missing name", "missing.example.com", 0, WICED_FALSE );
+    if ( dns_host_elapsed_ms( ) - start >= LOOKUP_TIMEOUT_MS / 2 )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "missing name: took %u ms\n", (unsigned) ( dns_host_elapsed_ms( ) - start ) );
+        }
+    }
+    check_lookup( "missing name again", "missing.example.com", 0, WICED_TRUE );
+    dns_host_sleep( ( NEGATIVE_TTL_S - 1 ) * 1000 );
+    check_lookup( "missing name after 29 s", "MISSING.example.com", 0, WICED_TRUE );
+    dns_host_sleep( 2 * 1000 );
+    check_lookup( "missing name after 31 s", "missing.example.com", 0, WICED_FALSE );
+
+    /* A failing server is not a missing name */
+    dns_host_servers[ 0 ].response_code = DNS_SERVER_FAILURE;
+    dns_host_servers[ 1 ].response_code = DNS_SERVER_FAILURE;
+    check_lookup( "server failure", "n9.example.org", 0, WICED_FALSE );
+    dns_host_servers[ 0 ].response_code = DNS_NO_ERROR;
+    dns_host_servers[ 1 ].response_code = DNS_NO_ERROR;
+    check_lookup( "after server failure", "n9.example.org", IPV4( 10, 2, 0, 9 ), WICED_FALSE );
+}
+
+static void check_eviction( void )
+{
+    char     name[ 32 ];
+    unsigned i;
+
+    /* Fill the cache, use the oldest entry again, then one more name pushes out the least recently used */
+    dns_client_flush_cache( );
+    for ( i = 1; i <= CACHE_SIZE; i++ )
+    {
+        sprintf( name, "n%u.example.org", i );
+        check_lookup( "fill", name, IPV4( 10, 2, 0, i ), WICED_FALSE );
+    }
+    check_lookup( "touch oldest", "n1.example.org", IPV4( 10, 2, 0, 1 ), WICED_TRUE );
+    check_lookup( "one more", "n9.example.org", IPV4( 10, 2, 0, 9 ), WICED_FALSE );
+    check_lookup( "touched survives", "n1.example.org", IPV4( 10, 2, 0, 1 ), WICED_TRUE );
+    for ( i = 3; i <= CACHE_SIZE + 1; i++ )
+    {
+        sprintf( name, "n%u.example.org", i );
+        check_lookup( "others survive", name, IPV4( 10, 2, 0, i ), WICED_TRUE );
+    }
+    check_lookup( "least recently used evicted", "n2.example.org", IPV4( 10, 2, 0, 2 ), WICED_FALSE );
+
+    /* Moving to other servers forgets what the old ones said */
+    check_lookup( "before new servers", "n2.example.org", IPV4( 10, 2, 0, 2 ), WICED_TRUE );
+    dns_client_remove_all_server_addresses( );
+    add_servers( );
+    check_lookup( "after new servers", "n2.example.org", IPV4( 10, 2, 0, 2 ), WICED_FALSE );
+
+    check_lookup( "before flush", "n2.example.org", IPV4( 10, 2, 0, 2 ), WICED_TRUE );
+    dns_client_flush_cache( );
+    check_lookup( "after flush", "n2.example.org", IPV4( 10, 2, 0, 2 ), WICED_FALSE );
+}
+
+/******************************************************
+ *               Threads
+ ******************************************************/
+
+static void lookup_thread_main( uint32_t arg )
+{
+    lookup_thread_t* self = &lookup_threads[ arg ];
+    uint32_t         i;
+
+    for ( i = 0; i < lookups_per_thread; i++ )
+    {
+        uint32_t           name    = (uint32_t) rand_r( &self->seed ) % SHARED_NAMES;
+        wiced_ip_address_t address = { WICED_INVALID_IP };
+        uint64_t           start   = dns_host_elapsed_ms( );
+        wiced_result_t     result;
+        uint64_t           taken;
+
+        /* Time stands still while this thread runs, so only a lookup which waited for a server takes any */
+        result = dns_client_hostname_lookup( shared_names[ name ], &address, LOOKUP_TIMEOUT_MS );
+        taken  = dns_host_elapsed_ms( ) - start;
+
+        dns_host_lock( );
+        self->lookups++;
+        self->from_cache += ( taken == 0 ) ? 1 : 0;
+        self->total_ms   += taken;
+        if ( ( result != WICED_SUCCESS ) || ( address.ip.v4 != shared_zone[ name ].address ) )
+        {
+            if ( errors++ < 10 )
+            {
+                printf( "thread %u: %s gave result %d, address %08x\n", (unsigned) arg, shared_names[ name ], result, (unsigned) address.ip.v4 );
+            }
+        }
+        dns_host_unlock( );
+
+        dns_host_sleep( (uint32_t) rand_r( &self->seed ) % 1000 );
+    }
+
+    dns_host_lock( );
+    lookup_threads_done++;
+    dns_host_unlock( );
+}
+
+static wiced_bool_t lookup_threads_finished( void* arg )
+{
+    UNUSED_PARAMETER( arg );
+    return ( lookup_threads_done == LOOKUP_THREADS ) ? WICED_TRUE : WICED_FALSE;
+}
+
+/******************************************************
+ *               Test
+ ******************************************************/
+
+int main( int argc, char* argv[ ] )
+{
+    dns_cache_statistics_t statistics;
+    dns_cache_statistics_t before_threads;
+    uint32_t               seed;
+    uint32_t               thread_lookups    = 0;
+    uint32_t               thread_from_cache = 0;
+    uint64_t               thread_ms         = 0;
+    uint64_t               start_ms;
+    unsigned               i;
+    int                    failed;
+
+    lookups_per_thread = ( argc > 1 ) ? (uint32_t) atoi( argv[ 1 ] ) : 500;
+    seed               = ( argc > 2 ) ? (uint32_t) atoi( argv[ 2 ] ) : 1;
+    dns_host_init( seed );
+
+    dns_host_servers[ 0 ].address = SERVER_1;
+    dns_host_servers[ 0 ].rtt_ms  = 20;
+    dns_host_servers[ 1 ].address = SERVER_2;
+    dns_host_servers[ 1 ].rtt_ms  = 40;
+    dns_host_server_count         = 2;
+    dns_host_zone                 = zone;
+    dns_host_zone_size            = sizeof( zone ) / sizeof( zone[ 0 ] );
+    add_servers( );
+
+    check_ttls( );
+    check_missing_names( );
+    check_eviction( );
+
+    dns_client_get_cache_statistics( &statistics );
+    printf( "%u lookups in steps, %u from the cache; counters say %u hits, %u misses\n", (unsigned) lookups_made,
+            (unsigned) lookups_from_cache, (unsigned) statistics.hits, (unsigned) statistics.misses );
+    if ( ( statistics.hits != lookups_from_cache ) || ( statistics.misses != lookups_made - lookups_from_cache ) )
+    {
+        errors++;
+    }
+
+    /* Several threads, more names than the cache holds, short TTLs and servers with jitter */
+    for ( i = 0; i < SHARED_NAMES; i++ )
+    {
+        sprintf( shared_names[ i ], "s%u.example.net", i );
+        shared_zone[ i ].name    = shared_names[ i ];
+        shared_zone[ i ].ttl     = 1 + i % 20;
+        shared_zone[ i ].address = IPV4( 10, 3, 0, i + 1 );
+    }
+    dns_host_zone                   = shared_zone;
+    dns_host_zone_size              = SHARED_NAMES;
+    dns_host_servers[ 0 ].jitter_ms = 30;
+    dns_host_servers[ 1 ].jitter_ms = 30;
+    dns_client_flush_cache( );
+    before_threads = statistics;
+    start_ms       = dns_host_elapsed_ms( );
+
+    for ( i = 0; i < LOOKUP_THREADS; i++ )
+    {
+        lookup_threads[ i ].seed = seed * 1000 + i;
+        wiced_rtos_create_thread( &lookup_threads[ i ].thread, WICED_DEFAULT_LIBRARY_PRIORITY, "lookup", lookup_thread_main, 4096, (void*) (uintptr_t) i );
+    }
+    dns_host_wait( lookup_threads_finished, NULL );
+    for ( i = 0; i < LOOKUP_THREADS; i++ )
+    {
+        wiced_rtos_thread_join( &lookup_threads[ i ].thread );
+        thread_lookups    += lookup_threads[ i ].lookups;
+        thread_from_cache += lookup_threads[ i ].from_cache;
+        thread_ms         += lookup_threads[ i ].total_ms;
+    }
+
+    dns_client_get_cache_statistics( &statistics );
+    printf( "%u threads, %u lookups over %u s: %u from the cache (%.0f%%), %.1f ms per lookup; counters say %u hits, %u misses\n",
+            LOOKUP_THREADS, (unsigned) thread_lookups, (unsigned) ( ( dns_host_elapsed_ms( ) - start_ms ) / 1000 ), (unsigned) thread_from_cache,
+            ( thread_lookups != 0 ) ? 100.0 * thread_from_cache / thread_lookups : 0.0, ( thread_lookups != 0 ) ? (double) thread_ms / thread_lookups : 0.0,
+            (unsigned) ( statistics.hits - before_threads.hits ), (unsigned) ( statistics.misses - before_threads.misses ) );
+    if ( ( statistics.hits - before_threads.hits != thread_from_cache ) || ( statistics.misses - before_threads.misses != thread_lookups - thread_from_cache ) ||
+         ( thread_lookups != LOOKUP_THREADS * lookups_per_thread ) )
+    {
+        errors++;
+    }
+
+    printf( "%u packets and %u sockets left over, %u errors\n", (unsigned) dns_host_packets_outstanding( ), (unsigned) dns_host_sockets_open( ), errors );
+    failed = ( errors != 0 ) || ( dns_host_packets_outstanding( ) != 0 ) || ( dns_host_sockets_open( ) != 0 );
+    printf( failed ? "FAIL\n" : "PASS\n" );
+    return failed;
+}
@@ -0,0 +1,825 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  Network, RTOS and clock models for the DNS client tests
+ *
+ *  See dns_host.h. Everything here runs under model_lock, the one lock of
+ *  the model. The time only moves forward when no thread is running: the
+ *  last thread to block takes the clock to the next answer or timeout and
+ *  wakes the threads that can go on.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "dns_host.h"
+#include "wiced_rtos.h"
+#include "wiced_time.h"
+#include "wiced_utilities.h"
+#include "wwd_crypto.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define DNS_PORT                (53)
+#define FIRST_EPHEMERAL_PORT    (49152)
+#define PACKET_CAPACITY         (1500)
+#define MAXIMUM_SOCKETS         (16)
+#define SOCKET_QUEUE_LENGTH     (32)
+#define MAXIMUM_DELIVERIES      (1024)
+#define MAXIMUM_WAITERS         (32)
+#define MAXIMUM_CHAIN           (16)
+#define MAXIMUM_NAME_LENGTH     (255)
+
+#define DNS_HEADER_LENGTH       (12)
+#define NO_DEADLINE             (UINT64_MAX)
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+/* A wiced_packet_t is a NetX packet; the model keeps its data and source after it */
+typedef struct
+{
+    NX_PACKET packet;
+    uint32_t  source_address;
+    uint16_t  source_port;
+    uint8_t   storage[ PACKET_CAPACITY ];
+} host_packet_t;
+
+typedef struct
+{
+    wiced_udp_socket_t* socket;     /* NULL when unused */
+    uint16_t            port;
+    host_packet_t*      queue[ SOCKET_QUEUE_LENGTH ];
+    uint32_t            queue_head;
+    uint32_t            queue_count;
+} host_socket_t;
+
+/* A packet on its way to a socket */
+typedef struct
+{
+    uint64_t        due_us;
+    uint16_t        port;
+    host_packet_t*  packet;         /* NULL when unused */
+} delivery_t;
+
+/* A thread blocked until its condition holds or its deadline passes */
+typedef struct
+{
+    wiced_bool_t (*condition)( void* arg );
+    void*        arg;
+    uint64_t     deadline_us;
+    int          ready;
+} waiter_t;
+
+typedef struct
+{
+    wiced_thread_function_t function;
+    void*                   arg;
+} thread_start_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+dns_host_server_t        dns_host_servers[ DNS_HOST_MAXIMUM_SERVERS ];
+uint32_t                 dns_host_server_count;
+const dns_host_record_t* dns_host_zone;
+uint32_t                 dns_host_zone_size;
+
+static pthread_mutex_t model_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  model_wake = PTHREAD_COND_INITIALIZER;
+static uint64_t        start_us   = ( ( 1ull << 32 ) - DNS_HOST_START_BEFORE_WRAP ) * 1000;
+static uint64_t        now_us     = ( ( 1ull << 32 ) - DNS_HOST_START_BEFORE_WRAP ) * 1000;
+static uint32_t        random_state = 1;
+static uint32_t        threads_running = 1;     /* The test's main thread */
+static waiter_t*       waiters[ MAXIMUM_WAITERS ];
+static host_socket_t   sockets[ MAXIMUM_SOCKETS ];
+static delivery_t      deliveries[ MAXIMUM_DELIVERIES ];
+static uint16_t        next_port = FIRST_EPHEMERAL_PORT;
+static uint32_t        packets_outstanding;
+static uint32_t        answers_dropped;
+
+/******************************************************
+ *               Scheduler
+ ******************************************************/
+
+static uint32_t model_random( void )
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static wiced_bool_t waiter_is_due( waiter_t* waiter )
+{
+    return ( now_us >= waiter->deadline_us ) || waiter->condition( waiter->arg );
+}
+
+/* Marks the waiters that can go on as running, so the clock stays put until they block again */
+static void wake_ready_waiters( void )
+{
+    unsigned i;
+
+    for ( i = 0; i < MAXIMUM_WAITERS; i++ )
+    {
+        if ( ( waiters[ i ] != NULL ) && !waiters[ i ]->ready && waiter_is_due( waiters[ i ] ) )
+        {
+            waiters[ i ]->ready = 1;
+            threads_running++;
+        }
+    }
+    pthread_cond_broadcast( &model_wake );
+}
+
+static void deliver( delivery_t* delivery )
+{
+    unsigned i;
+
+    for ( i = 0; i < MAXIMUM_SOCKETS; i++ )
+    {
+        host_socket_t* socket = &sockets[ i ];
+
+        if ( ( socket->socket != NULL ) && ( socket->port == delivery->port ) && ( socket->queue_count < SOCKET_QUEUE_LENGTH ) )
+        {
+            socket->queue[ ( socket->queue_head + socket->queue_count++ ) % SOCKET_QUEUE_LENGTH ] = delivery->packet;
+            delivery->packet = NULL;
+            return;
+        }
+    }
+
+    /* The socket has gone, as when a lookup has already been answered by another server */
+    answers_dropped++;
+    packets_outstanding--;
+    free( delivery->packet );
+    delivery->packet = NULL;
+}
+
+/* Takes the clock to the next delivery or deadline. Called by the last thread to block */
+static void advance_clock( void )
+{
+    uint64_t next = NO_DEADLINE;
+    unsigned i;
+
+    for ( i = 0; i < MAXIMUM_DELIVERIES; i++ )
+    {
+        if ( ( deliveries[ i ].packet != NULL ) && ( deliveries[ i ].due_us < next ) )
+        {
+            next = deliveries[ i ].due_us;
+        }
+    }
+    for ( i = 0; i < MAXIMUM_WAITERS; i++ )
+    {
+        if ( ( waiters[ i ] != NULL ) && !waiters[ i ]->ready && ( waiters[ i ]->deadline_us < next ) )
+        {
+            next = waiters[ i ]->deadline_us;
+        }
+    }
+    if ( next == NO_DEADLINE )
+    {
+        printf( "every thread is waiting for something that cannot happen\nFAIL\n" );
+        exit( 1 );
+    }
+
+    if ( next > now_us )
+    {
+        now_us = next;
+    }
+    for ( i = 0; i < MAXIMUM_DELIVERIES; i++ )
+    {
+        if ( ( deliveries[ i ].packet != NULL ) && ( deliveries[ i ].due_us <= now_us ) )
+        {
+            deliver( &deliveries[ i ] );
+        }
+    }
+    wake_ready_waiters( );
+}
+
+/* Blocks the calling thread, which holds model_lock, until condition( arg ) holds or the deadline passes */
+static void block_until( wiced_bool_t (*condition)( void* arg ), void* arg, uint64_t deadline_us )
+{
+    waiter_t waiter = { condition, arg, deadline_us, 0 };
+    unsigned slot;
+
+    if ( waiter_is_due( &waiter ) )
+    {
+        return;
+    }
+
+    for ( slot = 0; ( slot < MAXIMUM_WAITERS ) && ( waiters[ slot ] != NULL ); slot++ )
+    {
+    }
+    if ( slot == MAXIMUM_WAITERS )
+    {
+        printf( "too many threads waiting\nFAIL\n" );
+        exit( 1 );
+    }
+    waiters[ slot ] = &waiter;
+    threads_running--;
+
+    while ( !waiter.ready )
+    {
+        if ( threads_running == 0 )
+        {
+            advance_clock( );
+        }
+        else
+        {
+            pthread_cond_wait( &model_wake, &model_lock );
+        }
+    }
+    waiters[ slot ] = NULL;
+}
+
+static wiced_bool_t never( void* arg )
+{
+    UNUSED_PARAMETER( arg );
+    return WICED_FALSE;
+}
+
+void dns_host_init( uint32_t seed )
+{
+    random_state = ( seed != 0 ) ? seed : 1;
+}
+
+uint64_t dns_host_elapsed_ms( void )
+{
+    uint64_t elapsed;
+
+    pthread_mutex_lock( &model_lock );
+    elapsed = ( now_us - start_us ) / 1000;
+    pthread_mutex_unlock( &model_lock );
+    return elapsed;
+}
+
+void dns_host_sleep( uint32_t milliseconds )
+{
+    pthread_mutex_lock( &model_lock );
+    block_until( never, NULL, now_us + (uint64_t) milliseconds * 1000 );
+    pthread_mutex_unlock( &model_lock );
+}
+
+void dns_host_wait( wiced_bool_t (*condition)( void* arg ), void* arg )
+{
+    pthread_mutex_lock( &model_lock );
+    block_until( condition, arg, NO_DEADLINE );
+    pthread_mutex_unlock( &model_lock );
+}
+
+void dns_host_lock( void )
+{
+    pthread_mutex_lock( &model_lock );
+}
+
+void dns_host_unlock( void )
+{
+    wake_ready_waiters( );
+    pthread_mutex_unlock( &model_lock );
+}
+
+uint32_t dns_host_packets_outstanding( void )
+{
+    unsigned i;
+    uint32_t in_flight = 0;
+
+    pthread_mutex_lock( &model_lock );
+    for ( i = 0; i < MAXIMUM_DELIVERIES; i++ )
+    {
+        in_flight += ( deliveries[ i ].packet != NULL ) ? 1 : 0;
+    }
+    pthread_mutex_unlock( &model_lock );
+    return packets_outstanding - in_flight;
+}
+
+uint32_t dns_host_sockets_open( void )
+{
+    unsigned i;
+    uint32_t open = 0;
+
+    pthread_mutex_lock( &model_lock );
+    for ( i = 0; i < MAXIMUM_SOCKETS; i++ )
+    {
+        open += ( sockets[ i ].socket != NULL ) ? 1 : 0;
+    }
+    pthread_mutex_unlock( &model_lock );
+    return open;
+}
+
+uint32_t dns_host_answers_dropped( void )
+{
+    return answers_dropped;
+}
+
+/******************************************************
+ *               Fake DNS servers
+ ******************************************************/
+
+static host_packet_t* packet_new( void )
+{
+    host_packet_t* packet = malloc( sizeof( host_packet_t ) );
+
+    packet->packet.nx_packet_prepend_ptr = packet->storage;
+    packet->packet.nx_packet_append_ptr  = packet->storage;
+    packet->packet.nx_packet_length      = 0;
+    packets_outstanding++;
+    return packet;
+}
+
+static void schedule( host_packet_t* packet, uint16_t port, uint64_t due_us )
+{
+    unsigned i;
+
+    for ( i = 0; i < MAXIMUM_DELIVERIES; i++ )
+    {
+        if ( deliveries[ i ].packet == NULL )
+        {
+            deliveries[ i ].packet = packet;
+            deliveries[ i ].port   = port;
+            deliveries[ i ].due_us = due_us;
+            return;
+        }
+    }
+    packets_outstanding--;
+    free( packet );
+}
+
+static uint8_t* put_uint16( uint8_t* out, uint16_t value )
+{
+    out[ 0 ] = (uint8_t) ( value >> 8 );
+    out[ 1 ] = (uint8_t) value;
+    return out + 2;
+}
+
+static uint8_t* put_uint32( uint8_t* out, uint32_t value )
+{
+    return put_uint16( put_uint16( out, (uint16_t) ( value >> 16 ) ), (uint16_t) value );
+}
+
+static uint8_t* put_name( uint8_t* out, const char* name )
+{
+    while ( *name != '\0' )
+    {
+        const char* dot    = strchr( name, '.' );
+        size_t      length = ( dot != NULL ) ? (size_t) ( dot - name ) : strlen( name );
+
+        *out++ = (uint8_t) length;
+        memcpy( out, name, length );
+        out  += length;
+        name += length + ( ( dot != NULL ) ? 1 : 0 );
+    }
+    *out++ = 0;
+    return out;
+}
+
+static const dns_host_record_t* zone_find( const char* name )
+{
+    uint32_t i;
+
+    for ( i = 0; i < dns_host_zone_size; i++ )
+    {
+        if ( strcasecmp( dns_host_zone[ i ].name, name ) == 0 )
+        {
+            return &dns_host_zone[ i ];
+        }
+    }
+    return NULL;
+}
+
+/* Builds an answer. The first record's name points back at the question; the rest are written out */
+static host_packet_t* build_answer( uint16_t id, uint8_t response_code, const char* question_name, const dns_host_record_t* const* records, uint32_t record_count )
+{
+    host_packet_t* packet = packet_new( );
+    uint8_t*       out    = packet->storage;
+    uint32_t        i;
+
+    out = put_uint16( out, id );
+    out = put_uint16( out, (uint16_t) ( DNS_MESSAGE_IS_A_RESPONSE | DNS_MESSAGE_RECURSION_DESIRED | DNS_MESSAGE_RECURSION_AVAILABLE | response_code ) );
+    out = put_uint16( out, 1 );
+    out = put_uint16( out, (uint16_t) record_count );
+    out = put_uint16( out, 0 );
+    out = put_uint16( out, 0 );
+    out = put_name( out, question_name );
+    out = put_uint16( out, RR_TYPE_A );
+    out = put_uint16( out, RR_CLASS_IN );
+
+    for ( i = 0; i < record_count; i++ )
+    {
+        uint8_t* rdata_length;
+
+        if ( i == 0 )
+        {
+            out = put_uint16( out, 0xC000 | DNS_HEADER_LENGTH );
+        }
+        else
+        {
+            out = put_name( out, records[ i ]->name );
+        }
+        out = put_uint16( out, ( records[ i ]->alias != NULL ) ? RR_TYPE_CNAME : RR_TYPE_A );
+        out = put_uint16( out, RR_CLASS_IN );
+        out = put_uint32( out, records[ i ]->ttl );
+        rdata_length = out;
+        out += 2;
+        if ( records[ i ]->alias != NULL )
+        {
+            out = put_name( out, records[ i ]->alias );
+        }
+        else
+        {
+            out = put_uint32( out, records[ i ]->address );
+        }
+        put_uint16( rdata_length, (uint16_t) ( out - rdata_length - 2 ) );
+    }
+
+    packet->packet.nx_packet_length     = (ULONG) ( out - packet->storage );
+    packet->packet.nx_packet_append_ptr = out;
+    return packet;
+}
+
+/* Forged answers a spoofer sends ahead of the real one, each wrong in one way */
+static void send_forged_answers( dns_host_server_t* server, uint16_t id, const char* name, uint16_t port )
+{
+    static const dns_host_record_t forged_record = { NULL, 3600, DNS_HOST_SPOOFED_ADDRESS, NULL };
+    const dns_host_record_t*       records[ 1 ]  = { &forged_record };
+    char                           other_name[ MAXIMUM_NAME_LENGTH + 8 ];
+    uint64_t                       due_us        = now_us + (uint64_t) server->rtt_ms * 500;
+    host_packet_t*                 packet;
+
+    /* From another address */
+    packet = build_answer( id, DNS_NO_ERROR, name, records, 1 );
+    packet->source_address = server->address + 100;
+    packet->source_port    = DNS_PORT;
+    schedule( packet, port, due_us );
+
+    /* From another port of the server */
+    packet = build_answer( id, DNS_NO_ERROR, name, records, 1 );
+    packet->source_address = server->address;
+    packet->source_port    = 5353;
+    schedule( packet, port, due_us );
+
+    /* For another name */
+    snprintf( other_name, sizeof( other_name ), "forged.%s", name );
+    packet = build_answer( id, DNS_NO_ERROR, other_name, records, 1 );
+    packet->source_address = server->address;
+    packet->source_port    = DNS_PORT;
+    schedule( packet, port, due_us );
+
+    /* With a guessed ID */
+    packet = build_answer( (uint16_t) ( id + 1 ), DNS_NO_ERROR, name, records, 1 );
+    packet->source_address = server->address;
+    packet->source_port    = DNS_PORT;
+    schedule( packet, port, due_us );
+}
+
+static void server_receive( dns_host_server_t* server, const NX_PACKET* query, uint16_t port )
+{
+    const dns_host_record_t* records[ MAXIMUM_CHAIN ];
+    uint32_t                 record_count = 0;
+    char                     name[ MAXIMUM_NAME_LENGTH + 1 ];
+    uint32_t                 name_length  = 0;
+    uint32_t                 position     = DNS_HEADER_LENGTH;
+    uint8_t                  response_code;
+    uint16_t                 id;
+    uint16_t                 type;
+    const uint8_t*           data         = query->nx_packet_prepend_ptr;
+    uint32_t                 size         = query->nx_packet_length;
+    host_packet_t*           answer;
+
+    server->queries++;
+    if ( ( size < DNS_HEADER_LENGTH + 5 ) || ( ( ( data[ 4 ] << 8 ) | data[ 5 ] ) != 1 ) )
+    {
+        return;
+    }
+    id = (uint16_t) ( ( data[ 0 ] << 8 ) | data[ 1 ] );
+
+    while ( ( position < size ) && ( data[ position ] != 0 ) )
+    {
+        uint8_t label_length = data[ position++ ];
+
+        if ( ( position + label_length > size ) || ( name_length + label_length + 1 > MAXIMUM_NAME_LENGTH ) )
+        {
+            return;
+        }
+        if ( name_length != 0 )
+        {
+            name[ name_length++ ] = '.';
+        }
+        memcpy( &name[ name_length ], &data[ position ], label_length );
+        name_length += label_length;
+        position    += label_length;
+    }
+    name[ name_length ] = '\0';
+    if ( position + 5 > size )
+    {
+        return;
+    }
+    type = (uint16_t) ( ( data[ position + 1 ] << 8 ) | data[ position + 2 ] );
+
+    if ( ( model_random( ) % 100 ) < server->loss_percent )
+    {
+        return;
+    }
+
+    if ( server->spoof )
+    {
+        send_forged_answers( server, id, name, port );
+    }
+
+    /* Follow the CNAME chain through the zone */
+    response_code = server->response_code;
+    if ( ( response_code == DNS_NO_ERROR ) && ( type == RR_TYPE_A ) )
+    {
+        const dns_host_record_t* record = zone_find( name );
+
+        if ( record == NULL )
+        {
+            response_code = DNS_NAME_ERROR;
+        }
+        while ( ( record != NULL ) && ( record_count < MAXIMUM_CHAIN ) )
+        {
+            records[ record_count++ ] = record;
+            if ( ( record->alias == NULL ) || server->first_alias_only )
+            {
+                break;
+            }
+            record = zone_find( record->alias );
+        }
+    }
+
+    if ( ( model_random( ) % 100 ) < server->loss_percent )
+    {
+        return;
+    }
+
+    answer = build_answer( id, response_code, name, records, record_count );
+    answer->source_address = server->address;
+    answer->source_port    = DNS_PORT;
+    server->answers++;
+    schedule( answer, port, now_us + (uint64_t) server->rtt_ms * 1000 +
+                            ( ( server->jitter_ms != 0 ) ? model_random( ) % ( server->jitter_ms * 1000 ) : 0 ) );
+}
+
+/******************************************************
+ *               Network model
+ ******************************************************/
+
+static host_socket_t* find_socket( wiced_udp_socket_t* socket )
+{
+    unsigned i;
+
+    for ( i = 0; i < MAXIMUM_SOCKETS; i++ )
+    {
+        if ( sockets[ i ].socket == socket )
+        {
+            return &sockets[ i ];
+        }
+    }
+    return NULL;
+}
+
+static wiced_bool_t socket_has_data( void* arg )
+{
+    return ( ( (host_socket_t*) arg )->queue_count != 0 ) ? WICED_TRUE : WICED_FALSE;
+}
+
+wiced_result_t wiced_udp_create_socket( wiced_udp_socket_t* socket, uint16_t port, wiced_interface_t interface )
+{
+    host_socket_t* host_socket;
+
+    UNUSED_PARAMETER( interface );
+
+    pthread_mutex_lock( &model_lock );
+    host_socket = find_socket( NULL );
+    if ( host_socket == NULL )
+    {
+        pthread_mutex_unlock( &model_lock );
+        return WICED_ERROR;
+    }
+    memset( host_socket, 0, sizeof( *host_socket ) );
+    host_socket->socket = socket;
+    host_socket->port   = ( port != WICED_ANY_PORT ) ? port : next_port++;
+    pthread_mutex_unlock( &model_lock );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_udp_delete_socket( wiced_udp_socket_t* socket )
+{
+    host_socket_t* host_socket;
+
+    pthread_mutex_lock( &model_lock );
+    host_socket = find_socket( socket );
+    if ( host_socket != NULL )
+    {
+        while ( host_socket->queue_count != 0 )
+        {
+            free( host_socket->queue[ host_socket->queue_head ] );
+            host_socket->queue_head = ( host_socket->queue_head + 1 ) % SOCKET_QUEUE_LENGTH;
+            host_socket->queue_count--;
+            packets_outstanding--;
+        }
+        host_socket->socket = NULL;
+    }
+    pthread_mutex_unlock( &model_lock );
+    return ( host_socket != NULL ) ? WICED_SUCCESS : WICED_ERROR;
+}
+
+wiced_result_t wiced_packet_create_udp( wiced_udp_socket_t* socket, uint16_t content_length, wiced_packet_t** packet, uint8_t** data, uint16_t* available_space )
+{
+    UNUSED_PARAMETER( socket );
+
+    if ( content_length > PACKET_CAPACITY )
+    {
+        return WICED_ERROR;
+    }
+    pthread_mutex_lock( &model_lock );
+    *packet = &packet_new( )->packet;
+    pthread_mutex_unlock( &model_lock );
+    *data            = ( *packet )->nx_packet_prepend_ptr;
+    *available_space = PACKET_CAPACITY;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_packet_set_data_end( wiced_packet_t* packet, uint8_t* data_end )
+{
+    packet->nx_packet_append_ptr = data_end;
+    packet->nx_packet_length     = (ULONG) ( data_end - packet->nx_packet_prepend_ptr );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_packet_get_data( wiced_packet_t* packet, uint16_t offset, uint8_t** data, uint16_t* data_length, uint16_t* available_data_length )
+{
+    *data                  = packet->nx_packet_prepend_ptr + offset;
+    *data_length           = (uint16_t) ( packet->nx_packet_length - offset );
+    *available_data_length = *data_length;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_packet_delete( wiced_packet_t* packet )
+{
+    pthread_mutex_lock( &model_lock );
+    packets_outstanding--;
+    pthread_mutex_unlock( &model_lock );
+    free( packet );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_udp_packet_get_info( wiced_packet_t* packet, wiced_ip_address_t* address, uint16_t* port )
+{
+    SET_IPV4_ADDRESS( *address, ( (host_packet_t*) packet )->source_address );
+    *port = ( (host_packet_t*) packet )->source_port;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_udp_send( wiced_udp_socket_t* socket, const wiced_ip_address_t* address, uint16_t port, wiced_packet_t* packet )
+{
+    host_socket_t* host_socket;
+    uint32_t       i;
+
+    pthread_mutex_lock( &model_lock );
+    host_socket = find_socket( socket );
+    if ( host_socket == NULL )
+    {
+        pthread_mutex_unlock( &model_lock );
+        return WICED_ERROR;
+    }
+    for ( i = 0; i < dns_host_server_count; i++ )
+    {
+        if ( ( address->version == WICED_IPV4 ) && ( address->ip.v4 == dns_host_servers[ i ].address ) && ( port == DNS_PORT ) )
+        {
+            server_receive( &dns_host_servers[ i ], packet, host_socket->port );
+        }
+    }
+
+    /* The stack owns the packet once it is sent */
+    packets_outstanding--;
+    free( packet );
+    pthread_mutex_unlock( &model_lock );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_udp_receive( wiced_udp_socket_t* socket, wiced_packet_t** packet, uint32_t timeout )
+{
+    host_socket_t* host_socket;
+    wiced_result_t result = WICED_TIMEOUT;
+
+    pthread_mutex_lock( &model_lock );
+    host_socket = find_socket( socket );
+    if ( host_socket != NULL )
+    {
+        block_until( socket_has_data, host_socket, ( timeout == WICED_NEVER_TIMEOUT ) ? NO_DEADLINE : now_us + (uint64_t) timeout * 1000 );
+        if ( host_socket->queue_count != 0 )
+        {
+            *packet                 = &host_socket->queue[ host_socket->queue_head ]->packet;
+            host_socket->queue_head = ( host_socket->queue_head + 1 ) % SOCKET_QUEUE_LENGTH;
+            host_socket->queue_count--;
+            result                  = WICED_SUCCESS;
+        }
+    }
+    pthread_mutex_unlock( &model_lock );
+    return result;
+}
+
+wiced_result_t wiced_ip_get_ipv6_address( wiced_interface_t interface, wiced_ip_address_t* ipv6_address, wiced_ipv6_address_type_t address_type )
+{
+    UNUSED_PARAMETER( interface );
+    UNUSED_PARAMETER( ipv6_address );
+    UNUSED_PARAMETER( address_type );
+
+    /* IPv4 only, so lookups send A queries alone */
+    return WICED_ERROR;
+}
+
+wiced_result_t wiced_wifi_get_random( uint16_t* val )
+{
+    pthread_mutex_lock( &model_lock );
+    *val = (uint16_t) model_random( );
+    pthread_mutex_unlock( &model_lock );
+    return WICED_SUCCESS;
+}
+
+/******************************************************
+ *               RTOS model
+ ******************************************************/
+
+wiced_result_t wiced_time_get_time( wiced_time_t* time )
+{
+    pthread_mutex_lock( &model_lock );
+    *time = (wiced_time_t) ( now_us / 1000 );
+    pthread_mutex_unlock( &model_lock );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_init_mutex( wiced_mutex_t* mutex )
+{
+    pthread_mutex_t* host_mutex = malloc( sizeof( pthread_mutex_t ) );
+
+    pthread_mutex_init( host_mutex, NULL );
+    *(pthread_mutex_t**) mutex = host_mutex;
+    return WICED_SUCCESS;
+}
+
+/* A thread blocked here still counts as running. The DNS client never blocks in the model while holding its mutex */
+wiced_result_t wiced_rtos_lock_mutex( wiced_mutex_t* mutex )
+{
+    pthread_mutex_lock( *(pthread_mutex_t**) mutex );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_unlock_mutex( wiced_mutex_t* mutex )
+{
+    pthread_mutex_unlock( *(pthread_mutex_t**) mutex );
+    return WICED_SUCCESS;
+}
+
+static void* thread_main( void* arg )
+{
+    thread_start_t start = *(thread_start_t*) arg;
+
+    free( arg );
+    start.function( (uint32_t) (uintptr_t) start.arg );
+
+    pthread_mutex_lock( &model_lock );
+    threads_running--;
+    pthread_cond_broadcast( &model_wake );
+    pthread_mutex_unlock( &model_lock );
+    return NULL;
+}
+
+wiced_result_t wiced_rtos_create_thread( wiced_thread_t* thread, uint8_t priority, const char* name, wiced_thread_function_t function, uint32_t stack_size, void* arg )
+{
+    thread_start_t* start = malloc( sizeof( thread_start_t ) );
+
+    UNUSED_PARAMETER( priority );
+    UNUSED_PARAMETER( name );
+    UNUSED_PARAMETER( stack_size );
+
+    start->function = function;
+    start->arg      = arg;
+
+    pthread_mutex_lock( &model_lock );
+    threads_running++;
+    pthread_mutex_unlock( &model_lock );
+    pthread_create( (pthread_t*) &thread->handle, NULL, thread_main, start );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_thread_join( wiced_thread_t* thread )
+{
+    pthread_join( *(pthread_t*) &thread->handle, NULL );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_delete_thread( wiced_thread_t* thread )
+{
+    UNUSED_PARAMETER( thread );
+    return WICED_SUCCESS;
+}
@@ -0,0 +1,592 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  Asynchronous DNS resolver against fake servers which lose and forge answers
+ *
+ *  dns.c looks names up with dns_client_hostname_lookup_async(), keeping
+ *  DNS_RESOLVER_MAXIMUM_QUERIES (8) lookups outstanding, through two fake
+ *  servers (dns/dns_host.c) on a simulated clock. Each name is new, so the
+ *  cache never answers. The steps are:
+ *
+ *  - Correctness: plain names, CNAMEs the servers leave for the client to
+ *    follow, missing names and aliases to missing names, with 5% loss and
+ *    forged answers from another address, another port, for another name
+ *    and with a guessed ID ahead of every real answer. Blocking lookups
+ *    are made against the same forgeries.
+ *  - Timeouts: with both servers silent, every lookup ends with
+ *    WICED_TIMEOUT at its deadline, and a ninth lookup is refused.
+ *  - Failover: with the first server dead, lookups go to the second,
+ *    waiting on the first again only when its backoff runs out.
+ *  - Round trip tracking: the servers swap speeds, then the first recovers
+ *    while the second stays a little slower, and each time the resolver
+ *    must move to whichever is faster.
+ *  - Latency under loss on both servers, from 0% to 30% each way, against
+ *    blocking lookups of the same eight names one after another.
+ *
+ *  Fails if a lookup gives a wrong or forged address or a wrong result,
+ *  if its callback is not called exactly once, if a lookup times out early
+ *  or late, if the resolver stays with a slow or dead server, if lookups
+ *  fail with 10% loss or less, or if a packet or socket leaks.
+ *
+ *  Usage: dns_resolver_test [lookups_per_loss_rate [seed]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dns.h"
+#include "dns_host.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define MAXIMUM_QUERIES         (8)                 /* DNS_RESOLVER_MAXIMUM_QUERIES, as built */
+#define LOOKUP_TIMEOUT_MS       (5000)
+#define SILENT_TIMEOUT_MS       (2000)
+#define BACKOFF_MS              (1000)              /* DNS_RESOLVER_BACKOFF_TIME */
+
+#define SERVER_1                (0x0A000001)        /* 10.0.0.1 */
+#define SERVER_2                (0x0A000002)        /* 10.0.0.2 */
+
+#define HOST_NAMES              (6000)
+#define ALIAS_NAMES             (200)
+#define DEAD_END_NAMES          (20)
+#define HOST_ADDRESS( n )       ( 0x0A400000 + (uint32_t) (n) )
+
+#define CORRECTNESS_LOOKUPS     (400)
+#define FAILOVER_LOOKUPS        (20)
+#define TRACKING_LOOKUPS        (50)
+#define MAXIMUM_LOOKUPS         (4000)
+#define MAXIMUM_PER_LOSS_RATE   (500)
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct
+{
+    char           name[ 32 ];
+    uint32_t       expected_address;    /* Zero if the lookup must fail */
+    uint64_t       start_ms;
+    uint64_t       end_ms;
+    uint32_t       calls;
+    wiced_result_t result;
+    uint32_t       address;
+} lookup_t;
+
+typedef struct
+{
+    uint32_t loss_percent;
+    uint32_t lookups;
+    uint32_t failed;
+    uint64_t p50_ms;
+    uint64_t p95_ms;
+    uint64_t p99_ms;
+    uint64_t max_ms;
+    uint64_t async_eight_ms;
+    uint64_t blocking_eight_ms;
+    uint32_t blocking_failed;
+} loss_result_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static dns_host_record_t zone[ HOST_NAMES + ALIAS_NAMES + DEAD_END_NAMES ];
+static char              zone_names[ HOST_NAMES + ALIAS_NAMES + DEAD_END_NAMES ][ 32 ];
+static char              alias_targets[ ALIAS_NAMES ][ 32 ];
+
+static lookup_t lookups[ MAXIMUM_LOOKUPS ];
+static uint32_t lookups_started;
+static uint32_t lookups_outstanding;
+static uint32_t next_host;
+static uint32_t next_alias;
+static uint32_t next_missing;
+static uint32_t random_state = 1;
+static unsigned errors;
+static uint32_t forged_accepted;
+static uint32_t extra_callbacks;
+
+/******************************************************
+ *               Lookups
+ ******************************************************/
+
+static uint32_t test_random( void )
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static void lookup_done( void* arg, const char* hostname, wiced_result_t result, const wiced_ip_address_t* address )
+{
+    lookup_t* lookup = (lookup_t*) arg;
+    uint64_t  now_ms = dns_host_elapsed_ms( );
+
+    dns_host_lock( );
+    if ( lookup->calls++ == 0 )
+    {
+        lookup->end_ms  = now_ms;
+        lookup->result  = result;
+        lookup->address = ( address != NULL ) ? address->ip.v4 : 0;
+        lookups_outstanding--;
+    }
+    else
+    {
+        extra_callbacks++;
+    }
+    if ( strcmp( hostname, lookup->name ) != 0 )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "%s: callback given %s\n", lookup->name, hostname );
+        }
+    }
+    dns_host_unlock( );
+}
+
+static wiced_bool_t lookup_slot_free( void* arg )
+{
+    UNUSED_PARAMETER( arg );
+    return ( lookups_outstanding < MAXIMUM_QUERIES ) ? WICED_TRUE : WICED_FALSE;
+}
+
+static wiced_bool_t all_lookups_done( void* arg )
+{
+    UNUSED_PARAMETER( arg );
+    return ( lookups_outstanding == 0 ) ? WICED_TRUE : WICED_FALSE;
+}
+
+/* Starts a lookup of a fresh name of the given kind: 0 plain, 1 alias, 2 missing, 3 alias to a missing name */
+static lookup_t* start_lookup( unsigned kind, uint32_t timeout_ms )
+{
+    lookup_t*      lookup = &lookups[ lookups_started++ ];
+    wiced_result_t result;
+
+    memset( lookup, 0, sizeof( *lookup ) );
+    switch ( kind )
+    {
+        case 0:
+            strcpy( lookup->name, zone_names[ next_host ] );
+            lookup->expected_address = HOST_ADDRESS( next_host );
+            next_host++;
+            break;
+        case 1:
+            strcpy( lookup->name, zone_names[ HOST_NAMES + next_alias ] );
+            lookup->expected_address = HOST_ADDRESS( next_alias );
+            next_alias++;
+            break;
+        case 2:
+            sprintf( lookup->name, "missing%u.example.com", (unsigned) next_missing++ );
+            break;
+        default:
+            strcpy( lookup->name, zone_names[ HOST_NAMES + ALIAS_NAMES + next_missing % DEAD_END_NAMES ] );
+            next_missing++;
+            break;
+    }
+
+    lookup->start_ms = dns_host_elapsed_ms( );
+    dns_host_lock( );
+    lookups_outstanding++;
+    dns_host_unlock( );
+
+    result = dns_client_hostname_lookup_async( lookup->name, timeout_ms, lookup_done, lookup );
+    if ( result != WICED_SUCCESS )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "%s: lookup refused with %d\n", lookup->name, result );
+        }
+        dns_host_lock( );
+        lookups_outstanding--;
+        dns_host_unlock( );
+    }
+    return lookup;
+}
+
+/* Checks the lookups from first on, once they have all finished */
+static void check_lookups( const char* step, uint32_t first )
+{
+    uint32_t i;
+
+    for ( i = first; i < lookups_started; i++ )
+    {
+        lookup_t* lookup = &lookups[ i ];
+
+        if ( lookup->address == DNS_HOST_SPOOFED_ADDRESS )
+        {
+            forged_accepted++;
+        }
+        if ( ( lookup->calls != 1 ) ||
+             ( ( lookup->expected_address != 0 ) ? ( ( lookup->result != WICED_SUCCESS ) || ( lookup->address != lookup->expected_address ) )
+                                                 : ( ( lookup->result != WICED_ERROR ) || ( lookup->address != 0 ) ) ) )
+        {
+            if ( errors++ < 10 )
+            {
+                printf( "%s: %s called back %u times with result %d, address %08x, expected %08x\n", step, lookup->name,
+                        (unsigned) lookup->calls, lookup->result, (unsigned) lookup->address, (unsigned) lookup->expected_address );
+            }
+        }
+    }
+}
+
+/* Runs count lookups of plain names, MAXIMUM_QUERIES at a time, and returns the index of the first */
+static uint32_t run_lookups( uint32_t count, uint32_t timeout_ms )
+{
+    uint32_t first = lookups_started;
+    uint32_t i;
+
+    for ( i = 0; i < count; i++ )
+    {
+        dns_host_wait( lookup_slot_free, NULL );
+        start_lookup( 0, timeout_ms );
+    }
+    dns_host_wait( all_lookups_done, NULL );
+    return first;
+}
+
+static int compare_uint64( const void* a, const void* b )
+{
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return ( x > y ) - ( x < y );
+}
+
+/* Looks up eight plain names one after another with the blocking call, returning the time taken */
+static uint64_t run_blocking_lookups( uint32_t* failed )
+{
+    uint64_t start = dns_host_elapsed_ms( );
+    unsigned i;
+
+    for ( i = 0; i < MAXIMUM_QUERIES; i++ )
+    {
+        wiced_ip_address_t address;
+
+        address.ip.v4 = 0;
+        if ( dns_client_hostname_lookup( zone_names[ next_host ], &address, LOOKUP_TIMEOUT_MS ) != WICED_SUCCESS )
+        {
+            ( *failed )++;
+        }
+        else if ( address.ip.v4 != HOST_ADDRESS( next_host ) )
+        {
+            forged_accepted += ( address.ip.v4 == DNS_HOST_SPOOFED_ADDRESS ) ? 1 : 0;
+            if ( errors++ < 10 )
+            {
+                printf( "blocking lookup of %s gave %08x\n", zone_names[ next_host ], (unsigned) address.ip.v4 );
+            }
+        }
+        next_host++;
+    }
+    return dns_host_elapsed_ms( ) - start;
+}
+
+/******************************************************
+ *               Steps
+ ******************************************************/
+
+static void check_correctness( void )
+{
+    uint32_t first = lookups_started;
+    uint32_t blocking_failed = 0;
+    uint32_t i;
+
+    dns_host_servers[ 0 ].loss_percent     = 5;
+    dns_host_servers[ 1 ].loss_percent     = 5;
+    dns_host_servers[ 0 ].spoof            = WICED_TRUE;
+    dns_host_servers[ 1 ].spoof            = WICED_TRUE;
+    dns_host_servers[ 0 ].first_alias_only = WICED_TRUE;
+    dns_host_servers[ 1 ].first_alias_only = WICED_TRUE;
+
+    for ( i = 0; i < CORRECTNESS_LOOKUPS; i++ )
+    {
+        uint32_t kind = test_random( ) % 10;
+
+        dns_host_wait( lookup_slot_free, NULL );
+        start_lookup( ( kind < 6 ) ? 0 : ( kind < 8 ) ? 1 : ( kind < 9 ) ? 2 : 3, LOOKUP_TIMEOUT_MS );
+    }
+    dns_host_wait( all_lookups_done, NULL );
+    check_lookups( "correctness", first );
+
+    /* The blocking lookup takes whole CNAME chains only */
+    dns_host_servers[ 0 ].loss_percent     = 0;
+    dns_host_servers[ 1 ].loss_percent     = 0;
+    dns_host_servers[ 0 ].first_alias_only = WICED_FALSE;
+    dns_host_servers[ 1 ].first_alias_only = WICED_FALSE;
+    run_blocking_lookups( &blocking_failed );
+    if ( blocking_failed != 0 )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "correctness: %u blocking lookups failed\n", (unsigned) blocking_failed );
+        }
+    }
+    dns_host_servers[ 0 ].spoof = WICED_FALSE;
+    dns_host_servers[ 1 ].spoof = WICED_FALSE;
+
+    printf( "correctness: %u lookups with forged answers, %u of them accepted\n", (unsigned) ( lookups_started - first + MAXIMUM_QUERIES ),
+            (unsigned) forged_accepted );
+}
+
+static void check_timeouts( void )
+{
+    uint32_t first;
+    uint32_t i;
+
+    dns_host_servers[ 0 ].loss_percent = 100;
+    dns_host_servers[ 1 ].loss_percent = 100;
+
+    first = lookups_started;
+    for ( i = 0; i < MAXIMUM_QUERIES; i++ )
+    {
+        start_lookup( 0, SILENT_TIMEOUT_MS );
+    }
+    if ( dns_client_hostname_lookup_async( "one.too.many", SILENT_TIMEOUT_MS, lookup_done, &lookups[ MAXIMUM_LOOKUPS - 1 ] ) != WICED_NORESOURCE )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "timeouts: a lookup beyond %u was not refused\n", MAXIMUM_QUERIES );
+        }
+    }
+    dns_host_wait( all_lookups_done, NULL );
+
+    for ( i = first; i < lookups_started; i++ )
+    {
+        if ( ( lookups[ i ].calls != 1 ) || ( lookups[ i ].result != WICED_TIMEOUT ) || ( lookups[ i ].end_ms - lookups[ i ].start_ms != SILENT_TIMEOUT_MS ) )
+        {
+            if ( errors++ < 10 )
+            {
+                printf( "timeouts: %s ended with %d after %u ms\n", lookups[ i ].name, lookups[ i ].result,
+                        (unsigned) ( lookups[ i ].end_ms - lookups[ i ].start_ms ) );
+            }
+        }
+    }
+
+    dns_host_servers[ 0 ].loss_percent = 0;
+    dns_host_servers[ 1 ].loss_percent = 0;
+
+    /* Let both servers answer again before going on, so neither is left backing off */
+    dns_host_sleep( 60 * 1000 );
+    run_lookups( 4 * MAXIMUM_QUERIES, LOOKUP_TIMEOUT_MS );
+}
+
+/* Lookups one at a time. Returns how many took longer than slow_ms, and counts each server's queries */
+static uint32_t run_sequential_lookups( uint32_t count, uint64_t slow_ms, uint32_t* queries )
+{
+    uint32_t slow = 0;
+    uint32_t i;
+
+    for ( i = 0; i < count; i++ )
+    {
+        uint32_t  queries_before[ 2 ] = { dns_host_servers[ 0 ].queries, dns_host_servers[ 1 ].queries };
+        lookup_t* lookup              = start_lookup( 0, LOOKUP_TIMEOUT_MS );
+
+        dns_host_wait( all_lookups_done, NULL );
+        slow += ( lookup->end_ms - lookup->start_ms > slow_ms ) ? 1 : 0;
+        if ( queries != NULL )
+        {
+            queries[ 0 ] += dns_host_servers[ 0 ].queries - queries_before[ 0 ];
+            queries[ 1 ] += dns_host_servers[ 1 ].queries - queries_before[ 1 ];
+        }
+        dns_host_sleep( 100 );
+    }
+    return slow;
+}
+
+static void check_failover( void )
+{
+    uint32_t first = lookups_started;
+    uint64_t start = dns_host_elapsed_ms( );
+    uint32_t allowed;
+    uint64_t backoff;
+    uint32_t slow;
+
+    /* The dead server is only tried again when its backoff runs out, after 1 s, 2 s, 4 s... */
+    dns_host_servers[ 0 ].loss_percent = 100;
+    slow = run_sequential_lookups( FAILOVER_LOOKUPS, 2 * dns_host_servers[ 1 ].rtt_ms, NULL );
+    check_lookups( "failover", first );
+    allowed = 1;
+    for ( backoff = BACKOFF_MS; backoff < dns_host_elapsed_ms( ) - start; backoff = 2 * backoff + BACKOFF_MS )
+    {
+        allowed++;
+    }
+    printf( "failover: %u of %u lookups over %u ms waited on the dead server (%u allowed), first took %u ms\n", (unsigned) slow, FAILOVER_LOOKUPS,
+            (unsigned) ( dns_host_elapsed_ms( ) - start ), (unsigned) allowed, (unsigned) ( lookups[ first ].end_ms - lookups[ first ].start_ms ) );
+    if ( slow > allowed )
+    {
+        errors++;
+    }
+    dns_host_servers[ 0 ].loss_percent = 0;
+}
+
+/* Sets the servers' round trips, gives the resolver time to adapt, then counts where queries go */
+static void track_servers( uint32_t first_rtt_ms, uint32_t second_rtt_ms )
+{
+    uint32_t queries[ 2 ] = { 0, 0 };
+    unsigned faster       = ( first_rtt_ms < second_rtt_ms ) ? 0 : 1;
+
+    dns_host_servers[ 0 ].rtt_ms = first_rtt_ms;
+    dns_host_servers[ 1 ].rtt_ms = second_rtt_ms;
+    run_sequential_lookups( TRACKING_LOOKUPS, 0, NULL );
+    run_sequential_lookups( TRACKING_LOOKUPS, 0, queries );
+    printf( "round trip tracking: first server at %u ms, second at %u ms: %u and %u queries\n", (unsigned) first_rtt_ms, (unsigned) second_rtt_ms,
+            (unsigned) queries[ 0 ], (unsigned) queries[ 1 ] );
+    if ( queries[ faster ] < 4 * queries[ 1 - faster ] )
+    {
+        errors++;
+    }
+}
+
+static void check_rtt_tracking( void )
+{
+    uint32_t first = lookups_started;
+
+    /* The first server slows down, then recovers while the second stays a little slower */
+    track_servers( 20, 200 );
+    track_servers( 200, 20 );
+    track_servers( 20, 60 );
+    check_lookups( "round trip tracking", first );
+}
+
+static void measure_loss( loss_result_t* result, uint32_t count )
+{
+    static uint64_t latencies[ MAXIMUM_LOOKUPS ];
+    uint32_t        first;
+    uint32_t        i;
+    uint64_t        start;
+
+    dns_host_servers[ 0 ].loss_percent = result->loss_percent;
+    dns_host_servers[ 1 ].loss_percent = result->loss_percent;
+
+    first = run_lookups( count, LOOKUP_TIMEOUT_MS );
+    result->lookups = count;
+    for ( i = 0; i < count; i++ )
+    {
+        lookup_t* lookup = &lookups[ first + i ];
+
+        latencies[ i ] = lookup->end_ms - lookup->start_ms;
+        if ( lookup->result != WICED_SUCCESS )
+        {
+            result->failed++;
+        }
+        else if ( lookup->address != lookup->expected_address )
+        {
+            if ( errors++ < 10 )
+            {
+                printf( "%u%% loss: %s gave %08x\n", (unsigned) result->loss_percent, lookup->name, (unsigned) lookup->address );
+            }
+        }
+    }
+    qsort( latencies, count, sizeof( latencies[ 0 ] ), compare_uint64 );
+    result->p50_ms = latencies[ count / 2 ];
+    result->p95_ms = latencies[ count * 95 / 100 ];
+    result->p99_ms = latencies[ count * 99 / 100 ];
+    result->max_ms = latencies[ count - 1 ];
+
+    /* Eight names at once against eight one after another */
+    start = dns_host_elapsed_ms( );
+    run_lookups( MAXIMUM_QUERIES, LOOKUP_TIMEOUT_MS );
+    result->async_eight_ms    = dns_host_elapsed_ms( ) - start;
+    result->blocking_eight_ms = run_blocking_lookups( &result->blocking_failed );
+
+    dns_host_servers[ 0 ].loss_percent = 0;
+    dns_host_servers[ 1 ].loss_percent = 0;
+}
+
+/******************************************************
+ *               Test
+ ******************************************************/
+
+int main( int argc, char* argv[ ] )
+{
+    static const uint32_t loss_rates[ ] = { 0, 5, 10, 20, 30 };
+    loss_result_t         loss_results[ sizeof( loss_rates ) / sizeof( loss_rates[ 0 ] ) ];
+    wiced_ip_address_t    address;
+    uint32_t              lookups_per_loss_rate;
+    uint32_t              seed;
+    unsigned              i;
+    int                   failed;
+
+    lookups_per_loss_rate = ( argc > 1 ) ? (uint32_t) atoi( argv[ 1 ] ) : 250;
+    lookups_per_loss_rate = MAX( MIN( lookups_per_loss_rate, MAXIMUM_PER_LOSS_RATE ), 20 );
+    seed                  = ( argc > 2 ) ? (uint32_t) atoi( argv[ 2 ] ) : 1;
+    dns_host_init( seed );
+    random_state = seed;
+
+    /* Plain names, aliases to them, and aliases to names which do not exist */
+    for ( i = 0; i < HOST_NAMES + ALIAS_NAMES + DEAD_END_NAMES; i++ )
+    {
+        zone[ i ].name = zone_names[ i ];
+        zone[ i ].ttl  = 3600;
+        if ( i < HOST_NAMES )
+        {
+            sprintf( zone_names[ i ], "host%u.example.com", i );
+            zone[ i ].address = HOST_ADDRESS( i );
+        }
+        else if ( i < HOST_NAMES + ALIAS_NAMES )
+        {
+            sprintf( zone_names[ i ], "alias%u.example.net", i - HOST_NAMES );
+            zone[ i ].alias = zone_names[ i - HOST_NAMES ];
+        }
+        else
+        {
+            sprintf( zone_names[ i ], "dead-end%u.example.net", i - HOST_NAMES - ALIAS_NAMES );
+            sprintf( alias_targets[ i - HOST_NAMES - ALIAS_NAMES ], "gone%u.example.net", i - HOST_NAMES - ALIAS_NAMES );
+            zone[ i ].alias = alias_targets[ i - HOST_NAMES - ALIAS_NAMES ];
+        }
+    }
+    /* Plain names used by aliases are looked up through them, not directly */
+    next_host = ALIAS_NAMES;
+
+    dns_host_zone                   = zone;
+    dns_host_zone_size              = HOST_NAMES + ALIAS_NAMES + DEAD_END_NAMES;
+    dns_host_servers[ 0 ].address   = SERVER_1;
+    dns_host_servers[ 0 ].rtt_ms    = 20;
+    dns_host_servers[ 0 ].jitter_ms = 10;
+    dns_host_servers[ 1 ].address   = SERVER_2;
+    dns_host_servers[ 1 ].rtt_ms    = 60;
+    dns_host_servers[ 1 ].jitter_ms = 20;
+    dns_host_server_count           = 2;
+    for ( i = 0; i < dns_host_server_count; i++ )
+    {
+        SET_IPV4_ADDRESS( address, dns_host_servers[ i ].address );
+        dns_client_add_server_address( address );
+    }
+
+    check_correctness( );
+    check_timeouts( );
+    check_failover( );
+    check_rtt_tracking( );
+
+    printf( "loss each way   lookups  failed  median  95th  99th   max   8 at once  8 blocking (failed)\n" );
+    for ( i = 0; i < sizeof( loss_rates ) / sizeof( loss_rates[ 0 ] ); i++ )
+    {
+        memset( &loss_results[ i ], 0, sizeof( loss_results[ i ] ) );
+        loss_results[ i ].loss_percent = loss_rates[ i ];
+        measure_loss( &loss_results[ i ], lookups_per_loss_rate );
+        printf( "%11u%% %9u %7u %5u ms %4u %5u %5u %8u ms %8u ms (%u)\n", (unsigned) loss_results[ i ].loss_percent,
+                (unsigned) loss_results[ i ].lookups, (unsigned) loss_results[ i ].failed, (unsigned) loss_results[ i ].p50_ms,
+                (unsigned) loss_results[ i ].p95_ms, (unsigned) loss_results[ i ].p99_ms, (unsigned) loss_results[ i ].max_ms,
+                (unsigned) loss_results[ i ].async_eight_ms, (unsigned) loss_results[ i ].blocking_eight_ms,
+                (unsigned) loss_results[ i ].blocking_failed );
+        if ( ( loss_results[ i ].loss_percent <= 10 ) && ( loss_results[ i ].failed != 0 ) )
+        {
+            errors++;
+        }
+    }
+
+    /* The resolver thread closes its socket once nothing is pending */
+    dns_host_sleep( 10 * 1000 );
+    printf( "%u forged answers accepted, %u extra callbacks, %u packets and %u sockets left over, %u errors\n", (unsigned) forged_accepted,
+            (unsigned) extra_callbacks, (unsigned) dns_host_packets_outstanding( ), (unsigned) dns_host_sockets_open( ), errors );
+    failed = ( errors != 0 ) || ( forged_accepted != 0 ) || ( extra_callbacks != 0 ) || ( dns_host_packets_outstanding( ) != 0 ) ||
+             ( dns_host_sockets_open( ) != 0 );
+    printf( failed ? "FAIL\n" : "PASS\n" );
+    return failed;
+}
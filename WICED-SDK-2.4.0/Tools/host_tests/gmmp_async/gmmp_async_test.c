@@ -0,0 +1,401 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  GMMP delivery against a mock server
+ *
+ *  The GMMP library runs over an in-process transport whose data arrives a
+ *  fixed delay after it is sent, with a server thread answering every
+ *  delivery. GO_Delivery() and GO_Delivery_Async() are timed against each
+ *  other, then the server drops one response in seven.
+ *
+ *  Fails if a request fails, or if a request with a lost response is not
+ *  completed by a timeout exactly once.
+ *
+ *  Usage: gmmp_async_test [one_way_delay_ms]
+ */
+
+#include "../wizfimain/wx_defines.h"
+#include "GMMP.h"
+#undef errno
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define REQUESTS            (200)
+#define MAX_TID             (0x10000)
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/* Bytes written to a pipe become readable delay_ms later */
+typedef struct chunk_struct
+{
+    struct chunk_struct* next;
+    uint32_t             due;
+    int                  length;
+    int                  offset;
+    char                 data[];
+} chunk_t;
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t  ready;
+    chunk_t*        head;
+    chunk_t*        tail;
+} pipe_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static int    one_way_ms = 10;
+static int    drop_every;           /* The server drops every Nth response, 0 for none */
+static int    responses;            /* Counted from when drop_every is set */
+static pipe_t to_server   = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL };
+static pipe_t from_server = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL };
+
+static volatile int completed_ok;
+static volatile int completed_timeout;
+static volatile int completed_other;
+static volatile int completions[ MAX_TID ];
+
+/******************************************************
+ *               Transport
+ ******************************************************/
+
+static uint32_t now_ms( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (uint32_t) ( now.tv_sec * 1000 + now.tv_nsec / 1000000 );
+}
+
+static void sleep_until( uint32_t time )
+{
+    int32_t remaining;
+
+    while ( ( remaining = (int32_t) ( time - now_ms( ) ) ) > 0 )
+    {
+        struct timespec delay = { 0, (long) remaining * 1000000 };
+        nanosleep( &delay, NULL );
+    }
+}
+
+static void pipe_write( pipe_t* pipe, const void* data, int length )
+{
+    chunk_t* chunk = malloc( sizeof( *chunk ) + length );
+
+    chunk->next   = NULL;
+    chunk->due    = now_ms( ) + one_way_ms;
+    chunk->length = length;
+    chunk->offset = 0;
+    memcpy( chunk->data, data, length );
+
+    pthread_mutex_lock( &pipe->mutex );
+    if ( pipe->tail != NULL )
+    {
+        pipe->tail->next = chunk;
+    }
+    else
+    {
+        pipe->head = chunk;
+    }
+    pipe->tail = chunk;
+    pthread_cond_broadcast( &pipe->ready );
+    pthread_mutex_unlock( &pipe->mutex );
+}
+
+static void pipe_read( pipe_t* pipe, void* data, int length )
+{
+    char* out = data;
+
+    while ( length > 0 )
+    {
+        chunk_t* chunk;
+        int      take;
+
+        pthread_mutex_lock( &pipe->mutex );
+        while ( pipe->head == NULL )
+        {
+            pthread_cond_wait( &pipe->ready, &pipe->mutex );
+        }
+        chunk = pipe->head;
+        pthread_mutex_unlock( &pipe->mutex );
+
+        sleep_until( chunk->due );
+        take = MIN( chunk->length - chunk->offset, length );
+        memcpy( out, chunk->data + chunk->offset, take );
+        chunk->offset += take;
+        out           += take;
+        length        -= take;
+
+        if ( chunk->offset == chunk->length )
+        {
+            pthread_mutex_lock( &pipe->mutex );
+            pipe->head = chunk->next;
+            if ( pipe->head == NULL )
+            {
+                pipe->tail = NULL;
+            }
+            pthread_mutex_unlock( &pipe->mutex );
+            free( chunk );
+        }
+    }
+}
+
+int GmmpWicedTCPSend( void* pData, int nLength )
+{
+    pipe_write( &to_server, pData, nLength );
+    return nLength;
+}
+
+int GmmpWicedTCPRecv( void* pData, int nLength )
+{
+    pipe_read( &from_server, pData, nLength );
+    return nLength;
+}
+
+void GMMPDisconnectSocket( void )
+{
+}
+
+void W_DBG2( const char* format, ... )
+{
+    (void) format;
+}
+
+wiced_time_t host_rtos_get_time( void )
+{
+    return now_ms( );
+}
+
+/******************************************************
+ *               RTOS, on pthreads
+ ******************************************************/
+
+wiced_result_t wiced_time_get_time( wiced_time_t* time )
+{
+    *time = now_ms( );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_init_mutex( wiced_mutex_t* mutex )
+{
+    pthread_mutex_t* host_mutex = malloc( sizeof( *host_mutex ) );
+
+    pthread_mutex_init( host_mutex, NULL );
+    *(pthread_mutex_t**) mutex = host_mutex;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_lock_mutex( wiced_mutex_t* mutex )
+{
+    pthread_mutex_lock( *(pthread_mutex_t**) mutex );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_unlock_mutex( wiced_mutex_t* mutex )
+{
+    pthread_mutex_unlock( *(pthread_mutex_t**) mutex );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_init_semaphore( wiced_semaphore_t* semaphore )
+{
+    sem_t* host_semaphore = malloc( sizeof( *host_semaphore ) );
+
+    sem_init( host_semaphore, 0, 0 );
+    *(sem_t**) semaphore = host_semaphore;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_set_semaphore( wiced_semaphore_t* semaphore )
+{
+    sem_post( *(sem_t**) semaphore );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_get_semaphore( wiced_semaphore_t* semaphore, uint32_t timeout_ms )
+{
+    struct timespec deadline;
+
+    clock_gettime( CLOCK_REALTIME, &deadline );
+    deadline.tv_nsec += (long) ( timeout_ms % 1000 ) * 1000000;
+    deadline.tv_sec  += timeout_ms / 1000 + deadline.tv_nsec / 1000000000;
+    deadline.tv_nsec %= 1000000000;
+    return ( sem_timedwait( *(sem_t**) semaphore, &deadline ) == 0 ) ? WICED_SUCCESS : WICED_TIMEOUT;
+}
+
+/******************************************************
+ *               Server and client
+ ******************************************************/
+
+/* Answers each delivery with a response carrying its T-ID */
+static void* server_thread( void* arg )
+{
+    (void) arg;
+    for ( ;; )
+    {
+        GMMPHeader   header;
+        char         body[ 4096 ];
+        Delivery_Rsp response;
+        int          length;
+
+        pipe_read( &to_server, &header, sizeof( header ) );
+        length = ( ( (uint8_t) header.usMessageLength[ 0 ] << 8 ) | (uint8_t) header.usMessageLength[ 1 ] ) - (int) sizeof( header );
+        pipe_read( &to_server, body, length );
+        if ( ( drop_every != 0 ) && ( ++responses % drop_every == 0 ) )
+        {
+            continue;
+        }
+
+        memset( &response, 0, sizeof( response ) );
+        response.header                     = header;
+        response.header.ucMessageType       = OPERATION_DELIVERY_RSP;
+        response.header.usMessageLength[ 0 ] = sizeof( response ) >> 8;
+        response.header.usMessageLength[ 1 ] = sizeof( response ) & 0xFF;
+        memcpy( response.body.usGWID, "GW", 2 );
+        pipe_write( &from_server, &response, sizeof( response ) );
+    }
+    return NULL;
+}
+
+/* The receive thread of TCP Always On mode */
+static void* reader_thread( void* arg )
+{
+    GMMPHeader header;
+    void*      body;
+
+    (void) arg;
+    for ( ;; )
+    {
+        body = NULL;
+        if ( ( GetReadData( &header, &body ) == GMMP_SUCCESS ) && ( body != NULL ) )
+        {
+            free( body );
+        }
+    }
+    return NULL;
+}
+
+static void delivery_done( int nTID, int nResult, GMMPHeader* pstGMMPHeader, void* pBody, void* pArg )
+{
+    (void) pstGMMPHeader; (void) pBody; (void) pArg;
+
+    __sync_fetch_and_add( &completions[ nTID % MAX_TID ], 1 );
+    if ( nResult == GMMP_SUCCESS )
+    {
+        __sync_fetch_and_add( &completed_ok, 1 );
+    }
+    else if ( nResult == SERVER_REQUEST_TIMEOUT )
+    {
+        __sync_fetch_and_add( &completed_timeout, 1 );
+    }
+    else
+    {
+        __sync_fetch_and_add( &completed_other, 1 );
+    }
+}
+
+static void reset_completions( void )
+{
+    completed_ok      = 0;
+    completed_timeout = 0;
+    completed_other   = 0;
+    memset( (void*) completions, 0, sizeof( completions ) );
+}
+
+int main( int argc, char** argv )
+{
+    pthread_t server;
+    pthread_t reader;
+    uint32_t  start;
+    uint32_t  elapsed;
+    int       duplicates = 0;
+    int       failed     = 0;
+    int       i;
+
+    if ( argc > 1 )
+    {
+        one_way_ms = atoi( argv[ 1 ] );
+    }
+    Initializaion( "127.0.0.1", 1, "DOMAIN", "AUTHID", GMMP_OFF_LOG, GMMP_ERROR_LEVEL_ERROR, GMMP_NETWORK_ALYWAYS_OFF, NULL );
+    SetGWID( "GW" );
+    pthread_create( &server, NULL, server_thread, NULL );
+
+    /* One request at a time, each waiting for its response */
+    start = now_ms( );
+    for ( i = 0; i < REQUESTS; i++ )
+    {
+        if ( GO_Delivery( GetGWID( ), NULL, 0x01, 0x01, "Temperature=28C", 1, 1, GMMP_ENCRYPTION_NOT ) != GMMP_SUCCESS )
+        {
+            printf( "FAIL: GO_Delivery %d\n", i );
+            return 1;
+        }
+    }
+    elapsed = now_ms( ) - start;
+    printf( "RTT %d ms  GO_Delivery       : %d in %u ms, %.1f/s\n", 2 * one_way_ms, REQUESTS, elapsed, REQUESTS * 1000.0 / elapsed );
+
+    /* Up to GMMP_ASYNC_MAX_PENDING in flight */
+    SetNetworkType( GMMP_NETWORK_ALYWAYS_ON );
+    pthread_create( &reader, NULL, reader_thread, NULL );
+    reset_completions( );
+    start = now_ms( );
+    for ( i = 0; i < REQUESTS; i++ )
+    {
+        if ( GO_Delivery_Async( GetGWID( ), NULL, 0x01, 0x01, "Temperature=28C", 1, 1, GMMP_ENCRYPTION_NOT, 2000, delivery_done, NULL ) != GMMP_SUCCESS )
+        {
+            printf( "FAIL: GO_Delivery_Async %d\n", i );
+            return 1;
+        }
+    }
+    while ( completed_ok + completed_timeout + completed_other < REQUESTS )
+    {
+        sleep_until( now_ms( ) + 1 );
+    }
+    elapsed = now_ms( ) - start;
+    printf( "RTT %d ms  GO_Delivery_Async : %d in %u ms, %.1f/s, window %d, ok %d timeout %d other %d\n",
+            2 * one_way_ms, REQUESTS, elapsed, REQUESTS * 1000.0 / elapsed, GMMP_ASYNC_MAX_PENDING, completed_ok, completed_timeout, completed_other );
+    failed |= ( completed_ok != REQUESTS );
+
+    /* Every 7th response lost: each request still completes exactly once */
+    reset_completions( );
+    responses  = 0;
+    drop_every = 7;
+    for ( i = 0; i < REQUESTS; i++ )
+    {
+        if ( GO_Delivery_Async( GetGWID( ), NULL, 0x01, 0x01, "x", 1, 1, GMMP_ENCRYPTION_NOT, 300, delivery_done, NULL ) != GMMP_SUCCESS )
+        {
+            printf( "FAIL: GO_Delivery_Async %d with losses\n", i );
+            return 1;
+        }
+    }
+    while ( completed_ok + completed_timeout + completed_other < REQUESTS )
+    {
+        AsyncCheckTimeout( );
+        sleep_until( now_ms( ) + 20 );
+    }
+    for ( i = 0; i < MAX_TID; i++ )
+    {
+        duplicates += ( completions[ i ] > 1 ) ? 1 : 0;
+    }
+    printf( "1 in %d responses lost: ok %d timeout %d other %d, completed more than once %d\n",
+            drop_every, completed_ok, completed_timeout, completed_other, duplicates );
+    failed |= ( duplicates != 0 ) || ( completed_other != 0 ) || ( completed_timeout != REQUESTS / drop_every );
+
+    printf( failed ? "FAIL\n" : "PASS\n" );
+    return failed;
+}
@@ -0,0 +1,541 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  GMMP message encoder against the struct-based encoder it replaced
+ *
+ *  GMMP_SetDelivery(), GMMP_SetNotifi(), GMMP_SetControl() and GMMP_SetHB()
+ *  are called over empty, 1-char, full-width and over-long IDs and bodies of
+ *  0, 1, 37, 2047, 2048 and 2049 bytes. The bytes they put on the wire and
+ *  their return codes are compared with a copy of the previous encoder,
+ *  which memsets the whole struct and fills it through SetHeader().
+ *
+ *  Then both are timed per message type, and the stack each call uses is
+ *  measured by running it on a painted stack.
+ *
+ *  Fails on any difference, or if a notification with a body size out of
+ *  range is sent.
+ */
+
+#include "../wizfimain/wx_defines.h"
+#include "GMMP.h"
+#undef errno
+#include <pthread.h>
+#include <time.h>
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define WIRE_SIZE           (4096)
+#define TEST_TID            (0x01020304)
+#define TEST_STACK_SIZE     (64 * 1024)
+#define STACK_PAINT         (0xA5)
+#define BENCH_ITERATIONS    (50000)
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+typedef enum
+{
+    MESSAGE_DELIVERY,
+    MESSAGE_NOTIFICATION,
+    MESSAGE_CONTROL,
+    MESSAGE_HEARTBEAT,
+} message_t;
+
+typedef struct
+{
+    message_t   message;
+    const char* id[ 4 ];    /* Auth ID, auth key, domain code, device ID or GW ID */
+    const char* body;
+    int         body_length;
+} call_t;
+
+typedef int (*encoder_t)( const call_t* call );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static unsigned char wire[ WIRE_SIZE ];
+static int           wire_length;
+static char          body[ MAX_MSG_BODY + 2 ];
+
+static const char* ids[] = { "", "A", "GW01", "0123456789", "0123456789abcdef", "0123456789abcdefX", NULL };
+
+#define ID_COUNT            ( (int) ( sizeof( ids ) / sizeof( ids[ 0 ] ) ) )
+
+/******************************************************
+ *               Transport and RTOS stubs
+ ******************************************************/
+
+int GmmpWicedTCPSend( void* pData, int nLength )
+{
+    if ( wire_length + nLength <= WIRE_SIZE )
+    {
+        memcpy( &wire[ wire_length ], pData, nLength );
+    }
+    wire_length += nLength;
+    return nLength;
+}
+
+int GmmpWicedTCPRecv( void* pData, int nLength )
+{
+    (void) pData;
+    return nLength;
+}
+
+void GMMPDisconnectSocket( void )
+{
+}
+
+void W_DBG2( const char* format, ... )
+{
+    (void) format;
+}
+
+wiced_time_t host_rtos_get_time( void )
+{
+    return 123456;
+}
+
+wiced_result_t wiced_time_get_time( wiced_time_t* time )
+{
+    *time = 0;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_init_mutex( wiced_mutex_t* mutex )
+{
+    (void) mutex;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_lock_mutex( wiced_mutex_t* mutex )
+{
+    (void) mutex;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_unlock_mutex( wiced_mutex_t* mutex )
+{
+    (void) mutex;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_init_semaphore( wiced_semaphore_t* semaphore )
+{
+    (void) semaphore;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_set_semaphore( wiced_semaphore_t* semaphore )
+{
+    (void) semaphore;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_get_semaphore( wiced_semaphore_t* semaphore, uint32_t timeout_ms )
+{
+    (void) semaphore; (void) timeout_ms;
+    return WICED_SUCCESS;
+}
+
+/******************************************************
+ *               Previous encoder
+ ******************************************************/
+
+/* The pre-encoder GMMP_Set* bodies, logging as they did on success */
+static int reference_delivery( const call_t* call )
+{
+    const char*  auth_id   = call->id[ 0 ];
+    const char*  auth_key  = call->id[ 1 ];
+    const char*  domain    = call->id[ 2 ];
+    const char*  device_id = call->id[ 3 ];
+    Delivery_Req request;
+    int          body_length;
+    int          packet_size;
+    int          result;
+
+    GMMP_Printf( GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_OPS, "[GW->OMP]GMMP_SetDelivery Start \r\n" );
+    if ( auth_id == NULL || auth_key == NULL || strlen( auth_id ) > LEN_AUTH_ID || strlen( auth_key ) > LEN_AUTH_KEY ||
+         domain == NULL || strlen( domain ) > LEN_DOMAIN_CODE || call->body == NULL || strlen( call->body ) > MAX_MSG_BODY )
+    {
+        return LIB_PARAM_ERROR;
+    }
+
+    body_length = strlen( call->body );
+    memset( &request, 0, sizeof( request ) );
+    packet_size = sizeof( request ) - MAX_MSG_BODY + body_length;
+    SetTID( TEST_TID );
+    result = SetHeader( (void*) &request, packet_size, 1, 1, OPERATION_DELIVERY_REQ, auth_id, auth_key, GMMP_ENCRYPTION_NOT );
+    if ( result != GMMP_SUCCESS )
+    {
+        return result;
+    }
+    memcpy( request.body.usDomainCode, domain, strlen( domain ) );
+    memcpy( request.body.usGWID, "GW", strlen( "GW" ) );
+    if ( device_id != NULL && strlen( device_id ) <= LEN_DEVICE_ID )
+    {
+        memcpy( request.body.usDeviceID, device_id, strlen( device_id ) );
+    }
+    request.body.ucReportType = 1;
+    request.body.ucMediaType  = 1;
+    if ( body_length > 0 )
+    {
+        memcpy( request.body.usMessageBody, call->body, body_length );
+    }
+    GMMP_Printf( GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_REQ, "\r\n" );
+    GMMP_Trace( &request.header, &request.body );
+    result = GMMP_Delivery_Req( &request, packet_size );
+    GMMP_Printf( GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_NOT, "[GW->OMP]GMMP_SetDelivery End \r\n" );
+    return result;
+}
+
+static int reference_notification( const call_t* call )
+{
+    const char* auth_id   = call->id[ 0 ];
+    const char* auth_key  = call->id[ 1 ];
+    const char* domain    = call->id[ 2 ];
+    const char* device_id = call->id[ 3 ];
+    Notifi_Req  request;
+    int         packet_size;
+    int         result;
+
+    GMMP_Printf( GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_OPS, "[GW->OMP]GMMP_SetNotifi Start \r\n" );
+    if ( auth_id == NULL || auth_key == NULL || domain == NULL || strlen( auth_id ) > LEN_AUTH_ID || strlen( auth_key ) > LEN_AUTH_KEY ||
+         strlen( domain ) > LEN_DOMAIN_CODE )
+    {
+        return LIB_PARAM_ERROR;
+    }
+
+    memset( &request, 0, sizeof( request ) );
+    packet_size = sizeof( request ) - MAX_MSG_BODY + call->body_length;
+    result = SetHeader( (void*) &request, packet_size, 1, 1, OPERATION_NOTIFICATION_REQ, auth_id, auth_key, GMMP_ENCRYPTION_NOT );
+    if ( result != GMMP_SUCCESS )
+    {
+        return result;
+    }
+    memcpy( request.body.usDomainCode, domain, strlen( domain ) );
+    memcpy( request.body.usGWID, "GW", strlen( "GW" ) );
+    if ( device_id != NULL && strlen( device_id ) <= LEN_DEVICE_ID )
+    {
+        memcpy( request.body.usDeviceID, device_id, strlen( device_id ) );
+    }
+    request.body.ucControlType = 3;
+    request.body.ucResultCode  = 0;
+    if ( call->body != NULL )
+    {
+        memcpy( request.body.usMessageBody, call->body, call->body_length );
+    }
+    GMMP_Printf( GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_REQ, "\r\n" );
+    GMMP_Trace( &request.header, &request.body );
+    result = GMMP_Notifi_Req( &request, packet_size );
+    GMMP_Printf( GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_NOT, "[GW->OMP]GMMP_SetNotifi End \r\n" );
+    return result;
+}
+
+static int reference_control( const call_t* call )
+{
+    const char* auth_id   = call->id[ 0 ];
+    const char* auth_key  = call->id[ 1 ];
+    const char* domain    = call->id[ 2 ];
+    const char* device_id = call->id[ 3 ];
+    Control_Rsp response;
+    int         result;
+
+    if ( auth_id == NULL || auth_key == NULL || domain == NULL || strlen( auth_id ) > LEN_AUTH_ID || strlen( auth_key ) > LEN_AUTH_KEY ||
+         strlen( domain ) > LEN_DOMAIN_CODE )
+    {
+        return LIB_PARAM_ERROR;
+    }
+
+    memset( &response, 0, sizeof( response ) );
+    result = SetHeader( (void*) &response, sizeof( response ), 1, 1, OPERATION_CONTROL_RSP, auth_id, auth_key, GMMP_ENCRYPTION_NOT );
+    if ( result != GMMP_SUCCESS )
+    {
+        return result;
+    }
+    memcpy( response.body.usDomainCode, domain, strlen( domain ) );
+    memcpy( response.body.usGWID, "GW", strlen( "GW" ) );
+    if ( device_id != NULL && strlen( device_id ) <= LEN_DEVICE_ID )
+    {
+        memcpy( response.body.usDeviceID, device_id, strlen( device_id ) );
+    }
+    response.body.ucControlType = 2;
+    response.body.ucResultCode  = 1;
+    GMMP_Printf( GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_RSP, "\r\n" );
+    GMMP_Trace( &response.header, &response.body );
+    result = GMMP_Control_Rsp( &response );
+    GMMP_Printf( GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_OPE, "\r\n" );
+    GMMP_Printf( GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_NOT, "[GW->OMP]GMMP_SetControl End \r\n" );
+    return result;
+}
+
+static int reference_heartbeat( const call_t* call )
+{
+    const char* auth_id  = call->id[ 0 ];
+    const char* auth_key = call->id[ 1 ];
+    const char* domain   = call->id[ 2 ];
+    const char* gw_id    = call->id[ 3 ];
+    HB_Req      request;
+    int         result;
+
+    GMMP_Printf( GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_OPS, "[GW->OMP]GMMP_SetHB Start \r\n" );
+    if ( auth_id == NULL || auth_key == NULL || domain == NULL || gw_id == NULL || strlen( auth_id ) > LEN_AUTH_ID ||
+         strlen( auth_key ) > LEN_AUTH_KEY || strlen( domain ) > LEN_DOMAIN_CODE || strlen( gw_id ) > LEN_GW_ID )
+    {
+        return LIB_PARAM_ERROR;
+    }
+
+    memset( &request, 0, sizeof( request ) );
+    result = SetHeader( (void*) &request, sizeof( request ), 1, 1, OPERATION_HEARTBEAT_REQ, auth_id, auth_key, GMMP_ENCRYPTION_NOT );
+    if ( result != GMMP_SUCCESS )
+    {
+        return result;
+    }
+    memcpy( request.body.usDomainCode, domain, strlen( domain ) );
+    memcpy( request.body.usGWID, gw_id, strlen( gw_id ) );
+    GMMP_Printf( GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_REQ, "\r\n" );
+    GMMP_Trace( &request.header, &request.body );
+    result = GMMP_Heartbeat_Req( &request );
+    GMMP_Printf( GMMP_ERROR_LEVEL_DEBUG, GMMP_LOG_MARKET_NOT, "[GW->OMP]GMMP_SetHB End \r\n" );
+    return result;
+}
+
+static int reference_encode( const call_t* call )
+{
+    switch ( call->message )
+    {
+        case MESSAGE_DELIVERY:     return reference_delivery( call );
+        case MESSAGE_NOTIFICATION: return reference_notification( call );
+        case MESSAGE_CONTROL:      return reference_control( call );
+        case MESSAGE_HEARTBEAT:    return reference_heartbeat( call );
+    }
+    return LIB_PARAM_ERROR;
+}
+
+/******************************************************
+ *               Encoder under test
+ ******************************************************/
+
+static int encode( const call_t* call )
+{
+    const char* auth_id   = call->id[ 0 ];
+    const char* auth_key  = call->id[ 1 ];
+    const char* domain    = call->id[ 2 ];
+    const char* device_id = call->id[ 3 ];
+
+    switch ( call->message )
+    {
+        case MESSAGE_DELIVERY:
+            return GMMP_SetDelivery( auth_id, auth_key, domain, "GW", device_id, 1, 1, call->body, 1, 1, GMMP_ENCRYPTION_NOT, TEST_TID );
+        case MESSAGE_NOTIFICATION:
+            return GMMP_SetNotifi( auth_id, auth_key, domain, "GW", device_id, 3, 0, call->body, call->body_length );
+        case MESSAGE_CONTROL:
+            return GMMP_SetControl( auth_id, auth_key, domain, "GW", device_id, 2, 1 );
+        case MESSAGE_HEARTBEAT:
+            return GMMP_SetHB( auth_id, auth_key, domain, device_id );
+    }
+    return LIB_PARAM_ERROR;
+}
+
+/******************************************************
+ *               Checks and measurements
+ ******************************************************/
+
+/* Returns 1 if both encoders put the same bytes on the wire with the same result */
+static int compare( const call_t* call )
+{
+    static unsigned char expected[ WIRE_SIZE ];
+    int                  expected_length;
+    int                  expected_result;
+    int                  result;
+
+    wire_length     = 0;
+    expected_result = reference_encode( call );
+    expected_length = wire_length;
+    memcpy( expected, wire, MIN( expected_length, WIRE_SIZE ) );
+
+    wire_length = 0;
+    result      = encode( call );
+
+    if ( ( result != expected_result ) || ( wire_length != expected_length ) || ( memcmp( wire, expected, MIN( wire_length, WIRE_SIZE ) ) != 0 ) )
+    {
+        printf( "mismatch: message %d ids %s/%s/%s/%s body %d: result %d expected %d, %d bytes expected %d\n", call->message,
+                call->id[ 0 ] ? call->id[ 0 ] : "NULL", call->id[ 1 ] ? call->id[ 1 ] : "NULL", call->id[ 2 ] ? call->id[ 2 ] : "NULL",
+                call->id[ 3 ] ? call->id[ 3 ] : "NULL", call->body_length, result, expected_result, wire_length, expected_length );
+        return 0;
+    }
+    return 1;
+}
+
+static double now_ns( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+static double time_call( encoder_t encoder, const call_t* call )
+{
+    double start = now_ns( );
+    int    i;
+
+    for ( i = 0; i < BENCH_ITERATIONS; i++ )
+    {
+        wire_length = 0;
+        encoder( call );
+    }
+    return ( now_ns( ) - start ) / BENCH_ITERATIONS;
+}
+
+static encoder_t    stack_encoder;
+static const call_t* stack_call;
+
+static void* stack_thread( void* arg )
+{
+    (void) arg;
+    if ( stack_encoder != NULL )
+    {
+        wire_length = 0;
+        stack_encoder( stack_call );
+    }
+    return NULL;
+}
+
+/* Deepest stack use of one call, on a thread whose stack is painted first */
+static int stack_depth( encoder_t encoder, const call_t* call )
+{
+    static unsigned char stack[ TEST_STACK_SIZE ] __attribute__(( aligned( 4096 ) ));
+    pthread_attr_t       attributes;
+    pthread_t            thread;
+    int                  untouched = 0;
+
+    memset( stack, STACK_PAINT, sizeof( stack ) );
+    stack_encoder = encoder;
+    stack_call    = call;
+    pthread_attr_init( &attributes );
+    pthread_attr_setstack( &attributes, stack, sizeof( stack ) );
+    pthread_create( &thread, &attributes, stack_thread, NULL );
+    pthread_join( thread, NULL );
+    pthread_attr_destroy( &attributes );
+
+    while ( ( untouched < TEST_STACK_SIZE ) && ( stack[ untouched ] == STACK_PAINT ) )
+    {
+        untouched++;
+    }
+    return TEST_STACK_SIZE - untouched;
+}
+
+int main( void )
+{
+    static const int lengths[] = { 0, 1, 37, MAX_MSG_BODY - 1, MAX_MSG_BODY, MAX_MSG_BODY + 1 };
+    static const struct
+    {
+        const char* name;
+        message_t   message;
+        int         body_length;
+    } benches[] =
+    {
+        { "Delivery 16 B",     MESSAGE_DELIVERY,     16 },
+        { "Delivery 256 B",    MESSAGE_DELIVERY,     256 },
+        { "Delivery 2048 B",   MESSAGE_DELIVERY,     2048 },
+        { "Notification 16 B", MESSAGE_NOTIFICATION, 16 },
+        { "Control",           MESSAGE_CONTROL,      0 },
+        { "Heartbeat",         MESSAGE_HEARTBEAT,    0 },
+    };
+    call_t call;
+    int    calls      = 0;
+    int    mismatches = 0;
+    int    baseline;
+    int    i, l;
+
+    for ( i = 0; i < MAX_MSG_BODY + 1; i++ )
+    {
+        body[ i ] = 'a' + i % 26;
+    }
+    SetTID( TEST_TID );
+
+    /* Every combination of the four IDs, counted in base ID_COUNT */
+    for ( i = 0; i < ID_COUNT * ID_COUNT * ID_COUNT * ID_COUNT; i++ )
+    {
+        call.id[ 0 ] = ids[ i % ID_COUNT ];
+        call.id[ 1 ] = ids[ i / ID_COUNT % ID_COUNT ];
+        call.id[ 2 ] = ids[ i / ( ID_COUNT * ID_COUNT ) % ID_COUNT ];
+        call.id[ 3 ] = ids[ i / ( ID_COUNT * ID_COUNT * ID_COUNT ) ];
+
+        for ( l = 0; l < (int) ( sizeof( lengths ) / sizeof( lengths[ 0 ] ) ); l++ )
+        {
+            char saved = body[ lengths[ l ] ];
+
+            body[ lengths[ l ] ] = 0;
+            call.message         = MESSAGE_DELIVERY;
+            call.body            = body;
+            call.body_length     = lengths[ l ];
+            mismatches += !compare( &call );
+            calls++;
+            body[ lengths[ l ] ] = saved;
+
+            /* The previous encoder read past its struct for larger bodies */
+            if ( lengths[ l ] <= MAX_MSG_BODY )
+            {
+                call.message = MESSAGE_NOTIFICATION;
+                call.body    = ( l & 1 ) ? NULL : body;
+                mismatches += !compare( &call );
+                calls++;
+            }
+        }
+        call.message = MESSAGE_CONTROL;
+        mismatches += !compare( &call );
+        call.message = MESSAGE_HEARTBEAT;
+        mismatches += !compare( &call );
+        calls += 2;
+    }
+    printf( "%d calls against the previous encoder, %d mismatches\n", calls, mismatches );
+
+    /* Out of range notification bodies are refused, nothing is sent */
+    call.message = MESSAGE_NOTIFICATION;
+    call.id[ 0 ] = "AUTHID";
+    call.id[ 1 ] = "AUTHKEY";
+    call.id[ 2 ] = "DOMAIN";
+    call.id[ 3 ] = "DEV01";
+    call.body    = body;
+    for ( l = -1; l <= MAX_MSG_BODY + 1; l += MAX_MSG_BODY + 2 )
+    {
+        call.body_length = l;
+        wire_length      = 0;
+        if ( ( encode( &call ) != LIB_PARAM_ERROR ) || ( wire_length != 0 ) )
+        {
+            printf( "notification body of %d bytes was not refused\n", l );
+            mismatches++;
+        }
+    }
+
+    call.body_length = 0;
+    baseline = stack_depth( NULL, &call );
+    printf( "%-18s %10s %10s %12s %12s\n", "message", "before ns", "after ns", "before stack", "after stack" );
+    for ( i = 0; i < (int) ( sizeof( benches ) / sizeof( benches[ 0 ] ) ); i++ )
+    {
+        char saved = body[ benches[ i ].body_length ];
+
+        body[ benches[ i ].body_length ] = 0;
+        call.message     = benches[ i ].message;
+        call.body_length = benches[ i ].body_length;
+        printf( "%-18s %10.1f %10.1f %12d %12d\n", benches[ i ].name,
+                time_call( reference_encode, &call ), time_call( encode, &call ),
+                stack_depth( reference_encode, &call ) - baseline, stack_depth( encode, &call ) - baseline );
+        body[ benches[ i ].body_length ] = saved;
+    }
+
+    printf( ( mismatches != 0 ) ? "FAIL\n" : "PASS\n" );
+    return ( mismatches != 0 );
+}
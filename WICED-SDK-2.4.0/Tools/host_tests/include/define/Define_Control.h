@@ -0,0 +1,2 @@
+/* GMMP_Operation.c includes "../define/Define_Control.h"; the directory is Define in the tree */
+#include "../../../../Apps/wizfi_wiced/GMMP_lib/Define/Define_Control.h"
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  Network, RTOS and clock models for the DNS client tests (dns/dns_host.c)
+ *
+ *  Time is simulated. It only moves when every thread is blocked in
+ *  wiced_udp_receive() or dns_host_wait(), and then jumps to the next
+ *  answer or timeout, so a test runs as fast as the host allows and the
+ *  times it measures do not depend on the host. Threads are real pthreads.
+ *
+ *  Queries sent to port 53 of a fake server are answered from the zone
+ *  after the server's round trip time, unless lost. A fake server answers
+ *  a CNAME with the whole chain, as recursive servers do, unless told to
+ *  answer with the first alias only.
+ */
+#pragma once
+
+#include "wiced_tcpip.h"
+#include "dns.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define DNS_HOST_MAXIMUM_SERVERS    (4)
+
+/* The clock starts this long before wiced_time_t wraps, so expiry times cross the wrap */
+#define DNS_HOST_START_BEFORE_WRAP  (100 * 1000)
+
+/* The address forged answers carry, host order */
+#define DNS_HOST_SPOOFED_ADDRESS    (0x06060606)
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/* A record in the zone. An alias is a CNAME; a name without records does not exist */
+typedef struct
+{
+    const char* name;
+    uint32_t    ttl;
+    uint32_t    address;    /* A record, host order. Zero for a CNAME */
+    const char* alias;      /* CNAME target, otherwise NULL */
+} dns_host_record_t;
+
+typedef struct
+{
+    uint32_t     address;           /* IPv4, host order */
+    uint32_t     rtt_ms;
+    uint32_t     jitter_ms;         /* Added to the round trip, evenly spread */
+    uint32_t     loss_percent;      /* Chance of losing a query, and again of losing its answer */
+    uint8_t      response_code;     /* Answer every query with this error, if not DNS_NO_ERROR */
+    wiced_bool_t first_alias_only;  /* Answer a CNAME without following it */
+    wiced_bool_t spoof;             /* Send forged answers ahead of each real one */
+
+    /* Counters */
+    uint32_t     queries;           /* Received, including those then lost */
+    uint32_t     answers;           /* Sent and not lost */
+} dns_host_server_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+
+/* Set by the test before use, and under dns_host_lock() while other threads run */
+extern dns_host_server_t        dns_host_servers[ DNS_HOST_MAXIMUM_SERVERS ];
+extern uint32_t                 dns_host_server_count;
+extern const dns_host_record_t* dns_host_zone;
+extern uint32_t                 dns_host_zone_size;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/* Seeds the random numbers of the model and of wiced_wifi_get_random(). Call first */
+void     dns_host_init( uint32_t seed );
+
+/* Simulated time in milliseconds since the model started */
+uint64_t dns_host_elapsed_ms( void );
+
+/* Lets simulated time pass */
+void     dns_host_sleep( uint32_t milliseconds );
+
+/* Blocks until condition( arg ) holds, which other threads change under dns_host_lock() */
+void     dns_host_wait( wiced_bool_t (*condition)( void* arg ), void* arg );
+
+/* Guards test state shared with the threads. Unlocking wakes dns_host_wait() */
+void     dns_host_lock( void );
+void     dns_host_unlock( void );
+
+/* Leak checks */
+uint32_t dns_host_packets_outstanding( void );
+uint32_t dns_host_sockets_open( void );
+
+/* Answers which arrived for a socket that had been deleted */
+uint32_t dns_host_answers_dropped( void );
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,19 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  Forced into every host test build ahead of the SDK headers.
+ */
+#pragma once
+
+/* wiced_utilities.h defines these as functions, which clash with the glibc macros */
+#include <endian.h>
+#undef htobe16
+#undef htobe32
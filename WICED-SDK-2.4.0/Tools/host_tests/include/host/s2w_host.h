@@ -0,0 +1,32 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  Included at the top of the functions the Makefile cuts out of
+ *  wx_s2w_process.c, and by the tests that call them.
+ */
+#pragma once
+
+#include "wx_defines.h"
+#include "wiced_platform.h"
+#include "platform_common_config.h"
+
+/* Defined in wx_s2w_process.c outside the functions cut out */
+extern UINT8               g_auto_esc;
+extern wiced_timed_event_t g_autoesc_timer;
+extern wiced_queue_t       g_queue_handle_maincommand;
+
+/* Declared in wx_s2w_process.c itself */
+void ProcessActionButtonClicked( uint32_t BtnClickCount );
+void action_after_linkup_callback( );
+void check_psocketlist_and_process_basedon_scon1_option( );
+
+/* Called by the weak stub of each command handler the test does not define */
+UINT8 host_command( const char* name, UINT8* ptr );
@@ -0,0 +1,2 @@
+/* MQTTConsole.h includes "wiced_mqtt/mqtt_api.h"; the directory is wiced_MQTT in the tree */
+#include "../../../../Apps/wizfi_wiced/wiced_MQTT/mqtt_api.h"
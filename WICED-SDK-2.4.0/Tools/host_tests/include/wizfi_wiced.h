@@ -0,0 +1,3 @@
+/* wx_defines.h includes "../wizfi_wiced.h", whose file name is upper case in the tree.
+ * include/host is on the include path, so the lookup ends up here on a case-sensitive host. */
+#include "../../../Apps/wizfi_wiced/wizfi_wiced.H"
@@ -0,0 +1,554 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  HTTP server gzip decompressor against gzip
+ *
+ *  Each input, the given files and a set of generated ones, is compressed
+ *  by the gzip command at levels 1, 6 and 9 and by text_to_c.pl --gzip as
+ *  the build does for resources, then decompressed with inflate_gzip().
+ *  gzip output is decompressed with a 32 KB window and again with the 2 KB
+ *  window the HTTP server keeps, which must either give the same data or
+ *  refuse it. text_to_c.pl output is decompressed with both windows too.
+ *  Every compressed input is also decompressed truncated, with a byte
+ *  changed, and with an output function which gives up.
+ *
+ *  Fails if decompressed data differs from the input or from the CRC and
+ *  size in the gzip trailer, if a piece passed on is longer than the
+ *  window, if truncated data or a failed output function is not reported,
+ *  or if stored, fixed and dynamic blocks are not all seen.
+ *
+ *  Usage: inflate_test text_to_c.pl [file...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "inflate.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define GZIP_HEADER_LENGTH       (10)
+#define GZIP_TRAILER_LENGTH      (8)
+#define GZIP_WINDOW_BITS         (15)
+#define RESOURCE_WINDOW_BITS     (11)   /* WICED_GZIP_RESOURCE_WINDOW_BITS in http_server.h */
+#define CORRUPTIONS_PER_INPUT    (20)
+#define MAX_GENERATED_INPUTS     (16)
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct
+{
+    const char* name;
+    const char* command;        /* Given the input file name */
+    int         c_array;        /* Output is text_to_c.pl C source */
+    uint8_t     window_bits;    /* Window the compressor used */
+} compressor_t;
+
+typedef struct
+{
+    const char* name;
+    uint8_t*    data;
+    uint32_t    length;
+} input_t;
+
+/* Receives inflate_gzip() output and checks it against the input as it comes */
+typedef struct
+{
+    const uint8_t* expected;
+    uint32_t       expected_length;
+    uint32_t       window_size;
+    uint32_t       received;
+    uint32_t       pieces;
+    uint32_t       stop_after;      /* Fail the output function on this piece; zero for never */
+    uint32_t       crc;
+    int            differs;
+    int            piece_too_long;
+} output_check_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static char          text_to_c_command[ 512 ];
+static compressor_t  compressors[ ] =
+{
+    { "gzip -1",        "gzip -c -n -1 '%s'", 0, GZIP_WINDOW_BITS     },
+    { "gzip -6",        "gzip -c -n -6 '%s'", 0, GZIP_WINDOW_BITS     },
+    { "gzip -9",        "gzip -c -n -9 '%s'", 0, GZIP_WINDOW_BITS     },
+    { "text_to_c.pl",   text_to_c_command,    1, RESOURCE_WINDOW_BITS },
+};
+
+static uint32_t crc_table[ 256 ];
+static uint32_t random_state = 1;
+static unsigned errors;
+static unsigned block_types[ 4 ];
+static unsigned refused_for_window;
+static unsigned corruptions_reported;
+static unsigned corruptions_tried;
+static uint64_t bytes_inflated;
+static uint64_t inflate_ns;
+
+static const char* const words[ ] =
+{
+    "<div", "class=\"", "</div>", "<input", "type=\"text\"", "name=", "value=", "<td>", "</td>", "<tr>", "</tr>",
+    "wifi", "ssid", "channel", "security", "WPA2", "station", "access", "point", "serial", "baud", "115200",
+    "the", "of", "and", "to", "setting", "\n", "\r\n", "    ", "=", ";", "function", "return", "var", "{", "}",
+};
+
+/******************************************************
+ *               Reference functions
+ ******************************************************/
+
+static uint32_t random_next( void )
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static void crc_init( void )
+{
+    uint32_t i;
+    uint32_t bit;
+
+    for ( i = 0; i < 256; i++ )
+    {
+        uint32_t c = i;
+        for ( bit = 0; bit < 8; bit++ )
+        {
+            c = ( c & 1 ) ? ( 0xEDB88320 ^ ( c >> 1 ) ) : ( c >> 1 );
+        }
+        crc_table[ i ] = c;
+    }
+}
+
+/* CRC-32 as in the gzip trailer; crc starts at zero */
+static uint32_t crc_update( uint32_t crc, const uint8_t* data, uint32_t length )
+{
+    crc = ~crc;
+    while ( length-- != 0 )
+    {
+        crc = crc_table[ ( crc ^ *data++ ) & 0xFF ] ^ ( crc >> 8 );
+    }
+    return ~crc;
+}
+
+static uint32_t get_le32( const uint8_t* data )
+{
+    return (uint32_t) data[ 0 ] | ( (uint32_t) data[ 1 ] << 8 ) | ( (uint32_t) data[ 2 ] << 16 ) | ( (uint32_t) data[ 3 ] << 24 );
+}
+
+static uint64_t now_ns( void )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+/******************************************************
+ *               Compressors
+ ******************************************************/
+
+/* Runs a compressor over the input and returns what it wrote, or NULL */
+static uint8_t* compress_input( const compressor_t* compressor, const input_t* input, uint32_t* compressed_length )
+{
+    char     file_name[ ] = "/tmp/inflate_test_XXXXXX";
+    char     command[ 1024 ];
+    uint8_t* output          = NULL;
+    uint32_t output_length   = 0;
+    uint32_t output_capacity = 0;
+    FILE*    pipe;
+    int      fd;
+
+    fd = mkstemp( file_name );
+    if ( ( fd < 0 ) || ( write( fd, input->data, input->length ) != (ssize_t) input->length ) )
+    {
+        printf( "can't write %s\n", file_name );
+        exit( 1 );
+    }
+    close( fd );
+
+    snprintf( command, sizeof( command ), compressor->command, file_name );
+    pipe = popen( command, "r" );
+    if ( pipe != NULL )
+    {
+        size_t read_length;
+        do
+        {
+            if ( output_length + 4096 > output_capacity )
+            {
+                output_capacity = output_capacity * 2 + 8192;
+                output          = realloc( output, output_capacity + 1 );
+            }
+            read_length    = fread( &output[ output_length ], 1, output_capacity - output_length, pipe );
+            output_length += (uint32_t) read_length;
+        } while ( read_length != 0 );
+        if ( pclose( pipe ) != 0 )
+        {
+            free( output );
+            output = NULL;
+        }
+    }
+    unlink( file_name );
+    if ( output == NULL )
+    {
+        printf( "%s failed on %s\n", compressor->name, input->name );
+        return NULL;
+    }
+
+    /* text_to_c.pl writes the bytes out as a C array */
+    if ( compressor->c_array )
+    {
+        char*    text = (char*) output;
+        char*    end;
+        uint32_t length = 0;
+
+        text[ output_length ] = '\0';
+        text = strstr( text, "= {" );
+        while ( ( text != NULL ) && ( ( text = strstr( text, "0x" ) ) != NULL ) )
+        {
+            output[ length++ ] = (uint8_t) strtoul( text, &end, 16 );
+            text = end;
+        }
+        output_length = length;
+    }
+
+    *compressed_length = output_length;
+    return output;
+}
+
+/******************************************************
+ *               Checks
+ ******************************************************/
+
+static wiced_result_t check_output( void* arg, const uint8_t* data, uint16_t length )
+{
+    output_check_t* check = (output_check_t*) arg;
+
+    check->pieces++;
+    if ( ( length == 0 ) || ( length > check->window_size ) )
+    {
+        check->piece_too_long = 1;
+    }
+    if ( ( check->received + length > check->expected_length ) ||
+         ( memcmp( data, &check->expected[ check->received ], length ) != 0 ) )
+    {
+        check->differs = 1;
+    }
+    check->crc       = crc_update( check->crc, data, length );
+    check->received += length;
+
+    if ( check->pieces == check->stop_after )
+    {
+        return WICED_PARTIAL_RESULTS;
+    }
+    return WICED_SUCCESS;
+}
+
+static wiced_result_t run_inflate( const uint8_t* gzip_data, uint32_t gzip_length, uint8_t window_bits, const input_t* input, uint32_t stop_after, output_check_t* check )
+{
+    wiced_result_t result;
+    uint64_t       start;
+
+    memset( check, 0, sizeof( *check ) );
+    check->expected        = input->data;
+    check->expected_length = input->length;
+    check->window_size     = 1u << window_bits;
+    check->stop_after      = stop_after;
+
+    start  = now_ns( );
+    result = inflate_gzip( gzip_data, gzip_length, window_bits, check_output, check );
+    if ( ( result == WICED_SUCCESS ) && ( stop_after == 0 ) )
+    {
+        inflate_ns     += now_ns( ) - start;
+        bytes_inflated += check->received;
+    }
+    return result;
+}
+
+/* Decompresses complete data, which must succeed unless allowed to refuse it for the window size */
+static void check_complete( const compressor_t* compressor, const input_t* input, const uint8_t* gzip_data, uint32_t gzip_length, uint8_t window_bits )
+{
+    output_check_t check;
+    wiced_result_t result = run_inflate( gzip_data, gzip_length, window_bits, input, 0, &check );
+
+    if ( ( result == WICED_ERROR ) && ( window_bits < compressor->window_bits ) && !check.differs && !check.piece_too_long )
+    {
+        refused_for_window++;
+        return;
+    }
+    if ( ( result != WICED_SUCCESS ) || check.differs || check.piece_too_long || ( check.received != input->length ) ||
+         ( check.crc != get_le32( &gzip_data[ gzip_length - 8 ] ) ) || ( check.received != get_le32( &gzip_data[ gzip_length - 4 ] ) ) )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "%s, %s, %u bit window: result %d, %u of %u bytes%s%s, crc %08x trailer %08x\n", input->name, compressor->name,
+                    window_bits, result, check.received, input->length, check.differs ? ", differs" : "",
+                    check.piece_too_long ? ", piece too long" : "", check.crc, get_le32( &gzip_data[ gzip_length - 8 ] ) );
+        }
+    }
+}
+
+static void check_compressed( const compressor_t* compressor, const input_t* input, uint8_t* gzip_data, uint32_t gzip_length )
+{
+    output_check_t check;
+    wiced_result_t result;
+    uint32_t       cut;
+    unsigned       i;
+
+    if ( ( gzip_length < GZIP_HEADER_LENGTH + GZIP_TRAILER_LENGTH ) || ( gzip_data[ 3 ] != 0 ) ||
+         ( inflate_gzip_length( gzip_data, gzip_length ) != input->length ) )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "%s, %s: %u bytes of gzip data, flags %02x, inflate_gzip_length %u\n", input->name, compressor->name,
+                    gzip_length, ( gzip_length > 3 ) ? gzip_data[ 3 ] : 0, inflate_gzip_length( gzip_data, gzip_length ) );
+        }
+        return;
+    }
+    block_types[ ( gzip_data[ GZIP_HEADER_LENGTH ] >> 1 ) & 3 ]++;
+
+    check_complete( compressor, input, gzip_data, gzip_length, compressor->window_bits );
+    check_complete( compressor, input, gzip_data, gzip_length, ( compressor->window_bits == GZIP_WINDOW_BITS ) ? RESOURCE_WINDOW_BITS : GZIP_WINDOW_BITS );
+
+    /* Truncated data always loses the end of the last block */
+    for ( cut = 1; cut < gzip_length - GZIP_HEADER_LENGTH - GZIP_TRAILER_LENGTH; cut = cut * 3 + 1 )
+    {
+        result = run_inflate( gzip_data, gzip_length - cut, GZIP_WINDOW_BITS, input, 0, &check );
+        if ( ( result == WICED_SUCCESS ) || check.piece_too_long )
+        {
+            if ( errors++ < 10 )
+            {
+                printf( "%s, %s: %u bytes cut off, result %d\n", input->name, compressor->name, cut, result );
+            }
+        }
+    }
+
+    /* A changed byte need not be noticed, as there is no CRC check, but must be survived */
+    for ( i = 0; i < CORRUPTIONS_PER_INPUT; i++ )
+    {
+        uint32_t position = GZIP_HEADER_LENGTH + random_next( ) % ( gzip_length - GZIP_HEADER_LENGTH - GZIP_TRAILER_LENGTH );
+        uint8_t  original = gzip_data[ position ];
+
+        gzip_data[ position ] = (uint8_t) ( original ^ ( 1 + random_next( ) % 255 ) );
+        result = run_inflate( gzip_data, gzip_length, GZIP_WINDOW_BITS, input, 0, &check );
+        gzip_data[ position ] = original;
+
+        corruptions_tried++;
+        corruptions_reported += ( result != WICED_SUCCESS ) ? 1 : 0;
+        if ( check.piece_too_long )
+        {
+            if ( errors++ < 10 )
+            {
+                printf( "%s, %s: byte %u changed, piece longer than the window\n", input->name, compressor->name, position );
+            }
+        }
+    }
+
+    /* The output function's error ends decompression */
+    if ( input->length > ( 2u << RESOURCE_WINDOW_BITS ) )
+    {
+        result = run_inflate( gzip_data, gzip_length, RESOURCE_WINDOW_BITS, input, 1, &check );
+        if ( ( ( result != WICED_PARTIAL_RESULTS ) && ( compressor->window_bits == RESOURCE_WINDOW_BITS ) ) || ( check.pieces > 1 ) )
+        {
+            if ( errors++ < 10 )
+            {
+                printf( "%s, %s: output function failed, result %d after %u pieces\n", input->name, compressor->name, result, check.pieces );
+            }
+        }
+    }
+}
+
+/******************************************************
+ *               Inputs
+ ******************************************************/
+
+static input_t make_input( const char* name, uint32_t length )
+{
+    input_t input;
+
+    input.name   = name;
+    input.length = length;
+    input.data   = malloc( length + 1 );
+    return input;
+}
+
+static unsigned generate_inputs( input_t* inputs )
+{
+    unsigned count = 0;
+    uint32_t i;
+
+    inputs[ count++ ] = make_input( "empty", 0 );
+
+    inputs[ count ] = make_input( "one byte", 1 );
+    inputs[ count++ ].data[ 0 ] = 'a';
+
+    inputs[ count ] = make_input( "short text", 13 );
+    memcpy( inputs[ count++ ].data, "Hello, world!", 13 );
+
+    /* Incompressible, so stored blocks, and longer than one stored block */
+    inputs[ count ] = make_input( "random 100 KB", 100000 );
+    for ( i = 0; i < inputs[ count ].length; i++ )
+    {
+        inputs[ count ].data[ i ] = (uint8_t) random_next( );
+    }
+    count++;
+
+    /* Distance 1, length 258 matches */
+    inputs[ count ] = make_input( "one byte repeated", 70000 );
+    memset( inputs[ count++ ].data, 'x', 70000 );
+
+    inputs[ count ] = make_input( "every byte value", 256 * 300 );
+    for ( i = 0; i < inputs[ count ].length; i++ )
+    {
+        inputs[ count ].data[ i ] = (uint8_t) ( i * 7 + ( i >> 8 ) );
+    }
+    count++;
+
+    /* Random blocks repeated at exactly the 2 KB and 32 KB window distances */
+    inputs[ count ] = make_input( "2 KB repeated", 2048 * 10 );
+    for ( i = 0; i < inputs[ count ].length; i++ )
+    {
+        inputs[ count ].data[ i ] = ( i < 2048 ) ? (uint8_t) random_next( ) : inputs[ count ].data[ i - 2048 ];
+    }
+    count++;
+
+    inputs[ count ] = make_input( "32 KB repeated", 32768 * 3 );
+    for ( i = 0; i < inputs[ count ].length; i++ )
+    {
+        inputs[ count ].data[ i ] = ( i < 32768 ) ? (uint8_t) random_next( ) : inputs[ count ].data[ i - 32768 ];
+    }
+    count++;
+
+    /* Page-like text, so dynamic blocks with matches at every distance */
+    inputs[ count ] = make_input( "generated text", 200000 );
+    for ( i = 0; i < inputs[ count ].length; )
+    {
+        const char* word   = words[ random_next( ) % ( sizeof( words ) / sizeof( words[ 0 ] ) ) ];
+        uint32_t    length = (uint32_t) strlen( word );
+
+        if ( i + length + 1 > inputs[ count ].length )
+        {
+            length = inputs[ count ].length - i - 1;
+        }
+        memcpy( &inputs[ count ].data[ i ], word, length );
+        i += length;
+        inputs[ count ].data[ i++ ] = ' ';
+    }
+    count++;
+
+    return count;
+}
+
+static int read_input( const char* file_name, input_t* input )
+{
+    FILE* file = fopen( file_name, "rb" );
+    long  length;
+
+    if ( file == NULL )
+    {
+        return 0;
+    }
+    fseek( file, 0, SEEK_END );
+    length = ftell( file );
+    fseek( file, 0, SEEK_SET );
+    *input = make_input( file_name, (uint32_t) length );
+    if ( fread( input->data, 1, (size_t) length, file ) != (size_t) length )
+    {
+        fclose( file );
+        return 0;
+    }
+    fclose( file );
+    return 1;
+}
+
+/******************************************************
+ *               Test
+ ******************************************************/
+
+int main( int argc, char* argv[ ] )
+{
+    input_t  generated[ MAX_GENERATED_INPUTS ];
+    unsigned generated_count;
+    unsigned input_count = 0;
+    unsigned files       = 0;
+    uint64_t plain_bytes = 0;
+    uint64_t gzip_bytes[ sizeof( compressors ) / sizeof( compressors[ 0 ] ) ] = { 0 };
+    unsigned i;
+    unsigned c;
+    int      failed;
+
+    if ( argc < 2 )
+    {
+        printf( "Usage: inflate_test text_to_c.pl [file...]\n" );
+        return 1;
+    }
+    snprintf( text_to_c_command, sizeof( text_to_c_command ), "perl '%s' --gzip resource '%%s' 2>/dev/null", argv[ 1 ] );
+    crc_init( );
+    generated_count = generate_inputs( generated );
+
+    for ( i = 0; i < generated_count + (unsigned) argc - 2; i++ )
+    {
+        input_t input;
+
+        if ( i < generated_count )
+        {
+            input = generated[ i ];
+        }
+        else if ( !read_input( argv[ i - generated_count + 2 ], &input ) )
+        {
+            printf( "can't read %s\nFAIL\n", argv[ i - generated_count + 2 ] );
+            return 1;
+        }
+        else
+        {
+            files++;
+        }
+        input_count++;
+        plain_bytes += input.length;
+
+        for ( c = 0; c < sizeof( compressors ) / sizeof( compressors[ 0 ] ); c++ )
+        {
+            uint32_t gzip_length;
+            uint8_t* gzip_data = compress_input( &compressors[ c ], &input, &gzip_length );
+
+            if ( gzip_data == NULL )
+            {
+                printf( "FAIL\n" );
+                return 1;
+            }
+            gzip_bytes[ c ] += gzip_length;
+            check_compressed( &compressors[ c ], &input, gzip_data, gzip_length );
+            free( gzip_data );
+        }
+        free( input.data );
+    }
+
+    printf( "%u inputs (%u files), %llu bytes:", input_count, files, (unsigned long long) plain_bytes );
+    for ( c = 0; c < sizeof( compressors ) / sizeof( compressors[ 0 ] ); c++ )
+    {
+        printf( "%s %s %llu", ( c == 0 ) ? "" : ",", compressors[ c ].name, (unsigned long long) gzip_bytes[ c ] );
+    }
+    printf( "\nfirst blocks: %u stored, %u fixed, %u dynamic, %u invalid\n", block_types[ 0 ], block_types[ 1 ], block_types[ 2 ], block_types[ 3 ] );
+    printf( "%u gzip -N decompressions refused by the %u byte window\n", refused_for_window, 1u << RESOURCE_WINDOW_BITS );
+    printf( "%u of %u changed bytes reported\n", corruptions_reported, corruptions_tried );
+    printf( "inflated %llu bytes at %.1f MB/s\n", (unsigned long long) bytes_inflated,
+            ( inflate_ns != 0 ) ? (double) bytes_inflated * 1000.0 / (double) inflate_ns : 0.0 );
+    printf( "%u errors\n", errors );
+
+    failed = ( errors != 0 ) || ( block_types[ 0 ] == 0 ) || ( block_types[ 1 ] == 0 ) || ( block_types[ 2 ] == 0 );
+    printf( failed ? "FAIL\n" : "PASS\n" );
+    return failed;
+}
@@ -0,0 +1,691 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  SDPCM IOCTLs against a fake firmware which answers out of order
+ *
+ *  SDPCM.c is built with a 200 ms IOCTL timeout. A firmware thread, which
+ *  also plays the WWD thread, takes control frames off the SDPCM send
+ *  queue, returns bus credits, and answers each request after a random
+ *  delay, so answers overtake each other. By a rule the callers know too,
+ *  some requests fail with an error status, some are never answered and
+ *  some are answered after their caller has timed out. Each answer carries
+ *  the request's data, changed in a way its caller can check.
+ *
+ *  One thread first starts WICED_MAX_PENDING_IOCTLS IOCTLs at a time with
+ *  wiced_send_ioctl_start() and collects them with wiced_wait_ioctl() in a
+ *  random order. Then several threads, more than there are table entries,
+ *  call wiced_send_ioctl() at once.
+ *
+ *  Fails if a caller is given another caller's answer, a wrong result or a
+ *  wrong status, if a late answer is not dropped and counted, or if a
+ *  buffer leaks. The time taken is reported against the time the same
+ *  answers would take one IOCTL at a time.
+ *
+ *  Usage: ioctl_fw_test [ioctls_per_thread [seed]]
+ */
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "internal/SDPCM.h"
+#include "wwd_rtos.h"
+#include "wwd_buffer.h"
+#include "internal/wwd_internal.h"
+#include "internal/wwd_thread.h"
+#include "RTOS/wwd_rtos_interface.h"
+#include "Network/wwd_buffer_interface.h"
+#include "Network/wwd_network_interface.h"
+#include "internal/Bus_protocols/wwd_bus_protocol_interface.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+/* As in SDPCM.c */
+#define SDPCM_HEADER_LENGTH     (12)
+#define CDC_HEADER_LENGTH       (16)
+#define CHANNEL_CONTROL         (0)
+#define CDCF_IOC_ERROR          (0x01)
+#define CDCF_IOC_ID_SHIFT       (16)
+#define MAX_PENDING_IOCTLS      (4)     /* WICED_MAX_PENDING_IOCTLS */
+#define IOCTL_TIMEOUT_MS        (200)   /* WICED_IOCTL_TIMEOUT_MS, as built */
+
+#define CALLER_THREADS          (6)
+#define PIPELINED_CALLER        (CALLER_THREADS)
+#define MAX_REQUEST_DATA        (64)
+#define WLAN_CREDIT_WINDOW      (7)
+#define MAX_FIRMWARE_PENDING    (256)
+
+/* Answers on time come within ANSWER_MAX_MS; late ones well after the timeout */
+#define ANSWER_MAX_MS           (10)
+#define LATE_MIN_MS             (IOCTL_TIMEOUT_MS + 100)
+#define LATE_MAX_MS             (IOCTL_TIMEOUT_MS + 150)
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+struct NX_PACKET_STRUCT
+{
+    uint8_t* data;
+    uint16_t size;
+    uint16_t capacity;
+    uint8_t  storage[ 1 ];
+};
+
+/* As in SDPCM.c */
+typedef struct
+{
+    uint32_t cmd;
+    uint32_t len;
+    uint32_t flags;
+    uint32_t status;
+} cdc_header_t;
+
+typedef enum
+{
+    OUTCOME_ANSWER,
+    OUTCOME_ERROR,      /* Answered with CDCF_IOC_ERROR and a status */
+    OUTCOME_NEVER,      /* Never answered */
+    OUTCOME_LATE,       /* Answered after the caller has timed out */
+} outcome_t;
+
+/* Start of every request's data: who sent it */
+typedef struct
+{
+    uint32_t caller;
+    uint32_t index;
+    uint32_t length;
+} request_tag_t;
+
+typedef struct
+{
+    uint32_t cmd;
+    uint32_t flags;
+    uint32_t length;
+    uint32_t due_ms;
+    uint32_t order;         /* Order in which the firmware received it */
+    uint8_t  data[ MAX_REQUEST_DATA ];
+} firmware_request_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+/* Defined next to SDPCM.c on the target */
+wiced_bool_t        monitor_mode_enabled = WICED_FALSE;
+wiced_wlan_status_t wiced_wlan_status;
+
+static long buffers_outstanding;
+
+/* Firmware */
+static pthread_mutex_t    firmware_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t     firmware_wake  = PTHREAD_COND_INITIALIZER;
+static int                firmware_notified;
+static int                firmware_stop;
+static firmware_request_t firmware_pending[ MAX_FIRMWARE_PENDING ];
+static unsigned           firmware_pending_count;
+static uint8_t            firmware_credit;
+static uint8_t            firmware_received;
+static uint32_t           firmware_order;
+static unsigned           answered_out_of_order;
+static unsigned           late_answers_sent;
+static unsigned           seed;
+
+/* Callers */
+static unsigned ioctls_per_thread;
+static unsigned results_checked;
+static unsigned errors;
+static unsigned expected_timeouts;
+static unsigned expected_late;
+static uint64_t serial_ms;      /* Time the answers would take one IOCTL at a time */
+
+/******************************************************
+ *               Buffer and RTOS models
+ ******************************************************/
+
+static uint32_t now_ms( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (uint32_t) ( now.tv_sec * 1000 + now.tv_nsec / 1000000 );
+}
+
+wiced_result_t host_buffer_get( wiced_buffer_t* buffer, wiced_buffer_dir_t direction, unsigned short size, wiced_bool_t wait )
+{
+    (void) direction;
+    (void) wait;
+    *buffer = malloc( sizeof( struct NX_PACKET_STRUCT ) + size );
+    ( *buffer )->data     = ( *buffer )->storage;
+    ( *buffer )->size     = size;
+    ( *buffer )->capacity = size;
+    __sync_fetch_and_add( &buffers_outstanding, 1 );
+    return WICED_SUCCESS;
+}
+
+void host_buffer_release( wiced_buffer_t buffer, wiced_buffer_dir_t direction )
+{
+    (void) direction;
+    free( buffer );
+    __sync_fetch_and_sub( &buffers_outstanding, 1 );
+}
+
+uint8_t* host_buffer_get_current_piece_data_pointer( wiced_buffer_t buffer )
+{
+    return buffer->data;
+}
+
+uint16_t host_buffer_get_current_piece_size( wiced_buffer_t buffer )
+{
+    return buffer->size;
+}
+
+wiced_result_t host_buffer_add_remove_at_front( wiced_buffer_t* buffer, int32_t add_remove_amount )
+{
+    wiced_buffer_t b = *buffer;
+
+    if ( ( b->data + add_remove_amount < b->storage ) || ( add_remove_amount > (int32_t) b->size ) )
+    {
+        return WICED_ERROR;
+    }
+    b->data += add_remove_amount;
+    b->size  = (uint16_t) ( b->size - add_remove_amount );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_buffer_set_data_end( wiced_buffer_t buffer, uint8_t* end_of_data )
+{
+    buffer->size = (uint16_t) ( end_of_data - buffer->data );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_rtos_init_semaphore( host_semaphore_type_t* semaphore )
+{
+    sem_t* host_semaphore = malloc( sizeof( *host_semaphore ) );
+
+    sem_init( host_semaphore, 0, 0 );
+    *(sem_t**) semaphore = host_semaphore;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_rtos_deinit_semaphore( host_semaphore_type_t* semaphore )
+{
+    sem_destroy( *(sem_t**) semaphore );
+    free( *(sem_t**) semaphore );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_rtos_get_semaphore( host_semaphore_type_t* semaphore, uint32_t timeout_ms, wiced_bool_t will_set_in_isr )
+{
+    struct timespec deadline;
+
+    (void) will_set_in_isr;
+    if ( timeout_ms == NEVER_TIMEOUT )
+    {
+        return ( sem_wait( *(sem_t**) semaphore ) == 0 ) ? WICED_SUCCESS : WICED_ERROR;
+    }
+    clock_gettime( CLOCK_REALTIME, &deadline );
+    deadline.tv_nsec += (long) ( timeout_ms % 1000 ) * 1000000;
+    deadline.tv_sec  += timeout_ms / 1000 + deadline.tv_nsec / 1000000000;
+    deadline.tv_nsec %= 1000000000;
+    return ( sem_timedwait( *(sem_t**) semaphore, &deadline ) == 0 ) ? WICED_SUCCESS : WICED_TIMEOUT;
+}
+
+wiced_result_t host_rtos_set_semaphore( host_semaphore_type_t* semaphore, wiced_bool_t called_from_ISR )
+{
+    (void) called_from_ISR;
+    sem_post( *(sem_t**) semaphore );
+    return WICED_SUCCESS;
+}
+
+/* A frame was queued for the bus */
+void wiced_thread_notify( void )
+{
+    pthread_mutex_lock( &firmware_mutex );
+    firmware_notified = 1;
+    pthread_cond_signal( &firmware_wake );
+    pthread_mutex_unlock( &firmware_mutex );
+}
+
+wiced_result_t wiced_bus_set_flow_control( uint8_t value )
+{
+    (void) value;
+    return WICED_SUCCESS;
+}
+
+wiced_bool_t wiced_bus_is_flow_controlled( void )
+{
+    return WICED_FALSE;
+}
+
+wiced_bool_t wiced_wifi_is_packet_from_ap( uint8_t flags2 )
+{
+    (void) flags2;
+    return WICED_FALSE;
+}
+
+void host_network_process_ethernet_data( wiced_buffer_t buffer, wiced_interface_t interface )
+{
+    (void) interface;
+    host_buffer_release( buffer, WICED_NETWORK_RX );
+}
+
+/******************************************************
+ *               Fake firmware
+ ******************************************************/
+
+/* What the firmware does with a request, known to its caller as well */
+static outcome_t outcome_of( uint32_t caller, uint32_t index )
+{
+    uint32_t hash = ( caller * 2654435761u ) ^ ( index * 40503u + 0x9E37u );
+
+    hash = ( hash ^ ( hash >> 13 ) ) % 20;
+    return ( hash == 0 ) ? OUTCOME_NEVER : ( hash == 1 ) ? OUTCOME_LATE : ( hash < 4 ) ? OUTCOME_ERROR : OUTCOME_ANSWER;
+}
+
+static int32_t status_of( uint32_t caller, uint32_t index )
+{
+    return -(int32_t) ( 1 + ( caller + index ) % 30 );
+}
+
+static uint8_t answer_byte( uint8_t request_byte, uint32_t position )
+{
+    return (uint8_t) ( ~request_byte + position );
+}
+
+/* A frame from the WLAN, through the receive path of the WWD thread */
+static void firmware_send( uint16_t size, const cdc_header_t* cdc, const uint8_t* data, uint32_t length )
+{
+    wiced_buffer_t buffer;
+    uint8_t*       frame;
+    uint16_t       inverse = (uint16_t) ~size;
+
+    host_buffer_get( &buffer, WICED_NETWORK_RX, (unsigned short) ( sizeof( wiced_buffer_header_t ) + size ), WICED_FALSE );
+    frame = buffer->data + sizeof( wiced_buffer_header_t );
+    memset( frame, 0, size );
+    memcpy( frame, &size, 2 );
+    memcpy( frame + 2, &inverse, 2 );
+    frame[ 5 ] = CHANNEL_CONTROL;
+    frame[ 7 ] = SDPCM_HEADER_LENGTH;
+    frame[ 9 ] = firmware_credit;
+    if ( cdc != NULL )
+    {
+        memcpy( frame + SDPCM_HEADER_LENGTH, cdc, CDC_HEADER_LENGTH );
+        memcpy( frame + SDPCM_HEADER_LENGTH + CDC_HEADER_LENGTH, data, length );
+    }
+    wiced_process_sdpcm( buffer );
+}
+
+/* Takes every control frame the credits allow off the send queue */
+static void firmware_receive( void )
+{
+    wiced_buffer_t buffer;
+
+    while ( wiced_get_packet_to_send( &buffer ) == WICED_SUCCESS )
+    {
+        const uint8_t*       frame = buffer->data + sizeof( wiced_buffer_t );
+        cdc_header_t   cdc;
+        request_tag_t        tag;
+        firmware_request_t*  request;
+        uint32_t             length;
+        outcome_t            outcome;
+
+        if ( ( frame[ 4 ] != firmware_received ) || ( frame[ 5 ] != CHANNEL_CONTROL ) )
+        {
+            if ( errors++ < 10 )
+            {
+                printf( "control frame with sequence %u on channel %u, sequence %u expected\n", frame[ 4 ], frame[ 5 ], firmware_received );
+            }
+        }
+        firmware_received++;
+
+        memcpy( &cdc, frame + SDPCM_HEADER_LENGTH, CDC_HEADER_LENGTH );
+        length = ( cdc.len < MAX_REQUEST_DATA ) ? cdc.len : MAX_REQUEST_DATA;
+        memcpy( &tag, frame + SDPCM_HEADER_LENGTH + CDC_HEADER_LENGTH, sizeof( tag ) );
+        outcome = outcome_of( tag.caller, tag.index );
+
+        if ( ( outcome != OUTCOME_NEVER ) && ( firmware_pending_count < MAX_FIRMWARE_PENDING ) )
+        {
+            request         = &firmware_pending[ firmware_pending_count++ ];
+            request->cmd    = cdc.cmd;
+            request->flags  = cdc.flags;
+            request->length = length;
+            request->order  = firmware_order;
+            request->due_ms = now_ms( ) + ( ( outcome == OUTCOME_LATE ) ? LATE_MIN_MS + (uint32_t) rand_r( &seed ) % ( LATE_MAX_MS - LATE_MIN_MS )
+                                                                        : (uint32_t) rand_r( &seed ) % ( ANSWER_MAX_MS + 1 ) );
+            memcpy( request->data, frame + SDPCM_HEADER_LENGTH + CDC_HEADER_LENGTH, length );
+        }
+        firmware_order++;
+        host_buffer_release( buffer, WICED_NETWORK_TX );
+
+        /* The frame is consumed: tell the host it may send another */
+        firmware_credit = (uint8_t) ( firmware_received + WLAN_CREDIT_WINDOW );
+        firmware_send( SDPCM_HEADER_LENGTH, NULL, NULL, 0 );
+    }
+}
+
+/* Answers the requests which are due; returns the time the next one is */
+static uint32_t firmware_answer( void )
+{
+    uint32_t next_due = now_ms( ) + 1000;
+    unsigned i        = 0;
+
+    while ( i < firmware_pending_count )
+    {
+        firmware_request_t request = firmware_pending[ i ];
+        cdc_header_t cdc;
+        request_tag_t      tag;
+        uint8_t            answer[ MAX_REQUEST_DATA ];
+        uint32_t           position;
+        unsigned           j;
+
+        if ( (int32_t) ( request.due_ms - now_ms( ) ) > 0 )
+        {
+            next_due = ( (int32_t) ( request.due_ms - next_due ) < 0 ) ? request.due_ms : next_due;
+            i++;
+            continue;
+        }
+        firmware_pending[ i ] = firmware_pending[ --firmware_pending_count ];
+
+        /* Answered ahead of a request received earlier */
+        for ( j = 0; j < firmware_pending_count; j++ )
+        {
+            if ( firmware_pending[ j ].order < request.order )
+            {
+                answered_out_of_order++;
+                break;
+            }
+        }
+
+        memcpy( &tag, request.data, sizeof( tag ) );
+        memcpy( answer, request.data, sizeof( tag ) );
+        for ( position = sizeof( tag ); position < request.length; position++ )
+        {
+            answer[ position ] = answer_byte( request.data[ position ], position );
+        }
+        cdc.cmd    = request.cmd;
+        cdc.len    = request.length;
+        cdc.flags  = request.flags;
+        cdc.status = 0;
+        if ( outcome_of( tag.caller, tag.index ) == OUTCOME_ERROR )
+        {
+            cdc.flags  |= CDCF_IOC_ERROR;
+            cdc.status  = (uint32_t) status_of( tag.caller, tag.index );
+        }
+        if ( outcome_of( tag.caller, tag.index ) == OUTCOME_LATE )
+        {
+            late_answers_sent++;
+        }
+        firmware_send( (uint16_t) ( SDPCM_HEADER_LENGTH + CDC_HEADER_LENGTH + request.length ), &cdc, answer, request.length );
+    }
+    return next_due;
+}
+
+static void* firmware_thread( void* arg )
+{
+    (void) arg;
+    firmware_credit = WLAN_CREDIT_WINDOW;
+    firmware_send( SDPCM_HEADER_LENGTH, NULL, NULL, 0 );
+
+    pthread_mutex_lock( &firmware_mutex );
+    while ( !firmware_stop || ( firmware_pending_count != 0 ) )
+    {
+        uint32_t        next_due;
+        int32_t         wait_ms;
+        struct timespec deadline;
+
+        firmware_notified = 0;
+        pthread_mutex_unlock( &firmware_mutex );
+        firmware_receive( );
+        next_due = firmware_answer( );
+        pthread_mutex_lock( &firmware_mutex );
+
+        if ( firmware_notified )
+        {
+            continue;
+        }
+        wait_ms = (int32_t) ( next_due - now_ms( ) );
+        if ( wait_ms > 0 )
+        {
+            clock_gettime( CLOCK_REALTIME, &deadline );
+            deadline.tv_nsec += (long) ( wait_ms % 1000 ) * 1000000;
+            deadline.tv_sec  += wait_ms / 1000 + deadline.tv_nsec / 1000000000;
+            deadline.tv_nsec %= 1000000000;
+            pthread_cond_timedwait( &firmware_wake, &firmware_mutex, &deadline );
+        }
+    }
+    pthread_mutex_unlock( &firmware_mutex );
+    return NULL;
+}
+
+/******************************************************
+ *               Callers
+ ******************************************************/
+
+static void report( const char* format, uint32_t caller, uint32_t index, long value )
+{
+    if ( __sync_fetch_and_add( &errors, 1 ) < 10 )
+    {
+        printf( "caller %u IOCTL %u: ", caller, index );
+        printf( format, value );
+        printf( "\n" );
+    }
+}
+
+static uint32_t request_length( uint32_t caller, uint32_t index )
+{
+    return (uint32_t) sizeof( request_tag_t ) + ( caller * 7 + index * 13 ) % ( MAX_REQUEST_DATA - sizeof( request_tag_t ) );
+}
+
+static wiced_buffer_t make_request( uint32_t caller, uint32_t index )
+{
+    wiced_buffer_t buffer;
+    request_tag_t  tag    = { caller, index, request_length( caller, index ) };
+    uint8_t*       data   = wiced_get_ioctl_buffer( &buffer, (uint16_t) tag.length );
+    uint32_t       position;
+
+    memcpy( data, &tag, sizeof( tag ) );
+    for ( position = sizeof( tag ); position < tag.length; position++ )
+    {
+        data[ position ] = (uint8_t) ( caller * 31 + index * 17 + position );
+    }
+    return buffer;
+}
+
+/* Checks the result of one IOCTL against what the firmware was told to do */
+static void check_result( uint32_t caller, uint32_t index, wiced_result_t result, wiced_buffer_t response )
+{
+    outcome_t outcome = outcome_of( caller, index );
+    uint32_t  length  = request_length( caller, index );
+
+    __sync_fetch_and_add( &results_checked, 1 );
+    if ( ( outcome == OUTCOME_NEVER ) || ( outcome == OUTCOME_LATE ) )
+    {
+        __sync_fetch_and_add( &expected_timeouts, 1 );
+        __sync_fetch_and_add( &serial_ms, IOCTL_TIMEOUT_MS );
+        if ( outcome == OUTCOME_LATE )
+        {
+            __sync_fetch_and_add( &expected_late, 1 );
+        }
+        if ( result != WICED_TIMEOUT )
+        {
+            report( "result %ld, timeout expected", caller, index, (long) result );
+        }
+    }
+    else if ( outcome == OUTCOME_ERROR )
+    {
+        if ( ( result != (wiced_result_t) status_of( caller, index ) ) || ( response != NULL ) )
+        {
+            report( "result %ld, firmware error status expected", caller, index, (long) result );
+        }
+    }
+    else if ( ( result != WICED_SUCCESS ) || ( response == NULL ) )
+    {
+        report( "result %ld, answer expected", caller, index, (long) result );
+    }
+    else
+    {
+        const uint8_t* data = response->data;
+        request_tag_t  tag;
+        uint32_t       position;
+
+        memcpy( &tag, data, sizeof( tag ) );
+        if ( ( tag.caller != caller ) || ( tag.index != index ) || ( response->size != length ) )
+        {
+            report( "given the answer to caller %ld", caller, index, (long) tag.caller );
+        }
+        else
+        {
+            for ( position = sizeof( tag ); position < length; position++ )
+            {
+                if ( data[ position ] != answer_byte( (uint8_t) ( caller * 31 + index * 17 + position ), position ) )
+                {
+                    report( "answer differs at byte %ld", caller, index, (long) position );
+                    break;
+                }
+            }
+        }
+    }
+    if ( ( outcome == OUTCOME_ANSWER ) || ( outcome == OUTCOME_ERROR ) )
+    {
+        __sync_fetch_and_add( &serial_ms, ANSWER_MAX_MS / 2 );
+    }
+    if ( response != NULL )
+    {
+        host_buffer_release( response, WICED_NETWORK_RX );
+    }
+}
+
+/* Starts a table's worth of IOCTLs at a time and collects them in a random order, all by one deadline */
+static void run_pipelined( unsigned rounds )
+{
+    unsigned round;
+
+    for ( round = 0; round < rounds; round++ )
+    {
+        sdpcm_ioctl_handle_t handle[ MAX_PENDING_IOCTLS ];
+        uint32_t             index[ MAX_PENDING_IOCTLS ];
+        uint32_t             deadline = now_ms( ) + IOCTL_TIMEOUT_MS;
+        unsigned             i;
+
+        for ( i = 0; i < MAX_PENDING_IOCTLS; i++ )
+        {
+            index[ i ] = round * MAX_PENDING_IOCTLS + i;
+            if ( wiced_send_ioctl_start( SDPCM_GET, 100 + i, make_request( PIPELINED_CALLER, index[ i ] ), SDPCM_STA_INTERFACE, &handle[ i ] ) != WICED_SUCCESS )
+            {
+                report( "start failed%ld", PIPELINED_CALLER, index[ i ], 0 );
+            }
+        }
+        for ( i = MAX_PENDING_IOCTLS; i > 1; i-- )
+        {
+            unsigned             j = (unsigned) rand( ) % i;
+            sdpcm_ioctl_handle_t h = handle[ j ];
+            uint32_t             x = index[ j ];
+
+            handle[ j ] = handle[ i - 1 ];
+            index[ j ]  = index[ i - 1 ];
+            handle[ i - 1 ] = h;
+            index[ i - 1 ]  = x;
+        }
+        for ( i = 0; i < MAX_PENDING_IOCTLS; i++ )
+        {
+            int32_t        remaining = (int32_t) ( deadline - now_ms( ) );
+            wiced_buffer_t response  = NULL;
+            wiced_result_t result    = wiced_wait_ioctl( handle[ i ], ( remaining > 0 ) ? (uint32_t) remaining : 0, &response );
+
+            check_result( PIPELINED_CALLER, index[ i ], result, response );
+        }
+    }
+}
+
+static void* caller_thread( void* arg )
+{
+    uint32_t caller = (uint32_t) (uintptr_t) arg;
+    uint32_t index;
+
+    for ( index = 0; index < ioctls_per_thread; index++ )
+    {
+        wiced_buffer_t response = NULL;
+        wiced_result_t result   = wiced_send_ioctl( SDPCM_GET, 1 + index % 200, make_request( caller, index ), &response, SDPCM_STA_INTERFACE );
+
+        check_result( caller, index, result, response );
+    }
+    return NULL;
+}
+
+/******************************************************
+ *               Test
+ ******************************************************/
+
+int main( int argc, char** argv )
+{
+    pthread_t firmware;
+    pthread_t callers[ CALLER_THREADS ];
+    uint32_t  start_ms;
+    uint32_t  pipelined_ms;
+    uint32_t  concurrent_ms;
+    uint64_t  pipelined_serial_ms;
+    uint32_t  aborted;
+    uint32_t  late_replies;
+    unsigned  i;
+    int       failed;
+
+    ioctls_per_thread = ( argc > 1 ) ? (unsigned) atoi( argv[ 1 ] ) : 100;
+    seed              = ( argc > 2 ) ? (unsigned) atoi( argv[ 2 ] ) : 1;
+    srand( seed );
+
+    if ( wiced_init_sdpcm( ) != WICED_SUCCESS )
+    {
+        printf( "wiced_init_sdpcm failed\nFAIL\n" );
+        return 1;
+    }
+    pthread_create( &firmware, NULL, firmware_thread, NULL );
+
+    start_ms = now_ms( );
+    run_pipelined( ioctls_per_thread / MAX_PENDING_IOCTLS );
+    pipelined_ms        = now_ms( ) - start_ms;
+    pipelined_serial_ms = serial_ms;
+
+    start_ms = now_ms( );
+    for ( i = 0; i < CALLER_THREADS; i++ )
+    {
+        pthread_create( &callers[ i ], NULL, caller_thread, (void*) (uintptr_t) i );
+    }
+    for ( i = 0; i < CALLER_THREADS; i++ )
+    {
+        pthread_join( callers[ i ], NULL );
+    }
+    concurrent_ms = now_ms( ) - start_ms;
+
+    /* Let the late answers arrive, then stop the firmware */
+    pthread_mutex_lock( &firmware_mutex );
+    firmware_stop = 1;
+    pthread_cond_signal( &firmware_wake );
+    pthread_mutex_unlock( &firmware_mutex );
+    pthread_join( firmware, NULL );
+    wiced_get_ioctl_statistics( &aborted, &late_replies );
+    wiced_quit_sdpcm( );
+
+    printf( "%u IOCTLs: %u answered out of order, %u timed out, %u late answers sent\n",
+            results_checked, answered_out_of_order, expected_timeouts, late_answers_sent );
+    printf( "pipelined from one thread, %u at a time: %u ms, %u ms one at a time\n",
+            MAX_PENDING_IOCTLS, pipelined_ms, (unsigned) pipelined_serial_ms );
+    printf( "%u threads at once: %u ms, %u ms one at a time\n",
+            CALLER_THREADS, concurrent_ms, (unsigned) ( serial_ms - pipelined_serial_ms ) );
+    printf( "statistics: %u aborted (%u expected), %u late replies dropped (%u expected); %ld buffers leaked, %u errors\n",
+            aborted, expected_timeouts, late_replies, expected_late, buffers_outstanding, errors );
+
+    failed = ( errors != 0 ) || ( aborted != expected_timeouts ) || ( late_replies != expected_late ) ||
+             ( late_answers_sent != expected_late ) || ( buffers_outstanding != 0 );
+    printf( failed ? "FAIL\n" : "PASS\n" );
+    return failed;
+}
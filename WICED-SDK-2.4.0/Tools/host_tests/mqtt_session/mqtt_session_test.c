@@ -0,0 +1,935 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  MQTT in-flight window against a broker which acks out of order and drops acks
+ *
+ *  mqtt_manager() and the session run as on the MQTT thread: the test hands
+ *  them the application's publishes, subscribes and unsubscribes, the
+ *  broker's frames and a tick every simulated second. The frames the
+ *  manager writes go to a model of the broker, which answers each one after
+ *  a random delay, so acknowledgements arrive out of order. A share of the
+ *  acknowledgements is lost either way. The broker also publishes QoS 1 and 2 messages to
+ *  the client and resends them until they are acknowledged. Every few
+ *  minutes the connection drops, losing everything in flight, and comes back
+ *  with a CONNACK. The clock starts ten minutes before wiced_time_t wraps.
+ *
+ *  Fails if the session's counters or lists disagree with its items, if an
+ *  acknowledgement of one type frees an item of another, if a message is
+ *  resent before MQTT_SESSION_RETRANSMIT_TIMEOUT or left unsent after it,
+ *  if a resent PUBLISH lacks DUP or a first one carries it, if a QoS 2
+ *  PUBLISH is resent after its PUBREL, if a publish is refused while the
+ *  window has room or dropped without a PUBLISH_FAILED event, if an
+ *  accepted message does not reach the broker (a QoS 2 one exactly once),
+ *  or if a QoS 2 message from the broker reaches the application twice.
+ *
+ *  The window size is a build option; the Makefile builds the test with the
+ *  default and with windows of 64 and 255, and each build reports what an
+ *  acknowledgement costs with its window full.
+ *
+ *  Usage: mqtt_session_test [seconds [ack loss percent [seed]]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mqtt_internal.h"
+#include "mqtt_manager.h"
+#include "mqtt_session.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define START_BEFORE_WRAP_MS    (10 * 60 * 1000)
+#define STEP_MS                 (100)
+#define TICK_MS                 (1000)
+#define KEEP_ALIVE_SECONDS      (60)
+#define RECONNECT_INTERVAL_MS   (5 * 60 * 1000)     /* Mean time between dropped connections */
+#define DRAIN_LIMIT_MS          (10 * 60 * 1000)
+
+#define ANSWER_DELAY_MS         (2000)              /* Most time the broker takes to answer */
+#define BROKER_RESEND_MS        (20000)
+#define FIRST_PACKET_ID         (65000)             /* So the identifiers wrap during the run */
+
+#define MAXIMUM_MESSAGES        (200000)
+#define MAXIMUM_ANSWERS         (4096)
+#define BENCHMARK_ACKS          (2000000)
+
+/* Oracle indices of the item types the client resends */
+#define FLIGHT_PUBLISH          (0)
+#define FLIGHT_PUBREL           (1)
+#define FLIGHT_SUBSCRIBE        (2)
+#define FLIGHT_UNSUBSCRIBE      (3)
+#define FLIGHT_TYPES            (4)
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+typedef enum
+{
+    CONTEXT_APPLICATION,    /* The application or a broker frame made the manager send */
+    CONTEXT_TICK,
+    CONTEXT_CONNACK,
+} send_context_t;
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/* A message published by the client, or by the broker to the client */
+typedef struct
+{
+    uint16_t     packet_id;
+    uint8_t      qos;
+    wiced_bool_t refused;       /* PUBLISH_FAILED was reported */
+    wiced_bool_t released;      /* The broker has had PUBREL for it, or PUBREC from the client */
+    wiced_bool_t complete;      /* Acknowledged end to end */
+    uint32_t     delivered;     /* Times handed to the broker's subscribers, or to the application */
+    uint64_t     last_sent_ms;  /* Broker's own messages only */
+} message_t;
+
+/* A frame from the broker on its way to the client */
+typedef struct
+{
+    uint64_t       due_ms;
+    mqtt_event_t   event;
+    uint16_t       packet_id;
+    uint32_t       message;     /* Index into broker_messages for a PUBLISH */
+    uint8_t        qos;
+    wiced_bool_t   dup;
+} answer_t;
+
+/* When the session last started its resend timer for an item */
+typedef struct
+{
+    uint64_t timer_ms;
+    uint32_t message;           /* PUBLISH only */
+} flight_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+
+wiced_worker_thread_t wiced_networking_worker_thread;
+
+static mqtt_connection_t connection;
+static mqtt_session_t    session;
+static uint64_t          now_ms;
+static uint32_t          random_state = 1;
+static uint32_t          errors;
+static uint32_t          loss_percent;
+static send_context_t    context;
+static uint32_t          connack_resends;
+
+static message_t*        client_messages;
+static uint32_t          client_message_count;
+static message_t*        broker_messages;
+static uint32_t          broker_message_count;
+static uint32_t          client_id_message[ 65536 ];    /* Client message last sent under each identifier */
+static flight_t          flights[ FLIGHT_TYPES ][ 65536 ];
+
+static answer_t          answers[ MAXIMUM_ANSWERS ];
+static uint32_t          answer_count;
+
+/* Totals */
+static uint32_t          answers_lost;
+static uint32_t          client_acks_lost;
+static uint32_t          resends_on_timeout;
+static uint32_t          resends_on_connack;
+static uint32_t          refused_publishes;
+static uint32_t          most_in_flight;
+static uint32_t          reconnects;
+static uint32_t          stray_acks;
+static uint32_t          pingreqs;
+static uint32_t          duplicates_held_back;
+
+/******************************************************
+ *               Clock, RTOS and network models
+ ******************************************************/
+
+static uint64_t now_ns( void )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+wiced_result_t wiced_time_get_time( wiced_time_t* time )
+{
+    *time = (wiced_time_t) ( now_ms + ( 1ull << 32 ) - START_BEFORE_WRAP_MS );
+    return WICED_SUCCESS;
+}
+
+/* The test calls mqtt_manager() with MQTT_EVENT_TICK itself */
+wiced_result_t wiced_rtos_register_timed_event( wiced_timed_event_t* event_object, wiced_worker_thread_t* worker_thread, event_handler_t function, uint32_t time_ms, void* arg ) { return WICED_SUCCESS; }
+wiced_result_t wiced_rtos_deregister_timed_event( wiced_timed_event_t* event_object ) { return WICED_SUCCESS; }
+wiced_result_t wiced_rtos_push_to_queue( wiced_queue_t* queue, void* message, uint32_t timeout_ms ) { return WICED_SUCCESS; }
+wiced_result_t wiced_rtos_set_semaphore( wiced_semaphore_t* semaphore ) { return WICED_SUCCESS; }
+
+/* No offline store and no subscriptions with callbacks in this test */
+wiced_result_t mqtt_store_read( mqtt_store_t *store, mqtt_publish_arg_t *args ) { return WICED_ERROR; }
+void mqtt_store_release( mqtt_store_t *store ) { }
+void mqtt_store_cancel( mqtt_store_t *store ) { }
+wiced_result_t mqtt_topic_tree_add( mqtt_topic_tree_t *tree, const uint8_t *filter, uint16_t filter_length, wiced_mqtt_message_callback_t callback, void *arg ) { return WICED_SUCCESS; }
+wiced_result_t mqtt_topic_tree_remove( mqtt_topic_tree_t *tree, const uint8_t *filter, uint16_t filter_length ) { return WICED_SUCCESS; }
+wiced_result_t mqtt_connection_deinit( mqtt_connection_t *conn ) { return WICED_SUCCESS; }
+wiced_result_t mqtt_network_disconnect( mqtt_socket_t *socket ) { return WICED_SUCCESS; }
+wiced_result_t mqtt_backend_connection_close( mqtt_connection_t *conn ) { return WICED_SUCCESS; }
+wiced_result_t mqtt_backend_put_connect( const mqtt_connect_arg_t *args, mqtt_connection_t *conn ) { return WICED_SUCCESS; }
+wiced_result_t mqtt_backend_put_disconnect( mqtt_connection_t *conn ) { return WICED_SUCCESS; }
+
+static uint32_t test_random( void )
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+/* The broker answers after a random delay, so answers overtake each other, and loses some */
+static void broker_answer( mqtt_event_t event, uint16_t packet_id, uint32_t message, uint8_t qos, wiced_bool_t dup )
+{
+    answer_t* answer;
+
+    if ( ( event != MQTT_EVENT_RECV_PINGRES ) && ( test_random( ) % 100 < loss_percent ) )
+    {
+        answers_lost++;
+        return;
+    }
+    if ( answer_count == MAXIMUM_ANSWERS )
+    {
+        if ( errors++ < 10 ) printf( "broker model: too many answers in flight\n" );
+        return;
+    }
+    answer = &answers[ answer_count++ ];
+    answer->due_ms    = now_ms + 1 + test_random( ) % ANSWER_DELAY_MS;
+    answer->event     = event;
+    answer->packet_id = packet_id;
+    answer->message   = message;
+    answer->qos       = qos;
+    answer->dup       = dup;
+}
+
+static wiced_bool_t in_session( mqtt_frame_type_t type, uint16_t packet_id )
+{
+    return ( mqtt_session_item_exist( type, packet_id, &session ) == WICED_SUCCESS ) ? WICED_TRUE : WICED_FALSE;
+}
+
+/* Checks a frame the client sends for an item it holds against the session's resend timer */
+static void check_send( uint32_t flight_type, mqtt_frame_type_t type, uint16_t packet_id, const char* name )
+{
+    flight_t* flight = &flights[ flight_type ][ packet_id ];
+
+    switch ( context )
+    {
+        case CONTEXT_TICK:
+            if ( in_session( type, packet_id ) == WICED_FALSE )
+            {
+                if ( errors++ < 10 ) printf( "%u ms: %s %u resent on a tick though not in the session\n", (unsigned) now_ms, name, (unsigned) packet_id );
+            }
+            else if ( now_ms - flight->timer_ms < MQTT_SESSION_RETRANSMIT_TIMEOUT )
+            {
+                if ( errors++ < 10 ) printf( "%u ms: %s %u resent %u ms after its timer started\n", (unsigned) now_ms, name, (unsigned) packet_id, (unsigned) ( now_ms - flight->timer_ms ) );
+            }
+            flight->timer_ms = now_ms;
+            resends_on_timeout++;
+            break;
+
+        case CONTEXT_CONNACK:
+            flight->timer_ms = now_ms;
+            connack_resends++;
+            resends_on_connack++;
+            break;
+
+        case CONTEXT_APPLICATION:
+        default:
+            /* A duplicate PUBREC is answered from the item already held, which keeps its timer */
+            if ( ( type == MQTT_PACKET_TYPE_PUBLISH ) || ( in_session( type, packet_id ) == WICED_FALSE ) )
+            {
+                flight->timer_ms = now_ms;
+            }
+            break;
+    }
+}
+
+wiced_result_t mqtt_backend_put_publish( const mqtt_publish_arg_t *args, mqtt_connection_t *conn )
+{
+    uint32_t   index   = (uint32_t) ( (uintptr_t) args->data - (uintptr_t) client_messages ) / sizeof( message_t );
+    message_t* message = &client_messages[ index ];
+
+    UNUSED_PARAMETER( conn );
+
+    if ( args->qos != MQTT_QOS_DELIVER_AT_MOST_ONCE )
+    {
+        if ( ( args->dup != 0 ) != ( context != CONTEXT_APPLICATION ) )
+        {
+            if ( errors++ < 10 ) printf( "%u ms: PUBLISH %u %s DUP\n", (unsigned) now_ms, (unsigned) args->packet_id, ( args->dup != 0 ) ? "sent first with" : "resent without" );
+        }
+        check_send( FLIGHT_PUBLISH, MQTT_PACKET_TYPE_PUBLISH, args->packet_id, "PUBLISH" );
+    }
+    /* The broker */
+    if ( message->released == WICED_TRUE )
+    {
+        if ( errors++ < 10 ) printf( "%u ms: QoS 2 PUBLISH %u resent after its PUBREL\n", (unsigned) now_ms, (unsigned) args->packet_id );
+    }
+    /* It holds a QoS 2 identifier from the first PUBLISH to the PUBREL, so one after that is a new message */
+    if ( ( args->qos != MQTT_QOS_DELIVER_EXACTLY_ONCE ) || ( message->delivered == 0 ) || ( message->released == WICED_TRUE ) )
+    {
+        message->delivered++;
+    }
+    if ( args->qos == MQTT_QOS_DELIVER_AT_LEAST_ONCE )
+    {
+        broker_answer( MQTT_EVENT_RECV_PUBACK, args->packet_id, index, 0, WICED_FALSE );
+    }
+    else if ( args->qos == MQTT_QOS_DELIVER_EXACTLY_ONCE )
+    {
+        broker_answer( MQTT_EVENT_RECV_PUBREC, args->packet_id, index, 0, WICED_FALSE );
+    }
+    return WICED_SUCCESS;
+}
+
+wiced_result_t mqtt_backend_put_pubrel( const mqtt_pubrel_arg_t *args, mqtt_connection_t *conn )
+{
+    uint32_t index = client_id_message[ args->packet_id ];
+
+    UNUSED_PARAMETER( conn );
+    check_send( FLIGHT_PUBREL, MQTT_PACKET_TYPE_PUBREL, args->packet_id, "PUBREL" );
+    client_messages[ index ].released = WICED_TRUE;
+    broker_answer( MQTT_EVENT_RECV_PUBCOMP, args->packet_id, index, 0, WICED_FALSE );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t mqtt_backend_put_subscribe( const mqtt_subscribe_arg_t *args, mqtt_connection_t *conn )
+{
+    UNUSED_PARAMETER( conn );
+    check_send( FLIGHT_SUBSCRIBE, MQTT_PACKET_TYPE_SUBSCRIBE, args->packet_id, "SUBSCRIBE" );
+    broker_answer( MQTT_EVENT_RECV_SUBACK, args->packet_id, 0, 0, WICED_FALSE );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t mqtt_backend_put_unsubscribe( const mqtt_unsubscribe_arg_t *args, mqtt_connection_t *conn )
+{
+    UNUSED_PARAMETER( conn );
+    check_send( FLIGHT_UNSUBSCRIBE, MQTT_PACKET_TYPE_UNSUBSCRIBE, args->packet_id, "UNSUBSCRIBE" );
+    broker_answer( MQTT_EVENT_RECV_UNSUBACK, args->packet_id, 0, 0, WICED_FALSE );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t mqtt_backend_put_pingreq( mqtt_connection_t *conn )
+{
+    UNUSED_PARAMETER( conn );
+    pingreqs++;
+    broker_answer( MQTT_EVENT_RECV_PINGRES, 0, 0, 0, WICED_FALSE );
+    return WICED_SUCCESS;
+}
+
+static wiced_bool_t client_ack_lost( void )
+{
+    if ( test_random( ) % 100 < loss_percent )
+    {
+        client_acks_lost++;
+        return WICED_TRUE;
+    }
+    return WICED_FALSE;
+}
+
+/* The client's answers to the broker's own publishes. The broker matches them by identifier */
+static message_t* broker_message( uint16_t packet_id )
+{
+    uint32_t index = broker_message_count;
+
+    while ( index-- != 0 )
+    {
+        if ( broker_messages[ index ].packet_id == packet_id )
+        {
+            return &broker_messages[ index ];
+        }
+    }
+    return NULL;
+}
+
+wiced_result_t mqtt_backend_put_puback( const mqtt_puback_arg_t *args, mqtt_connection_t *conn )
+{
+    message_t* message = broker_message( args->packet_id );
+
+    UNUSED_PARAMETER( conn );
+    if ( ( message != NULL ) && ( client_ack_lost( ) == WICED_FALSE ) )
+    {
+        message->complete = WICED_TRUE;
+    }
+    return WICED_SUCCESS;
+}
+
+wiced_result_t mqtt_backend_put_pubrec( const mqtt_pubrec_arg_t *args, mqtt_connection_t *conn )
+{
+    message_t* message = broker_message( args->packet_id );
+
+    UNUSED_PARAMETER( conn );
+    if ( context == CONTEXT_CONNACK )
+    {
+        connack_resends++;
+        resends_on_connack++;
+    }
+    if ( ( message != NULL ) && ( message->complete == WICED_FALSE ) && ( client_ack_lost( ) == WICED_FALSE ) )
+    {
+        message->released     = WICED_TRUE;
+        message->last_sent_ms = now_ms;
+        broker_answer( MQTT_EVENT_RECV_PUBREL, args->packet_id, (uint32_t) ( message - broker_messages ), 0, WICED_FALSE );
+    }
+    return WICED_SUCCESS;
+}
+
+wiced_result_t mqtt_backend_put_pubcomp( const mqtt_pubcomp_arg_t *args, mqtt_connection_t *conn )
+{
+    message_t* message = broker_message( args->packet_id );
+
+    UNUSED_PARAMETER( conn );
+    if ( ( message != NULL ) && ( client_ack_lost( ) == WICED_FALSE ) )
+    {
+        message->complete = WICED_TRUE;
+    }
+    return WICED_SUCCESS;
+}
+
+/******************************************************
+ *               Application model
+ ******************************************************/
+
+static wiced_result_t application_callback( wiced_mqtt_object_t mqtt_object, wiced_mqtt_event_info_t *event )
+{
+    UNUSED_PARAMETER( mqtt_object );
+
+    if ( event->type == WICED_MQTT_EVENT_TYPE_PUBLISH_FAILED )
+    {
+        message_t* message = &client_messages[ client_id_message[ event->data.msgid ] ];
+        if ( message->packet_id != event->data.msgid )
+        {
+            if ( errors++ < 10 ) printf( "%u ms: PUBLISH_FAILED for %u, which was not being published\n", (unsigned) now_ms, (unsigned) event->data.msgid );
+        }
+        message->refused = WICED_TRUE;
+    }
+    else if ( event->type == WICED_MQTT_EVENT_TYPE_DISCONNECTED )
+    {
+        if ( errors++ < 10 ) printf( "%u ms: keep-alive timed out\n", (unsigned) now_ms );
+    }
+    return WICED_SUCCESS;
+}
+
+static uint16_t next_packet_id( void )
+{
+    if ( ++connection.packet_id == 0 )
+    {
+        ++connection.packet_id;
+    }
+    return connection.packet_id;
+}
+
+static uint32_t session_items( void )
+{
+    const wiced_mqtt_session_statistics_t* statistics = &session.statistics;
+    return (uint32_t) statistics->publish + statistics->pubrel + statistics->pubrec + statistics->subscribe + statistics->unsubscribe;
+}
+
+static void application_publish( uint8_t qos )
+{
+    mqtt_publish_arg_t publish;
+    message_t*         message;
+    uint32_t           held = session_items( );
+
+    if ( client_message_count == MAXIMUM_MESSAGES )
+    {
+        return;
+    }
+    message = &client_messages[ client_message_count ];
+    memset( message, 0, sizeof( *message ) );
+    message->packet_id = next_packet_id( );
+    message->qos       = qos;
+    client_id_message[ message->packet_id ] = client_message_count++;
+
+    memset( &publish, 0, sizeof( publish ) );
+    publish.packet_id = message->packet_id;
+    publish.qos       = qos;
+    publish.topic.str = (uint8_t*) "wizfi/sensor/1";
+    publish.topic.len = 14;
+    publish.data      = (uint8_t*) message;
+    publish.data_len  = sizeof( *message );
+
+    context = CONTEXT_APPLICATION;
+    mqtt_manager( MQTT_EVENT_SEND_PUBLISH, &publish, &connection );
+
+    if ( qos == MQTT_QOS_DELIVER_AT_MOST_ONCE )
+    {
+        message->complete = WICED_TRUE;
+        return;
+    }
+    if ( ( message->refused == WICED_TRUE ) != ( held == MQTT_SESSION_WINDOW_SIZE ) )
+    {
+        if ( errors++ < 10 ) printf( "%u ms: publish %u %s with %u of %u items held\n", (unsigned) now_ms, (unsigned) message->packet_id,
+                                     message->refused ? "refused" : "taken", (unsigned) held, (unsigned) MQTT_SESSION_WINDOW_SIZE );
+    }
+    refused_publishes += ( message->refused == WICED_TRUE ) ? 1 : 0;
+}
+
+static void application_subscribe( wiced_bool_t unsubscribe )
+{
+    context = CONTEXT_APPLICATION;
+    if ( unsubscribe == WICED_FALSE )
+    {
+        mqtt_subscribe_arg_t subscribe;
+        memset( &subscribe, 0, sizeof( subscribe ) );
+        subscribe.packet_id        = next_packet_id( );
+        subscribe.topic_filter.str = (uint8_t*) "wizfi/#";
+        subscribe.topic_filter.len = 7;
+        subscribe.qos              = MQTT_QOS_DELIVER_EXACTLY_ONCE;
+        mqtt_manager( MQTT_EVENT_SEND_SUBSCRIBE, &subscribe, &connection );
+    }
+    else
+    {
+        mqtt_unsubscribe_arg_t unsubscribe_args;
+        memset( &unsubscribe_args, 0, sizeof( unsubscribe_args ) );
+        unsubscribe_args.packet_id        = next_packet_id( );
+        unsubscribe_args.topic_filter.str = (uint8_t*) "wizfi/#";
+        unsubscribe_args.topic_filter.len = 7;
+        mqtt_manager( MQTT_EVENT_SEND_UNSUBSCRIBE, &unsubscribe_args, &connection );
+    }
+}
+
+/******************************************************
+ *               Broker model
+ ******************************************************/
+
+/* The broker publishes to the client, and resends what is not yet acknowledged */
+static void broker_publish( void )
+{
+    message_t* message;
+
+    if ( broker_message_count == MAXIMUM_MESSAGES )
+    {
+        return;
+    }
+    message = &broker_messages[ broker_message_count++ ];
+    memset( message, 0, sizeof( *message ) );
+    message->packet_id    = (uint16_t) ( 1 + ( broker_message_count - 1 ) % 65535 );
+    message->qos          = (uint8_t) ( 1 + test_random( ) % 2 );
+    message->last_sent_ms = now_ms;
+    broker_answer( MQTT_EVENT_RECV_PUBLISH, message->packet_id, broker_message_count - 1, message->qos, WICED_FALSE );
+}
+
+static void broker_resend( wiced_bool_t all )
+{
+    uint32_t index;
+
+    /* Only recent messages can still be open */
+    for ( index = ( broker_message_count > 4000 ) ? broker_message_count - 4000 : 0; index < broker_message_count; index++ )
+    {
+        message_t* message = &broker_messages[ index ];
+
+        if ( ( message->complete == WICED_TRUE ) || ( ( all == WICED_FALSE ) && ( now_ms - message->last_sent_ms < BROKER_RESEND_MS ) ) )
+        {
+            continue;
+        }
+        message->last_sent_ms = now_ms;
+        if ( message->released == WICED_TRUE )
+        {
+            broker_answer( MQTT_EVENT_RECV_PUBREL, message->packet_id, index, 0, WICED_FALSE );
+        }
+        else
+        {
+            broker_answer( MQTT_EVENT_RECV_PUBLISH, message->packet_id, index, message->qos, WICED_TRUE );
+        }
+    }
+}
+
+/* Hands the client every answer now due */
+static void deliver_answers( void )
+{
+    uint32_t index = 0;
+
+    while ( index < answer_count )
+    {
+        answer_t answer = answers[ index ];
+
+        if ( answer.due_ms > now_ms )
+        {
+            index++;
+            continue;
+        }
+        answers[ index ] = answers[ --answer_count ];
+
+        context = CONTEXT_APPLICATION;
+        switch ( answer.event )
+        {
+            case MQTT_EVENT_RECV_PUBLISH:
+            {
+                mqtt_publish_arg_t publish;
+                uint8_t            payload[ 4 ];
+
+                memset( &publish, 0, sizeof( publish ) );
+                publish.packet_id = answer.packet_id;
+                publish.qos       = answer.qos;
+                publish.dup       = answer.dup;
+                publish.data      = payload;
+                publish.data_len  = sizeof( payload );
+                mqtt_manager( MQTT_EVENT_RECV_PUBLISH, &publish, &connection );
+                if ( publish.data != NULL )
+                {
+                    broker_messages[ answer.message ].delivered++;
+                }
+                else
+                {
+                    duplicates_held_back++;
+                }
+                break;
+            }
+
+            case MQTT_EVENT_RECV_SUBACK:
+            {
+                wiced_mqtt_suback_arg_t suback;
+                suback.packet_id   = answer.packet_id;
+                suback.return_code = WICED_MQTT_RETURN_CODE_ACCEPTED;
+                mqtt_manager( answer.event, &suback, &connection );
+                break;
+            }
+
+            case MQTT_EVENT_RECV_PINGRES:
+                mqtt_manager( answer.event, NULL, &connection );
+                break;
+
+            default:
+            {
+                mqtt_unsuback_arg_t ack;
+                ack.packet_id = answer.packet_id;
+                mqtt_manager( answer.event, &ack, &connection );
+                if ( ( answer.event == MQTT_EVENT_RECV_PUBACK ) || ( answer.event == MQTT_EVENT_RECV_PUBCOMP ) )
+                {
+                    if ( client_messages[ answer.message ].packet_id == answer.packet_id )
+                    {
+                        client_messages[ answer.message ].complete = WICED_TRUE;
+                    }
+                }
+                break;
+            }
+        }
+    }
+}
+
+/* A PUBACK for an identifier the client holds as a PUBREL, or a PUBCOMP for one it holds as another type */
+static void send_stray_ack( void )
+{
+    struct list_head*   position;
+    mqtt_unsuback_arg_t ack;
+
+    list_for_each( position, &session.used_list )
+    {
+        wiced_mqtt_session_item_t* item  = list_entry( position, wiced_mqtt_session_item_t, list );
+        mqtt_event_t               event = ( item->type == MQTT_PACKET_TYPE_PUBREL ) ? MQTT_EVENT_RECV_PUBACK : MQTT_EVENT_RECV_PUBCOMP;
+        mqtt_frame_type_t          type  = item->type;
+
+        /* The type the acknowledgement does free must not be held under this identifier */
+        if ( ( type == MQTT_PACKET_TYPE_PUBLISH ) || in_session( ( event == MQTT_EVENT_RECV_PUBACK ) ? MQTT_PACKET_TYPE_PUBLISH : MQTT_PACKET_TYPE_PUBREL, item->packet_id ) )
+        {
+            continue;
+        }
+
+        ack.packet_id = item->packet_id;
+        context = CONTEXT_APPLICATION;
+        mqtt_manager( event, &ack, &connection );
+        if ( in_session( type, ack.packet_id ) == WICED_FALSE )
+        {
+            if ( errors++ < 10 ) printf( "%u ms: %s %u freed an item of type %u\n", (unsigned) now_ms, ( event == MQTT_EVENT_RECV_PUBACK ) ? "PUBACK" : "PUBCOMP", (unsigned) ack.packet_id, (unsigned) type );
+        }
+        stray_acks++;
+        return;
+    }
+}
+
+/******************************************************
+ *               Session checks
+ ******************************************************/
+
+static void check_session( void )
+{
+    wiced_mqtt_session_statistics_t counted;
+    struct list_head*               position;
+    uint32_t                        used = 0;
+    uint32_t                        free_items = 0;
+    wiced_mqtt_session_item_t*      previous = NULL;
+
+    memset( &counted, 0, sizeof( counted ) );
+    list_for_each( position, &session.used_list )
+    {
+        wiced_mqtt_session_item_t* item = list_entry( position, wiced_mqtt_session_item_t, list );
+
+        /* The expired sweep stops at the first item not due, so the list must stay in resend order */
+        if ( ( previous != NULL ) && ( (int32_t) ( item->resend_time - previous->resend_time ) < 0 ) )
+        {
+            if ( errors++ < 10 ) printf( "%u ms: item %u of type %u is due %d ms before item %u ahead of it\n", (unsigned) now_ms, (unsigned) item->packet_id, (unsigned) item->type,
+                                         (int) ( previous->resend_time - item->resend_time ), (unsigned) previous->packet_id );
+        }
+        previous = item;
+        used++;
+        counted.publish     += ( item->type == MQTT_PACKET_TYPE_PUBLISH ) ? 1 : 0;
+        counted.pubrel      += ( item->type == MQTT_PACKET_TYPE_PUBREL ) ? 1 : 0;
+        counted.pubrec      += ( item->type == MQTT_PACKET_TYPE_PUBREC ) ? 1 : 0;
+        counted.subscribe   += ( item->type == MQTT_PACKET_TYPE_SUBSCRIBE ) ? 1 : 0;
+        counted.unsubscribe += ( item->type == MQTT_PACKET_TYPE_UNSUBSCRIBE ) ? 1 : 0;
+        if ( in_session( item->type, item->packet_id ) == WICED_FALSE )
+        {
+            if ( errors++ < 10 ) printf( "%u ms: item %u of type %u is on the used list but not in its hash chain\n", (unsigned) now_ms, (unsigned) item->packet_id, (unsigned) item->type );
+        }
+    }
+    list_for_each( position, &session.nonused_list )
+    {
+        free_items++;
+    }
+
+    if ( ( used + free_items != MQTT_SESSION_WINDOW_SIZE ) || ( counted.publish != session.statistics.publish ) || ( counted.pubrel != session.statistics.pubrel ) ||
+         ( counted.pubrec != session.statistics.pubrec ) || ( counted.subscribe != session.statistics.subscribe ) || ( counted.unsubscribe != session.statistics.unsubscribe ) )
+    {
+        if ( errors++ < 10 ) printf( "%u ms: %u used and %u free items; counted %u/%u/%u/%u/%u, counters say %u/%u/%u/%u/%u\n", (unsigned) now_ms, (unsigned) used, (unsigned) free_items,
+                                     counted.publish, counted.pubrel, counted.pubrec, counted.subscribe, counted.unsubscribe,
+                                     session.statistics.publish, session.statistics.pubrel, session.statistics.pubrec, session.statistics.subscribe, session.statistics.unsubscribe );
+    }
+    most_in_flight = MAX( most_in_flight, used );
+}
+
+/* After a tick nothing the client resends may be overdue */
+static void check_overdue( void )
+{
+    struct list_head* position;
+
+    list_for_each( position, &session.used_list )
+    {
+        wiced_mqtt_session_item_t* item = list_entry( position, wiced_mqtt_session_item_t, list );
+        uint32_t                   flight_type;
+
+        switch ( item->type )
+        {
+            case MQTT_PACKET_TYPE_PUBLISH:     flight_type = FLIGHT_PUBLISH;     break;
+            case MQTT_PACKET_TYPE_PUBREL:      flight_type = FLIGHT_PUBREL;      break;
+            case MQTT_PACKET_TYPE_SUBSCRIBE:   flight_type = FLIGHT_SUBSCRIBE;   break;
+            case MQTT_PACKET_TYPE_UNSUBSCRIBE: flight_type = FLIGHT_UNSUBSCRIBE; break;
+            default:                           continue;
+        }
+        if ( now_ms - flights[ flight_type ][ item->packet_id ].timer_ms >= MQTT_SESSION_RETRANSMIT_TIMEOUT )
+        {
+            if ( errors++ < 10 ) printf( "%u ms: item %u of type %u not resent %u ms after its timer started\n", (unsigned) now_ms, (unsigned) item->packet_id, (unsigned) item->type,
+                                         (unsigned) ( now_ms - flights[ flight_type ][ item->packet_id ].timer_ms ) );
+        }
+    }
+}
+
+static void reconnect( void )
+{
+    mqtt_connack_arg_t connack;
+    uint32_t           held = session_items( );
+
+    /* Whatever was in flight either way is lost with the connection */
+    answers_lost += answer_count;
+    answer_count = 0;
+    reconnects++;
+
+    memset( &connack, 0, sizeof( connack ) );
+    connack.session_present = 1;
+    connack.return_code     = WICED_MQTT_RETURN_CODE_ACCEPTED;
+    context         = CONTEXT_CONNACK;
+    connack_resends = 0;
+    mqtt_manager( MQTT_EVENT_RECV_CONNACK, &connack, &connection );
+    if ( connack_resends != held )
+    {
+        if ( errors++ < 10 ) printf( "%u ms: CONNACK resent %u of %u items\n", (unsigned) now_ms, (unsigned) connack_resends, (unsigned) held );
+    }
+    broker_resend( WICED_TRUE );
+}
+
+/* Runs the simulation for a while. New traffic only while busy */
+static void run( uint64_t until_ms, wiced_bool_t busy )
+{
+    for ( ; now_ms < until_ms; now_ms += STEP_MS )
+    {
+        deliver_answers( );
+        check_session( );
+
+        if ( busy == WICED_TRUE )
+        {
+            uint32_t roll = test_random( ) % 1000;
+
+            if ( roll < 300 )
+            {
+                application_publish( (uint8_t) ( roll % 3 ) );
+            }
+            else if ( roll < 302 )
+            {
+                /* A burst which overflows the window */
+                uint32_t count;
+                for ( count = 0; count < MQTT_SESSION_WINDOW_SIZE + 4; count++ )
+                {
+                    application_publish( (uint8_t) ( 1 + count % 2 ) );
+                }
+            }
+            else if ( roll < 320 )
+            {
+                application_subscribe( ( roll & 1 ) ? WICED_TRUE : WICED_FALSE );
+            }
+            else if ( roll < 420 )
+            {
+                broker_publish( );
+            }
+            else if ( roll < 425 )
+            {
+                send_stray_ack( );
+            }
+            if ( test_random( ) % ( RECONNECT_INTERVAL_MS / STEP_MS ) == 0 )
+            {
+                reconnect( );
+            }
+        }
+        check_session( );
+
+        if ( now_ms % TICK_MS == 0 )
+        {
+            context = CONTEXT_TICK;
+            mqtt_manager( MQTT_EVENT_TICK, NULL, &connection );
+            check_overdue( );
+            broker_resend( WICED_FALSE );
+            check_session( );
+        }
+    }
+}
+
+/* What an acknowledgement costs with the window full, in acknowledgement order unrelated to sending order */
+static double benchmark_acks( void )
+{
+    static uint16_t    held[ MQTT_SESSION_WINDOW_SIZE ];
+    mqtt_publish_arg_t publish;
+    uint32_t           count;
+    uint16_t           packet_id = 1;
+    uint64_t           started;
+    uint64_t           spent = 0;
+
+    mqtt_session_init( &session );
+    memset( &publish, 0, sizeof( publish ) );
+    publish.qos = MQTT_QOS_DELIVER_AT_LEAST_ONCE;
+    for ( count = 0; count < MQTT_SESSION_WINDOW_SIZE; count++ )
+    {
+        publish.packet_id = held[ count ] = packet_id++;
+        mqtt_session_add_item( MQTT_PACKET_TYPE_PUBLISH, &publish, &session );
+    }
+
+    for ( count = 0; count < BENCHMARK_ACKS; count++ )
+    {
+        uint32_t slot = test_random( ) % MQTT_SESSION_WINDOW_SIZE;
+
+        started = now_ns( );
+        if ( mqtt_session_remove_item( MQTT_PACKET_TYPE_PUBLISH, held[ slot ], &session ) != WICED_SUCCESS )
+        {
+            if ( errors++ < 10 ) printf( "benchmark: PUBACK %u found nothing\n", (unsigned) held[ slot ] );
+        }
+        spent += now_ns( ) - started;
+
+        if ( ++packet_id == 0 )
+        {
+            ++packet_id;
+        }
+        publish.packet_id = held[ slot ] = packet_id;
+        mqtt_session_add_item( MQTT_PACKET_TYPE_PUBLISH, &publish, &session );
+    }
+    return (double) spent / BENCHMARK_ACKS;
+}
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+int main( int argc, char* argv[] )
+{
+    uint32_t           seconds = ( argc > 1 ) ? (uint32_t) strtoul( argv[ 1 ], NULL, 0 ) : 4 * 3600;
+    uint32_t           seed    = ( argc > 3 ) ? (uint32_t) strtoul( argv[ 3 ], NULL, 0 ) : 1;
+    mqtt_connect_arg_t connect;
+    uint32_t           index;
+    uint32_t           accepted = 0;
+    uint32_t           undelivered = 0;
+    uint32_t           duplicated = 0;
+    uint32_t           incomplete = 0;
+    uint32_t           broker_twice = 0;
+    uint32_t           broker_missing = 0;
+    double             ack_ns;
+    wiced_bool_t       failed;
+
+    loss_percent = ( argc > 2 ) ? (uint32_t) strtoul( argv[ 2 ], NULL, 0 ) : 20;
+    random_state = ( seed != 0 ) ? seed : 1;
+    client_messages = calloc( MAXIMUM_MESSAGES, sizeof( message_t ) );
+    broker_messages = calloc( MAXIMUM_MESSAGES, sizeof( message_t ) );
+
+    mqtt_session_init( &session );
+    connection.session   = &session;
+    connection.callbacks = application_callback;
+    connection.packet_id = FIRST_PACKET_ID;
+
+    memset( &connect, 0, sizeof( connect ) );
+    connect.keep_alive = KEEP_ALIVE_SECONDS;
+    mqtt_manager( MQTT_EVENT_SEND_CONNECT, &connect, &connection );
+    reconnect( );
+    reconnects = 0;
+
+    run( (uint64_t) seconds * 1000, WICED_TRUE );
+
+    /* Then let everything settle without losses */
+    loss_percent = 0;
+    run( now_ms + DRAIN_LIMIT_MS, WICED_FALSE );
+
+    for ( index = 0; index < client_message_count; index++ )
+    {
+        const message_t* message = &client_messages[ index ];
+
+        if ( ( message->qos == MQTT_QOS_DELIVER_AT_MOST_ONCE ) || ( message->refused == WICED_TRUE ) )
+        {
+            continue;
+        }
+        accepted++;
+        undelivered += ( message->delivered == 0 ) ? 1 : 0;
+        duplicated  += ( ( message->qos == MQTT_QOS_DELIVER_EXACTLY_ONCE ) && ( message->delivered > 1 ) ) ? 1 : 0;
+        incomplete  += ( message->complete == WICED_FALSE ) ? 1 : 0;
+    }
+    for ( index = 0; index < broker_message_count; index++ )
+    {
+        const message_t* message = &broker_messages[ index ];
+
+        broker_missing += ( message->delivered == 0 ) ? 1 : 0;
+        broker_twice   += ( ( message->qos == MQTT_QOS_DELIVER_EXACTLY_ONCE ) && ( message->delivered > 1 ) ) ? 1 : 0;
+    }
+    if ( ( undelivered | duplicated | incomplete | broker_missing | broker_twice | session_items( ) ) != 0 )
+    {
+        errors++;
+    }
+
+    printf( "window of %u, %u s with %u%% of the broker's answers lost, %u reconnects, %u keep-alive PINGREQs\n",
+            (unsigned) MQTT_SESSION_WINDOW_SIZE, (unsigned) seconds, (unsigned) ( ( argc > 2 ) ? strtoul( argv[ 2 ], NULL, 0 ) : 20 ), (unsigned) reconnects, (unsigned) pingreqs );
+    printf( "client: %u messages, %u QoS 1/2 accepted, %u refused on a full window (at most %u items held); %u broker answers lost, %u resent on timeout, %u on CONNACK, %u stray acks ignored\n",
+            (unsigned) client_message_count, (unsigned) accepted, (unsigned) refused_publishes, (unsigned) most_in_flight, (unsigned) answers_lost,
+            (unsigned) resends_on_timeout, (unsigned) resends_on_connack, (unsigned) stray_acks );
+    printf( "broker: %u not delivered, %u QoS 2 delivered twice, %u not acknowledged; to the client: %u messages, %u acks lost, %u duplicates held back, %u not delivered, %u QoS 2 delivered twice\n",
+            (unsigned) undelivered, (unsigned) duplicated, (unsigned) incomplete, (unsigned) broker_message_count, (unsigned) client_acks_lost, (unsigned) duplicates_held_back,
+            (unsigned) broker_missing, (unsigned) broker_twice );
+    printf( "session counters: %u retransmissions, %u refused on a full window; %u items left\n",
+            (unsigned) session.statistics.retransmissions, (unsigned) session.statistics.window_full, (unsigned) session_items( ) );
+
+    ack_ns = benchmark_acks( );
+    printf( "acknowledgement with %u items held: %.1f ns\n", (unsigned) MQTT_SESSION_WINDOW_SIZE, ack_ns );
+    printf( "%u errors\n", (unsigned) errors );
+
+    free( client_messages );
+    free( broker_messages );
+
+    failed = ( errors != 0 ) || ( refused_publishes == 0 ) || ( resends_on_timeout == 0 );
+    printf( failed ? "FAIL\n" : "PASS\n" );
+    return failed;
+}
@@ -0,0 +1,520 @@
+/*
+ * Copyright 2015, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  Power-cut test of the MQTT offline store
+ *
+ *  mqtt_store.c runs against serial flash held in RAM. Publishes and drains
+ *  are mixed at random, and the power is cut part way through a program or
+ *  an erase. A byte being programmed when the power goes keeps a random
+ *  subset of its new zero bits, and a sector being erased keeps a random
+ *  part of its old contents. After each cut the store is rebuilt from flash
+ *  as it is at start-up.
+ *
+ *  Fails if a message whose append returned success is never delivered, is
+ *  delivered twice or out of order, or comes back with different contents.
+ *  Also fails if a blank sector is erased, or if the erase count the store
+ *  keeps for a sector falls below the number of times it was erased.
+ *
+ *  Usage: mqtt_store_test [rounds [seed [max_steps_before_cut]]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "mqtt_internal.h"
+#include "mqtt_store.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define AREA_ADDRESS        (0x40000)
+#define AREA_SECTORS        (8)
+#define AREA_SIZE           (AREA_SECTORS * MQTT_STORE_SECTOR_SIZE)
+#define MAX_MESSAGES        (200000)
+#define OPERATIONS_PER_ROUND (40)
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static uint8_t      flash[ AREA_ADDRESS + AREA_SIZE ];
+static long         power_budget = -1;      /* Byte programs and erases left before the power goes, -1 for never */
+static jmp_buf      power_cut;
+static unsigned     cuts;
+static unsigned     erase_cuts;
+static unsigned     sector_erases[ AREA_SECTORS ];
+static unsigned     blank_erases;
+static wiced_time_t now_ms;
+
+static mqtt_store_t store;
+static wiced_mqtt_store_config_t config = { AREA_ADDRESS, AREA_SIZE, 0, WICED_FALSE };
+
+static int     next_id = 1;
+static int     last_delivered;
+static uint8_t appended[ MAX_MESSAGES ];
+static uint8_t delivered[ MAX_MESSAGES ];
+static unsigned duplicates, order_errors, bad_contents;
+
+/******************************************************
+ *               Serial flash model
+ ******************************************************/
+
+static void power_step( void )
+{
+    if ( ( power_budget > 0 ) && ( --power_budget == 0 ) )
+    {
+        power_budget = -1;
+        cuts++;
+        longjmp( power_cut, 1 );
+    }
+}
+
+int init_sflash( sflash_handle_t* const handle, int peripheral_id, sflash_write_allowed_t write_allowed )
+{
+    (void) handle; (void) peripheral_id; (void) write_allowed;
+    return 0;
+}
+
+int sflash_read( const sflash_handle_t* const handle, unsigned long device_address, void* const data_addr, unsigned int size )
+{
+    (void) handle;
+    memcpy( data_addr, &flash[ device_address ], size );
+    return 0;
+}
+
+int sflash_write( const sflash_handle_t* const handle, unsigned long device_address, const void* const data_addr, int size )
+{
+    const uint8_t* data = (const uint8_t*) data_addr;
+    int i;
+
+    (void) handle;
+    for ( i = 0; i < size; i++ )
+    {
+        if ( power_budget == 1 )
+        {
+            flash[ device_address + i ] &= (uint8_t) ( data[ i ] | ( rand( ) & 0xFF ) );
+        }
+        power_step( );
+        flash[ device_address + i ] &= data[ i ];
+    }
+    return 0;
+}
+
+int sflash_sector_erase( const sflash_handle_t* const handle, unsigned long device_address )
+{
+    uint8_t* sector = &flash[ device_address & ~( MQTT_STORE_SECTOR_SIZE - 1UL ) ];
+    int i;
+
+    (void) handle;
+    sector_erases[ ( device_address - AREA_ADDRESS ) / MQTT_STORE_SECTOR_SIZE ]++;
+    for ( i = 0; ( i < MQTT_STORE_SECTOR_SIZE ) && ( sector[ i ] == 0xFF ); i++ )
+    {
+    }
+    if ( i == MQTT_STORE_SECTOR_SIZE )
+    {
+        blank_erases++;
+    }
+
+    /* Erases take long enough that one in eight cuts lands in one */
+    if ( ( power_budget > 0 ) && ( rand( ) % 8 == 0 ) )
+    {
+        power_budget = 1;
+    }
+    if ( power_budget == 1 )
+    {
+        for ( i = 0; i < MQTT_STORE_SECTOR_SIZE; i++ )
+        {
+            if ( rand( ) & 1 )
+            {
+                sector[ i ] = 0xFF;
+            }
+        }
+        erase_cuts++;
+    }
+    power_step( );
+    memset( sector, 0xFF, MQTT_STORE_SECTOR_SIZE );
+    return 0;
+}
+
+/******************************************************
+ *       Background erases, run by pump_worker()
+ ******************************************************/
+static sflash_async_erase_t* erase_queued;
+static int                   erase_started;
+static int                   erase_finished;
+
+static void finish_erase( void )
+{
+    if ( ( erase_queued != NULL ) && ( erase_started != 0 ) && ( erase_finished == 0 ) )
+    {
+        sflash_sector_erase( NULL, erase_queued->device_address );
+        erase_finished = 1;
+    }
+}
+
+/* One turn of the worker thread: starts the queued erase, or completes the one started and calls back */
+static void pump_worker( void )
+{
+    sflash_async_erase_t* request = erase_queued;
+
+    if ( request == NULL )
+    {
+        return;
+    }
+    if ( erase_started == 0 )
+    {
+        erase_started = 1;
+        return;
+    }
+    finish_erase( );
+    erase_queued   = NULL;
+    erase_started  = 0;
+    erase_finished = 0;
+    request->callback( request->arg, 0 );
+}
+
+wiced_result_t sflash_async_init( sflash_async_t* async, const sflash_handle_t* handle, wiced_worker_thread_t* worker_thread )
+{
+    (void) worker_thread;
+    memset( async, 0, sizeof( *async ) );
+    async->handle  = handle;
+    erase_queued   = NULL;
+    erase_started  = 0;
+    erase_finished = 0;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t sflash_async_deinit( sflash_async_t* async )
+{
+    (void) async;
+    erase_queued = NULL;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t sflash_async_sector_erase( sflash_async_t* async, sflash_async_erase_t* request, unsigned long device_address, sflash_async_callback_t callback, void* arg )
+{
+    (void) async;
+    request->device_address = device_address;
+    request->callback       = callback;
+    request->arg            = arg;
+    request->status         = 0;
+    erase_queued  = request;
+    erase_started = 0;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t sflash_async_cancel( sflash_async_t* async, sflash_async_erase_t* request )
+{
+    (void) async;
+    if ( ( erase_queued == request ) && ( erase_started == 0 ) )
+    {
+        erase_queued = NULL;
+        return WICED_SUCCESS;
+    }
+    return WICED_NOTFOUND;
+}
+
+/* The chip is only handed over once an erase that has started is complete */
+void sflash_async_lock( sflash_async_t* async )
+{
+    (void) async;
+    finish_erase( );
+}
+
+void sflash_async_unlock( sflash_async_t* async )
+{
+    (void) async;
+}
+
+int sflash_async_read( sflash_async_t* async, unsigned long device_address, void* const data_addr, unsigned int size )
+{
+    sflash_async_lock( async );
+    return sflash_read( async->handle, device_address, data_addr, size );
+}
+
+int sflash_async_write( sflash_async_t* async, unsigned long device_address, const void* const data_addr, int size )
+{
+    sflash_async_lock( async );
+    return sflash_write( async->handle, device_address, data_addr, size );
+}
+
+/******************************************************
+ *          RTOS, single threaded
+ ******************************************************/
+wiced_result_t wiced_rtos_init_mutex( wiced_mutex_t* mutex )     { (void) mutex; return WICED_SUCCESS; }
+wiced_result_t wiced_rtos_deinit_mutex( wiced_mutex_t* mutex )   { (void) mutex; return WICED_SUCCESS; }
+wiced_result_t wiced_rtos_lock_mutex( wiced_mutex_t* mutex )     { (void) mutex; return WICED_SUCCESS; }
+wiced_result_t wiced_rtos_unlock_mutex( wiced_mutex_t* mutex )   { (void) mutex; return WICED_SUCCESS; }
+wiced_result_t wiced_time_get_time( wiced_time_t* time )         { *time = now_ms; return WICED_SUCCESS; }
+
+wiced_result_t wiced_rtos_create_worker_thread( wiced_worker_thread_t* worker_thread, uint8_t priority, uint32_t stack_size, uint32_t event_queue_size )
+{
+    (void) worker_thread; (void) priority; (void) stack_size; (void) event_queue_size;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_delete_worker_thread( wiced_worker_thread_t* worker_thread )
+{
+    (void) worker_thread;
+    return WICED_SUCCESS;
+}
+
+/******************************************************
+ *               Messages
+ ******************************************************/
+
+static void make_message( int id, mqtt_publish_arg_t* args, char* topic, uint8_t* payload )
+{
+    int length = ( id * 7919 ) % 500;
+    int i;
+
+    sprintf( topic, "t/%d", id );
+    for ( i = 0; i < length; i++ )
+    {
+        payload[ i ] = (uint8_t) ( id * 31 + i );
+    }
+    memset( args, 0, sizeof( *args ) );
+    args->topic.str = (uint8_t*) topic;
+    args->topic.len = (uint16_t) strlen( topic );
+    args->data      = payload;
+    args->data_len  = (uint32_t) length;
+    args->qos       = (mqtt_qos_t) ( id % 3 );
+    args->retain    = (uint8_t) ( id & 1 );
+}
+
+/* Returns the id of a message made by make_message(), or -1 */
+static int check_message( const mqtt_publish_arg_t* args )
+{
+    char topic[ 32 ];
+    int id;
+    int length;
+    int i;
+
+    if ( args->topic.len >= sizeof( topic ) )
+    {
+        return -1;
+    }
+    memcpy( topic, args->topic.str, args->topic.len );
+    topic[ args->topic.len ] = '\0';
+    if ( ( sscanf( topic, "t/%d", &id ) != 1 ) || ( id <= 0 ) || ( id >= next_id ) )
+    {
+        return -1;
+    }
+    length = ( id * 7919 ) % 500;
+    if ( ( (int) args->data_len != length ) || ( args->qos != (mqtt_qos_t) ( id % 3 ) ) || ( args->retain != ( id & 1 ) ) )
+    {
+        return -1;
+    }
+    for ( i = 0; i < length; i++ )
+    {
+        if ( args->data[ i ] != (uint8_t) ( id * 31 + i ) )
+        {
+            return -1;
+        }
+    }
+    return id;
+}
+
+static void append_one( void )
+{
+    static uint8_t payload[ 512 ];
+    mqtt_publish_arg_t args;
+    char topic[ 32 ];
+    int id = next_id++;
+
+    make_message( id, &args, topic, payload );
+    if ( mqtt_store_append( &store, &args ) == WICED_SUCCESS )
+    {
+        appended[ id ] = 1;
+    }
+}
+
+/* Reads the oldest message and either acknowledges it or gives up on it, as after a lost connection */
+static void drain_one( wiced_bool_t acknowledged )
+{
+    mqtt_publish_arg_t args;
+    int id;
+
+    if ( mqtt_store_read( &store, &args ) != WICED_SUCCESS )
+    {
+        return;
+    }
+    id = check_message( &args );
+    if ( id < 0 )
+    {
+        bad_contents++;
+        mqtt_store_cancel( &store );
+        return;
+    }
+    if ( acknowledged == WICED_FALSE )
+    {
+        mqtt_store_cancel( &store );
+        return;
+    }
+    if ( delivered[ id ] != 0 )
+    {
+        duplicates++;
+    }
+    else if ( id < last_delivered )
+    {
+        order_errors++;
+    }
+    delivered[ id ] = 1;
+    last_delivered  = id;
+    mqtt_store_release( &store );
+}
+
+/* Store rebuilt from flash, as after a restart; the RAM state of the one cut off is dropped */
+static void restart( void )
+{
+    free( store.sectors );
+    store.sectors = NULL;
+    if ( store.drain_buffer != NULL )
+    {
+        free( store.drain_buffer );
+    }
+    if ( mqtt_store_init( &store, &config ) != WICED_SUCCESS )
+    {
+        printf( "FAIL: store init after power cut %u\n", cuts );
+        exit( 1 );
+    }
+}
+
+/* A quarter of the rounds lose power somewhere in their flash operations */
+static void run_round( int max_steps )
+{
+    int i;
+
+    if ( setjmp( power_cut ) != 0 )
+    {
+        restart( );
+        return;
+    }
+    power_budget = ( rand( ) % 4 == 0 ) ? 1 + rand( ) % max_steps : -1;
+    for ( i = 0; i < OPERATIONS_PER_ROUND; i++ )
+    {
+        int operation = rand( ) % 10;
+
+        if ( rand( ) % 3 == 0 )
+        {
+            pump_worker( );
+        }
+        if ( operation < 5 )
+        {
+            append_one( );
+        }
+        else
+        {
+            drain_one( ( operation != 9 ) ? WICED_TRUE : WICED_FALSE );
+        }
+    }
+    power_budget = -1;
+}
+
+static unsigned drain_rate_test( void )
+{
+    static uint8_t payload[ 512 ];
+    wiced_mqtt_store_config_t paced = config;
+    mqtt_publish_arg_t args;
+    char topic[ 32 ];
+    unsigned sent = 0;
+    int i;
+
+    mqtt_store_deinit( &store );
+    memset( flash, 0xFF, sizeof( flash ) );
+    paced.drain_rate = 5;
+    now_ms = 0;
+    mqtt_store_init( &store, &paced );
+    for ( i = 0; i < 200; i++ )
+    {
+        make_message( next_id++, &args, topic, payload );
+        mqtt_store_append( &store, &args );
+    }
+    for ( ; now_ms < 10000; now_ms += 10 )
+    {
+        if ( mqtt_store_read( &store, &args ) == WICED_SUCCESS )
+        {
+            sent++;
+            mqtt_store_release( &store );
+        }
+    }
+    mqtt_store_deinit( &store );
+    return sent;
+}
+
+int main( int argc, char** argv )
+{
+    int rounds    = ( argc > 1 ) ? atoi( argv[ 1 ] ) : 2000;
+    int max_steps = ( argc > 3 ) ? atoi( argv[ 3 ] ) : 3000;
+    unsigned missing = 0;
+    unsigned sent;
+    unsigned min_erases = ~0U;
+    unsigned max_erases = 0;
+    unsigned count_below = 0;
+    unsigned count_above = 0;
+    int round;
+    int i;
+
+    srand( ( argc > 2 ) ? (unsigned) atoi( argv[ 2 ] ) : 1 );
+    memset( flash, 0xFF, sizeof( flash ) );
+    if ( mqtt_store_init( &store, &config ) != WICED_SUCCESS )
+    {
+        printf( "FAIL: store init\n" );
+        return 1;
+    }
+
+    for ( round = 0; round < rounds; round++ )
+    {
+        run_round( max_steps );
+    }
+
+    /* Everything left is drained with the power on */
+    for ( i = 0; ( i < 2 * MAX_MESSAGES ) && ( store.statistics.queued > 0 ); i++ )
+    {
+        drain_one( WICED_TRUE );
+    }
+    for ( i = 1; i < next_id; i++ )
+    {
+        if ( ( appended[ i ] != 0 ) && ( delivered[ i ] == 0 ) )
+        {
+            missing++;
+        }
+    }
+    for ( i = 0; i < AREA_SECTORS; i++ )
+    {
+        min_erases = MIN( min_erases, sector_erases[ i ] );
+        max_erases = MAX( max_erases, sector_erases[ i ] );
+        if ( store.sectors[ i ].erase_count < sector_erases[ i ] )
+        {
+            count_below++;
+        }
+        else
+        {
+            count_above = MAX( count_above, store.sectors[ i ].erase_count - sector_erases[ i ] );
+        }
+    }
+    printf( "messages %d  power cuts %u (%u in an erase)  missing %u  duplicates %u  out of order %u  bad %u  corrupted %u\n",
+            next_id - 1, cuts, erase_cuts, missing, duplicates, order_errors, bad_contents, (unsigned) store.statistics.corrupted );
+    printf( "sector erases min %u max %u, of blank sectors %u; recorded counts below the real ones %u, at most %u above\n",
+            min_erases, max_erases, blank_erases, count_below, count_above );
+
+    /* 5 a second over 10 s, plus the first second's burst */
+    sent = drain_rate_test( );
+    printf( "drain rate 5/s: %u sent in 10 s\n", sent );
+
+    if ( ( missing != 0 ) || ( duplicates != 0 ) || ( order_errors != 0 ) || ( bad_contents != 0 ) || ( blank_erases != 0 ) || ( count_below != 0 ) || ( sent < 50 ) || ( sent > 56 ) )
+    {
+        printf( "FAIL\n" );
+        return 1;
+    }
+    printf( "PASS\n" );
+    return 0;
+}
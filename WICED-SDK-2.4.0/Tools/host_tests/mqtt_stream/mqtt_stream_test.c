@@ -0,0 +1,753 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  MQTT receive path fed broker traffic cut at every offset
+ *
+ *  mqtt_network.c is included here so its decoder is driven through
+ *  wiced_process_mqtt_request(), as the network thread drives it, with
+ *  TCP packets taken from a model of the socket. The stream is what a
+ *  broker sends a subscriber: CONNACK, SUBACK, PUBLISHes at each QoS, the
+ *  acknowledgements, PINGRESPs, payloads either side of the one and two
+ *  octet remaining length boundaries, a frame of exactly the reassembly
+ *  limit, and frames over it with two, three and four octet lengths.
+ *
+ *  The stream is cut at every offset, at every pair of offsets (without
+ *  the large frames), into single octets, and into random packets of
+ *  chained fragments. A last case follows a few frames with a malformed
+ *  remaining length.
+ *
+ *  Fails if a frame reaches mqtt_frame_recv() other than whole and in
+ *  order, if a frame over the limit reaches it at all, if a frame held in
+ *  one fragment is copied or a frame across fragments is not, if the
+ *  malformed length does not end the connection after the frames ahead
+ *  of it, or if a packet or reassembly buffer is leaked.
+ *
+ *  Usage: mqtt_stream_test [random runs [seed]]
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define MAXIMUM_FRAMES          (64)
+#define MAXIMUM_FRAGMENTS       (3)                 /* Per packet, for the chained packet runs */
+#define FRAGMENT_CAPACITY       (1460)              /* A full Ethernet TCP segment */
+#define LARGE_FRAME_LENGTH      ( 2 * 1024 * 1024 ) /* Remaining length which needs four octets */
+
+/******************************************************
+ *               Allocation counting
+ ******************************************************/
+
+/* mqtt_network.c allocates reassembly buffers only; count them */
+static uint32_t buffers_outstanding;
+static uint64_t bytes_allocated;
+
+static void* test_malloc( size_t size )
+{
+    buffers_outstanding++;
+    bytes_allocated += size;
+    return malloc( size );
+}
+
+static void test_free( void* buffer )
+{
+    buffers_outstanding--;
+    free( buffer );
+}
+
+#define malloc( size )  test_malloc( size )
+#define free( buffer )  test_free( buffer )
+
+/******************************************************
+ *               Code under test
+ ******************************************************/
+
+#include "mqtt_network.c"
+
+#undef malloc
+#undef free
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/* A wiced_packet_t is a NetX packet; the model keeps its fragments after it */
+typedef struct
+{
+    NX_PACKET packet;
+    uint32_t  fragment_count;
+    uint16_t  fragment_length[ MAXIMUM_FRAGMENTS ];
+    uint8_t*  fragment[ MAXIMUM_FRAGMENTS ];
+    uint8_t   storage[ ];
+} test_packet_t;
+
+/* A frame of the stream, and whether mqtt_frame_recv() should see it */
+typedef struct
+{
+    uint32_t     offset;
+    uint32_t     length;
+    wiced_bool_t delivered;
+} stream_frame_t;
+
+typedef struct
+{
+    const char* name;
+    uint8_t*    data;
+    uint32_t    length;
+    uint32_t    good_length;    /* Octets ahead of a malformed header, or all of them */
+    uint32_t    frame_count;
+    stream_frame_t frames[ MAXIMUM_FRAMES ];
+} test_stream_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+
+mqtt_connection_t* g_p_mqtt_connection;
+int                g_mqtt_thread_is_running;
+
+static mqtt_socket_t  mqtt_socket;
+static uint32_t       random_state = 1;
+static uint32_t       errors;
+
+/* The socket's receive queue */
+static test_packet_t** queue;
+static uint32_t        queue_head;
+static uint32_t        queue_count;
+static uint32_t        packets_outstanding;
+static test_packet_t*  current_packet;
+
+/* The run in progress. Cuts are stream offsets where a fragment ends, in order */
+static const test_stream_t* run_stream;
+static uint32_t*            run_cuts;
+static uint32_t             run_cut_count;
+static uint32_t             next_frame;
+static uint32_t             disconnects;
+
+/* Totals */
+static uint64_t frames_checked;
+static uint64_t frames_in_place;
+static uint64_t bytes_copied;
+
+/******************************************************
+ *               Network, RTOS and TLS models
+ ******************************************************/
+
+static uint64_t now_ns( void )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+static test_packet_t* packet_new( const uint8_t* data, const uint16_t* fragment_length, uint32_t fragment_count )
+{
+    uint32_t       total = 0;
+    uint32_t       index;
+    test_packet_t* packet;
+    uint8_t*       out;
+
+    for ( index = 0; index < fragment_count; index++ )
+    {
+        total += fragment_length[ index ];
+    }
+    packet = calloc( 1, sizeof( test_packet_t ) + total );
+    packet->fragment_count = fragment_count;
+    out = packet->storage;
+    for ( index = 0; index < fragment_count; index++ )
+    {
+        packet->fragment[ index ]        = out;
+        packet->fragment_length[ index ] = fragment_length[ index ];
+        memcpy( out, data, fragment_length[ index ] );
+        data += fragment_length[ index ];
+        out  += fragment_length[ index ];
+    }
+    packet->packet.nx_packet_length = (ULONG) total;
+    packets_outstanding++;
+    return packet;
+}
+
+wiced_result_t wiced_tcp_receive( wiced_tcp_socket_t* socket, wiced_packet_t** packet, uint32_t timeout )
+{
+    UNUSED_PARAMETER( socket );
+    UNUSED_PARAMETER( timeout );
+
+    if ( queue_count == 0 )
+    {
+        return WICED_TIMEOUT;
+    }
+    current_packet = queue[ queue_head++ ];
+    queue_count--;
+    *packet = &current_packet->packet;
+    return WICED_SUCCESS;
+}
+
+/* As NetX: the fragment holding the offset, and what is left of the whole chain */
+wiced_result_t wiced_packet_get_data( wiced_packet_t* packet, uint16_t offset, uint8_t** data, uint16_t* data_length, uint16_t *available_data_length )
+{
+    test_packet_t* test_packet = (test_packet_t*) packet;
+    uint32_t       index;
+    uint32_t       start = 0;
+
+    if ( offset >= test_packet->packet.nx_packet_length )
+    {
+        *data_length           = 0;
+        *available_data_length = 0;
+        return WICED_SUCCESS;
+    }
+    for ( index = 0; offset >= start + test_packet->fragment_length[ index ]; index++ )
+    {
+        start += test_packet->fragment_length[ index ];
+    }
+    *data                  = test_packet->fragment[ index ] + ( offset - start );
+    *data_length           = (uint16_t) ( test_packet->fragment_length[ index ] - ( offset - start ) );
+    *available_data_length = (uint16_t) ( test_packet->packet.nx_packet_length - offset );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_packet_delete( wiced_packet_t* packet )
+{
+    if ( (test_packet_t*) packet == current_packet )
+    {
+        current_packet = NULL;
+    }
+    packets_outstanding--;
+    free( packet );
+    return WICED_SUCCESS;
+}
+
+/* Only the receive path runs; the rest of the network, RTOS and TLS calls are never made */
+wiced_result_t wiced_packet_create_tcp( wiced_tcp_socket_t* socket, uint16_t content_length, wiced_packet_t** packet, uint8_t** data, uint16_t* available_space ) { return WICED_ERROR; }
+wiced_result_t wiced_packet_set_data_end( wiced_packet_t* packet, uint8_t* data_end ) { return WICED_ERROR; }
+wiced_result_t wiced_tcp_create_socket( wiced_tcp_socket_t* socket, wiced_interface_t interface ) { return WICED_ERROR; }
+wiced_result_t wiced_tcp_delete_socket( wiced_tcp_socket_t* socket ) { return WICED_ERROR; }
+wiced_result_t wiced_tcp_connect( wiced_tcp_socket_t* socket, const wiced_ip_address_t* address, uint16_t port, uint32_t timeout_ms ) { return WICED_ERROR; }
+wiced_result_t wiced_tcp_disconnect( wiced_tcp_socket_t* socket ) { return WICED_ERROR; }
+wiced_result_t wiced_tcp_send_packet( wiced_tcp_socket_t* socket, wiced_packet_t* packet ) { return WICED_ERROR; }
+wiced_result_t wiced_tcp_enable_tls( wiced_tcp_socket_t* socket, void* context ) { return WICED_ERROR; }
+wiced_result_t wiced_tcp_register_callbacks( wiced_tcp_socket_t* socket, wiced_socket_callback_t connect_callback, wiced_socket_callback_t receive_callback, wiced_socket_callback_t disconnect_callback ) { return WICED_ERROR; }
+wiced_result_t wiced_tls_init_advanced_context( wiced_tls_advanced_context_t* context, const char* certificate, const char* key ) { return WICED_ERROR; }
+wiced_result_t wiced_tls_init_root_ca_certificates( const char* trusted_ca_certificates ) { return WICED_ERROR; }
+wiced_result_t wiced_tls_deinit_root_ca_certificates( void ) { return WICED_ERROR; }
+wiced_result_t wiced_tls_reset_context( wiced_tls_simple_context_t* tls_context ) { return WICED_ERROR; }
+platform_dct_security_t const* wiced_dct_get_security_section( void ) { return NULL; }
+wiced_result_t wiced_rtos_create_thread( wiced_thread_t* thread, uint8_t priority, const char* name, wiced_thread_function_t function, uint32_t stack_size, void* arg ) { return WICED_ERROR; }
+wiced_result_t wiced_rtos_delete_thread( wiced_thread_t* thread ) { return WICED_ERROR; }
+wiced_result_t wiced_rtos_thread_force_awake( wiced_thread_t* thread ) { return WICED_ERROR; }
+wiced_result_t wiced_rtos_is_current_thread( wiced_thread_t* thread ) { return WICED_ERROR; }
+wiced_result_t wiced_rtos_init_semaphore( wiced_semaphore_t* semaphore ) { return WICED_ERROR; }
+wiced_result_t wiced_rtos_deinit_semaphore( wiced_semaphore_t* semaphore ) { return WICED_ERROR; }
+wiced_result_t wiced_rtos_init_queue( wiced_queue_t* queue, const char* name, uint32_t message_size, uint32_t number_of_messages ) { return WICED_ERROR; }
+wiced_result_t wiced_rtos_push_to_queue( wiced_queue_t* queue, void* message, uint32_t timeout_ms ) { return WICED_ERROR; }
+wiced_result_t wiced_rtos_pop_from_queue( wiced_queue_t* queue, void* message, uint32_t timeout_ms ) { return WICED_ERROR; }
+wiced_result_t wiced_rtos_deinit_queue( wiced_queue_t* queue ) { return WICED_ERROR; }
+wiced_result_t mqtt_manager( mqtt_event_t event, void *args, mqtt_connection_t *conn ) { return WICED_ERROR; }
+wiced_result_t mqtt_topic_tree_init( mqtt_topic_tree_t *tree ) { return WICED_ERROR; }
+void mqtt_topic_tree_deinit( mqtt_topic_tree_t *tree ) { }
+void mqtt_store_deinit( mqtt_store_t *store ) { }
+
+/******************************************************
+ *               Framing layer model
+ ******************************************************/
+
+/* True if the frame at offset lies in one fragment of the run */
+static wiced_bool_t frame_in_one_fragment( uint32_t offset, uint32_t length )
+{
+    uint32_t low  = 0;
+    uint32_t high = run_cut_count;
+
+    /* First cut after the frame's first octet */
+    while ( low < high )
+    {
+        uint32_t middle = ( low + high ) / 2;
+        if ( run_cuts[ middle ] <= offset )
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return ( low == run_cut_count ) || ( run_cuts[ low ] >= offset + length );
+}
+
+static wiced_bool_t buffer_in_fragment( const test_packet_t* packet, const uint8_t* data, uint32_t length )
+{
+    uint32_t index;
+
+    for ( index = 0; index < packet->fragment_count; index++ )
+    {
+        if ( ( data >= packet->fragment[ index ] ) && ( data + length <= packet->fragment[ index ] + packet->fragment_length[ index ] ) )
+        {
+            return WICED_TRUE;
+        }
+    }
+    return WICED_FALSE;
+}
+
+wiced_result_t mqtt_frame_recv( wiced_mqtt_buffer_t* buffer, void* p_user, uint32_t* size )
+{
+    const stream_frame_t* frame;
+    wiced_bool_t          in_place;
+
+    UNUSED_PARAMETER( p_user );
+    UNUSED_PARAMETER( size );
+
+    if ( buffer == NULL )
+    {
+        disconnects++;
+        return WICED_SUCCESS;
+    }
+
+    while ( ( next_frame < run_stream->frame_count ) && ( run_stream->frames[ next_frame ].delivered == WICED_FALSE ) )
+    {
+        next_frame++;
+    }
+    if ( ( next_frame == run_stream->frame_count ) || ( disconnects != 0 ) )
+    {
+        if ( errors++ < 10 ) printf( "%s: frame delivered after the last one or after disconnecting\n", run_stream->name );
+        return WICED_SUCCESS;
+    }
+
+    frame    = &run_stream->frames[ next_frame++ ];
+    in_place = ( buffer->packet != NULL ) ? WICED_TRUE : WICED_FALSE;
+    frames_checked++;
+
+    if ( memcmp( buffer->data, run_stream->data + frame->offset, frame->length ) != 0 )
+    {
+        if ( errors++ < 10 ) printf( "%s: frame %u at offset %u delivered with the wrong contents\n", run_stream->name, (unsigned) ( next_frame - 1 ), (unsigned) frame->offset );
+    }
+    if ( in_place != frame_in_one_fragment( frame->offset, frame->length ) )
+    {
+        if ( errors++ < 10 ) printf( "%s: frame %u at offset %u %s\n", run_stream->name, (unsigned) ( next_frame - 1 ), (unsigned) frame->offset,
+                                     in_place ? "delivered in place across fragments" : "copied though held in one fragment" );
+    }
+    if ( in_place )
+    {
+        frames_in_place++;
+        if ( ( (test_packet_t*) buffer->packet != current_packet ) || ( buffer_in_fragment( current_packet, buffer->data, frame->length ) == WICED_FALSE ) )
+        {
+            if ( errors++ < 10 ) printf( "%s: frame %u delivered in place outside the packet being read\n", run_stream->name, (unsigned) ( next_frame - 1 ) );
+        }
+    }
+    else
+    {
+        bytes_copied += frame->length;
+    }
+    return WICED_SUCCESS;
+}
+
+/******************************************************
+ *               Static Function Definitions
+ ******************************************************/
+
+static uint32_t test_random( void )
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+/* Appends a frame whose body is the given octets, padded with a pattern to body_length */
+static void put_frame( test_stream_t* stream, uint8_t type, const uint8_t* body, uint32_t body_start_length, uint32_t body_length )
+{
+    stream_frame_t* frame     = &stream->frames[ stream->frame_count++ ];
+    uint32_t        remaining = body_length;
+    uint8_t*        out;
+    uint32_t        index;
+
+    stream->data = realloc( stream->data, stream->length + 5 + body_length );
+    out = stream->data + stream->length;
+    frame->offset = stream->length;
+
+    *out++ = type;
+    do
+    {
+        uint8_t octet = (uint8_t) ( remaining & 127 );
+        remaining >>= 7;
+        *out++ = ( remaining != 0 ) ? (uint8_t) ( octet | 128 ) : octet;
+    } while ( remaining != 0 );
+
+    if ( body_start_length != 0 )
+    {
+        memcpy( out, body, body_start_length );
+    }
+    for ( index = body_start_length; index < body_length; index++ )
+    {
+        out[ index ] = (uint8_t) ( index * 7 + stream->frame_count );
+    }
+    out += body_length;
+
+    frame->length    = (uint32_t) ( out - ( stream->data + stream->length ) );
+    frame->delivered = ( frame->length <= MQTT_DECODER_MAXIMUM_FRAME_LENGTH ) ? WICED_TRUE : WICED_FALSE;
+    stream->length  += frame->length;
+    stream->good_length = stream->length;
+}
+
+/* A PUBLISH of topic and a payload making the remaining length up to remaining_length */
+static void put_publish( test_stream_t* stream, uint8_t qos, uint16_t packet_id, const char* topic, uint32_t remaining_length )
+{
+    uint8_t  body[ 64 ];
+    uint32_t topic_length = (uint32_t) strlen( topic );
+    uint32_t length       = 0;
+
+    body[ length++ ] = (uint8_t) ( topic_length >> 8 );
+    body[ length++ ] = (uint8_t) topic_length;
+    memcpy( body + length, topic, topic_length );
+    length += topic_length;
+    if ( qos != 0 )
+    {
+        body[ length++ ] = (uint8_t) ( packet_id >> 8 );
+        body[ length++ ] = (uint8_t) packet_id;
+    }
+    put_frame( stream, (uint8_t) ( 0x30 | ( qos << 1 ) ), body, length, remaining_length );
+}
+
+static void put_ack( test_stream_t* stream, uint8_t type, uint16_t packet_id )
+{
+    uint8_t body[ 2 ] = { (uint8_t) ( packet_id >> 8 ), (uint8_t) packet_id };
+    put_frame( stream, type, body, 2, 2 );
+}
+
+/* What a subscriber hears from a broker in a short session */
+static void build_session( test_stream_t* stream, wiced_bool_t large_frames )
+{
+    static const uint8_t connack[ ] = { 0x00, 0x00 };
+    static const uint8_t suback[ ]  = { 0x00, 0x01, 0x00, 0x01, 0x80 };
+    uint32_t header_length;
+
+    put_frame( stream, 0x20, connack, sizeof( connack ), sizeof( connack ) );
+    put_frame( stream, 0x90, suback, sizeof( suback ), sizeof( suback ) );
+    put_publish( stream, 0, 0, "wizfi/sensor/1", 20 );
+    put_publish( stream, 1, 2, "wizfi/sensor/2", 300 );
+    put_ack( stream, 0x40, 7 );                                 /* PUBACK  */
+    put_frame( stream, 0xD0, NULL, 0, 0 );                      /* PINGRESP */
+    put_publish( stream, 2, 3, "wizfi/cmd", 127 );              /* Largest one octet length */
+    put_ack( stream, 0x62, 3 );                                 /* PUBREL  */
+    put_publish( stream, 0, 0, "wizfi/cmd", 128 );              /* Smallest two octet length */
+    put_ack( stream, 0x50, 8 );                                 /* PUBREC  */
+    put_ack( stream, 0x70, 8 );                                 /* PUBCOMP */
+    put_ack( stream, 0xB0, 5 );                                 /* UNSUBACK */
+    put_publish( stream, 1, 9, "wizfi/fw", 1000 );
+
+    if ( large_frames == WICED_TRUE )
+    {
+        /* Exactly the limit, then one octet over it */
+        header_length = 3;
+        put_publish( stream, 1, 10, "wizfi/fw", MQTT_DECODER_MAXIMUM_FRAME_LENGTH - header_length );
+        put_publish( stream, 1, 11, "wizfi/fw", MQTT_DECODER_MAXIMUM_FRAME_LENGTH - header_length + 1 );
+        put_publish( stream, 0, 0, "wizfi/log", 5 );
+        put_publish( stream, 0, 0, "wizfi/fw", 20000 );         /* Three octet length */
+        put_frame( stream, 0xD0, NULL, 0, 0 );
+    }
+
+    put_publish( stream, 0, 0, "wizfi/sensor/1", 2 );
+    put_frame( stream, 0xD0, NULL, 0, 0 );
+}
+
+static void start_run( const test_stream_t* stream, uint32_t* cuts, uint32_t cut_count )
+{
+    memset( &mqtt_socket.decoder, 0, sizeof( mqtt_socket.decoder ) );
+    run_stream    = stream;
+    run_cuts      = cuts;
+    run_cut_count = cut_count;
+    next_frame    = 0;
+    disconnects   = 0;
+    queue_head    = 0;
+    queue_count   = 0;
+}
+
+static void queue_packet( test_packet_t* packet )
+{
+    queue[ queue_head + queue_count++ ] = packet;
+}
+
+static void end_run( void )
+{
+    const test_stream_t* stream = run_stream;
+    uint32_t             expected = 0;
+    uint32_t             index;
+
+    for ( index = 0; index < stream->frame_count; index++ )
+    {
+        expected += ( stream->frames[ index ].delivered == WICED_TRUE ) ? 1 : 0;
+    }
+    for ( index = 0; index < next_frame; index++ )
+    {
+        expected -= ( stream->frames[ index ].delivered == WICED_TRUE ) ? 1 : 0;
+    }
+
+    if ( stream->good_length == stream->length )
+    {
+        if ( ( expected != 0 ) || ( disconnects != 0 ) )
+        {
+            if ( errors++ < 10 ) printf( "%s: %u frames missing, %u disconnects\n", stream->name, (unsigned) expected, (unsigned) disconnects );
+        }
+        if ( mqtt_socket.decoder.state != MQTT_DECODER_STATE_HEADER )
+        {
+            if ( errors++ < 10 ) printf( "%s: decoder left mid-frame at the end of the stream\n", stream->name );
+        }
+    }
+    else
+    {
+        if ( ( expected != 0 ) || ( disconnects != 1 ) )
+        {
+            if ( errors++ < 10 ) printf( "%s: %u frames ahead of the malformed length missing, %u disconnects\n", stream->name, (unsigned) expected, (unsigned) disconnects );
+        }
+    }
+
+    /* A closed connection leaves packets unread */
+    while ( queue_count != 0 )
+    {
+        queue_count--;
+        wiced_packet_delete( &queue[ queue_head++ ]->packet );
+    }
+    mqtt_network_reset_decoder( &mqtt_socket );
+    if ( ( packets_outstanding != 0 ) || ( buffers_outstanding != 0 ) )
+    {
+        if ( errors++ < 10 ) printf( "%s: %u packets and %u reassembly buffers leaked\n", stream->name, (unsigned) packets_outstanding, (unsigned) buffers_outstanding );
+        packets_outstanding = 0;
+        buffers_outstanding = 0;
+    }
+}
+
+/* One packet of one fragment per piece between cuts, each read as it arrives, as the network thread reads them. Pieces stay under 64 KB */
+static void run_cuts_single( const test_stream_t* stream, uint32_t* cuts, uint32_t cut_count )
+{
+    uint32_t start = 0;
+    uint32_t index;
+
+    start_run( stream, cuts, cut_count );
+    for ( index = 0; ( index <= cut_count ) && ( disconnects == 0 ); index++ )
+    {
+        uint32_t end = ( index < cut_count ) ? cuts[ index ] : stream->length;
+        uint16_t length = (uint16_t) ( end - start );
+
+        queue_packet( packet_new( stream->data + start, &length, 1 ) );
+        wiced_process_mqtt_request( &mqtt_socket );
+        start = end;
+    }
+    end_run( );
+}
+
+static void split_at_every_offset( const test_stream_t* stream )
+{
+    uint32_t cut;
+
+    for ( cut = 1; cut < stream->length; cut++ )
+    {
+        run_cuts_single( stream, &cut, 1 );
+    }
+}
+
+static void split_at_every_pair( const test_stream_t* stream )
+{
+    uint32_t cuts[ 2 ];
+
+    for ( cuts[ 0 ] = 1; cuts[ 0 ] < stream->length; cuts[ 0 ]++ )
+    {
+        for ( cuts[ 1 ] = cuts[ 0 ] + 1; cuts[ 1 ] < stream->length; cuts[ 1 ]++ )
+        {
+            run_cuts_single( stream, cuts, 2 );
+        }
+    }
+}
+
+static void split_evenly( const test_stream_t* stream, uint32_t piece )
+{
+    uint32_t  cut_count = ( stream->length - 1 ) / piece;
+    uint32_t* cuts      = malloc( ( cut_count + 1 ) * sizeof( uint32_t ) );
+    uint32_t  index;
+
+    for ( index = 0; index < cut_count; index++ )
+    {
+        cuts[ index ] = ( index + 1 ) * piece;
+    }
+    run_cuts_single( stream, cuts, cut_count );
+    free( cuts );
+}
+
+/* Random packets of one to three fragments, a few queued at a time before each read */
+static void split_randomly( const test_stream_t* stream )
+{
+    uint32_t* cuts      = malloc( ( stream->length + 1 ) * sizeof( uint32_t ) );
+    uint32_t  cut_count = 0;
+    uint32_t  start     = 0;
+
+    /* Cuts first, so the framing model knows them as frames arrive */
+    while ( start < stream->length )
+    {
+        uint32_t length = ( test_random( ) % 4 == 0 ) ? 1 + test_random( ) % 8 : 1 + test_random( ) % FRAGMENT_CAPACITY;
+        start += length;
+        if ( start < stream->length )
+        {
+            cuts[ cut_count++ ] = start;
+        }
+    }
+
+    start_run( stream, cuts, cut_count );
+    start = 0;
+    while ( ( start < stream->length ) && ( disconnects == 0 ) )
+    {
+        uint32_t burst = 1 + test_random( ) % 4;
+
+        while ( ( burst-- != 0 ) && ( start < stream->length ) )
+        {
+            uint16_t fragment_length[ MAXIMUM_FRAGMENTS ];
+            uint32_t fragment_count = 1 + test_random( ) % MAXIMUM_FRAGMENTS;
+            uint32_t packet_start   = start;
+            uint32_t index;
+
+            for ( index = 0; ( index < fragment_count ) && ( start < stream->length ); index++ )
+            {
+                uint32_t cut = 0;
+                uint32_t low = 0;
+                uint32_t high = cut_count;
+
+                /* Next cut after start */
+                while ( low < high )
+                {
+                    uint32_t middle = ( low + high ) / 2;
+                    if ( cuts[ middle ] <= start ) low = middle + 1; else high = middle;
+                }
+                cut = ( low < cut_count ) ? cuts[ low ] : stream->length;
+                fragment_length[ index ] = (uint16_t) ( cut - start );
+                start = cut;
+            }
+            queue_packet( packet_new( stream->data + packet_start, fragment_length, index ) );
+        }
+        wiced_process_mqtt_request( &mqtt_socket );
+    }
+    end_run( );
+    free( cuts );
+}
+
+static void report( const char* name, uint64_t runs, uint64_t started_ns )
+{
+    printf( "%-40s %9llu runs, %10llu frames, %5.1f%% in place, %12llu bytes copied, %7.0f ns per run\n",
+            name, (unsigned long long) runs, (unsigned long long) frames_checked,
+            ( frames_checked != 0 ) ? 100.0 * (double) frames_in_place / (double) frames_checked : 0.0,
+            (unsigned long long) bytes_copied, (double) ( now_ns( ) - started_ns ) / (double) runs );
+    frames_checked  = 0;
+    frames_in_place = 0;
+    bytes_copied    = 0;
+}
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+int main( int argc, char* argv[] )
+{
+    uint32_t      random_runs = ( argc > 1 ) ? (uint32_t) strtoul( argv[ 1 ], NULL, 0 ) : 2000;
+    uint32_t      seed        = ( argc > 2 ) ? (uint32_t) strtoul( argv[ 2 ], NULL, 0 ) : 1;
+    test_stream_t full        = { .name = "full session" };
+    test_stream_t small       = { .name = "session without large frames" };
+    test_stream_t malformed   = { .name = "malformed length" };
+    test_stream_t huge        = { .name = "four octet length" };
+    static const uint8_t bad_length[ ] = { 0x30, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+    uint32_t      stream_length;
+    uint32_t      index;
+    uint32_t      piece;
+    uint64_t      started;
+    wiced_bool_t  failed;
+
+    random_state = ( seed != 0 ) ? seed : 1;
+
+    build_session( &full, WICED_TRUE );
+    build_session( &small, WICED_FALSE );
+
+    /* Two frames, a remaining length of five octets, then frames the client must never see */
+    put_frame( &malformed, 0x20, (const uint8_t*) "\0\0", 2, 2 );
+    put_publish( &malformed, 0, 0, "wizfi/sensor/1", 40 );
+    stream_length = malformed.length;
+    put_publish( &malformed, 0, 0, "wizfi/sensor/1", 40 );
+    memcpy( malformed.data + stream_length, bad_length, sizeof( bad_length ) );
+    malformed.frames[ malformed.frame_count - 1 ].delivered = WICED_FALSE;
+    put_publish( &malformed, 0, 0, "wizfi/sensor/1", 40 );
+    put_frame( &malformed, 0xD0, NULL, 0, 0 );
+    for ( index = 3; index < malformed.frame_count; index++ )
+    {
+        malformed.frames[ index ].delivered = WICED_FALSE;
+    }
+    malformed.good_length = stream_length;
+
+    put_publish( &huge, 1, 12, "wizfi/fw", LARGE_FRAME_LENGTH );
+    put_publish( &huge, 0, 0, "wizfi/sensor/1", 2 );
+
+    queue = malloc( ( huge.length + 1 ) * sizeof( test_packet_t* ) );
+    mqtt_socket.p_user = &mqtt_socket;
+
+    printf( "streams: %u octets in %u frames, %u octets in %u frames, %u octet frame with a four octet length\n",
+            (unsigned) full.length, (unsigned) full.frame_count, (unsigned) small.length, (unsigned) small.frame_count, (unsigned) huge.frames[ 0 ].length );
+
+    started = now_ns( );
+    split_at_every_offset( &full );
+    report( "full session, one cut at every offset", full.length - 1, started );
+
+    started = now_ns( );
+    split_at_every_pair( &small );
+    report( "small session, two cuts at every offset", (uint64_t) ( small.length - 1 ) * ( small.length - 2 ) / 2, started );
+
+    started = now_ns( );
+    split_evenly( &full, 1 );
+    report( "full session, one octet per packet", 1, started );
+
+    for ( piece = 536; piece <= 1460; piece += 1460 - 536 )
+    {
+        char name[ 64 ];
+        started = now_ns( );
+        split_evenly( &full, piece );
+        snprintf( name, sizeof( name ), "full session, %u octet segments", (unsigned) piece );
+        report( name, 1, started );
+    }
+
+    started = now_ns( );
+    for ( index = 0; index < random_runs; index++ )
+    {
+        split_randomly( &full );
+    }
+    report( "full session, random chained packets", random_runs, started );
+
+    started = now_ns( );
+    for ( index = 0; index < 10; index++ )
+    {
+        split_randomly( &huge );
+    }
+    report( "four octet length, random chained packets", 10, started );
+
+    started = now_ns( );
+    split_at_every_offset( &malformed );
+    for ( index = 0; index < random_runs; index++ )
+    {
+        split_randomly( &malformed );
+    }
+    report( "malformed length, every offset and random", malformed.length - 1 + random_runs, started );
+
+    printf( "%llu bytes of reassembly buffers allocated, %u errors\n", (unsigned long long) bytes_allocated, (unsigned) errors );
+
+    free( queue );
+    free( full.data );
+    free( small.data );
+    free( malformed.data );
+    free( huge.data );
+
+    failed = ( errors != 0 );
+    printf( failed ? "FAIL\n" : "PASS\n" );
+    return failed;
+}
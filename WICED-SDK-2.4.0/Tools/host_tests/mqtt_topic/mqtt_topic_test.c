@@ -0,0 +1,693 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  MQTT topic filter tree against the MQTT 3.1.1 wildcard rules
+ *
+ *  mqtt_topic.c is included with malloc() and free() counted, and with an
+ *  allocation that can be made to fail. The test checks which filters are
+ *  accepted, then the examples of section 4.7 of the specification. It then
+ *  builds random filters and topics from a few level names, including empty
+ *  levels and names starting with '$'. It subscribes and unsubscribes them
+ *  in random order and dispatches every topic after each change. The
+ *  callbacks that run must be exactly those a plain level-by-level matcher
+ *  picks. The same happens while allocations fail one by one.
+ *
+ *  Then it times dispatch with thousands of subscriptions in the tree, next
+ *  to a scan of every filter with the plain matcher.
+ *
+ *  Fails if a filter is accepted or refused against the rules, if a callback
+ *  runs for a topic its filter does not match or does not run for one it
+ *  does, if the count dispatch returns is wrong, if unsubscribing a filter
+ *  not subscribed succeeds, if a failed allocation leaves nodes or memory
+ *  behind, or if the hash table has not grown with the tree.
+ *
+ *  Usage: mqtt_topic_test [random rounds [seed]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "wiced.h"
+
+static void* test_malloc( size_t size );
+static void  test_free( void* pointer );
+
+#define malloc( size )  test_malloc( size )
+#define free( pointer ) test_free( pointer )
+#include "mqtt_topic.c"
+#undef malloc
+#undef free
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define MAXIMUM_LEVELS          (5)
+#define MAXIMUM_NAME            (64)
+#define RANDOM_FILTERS          (400)
+#define RANDOM_TOPICS           (300)
+#define BENCHMARK_TOPICS        (1024)
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct
+{
+    const char*  filter;
+    wiced_bool_t valid;
+} filter_case_t;
+
+typedef struct
+{
+    const char*  filter;
+    const char*  topic;
+    wiced_bool_t match;
+} match_case_t;
+
+typedef struct
+{
+    char         name[ MAXIMUM_NAME ];
+    wiced_bool_t subscribed;
+    uint32_t     hits;
+} test_filter_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static const filter_case_t filter_cases[] =
+{
+    { "sport/tennis/player1",   WICED_TRUE  },
+    { "sport/tennis/#",         WICED_TRUE  },
+    { "sport/#",                WICED_TRUE  },
+    { "#",                      WICED_TRUE  },
+    { "+",                      WICED_TRUE  },
+    { "+/tennis/#",             WICED_TRUE  },
+    { "sport/+/player1",        WICED_TRUE  },
+    { "/",                      WICED_TRUE  },
+    { "+/+",                    WICED_TRUE  },
+    { "/+",                     WICED_TRUE  },
+    { "//#",                    WICED_TRUE  },
+    { "$SYS/#",                 WICED_TRUE  },
+    { "",                       WICED_FALSE },
+    { "sport/tennis#",          WICED_FALSE },
+    { "sport/tennis/#/ranking", WICED_FALSE },
+    { "#/",                     WICED_FALSE },
+    { "##",                     WICED_FALSE },
+    { "sport+",                 WICED_FALSE },
+    { "+sport",                 WICED_FALSE },
+    { "sport/+tennis",          WICED_FALSE },
+    { "++",                     WICED_FALSE },
+    { "a/b+/c",                 WICED_FALSE },
+};
+
+static const match_case_t match_cases[] =
+{
+    /* 4.7.1.2 multi-level wildcard */
+    { "sport/tennis/player1/#", "sport/tennis/player1",                 WICED_TRUE  },
+    { "sport/tennis/player1/#", "sport/tennis/player1/ranking",         WICED_TRUE  },
+    { "sport/tennis/player1/#", "sport/tennis/player1/score/wimbledon", WICED_TRUE  },
+    { "sport/tennis/player1/#", "sport/tennis",                         WICED_FALSE },
+    { "sport/#",                "sport",                                WICED_TRUE  },
+    { "#",                      "sport/tennis",                         WICED_TRUE  },
+    { "#",                      "/",                                    WICED_TRUE  },
+    /* 4.7.1.3 single-level wildcard */
+    { "sport/tennis/+",         "sport/tennis/player1",                 WICED_TRUE  },
+    { "sport/tennis/+",         "sport/tennis/player2",                 WICED_TRUE  },
+    { "sport/tennis/+",         "sport/tennis/player1/ranking",         WICED_FALSE },
+    { "sport/tennis/+",         "sport/tennis",                         WICED_FALSE },
+    { "sport/+",                "sport",                                WICED_FALSE },
+    { "sport/+",                "sport/",                               WICED_TRUE  },
+    { "+/+",                    "/finance",                             WICED_TRUE  },
+    { "/+",                     "/finance",                             WICED_TRUE  },
+    { "+",                      "/finance",                             WICED_FALSE },
+    { "+",                      "finance",                              WICED_TRUE  },
+    { "+/tennis/#",             "sport/tennis/player1",                 WICED_TRUE  },
+    { "sport/+/player1",        "sport/tennis/player1",                 WICED_TRUE  },
+    { "sport/+/player1",        "sport/tennis/player2",                 WICED_FALSE },
+    /* 4.7.2 topics beginning with $ */
+    { "#",                      "$SYS/uptime",                          WICED_FALSE },
+    { "+/monitor/Clients",      "$SYS/monitor/Clients",                 WICED_FALSE },
+    { "$SYS/#",                 "$SYS/monitor/Clients",                 WICED_TRUE  },
+    { "$SYS/monitor/+",         "$SYS/monitor/Clients",                 WICED_TRUE  },
+    { "+/+",                    "a/$SYS",                               WICED_TRUE  },
+    /* 4.7.3 topic semantics */
+    { "ACCOUNTS",               "Accounts",                             WICED_FALSE },
+    { "Accounts payable",       "Accounts payable",                     WICED_TRUE  },
+    { "/finance",               "finance",                              WICED_FALSE },
+    { "finance",                "/finance",                             WICED_FALSE },
+    { "a//b",                   "a//b",                                 WICED_TRUE  },
+    { "a/+/b",                  "a//b",                                 WICED_TRUE  },
+    { "a/+/b",                  "a/b",                                  WICED_FALSE },
+};
+
+/* Level names random filters and topics are made of */
+static const char* const level_names[] = { "a", "b", "ab", "", "$s" };
+
+static test_filter_t* filters;
+static uint32_t       filter_count;
+static uint32_t       random_state = 1;
+static uint32_t       errors;
+static uint32_t       allocations;
+static uint32_t       fail_allocation;   /* The allocation to fail, counting down; 0 fails none */
+static uint32_t       wrong_arg;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+static void* test_malloc( size_t size )
+{
+    if ( ( fail_allocation != 0 ) && ( --fail_allocation == 0 ) )
+    {
+        return NULL;
+    }
+    allocations++;
+    return malloc( size );
+}
+
+static void test_free( void* pointer )
+{
+    if ( pointer != NULL )
+    {
+        allocations--;
+    }
+    free( pointer );
+}
+
+static uint32_t test_random( void )
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static uint64_t now_ns( void )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+/* Splits a filter or topic at '/' into at most MAXIMUM_LEVELS * 2 levels */
+static uint32_t split_levels( const char* name, const char** levels, uint32_t* lengths )
+{
+    uint32_t count = 0;
+
+    for ( ;; )
+    {
+        const char* separator = strchr( name, '/' );
+
+        levels[ count ]  = name;
+        lengths[ count ] = ( separator != NULL ) ? (uint32_t) ( separator - name ) : (uint32_t) strlen( name );
+        count++;
+        if ( separator == NULL )
+        {
+            return count;
+        }
+        name = separator + 1;
+    }
+}
+
+/* The rules of section 4.7 read level by level, to check the tree against */
+static wiced_bool_t reference_match( const char* filter, const char* topic )
+{
+    const char* filter_levels[ MAXIMUM_LEVELS * 2 ];
+    const char* topic_levels[ MAXIMUM_LEVELS * 2 ];
+    uint32_t    filter_lengths[ MAXIMUM_LEVELS * 2 ];
+    uint32_t    topic_lengths[ MAXIMUM_LEVELS * 2 ];
+    uint32_t    filter_level_count = split_levels( filter, filter_levels, filter_lengths );
+    uint32_t    topic_level_count  = split_levels( topic, topic_levels, topic_lengths );
+    uint32_t    index;
+
+    if ( ( topic[ 0 ] == '$' ) && ( ( filter[ 0 ] == '+' ) || ( filter[ 0 ] == '#' ) ) )
+    {
+        return WICED_FALSE;
+    }
+    for ( index = 0; index < filter_level_count; index++ )
+    {
+        if ( ( filter_lengths[ index ] == 1 ) && ( filter_levels[ index ][ 0 ] == '#' ) )
+        {
+            return WICED_TRUE;
+        }
+        if ( index == topic_level_count )
+        {
+            return WICED_FALSE;
+        }
+        if ( ( filter_lengths[ index ] == 1 ) && ( filter_levels[ index ][ 0 ] == '+' ) )
+        {
+            continue;
+        }
+        if ( ( filter_lengths[ index ] != topic_lengths[ index ] ) || ( memcmp( filter_levels[ index ], topic_levels[ index ], topic_lengths[ index ] ) != 0 ) )
+        {
+            return WICED_FALSE;
+        }
+    }
+    return ( filter_level_count == topic_level_count ) ? WICED_TRUE : WICED_FALSE;
+}
+
+static void count_hit( wiced_mqtt_object_t mqtt_object, wiced_mqtt_topic_msg_t *message, void *arg )
+{
+    uint32_t index = (uint32_t) (uintptr_t) arg;
+
+    UNUSED_PARAMETER( message );
+    if ( ( mqtt_object != (wiced_mqtt_object_t) &filters ) || ( index >= filter_count ) )
+    {
+        wrong_arg++;
+        return;
+    }
+    filters[ index ].hits++;
+}
+
+static void ignore_message( wiced_mqtt_object_t mqtt_object, wiced_mqtt_topic_msg_t *message, void *arg )
+{
+    UNUSED_PARAMETER( mqtt_object );
+    UNUSED_PARAMETER( message );
+    UNUSED_PARAMETER( arg );
+}
+
+static uint32_t dispatch( mqtt_topic_tree_t* tree, const char* topic )
+{
+    wiced_mqtt_topic_msg_t message;
+
+    memset( &message, 0, sizeof( message ) );
+    message.topic     = (uint8_t*) topic;
+    message.topic_len = (uint32_t) strlen( topic );
+    return mqtt_topic_tree_dispatch( tree, (wiced_mqtt_object_t) &filters, &message );
+}
+
+static wiced_result_t subscribe( mqtt_topic_tree_t* tree, uint32_t index )
+{
+    return mqtt_topic_tree_add( tree, (const uint8_t*) filters[ index ].name, (uint16_t) strlen( filters[ index ].name ), count_hit, (void*) (uintptr_t) index );
+}
+
+static wiced_result_t unsubscribe( mqtt_topic_tree_t* tree, uint32_t index )
+{
+    return mqtt_topic_tree_remove( tree, (const uint8_t*) filters[ index ].name, (uint16_t) strlen( filters[ index ].name ) );
+}
+
+/* Dispatches the topic and checks each filter's callback ran exactly when the rules say it must */
+static void check_topic( mqtt_topic_tree_t* tree, const char* topic, const char* when )
+{
+    uint32_t expected = 0;
+    uint32_t delivered;
+    uint32_t index;
+
+    for ( index = 0; index < filter_count; index++ )
+    {
+        filters[ index ].hits = 0;
+    }
+    delivered = dispatch( tree, topic );
+    for ( index = 0; index < filter_count; index++ )
+    {
+        uint32_t should = ( ( filters[ index ].subscribed == WICED_TRUE ) && ( reference_match( filters[ index ].name, topic ) == WICED_TRUE ) ) ? 1 : 0;
+
+        expected += should;
+        if ( filters[ index ].hits != should )
+        {
+            if ( errors++ < 10 ) printf( "%s: filter \"%s\" called %u times for topic \"%s\", expected %u\n", when, filters[ index ].name, (unsigned) filters[ index ].hits, topic, (unsigned) should );
+        }
+    }
+    if ( delivered != expected )
+    {
+        if ( errors++ < 10 ) printf( "%s: dispatch of \"%s\" returned %u, expected %u\n", when, topic, (unsigned) delivered, (unsigned) expected );
+    }
+}
+
+/******************************************************
+ *               Validation and examples
+ ******************************************************/
+
+static void test_filters( void )
+{
+    mqtt_topic_tree_t tree;
+    uint32_t          index;
+
+    mqtt_topic_tree_init( &tree );
+    for ( index = 0; index < sizeof( filter_cases ) / sizeof( filter_cases[ 0 ] ); index++ )
+    {
+        const filter_case_t* test_case = &filter_cases[ index ];
+        wiced_result_t       result    = mqtt_topic_tree_add( &tree, (const uint8_t*) test_case->filter, (uint16_t) strlen( test_case->filter ), ignore_message, NULL );
+
+        if ( ( result == WICED_SUCCESS ) != ( test_case->valid == WICED_TRUE ) )
+        {
+            if ( errors++ < 10 ) printf( "filter \"%s\" %s\n", test_case->filter, ( result == WICED_SUCCESS ) ? "accepted" : "refused" );
+        }
+    }
+    mqtt_topic_tree_deinit( &tree );
+}
+
+static void test_examples( void )
+{
+    test_filter_t     example;
+    mqtt_topic_tree_t tree;
+    uint32_t          index;
+
+    filters      = &example;
+    filter_count = 1;
+    for ( index = 0; index < sizeof( match_cases ) / sizeof( match_cases[ 0 ] ); index++ )
+    {
+        const match_case_t* test_case = &match_cases[ index ];
+
+        if ( reference_match( test_case->filter, test_case->topic ) != test_case->match )
+        {
+            if ( errors++ < 10 ) printf( "reference matcher wrong on \"%s\" and \"%s\"\n", test_case->filter, test_case->topic );
+        }
+
+        mqtt_topic_tree_init( &tree );
+        strcpy( example.name, test_case->filter );
+        example.subscribed = WICED_TRUE;
+        subscribe( &tree, 0 );
+        check_topic( &tree, test_case->topic, "example" );
+
+        /* Subscribing again replaces the callback rather than adding a second one */
+        subscribe( &tree, 0 );
+        check_topic( &tree, test_case->topic, "subscribed twice" );
+
+        /* Only the filter itself unsubscribes, not a level above or below it */
+        if ( mqtt_topic_tree_remove( &tree, (const uint8_t*) "sport", 5 ) == WICED_SUCCESS )
+        {
+            if ( errors++ < 10 ) printf( "\"sport\" unsubscribed with only \"%s\" subscribed\n", test_case->filter );
+        }
+        if ( ( unsubscribe( &tree, 0 ) != WICED_SUCCESS ) || ( tree.node_count != 0 ) )
+        {
+            if ( errors++ < 10 ) printf( "\"%s\" not unsubscribed, %u nodes left\n", test_case->filter, (unsigned) tree.node_count );
+        }
+        example.subscribed = WICED_FALSE;
+        check_topic( &tree, test_case->topic, "unsubscribed" );
+        if ( unsubscribe( &tree, 0 ) != WICED_NOTFOUND )
+        {
+            if ( errors++ < 10 ) printf( "\"%s\" unsubscribed twice\n", test_case->filter );
+        }
+        mqtt_topic_tree_deinit( &tree );
+    }
+}
+
+/******************************************************
+ *               Random filters and topics
+ ******************************************************/
+
+/* Filters and topics are at least one character long, so a name of one empty level is drawn again */
+static void random_name( char* name, wiced_bool_t wildcards )
+{
+    do
+    {
+        uint32_t levels = 1 + test_random( ) % MAXIMUM_LEVELS;
+        uint32_t level;
+
+        name[ 0 ] = '\0';
+        for ( level = 0; level < levels; level++ )
+        {
+            uint32_t roll = test_random( ) % 10;
+
+            if ( level > 0 )
+            {
+                strcat( name, "/" );
+            }
+            if ( ( wildcards == WICED_TRUE ) && ( roll < 2 ) )
+            {
+                strcat( name, "+" );
+            }
+            else if ( ( wildcards == WICED_TRUE ) && ( roll == 2 ) )
+            {
+                strcat( name, "#" );
+                break;
+            }
+            else
+            {
+                strcat( name, level_names[ test_random( ) % ( sizeof( level_names ) / sizeof( level_names[ 0 ] ) ) ] );
+            }
+        }
+    } while ( name[ 0 ] == '\0' );
+}
+
+static void make_random_filters( void )
+{
+    filter_count = 0;
+    while ( filter_count < RANDOM_FILTERS )
+    {
+        uint32_t index;
+
+        random_name( filters[ filter_count ].name, WICED_TRUE );
+        for ( index = 0; ( index < filter_count ) && ( strcmp( filters[ index ].name, filters[ filter_count ].name ) != 0 ); index++ )
+        {
+        }
+        if ( index == filter_count )
+        {
+            filters[ filter_count ].subscribed = WICED_FALSE;
+            filter_count++;
+        }
+    }
+}
+
+static void check_random_topics( mqtt_topic_tree_t* tree, char (*topics)[ MAXIMUM_NAME ], const char* when )
+{
+    uint32_t index;
+
+    for ( index = 0; index < RANDOM_TOPICS; index++ )
+    {
+        check_topic( tree, topics[ index ], when );
+    }
+}
+
+static void test_random_filters( uint32_t rounds )
+{
+    static char       topics[ RANDOM_TOPICS ][ MAXIMUM_NAME ];
+    mqtt_topic_tree_t tree;
+    uint32_t          round;
+    uint32_t          index;
+
+    filters = calloc( RANDOM_FILTERS, sizeof( test_filter_t ) );
+    for ( round = 0; round < rounds; round++ )
+    {
+        make_random_filters( );
+        for ( index = 0; index < RANDOM_TOPICS; index++ )
+        {
+            random_name( topics[ index ], WICED_FALSE );
+        }
+
+        mqtt_topic_tree_init( &tree );
+        for ( index = 0; index < filter_count * 2; index++ )
+        {
+            uint32_t chosen = test_random( ) % filter_count;
+
+            if ( filters[ chosen ].subscribed == WICED_FALSE )
+            {
+                if ( subscribe( &tree, chosen ) != WICED_SUCCESS )
+                {
+                    if ( errors++ < 10 ) printf( "could not subscribe to \"%s\"\n", filters[ chosen ].name );
+                }
+                filters[ chosen ].subscribed = WICED_TRUE;
+            }
+            else
+            {
+                if ( unsubscribe( &tree, chosen ) != WICED_SUCCESS )
+                {
+                    if ( errors++ < 10 ) printf( "could not unsubscribe from \"%s\"\n", filters[ chosen ].name );
+                }
+                filters[ chosen ].subscribed = WICED_FALSE;
+            }
+            if ( index % 50 == 0 )
+            {
+                check_random_topics( &tree, topics, "random" );
+            }
+        }
+        check_random_topics( &tree, topics, "random" );
+
+        /* Allocations fail one by one while the rest is subscribed; a failed subscribe leaves the tree as it was */
+        for ( index = 0; index < filter_count; index++ )
+        {
+            uint32_t nodes;
+            uint32_t allocated;
+
+            if ( filters[ index ].subscribed == WICED_TRUE )
+            {
+                continue;
+            }
+            nodes           = tree.node_count;
+            allocated       = allocations;
+            fail_allocation = 1 + test_random( ) % MAXIMUM_LEVELS;
+            if ( subscribe( &tree, index ) == WICED_SUCCESS )
+            {
+                filters[ index ].subscribed = WICED_TRUE;
+            }
+            else if ( ( tree.node_count != nodes ) || ( allocations != allocated ) )
+            {
+                if ( errors++ < 10 ) printf( "failed subscribe to \"%s\" left %d nodes and %d allocations\n", filters[ index ].name,
+                                             (int) ( tree.node_count - nodes ), (int) ( allocations - allocated ) );
+            }
+            fail_allocation = 0;
+        }
+        check_random_topics( &tree, topics, "after failed allocations" );
+
+        /* Everything unsubscribed leaves just the empty table */
+        for ( index = 0; index < filter_count; index++ )
+        {
+            if ( filters[ index ].subscribed == WICED_TRUE )
+            {
+                unsubscribe( &tree, index );
+                filters[ index ].subscribed = WICED_FALSE;
+            }
+        }
+        if ( ( tree.node_count != 0 ) || ( allocations != 1 ) )
+        {
+            if ( errors++ < 10 ) printf( "round %u: %u nodes and %u allocations left with nothing subscribed\n", (unsigned) round, (unsigned) tree.node_count, (unsigned) allocations );
+        }
+
+        /* And deinit frees a full tree */
+        for ( index = 0; index < filter_count; index += 2 )
+        {
+            subscribe( &tree, index );
+        }
+        mqtt_topic_tree_deinit( &tree );
+        if ( allocations != 0 )
+        {
+            if ( errors++ < 10 ) printf( "round %u: %u allocations left after deinit\n", (unsigned) round, (unsigned) allocations );
+        }
+    }
+    free( filters );
+}
+
+/******************************************************
+ *               Dispatch benchmark
+ ******************************************************/
+
+/* One filter per sensor, and a few wildcard ones per building: "building/<b>/floor/<f>/room/<r>/temperature" */
+static uint32_t make_sensor_filters( uint32_t buildings )
+{
+    uint32_t building;
+
+    filter_count = 0;
+    for ( building = 0; building < buildings; building++ )
+    {
+        uint32_t floor_number;
+
+        for ( floor_number = 0; floor_number < 10; floor_number++ )
+        {
+            uint32_t room;
+
+            for ( room = 0; room < 10; room++ )
+            {
+                sprintf( filters[ filter_count++ ].name, "building/%u/floor/%u/room/%u/temperature", (unsigned) building, (unsigned) floor_number, (unsigned) room );
+            }
+            sprintf( filters[ filter_count++ ].name, "building/%u/floor/%u/+/+/alarm", (unsigned) building, (unsigned) floor_number );
+        }
+        sprintf( filters[ filter_count++ ].name, "building/%u/#", (unsigned) building );
+        sprintf( filters[ filter_count++ ].name, "building/%u/+/+/room/0/temperature", (unsigned) building );
+    }
+    return filter_count;
+}
+
+static void benchmark_dispatch( void )
+{
+    static const uint32_t building_counts[] = { 1, 10, 100 };
+    static char           topics[ BENCHMARK_TOPICS ][ MAXIMUM_NAME ];
+    char                  topic[ MAXIMUM_NAME ];
+    uint32_t              size;
+
+    printf( "subscriptions  tree dispatch  scan of every filter  callbacks per message\n" );
+    filters = calloc( 100 * 112, sizeof( test_filter_t ) );
+    for ( size = 0; size < sizeof( building_counts ) / sizeof( building_counts[ 0 ] ); size++ )
+    {
+        uint32_t          buildings = building_counts[ size ];
+        uint32_t          messages  = 200000;
+        uint32_t          delivered = 0;
+        uint32_t          scanned   = 0;
+        uint32_t          message;
+        uint32_t          index;
+        uint64_t          tree_ns;
+        uint64_t          scan_ns;
+        mqtt_topic_tree_t tree;
+
+        make_sensor_filters( buildings );
+        mqtt_topic_tree_init( &tree );
+        for ( index = 0; index < filter_count; index++ )
+        {
+            filters[ index ].subscribed = WICED_TRUE;
+            subscribe( &tree, index );
+        }
+
+        /* Lookups stay short only while the hash table grows with the tree */
+        if ( tree.node_count > 2 * tree.bucket_count )
+        {
+            if ( errors++ < 10 ) printf( "%u nodes in %u hash buckets\n", (unsigned) tree.node_count, (unsigned) tree.bucket_count );
+        }
+
+        /* Spot checks that the benchmark topics dispatch as they should */
+        for ( index = 0; index < 100; index++ )
+        {
+            sprintf( topic, "building/%u/floor/%u/room/%u/%s", (unsigned) ( test_random( ) % buildings ), (unsigned) ( test_random( ) % 10 ), (unsigned) ( test_random( ) % 12 ),
+                     ( index & 1 ) ? "temperature" : "alarm" );
+            check_topic( &tree, topic, "benchmark" );
+        }
+
+        for ( index = 0; index < BENCHMARK_TOPICS; index++ )
+        {
+            sprintf( topics[ index ], "building/%u/floor/%u/room/%u/temperature", (unsigned) ( test_random( ) % buildings ), (unsigned) ( test_random( ) % 10 ), (unsigned) ( test_random( ) % 10 ) );
+        }
+
+        tree_ns = now_ns( );
+        for ( message = 0; message < messages; message++ )
+        {
+            delivered += dispatch( &tree, topics[ message % BENCHMARK_TOPICS ] );
+        }
+        tree_ns = now_ns( ) - tree_ns;
+
+        /* What matching each filter in turn would cost, on fewer messages */
+        scan_ns = now_ns( );
+        for ( message = 0; message < messages / buildings; message++ )
+        {
+            for ( index = 0; index < filter_count; index++ )
+            {
+                scanned += ( reference_match( filters[ index ].name, topics[ message % BENCHMARK_TOPICS ] ) == WICED_TRUE ) ? 1 : 0;
+            }
+        }
+        scan_ns = now_ns( ) - scan_ns;
+
+        printf( "%13u  %10.0f ns  %17.0f ns  %21.2f\n", (unsigned) filter_count, (double) tree_ns / messages, (double) scan_ns / ( messages / buildings ),
+                (double) delivered / messages );
+        if ( ( delivered / messages ) != ( scanned / ( messages / buildings ) ) )
+        {
+            if ( errors++ < 10 ) printf( "tree delivered %u, scan matched %u\n", (unsigned) delivered, (unsigned) scanned );
+        }
+        mqtt_topic_tree_deinit( &tree );
+    }
+    free( filters );
+}
+
+int main( int argc, char* argv[] )
+{
+    uint32_t rounds = ( argc > 1 ) ? (uint32_t) strtoul( argv[ 1 ], NULL, 0 ) : 20;
+    int      failed;
+
+    if ( argc > 2 )
+    {
+        random_state = (uint32_t) strtoul( argv[ 2 ], NULL, 0 ) | 1;
+    }
+
+    test_filters( );
+    test_examples( );
+    test_random_filters( rounds );
+    printf( "%u filter cases, %u examples, %u rounds of %u random filters against %u topics\n", (unsigned) ( sizeof( filter_cases ) / sizeof( filter_cases[ 0 ] ) ),
+            (unsigned) ( sizeof( match_cases ) / sizeof( match_cases[ 0 ] ) ), (unsigned) rounds, (unsigned) RANDOM_FILTERS, (unsigned) RANDOM_TOPICS );
+
+    benchmark_dispatch( );
+    if ( wrong_arg != 0 )
+    {
+        printf( "%u callbacks with the wrong object or argument\n", (unsigned) wrong_arg );
+        errors++;
+    }
+    printf( "%u errors\n", (unsigned) errors );
+
+    failed = ( errors != 0 );
+    printf( failed ? "FAIL\n" : "PASS\n" );
+    return failed;
+}
@@ -0,0 +1,305 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  WizFi250 receive header formatter against the sprintf code it replaced
+ *
+ *  WXNetwork_NetRx() and its formatting helpers are cut out of
+ *  wx_platform_rtos_socket.c by the Makefile. A copy of the previous
+ *  sprintf/strcat version is kept below. Both are given the same packets
+ *  under every AT+SFORM (xrdf_main) combination, with random delimiters
+ *  including NUL, SCIDs, addresses, ports and lengths, from the socket
+ *  list and from a UDP sender, in command and data mode.
+ *
+ *  Fails if the bytes written to the UART differ anywhere. The number of
+ *  packets per second each one formats is reported.
+ *
+ *  Usage: rx_header_test [random_packets [seed]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "s2w_host.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define MAX_PAYLOAD         (64 * 1024)
+#define MAX_OUTPUT          (MAX_PAYLOAD + 512)
+#define TIMING_PACKETS      (1000000)
+#define TIMING_PAYLOAD      (16)
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+/* Defined next to the code under test on the target */
+UINT8         g_wxModeState;
+WT_PROFILE    g_wxProfile;
+WT_SCLIST     g_scList[ WX_MAX_SCID_RANGE ];
+uint32_t      g_time_lastdata;
+wiced_mutex_t g_upart_type1_wizmutex;
+
+static uint8_t  payload[ MAX_PAYLOAD ];
+static uint8_t  output[ MAX_OUTPUT ];
+static uint32_t output_length;
+static int      uart_counting_only;
+static int      mutex_held;
+static unsigned mutex_errors;
+static unsigned reported;
+
+/******************************************************
+ *               UART and RTOS models
+ ******************************************************/
+
+VOID WXHal_CharNPut( const VOID* buf, UINT32 len )
+{
+    if ( !mutex_held && ( g_wxModeState != WX_MODE_DATA ) )
+    {
+        mutex_errors++;
+    }
+    if ( !uart_counting_only && ( output_length + len <= sizeof( output ) ) )
+    {
+        memcpy( output + output_length, buf, len );
+    }
+    output_length += len;
+}
+
+wiced_time_t host_rtos_get_time( void )
+{
+    return 0;
+}
+
+wiced_result_t wiced_rtos_lock_mutex( wiced_mutex_t* mutex )
+{
+    (void) mutex;
+    mutex_held = 1;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_unlock_mutex( wiced_mutex_t* mutex )
+{
+    (void) mutex;
+    mutex_held = 0;
+    return WICED_SUCCESS;
+}
+
+/******************************************************
+ *               Previous implementation
+ ******************************************************/
+
+/* WXNetwork_NetRx() before the sprintf-free formatter, unchanged but for names and layout */
+static UINT8 previous_net_rx( UINT8 scid, VOID* buf, UINT32 len, wiced_ip_address_t* rmtIP, UINT16* rmtPort )
+{
+    UINT8* p = (UINT8*) buf;
+
+    char szUartBuff[ 256 ] = { 0, };
+    char xrdfbuff[ 30 ]    = { 0, };
+
+    g_scList[ scid ].tcp_time_lastdata = host_rtos_get_time( );
+    g_time_lastdata = g_scList[ scid ].tcp_time_lastdata;
+
+    if ( g_wxModeState == WX_MODE_DATA )
+    {
+        WXHal_CharNPut( p, len );
+        return WXCODE_SUCCESS;
+    }
+
+    if ( g_wxProfile.xrdf_main[ 0 ] == '1' ) { sprintf( szUartBuff, "%c", g_wxProfile.xrdf_data[ 0 ] ); }
+    if ( g_wxProfile.xrdf_main[ 1 ] == '1' ) { sprintf( xrdfbuff, "%x", scid ); strcat( szUartBuff, xrdfbuff ); }
+    if ( g_wxProfile.xrdf_main[ 2 ] == '1' ) { sprintf( xrdfbuff, "%c", g_wxProfile.xrdf_data[ 1 ] ); strcat( szUartBuff, xrdfbuff ); }
+    if ( g_wxProfile.xrdf_main[ 3 ] == '1' )
+    {
+        if ( rmtIP != NULL )
+            sprintf( xrdfbuff, "%s", (char*) WXNetwork_WicedV4IPToString( 0, *rmtIP ) );
+        else
+            sprintf( xrdfbuff, "%s", (char*) WXNetwork_WicedV4IPToString( 0, g_scList[ scid ].remoteIp ) );
+        strcat( szUartBuff, xrdfbuff );
+    }
+    if ( g_wxProfile.xrdf_main[ 2 ] == '1' ) { sprintf( xrdfbuff, "%c", g_wxProfile.xrdf_data[ 1 ] ); strcat( szUartBuff, xrdfbuff ); }
+    if ( g_wxProfile.xrdf_main[ 4 ] == '1' )
+    {
+        if ( rmtPort != NULL )
+            sprintf( xrdfbuff, "%d", *rmtPort );
+        else
+            sprintf( xrdfbuff, "%d", g_scList[ scid ].remotePort );
+        strcat( szUartBuff, xrdfbuff );
+    }
+    if ( g_wxProfile.xrdf_main[ 2 ] == '1' ) { sprintf( xrdfbuff, "%c", g_wxProfile.xrdf_data[ 1 ] ); strcat( szUartBuff, xrdfbuff ); }
+    if ( g_wxProfile.xrdf_main[ 5 ] == '1' ) { sprintf( xrdfbuff, "%d", (int) len ); strcat( szUartBuff, xrdfbuff ); }
+    if ( g_wxProfile.xrdf_main[ 6 ] == '1' ) { sprintf( xrdfbuff, "%c", g_wxProfile.xrdf_data[ 2 ] ); strcat( szUartBuff, xrdfbuff ); }
+
+    wiced_rtos_lock_mutex( &g_upart_type1_wizmutex );
+
+    WXHal_CharNPut( szUartBuff, strlen( szUartBuff ) );
+    WXHal_CharNPut( p, len );
+
+    if ( g_wxProfile.xrdf_main[ 7 ] == '1' ) { sprintf( szUartBuff, "%c", g_wxProfile.xrdf_data[ 3 ] ); }
+    if ( g_wxProfile.xrdf_main[ 8 ] == '1' ) { sprintf( xrdfbuff, "%c", g_wxProfile.xrdf_data[ 4 ] ); strcat( szUartBuff, xrdfbuff ); }
+    WXHal_CharNPut( szUartBuff, strlen( szUartBuff ) );
+
+    wiced_rtos_unlock_mutex( &g_upart_type1_wizmutex );
+    return WXCODE_SUCCESS;
+}
+
+/******************************************************
+ *               Test
+ ******************************************************/
+
+static uint32_t random_u32( void )
+{
+    return ( (uint32_t) rand( ) << 16 ) ^ (uint32_t) rand( );
+}
+
+/* Mostly the usual delimiters, sometimes NUL or any other byte */
+static UINT8 random_delimiter( void )
+{
+    static const char usual[] = "{},\r\n[]:;| ";
+
+    switch ( rand( ) % 4 )
+    {
+        case 0:  return 0;
+        case 1:  return (UINT8) ( 1 + rand( ) % 255 );
+        default: return (UINT8) usual[ rand( ) % ( sizeof( usual ) - 1 ) ];
+    }
+}
+
+/* Edge values half of the time */
+static uint32_t random_value( const uint32_t* edges, unsigned edge_count, uint32_t limit )
+{
+    return ( rand( ) % 2 == 0 ) ? edges[ rand( ) % edge_count ] : random_u32( ) % limit;
+}
+
+static int check_packet( unsigned form )
+{
+    static const uint32_t ip_edges[]     = { 0, 0xFFFFFFFF, 0x0A000001, 0xC0A80117, 0x01020304, 0x64646464, 0x09090909 };
+    static const uint32_t port_edges[]   = { 0, 1, 9, 10, 99, 100, 5000, 9999, 10000, 65535 };
+    static const uint32_t length_edges[] = { 0, 1, 9, 10, 99, 100, 999, 1000, 1460, 9999, 10000, MAX_PAYLOAD - 1 };
+    static uint8_t      expected[ MAX_OUTPUT ];
+    uint32_t            expected_length;
+    wiced_ip_address_t  sender_ip;
+    UINT16              sender_port;
+    int                 from_sender = rand( ) % 2;
+    UINT8               scid        = (UINT8) ( rand( ) % WX_MAX_SCID_RANGE );
+    UINT32              len         = random_value( length_edges, sizeof( length_edges ) / sizeof( length_edges[ 0 ] ), MAX_PAYLOAD );
+    unsigned            i;
+
+    for ( i = 0; i < 9; i++ )
+    {
+        g_wxProfile.xrdf_main[ i ] = ( form & ( 1u << i ) ) ? '1' : ( ( rand( ) % 2 ) ? '0' : (UINT8) rand( ) );
+    }
+    for ( i = 0; i < 5; i++ )
+    {
+        g_wxProfile.xrdf_data[ i ] = random_delimiter( );
+    }
+    g_wxModeState = ( rand( ) % 16 == 0 ) ? WX_MODE_DATA : WX_MODE_COMMAND;
+    SET_IPV4_ADDRESS( g_scList[ scid ].remoteIp, random_value( ip_edges, sizeof( ip_edges ) / sizeof( ip_edges[ 0 ] ), 0xFFFFFFFF ) );
+    g_scList[ scid ].remotePort = (UINT16) random_value( port_edges, sizeof( port_edges ) / sizeof( port_edges[ 0 ] ), 65536 );
+    SET_IPV4_ADDRESS( sender_ip, random_value( ip_edges, sizeof( ip_edges ) / sizeof( ip_edges[ 0 ] ), 0xFFFFFFFF ) );
+    sender_port = (UINT16) random_value( port_edges, sizeof( port_edges ) / sizeof( port_edges[ 0 ] ), 65536 );
+
+    output_length = 0;
+    previous_net_rx( scid, payload, len, from_sender ? &sender_ip : NULL, from_sender ? &sender_port : NULL );
+    expected_length = output_length;
+    memcpy( expected, output, output_length );
+
+    output_length = 0;
+    WXNetwork_NetRx( scid, payload, len, from_sender ? &sender_ip : NULL, from_sender ? &sender_port : NULL );
+
+    if ( ( output_length != expected_length ) || ( memcmp( output, expected, output_length ) != 0 ) )
+    {
+        if ( reported++ < 10 )
+        {
+            printf( "form %.9s, scid %u, %u bytes: \"%.*s\" expected, \"%.*s\" written\n",
+                    (const char*) g_wxProfile.xrdf_main, scid, (unsigned) len,
+                    (int) MIN( expected_length, 48 ), expected, (int) MIN( output_length, 48 ), output );
+        }
+        return 1;
+    }
+    return 0;
+}
+
+static double now_ns( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+/* Small UDP datagrams from one sender, in the default {SCID,IP,port,len} form */
+static void time_packets( void )
+{
+    wiced_ip_address_t sender_ip;
+    UINT16             sender_port = 50000;
+    double             start, previous_ns, current_ns;
+    unsigned           n;
+
+    memcpy( g_wxProfile.xrdf_main, "111111111", 9 );
+    memcpy( g_wxProfile.xrdf_data, "{,}\r\n", 5 );
+    g_wxModeState = WX_MODE_COMMAND;
+    SET_IPV4_ADDRESS( sender_ip, MAKE_IPV4_ADDRESS( 192, 168, 100, 123 ) );
+    uart_counting_only = 1;
+
+    start = now_ns( );
+    for ( n = 0; n < TIMING_PACKETS; n++ )
+    {
+        previous_net_rx( 3, payload, TIMING_PAYLOAD, &sender_ip, &sender_port );
+    }
+    previous_ns = ( now_ns( ) - start ) / TIMING_PACKETS;
+
+    start = now_ns( );
+    for ( n = 0; n < TIMING_PACKETS; n++ )
+    {
+        WXNetwork_NetRx( 3, payload, TIMING_PAYLOAD, &sender_ip, &sender_port );
+    }
+    current_ns = ( now_ns( ) - start ) / TIMING_PACKETS;
+
+    uart_counting_only = 0;
+    printf( "%u-byte datagrams on this host: sprintf %.0f ns, %.2f M/s; formatter %.0f ns, %.2f M/s\n",
+            TIMING_PAYLOAD, previous_ns, 1e3 / previous_ns, current_ns, 1e3 / current_ns );
+}
+
+int main( int argc, char** argv )
+{
+    unsigned random_packets = ( argc > 1 ) ? (unsigned) atoi( argv[ 1 ] ) : 200000;
+    int      seed           = ( argc > 2 ) ? atoi( argv[ 2 ] ) : 1;
+    unsigned mismatches     = 0;
+    unsigned checked        = 0;
+    unsigned form;
+    unsigned n;
+
+    srand( seed );
+    for ( n = 0; n < sizeof( payload ); n++ )
+    {
+        payload[ n ] = (uint8_t) rand( );
+    }
+
+    /* Every xrdf_main combination, then random ones */
+    for ( form = 0; form < 512; form++ )
+    {
+        for ( n = 0; n < 16; n++, checked++ )
+        {
+            mismatches += check_packet( form );
+        }
+    }
+    for ( n = 0; n < random_packets; n++, checked++ )
+    {
+        mismatches += check_packet( (unsigned) rand( ) % 512 );
+    }
+
+    printf( "%u packets formatted: %u differ from the sprintf version, %u UART writes outside g_upart_type1_wizmutex\n",
+            checked, mismatches, mutex_errors );
+    time_packets( );
+
+    printf( ( mismatches != 0 || mutex_errors != 0 ) ? "FAIL\n" : "PASS\n" );
+    return ( mismatches != 0 || mutex_errors != 0 );
+}
@@ -0,0 +1,473 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  WizFi250 serial input replayed in bursts
+ *
+ *  WXS2w_SerialInput(), the command line editor, the AT command lookup and
+ *  the command table run against a UART whose ring buffer already holds the
+ *  whole burst when the first read is made. The Makefile cuts them out of
+ *  wx_s2w_process.c.
+ *
+ *  In command mode, commands that take a payload from the UART (AT+SSEND,
+ *  AT+MQTTPUB and AT+MCERT) are sent with their payload right behind them,
+ *  followed by more commands. The three handlers are stood in for by ones
+ *  that read the payload the way the real ones do. In data mode, a burst of
+ *  data holding '+' runs is sent.
+ *
+ *  Fails if a payload reader does not get its payload, if a payload byte is
+ *  parsed as a command, if a command is not found, if data mode bytes come
+ *  out changed, or if data mode reads the UART a byte at a time.
+ *
+ *  Usage: s2w_input_test [data_bytes [seed]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "s2w_host.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define MAX_BURST           (64 * 1024)
+#define MAX_PAYLOAD         (1400)
+#define MAX_EVENTS          (64)
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct
+{
+    const char* command;
+    uint32_t    length;        /* Payload bytes read, or expected */
+    uint8_t     payload[ MAX_PAYLOAD ];
+} command_event_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+/* Defined in wx_s2w_process.c next to the code under test */
+UINT8                  g_wxModeState;
+WT_PROFILE             g_wxProfile;
+UINT8                  g_currentScid = WX_INVALID_SCID;
+UINT8                  g_auto_esc    = 0;
+wiced_timed_event_t    g_autoesc_timer;
+wiced_queue_t          g_queue_handle_maincommand;
+wiced_system_monitor_t wizfi_task_monitor_item;
+uint32_t               wizfi_task_monitor_stop;
+
+/* UART receive ring buffer, filled with the whole burst before the first read */
+static uint8_t  burst[ MAX_BURST ];
+static uint32_t burst_length;
+static uint32_t burst_position;
+static jmp_buf  burst_done;
+static uint32_t uart_reads;
+static uint32_t uart_waits;         /* Reads that would wait for the first byte */
+static uint32_t payload_timeouts;
+
+static command_event_t events[ MAX_EVENTS ];
+static int             event_count;
+static int             statuses[ 256 ];
+
+static uint8_t  data_out[ MAX_BURST ];
+static uint32_t data_out_length;
+
+/******************************************************
+ *               UART model
+ ******************************************************/
+
+wiced_result_t wiced_uart_receive_available_bytes( wiced_uart_t uart, void* data, uint32_t* size, uint32_t timeout )
+{
+    uint32_t available = burst_length - burst_position;
+
+    (void) uart;
+    if ( available == 0 )
+    {
+        *size = 0;
+        if ( timeout != 0 )
+        {
+            /* The main loop is waiting for the next burst: this one is done */
+            longjmp( burst_done, 1 );
+        }
+        return WICED_TIMEOUT;
+    }
+    if ( *size > available )
+    {
+        *size = available;
+    }
+    memcpy( data, burst + burst_position, *size );
+    burst_position += *size;
+    uart_reads++;
+    uart_waits += ( timeout != 0 );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_uart_receive_bytes( wiced_uart_t uart, void* data, uint32_t size, uint32_t timeout )
+{
+    uint32_t available = burst_length - burst_position;
+
+    (void) uart;
+    (void) timeout;
+    if ( size > available )
+    {
+        burst_position = burst_length;
+        payload_timeouts++;
+        return WICED_TIMEOUT;
+    }
+    memcpy( data, burst + burst_position, size );
+    burst_position += size;
+    uart_reads++;
+    return WICED_SUCCESS;
+}
+
+/* getchar() on the target, which reads the UART */
+VOID WXHal_CharNGet( UINT8* ch, UINT16 dataLen )
+{
+    if ( wiced_uart_receive_bytes( STDIO_UART, ch, dataLen, WICED_NEVER_TIMEOUT ) != WICED_SUCCESS )
+    {
+        memset( ch, 0, dataLen );
+    }
+}
+
+VOID WXHal_CharPut( UINT8 ch )
+{
+    (void) ch;
+}
+
+/******************************************************
+ *               Command handlers
+ ******************************************************/
+
+static command_event_t* new_event( const char* command )
+{
+    command_event_t* event = &events[ event_count < MAX_EVENTS - 1 ? event_count++ : event_count ];
+
+    event->command = command;
+    event->length  = 0;
+    return event;
+}
+
+UINT8 host_command( const char* name, UINT8* ptr )
+{
+    (void) ptr;
+    new_event( name );
+    return WXCODE_SUCCESS;
+}
+
+/* The payload length is the last parameter of each of these commands */
+static uint32_t payload_length( const UINT8* ptr )
+{
+    const char* comma = strrchr( (const char*) ptr, ',' );
+
+    return (uint32_t) atoi( ( comma != NULL ) ? comma + 1 : (const char*) ptr );
+}
+
+/* Reads in pieces of up to 1400 bytes with wiced_uart_receive_bytes(), as WXCmd_SSEND does */
+static UINT8 receive_payload( const char* name, UINT8* ptr )
+{
+    command_event_t* event  = new_event( name );
+    uint32_t         length = payload_length( ptr );
+
+    while ( length > 0 )
+    {
+        uint32_t piece = MIN( length, 1400 );
+
+        if ( ( event->length + piece > MAX_PAYLOAD ) ||
+             ( wiced_uart_receive_bytes( STDIO_UART, event->payload + event->length, piece, 3000 ) != WICED_SUCCESS ) )
+        {
+            return WXCODE_FAILURE;
+        }
+        event->length += piece;
+        length        -= piece;
+    }
+    return WXCODE_SUCCESS;
+}
+
+UINT8 WXCmd_SSEND( UINT8* ptr )
+{
+    return receive_payload( "WXCmd_SSEND", ptr );
+}
+
+UINT8 WXCmd_MQTTPUB( UINT8* ptr )
+{
+    return receive_payload( "WXCmd_MQTTPUB", ptr );
+}
+
+/* Reads the whole certificate with WXHal_CharNGet(), as WXCmd_MCERT does */
+UINT8 WXCmd_MCERT( UINT8* ptr )
+{
+    command_event_t* event  = new_event( "WXCmd_MCERT" );
+    uint32_t         length = payload_length( ptr );
+
+    if ( length >= MAX_PAYLOAD )
+    {
+        return WXCODE_EINVAL;
+    }
+    WXHal_CharNGet( event->payload, (UINT16) length );
+    event->length = length;
+    return WXCODE_SUCCESS;
+}
+
+/******************************************************
+ *               Rest of the application
+ ******************************************************/
+
+VOID WXS2w_StatusNotify( UINT8 status, UINT32 arg )
+{
+    (void) arg;
+    statuses[ status ]++;
+}
+
+VOID WXS2w_DataSpanProcess( UINT8* data, UINT32 len )
+{
+    memcpy( data_out + data_out_length, data, len );
+    data_out_length += len;
+}
+
+VOID WXS2w_LEDIndication( UINT8 led, UINT8 init, UINT8 repeat, UINT8 delay1, UINT8 delay2, UINT8 on )
+{
+    (void) led; (void) init; (void) repeat; (void) delay1; (void) delay2; (void) on;
+}
+
+VOID WXS2w_SystemReset( )
+{
+}
+
+wiced_result_t wiced_update_system_monitor( wiced_system_monitor_t* system_monitor, uint32_t value )
+{
+    (void) system_monitor;
+    (void) value;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_pop_from_queue( wiced_queue_t* queue, void* message, uint32_t timeout_ms )
+{
+    (void) queue;
+    (void) message;
+    (void) timeout_ms;
+    return WICED_TIMEOUT;
+}
+
+wiced_result_t wiced_rtos_stop_timer( wiced_timer_t* timer )
+{
+    (void) timer;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_reload_timer( wiced_timer_t* timer )
+{
+    (void) timer;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_start_timer( wiced_timer_t* timer )
+{
+    (void) timer;
+    return WICED_SUCCESS;
+}
+
+void ProcessActionButtonClicked( uint32_t BtnClickCount )
+{
+    (void) BtnClickCount;
+}
+
+void action_after_linkup_callback( )
+{
+}
+
+void wifi_link_down_callback( void )
+{
+}
+
+void check_psocketlist_and_process_basedon_scon1_option( )
+{
+}
+
+void check_tcp_idle_time( )
+{
+}
+
+void process_air_command_rx_data( )
+{
+}
+
+/******************************************************
+ *               Test
+ ******************************************************/
+
+static void add_text( const char* text )
+{
+    memcpy( burst + burst_length, text, strlen( text ) );
+    burst_length += strlen( text );
+}
+
+/* Random payload bytes, with CRs and command text mixed in */
+static void add_payload( uint8_t* copy, uint32_t length )
+{
+    uint32_t i;
+
+    for ( i = 0; i < length; i++ )
+    {
+        int kind = rand( ) % 8;
+
+        copy[ i ] = ( kind == 0 ) ? '\r' : ( kind == 1 ) ? (uint8_t) "AT+WSTAT"[ rand( ) % 8 ] : (uint8_t) rand( );
+    }
+    memcpy( burst + burst_length, copy, length );
+    burst_length += length;
+}
+
+static void replay_burst( void )
+{
+    burst_position = 0;
+    if ( setjmp( burst_done ) == 0 )
+    {
+        WXS2w_SerialInput( );
+    }
+}
+
+/* Returns the number of failures */
+static int run_command_burst( void )
+{
+    static const struct
+    {
+        const char* line;
+        const char* handler;
+        uint32_t    length;
+    } script[] =
+    {
+        { "AT\r",                             NULL,            0    },
+        { "AT+SSEND=0,,,%u\r",                "WXCmd_SSEND",   600  },
+        { "AT+MQTTPUB=sensor/temperature,%u\r", "WXCmd_MQTTPUB", 1000 },
+        { "AT+WSTAT\r",                       "WXCmd_WSTAT",   0    },
+        { "AT+MCERT=W,C,%u\r",                "WXCmd_MCERT",   900  },
+        { "AT+SSEND=0,,,%u\r",                "WXCmd_SSEND",   1    },
+        { "AT+MPROF=?\r",                     "WXCmd_MPROF",   0    },
+    };
+    static uint8_t expected[ sizeof( script ) / sizeof( script[ 0 ] ) ][ MAX_PAYLOAD ];
+    unsigned       commands = sizeof( script ) / sizeof( script[ 0 ] );
+    int            failures = 0;
+    int            event    = 0;
+    unsigned       i;
+
+    g_wxModeState  = WX_MODE_COMMAND;
+    burst_length   = 0;
+    event_count    = 0;
+    uart_reads     = 0;
+    memset( statuses, 0, sizeof( statuses ) );
+    for ( i = 0; i < commands; i++ )
+    {
+        char line[ 64 ];
+
+        snprintf( line, sizeof( line ), script[ i ].line, script[ i ].length );
+        add_text( line );
+        add_payload( expected[ i ], script[ i ].length );
+    }
+
+    replay_burst( );
+
+    for ( i = 0; i < commands; i++ )
+    {
+        if ( script[ i ].handler == NULL )
+        {
+            continue;
+        }
+        if ( ( event >= event_count ) || ( strcmp( events[ event ].command, script[ i ].handler ) != 0 ) )
+        {
+            printf( "command %u: %s not called\n", i, script[ i ].handler );
+            failures++;
+            continue;
+        }
+        if ( ( events[ event ].length != script[ i ].length ) || ( memcmp( events[ event ].payload, expected[ i ], script[ i ].length ) != 0 ) )
+        {
+            printf( "command %u: %s got a different payload\n", i, script[ i ].handler );
+            failures++;
+        }
+        event++;
+    }
+    printf( "command mode: %u commands in a %u byte burst, %d handlers called, %u OK, %u errors, %u payload timeouts\n",
+            commands, burst_length, event_count, statuses[ WXCODE_SUCCESS ], statuses[ WXCODE_EINVAL ] + statuses[ WXCODE_FAILURE ], payload_timeouts );
+    if ( event_count != event )
+    {
+        printf( "%d handlers called for payload bytes\n", event_count - event );
+        failures++;
+    }
+    if ( ( statuses[ WXCODE_SUCCESS ] != (int) commands ) || ( payload_timeouts != 0 ) )
+    {
+        failures++;
+    }
+    return failures;
+}
+
+/* Returns the number of failures */
+static int run_data_burst( uint32_t data_bytes )
+{
+    static uint8_t expected[ MAX_BURST ];
+    uint32_t       i;
+    int            failures = 0;
+
+    g_wxModeState   = WX_MODE_DATA;
+    g_currentScid   = 0;
+    burst_length    = 0;
+    data_out_length = 0;
+    uart_reads      = 0;
+    uart_waits      = 0;
+
+    /* Runs of one to four '+' among the data; the last byte ends any run */
+    for ( i = 0; i < data_bytes; i++ )
+    {
+        expected[ i ] = ( rand( ) % 16 == 0 ) ? '+' : (uint8_t) ( 'a' + rand( ) % 26 );
+        if ( ( i >= 4 ) && ( memcmp( expected + i - 4, "++++", 4 ) == 0 ) )
+        {
+            expected[ i ] = 'x';
+        }
+    }
+    expected[ data_bytes - 1 ] = 'z';
+    memcpy( burst, expected, data_bytes );
+    burst_length = data_bytes;
+
+    replay_burst( );
+
+    printf( "data mode: %u bytes in %u passes of the input loop (%u UART reads), %u bytes passed on\n", data_bytes, uart_waits, uart_reads, data_out_length );
+    if ( ( data_out_length != data_bytes ) || ( memcmp( data_out, expected, data_bytes ) != 0 ) )
+    {
+        printf( "data mode bytes changed\n" );
+        failures++;
+    }
+    if ( uart_waits > data_bytes / WX_SERIAL_RX_CHUNK_SIZE + 1 )
+    {
+        printf( "data mode read the UART in small pieces\n" );
+        failures++;
+    }
+    return failures;
+}
+
+int main( int argc, char** argv )
+{
+    uint32_t data_bytes = ( argc > 1 ) ? (uint32_t) atoi( argv[ 1 ] ) : 20000;
+    int      seed       = ( argc > 2 ) ? atoi( argv[ 2 ] ) : 1;
+    int      failures;
+
+    if ( data_bytes < 2 || data_bytes > MAX_BURST )
+    {
+        printf( "FAIL: data_bytes must be 2 to %u\n", MAX_BURST );
+        return 1;
+    }
+    srand( seed );
+    g_wxProfile.echo_mode = FALSE;
+    WXS2w_BuildCommandIndex( );
+
+    failures  = run_command_burst( );
+    failures += run_data_burst( data_bytes );
+
+    printf( ( failures != 0 ) ? "FAIL\n" : "PASS\n" );
+    return ( failures != 0 );
+}
@@ -0,0 +1,713 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  SDPCM receive glomming against a model of the SDIO bus
+ *
+ *  SDPCM.c is built with WICED_SDPCM_ENABLE_RX_GLOM. The bus model holds
+ *  superframes laid out as the WLAN sends them: a glom descriptor read as an
+ *  ordinary frame, then the superframe header and its padded subframes,
+ *  which wiced_receive_superframe() reads with wiced_read_superframe().
+ *  Subframes carry data frames, IOCTL replies nobody waits for and credit
+ *  updates. Superframes are mixed with frames sent on their own, as from a
+ *  WLAN which does not glom, and some are corrupted: a bad subframe
+ *  frametag, a descriptor length shorter than its subframe, a bad
+ *  superframe header, too many subframes, an oversized subframe. Some RX
+ *  buffer requests fail.
+ *
+ *  Fails if a data frame reaches the network stack changed, out of order or
+ *  twice, if one is lost other than to a corruption or a failed buffer
+ *  request, if a frame behind a corruption is passed on, if the rest of a
+ *  superframe is left on the bus or read past its end, if an IOCTL reply is
+ *  not routed, or if a buffer leaks. Frames per bus transaction and CPU time
+ *  per frame, glommed and not, are reported.
+ *
+ *  Usage: sdpcm_glom_test [superframes [seed]]
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "internal/SDPCM.h"
+#include "wwd_rtos.h"
+#include "wwd_buffer.h"
+#include "internal/wwd_internal.h"
+#include "internal/wwd_thread.h"
+#include "RTOS/wwd_rtos_interface.h"
+#include "Network/wwd_buffer_interface.h"
+#include "Network/wwd_network_interface.h"
+#include "internal/Bus_protocols/wwd_bus_protocol_interface.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+/* As in SDPCM.c */
+#define SDPCM_HEADER_LENGTH     (12)
+#define BDC_HEADER_LENGTH       (4)
+#define CDC_HEADER_LENGTH       (16)
+#define CHANNEL_CONTROL         (0)
+#define CHANNEL_DATA            (2)
+#define CHANNEL_GLOM            (3)
+#define GLOM_DESCRIPTOR_FLAG    (0x80)
+#define MAX_GLOM_SUBFRAMES      (16)
+#define MAX_SUBFRAME_SIZE       (2048)
+#define GLOM_READ_SIZE          (2048)
+
+#define MAX_FRAME               (MAX_SUBFRAME_SIZE + 64)
+#define MAX_SUBFRAMES           (MAX_GLOM_SUBFRAMES + 4)
+#define MAX_SUPERFRAME          (SDPCM_HEADER_LENGTH + MAX_SUBFRAMES * MAX_FRAME)
+#define MAX_ETHERNET_PAYLOAD    (1514)
+#define TIMING_SUPERFRAMES      (5000)
+#define TIMING_SUBFRAMES        (8)
+#define FRAME_READ_TRANSACTIONS (2)     /* wiced_read_frame() reads the frametag, then the rest of the frame */
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+struct NX_PACKET_STRUCT
+{
+    uint8_t* data;
+    uint16_t size;
+    uint16_t capacity;
+    uint8_t  storage[ 1 ];
+};
+
+typedef enum
+{
+    CORRUPT_NONE,
+    CORRUPT_FRAMETAG,       /* One subframe frametag does not check */
+    CORRUPT_SHORT_LENGTH,   /* One descriptor length is shorter than its subframe */
+    CORRUPT_HEADER,         /* The superframe header is not a glom header */
+    CORRUPT_TOO_MANY,       /* More subframes than the host accepts */
+    CORRUPT_OVERSIZED,      /* A subframe larger than the host accepts */
+    CORRUPT_KINDS
+} corruption_t;
+
+typedef struct
+{
+    uint8_t  channel;
+    uint16_t size;
+    uint16_t payload_offset;        /* Where the Ethernet frame starts, for data frames */
+    uint16_t payload_length;
+    int      buffer_requested;
+    int      buffer_refused;
+    int      delivered;
+    uint8_t  frame[ MAX_FRAME ];
+} subframe_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+/* Defined next to SDPCM.c on the target */
+wiced_bool_t        monitor_mode_enabled = WICED_FALSE;
+wiced_wlan_status_t wiced_wlan_status;
+
+/* Bus model: the superframe the WLAN is sending */
+static uint8_t  superframe[ MAX_SUPERFRAME ];
+static uint32_t superframe_length;
+static uint32_t superframe_position;
+static unsigned bus_reads;
+static unsigned bus_aborts;
+static unsigned bus_overreads;
+
+static subframe_t subframes[ MAX_SUBFRAMES ];
+static unsigned   subframe_count;
+static unsigned   subframe_cursor;      /* Subframe whose buffer was last requested */
+static int        in_superframe;
+static unsigned   refuse_one_in;        /* Buffer requests refused during superframes, 0 for none */
+
+static long     buffers_outstanding;
+static unsigned errors;
+
+static const uint8_t* single_payload;   /* Data frame sent on its own */
+static uint16_t       single_payload_length;
+static int            single_delivered;
+
+static unsigned data_frames_sent;
+static unsigned data_frames_delivered;
+static unsigned data_frames_dropped;    /* Lost to a corruption or a refused buffer */
+static unsigned control_frames_routed;
+static uint8_t  bus_credit;
+static uint8_t  sequence;
+static int      timing;                 /* Frames are not checked while timing */
+
+/******************************************************
+ *               Buffer, RTOS and bus models
+ ******************************************************/
+
+wiced_result_t host_buffer_get( wiced_buffer_t* buffer, wiced_buffer_dir_t direction, unsigned short size, wiced_bool_t wait )
+{
+    (void) direction;
+    (void) wait;
+    if ( in_superframe )
+    {
+        subframe_t* subframe = &subframes[ subframe_cursor++ ];
+
+        subframe->buffer_requested = 1;
+        if ( ( refuse_one_in != 0 ) && ( rand( ) % refuse_one_in == 0 ) )
+        {
+            subframe->buffer_refused = 1;
+            return WICED_ERROR;
+        }
+    }
+    *buffer = malloc( sizeof( struct NX_PACKET_STRUCT ) + size );
+    ( *buffer )->data     = ( *buffer )->storage;
+    ( *buffer )->size     = size;
+    ( *buffer )->capacity = size;
+    buffers_outstanding++;
+    return WICED_SUCCESS;
+}
+
+void host_buffer_release( wiced_buffer_t buffer, wiced_buffer_dir_t direction )
+{
+    (void) direction;
+    free( buffer );
+    buffers_outstanding--;
+}
+
+uint8_t* host_buffer_get_current_piece_data_pointer( wiced_buffer_t buffer )
+{
+    return buffer->data;
+}
+
+uint16_t host_buffer_get_current_piece_size( wiced_buffer_t buffer )
+{
+    return buffer->size;
+}
+
+wiced_result_t host_buffer_add_remove_at_front( wiced_buffer_t* buffer, int32_t add_remove_amount )
+{
+    wiced_buffer_t b = *buffer;
+
+    if ( ( b->data + add_remove_amount < b->storage ) || ( add_remove_amount > (int32_t) b->size ) )
+    {
+        return WICED_ERROR;
+    }
+    b->data += add_remove_amount;
+    b->size  = (uint16_t) ( b->size - add_remove_amount );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_buffer_set_data_end( wiced_buffer_t buffer, uint8_t* end_of_data )
+{
+    buffer->size = (uint16_t) ( end_of_data - buffer->data );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_rtos_init_semaphore( host_semaphore_type_t* semaphore )
+{
+    (void) semaphore;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_rtos_deinit_semaphore( host_semaphore_type_t* semaphore )
+{
+    (void) semaphore;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_rtos_get_semaphore( host_semaphore_type_t* semaphore, uint32_t timeout_ms, wiced_bool_t will_set_in_isr )
+{
+    (void) semaphore;
+    (void) timeout_ms;
+    (void) will_set_in_isr;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t host_rtos_set_semaphore( host_semaphore_type_t* semaphore, wiced_bool_t called_from_ISR )
+{
+    (void) semaphore;
+    (void) called_from_ISR;
+    return WICED_SUCCESS;
+}
+
+void wiced_thread_notify( void )
+{
+}
+
+wiced_result_t wiced_bus_set_flow_control( uint8_t value )
+{
+    (void) value;
+    return WICED_SUCCESS;
+}
+
+wiced_bool_t wiced_bus_is_flow_controlled( void )
+{
+    return WICED_FALSE;
+}
+
+wiced_bool_t wiced_wifi_is_packet_from_ap( uint8_t flags2 )
+{
+    (void) flags2;
+    return WICED_FALSE;
+}
+
+/* One CMD53 of the superframe, or with no data the abort which drops the rest of it */
+wiced_result_t wiced_read_superframe( uint8_t* data, uint16_t size )
+{
+    if ( data == NULL )
+    {
+        superframe_position = superframe_length;
+        bus_aborts++;
+        return WICED_ERROR;
+    }
+    bus_reads++;
+    if ( superframe_position + size > superframe_length )
+    {
+        bus_overreads++;
+        return WICED_ERROR;
+    }
+    memcpy( data, superframe + superframe_position, size );
+    superframe_position += size;
+    return WICED_SUCCESS;
+}
+
+/* The network stack end of the data path */
+void host_network_process_ethernet_data( wiced_buffer_t buffer, wiced_interface_t interface )
+{
+    const uint8_t* expected;
+    uint16_t       expected_length;
+    int*           delivered;
+
+    (void) interface;
+    if ( in_superframe )
+    {
+        subframe_t* subframe = &subframes[ subframe_cursor - 1 ];
+
+        expected        = subframe->frame + subframe->payload_offset;
+        expected_length = ( subframe->channel == CHANNEL_DATA ) ? subframe->payload_length : 0;
+        delivered       = &subframe->delivered;
+    }
+    else
+    {
+        expected        = single_payload;
+        expected_length = single_payload_length;
+        delivered       = &single_delivered;
+    }
+
+    if ( !timing && ( ( *delivered != 0 ) || ( expected_length == 0 ) || ( buffer->size != expected_length ) ||
+                      ( memcmp( buffer->data, expected, expected_length ) != 0 ) ) )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "data frame of %u bytes reached the network stack, %u expected\n", buffer->size, expected_length );
+        }
+    }
+    *delivered = 1;
+    data_frames_delivered++;
+    host_buffer_release( buffer, WICED_NETWORK_RX );
+}
+
+/******************************************************
+ *               WLAN model
+ ******************************************************/
+
+static uint16_t put_sdpcm_header( uint8_t* frame, uint16_t size, uint8_t channel, uint8_t header_length )
+{
+    uint16_t inverse = (uint16_t) ~size;
+
+    memcpy( frame, &size, 2 );
+    memcpy( frame + 2, &inverse, 2 );
+    frame[ 4 ]  = sequence++;
+    frame[ 5 ]  = channel;
+    frame[ 6 ]  = 0;
+    frame[ 7 ]  = header_length;
+    frame[ 8 ]  = 0;
+    frame[ 9 ]  = ++bus_credit;
+    frame[ 10 ] = 0;
+    frame[ 11 ] = 0;
+    memset( frame + SDPCM_HEADER_LENGTH, 0x5A, (size_t) ( header_length - SDPCM_HEADER_LENGTH ) );
+    return size;
+}
+
+/* A data frame, or one time in ten an IOCTL reply nobody waits for or a bare credit update */
+static void make_frame( subframe_t* subframe, uint16_t payload_length, int data_only )
+{
+    uint8_t  header_length = ( rand( ) % 4 == 0 ) ? 16 : SDPCM_HEADER_LENGTH;
+    uint8_t* frame         = subframe->frame;
+    int      kind          = data_only ? 0 : rand( ) % 20;
+    uint16_t i;
+
+    memset( subframe, 0, offsetof( subframe_t, frame ) );
+    if ( kind == 0 || kind > 2 )
+    {
+        uint8_t data_offset = (uint8_t) ( rand( ) % 3 );
+
+        subframe->channel        = CHANNEL_DATA;
+        subframe->payload_offset = (uint16_t) ( header_length + BDC_HEADER_LENGTH + 4 * data_offset );
+        subframe->payload_length = payload_length;
+        subframe->size           = put_sdpcm_header( frame, (uint16_t) ( subframe->payload_offset + payload_length ), CHANNEL_DATA, header_length );
+        frame[ header_length ]     = 0x20;
+        frame[ header_length + 1 ] = (uint8_t) ( rand( ) % 8 );
+        frame[ header_length + 2 ] = 0;
+        frame[ header_length + 3 ] = data_offset;
+        for ( i = 0; i < payload_length; i++ )
+        {
+            frame[ subframe->payload_offset + i ] = (uint8_t) rand( );
+        }
+        data_frames_sent++;
+    }
+    else if ( kind == 1 )
+    {
+        uint16_t id = (uint16_t) ( 0x8000 | rand( ) );
+
+        subframe->channel = CHANNEL_CONTROL;
+        subframe->size    = put_sdpcm_header( frame, (uint16_t) ( header_length + CDC_HEADER_LENGTH + 4 ), CHANNEL_CONTROL, header_length );
+        memset( frame + header_length, 0, CDC_HEADER_LENGTH + 4 );
+        frame[ header_length + 10 ] = (uint8_t) id;
+        frame[ header_length + 11 ] = (uint8_t) ( id >> 8 );
+    }
+    else
+    {
+        subframe->channel = CHANNEL_DATA;
+        subframe->size    = put_sdpcm_header( frame, SDPCM_HEADER_LENGTH, CHANNEL_DATA, SDPCM_HEADER_LENGTH );
+    }
+}
+
+static uint16_t random_payload_length( void )
+{
+    static const uint16_t edges[] = { 14, 15, 60, 64, 590, 1024, 1500, MAX_ETHERNET_PAYLOAD };
+
+    return ( rand( ) % 2 == 0 ) ? edges[ rand( ) % ( sizeof( edges ) / sizeof( edges[ 0 ] ) ) ] : (uint16_t) ( 14 + rand( ) % ( MAX_ETHERNET_PAYLOAD - 13 ) );
+}
+
+/* The descriptor, as read by wiced_read_frame() into its own buffer */
+static wiced_buffer_t make_descriptor( const uint16_t* lengths, unsigned count )
+{
+    wiced_buffer_t buffer;
+    uint8_t*       frame;
+    uint16_t       size = (uint16_t) ( SDPCM_HEADER_LENGTH + 2 * count );
+    unsigned       i;
+
+    in_superframe = 0;
+    host_buffer_get( &buffer, WICED_NETWORK_RX, (unsigned short) ( sizeof( wiced_buffer_header_t ) + size ), WICED_FALSE );
+    frame = buffer->data + sizeof( wiced_buffer_header_t );
+    put_sdpcm_header( frame, size, CHANNEL_GLOM | GLOM_DESCRIPTOR_FLAG, SDPCM_HEADER_LENGTH );
+    for ( i = 0; i < count; i++ )
+    {
+        frame[ SDPCM_HEADER_LENGTH + 2 * i ]     = (uint8_t) lengths[ i ];
+        frame[ SDPCM_HEADER_LENGTH + 2 * i + 1 ] = (uint8_t) ( lengths[ i ] >> 8 );
+    }
+    return buffer;
+}
+
+/* Lays out the subframes, padded, behind a superframe header and sends it with its descriptor.
+ * Returns the number of subframes the host should process before it gives up on the rest. */
+static unsigned send_superframe( corruption_t corruption )
+{
+    uint16_t lengths[ MAX_SUBFRAMES ];
+    unsigned alignment = ( rand( ) % 2 == 0 ) ? 4 : 8;
+    unsigned usable    = subframe_count;
+    unsigned victim    = (unsigned) rand( ) % subframe_count;
+    unsigned i;
+
+    superframe_length = SDPCM_HEADER_LENGTH;
+    for ( i = 0; i < subframe_count; i++ )
+    {
+        subframe_t* subframe = &subframes[ i ];
+        uint16_t    padded   = (uint16_t) ( ( subframe->size + alignment - 1 ) & ~( alignment - 1 ) );
+
+        memcpy( superframe + superframe_length, subframe->frame, subframe->size );
+        memset( superframe + superframe_length + subframe->size, 0xEE, (size_t) ( padded - subframe->size ) );
+        lengths[ i ]       = (uint16_t) ( padded + ( ( i == 0 ) ? SDPCM_HEADER_LENGTH : 0 ) );
+        superframe_length += padded;
+    }
+    put_sdpcm_header( superframe, (uint16_t) superframe_length, CHANNEL_GLOM, SDPCM_HEADER_LENGTH );
+
+    switch ( corruption )
+    {
+        case CORRUPT_FRAMETAG:
+            {
+                uint32_t offset = SDPCM_HEADER_LENGTH;
+
+                for ( i = 0; i < victim; i++ )
+                {
+                    offset += lengths[ i ] - ( ( i == 0 ) ? SDPCM_HEADER_LENGTH : 0 );
+                }
+                superframe[ offset + 2 ] ^= 0x01;
+            }
+            usable = victim;
+            break;
+
+        case CORRUPT_SHORT_LENGTH:
+            lengths[ victim ] = (uint16_t) ( ( ( victim == 0 ) ? SDPCM_HEADER_LENGTH : 0 ) + subframes[ victim ].size - 1 );
+            usable = victim;
+            break;
+
+        case CORRUPT_HEADER:
+            superframe[ 5 ] = CHANNEL_DATA;
+            usable = 0;
+            break;
+
+        case CORRUPT_TOO_MANY:
+        case CORRUPT_OVERSIZED:
+            usable = 0;
+            break;
+
+        case CORRUPT_NONE:
+        case CORRUPT_KINDS:
+        default:
+            break;
+    }
+
+    superframe_position = 0;
+    wiced_process_sdpcm( make_descriptor( lengths, subframe_count ) );
+    return usable;
+}
+
+/******************************************************
+ *               Test
+ ******************************************************/
+
+static void check_superframe( corruption_t corruption, unsigned usable )
+{
+    uint32_t aborted, late_replies;
+    unsigned controls = 0;
+    unsigned i;
+
+    wiced_get_ioctl_statistics( &aborted, &late_replies );
+    in_superframe   = 1;
+    subframe_cursor = 0;
+    if ( wiced_receive_superframe( ) != 1 )
+    {
+        errors++;
+        printf( "superframe announced by a glom descriptor was not read\n" );
+    }
+    in_superframe = 0;
+
+    if ( superframe_position != superframe_length )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "%u of %u superframe bytes left on the bus, corruption %d\n",
+                    (unsigned) ( superframe_length - superframe_position ), (unsigned) superframe_length, (int) corruption );
+        }
+        superframe_position = superframe_length;
+    }
+    if ( wiced_receive_superframe( ) != 0 )
+    {
+        errors++;
+        printf( "superframe read twice\n" );
+    }
+
+    for ( i = 0; i < subframe_count; i++ )
+    {
+        subframe_t* subframe = &subframes[ i ];
+        int         is_data  = ( subframe->channel == CHANNEL_DATA ) && ( subframe->payload_length != 0 );
+        int         expected = ( i < usable ) && !subframe->buffer_refused && is_data;
+
+        if ( ( i >= usable ) && subframe->buffer_requested )
+        {
+            if ( errors++ < 10 )
+            {
+                printf( "subframe %u of %u passed on behind corruption %d at %u\n", i, subframe_count, (int) corruption, usable );
+            }
+        }
+        if ( is_data && ( subframe->delivered != expected ) )
+        {
+            if ( errors++ < 10 )
+            {
+                printf( "data subframe %u of %u %s, corruption %d\n", i, subframe_count,
+                        subframe->delivered ? "delivered" : "lost", (int) corruption );
+            }
+        }
+        if ( is_data && !expected )
+        {
+            data_frames_dropped++;
+        }
+        if ( ( i < usable ) && !subframe->buffer_refused && ( subframe->channel == CHANNEL_CONTROL ) )
+        {
+            controls++;
+        }
+    }
+
+    {
+        uint32_t late_after;
+
+        wiced_get_ioctl_statistics( &aborted, &late_after );
+        if ( late_after - late_replies != controls )
+        {
+            errors++;
+            printf( "%u IOCTL replies in the superframe, %u routed\n", controls, (unsigned) ( late_after - late_replies ) );
+        }
+        control_frames_routed += controls;
+    }
+}
+
+static void run_superframe( void )
+{
+    corruption_t corruption = ( rand( ) % 4 == 0 ) ? (corruption_t) ( 1 + rand( ) % ( CORRUPT_KINDS - 1 ) ) : CORRUPT_NONE;
+    unsigned     oversized;
+    unsigned     i;
+
+    subframe_count = 1 + (unsigned) rand( ) % MAX_GLOM_SUBFRAMES;
+    if ( corruption == CORRUPT_TOO_MANY )
+    {
+        subframe_count = MAX_GLOM_SUBFRAMES + 1 + (unsigned) rand( ) % ( MAX_SUBFRAMES - MAX_GLOM_SUBFRAMES );
+    }
+    oversized = ( corruption == CORRUPT_OVERSIZED ) ? (unsigned) rand( ) % subframe_count : subframe_count;
+    for ( i = 0; i < subframe_count; i++ )
+    {
+        if ( i == oversized )
+        {
+            make_frame( &subframes[ i ], MAX_SUBFRAME_SIZE, 1 );
+        }
+        else
+        {
+            make_frame( &subframes[ i ], random_payload_length( ), 0 );
+        }
+    }
+    check_superframe( corruption, send_superframe( corruption ) );
+}
+
+/* A frame sent on its own, as by a WLAN which does not glom */
+static void run_single_frame( void )
+{
+    subframe_t*    subframe = &subframes[ 0 ];
+    wiced_buffer_t buffer;
+
+    make_frame( subframe, random_payload_length( ), 0 );
+    in_superframe = 0;
+    host_buffer_get( &buffer, WICED_NETWORK_RX, (unsigned short) ( sizeof( wiced_buffer_header_t ) + subframe->size ), WICED_FALSE );
+    memcpy( buffer->data + sizeof( wiced_buffer_header_t ), subframe->frame, subframe->size );
+
+    single_payload        = subframe->frame + subframe->payload_offset;
+    single_payload_length = ( subframe->channel == CHANNEL_DATA ) ? subframe->payload_length : 0;
+    single_delivered      = 0;
+    if ( wiced_receive_superframe( ) != 0 )
+    {
+        errors++;
+        printf( "superframe read with no glom descriptor\n" );
+    }
+    wiced_process_sdpcm( buffer );
+    if ( single_payload_length != 0 && !single_delivered )
+    {
+        if ( errors++ < 10 )
+        {
+            printf( "data frame of %u bytes sent on its own was lost\n", single_payload_length );
+        }
+    }
+    if ( subframe->channel == CHANNEL_CONTROL )
+    {
+        control_frames_routed++;
+    }
+}
+
+static double now_ns( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+/* Bulk download: full-size data frames, glommed eight to a superframe and sent one by one */
+static void time_frames( void )
+{
+    static uint8_t frames[ TIMING_SUBFRAMES ][ MAX_FRAME ];
+    static uint16_t sizes[ TIMING_SUBFRAMES ];
+    double   start, glom_ns = 0, single_ns = 0;
+    unsigned reads_before = bus_reads;
+    unsigned n, i;
+
+    timing        = 1;
+    refuse_one_in = 0;
+    for ( n = 0; n < TIMING_SUPERFRAMES; n++ )
+    {
+        subframe_count = TIMING_SUBFRAMES;
+        for ( i = 0; i < subframe_count; i++ )
+        {
+            make_frame( &subframes[ i ], 1500, 1 );
+            memcpy( frames[ i ], subframes[ i ].frame, subframes[ i ].size );
+            sizes[ i ] = subframes[ i ].size;
+        }
+
+        start = now_ns( );
+        send_superframe( CORRUPT_NONE );
+        in_superframe   = 1;
+        subframe_cursor = 0;
+        wiced_receive_superframe( );
+        in_superframe = 0;
+        glom_ns += now_ns( ) - start;
+
+        /* The same frames, each read into its own buffer as wiced_read_frame() does */
+        start = now_ns( );
+        for ( i = 0; i < subframe_count; i++ )
+        {
+            wiced_buffer_t buffer;
+
+            host_buffer_get( &buffer, WICED_NETWORK_RX, (unsigned short) ( sizeof( wiced_buffer_header_t ) + sizes[ i ] ), WICED_FALSE );
+            memcpy( buffer->data + sizeof( wiced_buffer_header_t ), frames[ i ], sizes[ i ] );
+            wiced_process_sdpcm( buffer );
+        }
+        single_ns += now_ns( ) - start;
+    }
+    timing = 0;
+
+    printf( "bulk download of 1500-byte frames, %u to a superframe: %.2f frames per CMD53 glommed, %.2f not\n",
+            TIMING_SUBFRAMES, (double) ( TIMING_SUPERFRAMES * TIMING_SUBFRAMES ) / ( TIMING_SUPERFRAMES * FRAME_READ_TRANSACTIONS + bus_reads - reads_before ),
+            1.0 / FRAME_READ_TRANSACTIONS );
+    printf( "CPU per frame on this host, bus copies included: %.0f ns glommed, %.0f ns not\n",
+            glom_ns / ( TIMING_SUPERFRAMES * TIMING_SUBFRAMES ), single_ns / ( TIMING_SUPERFRAMES * TIMING_SUBFRAMES ) );
+}
+
+int main( int argc, char** argv )
+{
+    unsigned count = ( argc > 1 ) ? (unsigned) atoi( argv[ 1 ] ) : 20000;
+    int      seed  = ( argc > 2 ) ? atoi( argv[ 2 ] ) : 1;
+    unsigned superframes = 0;
+    unsigned n;
+
+    srand( seed );
+    if ( wiced_init_sdpcm( ) != WICED_SUCCESS )
+    {
+        printf( "wiced_init_sdpcm failed\nFAIL\n" );
+        return 1;
+    }
+
+    for ( n = 0; n < count; n++ )
+    {
+        refuse_one_in = ( n % 8 == 0 ) ? 10 : 0;
+        if ( rand( ) % 5 == 0 )
+        {
+            run_single_frame( );
+        }
+        else
+        {
+            run_superframe( );
+            superframes++;
+        }
+    }
+
+    printf( "%u superframes and %u single frames: %u data frames sent, %u delivered, %u dropped with a bad superframe or no buffer, "
+            "%u IOCTL replies routed\n", superframes, count - superframes, data_frames_sent, data_frames_delivered,
+            data_frames_dropped, control_frames_routed );
+    printf( "%u superframe reads, %u aborts, %u past the end of a superframe\n", bus_reads, bus_aborts, bus_overreads );
+    errors += bus_overreads;
+    if ( data_frames_delivered + data_frames_dropped != data_frames_sent )
+    {
+        errors++;
+        printf( "data frames do not add up\n" );
+    }
+
+    time_frames( );
+
+    wiced_quit_sdpcm( );
+    if ( buffers_outstanding != 0 )
+    {
+        errors++;
+        printf( "%ld buffers leaked\n", buffers_outstanding );
+    }
+
+    printf( errors != 0 ? "FAIL\n" : "PASS\n" );
+    return ( errors != 0 );
+}
@@ -0,0 +1,436 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  Background serial flash erases
+ *
+ *  spi_flash_async.c runs against serial flash held in RAM, on a simulated
+ *  clock. A sector erase keeps the chip busy for 60 ms. The worker thread's
+ *  timed event fires at its time between the calls of the test, and while a
+ *  caller sleeps in wiced_rtos_delay_milliseconds() holding no mutex.
+ *
+ *  First the queue is checked directly: erases run in order, one at a time,
+ *  a queued erase can be cancelled and a started one cannot, a read waits
+ *  out the erase in progress and goes before the next one, and deinit waits
+ *  for the erase in progress and its callback.
+ *
+ *  Then mqtt_store.c publishes every 20 ms and drains every 15 ms for the
+ *  given time, and the time each publish and drain takes is measured. Both
+ *  are made from one thread, so whichever comes first after an erase starts
+ *  waits for the chip.
+ *
+ *  Fails if any of the queue checks fails, if the chip is read, written or
+ *  erased while it is busy, or if a message is lost or delivered twice.
+ *
+ *  Usage: sflash_async_test [seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mqtt_internal.h"
+#include "mqtt_store.h"
+#include "spi_flash_async.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+#define CHECK( condition ) \
+    do { if ( !( condition ) ) { printf( "check failed, line %d: %s\n", __LINE__, #condition ); failures++; } } while ( 0 )
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define AREA_ADDRESS        (0x40000)
+#define AREA_SECTORS        (8)
+#define AREA_SIZE           (AREA_SECTORS * MQTT_STORE_SECTOR_SIZE)
+
+#define ERASE_TIME_US       (60000)
+#define CHIP_ERASE_TIME_US  (8000000)
+#define BYTE_TIME_US        (1)
+#define PROGRAM_BYTE_US     (5)
+
+#define PUBLISH_PERIOD_US   (20000)
+#define DRAIN_PERIOD_US     (15000)
+#define PAYLOAD_SIZE        (100)
+#define MAX_MESSAGES        (100000)
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static uint8_t  flash[ AREA_ADDRESS + AREA_SIZE ];
+static uint64_t now_us;
+static uint64_t busy_until_us;
+static unsigned busy_violations;
+static unsigned erases_started;
+static unsigned long started_address[ 16 ];
+static int      failures;
+static int      mutexes_held;
+
+/* The one timed event, that of the erase scheduler */
+static event_handler_t poll_function;
+static void*           poll_arg;
+static uint32_t        poll_period_ms;
+static int             poll_running;
+static uint64_t        poll_due_us;
+
+/******************************************************
+ *               Serial flash in RAM
+ ******************************************************/
+
+static void check_idle( void )
+{
+    if ( now_us < busy_until_us )
+    {
+        busy_violations++;
+    }
+}
+
+int init_sflash( sflash_handle_t* const handle, int peripheral_id, sflash_write_allowed_t write_allowed )
+{
+    (void) handle; (void) peripheral_id; (void) write_allowed;
+    return 0;
+}
+
+int sflash_read( const sflash_handle_t* const handle, unsigned long device_address, void* const data_addr, unsigned int size )
+{
+    (void) handle;
+    check_idle( );
+    memcpy( data_addr, &flash[ device_address ], size );
+    now_us += BYTE_TIME_US * ( 4 + size );
+    return 0;
+}
+
+int sflash_write( const sflash_handle_t* const handle, unsigned long device_address, const void* const data_addr, int size )
+{
+    const uint8_t* data = (const uint8_t*) data_addr;
+    int i;
+
+    (void) handle;
+    check_idle( );
+    for ( i = 0; i < size; i++ )
+    {
+        flash[ device_address + i ] &= data[ i ];
+    }
+    now_us += BYTE_TIME_US * ( 4 + size ) + PROGRAM_BYTE_US * size;
+    return 0;
+}
+
+int sflash_sector_erase_start( const sflash_handle_t* const handle, unsigned long device_address )
+{
+    (void) handle;
+    check_idle( );
+    if ( erases_started < sizeof( started_address ) / sizeof( started_address[ 0 ] ) )
+    {
+        started_address[ erases_started ] = device_address;
+    }
+    erases_started++;
+    memset( &flash[ device_address & ~( MQTT_STORE_SECTOR_SIZE - 1UL ) ], 0xFF, MQTT_STORE_SECTOR_SIZE );
+    now_us += BYTE_TIME_US * 5;
+    busy_until_us = now_us + ERASE_TIME_US;
+    return 0;
+}
+
+int sflash_chip_erase_start( const sflash_handle_t* const handle )
+{
+    (void) handle;
+    check_idle( );
+    erases_started++;
+    memset( flash, 0xFF, sizeof( flash ) );
+    now_us += BYTE_TIME_US * 2;
+    busy_until_us = now_us + CHIP_ERASE_TIME_US;
+    return 0;
+}
+
+int sflash_sector_erase( const sflash_handle_t* const handle, unsigned long device_address )
+{
+    sflash_sector_erase_start( handle, device_address );
+    now_us = busy_until_us;
+    return 0;
+}
+
+int sflash_is_busy( const sflash_handle_t* const handle, int* const busy )
+{
+    (void) handle;
+    now_us += BYTE_TIME_US * 2;
+    *busy = ( now_us < busy_until_us ) ? 1 : 0;
+    return 0;
+}
+
+/******************************************************
+ *          RTOS on a simulated clock
+ ******************************************************/
+wiced_result_t wiced_rtos_init_mutex( wiced_mutex_t* mutex )     { (void) mutex; return WICED_SUCCESS; }
+wiced_result_t wiced_rtos_deinit_mutex( wiced_mutex_t* mutex )   { (void) mutex; return WICED_SUCCESS; }
+wiced_result_t wiced_rtos_lock_mutex( wiced_mutex_t* mutex )     { (void) mutex; mutexes_held++; return WICED_SUCCESS; }
+wiced_result_t wiced_rtos_unlock_mutex( wiced_mutex_t* mutex )   { (void) mutex; mutexes_held--; return WICED_SUCCESS; }
+wiced_result_t wiced_time_get_time( wiced_time_t* time )         { *time = (wiced_time_t) ( now_us / 1000 ); return WICED_SUCCESS; }
+
+wiced_result_t wiced_rtos_create_worker_thread( wiced_worker_thread_t* worker_thread, uint8_t priority, uint32_t stack_size, uint32_t event_queue_size )
+{
+    (void) worker_thread; (void) priority; (void) stack_size; (void) event_queue_size;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_delete_worker_thread( wiced_worker_thread_t* worker_thread )
+{
+    (void) worker_thread;
+    return WICED_SUCCESS;
+}
+
+static void run_until( uint64_t time_us );
+
+/* The worker thread runs while a caller sleeps here, unless the caller holds a mutex the
+ * worker's callbacks could need */
+wiced_result_t wiced_rtos_delay_milliseconds( uint32_t milliseconds )
+{
+    if ( mutexes_held == 0 )
+    {
+        run_until( now_us + (uint64_t) milliseconds * 1000 );
+    }
+    else
+    {
+        now_us += (uint64_t) milliseconds * 1000;
+    }
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_register_timed_event( wiced_timed_event_t* event_object, wiced_worker_thread_t* worker_thread, event_handler_t function, uint32_t time_ms, void* arg )
+{
+    (void) event_object; (void) worker_thread;
+    poll_function  = function;
+    poll_arg       = arg;
+    poll_period_ms = time_ms;
+    poll_running   = 1;
+    poll_due_us    = now_us + (uint64_t) time_ms * 1000;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_deregister_timed_event( wiced_timed_event_t* event_object )
+{
+    (void) event_object;
+    poll_function = NULL;
+    poll_running  = 0;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_start_timer( wiced_timer_t* timer )
+{
+    (void) timer;
+    poll_running = 1;
+    poll_due_us  = now_us + (uint64_t) poll_period_ms * 1000;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_stop_timer( wiced_timer_t* timer )
+{
+    (void) timer;
+    poll_running = 0;
+    return WICED_SUCCESS;
+}
+
+/* Moves the clock on to the given time, running the timed event on the way */
+static void run_until( uint64_t time_us )
+{
+    while ( ( poll_function != NULL ) && ( poll_running != 0 ) && ( poll_due_us <= time_us ) )
+    {
+        if ( now_us < poll_due_us )
+        {
+            now_us = poll_due_us;
+        }
+        poll_due_us += (uint64_t) poll_period_ms * 1000;
+        poll_function( poll_arg );
+    }
+    if ( now_us < time_us )
+    {
+        now_us = time_us;
+    }
+}
+
+/******************************************************
+ *               Erase queue
+ ******************************************************/
+static int completed[ 8 ];
+static int completion_order[ 8 ];
+static int completions;
+
+static void erase_done( void* arg, int status )
+{
+    int index = (int) (long) arg;
+
+    (void) status;
+    completed[ index ]++;
+    completion_order[ completions++ ] = index;
+}
+
+static void test_queue( void )
+{
+    static sflash_handle_t handle;
+    sflash_async_t         async;
+    sflash_async_erase_t   requests[ 5 ];
+    uint8_t                buffer[ 4 ];
+    uint64_t               start;
+    int                    i;
+
+    CHECK( sflash_async_init( &async, &handle, NULL ) == WICED_SUCCESS );
+    CHECK( poll_running == 0 );
+
+    for ( i = 0; i < 4; i++ )
+    {
+        sflash_async_sector_erase( &async, &requests[ i ], AREA_ADDRESS + i * MQTT_STORE_SECTOR_SIZE, erase_done, (void*) (long) i );
+    }
+    CHECK( erases_started == 1 );
+    CHECK( poll_running != 0 );
+
+    /* 0 has started, 2 is still queued */
+    CHECK( sflash_async_cancel( &async, &requests[ 0 ] ) == WICED_NOTFOUND );
+    CHECK( sflash_async_cancel( &async, &requests[ 2 ] ) == WICED_SUCCESS );
+
+    /* The read waits out erase 0, and erase 1 only starts after it */
+    start = now_us;
+    sflash_async_read( &async, AREA_ADDRESS, buffer, sizeof( buffer ) );
+    CHECK( now_us - start >= ERASE_TIME_US && now_us - start < 2 * ERASE_TIME_US );
+    CHECK( erases_started == 2 );
+
+    run_until( now_us + 4 * ERASE_TIME_US );
+    CHECK( poll_running == 0 );
+    CHECK( completions == 3 );
+    CHECK( completion_order[ 0 ] == 0 && completion_order[ 1 ] == 1 && completion_order[ 2 ] == 3 );
+    CHECK( completed[ 2 ] == 0 );
+    CHECK( erases_started == 3 );
+    CHECK( started_address[ 0 ] == AREA_ADDRESS && started_address[ 1 ] == AREA_ADDRESS + MQTT_STORE_SECTOR_SIZE &&
+           started_address[ 2 ] == AREA_ADDRESS + 3 * MQTT_STORE_SECTOR_SIZE );
+
+    /* Deinit waits for a chip erase in progress and its callback */
+    sflash_async_chip_erase( &async, &requests[ 4 ], erase_done, (void*) 4L );
+    sflash_async_deinit( &async );
+    CHECK( completed[ 4 ] == 1 );
+    CHECK( now_us >= busy_until_us );
+    CHECK( poll_function == NULL );
+    CHECK( busy_violations == 0 );
+}
+
+/******************************************************
+ *               Offline store
+ ******************************************************/
+static uint8_t delivered[ MAX_MESSAGES ];
+
+typedef struct
+{
+    uint64_t total_us;
+    uint64_t max_us;
+    unsigned count;
+    unsigned over_1ms;
+} latency_t;
+
+static void add_latency( latency_t* latency, uint64_t time_us )
+{
+    latency->total_us += time_us;
+    latency->max_us    = ( time_us > latency->max_us ) ? time_us : latency->max_us;
+    latency->over_1ms += ( time_us > 1000 ) ? 1 : 0;
+    latency->count++;
+}
+
+static void print_latency( const char* name, const latency_t* latency )
+{
+    printf( "%-8s %6u calls, mean %.2f ms, max %.1f ms, %u over 1 ms\n", name, latency->count,
+            latency->total_us / 1000.0 / latency->count, latency->max_us / 1000.0, latency->over_1ms );
+}
+
+static void test_store( int seconds )
+{
+    static mqtt_store_t       store;
+    wiced_mqtt_store_config_t config = { AREA_ADDRESS, AREA_SIZE, 0, WICED_FALSE };
+    uint8_t                   payload[ PAYLOAD_SIZE ];
+    char                      topic[ 32 ];
+    mqtt_publish_arg_t        args;
+    latency_t                 publishes = { 0 };
+    latency_t                 drains    = { 0 };
+    uint64_t                  end_us;
+    uint64_t                  next_publish_us;
+    uint64_t                  next_drain_us;
+    uint64_t                  start;
+    unsigned                  erases_before = erases_started;
+    int                       next_id       = 1;
+    int                       last_id       = 0;
+    int                       id;
+
+    memset( flash, 0xFF, sizeof( flash ) );
+    busy_until_us = now_us;
+    CHECK( mqtt_store_init( &store, &config ) == WICED_SUCCESS );
+
+    next_publish_us = now_us;
+    next_drain_us   = now_us + DRAIN_PERIOD_US / 2;
+    end_us          = now_us + (uint64_t) seconds * 1000000;
+    while ( ( now_us < end_us ) && ( next_id < MAX_MESSAGES ) )
+    {
+        if ( next_publish_us <= next_drain_us )
+        {
+            run_until( next_publish_us );
+            next_publish_us += PUBLISH_PERIOD_US;
+
+            sprintf( topic, "t/%d", next_id );
+            memset( payload, next_id, sizeof( payload ) );
+            memset( &args, 0, sizeof( args ) );
+            args.topic.str = (uint8_t*) topic;
+            args.topic.len = (uint16_t) strlen( topic );
+            args.data      = payload;
+            args.data_len  = sizeof( payload );
+
+            start = now_us;
+            CHECK( mqtt_store_append( &store, &args ) == WICED_SUCCESS );
+            add_latency( &publishes, now_us - start );
+            next_id++;
+        }
+        else
+        {
+            run_until( next_drain_us );
+            next_drain_us += DRAIN_PERIOD_US;
+
+            start = now_us;
+            if ( mqtt_store_read( &store, &args ) == WICED_SUCCESS )
+            {
+                memcpy( topic, args.topic.str, args.topic.len );
+                topic[ args.topic.len ] = '\0';
+                id = atoi( topic + 2 );
+                CHECK( id == last_id + 1 );
+                CHECK( args.data_len == PAYLOAD_SIZE && args.data[ 0 ] == (uint8_t) id );
+                delivered[ id ]++;
+                last_id = id;
+                mqtt_store_release( &store );
+                add_latency( &drains, now_us - start );
+            }
+        }
+    }
+    mqtt_store_deinit( &store );
+
+    printf( "%d s, a publish every %d ms and a drain every %d ms, %d ms erases: %u erases\n", seconds,
+            PUBLISH_PERIOD_US / 1000, DRAIN_PERIOD_US / 1000, ERASE_TIME_US / 1000, erases_started - erases_before );
+    print_latency( "publish", &publishes );
+    print_latency( "drain", &drains );
+    CHECK( last_id >= next_id - 2 );
+    for ( id = 1; id <= last_id; id++ )
+    {
+        CHECK( delivered[ id ] == 1 );
+    }
+}
+
+int main( int argc, char** argv )
+{
+    int seconds = ( argc > 1 ) ? atoi( argv[ 1 ] ) : 400;
+
+    test_queue( );
+    test_store( seconds );
+    printf( "chip used while busy %u times\n", busy_violations );
+    CHECK( busy_violations == 0 );
+
+    printf( ( failures != 0 ) ? "FAIL\n" : "PASS\n" );
+    return ( failures != 0 );
+}
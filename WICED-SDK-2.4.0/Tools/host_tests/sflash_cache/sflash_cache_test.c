@@ -0,0 +1,359 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  Serial flash read cache
+ *
+ *  spi_flash.c runs against a model of a 1 MB SPI NOR part behind the
+ *  sflash_platform_* byte interface. Each polled byte costs 0.9 us and each
+ *  command another 2.5 us for chip select and the layers above. The Makefile
+ *  builds the test with the cache the WizFi application uses and without.
+ *
+ *  Random reads, some carrying on from the previous one, are mixed with
+ *  writes and sector erases and checked against a copy of the flash. Then
+ *  mqtt_store.c is filled, restarted and drained, and the reads of its
+ *  start-up scan and of the drain are counted and timed.
+ *
+ *  Fails if a read returns data other than what the flash holds, or if a
+ *  stored message does not come back.
+ *
+ *  Usage: sflash_cache_test [operations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mqtt_internal.h"
+#include "mqtt_store.h"
+#include "spi_flash.h"
+#include "spi_flash_internal.h"
+#include "spi_flash_async.h"
+#include "spi_flash_platform_interface.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define FLASH_SIZE          (0x100000)
+#define FLASH_PAGE_SIZE     (256)
+#define FLASH_SECTOR_SIZE   (0x1000)
+#define FLASH_JEDEC_ID      (SFLASH_ID_MX25L8006E)
+
+#define BYTE_TIME_US        (0.9)
+#define COMMAND_TIME_US     (2.5)
+#define ERASE_POLLS         (3)
+
+#define FUZZ_SECTORS        (4)
+#define STORE_ADDRESS       (0x40000)
+#define STORE_SECTORS       (64)
+#define STORE_MESSAGES      (1500)
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static uint8_t  flash[ FLASH_SIZE ];
+static uint8_t  shadow[ FLASH_SIZE ];
+static double   now_us;
+
+static int      write_enabled;
+static int      busy_polls;
+static int      command;
+static int      bytes_in_command;
+static uint32_t command_address;
+
+/******************************************************
+ *               SPI NOR model
+ ******************************************************/
+
+int sflash_platform_init( int peripheral_id, void** platform_peripheral_out )
+{
+    (void) peripheral_id;
+    *platform_peripheral_out = (void*) 1;
+    return 0;
+}
+
+int sflash_platform_chip_select( void* platform_peripheral )
+{
+    (void) platform_peripheral;
+    bytes_in_command = 0;
+    now_us += COMMAND_TIME_US / 2;
+    return 0;
+}
+
+int sflash_platform_chip_deselect( void* platform_peripheral )
+{
+    (void) platform_peripheral;
+    now_us += COMMAND_TIME_US / 2;
+    if ( ( command == SFLASH_SECTOR_ERASE ) && ( bytes_in_command == 4 ) && write_enabled )
+    {
+        memset( &flash[ command_address & ~( FLASH_SECTOR_SIZE - 1 ) ], 0xFF, FLASH_SECTOR_SIZE );
+        busy_polls = ERASE_POLLS;
+    }
+    if ( command == SFLASH_WRITE || command == SFLASH_SECTOR_ERASE )
+    {
+        write_enabled = 0;
+    }
+    if ( command == SFLASH_WRITE_ENABLE )
+    {
+        write_enabled = 1;
+    }
+    return 0;
+}
+
+int sflash_platform_send_recv_byte( void* platform_peripheral, unsigned char MOSI_val, void* MISO_addr )
+{
+    unsigned char out = 0xFF;
+
+    (void) platform_peripheral;
+    now_us += BYTE_TIME_US;
+
+    if ( bytes_in_command == 0 )
+    {
+        command = MOSI_val;
+    }
+    else if ( ( bytes_in_command <= 3 ) && ( command == SFLASH_READ || command == SFLASH_WRITE || command == SFLASH_SECTOR_ERASE ) )
+    {
+        command_address = ( ( command_address << 8 ) | MOSI_val ) & 0xFFFFFF;
+    }
+    else if ( command == SFLASH_READ )
+    {
+        out = flash[ command_address % FLASH_SIZE ];
+        command_address++;
+    }
+    else if ( ( command == SFLASH_WRITE ) && write_enabled )
+    {
+        /* Wraps within the page */
+        flash[ command_address ] &= MOSI_val;
+        command_address = ( command_address & ~( FLASH_PAGE_SIZE - 1 ) ) | ( ( command_address + 1 ) & ( FLASH_PAGE_SIZE - 1 ) );
+    }
+    else if ( command == SFLASH_READ_STATUS_REGISTER )
+    {
+        out = ( ( busy_polls > 0 ) ? SFLASH_STATUS_REGISTER_BUSY : 0 ) | ( write_enabled ? SFLASH_STATUS_REGISTER_WRITE_ENABLED : 0 );
+        busy_polls = ( busy_polls > 0 ) ? busy_polls - 1 : 0;
+    }
+    else if ( command == SFLASH_READ_JEDEC_ID )
+    {
+        out = (unsigned char) ( FLASH_JEDEC_ID >> ( 8 * ( 3 - bytes_in_command ) ) );
+    }
+    bytes_in_command++;
+
+    if ( MISO_addr != NULL )
+    {
+        *(unsigned char*) MISO_addr = out;
+    }
+    return 0;
+}
+
+/******************************************************
+ *     RTOS and background erases, single threaded
+ ******************************************************/
+wiced_result_t wiced_rtos_init_mutex( wiced_mutex_t* mutex )     { (void) mutex; return WICED_SUCCESS; }
+wiced_result_t wiced_rtos_deinit_mutex( wiced_mutex_t* mutex )   { (void) mutex; return WICED_SUCCESS; }
+wiced_result_t wiced_rtos_lock_mutex( wiced_mutex_t* mutex )     { (void) mutex; return WICED_SUCCESS; }
+wiced_result_t wiced_rtos_unlock_mutex( wiced_mutex_t* mutex )   { (void) mutex; return WICED_SUCCESS; }
+wiced_result_t wiced_time_get_time( wiced_time_t* time )         { *time = (wiced_time_t) ( now_us / 1000 ); return WICED_SUCCESS; }
+
+wiced_result_t wiced_rtos_create_worker_thread( wiced_worker_thread_t* worker_thread, uint8_t priority, uint32_t stack_size, uint32_t event_queue_size )
+{
+    (void) worker_thread; (void) priority; (void) stack_size; (void) event_queue_size;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_rtos_delete_worker_thread( wiced_worker_thread_t* worker_thread )
+{
+    (void) worker_thread;
+    return WICED_SUCCESS;
+}
+
+/* Erases are done in line, so only the reads and writes of the store go through the cache */
+wiced_result_t sflash_async_init( sflash_async_t* async, const sflash_handle_t* handle, wiced_worker_thread_t* worker_thread )
+{
+    (void) worker_thread;
+    memset( async, 0, sizeof( *async ) );
+    async->handle = handle;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t sflash_async_deinit( sflash_async_t* async )
+{
+    (void) async;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t sflash_async_sector_erase( sflash_async_t* async, sflash_async_erase_t* request, unsigned long device_address, sflash_async_callback_t callback, void* arg )
+{
+    (void) request;
+    callback( arg, sflash_sector_erase( async->handle, device_address ) );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t sflash_async_cancel( sflash_async_t* async, sflash_async_erase_t* request )
+{
+    (void) async; (void) request;
+    return WICED_NOTFOUND;
+}
+
+void sflash_async_lock( sflash_async_t* async )   { (void) async; }
+void sflash_async_unlock( sflash_async_t* async ) { (void) async; }
+
+int sflash_async_read( sflash_async_t* async, unsigned long device_address, void* const data_addr, unsigned int size )
+{
+    return sflash_read( async->handle, device_address, data_addr, size );
+}
+
+int sflash_async_write( sflash_async_t* async, unsigned long device_address, const void* const data_addr, int size )
+{
+    return sflash_write( async->handle, device_address, data_addr, size );
+}
+
+/******************************************************
+ *               Test
+ ******************************************************/
+
+static void report( const char* name, double start_us )
+{
+    sflash_read_stats_t stats;
+    double              elapsed_us = now_us - start_us;
+
+    sflash_get_read_stats( &stats );
+    printf( "%-18s %6.1f ms  reads %5u  commands %5u  hits %4.1f%%  bytes requested %6u  transferred %6u\n",
+            name, elapsed_us / 1000, stats.hits + stats.misses, stats.read_commands,
+            100.0 * stats.hits / ( stats.hits + stats.misses ), stats.bytes_requested, stats.bytes_transferred );
+    sflash_reset_read_stats( );
+}
+
+/* Returns the number of reads that did not match the flash */
+static int run_coherence( long operations )
+{
+    static uint8_t  buffer[ 700 ];
+    static uint8_t  data[ 300 ];
+    sflash_handle_t handle;
+    unsigned long   next_address = 0;
+    int             mismatches = 0;
+    long            i;
+    int             busy;
+    int             j;
+
+    init_sflash( &handle, 0, SFLASH_WRITE_ALLOWED );
+    memcpy( shadow, flash, sizeof( shadow ) );
+    srand( 3 );
+
+    for ( i = 0; i < operations; i++ )
+    {
+        unsigned long address   = ( rand( ) % FUZZ_SECTORS ) * FLASH_SECTOR_SIZE + rand( ) % FLASH_SECTOR_SIZE;
+        int           operation = rand( ) % 100;
+        int           size;
+
+        if ( operation < 80 )
+        {
+            size = 1 + ( ( rand( ) % 10 == 0 ) ? rand( ) % 600 : rand( ) % 40 );
+            if ( ( rand( ) % 3 == 0 ) && ( next_address + size < FUZZ_SECTORS * FLASH_SECTOR_SIZE ) )
+            {
+                address = next_address;
+            }
+            sflash_read( &handle, address, buffer, size );
+            next_address = address + size;
+            mismatches += ( memcmp( buffer, &shadow[ address ], size ) != 0 ) ? 1 : 0;
+        }
+        else if ( operation < 97 )
+        {
+            size = 1 + rand( ) % 200;
+            for ( j = 0; j < size; j++ )
+            {
+                data[ j ] = (uint8_t) rand( );
+                shadow[ address + j ] &= data[ j ];
+            }
+            sflash_write( &handle, address, data, size );
+        }
+        else
+        {
+            if ( operation < 99 )
+            {
+                sflash_sector_erase( &handle, address );
+            }
+            else
+            {
+                sflash_sector_erase_start( &handle, address );
+                do
+                {
+                    sflash_is_busy( &handle, &busy );
+                } while ( busy != 0 );
+            }
+            memset( &shadow[ address & ~( FLASH_SECTOR_SIZE - 1UL ) ], 0xFF, FLASH_SECTOR_SIZE );
+        }
+    }
+    printf( "%ld reads, writes and erases: %d reads mismatched\n", operations, mismatches );
+    sflash_reset_read_stats( );
+    return mismatches;
+}
+
+/* Returns the number of stored messages that did not come back */
+static int run_store( void )
+{
+    static mqtt_store_t       store;
+    static uint8_t            payload[ 128 ];
+    wiced_mqtt_store_config_t config = { STORE_ADDRESS, STORE_SECTORS * MQTT_STORE_SECTOR_SIZE, 0, WICED_FALSE };
+    mqtt_publish_arg_t        args;
+    char                      topic[ 40 ];
+    double                    start;
+    int                       stored = 0;
+    int                       drained = 0;
+    int                       i;
+
+    srand( 7 );
+    mqtt_store_init( &store, &config );
+    for ( i = 0; i < STORE_MESSAGES; i++ )
+    {
+        sprintf( topic, "sensors/node%02d/temperature", i % 20 );
+        memset( &args, 0, sizeof( args ) );
+        args.topic.str = (uint8_t*) topic;
+        args.topic.len = (uint16_t) strlen( topic );
+        args.data      = payload;
+        args.data_len  = (uint32_t) ( 8 + rand( ) % 120 );
+        args.qos       = WICED_MQTT_QOS_DELIVER_AT_LEAST_ONCE;
+        stored += ( mqtt_store_append( &store, &args ) == WICED_SUCCESS ) ? 1 : 0;
+    }
+    mqtt_store_deinit( &store );
+    printf( "%d messages stored\n", stored );
+
+    sflash_reset_read_stats( );
+    start = now_us;
+    mqtt_store_init( &store, &config );
+    report( "start-up scan", start );
+
+    start = now_us;
+    while ( mqtt_store_read( &store, &args ) == WICED_SUCCESS )
+    {
+        mqtt_store_release( &store );
+        drained++;
+    }
+    report( "drain", start );
+    mqtt_store_deinit( &store );
+
+    return stored - drained;
+}
+
+int main( int argc, char** argv )
+{
+    long operations = ( argc > 1 ) ? atol( argv[ 1 ] ) : 1000000;
+    int  mismatches;
+    int  lost;
+
+    printf( "read cache %d lines of %d bytes, read-ahead %d\n", SFLASH_READ_CACHE_LINES, SFLASH_READ_CACHE_LINE_SIZE, SFLASH_READ_CACHE_READ_AHEAD );
+    memset( flash, 0xFF, sizeof( flash ) );
+    mismatches = run_coherence( operations );
+    lost       = run_store( );
+    if ( lost != 0 )
+    {
+        printf( "%d messages did not come back\n", lost );
+    }
+
+    printf( ( mismatches != 0 || lost != 0 ) ? "FAIL\n" : "PASS\n" );
+    return ( mismatches != 0 || lost != 0 );
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  Serial flash page programming
+ *
+ *  spi_flash.c runs against a model of a 1 MB SPI NOR part behind the
+ *  sflash_platform_* byte interface. The model keeps the write enable latch
+ *  and the busy bit, and a page program that runs past the end of its page
+ *  wraps to the start of that page, as the real parts do. Time is counted
+ *  at 1 us per SPI byte and 10 us + 5 us per byte programmed.
+ *
+ *  Unaligned writes of 1 byte to 64 KB are made for each supported part and
+ *  timed. SST25VF080B has no page program, so it shows the one byte per
+ *  command rate every part had before.
+ *
+ *  Fails if the flash differs from a reference copy, if a program command
+ *  crosses a page, or if a command other than a status read is sent while
+ *  the part is busy.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "spi_flash.h"
+#include "spi_flash_internal.h"
+#include "spi_flash_platform_interface.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define FLASH_SIZE          (0x100000)
+#define FLASH_PAGE_SIZE     (256)
+#define FLASH_SECTOR_SIZE   (0x1000)
+
+#define BYTE_TIME_US        (1.0)
+#define PROGRAM_TIME_US     (10.0)
+#define PROGRAM_BYTE_US     (5.0)
+#define ERASE_TIME_US       (45000.0)
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static uint8_t  flash[ FLASH_SIZE ];
+static uint8_t  reference[ FLASH_SIZE ];
+static uint32_t jedec_id;
+
+static double   now_us;
+static double   busy_until_us;
+static int      write_enabled;
+static int      command;
+static int      bytes_in_command;
+static uint32_t command_address;
+static uint8_t  page_buffer[ FLASH_PAGE_SIZE ];
+
+static int      page_crossings;
+static int      busy_violations;
+
+/******************************************************
+ *               SPI NOR model
+ ******************************************************/
+
+static void end_command( void )
+{
+    if ( command == SFLASH_WRITE && bytes_in_command > 4 )
+    {
+        uint32_t length = bytes_in_command - 4;
+        uint32_t page   = command_address & ~( FLASH_PAGE_SIZE - 1 );
+        uint32_t i;
+
+        if ( write_enabled )
+        {
+            if ( ( command_address % FLASH_PAGE_SIZE ) + length > FLASH_PAGE_SIZE )
+            {
+                page_crossings++;
+            }
+            /* The part keeps the last page of data and wraps within the page */
+            for ( i = 0; i < length; i++ )
+            {
+                flash[ page + ( command_address + i ) % FLASH_PAGE_SIZE ] &= page_buffer[ i % FLASH_PAGE_SIZE ];
+            }
+            busy_until_us = now_us + PROGRAM_TIME_US + PROGRAM_BYTE_US * length;
+        }
+        write_enabled = 0;
+    }
+    else if ( command == SFLASH_SECTOR_ERASE && bytes_in_command == 4 )
+    {
+        if ( write_enabled )
+        {
+            memset( &flash[ command_address & ~( FLASH_SECTOR_SIZE - 1 ) ], 0xFF, FLASH_SECTOR_SIZE );
+            busy_until_us = now_us + ERASE_TIME_US;
+        }
+        write_enabled = 0;
+    }
+    else if ( command == SFLASH_WRITE_ENABLE )
+    {
+        write_enabled = 1;
+    }
+}
+
+int sflash_platform_init( int peripheral_id, void** platform_peripheral_out )
+{
+    (void) peripheral_id;
+    *platform_peripheral_out = (void*) 1;
+    return 0;
+}
+
+int sflash_platform_chip_select( void* platform_peripheral )
+{
+    (void) platform_peripheral;
+    bytes_in_command = 0;
+    return 0;
+}
+
+int sflash_platform_chip_deselect( void* platform_peripheral )
+{
+    (void) platform_peripheral;
+    end_command( );
+    return 0;
+}
+
+int sflash_platform_send_recv_byte( void* platform_peripheral, unsigned char MOSI_val, void* MISO_addr )
+{
+    unsigned char out = 0xFF;
+
+    (void) platform_peripheral;
+    now_us += BYTE_TIME_US;
+
+    if ( bytes_in_command == 0 )
+    {
+        command = MOSI_val;
+        if ( ( now_us < busy_until_us ) && ( command != SFLASH_READ_STATUS_REGISTER ) )
+        {
+            busy_violations++;
+        }
+    }
+    else if ( command == SFLASH_READ_JEDEC_ID )
+    {
+        out = (unsigned char) ( jedec_id >> ( 8 * ( 3 - bytes_in_command ) ) );
+    }
+    else if ( command == SFLASH_READ_STATUS_REGISTER )
+    {
+        out = ( ( now_us < busy_until_us ) ? SFLASH_STATUS_REGISTER_BUSY : 0 ) |
+              ( write_enabled ? SFLASH_STATUS_REGISTER_WRITE_ENABLED : 0 );
+    }
+    else if ( command == SFLASH_WRITE || command == SFLASH_READ || command == SFLASH_SECTOR_ERASE )
+    {
+        if ( bytes_in_command <= 3 )
+        {
+            command_address = ( ( command_address << 8 ) | MOSI_val ) & 0xFFFFFF;
+        }
+        else if ( command == SFLASH_WRITE )
+        {
+            page_buffer[ ( bytes_in_command - 4 ) % FLASH_PAGE_SIZE ] = MOSI_val;
+        }
+        else if ( command == SFLASH_READ )
+        {
+            out = flash[ ( command_address + bytes_in_command - 4 ) % FLASH_SIZE ];
+        }
+    }
+    bytes_in_command++;
+
+    if ( MISO_addr != NULL )
+    {
+        *(unsigned char*) MISO_addr = out;
+    }
+    return 0;
+}
+
+/******************************************************
+ *               Test
+ ******************************************************/
+
+/* Returns the number of bytes that differ from the reference */
+static int run_part( const char* name, uint32_t id )
+{
+    static const int sizes[] = { 1, 16, 100, 256, 300, 1024, 4096, 65536 };
+    static uint8_t   data[ 65536 ];
+    sflash_handle_t  handle;
+    uint32_t         address = 0;
+    int              mismatches = 0;
+    int              i, j, k;
+
+    jedec_id = id;
+    memset( flash, 0xFF, sizeof( flash ) );
+    memset( reference, 0xFF, sizeof( reference ) );
+    now_us = busy_until_us = 0;
+    write_enabled = 0;
+    init_sflash( &handle, 0, SFLASH_WRITE_ALLOWED );
+
+    printf( "%-12s", name );
+    srand( 3 );
+    for ( k = 0; k < (int) ( sizeof( sizes ) / sizeof( sizes[ 0 ] ) ); k++ )
+    {
+        int    size    = sizes[ k ];
+        int    repeats = ( size >= 4096 ) ? 2 : 8;
+        double start   = now_us;
+
+        for ( i = 0; i < repeats; i++ )
+        {
+            /* A fresh, unaligned region each time */
+            address += rand( ) % 300;
+            if ( address + size >= FLASH_SIZE )
+            {
+                address = 0;
+            }
+            for ( j = 0; j < size; j++ )
+            {
+                data[ j ] = (uint8_t) rand( );
+                reference[ address + j ] &= data[ j ];
+            }
+            sflash_write( &handle, address, data, size );
+            address += size;
+        }
+        printf( " %7.0f", repeats * size / ( ( now_us - start ) / 1e6 ) / 1024 );
+    }
+    printf( "\n" );
+
+    for ( i = 0; i < FLASH_SIZE; i++ )
+    {
+        mismatches += ( flash[ i ] != reference[ i ] ) ? 1 : 0;
+    }
+    sflash_read( &handle, 0, data, sizeof( data ) );
+    mismatches += ( memcmp( data, reference, sizeof( data ) ) != 0 ) ? 1 : 0;
+    return mismatches;
+}
+
+int main( void )
+{
+    int mismatches = 0;
+
+    printf( "write KB/s  %7s %7s %7s %7s %7s %7s %7s %7s\n", "1 B", "16 B", "100 B", "256 B", "300 B", "1 KB", "4 KB", "64 KB" );
+    mismatches += run_part( "EN25Q80A", SFLASH_ID_EN25Q80A );
+    mismatches += run_part( "MX25L8006E", SFLASH_ID_MX25L8006E );
+    mismatches += run_part( "SST25VF080B", SFLASH_ID_SST25VF080B );
+    printf( "mismatched bytes %d, page-crossing programs %d, commands while busy %d\n", mismatches, page_crossings, busy_violations );
+
+    printf( ( mismatches != 0 || page_crossings != 0 || busy_violations != 0 ) ? "FAIL\n" : "PASS\n" );
+    return ( mismatches != 0 || page_crossings != 0 || busy_violations != 0 );
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  What the bootloader's flash_if.c and ymodem.c use of the STM32F2xx
+ *  headers, with the flash registers and calls provided by ymodem_test.c
+ */
+#pragma once
+
+#include <stdint.h>
+
+#define __IO    volatile
+
+typedef struct
+{
+    __IO uint32_t CR;
+    __IO uint32_t SR;
+} FLASH_TypeDef;
+
+typedef enum
+{
+    FLASH_BUSY = 1,
+    FLASH_ERROR_PGS,
+    FLASH_ERROR_PGP,
+    FLASH_ERROR_PGA,
+    FLASH_ERROR_WRP,
+    FLASH_ERROR_PROGRAM,
+    FLASH_ERROR_OPERATION,
+    FLASH_COMPLETE
+} FLASH_Status;
+
+/* Each access moves the simulated clock on */
+FLASH_TypeDef* host_flash_registers( void );
+#define FLASH   ( host_flash_registers( ) )
+
+#define FLASH_FLAG_EOP      ((uint32_t)0x00000001)
+#define FLASH_FLAG_OPERR    ((uint32_t)0x00000002)
+#define FLASH_FLAG_WRPERR   ((uint32_t)0x00000010)
+#define FLASH_FLAG_PGAERR   ((uint32_t)0x00000020)
+#define FLASH_FLAG_PGPERR   ((uint32_t)0x00000040)
+#define FLASH_FLAG_PGSERR   ((uint32_t)0x00000080)
+#define FLASH_FLAG_BSY      ((uint32_t)0x00010000)
+#define FLASH_PSIZE_WORD    ((uint32_t)0x00000200)
+#define CR_PSIZE_MASK       ((uint32_t)0xFFFFFCFF)
+#define FLASH_CR_PG         ((uint32_t)0x00000001)
+#define VoltageRange_3      ((uint8_t)0x02)
+
+#define FLASH_Sector_0      ((uint16_t)0x0000)
+#define FLASH_Sector_1      ((uint16_t)0x0008)
+#define FLASH_Sector_2      ((uint16_t)0x0010)
+#define FLASH_Sector_3      ((uint16_t)0x0018)
+#define FLASH_Sector_4      ((uint16_t)0x0020)
+#define FLASH_Sector_5      ((uint16_t)0x0028)
+#define FLASH_Sector_6      ((uint16_t)0x0030)
+#define FLASH_Sector_7      ((uint16_t)0x0038)
+#define FLASH_Sector_8      ((uint16_t)0x0040)
+#define FLASH_Sector_9      ((uint16_t)0x0048)
+#define FLASH_Sector_10     ((uint16_t)0x0050)
+#define FLASH_Sector_11     ((uint16_t)0x0058)
+
+void         FLASH_Unlock( void );
+void         FLASH_ClearFlag( uint32_t FLASH_FLAG );
+FLASH_Status FLASH_EraseSector( uint32_t FLASH_Sector, uint8_t VoltageRange );
+FLASH_Status FLASH_WaitForLastOperation( void );
+
+/* The LED the bootloader blinks while it receives */
+#define GPIO_SetBits( port, pin )      ( (void) 0 )
+#define GPIO_ResetBits( port, pin )    ( (void) 0 )
@@ -0,0 +1,745 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  YMODEM download into internal flash
+ *
+ *  The bootloader's ymodem.c and flash_if.c receive images from a modelled
+ *  sender over a 115200 baud line, on a simulated clock. The sender answers
+ *  2 ms after each reply and sends again after 1 s of silence. A byte that
+ *  arrives before the previous one is read is lost, as on the UART.
+ *
+ *  Internal flash is mapped at its STM32F2xx address and kept read-only. A
+ *  store to it traps; the word is then programmed with NOR semantics if PG
+ *  is set with a 32-bit width, and the flash stays busy for 16 us, during
+ *  which the CPU stalls on its next code fetch.
+ *
+ *  Clean transfers of several sizes are timed. Then faults are injected: a
+ *  corrupted, a shortened and a repeated packet, a lost header ACK, aborts
+ *  by the sender and by the user, a line that never goes quiet, and headers
+ *  without a size for an image that fits and for one that does not.
+ *
+ *  Fails if a transfer that should complete does not or leaves the flash
+ *  different from the image, if one that should not complete hangs or
+ *  reports success, or if the watchdog goes unkicked for WATCHDOG_MAX_GAP_US
+ *  once data packets are being sent.
+ *
+ *  x86-64 Linux only, as the trap single-steps the store.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include "flash_if.h"
+#include "ioutil.h"
+#include "ymodem.h"
+#include "watchdog.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define FLASH_BASE_ADDRESS      (0x08000000)
+#define FLASH_SIZE              (0x100000)
+#define IMAGE_START_ADDRESS     (ADDR_FLASH_SECTOR_4)
+#define IMAGE_AREA_SIZE         (FLASH_BASE_ADDRESS + FLASH_SIZE - IMAGE_START_ADDRESS)
+
+#define BYTE_TIME_US            (86.8)      /* 115200 baud, 8N1 */
+#define POLL_TIME_US            (0.08)      /* One pass of the Receive_Byte() loop */
+#define REGISTER_TIME_US        (0.02)
+#define WORD_PROGRAM_US         (16.0)
+#define SENDER_TURNAROUND_US    (2000.0)    /* PC and USB serial adapter */
+#define SENDER_TIMEOUT_US       (1000000.0)
+#define GIVE_UP_US              (600e6)     /* A transfer still going after this has hung */
+#define WATCHDOG_MAX_GAP_US     (1000000.0) /* Well inside the 22 s default timeout */
+
+#define LINE_QUEUE_SIZE         (1 << 16)
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+typedef enum
+{
+    FAULT_NONE,
+    FAULT_CORRUPT,          /* One byte of the block is flipped */
+    FAULT_DROP_BYTE,        /* One byte of the block never arrives */
+    FAULT_LOSE_ACK,         /* The ACK of the block is lost, so it is sent again */
+    FAULT_LOSE_HEADER_ACK,
+    FAULT_SENDER_ABORT,     /* CA CA instead of the block */
+    FAULT_USER_ABORT,       /* 'a' typed instead of the block */
+    FAULT_NOISE,            /* The line never goes quiet from the block on */
+    FAULT_NO_SIZE,          /* The header gives the name only */
+} fault_t;
+
+typedef enum
+{
+    SENDER_WAIT_HEADER_C,
+    SENDER_HEADER,
+    SENDER_WAIT_DATA_C,
+    SENDER_DATA,
+    SENDER_EOT,
+    SENDER_WAIT_FINAL_C,
+    SENDER_FINAL,
+    SENDER_DONE,
+    SENDER_ABORTED,
+    SENDER_NOISE,
+} sender_state_t;
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct
+{
+    const char* name;
+    uint32_t    image_size;
+    int         block_size;
+    fault_t     fault;
+    uint32_t    fault_block;
+    int         completes;
+} scenario_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static const scenario_t scenarios[] =
+{
+    { "300 KB in 1 KB blocks",      300000,          1024, FAULT_NONE,            0, 1 },
+    { "300 KB in 128 byte blocks",  300000,          128,  FAULT_NONE,            0, 1 },
+    { "20 KB",                      20000,           1024, FAULT_NONE,            0, 1 },
+    { "sectors 4-11 exactly",       IMAGE_AREA_SIZE, 1024, FAULT_NONE,            0, 1 },
+    { "corrupted block",            100000,          1024, FAULT_CORRUPT,         5, 1 },
+    { "byte dropped",               100000,          1024, FAULT_DROP_BYTE,       5, 1 },
+    { "data ACK lost",              100000,          1024, FAULT_LOSE_ACK,        5, 1 },
+    { "header ACK lost",            100000,          1024, FAULT_LOSE_HEADER_ACK, 0, 1 },
+    { "sender abort",               100000,          1024, FAULT_SENDER_ABORT,    5, 0 },
+    { "user abort",                 100000,          1024, FAULT_USER_ABORT,      5, 0 },
+    { "line never quiet",           100000,          1024, FAULT_NOISE,           5, 0 },
+    { "no size in header",          100000,          1024, FAULT_NO_SIZE,         0, 1 },
+    { "no size, too large",         IMAGE_AREA_SIZE + 2048, 1024, FAULT_NO_SIZE,  0, 0 },
+};
+
+static const scenario_t* scenario;
+static uint8_t*          image;
+static jmp_buf           give_up;
+
+/* Clock and flash */
+static double        now_us;
+static double        flash_busy_until_us;
+static FLASH_TypeDef flash_registers;
+static uint8_t*      flash;
+static uint32_t      trapped_address;
+static uint32_t      trapped_old_word;
+static int           trapping;
+static long          words_programmed;
+
+/* Line from the sender, with the time each byte has fully arrived */
+static uint8_t  line_data[ LINE_QUEUE_SIZE ];
+static double   line_time[ LINE_QUEUE_SIZE ];
+static int      line_head;
+static int      line_count;
+static double   line_free_us;
+static long     overruns;
+
+/* Sender */
+static sender_state_t sender_state;
+static uint32_t       block;
+static double         waiting_since_us;
+static int            resends;
+static int            fault_pending;
+static double         first_byte_us;
+static double         done_us;
+
+/* Watchdog, measured once data blocks are being sent */
+static double last_kick_us;
+static double max_kick_gap_us;
+
+static char messages[ 512 ];
+
+/******************************************************
+ *               Internal flash
+ ******************************************************/
+
+static void flash_writable( int writable )
+{
+    mprotect( flash, FLASH_SIZE, writable ? ( PROT_READ | PROT_WRITE ) : PROT_READ );
+}
+
+static void flash_update_status( void )
+{
+    if ( now_us >= flash_busy_until_us )
+    {
+        flash_registers.SR &= ~FLASH_FLAG_BSY;
+    }
+    else
+    {
+        flash_registers.SR |= FLASH_FLAG_BSY;
+    }
+}
+
+FLASH_TypeDef* host_flash_registers( void )
+{
+    now_us += REGISTER_TIME_US;
+    flash_update_status( );
+    return &flash_registers;
+}
+
+/* A store to flash: let it through, then check it after one instruction */
+static void flash_store_fault( int signal_number, siginfo_t* info, void* context )
+{
+    ucontext_t* user_context = (ucontext_t*) context;
+    uint32_t    address      = (uint32_t) (uintptr_t) info->si_addr;
+
+    (void) signal_number;
+    if ( ( address < FLASH_BASE_ADDRESS ) || ( address >= FLASH_BASE_ADDRESS + FLASH_SIZE ) || trapping )
+    {
+        fprintf( stderr, "FAIL: fault at 0x%08X\n", address );
+        _exit( 2 );
+    }
+    if ( now_us < flash_busy_until_us )
+    {
+        now_us = flash_busy_until_us;
+    }
+    trapped_address  = address & ~3U;
+    trapped_old_word = *(uint32_t*) (uintptr_t) trapped_address;
+    flash_writable( 1 );
+    trapping = 1;
+    user_context->uc_mcontext.gregs[ REG_EFL ] |= 0x100;
+}
+
+static void flash_store_done( int signal_number, siginfo_t* info, void* context )
+{
+    ucontext_t* user_context = (ucontext_t*) context;
+    uint32_t*   word         = (uint32_t*) (uintptr_t) trapped_address;
+    uint32_t    written      = *word;
+
+    (void) signal_number;
+    (void) info;
+    user_context->uc_mcontext.gregs[ REG_EFL ] &= ~0x100;
+    trapping = 0;
+    if ( ( ( flash_registers.CR & FLASH_CR_PG ) == 0 ) || ( ( flash_registers.CR & ~CR_PSIZE_MASK ) != FLASH_PSIZE_WORD ) )
+    {
+        *word = trapped_old_word;
+        flash_registers.SR |= FLASH_FLAG_PGSERR;
+    }
+    else
+    {
+        /* Bits only go from one to zero; a word not erased reads back wrong */
+        *word = trapped_old_word & written;
+        flash_busy_until_us = now_us + WORD_PROGRAM_US;
+        words_programmed++;
+    }
+    flash_writable( 0 );
+}
+
+void FLASH_Unlock( void )
+{
+}
+
+void FLASH_ClearFlag( uint32_t FLASH_FLAG )
+{
+    flash_registers.SR &= ~FLASH_FLAG;
+}
+
+FLASH_Status FLASH_WaitForLastOperation( void )
+{
+    if ( now_us < flash_busy_until_us )
+    {
+        now_us = flash_busy_until_us;
+    }
+    flash_update_status( );
+    return ( ( flash_registers.SR & ( FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR | FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR ) ) != 0 ) ? FLASH_ERROR_PROGRAM : FLASH_COMPLETE;
+}
+
+FLASH_Status FLASH_EraseSector( uint32_t FLASH_Sector, uint8_t VoltageRange )
+{
+    static const uint32_t offset[ 12 ] = { 0, 0x4000, 0x8000, 0xC000, 0x10000, 0x20000, 0x40000, 0x60000, 0x80000, 0xA0000, 0xC0000, 0xE0000 };
+    static const uint32_t size[ 12 ]   = { 0x4000, 0x4000, 0x4000, 0x4000, 0x10000, 0x20000, 0x20000, 0x20000, 0x20000, 0x20000, 0x20000, 0x20000 };
+    int sector = FLASH_Sector / 8;
+
+    (void) VoltageRange;
+    FLASH_WaitForLastOperation( );
+    flash_writable( 1 );
+    memset( flash + offset[ sector ], 0xFF, size[ sector ] );
+    flash_writable( 0 );
+
+    /* Typical sector erase times at x32 */
+    now_us += ( size[ sector ] == 0x4000 ) ? 400000 : ( size[ sector ] == 0x10000 ) ? 1100000 : 2000000;
+    return FLASH_COMPLETE;
+}
+
+/******************************************************
+ *               Sender
+ ******************************************************/
+
+static void line_send( const uint8_t* data, int length, double start_us )
+{
+    double time_us = ( start_us > line_free_us ) ? start_us : line_free_us;
+    int    i;
+
+    for ( i = 0; i < length; i++ )
+    {
+        time_us += BYTE_TIME_US;
+        line_data[ ( line_head + line_count ) % LINE_QUEUE_SIZE ] = data[ i ];
+        line_time[ ( line_head + line_count ) % LINE_QUEUE_SIZE ] = time_us;
+        line_count++;
+    }
+    line_free_us = time_us;
+}
+
+static uint16_t crc16( const uint8_t* data, int length )
+{
+    uint16_t crc = 0;
+    int      i, bit;
+
+    for ( i = 0; i < length; i++ )
+    {
+        crc ^= (uint16_t) ( data[ i ] << 8 );
+        for ( bit = 0; bit < 8; bit++ )
+        {
+            crc = ( crc & 0x8000 ) ? (uint16_t) ( ( crc << 1 ) ^ 0x1021 ) : (uint16_t) ( crc << 1 );
+        }
+    }
+    return crc;
+}
+
+static void send_packet( uint8_t sequence, const uint8_t* data, int length, int size, double start_us, fault_t fault )
+{
+    uint8_t  packet[ PACKET_1K_SIZE + PACKET_OVERHEAD ];
+    int      packet_length = size + PACKET_OVERHEAD;
+    uint16_t crc;
+
+    packet[ 0 ]                       = ( size == PACKET_1K_SIZE ) ? STX : SOH;
+    packet[ PACKET_SEQNO_INDEX ]      = sequence;
+    packet[ PACKET_SEQNO_COMP_INDEX ] = (uint8_t) ~sequence;
+    memset( packet + PACKET_HEADER, 0x1A, size );
+    memcpy( packet + PACKET_HEADER, data, length );
+    crc = crc16( packet + PACKET_HEADER, size );
+    packet[ PACKET_HEADER + size ]     = (uint8_t) ( crc >> 8 );
+    packet[ PACKET_HEADER + size + 1 ] = (uint8_t) crc;
+
+    if ( fault == FAULT_CORRUPT )
+    {
+        packet[ 100 ] ^= 0x40;
+    }
+    else if ( fault == FAULT_DROP_BYTE )
+    {
+        memmove( packet + 50, packet + 51, packet_length - 51 );
+        packet_length--;
+    }
+    line_send( packet, packet_length, start_us );
+    if ( first_byte_us < 0 )
+    {
+        first_byte_us = start_us;
+    }
+    waiting_since_us = line_free_us;
+}
+
+static void send_header( double start_us, int last )
+{
+    uint8_t header[ PACKET_SIZE ];
+    int     name_length;
+
+    memset( header, 0, sizeof( header ) );
+    if ( last == 0 )
+    {
+        name_length = sprintf( (char*) header, "image.bin" );
+        if ( scenario->fault != FAULT_NO_SIZE )
+        {
+            sprintf( (char*) header + name_length + 1, "%u ", (unsigned) scenario->image_size );
+        }
+    }
+    send_packet( 0, header, PACKET_SIZE, PACKET_SIZE, start_us, FAULT_NONE );
+}
+
+static void send_block( double start_us, int first_time )
+{
+    uint32_t offset = ( block - 1 ) * scenario->block_size;
+    uint32_t length = scenario->image_size - offset;
+    int      size   = scenario->block_size;
+    fault_t  fault  = ( first_time && ( block == scenario->fault_block ) ) ? scenario->fault : FAULT_NONE;
+
+    if ( block == 1 && first_time )
+    {
+        last_kick_us = start_us;
+    }
+    if ( length > (uint32_t) size )
+    {
+        length = size;
+    }
+    if ( ( size == PACKET_1K_SIZE ) && ( length <= PACKET_SIZE ) )
+    {
+        /* A short tail goes in a 128 byte block */
+        size = PACKET_SIZE;
+    }
+
+    if ( fault == FAULT_SENDER_ABORT )
+    {
+        static const uint8_t abort[ 2 ] = { CA, CA };
+        line_send( abort, 2, start_us );
+        sender_state = SENDER_ABORTED;
+        return;
+    }
+    if ( fault == FAULT_USER_ABORT )
+    {
+        static const uint8_t abort = ABORT2;
+        line_send( &abort, 1, start_us );
+        sender_state = SENDER_ABORTED;
+        return;
+    }
+    if ( fault == FAULT_NOISE )
+    {
+        sender_state = SENDER_NOISE;
+        return;
+    }
+    if ( fault == FAULT_LOSE_ACK )
+    {
+        fault_pending = 1;
+    }
+    send_packet( (uint8_t) block, image + offset, (int) length, size, start_us, fault );
+}
+
+static void send_eot( double start_us )
+{
+    static const uint8_t eot = EOT;
+
+    line_send( &eot, 1, start_us );
+    waiting_since_us = line_free_us;
+}
+
+/* A byte from the receiver has arrived at the sender */
+static void sender_receive( uint8_t c, double time_us )
+{
+    double reply_us = time_us + SENDER_TURNAROUND_US;
+
+    if ( c == CA )
+    {
+        sender_state = SENDER_ABORTED;
+        return;
+    }
+    switch ( sender_state )
+    {
+        case SENDER_WAIT_HEADER_C:
+            if ( c == CRC16 )
+            {
+                fault_pending = ( scenario->fault == FAULT_LOSE_HEADER_ACK );
+                send_header( reply_us, 0 );
+                sender_state = SENDER_HEADER;
+            }
+            break;
+
+        case SENDER_HEADER:
+            if ( c == ACK && fault_pending )
+            {
+                fault_pending = 0;
+            }
+            else if ( c == ACK )
+            {
+                sender_state = SENDER_WAIT_DATA_C;
+            }
+            else if ( c == NAK )
+            {
+                send_header( reply_us, 0 );
+                resends++;
+            }
+            break;
+
+        case SENDER_WAIT_DATA_C:
+            if ( c == CRC16 )
+            {
+                sender_state = SENDER_DATA;
+                block = 1;
+                send_block( reply_us, 1 );
+            }
+            break;
+
+        case SENDER_DATA:
+            if ( c == ACK && fault_pending )
+            {
+                fault_pending = 0;
+            }
+            else if ( c == ACK && ( block * (uint32_t) scenario->block_size >= scenario->image_size ) )
+            {
+                send_eot( reply_us );
+                sender_state = SENDER_EOT;
+            }
+            else if ( c == ACK )
+            {
+                block++;
+                send_block( reply_us, 1 );
+            }
+            else if ( c == NAK || c == CRC16 )
+            {
+                send_block( reply_us, 0 );
+                resends++;
+            }
+            break;
+
+        case SENDER_EOT:
+            if ( c == ACK )
+            {
+                sender_state = SENDER_WAIT_FINAL_C;
+            }
+            else if ( c == NAK )
+            {
+                send_eot( reply_us );
+            }
+            break;
+
+        case SENDER_WAIT_FINAL_C:
+            if ( c == CRC16 )
+            {
+                send_header( reply_us, 1 );
+                sender_state = SENDER_FINAL;
+            }
+            break;
+
+        case SENDER_FINAL:
+            if ( c == ACK )
+            {
+                sender_state = SENDER_DONE;
+                done_us      = time_us;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void sender_check_timeout( void )
+{
+    static const uint8_t noise = 0x00;
+
+    if ( sender_state == SENDER_NOISE )
+    {
+        if ( line_count < 2 )
+        {
+            line_send( &noise, 1, now_us );
+        }
+        return;
+    }
+    if ( ( now_us - waiting_since_us < SENDER_TIMEOUT_US ) || ( line_free_us > now_us ) )
+    {
+        return;
+    }
+    waiting_since_us = now_us;
+    if ( sender_state == SENDER_DATA )
+    {
+        send_block( now_us, 0 );
+        resends++;
+    }
+    else if ( sender_state == SENDER_HEADER )
+    {
+        send_header( now_us, 0 );
+        resends++;
+    }
+    else if ( sender_state == SENDER_EOT )
+    {
+        send_eot( now_us );
+    }
+}
+
+/******************************************************
+ *               UART and watchdog
+ ******************************************************/
+
+uint32_t SerialKeyPressed( uint8_t* key )
+{
+    now_us += POLL_TIME_US;
+
+    /* Code is fetched from flash, so the CPU waits while it is busy */
+    if ( now_us < flash_busy_until_us )
+    {
+        now_us = flash_busy_until_us;
+    }
+    if ( now_us - first_byte_us > GIVE_UP_US )
+    {
+        longjmp( give_up, 1 );
+    }
+    sender_check_timeout( );
+    if ( ( line_count == 0 ) || ( line_time[ line_head ] > now_us ) )
+    {
+        return 0;
+    }
+
+    /* Bytes that arrived while this one sat unread are lost */
+    while ( ( line_count > 1 ) && ( line_time[ ( line_head + 1 ) % LINE_QUEUE_SIZE ] <= now_us ) )
+    {
+        int i;
+
+        for ( i = 1; i < line_count - 1; i++ )
+        {
+            line_data[ ( line_head + i ) % LINE_QUEUE_SIZE ] = line_data[ ( line_head + i + 1 ) % LINE_QUEUE_SIZE ];
+            line_time[ ( line_head + i ) % LINE_QUEUE_SIZE ] = line_time[ ( line_head + i + 1 ) % LINE_QUEUE_SIZE ];
+        }
+        line_count--;
+        overruns++;
+    }
+    *key      = line_data[ line_head ];
+    line_head = ( line_head + 1 ) % LINE_QUEUE_SIZE;
+    line_count--;
+    return 1;
+}
+
+void SerialPutChar( uint8_t c )
+{
+    now_us += BYTE_TIME_US;
+    sender_receive( c, now_us );
+}
+
+/* Keeps what the receiver reports once the sender has started */
+void Serial_PutString( uint8_t* s )
+{
+    if ( first_byte_us < 0 )
+    {
+        return;
+    }
+    strncat( messages, (const char*) s, sizeof( messages ) - strlen( messages ) - 1 );
+}
+
+uint32_t Str2Int( uint8_t* inputstr, int32_t* intnum )
+{
+    *intnum = atoi( (const char*) inputstr );
+    return 1;
+}
+
+void Int2Str( uint8_t* str, uint8_t base, int64_t intnum )
+{
+    sprintf( (char*) str, ( base == 16 ) ? "%llx" : "%lld", (long long) intnum );
+}
+
+wiced_result_t watchdog_kick( void )
+{
+    if ( ( block > 0 ) && ( now_us - last_kick_us > max_kick_gap_us ) )
+    {
+        max_kick_gap_us = now_us - last_kick_us;
+    }
+    last_kick_us = now_us;
+    return WICED_SUCCESS;
+}
+
+/******************************************************
+ *               Test
+ ******************************************************/
+
+/* Returns non-zero if the scenario went as it should */
+static int run_scenario( const scenario_t* run )
+{
+    char     outcome[ 64 ];
+    char*    message;
+    double   seconds;
+    int      hung = 0;
+    int      matches;
+    int      passed;
+    uint32_t i;
+
+    scenario         = run;
+    now_us           = 0;
+    flash_busy_until_us = 0;
+    memset( &flash_registers, 0, sizeof( flash_registers ) );
+    line_head        = 0;
+    line_count       = 0;
+    line_free_us     = 0;
+    overruns         = 0;
+    sender_state     = SENDER_WAIT_HEADER_C;
+    block            = 0;
+    waiting_since_us = 0;
+    resends          = 0;
+    fault_pending    = 0;
+    first_byte_us    = -1;
+    done_us          = 0;
+    max_kick_gap_us  = 0;
+    words_programmed = 0;
+    messages[ 0 ]    = '\0';
+
+    /* Whatever was there before */
+    flash_writable( 1 );
+    for ( i = 0; i < FLASH_SIZE; i++ )
+    {
+        flash[ i ] = (uint8_t) rand( );
+    }
+    flash_writable( 0 );
+    image = malloc( run->image_size );
+    for ( i = 0; i < run->image_size; i++ )
+    {
+        image[ i ] = (uint8_t) rand( );
+    }
+
+    if ( setjmp( give_up ) == 0 )
+    {
+        SerialDownload( IMAGE_START_ADDRESS, ADDR_FLASH_SECTOR_11 );
+    }
+    else
+    {
+        hung = 1;
+    }
+
+    /* An image too large for the area is compared as far as the area goes */
+    matches = ( memcmp( flash + ( IMAGE_START_ADDRESS - FLASH_BASE_ADDRESS ), image, ( run->image_size < IMAGE_AREA_SIZE ) ? run->image_size : IMAGE_AREA_SIZE ) == 0 );
+    free( image );
+    if ( run->completes )
+    {
+        passed = !hung && ( sender_state == SENDER_DONE ) && matches && ( strstr( messages, "Completed Successfully" ) != NULL );
+    }
+    else
+    {
+        passed = !hung && ( strstr( messages, "Completed Successfully" ) == NULL );
+    }
+    passed = passed && ( max_kick_gap_us <= WATCHDOG_MAX_GAP_US );
+
+    for ( message = messages; ( *message == '\r' ) || ( *message == '\n' ) || ( *message == ' ' ); message++ )
+    {
+    }
+    outcome[ 0 ] = '\0';
+    sscanf( message, "%63[^\r\n]", outcome );
+    seconds = ( ( ( done_us > 0 ) ? done_us : now_us ) - first_byte_us ) / 1e6;
+    printf( "%-26s %-36s %s, flash %s, %6.1f s", run->name, hung ? "hung" : outcome,
+            ( sender_state == SENDER_DONE ) ? "sent" : "not sent", matches ? "matches" : "differs", seconds );
+    if ( sender_state == SENDER_DONE )
+    {
+        printf( " %4.1f kB/s", run->image_size / seconds / 1000 );
+    }
+    printf( ", %d resent, %ld overruns, watchdog gap %.0f ms%s\n", resends, overruns, max_kick_gap_us / 1000, passed ? "" : "  <-- FAIL" );
+    return passed;
+}
+
+int main( void )
+{
+    struct sigaction action;
+    int              failures = 0;
+    unsigned         i;
+
+    memset( &action, 0, sizeof( action ) );
+    action.sa_flags     = SA_SIGINFO;
+    action.sa_sigaction = flash_store_fault;
+    sigaction( SIGSEGV, &action, NULL );
+    action.sa_sigaction = flash_store_done;
+    sigaction( SIGTRAP, &action, NULL );
+
+    flash = mmap( (void*) FLASH_BASE_ADDRESS, FLASH_SIZE, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0 );
+    if ( flash != (uint8_t*) FLASH_BASE_ADDRESS )
+    {
+        printf( "FAIL: cannot map the flash at 0x%08X\n", FLASH_BASE_ADDRESS );
+        return 1;
+    }
+
+    srand( 7 );
+    for ( i = 0; i < sizeof( scenarios ) / sizeof( scenarios[ 0 ] ); i++ )
+    {
+        failures += !run_scenario( &scenarios[ i ] );
+    }
+
+    printf( ( failures != 0 ) ? "FAIL\n" : "PASS\n" );
+    return ( failures != 0 );
+}
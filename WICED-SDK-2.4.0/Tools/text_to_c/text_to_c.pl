@@ -12,10 +12,21 @@
 
 if (! $ARGV[0] )
 {
-	print "Usage ./text_to_c.pl  <variable name> <text file>";
+	print "Usage ./text_to_c.pl  [--gzip] <variable name> <text file>";
 	exit;
 }
 
+# Window size used when compressing. The HTTP server keeps a window of this size
+# (WICED_GZIP_RESOURCE_WINDOW_BITS in http_server.h) to decompress for clients without gzip support
+$gzip_window_bits = 11;
+
+$gzip = 0;
+if ( $ARGV[0] eq "--gzip" )
+{
+    $gzip = 1;
+    shift @ARGV;
+}
+
 # Print start of output
 $variable_name = shift @ARGV;
 $original_variable_name = $variable_name;
@@ -46,6 +57,26 @@ if ( ( $file =~ m/\.html$/sgi ) ||
 }
 
 
+if ( $gzip )
+{
+    if ( $variable_name ne $original_variable_name )
+    {
+        die "Can't compress " . $file . " as it is split into sections";
+    }
+
+    $compressed = gzip_string( $file_cont );
+    print STDERR "Compressed " . $file . ": " . length( $file_cont ) . " -> " . length( $compressed ) . " bytes\n";
+
+    print "/* gzip compressed, " . length( $file_cont ) . " bytes uncompressed */\n";
+    print "const unsigned char ${variable_name}[" . length( $compressed ) . "] = {";
+    for ( $i = 0; $i < length( $compressed ); $i++ )
+    {
+        print ( ( $i % 16 ) ? " " : "\n    " );
+        printf( "0x%02x,", ord( substr( $compressed, $i, 1 ) ) );
+    }
+    print "\n};\n";
+    exit;
+}
 
 print "const char ${variable_name}[" . (length( $file_cont )+1) . "] = ";
 while ( $file_cont =~ s/^(.*?\n)(.*)$/$2/sgi )
@@ -73,3 +104,20 @@ sub escape_string( $escstring )
   $escstring =~ s/\"/\\"/sgi;  # double quote
   return $escstring;
 }
+
+
+sub gzip_string( $string )
+{
+  my $string = shift;
+  require Compress::Raw::Zlib or die "Compressing resources requires the Compress::Raw::Zlib perl module";
+
+  my ( $deflater, $status ) = new Compress::Raw::Zlib::Deflate( -Level => 9, -WindowBits => -$gzip_window_bits, -AppendOutput => 1 );
+  $status == Compress::Raw::Zlib::Z_OK() or die "Can't initialise deflate: " . $status;
+
+  my $deflated = "";
+  $deflater->deflate( $string, $deflated ) == Compress::Raw::Zlib::Z_OK() or die "Can't deflate " . $file;
+  $deflater->flush( $deflated ) == Compress::Raw::Zlib::Z_OK() or die "Can't deflate " . $file;
+
+  # Minimal gzip header (no name or time, so output does not change between builds) and the CRC32 / size trailer
+  return pack( "C10", 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 2, 255 ) . $deflated . pack( "VV", Compress::Raw::Zlib::crc32( $string ), length( $string ) );
+}
@@ -56,6 +56,7 @@ typedef struct
     wiced_tls_context_t      context;
     wiced_tls_session_t      session;
     wiced_packet_t*          temp_packet;
+    microrng_state           rng_state;
 } wiced_tls_simple_context_t;
 
 typedef struct
@@ -64,6 +65,7 @@ typedef struct
     wiced_tls_context_t      context;
     wiced_tls_session_t      session;
     wiced_packet_t*          temp_packet;
+    microrng_state           rng_state;
     wiced_tls_certificate_t  certificate;
     wiced_tls_key_t          key;
 } wiced_tls_advanced_context_t;
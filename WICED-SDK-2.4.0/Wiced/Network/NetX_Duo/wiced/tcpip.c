@@ -101,7 +101,12 @@ wiced_result_t wiced_tcp_accept( wiced_tcp_socket_t* socket )
 
     WICED_LINK_CHECK( socket->socket.nx_tcp_socket_ip_ptr );
 
-    if ( socket->callbacks[WICED_TCP_CONNECT_CALLBACK_INDEX] == NULL )
+    if ( socket->socket.nx_tcp_socket_state == NX_TCP_SYN_RECEIVED )
+    {
+        /* A connection request queued on the port was attached when this socket was put into listen */
+        result = nx_tcp_server_socket_accept( &socket->socket, NX_TIMEOUT(WICED_TCP_ACCEPT_TIMEOUT) );
+    }
+    else if ( socket->callbacks[WICED_TCP_CONNECT_CALLBACK_INDEX] == NULL )
     {
         if ( socket->socket.nx_tcp_socket_state != NX_TCP_LISTEN_STATE )
         {
@@ -298,10 +303,11 @@ wiced_result_t wiced_tcp_listen( wiced_tcp_socket_t* socket, uint16_t port )
 {
     tcp_listen_callback_t listen_callback = NULL;
     struct NX_TCP_LISTEN_STRUCT* listen_ptr;
+    UINT result;
     WICED_LINK_CHECK( socket->socket.nx_tcp_socket_ip_ptr );
 
-    /* Check if there is already another socket listening on the port */
-    listen_ptr = IP_HANDLE(WICED_STA_INTERFACE).nx_ip_tcp_active_listen_requests;
+    /* Check if there is already another socket listening on the port of the interface this socket belongs to */
+    listen_ptr = socket->socket.nx_tcp_socket_ip_ptr->nx_ip_tcp_active_listen_requests;
     if ( listen_ptr != NULL )
     {
         /* Search the active listen requests for this port. */
@@ -310,8 +316,9 @@ wiced_result_t wiced_tcp_listen( wiced_tcp_socket_t* socket, uint16_t port )
             /* Determine if there is another listen request for the same port. */
             if ( listen_ptr->nx_tcp_listen_port == port )
             {
-                /* Do a re-listen instead of a listen */
-                if ( nx_tcp_server_socket_relisten( socket->socket.nx_tcp_socket_ip_ptr, port, &socket->socket ) == NX_SUCCESS )
+                /* Do a re-listen instead of a listen. A queued connection request may be attached to the socket straight away */
+                result = nx_tcp_server_socket_relisten( socket->socket.nx_tcp_socket_ip_ptr, port, &socket->socket );
+                if ( ( result == NX_SUCCESS ) || ( result == NX_CONNECTION_PENDING ) )
                 {
                     return WICED_SUCCESS;
                 }
@@ -321,7 +328,7 @@ wiced_result_t wiced_tcp_listen( wiced_tcp_socket_t* socket, uint16_t port )
                 }
             }
             listen_ptr = listen_ptr->nx_tcp_listen_next;
-        } while ( listen_ptr != IP_HANDLE(WICED_STA_INTERFACE).nx_ip_tcp_active_listen_requests);
+        } while ( listen_ptr != socket->socket.nx_tcp_socket_ip_ptr->nx_ip_tcp_active_listen_requests);
     }
 
     /* Check if this socket has an asynchronous connect callback */
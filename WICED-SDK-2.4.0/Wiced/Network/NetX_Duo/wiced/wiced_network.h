@@ -63,6 +63,7 @@ typedef struct
     wiced_tls_context_t      context;
     wiced_tls_session_t      session;
     wiced_packet_t*          temp_packet;
+    microrng_state           rng_state;
 } wiced_tls_simple_context_t;
 
 /* The advanced context contains a simple context but with additional certificate and key information */
@@ -72,6 +73,7 @@ typedef struct
     wiced_tls_context_t      context;
     wiced_tls_session_t      session;
     wiced_packet_t*          temp_packet;
+    microrng_state           rng_state;
     wiced_tls_certificate_t  certificate;
     wiced_tls_key_t          key;
 } wiced_tls_advanced_context_t;
@@ -2593,6 +2593,82 @@ wiced_result_t wiced_uart_receive_bytes( wiced_uart_t uart, void* data, uint32_t
     }
 }
 
+wiced_result_t wiced_uart_receive_available_bytes( wiced_uart_t uart, void* data, uint32_t* size, uint32_t timeout )
+{
+    uint32_t max_size = *size;
+
+    *size = 0;
+
+    if ( uart_interfaces[uart].rx_buffer == NULL )
+    {
+        /* Without a ring buffer only single byte DMA transfers are possible */
+        if ( max_size == 0 || wiced_uart_receive_bytes( uart, data, 1, timeout ) != WICED_SUCCESS )
+        {
+            return WICED_TIMEOUT;
+        }
+        *size = 1;
+        return WICED_SUCCESS;
+    }
+
+#ifdef BUILD_WIZFI250
+    if(GPIO_ReadOutputDataBit(uart_mapping[uart].pin_rts->bank,
+    (uint16_t) (1 << uart_mapping[uart].pin_rts->number))==Bit_SET
+    && ring_buffer_free_space(uart_interfaces[uart].rx_buffer)>30) {
+        GPIO_WriteBit(uart_mapping[uart].pin_rts->bank,
+         (uint16_t) (1 << uart_mapping[uart].pin_rts->number), Bit_RESET);
+    }
+#endif
+
+    /* Wait for the first byte only; whatever else has arrived is returned with it */
+    while ( ring_buffer_used_space( uart_interfaces[uart].rx_buffer ) == 0 )
+    {
+        uart_interfaces[uart].rx_size = 1;
+
+        /* Data may have arrived before rx_size was armed */
+        if ( ring_buffer_used_space( uart_interfaces[uart].rx_buffer ) != 0 )
+        {
+            uart_interfaces[uart].rx_size = 0;
+            break;
+        }
+
+        if ( host_rtos_get_semaphore( &uart_interfaces[uart].rx_complete, timeout, WICED_TRUE ) != WICED_SUCCESS )
+        {
+            uart_interfaces[uart].rx_size = 0;
+            return WICED_TIMEOUT;
+        }
+
+        uart_interfaces[uart].rx_size = 0;
+    }
+
+#ifdef BUILD_WIZFI250
+    if ( platfrom_spi_stdio_x!=platfrom_spi_stdio )
+    {
+        void quick_change_sdtio_mode(uint8_t mode);
+
+        if ( platfrom_spi_stdio==0 )    quick_change_sdtio_mode(platfrom_spi_stdio_x);
+    }
+#endif
+
+    /* The received span may wrap around the end of the ring buffer, so it takes at most two copies */
+    while ( *size < max_size )
+    {
+        uint8_t* available_data;
+        uint32_t bytes_available;
+
+        ring_buffer_get_data( uart_interfaces[uart].rx_buffer, &available_data, &bytes_available );
+        bytes_available = MIN( bytes_available, max_size - *size );
+        if ( bytes_available == 0 )
+        {
+            break;
+        }
+        memcpy( (uint8_t*) data + *size, available_data, bytes_available );
+        ring_buffer_consume( uart_interfaces[uart].rx_buffer, bytes_available );
+        *size += bytes_available;
+    }
+
+    return WICED_SUCCESS;
+}
+
 static wiced_result_t platform_uart_receive_bytes( wiced_uart_t uart, void* data, uint32_t size, uint32_t timeout )
 {
     uint32_t tmpvar; /* needed to ensure ordering of volatile accesses */
@@ -2706,6 +2782,14 @@ int platform_write_dct( uint16_t data_start_offset, const void* data, uint16_t d
         return -1;
     }
 
+    /* Leave the flash alone if the current DCT already holds this data and header */
+    if ( ( ( app_valid == -1 ) || ( (char) app_valid == curr_dct->app_valid ) ) &&
+         ( func == curr_dct->load_app_func ) &&
+         ( ( data_length == 0 ) || ( memcmp( (uint8_t*) &curr_dct[1] + data_start_offset, data, data_length ) == 0 ) ) )
+    {
+        return 0;
+    }
+
     /* Erase the non-current DCT */
     if ( curr_dct == ((platform_dct_header_t*)PLATFORM_DCT_COPY1_START_ADDRESS) )
     {
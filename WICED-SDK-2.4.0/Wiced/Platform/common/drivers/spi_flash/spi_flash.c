@@ -12,6 +12,29 @@
 #include "spi_flash_platform_interface.h"
 #include <string.h> /* for NULL */
 
+static int  sflash_send_command            ( const sflash_handle_t* const handle, sflash_command_t cmd, unsigned int num_initial_parameter_bytes, const void* const parameter_bytes, int num_data_bytes, const void* const data_MOSI, void* const data_MISO );
+static int  sflash_read_command            ( const sflash_handle_t* const handle, unsigned long device_address, void* const data_addr, unsigned int size, void* const ahead_addr, unsigned int ahead_size );
+static void sflash_read_cache_invalidate   ( unsigned long device_address, unsigned long size );
+static void sflash_read_cache_invalidate_all( void );
+
+static sflash_read_stats_t sflash_read_stats;
+
+#if ( SFLASH_READ_CACHE_LINES > 0 )
+#define SFLASH_READ_CACHE_EMPTY    ( 0xFFFFFFFFUL )
+
+static int          sflash_read_cached     ( const sflash_handle_t* const handle, unsigned long device_address, void* const data_addr, unsigned int size );
+static int          sflash_read_cache_find ( unsigned long device_address );
+static unsigned int sflash_read_cache_take ( unsigned int lines );
+
+/* Each line holds the bytes from the address it was filled at. Lines filled together sit next
+ * to each other, so one read command fills them all. */
+static unsigned long sflash_read_cache_address[ SFLASH_READ_CACHE_LINES ];
+static unsigned char sflash_read_cache_data[ SFLASH_READ_CACHE_LINES ][ SFLASH_READ_CACHE_LINE_SIZE ];
+static unsigned int  sflash_read_cache_victim;
+static void*         sflash_read_cache_peripheral;
+static unsigned long sflash_read_cache_next_address = SFLASH_READ_CACHE_EMPTY; /* Where the last read ended */
+#endif /* if ( SFLASH_READ_CACHE_LINES > 0 ) */
+
 int sflash_read_ID( const sflash_handle_t* const handle, void* const data_addr )
 {
     return generic_sflash_command( handle, SFLASH_READ_JEDEC_ID, 0, NULL, 3, NULL, data_addr );
@@ -65,9 +88,21 @@ int sflash_chip_erase( const sflash_handle_t* const handle )
     {
         return status;
     }
+    sflash_read_cache_invalidate_all( );
     return generic_sflash_command( handle, SFLASH_CHIP_ERASE1, 0, NULL, 0, NULL, NULL );
 }
 
+int sflash_chip_erase_start( const sflash_handle_t* const handle )
+{
+    int status = sflash_write_enable( handle );
+    if ( status != 0 )
+    {
+        return status;
+    }
+    sflash_read_cache_invalidate_all( );
+    return sflash_send_command( handle, SFLASH_CHIP_ERASE1, 0, NULL, 0, NULL, NULL );
+}
+
 #include "wwd_assert.h"
 
 int sflash_sector_erase ( const sflash_handle_t* const handle, unsigned long device_address )
@@ -83,11 +118,39 @@ int sflash_sector_erase ( const sflash_handle_t* const handle, unsigned long dev
     {
         return status;
     }
+    sflash_read_cache_invalidate( device_address & ~( (unsigned long) SFLASH_SECTOR_SIZE - 1 ), SFLASH_SECTOR_SIZE );
     retval = generic_sflash_command( handle, SFLASH_SECTOR_ERASE, 3, device_address_array, 0, NULL, NULL );
     wiced_assert("error", retval == 0);
     return retval;
 }
 
+int sflash_sector_erase_start( const sflash_handle_t* const handle, unsigned long device_address )
+{
+    char device_address_array[3] =  { ( ( device_address & 0x00FF0000 ) >> 16 ),
+                                      ( ( device_address & 0x0000FF00 ) >>  8 ),
+                                      ( ( device_address & 0x000000FF ) >>  0 ) };
+
+    int status = sflash_write_enable( handle );
+    if ( status != 0 )
+    {
+        return status;
+    }
+    sflash_read_cache_invalidate( device_address & ~( (unsigned long) SFLASH_SECTOR_SIZE - 1 ), SFLASH_SECTOR_SIZE );
+    return sflash_send_command( handle, SFLASH_SECTOR_ERASE, 3, device_address_array, 0, NULL, NULL );
+}
+
+int sflash_is_busy( const sflash_handle_t* const handle, int* const busy )
+{
+    unsigned char status_register;
+    int status = sflash_read_status_register( handle, &status_register );
+    if ( status != 0 )
+    {
+        return status;
+    }
+    *busy = ( ( status_register & SFLASH_STATUS_REGISTER_BUSY ) != 0 );
+    return 0;
+}
+
 int sflash_read_status_register( const sflash_handle_t* const handle, void* const dest_addr )
 {
     return generic_sflash_command( handle, SFLASH_READ_STATUS_REGISTER, 0, NULL, 1, NULL, dest_addr );
@@ -96,12 +159,214 @@ int sflash_read_status_register( const sflash_handle_t* const handle, void* cons
 
 
 int sflash_read( const sflash_handle_t* const handle, unsigned long device_address, void* const data_addr, unsigned int size )
+{
+    sflash_read_stats.bytes_requested += size;
+
+#if ( SFLASH_READ_CACHE_LINES > 0 )
+    return sflash_read_cached( handle, device_address, data_addr, size );
+#else
+    sflash_read_stats.misses++;
+    return sflash_read_command( handle, device_address, data_addr, size, NULL, 0 );
+#endif /* if ( SFLASH_READ_CACHE_LINES > 0 ) */
+}
+
+void sflash_get_read_stats( sflash_read_stats_t* const stats )
+{
+    *stats = sflash_read_stats;
+}
+
+void sflash_reset_read_stats( void )
+{
+    memset( &sflash_read_stats, 0, sizeof( sflash_read_stats ) );
+}
+
+/* Reads size bytes into data_addr, then carries on reading ahead_size bytes into ahead_addr */
+static int sflash_read_command( const sflash_handle_t* const handle, unsigned long device_address, void* const data_addr, unsigned int size, void* const ahead_addr, unsigned int ahead_size )
 {
     char device_address_array[3] =  { ( ( device_address & 0x00FF0000 ) >> 16 ),
                                       ( ( device_address & 0x0000FF00 ) >>  8 ),
                                       ( ( device_address & 0x000000FF ) >>  0 ) };
+    unsigned char* data_MISO_ptr = (unsigned char*) data_addr;
+    unsigned int   count;
+    int            status;
+
+    sflash_read_stats.read_commands++;
+    sflash_read_stats.bytes_transferred += size + ahead_size;
+
+    sflash_platform_chip_select( handle->platform_peripheral );
+
+    status = sflash_platform_send_recv_byte( handle->platform_peripheral, SFLASH_READ, NULL );
+    for ( count = 0; ( status == 0 ) && ( count < sizeof( device_address_array ) ); count++ )
+    {
+        status = sflash_platform_send_recv_byte( handle->platform_peripheral, device_address_array[ count ], NULL );
+    }
+    for ( count = 0; ( status == 0 ) && ( count < size + ahead_size ); count++ )
+    {
+        if ( count == size )
+        {
+            data_MISO_ptr = (unsigned char*) ahead_addr;
+        }
+        status = sflash_platform_send_recv_byte( handle->platform_peripheral, SFLASH_DUMMY_BYTE, data_MISO_ptr );
+        data_MISO_ptr++;
+    }
+
+    sflash_platform_chip_deselect( handle->platform_peripheral );
+
+    return status;
+}
+
+#if ( SFLASH_READ_CACHE_LINES > 0 )
+
+static int sflash_read_cached( const sflash_handle_t* const handle, unsigned long device_address, void* const data_addr, unsigned int size )
+{
+    unsigned char* data_addr_ptr = (unsigned char*) data_addr;
+    unsigned char  sequential    = ( device_address == sflash_read_cache_next_address );
+    unsigned int   lines;
+    unsigned int   first;
+    unsigned int   line;
+    int            status;
+
+    /* Only one chip is cached at a time */
+    if ( handle->platform_peripheral != sflash_read_cache_peripheral )
+    {
+        sflash_read_cache_invalidate_all( );
+        sflash_read_cache_peripheral = handle->platform_peripheral;
+    }
+    sflash_read_cache_next_address = device_address + size;
+
+    /* Take what the cache holds of the start of the read */
+    while ( size > 0 )
+    {
+        int          hit = sflash_read_cache_find( device_address );
+        unsigned int offset;
+        unsigned int chunk;
+
+        if ( hit < 0 )
+        {
+            break;
+        }
+        offset = (unsigned int) ( device_address - sflash_read_cache_address[ hit ] );
+        chunk  = SFLASH_READ_CACHE_LINE_SIZE - offset;
+        chunk  = ( size > chunk )? chunk : size;
+        memcpy( data_addr_ptr, &sflash_read_cache_data[ hit ][ offset ], chunk );
+        data_addr_ptr  += chunk;
+        device_address += chunk;
+        size           -= chunk;
+    }
+    if ( size == 0 )
+    {
+        sflash_read_stats.hits++;
+        return 0;
+    }
+    sflash_read_stats.misses++;
+
+    /* The rest takes one read command. A read carrying on from the last one is likely followed
+     * by more, so the lines after it are filled by the same command. */
+    lines = ( sequential )? SFLASH_READ_CACHE_READ_AHEAD : 0;
+
+    if ( size < SFLASH_READ_CACHE_LINE_SIZE )
+    {
+        /* Small enough to be read into a line and copied out */
+        lines = ( lines + 1 < SFLASH_READ_CACHE_LINES )? lines + 1 : SFLASH_READ_CACHE_LINES;
+        first = sflash_read_cache_take( lines );
+        if ( 0 != ( status = sflash_read_command( handle, device_address, sflash_read_cache_data[ first ], lines * SFLASH_READ_CACHE_LINE_SIZE, NULL, 0 ) ) )
+        {
+            return status;
+        }
+        memcpy( data_addr_ptr, sflash_read_cache_data[ first ], size );
+    }
+    else if ( lines == 0 )
+    {
+        return sflash_read_command( handle, device_address, data_addr_ptr, size, NULL, 0 );
+    }
+    else
+    {
+        lines = ( lines < SFLASH_READ_CACHE_LINES )? lines : SFLASH_READ_CACHE_LINES;
+        first = sflash_read_cache_take( lines );
+        if ( 0 != ( status = sflash_read_command( handle, device_address, data_addr_ptr, size, sflash_read_cache_data[ first ], lines * SFLASH_READ_CACHE_LINE_SIZE ) ) )
+        {
+            return status;
+        }
+        device_address += size;
+    }
 
-    return generic_sflash_command( handle, SFLASH_READ, 3, device_address_array, size, NULL, data_addr );
+    for ( line = 0; line < lines; line++ )
+    {
+        sflash_read_cache_address[ first + line ] = device_address + line * SFLASH_READ_CACHE_LINE_SIZE;
+    }
+    return 0;
+}
+
+static int sflash_read_cache_find( unsigned long device_address )
+{
+    int line;
+
+    for ( line = 0; line < SFLASH_READ_CACHE_LINES; line++ )
+    {
+        if ( ( sflash_read_cache_address[ line ] != SFLASH_READ_CACHE_EMPTY ) &&
+             ( device_address - sflash_read_cache_address[ line ] < SFLASH_READ_CACHE_LINE_SIZE ) )
+        {
+            return line;
+        }
+    }
+    return -1;
+}
+
+/* Empties the oldest filled run of lines long enough to be filled together and returns the first */
+static unsigned int sflash_read_cache_take( unsigned int lines )
+{
+    unsigned int first = sflash_read_cache_victim;
+    unsigned int line;
+
+    if ( first + lines > SFLASH_READ_CACHE_LINES )
+    {
+        first = 0;
+    }
+    sflash_read_cache_victim = ( first + lines ) % SFLASH_READ_CACHE_LINES;
+
+    for ( line = first; line < first + lines; line++ )
+    {
+        sflash_read_cache_address[ line ] = SFLASH_READ_CACHE_EMPTY;
+    }
+    return first;
+}
+
+#endif /* if ( SFLASH_READ_CACHE_LINES > 0 ) */
+
+/* Called before anything that changes the contents of the chip */
+static void sflash_read_cache_invalidate( unsigned long device_address, unsigned long size )
+{
+#if ( SFLASH_READ_CACHE_LINES > 0 )
+    int line;
+
+    for ( line = 0; line < SFLASH_READ_CACHE_LINES; line++ )
+    {
+        unsigned long line_address = sflash_read_cache_address[ line ];
+
+        if ( ( line_address != SFLASH_READ_CACHE_EMPTY ) &&
+             ( line_address < device_address + size ) &&
+             ( line_address + SFLASH_READ_CACHE_LINE_SIZE > device_address ) )
+        {
+            sflash_read_cache_address[ line ] = SFLASH_READ_CACHE_EMPTY;
+        }
+    }
+#else
+    (void) device_address;
+    (void) size;
+#endif /* if ( SFLASH_READ_CACHE_LINES > 0 ) */
+}
+
+static void sflash_read_cache_invalidate_all( void )
+{
+#if ( SFLASH_READ_CACHE_LINES > 0 )
+    int line;
+
+    for ( line = 0; line < SFLASH_READ_CACHE_LINES; line++ )
+    {
+        sflash_read_cache_address[ line ] = SFLASH_READ_CACHE_EMPTY;
+    }
+    sflash_read_cache_next_address = SFLASH_READ_CACHE_EMPTY;
+#endif /* if ( SFLASH_READ_CACHE_LINES > 0 ) */
 }
 
 
@@ -147,15 +412,24 @@ int sflash_write( const sflash_handle_t* const handle, unsigned long device_addr
         return -1;
     }
 
+    sflash_read_cache_invalidate( device_address, (unsigned long) size );
+
     /* Some manufacturers support programming an entire page in one command. */
 
 #ifdef SFLASH_SUPPORT_MACRONIX_PARTS
     if ( SFLASH_MANUFACTURER( handle->device_id ) == SFLASH_MANUFACTURER_MACRONIX )
     {
-        max_write_size = 1;  /* TODO: this should be 256, but that causes write errors */
+        max_write_size = SFLASH_PAGE_SIZE;
         enable_before_every_write = 1;
     }
 #endif /* ifdef SFLASH_SUPPORT_MACRONIX_PARTS */
+#ifdef SFLASH_SUPPORT_EON_PARTS
+    if ( SFLASH_MANUFACTURER( handle->device_id ) == SFLASH_MANUFACTURER_EON )
+    {
+        max_write_size = SFLASH_PAGE_SIZE;
+        enable_before_every_write = 1;
+    }
+#endif /* ifdef SFLASH_SUPPORT_EON_PARTS */
 #ifdef SFLASH_SUPPORT_SST_PARTS
     if ( SFLASH_MANUFACTURER( handle->device_id ) == SFLASH_MANUFACTURER_SST )
     {
@@ -175,7 +449,11 @@ int sflash_write( const sflash_handle_t* const handle, unsigned long device_addr
 
     while ( size > 0 )
     {
-        write_size = ( size > max_write_size )? max_write_size : size;
+        /* A program command must not cross a page boundary, otherwise the part wraps
+         * around and overwrites the start of the page. This splits off the partial
+         * leading page of an unaligned write and keeps the rest page aligned. */
+        write_size = max_write_size - (int) ( device_address % max_write_size );
+        write_size = ( size > write_size )? write_size : size;
         curr_device_address[0] = ( ( device_address & 0x00FF0000 ) >> 16 );
         curr_device_address[1] = ( ( device_address & 0x0000FF00 ) >>  8 );
         curr_device_address[2] = ( ( device_address & 0x000000FF ) >>  0 );
@@ -241,6 +519,9 @@ int init_sflash( sflash_handle_t* const handle, int peripheral_id, sflash_write_
 
     handle->write_allowed = write_allowed_in;
 
+    /* The chip may have been written by someone else since anything was cached */
+    sflash_read_cache_invalidate_all( );
+
     if ( write_allowed_in == SFLASH_WRITE_ALLOWED )
     {
         /* Enable writing */
@@ -259,9 +540,6 @@ int init_sflash( sflash_handle_t* const handle, int peripheral_id, sflash_write_
 int generic_sflash_command( const sflash_handle_t* const handle, sflash_command_t cmd, unsigned int num_initial_parameter_bytes, const void* const parameter_bytes, int num_data_bytes, const void* const data_MOSI, void* const data_MISO )
 {
     int status;
-    unsigned char* data_MISO_ptr = (unsigned char*) data_MISO;
-    unsigned char* data_MOSI_ptr = (unsigned char*) data_MOSI;
-    unsigned char* parameter_bytes_ptr = (unsigned char*) parameter_bytes;
     char is_write_command = ( ( cmd == SFLASH_WRITE ) ||
             ( cmd == SFLASH_CHIP_ERASE1 ) ||
             ( cmd == SFLASH_CHIP_ERASE2 ) ||
@@ -269,6 +547,37 @@ int generic_sflash_command( const sflash_handle_t* const handle, sflash_command_
             ( cmd == SFLASH_BLOCK_ERASE_MID ) ||
             ( cmd == SFLASH_BLOCK_ERASE_LARGE ) );
 
+    if ( 0 != ( status = sflash_send_command( handle, cmd, num_initial_parameter_bytes, parameter_bytes, num_data_bytes, data_MOSI, data_MISO ) ) )
+    {
+        return status;
+    }
+
+    if ( is_write_command )
+    {
+        unsigned char status_register;
+        /* write commands require waiting until chip is finished writing */
+
+        do
+        {
+            if ( 0 != ( status = sflash_read_status_register( handle, &status_register ) ) )
+            {
+                return status;
+            }
+        } while( ( status_register & SFLASH_STATUS_REGISTER_BUSY ) != 0 );
+
+    }
+
+    return 0;
+}
+
+/* Sends a command without waiting for the chip to finish a write or erase it starts */
+static int sflash_send_command( const sflash_handle_t* const handle, sflash_command_t cmd, unsigned int num_initial_parameter_bytes, const void* const parameter_bytes, int num_data_bytes, const void* const data_MOSI, void* const data_MISO )
+{
+    int status;
+    unsigned char* data_MISO_ptr = (unsigned char*) data_MISO;
+    unsigned char* data_MOSI_ptr = (unsigned char*) data_MOSI;
+    unsigned char* parameter_bytes_ptr = (unsigned char*) parameter_bytes;
+
     sflash_platform_chip_select( handle->platform_peripheral );
 
     if ( 0 != ( status = sflash_platform_send_recv_byte( handle->platform_peripheral, cmd, NULL ) ) )
@@ -309,21 +618,6 @@ int generic_sflash_command( const sflash_handle_t* const handle, sflash_command_
 
     sflash_platform_chip_deselect( handle->platform_peripheral );
 
-    if ( is_write_command )
-    {
-        unsigned char status_register;
-        /* write commands require waiting until chip is finished writing */
-
-        do
-        {
-            if ( 0 != ( status = sflash_read_status_register( handle, &status_register ) ) )
-            {
-                return status;
-            }
-        } while( ( status_register & SFLASH_STATUS_REGISTER_BUSY ) != 0 );
-
-    }
-
     return 0;
 }
 
@@ -16,7 +16,21 @@
 
 #include <stdint.h>
 
+/* Read cache. Reads shorter than a line are served from lines each filled by one read command,
+ * saving the command and address overhead of every small read. Off unless the build sets
+ * SFLASH_READ_CACHE_LINES; it costs SFLASH_READ_CACHE_LINES * SFLASH_READ_CACHE_LINE_SIZE bytes of RAM. */
+#ifndef SFLASH_READ_CACHE_LINES
+#define SFLASH_READ_CACHE_LINES         ( 0 )
+#endif
+
+#ifndef SFLASH_READ_CACHE_LINE_SIZE
+#define SFLASH_READ_CACHE_LINE_SIZE     ( 32 )
+#endif
 
+/* Extra lines filled by a miss that carries on from where the previous read ended */
+#ifndef SFLASH_READ_CACHE_READ_AHEAD
+#define SFLASH_READ_CACHE_READ_AHEAD    ( 1 )
+#endif
 
 typedef enum
 {
@@ -32,6 +46,16 @@ typedef struct
     sflash_write_allowed_t write_allowed;
 } sflash_handle_t;
 
+/* Kept whether or not the cache is enabled. Throughput is bytes_requested over the caller's own
+ * elapsed time; bytes_transferred against bytes_requested shows what the read-ahead costs. */
+typedef struct
+{
+    uint32_t hits;              /* Reads served without a read command */
+    uint32_t misses;            /* Reads that sent at least one read command */
+    uint32_t read_commands;
+    uint32_t bytes_requested;
+    uint32_t bytes_transferred; /* Read from the chip, including line fills and read-ahead */
+} sflash_read_stats_t;
 
 
 int init_sflash         (       sflash_handle_t* const handle, int peripheral_id, sflash_write_allowed_t write_allowed );
@@ -41,6 +65,15 @@ int sflash_chip_erase   ( const sflash_handle_t* const handle );
 int sflash_sector_erase ( const sflash_handle_t* const handle, unsigned long device_address );
 int sflash_get_size     ( const sflash_handle_t* const handle, unsigned long* size );
 
+/* Start an erase and return while the chip is still busy; poll sflash_is_busy() for completion.
+ * Nothing else may be sent to the chip until it is no longer busy. */
+int sflash_chip_erase_start   ( const sflash_handle_t* const handle );
+int sflash_sector_erase_start ( const sflash_handle_t* const handle, unsigned long device_address );
+int sflash_is_busy            ( const sflash_handle_t* const handle, int* const busy );
+
+void sflash_get_read_stats    ( sflash_read_stats_t* const stats );
+void sflash_reset_read_stats  ( void );
+
 
 
 
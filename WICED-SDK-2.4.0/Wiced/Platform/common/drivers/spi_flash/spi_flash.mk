@@ -12,6 +12,11 @@ NAME := SPI_Flash_Library_$(PLATFORM)
 
 $(NAME)_SOURCES := spi_flash.c $(PLATFORM_FULL).c
 
-$(NAME)_DEFINES += SFLASH_SUPPORT_SST_PARTS SFLASH_SUPPORT_MACRONIX_PARTS
+# Background erases need a timer and a worker thread
+ifneq ($(RTOS),NoOS)
+$(NAME)_SOURCES += spi_flash_async.c
+endif
+
+$(NAME)_DEFINES += SFLASH_SUPPORT_SST_PARTS SFLASH_SUPPORT_MACRONIX_PARTS SFLASH_SUPPORT_EON_PARTS
 
 GLOBAL_INCLUDES := .
\ No newline at end of file
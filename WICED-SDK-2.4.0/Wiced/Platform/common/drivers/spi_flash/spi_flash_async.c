@@ -0,0 +1,280 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+
+/** @file
+ *  Serial flash erases that do not block the caller
+ *
+ *  A sector erase takes tens to hundreds of milliseconds and a chip erase
+ *  several seconds. Rather than spin on the status register for that long,
+ *  the erase is started and a timer on a worker thread checks the status
+ *  register until the chip is done, then calls the requester back.
+ */
+
+#include <string.h>
+#include "wiced_rtos.h"
+#include "spi_flash.h"
+#include "spi_flash_async.h"
+
+/******************************************************
+ *               Static Function Declarations
+ ******************************************************/
+static wiced_result_t sflash_async_queue     ( sflash_async_t* async, sflash_async_erase_t* request );
+static void           sflash_async_start_next( sflash_async_t* async );
+static wiced_bool_t   sflash_async_erasing   ( sflash_async_t* async );
+static wiced_result_t sflash_async_poll      ( void* arg );
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+wiced_result_t sflash_async_init( sflash_async_t* async, const sflash_handle_t* handle, wiced_worker_thread_t* worker_thread )
+{
+    memset( async, 0, sizeof( *async ) );
+    async->handle = handle;
+
+    if ( wiced_rtos_init_mutex( &async->mutex ) != WICED_SUCCESS )
+    {
+        return WICED_ERROR;
+    }
+
+    /* Only runs while there is an erase to watch */
+    if ( wiced_rtos_register_timed_event( &async->poll_event, worker_thread, sflash_async_poll, SFLASH_ASYNC_POLL_MS, async ) != WICED_SUCCESS )
+    {
+        wiced_rtos_deinit_mutex( &async->mutex );
+        return WICED_ERROR;
+    }
+    wiced_rtos_stop_timer( &async->poll_event.timer );
+
+    return WICED_SUCCESS;
+}
+
+/* Waits for the erase in progress and its callback; those still queued are dropped without their
+ * callbacks being called. Must not be called from a callback. */
+wiced_result_t sflash_async_deinit( sflash_async_t* async )
+{
+    wiced_rtos_lock_mutex( &async->mutex );
+    async->waiting++;
+    async->head = NULL;
+    async->tail = NULL;
+    while ( ( async->active != NULL ) || ( async->completing == WICED_TRUE ) )
+    {
+        wiced_rtos_unlock_mutex( &async->mutex );
+        wiced_rtos_delay_milliseconds( SFLASH_ASYNC_POLL_MS );
+        wiced_rtos_lock_mutex( &async->mutex );
+    }
+    wiced_rtos_deregister_timed_event( &async->poll_event );
+    wiced_rtos_unlock_mutex( &async->mutex );
+
+    wiced_rtos_deinit_mutex( &async->mutex );
+    return WICED_SUCCESS;
+}
+
+wiced_result_t sflash_async_sector_erase( sflash_async_t* async, sflash_async_erase_t* request, unsigned long device_address, sflash_async_callback_t callback, void* arg )
+{
+    request->device_address = device_address;
+    request->chip           = WICED_FALSE;
+    request->callback       = callback;
+    request->arg            = arg;
+    return sflash_async_queue( async, request );
+}
+
+wiced_result_t sflash_async_chip_erase( sflash_async_t* async, sflash_async_erase_t* request, sflash_async_callback_t callback, void* arg )
+{
+    request->device_address = 0;
+    request->chip           = WICED_TRUE;
+    request->callback       = callback;
+    request->arg            = arg;
+    return sflash_async_queue( async, request );
+}
+
+wiced_result_t sflash_async_cancel( sflash_async_t* async, sflash_async_erase_t* request )
+{
+    sflash_async_erase_t** link;
+    sflash_async_erase_t*  previous = NULL;
+
+    wiced_rtos_lock_mutex( &async->mutex );
+    for ( link = &async->head; *link != NULL; link = &(*link)->next )
+    {
+        if ( *link == request )
+        {
+            *link = request->next;
+            if ( async->tail == request )
+            {
+                async->tail = previous;
+            }
+            wiced_rtos_unlock_mutex( &async->mutex );
+            return WICED_SUCCESS;
+        }
+        previous = *link;
+    }
+    wiced_rtos_unlock_mutex( &async->mutex );
+    return WICED_NOTFOUND;
+}
+
+void sflash_async_lock( sflash_async_t* async )
+{
+    wiced_rtos_lock_mutex( &async->mutex );
+
+    /* The chip itself is asked rather than waiting for the timer to notice, so this also works
+     * from a callback running on the worker thread */
+    async->waiting++;
+    while ( sflash_async_erasing( async ) == WICED_TRUE )
+    {
+        wiced_rtos_unlock_mutex( &async->mutex );
+        wiced_rtos_delay_milliseconds( SFLASH_ASYNC_POLL_MS );
+        wiced_rtos_lock_mutex( &async->mutex );
+    }
+    async->waiting--;
+}
+
+void sflash_async_unlock( sflash_async_t* async )
+{
+    if ( ( async->active == NULL ) && ( async->waiting == 0 ) )
+    {
+        sflash_async_start_next( async );
+    }
+    wiced_rtos_unlock_mutex( &async->mutex );
+}
+
+int sflash_async_read( sflash_async_t* async, unsigned long device_address, void* const data_addr, unsigned int size )
+{
+    int status;
+
+    sflash_async_lock( async );
+    status = sflash_read( async->handle, device_address, data_addr, size );
+    sflash_async_unlock( async );
+    return status;
+}
+
+int sflash_async_write( sflash_async_t* async, unsigned long device_address, const void* const data_addr, int size )
+{
+    int status;
+
+    sflash_async_lock( async );
+    status = sflash_write( async->handle, device_address, data_addr, size );
+    sflash_async_unlock( async );
+    return status;
+}
+
+static wiced_result_t sflash_async_queue( sflash_async_t* async, sflash_async_erase_t* request )
+{
+    request->next   = NULL;
+    request->status = 0;
+
+    wiced_rtos_lock_mutex( &async->mutex );
+    if ( async->tail == NULL )
+    {
+        async->head = request;
+    }
+    else
+    {
+        async->tail->next = request;
+    }
+    async->tail = request;
+
+    if ( ( async->active == NULL ) && ( async->waiting == 0 ) )
+    {
+        sflash_async_start_next( async );
+    }
+    if ( async->polling == WICED_FALSE )
+    {
+        wiced_rtos_start_timer( &async->poll_event.timer );
+        async->polling = WICED_TRUE;
+    }
+    wiced_rtos_unlock_mutex( &async->mutex );
+    return WICED_SUCCESS;
+}
+
+/* Called with the mutex held and no erase in progress */
+static void sflash_async_start_next( sflash_async_t* async )
+{
+    sflash_async_erase_t* request = async->head;
+
+    if ( request == NULL )
+    {
+        return;
+    }
+    async->head = request->next;
+    if ( async->head == NULL )
+    {
+        async->tail = NULL;
+    }
+
+    /* A failure to start is reported by the next poll */
+    if ( request->chip == WICED_TRUE )
+    {
+        request->status = sflash_chip_erase_start( async->handle );
+    }
+    else
+    {
+        request->status = sflash_sector_erase_start( async->handle, request->device_address );
+    }
+    async->active = request;
+}
+
+/* Called with the mutex held */
+static wiced_bool_t sflash_async_erasing( sflash_async_t* async )
+{
+    int busy = 0;
+
+    if ( ( async->active == NULL ) || ( async->active->status != 0 ) )
+    {
+        return WICED_FALSE;
+    }
+    if ( sflash_is_busy( async->handle, &busy ) != 0 )
+    {
+        return WICED_FALSE;
+    }
+    return ( busy != 0 ) ? WICED_TRUE : WICED_FALSE;
+}
+
+static wiced_result_t sflash_async_poll( void* arg )
+{
+    sflash_async_t*       async = (sflash_async_t*) arg;
+    sflash_async_erase_t* done  = NULL;
+    int                   busy  = 0;
+
+    wiced_rtos_lock_mutex( &async->mutex );
+    if ( async->active != NULL )
+    {
+        if ( async->active->status == 0 )
+        {
+            async->active->status = sflash_is_busy( async->handle, &busy );
+        }
+        if ( busy == 0 )
+        {
+            done = async->active;
+            async->active = NULL;
+            async->completing = WICED_TRUE;
+        }
+    }
+
+    /* Threads waiting for the chip go before the next erase; sflash_async_unlock() starts it */
+    if ( ( async->active == NULL ) && ( async->waiting == 0 ) )
+    {
+        sflash_async_start_next( async );
+    }
+    if ( ( async->active == NULL ) && ( async->head == NULL ) )
+    {
+        wiced_rtos_stop_timer( &async->poll_event.timer );
+        async->polling = WICED_FALSE;
+    }
+    wiced_rtos_unlock_mutex( &async->mutex );
+
+    if ( done != NULL )
+    {
+        done->callback( done->arg, done->status );
+
+        wiced_rtos_lock_mutex( &async->mutex );
+        async->completing = WICED_FALSE;
+        wiced_rtos_unlock_mutex( &async->mutex );
+    }
+    return WICED_SUCCESS;
+}
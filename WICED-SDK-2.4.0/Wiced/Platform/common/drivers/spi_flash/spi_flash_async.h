@@ -0,0 +1,90 @@
+/*
+ * Copyright 2013, Broadcom Corporation
+ * All Rights Reserved.
+ *
+ * This is UNPUBLISHED PROPRIETARY SOURCE CODE of Broadcom Corporation;
+ * the contents of this file may not be disclosed to third parties, copied
+ * or duplicated in any form, in whole or in part, without the prior
+ * written permission of Broadcom Corporation.
+ */
+#ifndef INCLUDED_SPI_FLASH_ASYNC_H
+#define INCLUDED_SPI_FLASH_ASYNC_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "wiced_rtos.h"
+#include "spi_flash.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+/* How often the status register of the chip is read while an erase runs */
+#ifndef SFLASH_ASYNC_POLL_MS
+#define SFLASH_ASYNC_POLL_MS    ( 5 )
+#endif
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/* Called on the worker thread once the erase has finished; status is 0 on success */
+typedef void (*sflash_async_callback_t)( void* arg, int status );
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/* A queued erase. Owned by the caller and must stay valid until its callback is called */
+typedef struct sflash_async_erase_struct
+{
+    struct sflash_async_erase_struct* next;
+    unsigned long                     device_address;
+    wiced_bool_t                      chip;
+    int                               status;
+    sflash_async_callback_t           callback;
+    void*                             arg;
+} sflash_async_erase_t;
+
+typedef struct
+{
+    const sflash_handle_t* handle;
+    wiced_mutex_t          mutex;
+    wiced_timed_event_t    poll_event;
+    wiced_bool_t           polling;
+    wiced_bool_t           completing;  /* A callback is running */
+    uint32_t               waiting;     /* Threads in sflash_async_lock(); no new erase starts while non-zero */
+    sflash_async_erase_t*  active;      /* Erase the chip is busy with */
+    sflash_async_erase_t*  head;
+    sflash_async_erase_t*  tail;
+} sflash_async_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/* Erases run one at a time in the background. Between two erases the chip is handed to any
+ * thread waiting in sflash_async_lock(), so reads and writes are interleaved with a long queue
+ * of erases rather than held up behind all of them. */
+wiced_result_t sflash_async_init        ( sflash_async_t* async, const sflash_handle_t* handle, wiced_worker_thread_t* worker_thread );
+wiced_result_t sflash_async_deinit      ( sflash_async_t* async );
+wiced_result_t sflash_async_sector_erase( sflash_async_t* async, sflash_async_erase_t* request, unsigned long device_address, sflash_async_callback_t callback, void* arg );
+wiced_result_t sflash_async_chip_erase  ( sflash_async_t* async, sflash_async_erase_t* request, sflash_async_callback_t callback, void* arg );
+
+/* Removes an erase that has not started yet, whose callback is then never called.
+ * Returns WICED_NOTFOUND once the erase has started; its callback is still called. */
+wiced_result_t sflash_async_cancel      ( sflash_async_t* async, sflash_async_erase_t* request );
+
+/* Waits for the erase in progress, if any, and takes the chip for direct sflash_xxx() calls */
+void           sflash_async_lock        ( sflash_async_t* async );
+void           sflash_async_unlock      ( sflash_async_t* async );
+int            sflash_async_read        ( sflash_async_t* async, unsigned long device_address, void* const data_addr, unsigned int size );
+int            sflash_async_write       ( sflash_async_t* async, unsigned long device_address, const void* const data_addr, int size );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INCLUDED_SPI_FLASH_ASYNC_H */
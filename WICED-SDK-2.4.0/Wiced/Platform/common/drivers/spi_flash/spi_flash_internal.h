@@ -68,6 +68,13 @@ typedef enum
 
 #define SFLASH_MANUFACTURER_SST        ( 0xBF )
 #define SFLASH_MANUFACTURER_MACRONIX   ( 0xC2 )
+#define SFLASH_MANUFACTURER_EON        ( 0x1C )
+
+/* Page program (0x02) writes at most one page and wraps to the start of the page past its end */
+#define SFLASH_PAGE_SIZE               ( 256 )
+
+/* Sector erase (0x20) clears this many bytes */
+#define SFLASH_SECTOR_SIZE             ( 4096 )
 
 #define SFLASH_ID_MX25L8006E           ( 0xC22014 )
 #define SFLASH_ID_SST25VF080B          ( 0xBF258E )
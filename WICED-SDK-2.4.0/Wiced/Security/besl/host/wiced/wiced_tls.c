@@ -470,31 +470,69 @@ wiced_result_t wiced_tcp_enable_tls( wiced_tcp_socket_t* socket, void* context )
 
 wiced_result_t wiced_tcp_start_tls(wiced_tcp_socket_t* socket, wiced_tls_endpoint_type_t type, wiced_tls_certificate_verification_t verification )
 {
-    microrng_state              rngstate;
     wiced_tls_simple_context_t* tls_context = (wiced_tls_simple_context_t*)socket->tls_context;
     int                         prev_state;
     wiced_time_t                start_time;
+    wiced_result_t              result;
+
+    if ( wiced_tcp_start_tls_async( socket, type, verification ) != WICED_SUCCESS )
+    {
+        return WICED_ERROR;
+    }
+
+    prev_state = 0;
+    start_time = host_rtos_get_time();
+    while ( ( result = wiced_tcp_tls_handshake_step( socket ) ) == WICED_PENDING )
+    {
+        // break out if stuck
+#define MAX_HANDSHAKE_WAIT  10000
+        wiced_time_t curr_time = host_rtos_get_time();
+        if ( curr_time - start_time > MAX_HANDSHAKE_WAIT )
+        {
+            WPRINT_SECURITY_INFO(( "Timeout in SSL handshake\r\n" ));
+            wiced_tcp_tls_handshake_abort( socket );
+            return WICED_ERROR;
+        }
+
+        // if no state change then wait on client
+        if ( prev_state == tls_context->context.state )
+        {
+            host_rtos_delay_milliseconds( 10 );
+        }
+        else // otherwise process next state with no delay
+        {
+            prev_state = tls_context->context.state;
+        }
+    }
+
+    return result;
+}
+
+/* Sets up the handshake without running any of it; wiced_tcp_tls_handshake_step() does that */
+wiced_result_t wiced_tcp_start_tls_async( wiced_tcp_socket_t* socket, wiced_tls_endpoint_type_t type, wiced_tls_certificate_verification_t verification )
+{
+    wiced_tls_simple_context_t* tls_context = (wiced_tls_simple_context_t*)socket->tls_context;
 
     /* Initialize the session data */
     memset( &tls_context->session, 0, sizeof(wiced_tls_session_t) );
     memset( &tls_context->context, 0, sizeof(wiced_tls_context_t) );
 
-    /* Prepare session and entropy */
+    /* Prepare session and entropy. The RNG state lives in the context because the handshake may span several calls */
     tls_context->session.age = MAX_TLS_SESSION_AGE;
-    wiced_wifi_get_random((uint16_t*)&rngstate.entropy);
-    wiced_wifi_get_random(((uint16_t*)&rngstate.entropy)+1);
+    wiced_wifi_get_random((uint16_t*)&tls_context->rng_state.entropy);
+    wiced_wifi_get_random(((uint16_t*)&tls_context->rng_state.entropy)+1);
 
     /* Initialize session context */ // TODO: Ideally this should be done once for a socket
     if ( ssl_init( &tls_context->context ) != 0 )
     {
         wiced_assert("Error initialising SSL", 0!=0 );
-        goto exit;
+        return WICED_ERROR;
     }
 
-    microrng_init( &rngstate );
+    microrng_init( &tls_context->rng_state );
 
     ssl_set_endpoint( &tls_context->context, type );
-    ssl_set_rng     ( &tls_context->context, microrng_rand, &rngstate );
+    ssl_set_rng     ( &tls_context->context, microrng_rand, &tls_context->rng_state );
     tls_context->context.receive_context = socket;
     tls_context->context.send_context    = socket;
     tls_context->context.get_session     = tls_get_session;
@@ -525,54 +563,42 @@ wiced_result_t wiced_tcp_start_tls(wiced_tcp_socket_t* socket, wiced_tls_endpoin
 #endif
     }
 
-    prev_state = 0;
-    start_time = host_rtos_get_time();
-    do
+    return WICED_SUCCESS;
+}
+
+/* Runs the handshake as far as the data received so far allows.
+ * Returns WICED_PENDING until the handshake is over; on an error the context is already freed. */
+wiced_result_t wiced_tcp_tls_handshake_step( wiced_tcp_socket_t* socket )
+{
+    wiced_tls_simple_context_t* tls_context = (wiced_tls_simple_context_t*)socket->tls_context;
+    uint32_t                    result;
+
+    if ( tls_context->context.endpoint == WICED_TLS_AS_SERVER )
     {
-        if (type == WICED_TLS_AS_SERVER)
-        {
-            if ( ssl_handshake_server_async( &tls_context->context ) != 0 )
-            {
-                WPRINT_SECURITY_INFO(( "Error with TLS handshake\r\n" ));
-                goto exit_with_inited_context;
-            }
-        }
-        else
-        {
-            if ( ssl_handshake_client_async( &tls_context->context ) != 0 )
-            {
-                WPRINT_SECURITY_INFO(( "Error with TLS handshake\r\n" ));
-                goto exit_with_inited_context;
-            }
-        }
+        result = ssl_handshake_server_async( &tls_context->context );
+    }
+    else
+    {
+        result = ssl_handshake_client_async( &tls_context->context );
+    }
 
-        // break out if stuck
-#define MAX_HANDSHAKE_WAIT  10000
-        wiced_time_t curr_time = host_rtos_get_time();
-        if ( curr_time - start_time > MAX_HANDSHAKE_WAIT )
-        {
-            WPRINT_SECURITY_INFO(( "Timeout in SSL handshake\r\n" ));
-            goto exit_with_inited_context;
-        }
+    if ( result != 0 )
+    {
+        WPRINT_SECURITY_INFO(( "Error with TLS handshake\r\n" ));
+        wiced_tcp_tls_handshake_abort( socket );
+        return WICED_ERROR;
+    }
 
-        // if no state change then wait on client
-        if ( prev_state == tls_context->context.state )
-        {
-            host_rtos_delay_milliseconds( 10 );
-        }
-        else // otherwise process next state with no delay
-        {
-            prev_state = tls_context->context.state;
-        }
-    } while ( tls_context->context.state != SSL_HANDSHAKE_OVER );
+    return ( tls_context->context.state == SSL_HANDSHAKE_OVER ) ? WICED_SUCCESS : WICED_PENDING;
+}
 
-    return WICED_SUCCESS;
+/* Gives up on a handshake started by wiced_tcp_start_tls_async() that is still pending */
+void wiced_tcp_tls_handshake_abort( wiced_tcp_socket_t* socket )
+{
+    wiced_tls_simple_context_t* tls_context = (wiced_tls_simple_context_t*)socket->tls_context;
 
-exit_with_inited_context:
     ssl_close_notify( &tls_context->context );
-    ssl_free(&tls_context->context);
-exit:
-    return WICED_ERROR;
+    ssl_free( &tls_context->context );
 }
 
 
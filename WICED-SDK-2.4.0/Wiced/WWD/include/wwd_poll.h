@@ -48,6 +48,20 @@ extern "C"
 extern int8_t wiced_send_one_packet( void )  /*@modifies internalState @*/;
 
 
+/** Sends queued packets until the queue is empty or the bus credits run out
+ *
+ * Drains the send queue in one pass, bringing the WLAN bus up once for
+ * the whole batch rather than once per packet.
+ *
+ * This function is normally used by the Wiced Thread, but can be
+ * called periodically by systems which have no RTOS to ensure
+ * packets get sent.
+ *
+ * @return    The number of packets sent
+ */
+extern uint32_t wiced_send_queued_packets( void )  /*@modifies internalState @*/;
+
+
 /** Receives a packet if one is waiting
  *
  * Checks the wifi chip fifo to determine if there is any packets waiting
@@ -66,7 +80,7 @@ extern int8_t wiced_receive_one_packet( void )  /*@modifies internalState @*/;
 
 /** Sends and Receives all waiting packets
  *
- * Repeatedly calls wiced_send_one_packet and wiced_receive_one_packet
+ * Repeatedly calls wiced_send_queued_packets and wiced_receive_one_packet
  * to send and receive packets, until there are no more packets waiting to
  * be transferred.
  *
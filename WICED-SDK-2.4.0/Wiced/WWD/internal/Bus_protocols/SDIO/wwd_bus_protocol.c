@@ -517,6 +517,38 @@ uint32_t wiced_bus_process_interrupt(void)
     return WICED_SUCCESS;
 }
 
+/*
+ * Reads the next piece of a superframe which has been announced by a glom descriptor.
+ * The F2 FIFO streams the superframe, so it may be read with several CMD53s as long as
+ * every piece but the last is a whole number of blocks.
+ * Passing a NULL data pointer drops the rest of the superframe from the WLAN FIFO instead.
+ */
+wiced_result_t wiced_read_superframe( /*@null@*/ /*@out@*/ uint8_t* data, uint16_t size )
+{
+    wiced_result_t result;
+
+    /* Ensure the wlan backplane bus is up */
+    if ( wiced_bus_ensure_wlan_bus_is_up() != WICED_SUCCESS )
+    {
+        return WICED_ERROR;
+    }
+
+    if ( data == NULL )
+    {
+        wiced_abort_read( WICED_FALSE );
+        return WICED_ERROR;
+    }
+
+    result = wiced_sdio_transfer( BUS_READ, WLAN_FUNCTION, 0, size, data, RESPONSE_NEEDED );
+    if ( result != WICED_SUCCESS )
+    {
+        wiced_abort_read( WICED_FALSE );
+        return WICED_ERROR;
+    }
+
+    return WICED_SUCCESS;
+}
+
 
 
 /******************************************************
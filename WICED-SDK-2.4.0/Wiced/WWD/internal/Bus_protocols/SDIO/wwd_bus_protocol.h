@@ -27,6 +27,7 @@
 
 #define WICED_BUS_PACKET_AVAILABLE_TO_READ(intstatus)     ((intstatus) & (FRAME_AVAILABLE_MASK))
 #define WICED_BUS_USE_STATUS_REPORT_SCHEME                (0)
+#define WICED_BUS_SUPPORTS_RX_GLOM                        (1)
 
 /******************************************************
  *             Function declarations
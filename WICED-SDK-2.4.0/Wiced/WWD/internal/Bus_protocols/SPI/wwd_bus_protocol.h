@@ -38,6 +38,7 @@ typedef struct
 
 #define WICED_BUS_PACKET_AVAILABLE_TO_READ(intstatus)    ((intstatus) & (F2_PACKET_AVAILABLE))
 #define WICED_BUS_USE_STATUS_REPORT_SCHEME               (1)
+#define WICED_BUS_SUPPORTS_RX_GLOM                       (0)
 
 /******************************************************
  *             Function declarations
@@ -64,6 +64,9 @@ extern wiced_result_t  wiced_bus_transfer_bytes  ( bus_transfer_direction_t dire
 
 /* Frame transfer function */
 extern /*@only@*/ /*@null@*/ wiced_result_t wiced_read_frame( wiced_buffer_t* buffer );
+#if WICED_BUS_SUPPORTS_RX_GLOM
+extern wiced_result_t wiced_read_superframe( /*@null@*/ /*@out@*/ uint8_t* data, uint16_t size );
+#endif /* if WICED_BUS_SUPPORTS_RX_GLOM */
 
 /* Bus energy saving functions */
 extern wiced_result_t wiced_bus_allow_wlan_bus_to_sleep( void );
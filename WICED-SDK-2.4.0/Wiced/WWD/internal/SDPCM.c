@@ -46,7 +46,13 @@
 #define WICED_EVENT_HANDLER_LIST_SIZE   (5)      /** Maximum number of simultaneously registered event handlers */
 #endif
 
+#ifndef WICED_IOCTL_TIMEOUT_MS
 #define WICED_IOCTL_TIMEOUT_MS         (400)
+#endif
+
+#ifndef WICED_MAX_PENDING_IOCTLS
+#define WICED_MAX_PENDING_IOCTLS         (4)      /** Maximum number of IOCTLs which may be awaiting a response at once */
+#endif
 
 
 #define BDC_PROTO_VER                  (2)      /** Version number of BDC header */
@@ -72,6 +78,21 @@
 #define SDPCM_HEADER_LEN              (12)
 #define BDC_HEADER_LEN                 (4)
 
+/* SDPCM receive glomming */
+#define SDPCM_GLOMDESC_FLAG         (0x80)      /** Flag in channel_and_flags which marks a glom descriptor rather than a superframe */
+
+#ifndef WICED_SDPCM_MAX_GLOM_SUBFRAMES
+#define WICED_SDPCM_MAX_GLOM_SUBFRAMES  (16)    /** Maximum number of subframes accepted in a single superframe */
+#endif
+
+#ifndef WICED_SDPCM_GLOM_READ_SIZE
+#define WICED_SDPCM_GLOM_READ_SIZE      (2048)  /** Superframes are read in pieces of this size - a multiple of the SDIO block size which fits the STM32 DMA bounce buffer */
+#endif
+
+#ifndef WICED_SDPCM_MAX_SUBFRAME_SIZE
+#define WICED_SDPCM_MAX_SUBFRAME_SIZE   (2048)  /** Largest subframe accepted in a superframe - superframes announcing a larger one are discarded */
+#endif
+
 /* Event flags */
 #define WLC_EVENT_MSG_LINK      (0x01)    /** link is up */
 #define WLC_EVENT_MSG_FLUSHTXQ  (0x02)    /** flush tx queue on MIC error */
@@ -109,6 +130,7 @@
 
 typedef enum
 {
+    GLOM_HEADER       = 3,
     DATA_HEADER       = 2,
     ASYNCEVENT_HEADER = 1,
     CONTROL_HEADER    = 0
@@ -255,6 +277,19 @@ typedef struct
     /*@null@*/ void*                    handler_user_data;
 } event_list_elem_t;
 
+/** Pending IOCTL table entry
+ *
+ * id      : The CDC request ID of the IOCTL awaiting a response, or 0 if the entry is free
+ * response: The response buffer, once it has arrived
+ * sleep   : Semaphore on which the sender waits for the response
+ */
+typedef struct
+{
+    uint16_t                       id;
+    /*@only@*/ /*@null@*/ wiced_buffer_t response;
+    host_semaphore_type_t          sleep;
+} sdpcm_pending_ioctl_t;
+
 /** @endcond */
 
 /******************************************************
@@ -266,10 +301,11 @@ static event_list_elem_t      event_list[WICED_EVENT_HANDLER_LIST_SIZE];
 
 /* IOCTL variables*/
 static uint16_t                  requested_ioctl_id;
-static host_semaphore_type_t     wiced_sdpcm_ioctl_mutex;
-static /*@only@*/ wiced_buffer_t wiced_ioctl_response;
-static host_semaphore_type_t     wiced_ioctl_sleep;
-static uint32_t                  ioctl_abort_count = 0;
+static host_semaphore_type_t     wiced_sdpcm_ioctl_mutex;   /* Protects the pending IOCTL table */
+static host_semaphore_type_t     wiced_ioctl_slots;         /* Counts the free entries in the pending IOCTL table */
+static sdpcm_pending_ioctl_t     wiced_pending_ioctl[WICED_MAX_PENDING_IOCTLS];
+static uint32_t                  ioctl_abort_count = 0;       /* Waiters which gave up before their response arrived */
+static uint32_t                  ioctl_late_reply_count = 0;  /* Responses which arrived after their waiter had gone */
 
 /* Bus data credit variables */
 static uint8_t        sdpcm_packet_transmit_sequence_number;
@@ -283,6 +319,14 @@ static host_semaphore_type_t                        wiced_sdpcm_send_queue_mutex
 static wiced_buffer_t /*@owned@*/ /*@null@*/ wiced_sdpcm_send_queue_head = (wiced_buffer_t) NULL;
 static wiced_buffer_t /*@owned@*/ /*@null@*/ wiced_sdpcm_send_queue_tail = (wiced_buffer_t) NULL;
 
+#if WICED_SDPCM_RX_GLOM
+/* Receive glomming variables */
+static uint16_t sdpcm_glom_superframe_length = 0;
+static uint8_t  sdpcm_glom_subframe_count    = 0;
+static uint16_t sdpcm_glom_subframe_length[WICED_SDPCM_MAX_GLOM_SUBFRAMES];
+static uint32_t sdpcm_glom_superframe_buffer[( WICED_SDPCM_GLOM_READ_SIZE + WICED_SDPCM_MAX_SUBFRAME_SIZE ) / sizeof(uint32_t)];  /* uint32_t for DMA alignment */
+#endif /* if WICED_SDPCM_RX_GLOM */
+
 extern wiced_bool_t monitor_mode_enabled;
 
 /******************************************************
@@ -343,6 +387,11 @@ static void add_sdpcm_log_entry( sdpcm_log_direction_t dir, sdpcm_log_type_t typ
 static wiced_buffer_t wiced_get_next_buffer_in_queue( wiced_buffer_t buffer );
 static void wiced_set_next_buffer_in_queue( wiced_buffer_t buffer, wiced_buffer_t prev_buffer );
 static void wiced_send_sdpcm_common( /*@only@*/ wiced_buffer_t buffer, sdpcm_header_type_t header_type );
+static wiced_bool_t wiced_process_ioctl_response( /*@only@*/ wiced_buffer_t buffer, sdpcm_cdc_header_t* cdc_header );
+#if WICED_SDPCM_RX_GLOM
+static void wiced_process_glom_descriptor( sdpcm_common_packet_t* packet, uint16_t size );
+static wiced_result_t wiced_glom_read( uint16_t needed, uint16_t* offset, uint16_t* filled, uint16_t* remaining );
+#endif /* if WICED_SDPCM_RX_GLOM */
 
 extern void host_network_process_raw_packet( wiced_buffer_t buffer, wiced_interface_t interface );
 
@@ -362,26 +411,50 @@ extern void host_network_process_raw_packet( wiced_buffer_t buffer, wiced_interf
 wiced_result_t wiced_init_sdpcm( void )
 {
     uint16_t i;
+    uint16_t j;
     ioctl_abort_count = 0;
+    ioctl_late_reply_count = 0;
 
-    /* Create the mutex protecting the packet send queue */
+    /* Create the mutex protecting the pending IOCTL table */
     if ( host_rtos_init_semaphore( &wiced_sdpcm_ioctl_mutex ) != WICED_SUCCESS )
     {
         return WICED_ERROR;
     }
     host_rtos_set_semaphore( &wiced_sdpcm_ioctl_mutex, WICED_FALSE );
 
-    /* Create the event flag which signals the Wiced thread needs to wake up */
-    if ( host_rtos_init_semaphore( &wiced_ioctl_sleep ) != WICED_SUCCESS )
+    /* Create the semaphore which counts free entries in the pending IOCTL table */
+    if ( host_rtos_init_semaphore( &wiced_ioctl_slots ) != WICED_SUCCESS )
     {
         host_rtos_deinit_semaphore( &wiced_sdpcm_ioctl_mutex );
         return WICED_ERROR;
     }
 
+    /* Create the flags which wake each thread waiting for an IOCTL response */
+    for ( i = 0; i < (uint16_t) WICED_MAX_PENDING_IOCTLS; i++ )
+    {
+        wiced_pending_ioctl[i].id       = 0;
+        wiced_pending_ioctl[i].response = NULL;
+        if ( host_rtos_init_semaphore( &wiced_pending_ioctl[i].sleep ) != WICED_SUCCESS )
+        {
+            for ( j = 0; j < i; j++ )
+            {
+                host_rtos_deinit_semaphore( &wiced_pending_ioctl[j].sleep );
+            }
+            host_rtos_deinit_semaphore( &wiced_ioctl_slots );
+            host_rtos_deinit_semaphore( &wiced_sdpcm_ioctl_mutex );
+            return WICED_ERROR;
+        }
+        host_rtos_set_semaphore( &wiced_ioctl_slots, WICED_FALSE );
+    }
+
     /* Create the sdpcm packet queue semaphore */
     if ( host_rtos_init_semaphore( &wiced_sdpcm_send_queue_mutex ) != WICED_SUCCESS )
     {
-        host_rtos_deinit_semaphore( &wiced_ioctl_sleep );
+        for ( i = 0; i < (uint16_t) WICED_MAX_PENDING_IOCTLS; i++ )
+        {
+            host_rtos_deinit_semaphore( &wiced_pending_ioctl[i].sleep );
+        }
+        host_rtos_deinit_semaphore( &wiced_ioctl_slots );
         host_rtos_deinit_semaphore( &wiced_sdpcm_ioctl_mutex );
         return WICED_ERROR;
     }
@@ -414,8 +487,20 @@ wiced_result_t wiced_init_sdpcm( void )
 
 void wiced_quit_sdpcm( void )
 {
-    /* Delete the sleep mutex */
-    host_rtos_deinit_semaphore( &wiced_ioctl_sleep );
+    uint16_t i;
+
+    /* Delete the sleep flags, freeing any responses nobody collected */
+    for ( i = 0; i < (uint16_t) WICED_MAX_PENDING_IOCTLS; i++ )
+    {
+        host_rtos_deinit_semaphore( &wiced_pending_ioctl[i].sleep );
+        if ( wiced_pending_ioctl[i].response != NULL )
+        {
+            host_buffer_release( wiced_pending_ioctl[i].response, WICED_NETWORK_RX );
+            wiced_pending_ioctl[i].response = NULL;
+        }
+        wiced_pending_ioctl[i].id = 0;
+    }
+    host_rtos_deinit_semaphore( &wiced_ioctl_slots );
 
     /* Delete the queue mutex.  */
     host_rtos_deinit_semaphore( &wiced_sdpcm_ioctl_mutex );
@@ -430,6 +515,12 @@ void wiced_quit_sdpcm( void )
         host_buffer_release(wiced_sdpcm_send_queue_head, WICED_NETWORK_TX);
         wiced_sdpcm_send_queue_head = buf;
     }
+
+#if WICED_SDPCM_RX_GLOM
+    /* Forget any superframe announced before the bus went down */
+    sdpcm_glom_superframe_length = 0;
+    sdpcm_glom_subframe_count    = 0;
+#endif /* if WICED_SDPCM_RX_GLOM */
 }
 
 
@@ -604,21 +695,16 @@ void wiced_process_sdpcm( /*@only@*/ wiced_buffer_t buffer )
                 break;
             }
 
-            /* Ignore a reply for each aborted ioctl attempt to ensure wiced_ioctl_sleep semaphore does not get out of sync */
-            if (ioctl_abort_count != 0)
+            WICED_LOG( ( "Wcd:< Procd pkt 0x%08X: IOCTL Response (%d bytes)\r\n", (unsigned int)buffer, size ) );
+
+            /* Pass the response to the thread waiting on its request ID so that it will resume */
+            if ( wiced_process_ioctl_response( buffer, (sdpcm_cdc_header_t*) &packet->data[ packet->sdpcm_header.sw_header.header_length - SDPCM_HEADER_LEN ] ) != WICED_TRUE )
             {
-                --ioctl_abort_count;
+                /* Nobody is waiting for it - most likely a late reply to an IOCTL which timed out */
+                WPRINT_WWD_DEBUG(("Received a response for an IOCTL which is not pending - dropping it\r\n"));
+                ++ioctl_late_reply_count;
                 host_buffer_release( buffer, WICED_NETWORK_RX );
-                break;
             }
-
-            /* Save the response packet in a global variable */
-            wiced_ioctl_response = buffer;
-
-            WICED_LOG( ( "Wcd:< Procd pkt 0x%08X: IOCTL Response (%d bytes)\r\n", (unsigned int)buffer, size ) );
-
-            /* Wake the thread which sent the IOCTL/IOVAR so that it will resume */
-            host_rtos_set_semaphore( &wiced_ioctl_sleep, WICED_FALSE );
             break;
 
         case DATA_HEADER:
@@ -762,6 +848,14 @@ void wiced_process_sdpcm( /*@only@*/ wiced_buffer_t buffer )
             }
             break;
 
+#if WICED_SDPCM_RX_GLOM
+        case GLOM_HEADER:
+            /* Glom descriptor announcing the superframe which follows it */
+            wiced_process_glom_descriptor( packet, size );
+            host_buffer_release( buffer, WICED_NETWORK_RX );
+            break;
+#endif /* if WICED_SDPCM_RX_GLOM */
+
         default:
             WPRINT_WWD_DEBUG(("SDPCM packet of unknown channel received - dropping packet\r\n"));
             host_buffer_release( buffer, WICED_NETWORK_RX );
@@ -769,6 +863,215 @@ void wiced_process_sdpcm( /*@only@*/ wiced_buffer_t buffer )
     }
 }
 
+#if WICED_SDPCM_RX_GLOM
+/** Reads and splits a superframe announced by a glom descriptor
+ *
+ *  The superframe is read from the Broadcom 802.11 device in pieces of
+ *  WICED_SDPCM_GLOM_READ_SIZE, so its total size is not limited by the buffer.
+ *  Each subframe it contains is copied into its own packet buffer and passed
+ *  to @ref wiced_process_sdpcm, exactly as if it had been read on its own.
+ *  A superframe which does not match its descriptor is discarded.
+ *
+ * @return 1 if a superframe was pending (and has been handled), 0 otherwise
+ */
+int8_t wiced_receive_superframe( void )
+{
+    uint8_t*        data = (uint8_t*) sdpcm_glom_superframe_buffer;
+    sdpcm_header_t* header;
+    wiced_buffer_t  buffer;
+    uint16_t        remaining;
+    uint16_t        filled = 0;
+    uint16_t        offset = 0;
+    uint16_t        space;
+    uint16_t        size;
+    uint8_t         count;
+    uint8_t         i;
+
+    if ( sdpcm_glom_superframe_length == 0 )
+    {
+        return 0;
+    }
+
+    remaining = sdpcm_glom_superframe_length;
+    count     = sdpcm_glom_subframe_count;
+    sdpcm_glom_superframe_length = 0;
+    sdpcm_glom_subframe_count    = 0;
+
+    /* A descriptor which could not be used still has its superframe sitting in the WLAN FIFO */
+    if ( count == 0 )
+    {
+        (void) wiced_read_superframe( NULL, 0 );
+        return 1;
+    }
+
+    /* The first descriptor length covers the superframe header as well as the first subframe */
+    if ( wiced_glom_read( sdpcm_glom_subframe_length[0], &offset, &filled, &remaining ) != WICED_SUCCESS )
+    {
+        return 1;
+    }
+
+    /* Check the superframe header */
+    header = (sdpcm_header_t*) data;
+    if ( ( ( header->frametag[0] ^ header->frametag[1] ) != (uint16_t) 0xFFFF ) ||
+         ( ( header->sw_header.channel_and_flags & 0x0f ) != (uint8_t) GLOM_HEADER ) ||
+         ( ( header->sw_header.channel_and_flags & SDPCM_GLOMDESC_FLAG ) != 0 ) ||
+         ( header->sw_header.header_length < (uint8_t) SDPCM_HEADER_LEN ) ||
+         ( header->sw_header.header_length >= sdpcm_glom_subframe_length[0] ) )
+    {
+        WPRINT_WWD_DEBUG(("Received a superframe which does not match its descriptor - dropping it\r\n"));
+        goto drop_rest;
+    }
+
+    wiced_process_bus_credit_update( data );
+
+    offset = header->sw_header.header_length;
+    for ( i = 0; i < count; i++ )
+    {
+        sdpcm_header_t* subframe;
+
+        space = ( i == 0 ) ? (uint16_t) ( sdpcm_glom_subframe_length[0] - header->sw_header.header_length ) : sdpcm_glom_subframe_length[i];
+        if ( ( i != 0 ) && ( wiced_glom_read( space, &offset, &filled, &remaining ) != WICED_SUCCESS ) )
+        {
+            return 1;
+        }
+
+        subframe = (sdpcm_header_t*) &data[offset];
+        size     = subframe->frametag[0];
+
+        if ( ( ( size ^ subframe->frametag[1] ) != (uint16_t) 0xFFFF ) ||
+             ( size < (uint16_t) SDPCM_HEADER_LEN ) ||
+             ( size > space ) ||
+             ( ( subframe->sw_header.channel_and_flags & 0x0f ) >= (uint8_t) GLOM_HEADER ) )
+        {
+            WPRINT_WWD_DEBUG(("Received a superframe with a corrupt subframe - dropping the rest of it\r\n"));
+            goto drop_rest;
+        }
+
+        if ( host_buffer_get( &buffer, WICED_NETWORK_RX, (unsigned short) ( size + sizeof(wiced_buffer_header_t) ), WICED_FALSE ) != WICED_SUCCESS )
+        {
+            /* No buffer for this subframe, but its bus credit information is still needed */
+            wiced_process_bus_credit_update( (uint8_t*) subframe );
+        }
+        else
+        {
+            memcpy( host_buffer_get_current_piece_data_pointer( buffer ) + sizeof(wiced_buffer_header_t), subframe, (size_t) size );
+            wiced_process_sdpcm( buffer );
+        }
+
+        offset = (uint16_t) ( offset + space );
+    }
+
+    return 1;
+
+drop_rest:
+    /* Terminate the frame even when the descriptor lengths have all been read - the WLAN may have sent more */
+    (void) wiced_read_superframe( NULL, 0 );
+    return 1;
+}
+
+/** Makes sure the next @a needed bytes of the superframe are in the buffer
+ *
+ *  Bytes already processed are dropped from the front of the buffer before the
+ *  next piece is read. Every piece but the last is a whole number of SDIO blocks.
+ *  On failure the rest of the superframe has already been dropped from the bus.
+ */
+static wiced_result_t wiced_glom_read( uint16_t needed, uint16_t* offset, uint16_t* filled, uint16_t* remaining )
+{
+    uint8_t* data = (uint8_t*) sdpcm_glom_superframe_buffer;
+    uint16_t chunk;
+
+    while ( (uint16_t) ( *filled - *offset ) < needed )
+    {
+        if ( *offset != 0 )
+        {
+            memmove( data, &data[*offset], (size_t) ( *filled - *offset ) );
+            *filled = (uint16_t) ( *filled - *offset );
+            *offset = 0;
+        }
+
+        chunk = MIN( *remaining, (uint16_t) WICED_SDPCM_GLOM_READ_SIZE );
+        if ( ( chunk == 0 ) || ( (uint32_t) *filled + chunk > sizeof( sdpcm_glom_superframe_buffer ) ) )
+        {
+            WPRINT_WWD_DEBUG(("Received a superframe which does not match its descriptor - dropping it\r\n"));
+            (void) wiced_read_superframe( NULL, 0 );
+            return WICED_ERROR;
+        }
+
+        if ( wiced_read_superframe( &data[*filled], chunk ) != WICED_SUCCESS )
+        {
+            return WICED_ERROR;
+        }
+        *filled    = (uint16_t) ( *filled + chunk );
+        *remaining = (uint16_t) ( *remaining - chunk );
+    }
+
+    return WICED_SUCCESS;
+}
+
+/** Records the subframe lengths carried by a glom descriptor
+ *
+ *  The descriptor payload is a list of little-endian 16-bit subframe lengths.
+ *  If the list cannot be used, the superframe is still marked as pending so
+ *  that @ref wiced_receive_superframe drops it from the bus.
+ *
+ * @param packet : The glom descriptor packet
+ * @param size   : The SDPCM size of the descriptor taken from its frametag
+ */
+static void wiced_process_glom_descriptor( sdpcm_common_packet_t* packet, uint16_t size )
+{
+    uint8_t  header_length = packet->sdpcm_header.sw_header.header_length;
+    uint8_t* lengths;
+    uint16_t count;
+    uint16_t i;
+    uint32_t total_length = 0;
+    wiced_bool_t oversized = WICED_FALSE;
+
+    if ( ( packet->sdpcm_header.sw_header.channel_and_flags & SDPCM_GLOMDESC_FLAG ) == 0 )
+    {
+        WPRINT_WWD_DEBUG(("Received a superframe without a glom descriptor - dropping it\r\n"));
+        return;
+    }
+
+    if ( ( header_length < (uint8_t) SDPCM_HEADER_LEN ) || ( header_length > size ) )
+    {
+        WPRINT_WWD_DEBUG(("Received a glom descriptor with a bad header length\r\n"));
+        return;
+    }
+
+    lengths = &packet->data[ header_length - SDPCM_HEADER_LEN ];
+    count   = (uint16_t) ( ( size - header_length ) / 2 );
+
+    sdpcm_glom_subframe_count = 0;
+    for ( i = 0; i < count; i++ )
+    {
+        uint16_t length = (uint16_t) ( lengths[2 * i] | ( lengths[2 * i + 1] << 8 ) );
+        if ( i < (uint16_t) WICED_SDPCM_MAX_GLOM_SUBFRAMES )
+        {
+            sdpcm_glom_subframe_length[i] = length;
+        }
+        if ( length > (uint16_t) WICED_SDPCM_MAX_SUBFRAME_SIZE )
+        {
+            oversized = WICED_TRUE;
+        }
+        total_length += length;
+    }
+
+    if ( ( count == 0 ) || ( total_length == 0 ) || ( total_length > (uint32_t) 0xFFFF ) )
+    {
+        WPRINT_WWD_DEBUG(("Received an empty glom descriptor\r\n"));
+        return;
+    }
+
+    sdpcm_glom_superframe_length = (uint16_t) total_length;
+    if ( ( count > (uint16_t) WICED_SDPCM_MAX_GLOM_SUBFRAMES ) || ( oversized == WICED_TRUE ) )
+    {
+        WPRINT_WWD_DEBUG(("Received a superframe which is too large - dropping it\r\n"));
+        return;
+    }
+    sdpcm_glom_subframe_count = (uint8_t) count;
+}
+#endif /* if WICED_SDPCM_RX_GLOM */
+
 
 /** Sends an IOCTL command
  *
@@ -780,7 +1083,7 @@ void wiced_process_sdpcm( /*@only@*/ wiced_buffer_t buffer )
  *
  *  @Note: The caller is responsible for releasing the response buffer.
  *  @Note: The function blocks until the IOCTL has completed
- *  @Note: Only one IOCTL may happen simultaneously.
+ *  @Note: Up to WICED_MAX_PENDING_IOCTLS IOCTLs from different threads may be in progress simultaneously.
  *
  *  @param type       : SDPCM_SET or SDPCM_GET - indicating whether to set or get the I/O control
  *  @param send_buffer_hnd : A handle for a packet buffer containing the data value to be sent.
@@ -791,22 +1094,74 @@ void wiced_process_sdpcm( /*@only@*/ wiced_buffer_t buffer )
  */
 
 wiced_result_t wiced_send_ioctl( sdpcm_command_type_t type, uint32_t command, wiced_buffer_t send_buffer_hnd, /*@null@*/ /*@out@*/ wiced_buffer_t* response_buffer_hnd, sdpcm_interface_t interface ) /*@releases send_buffer_hnd@*/
+{
+    sdpcm_ioctl_handle_t handle;
+    wiced_result_t       retval;
+
+    retval = wiced_send_ioctl_start( type, command, send_buffer_hnd, interface, &handle );
+    if ( retval != WICED_SUCCESS )
+    {
+        return retval;
+    }
+
+    return wiced_wait_ioctl( handle, (uint32_t) WICED_IOCTL_TIMEOUT_MS, response_buffer_hnd );
+}
+
+/** Sends an IOCTL command without waiting for the response
+ *
+ *  Queues the IOCTL for transmission and returns a handle which must later be passed
+ *  to @ref wiced_wait_ioctl, which collects the response and frees the handle.
+ *  Several IOCTLs may be started before waiting for any of them; responses are matched
+ *  to their IOCTL by the CDC request ID, so they may complete in any order.
+ *
+ *  @Note: Blocks if WICED_MAX_PENDING_IOCTLS IOCTLs are already in progress. A thread which
+ *         starts more than one IOCTL before waiting can therefore deadlock against another thread
+ *         doing the same, once the two hold every entry between them; only one thread should do so.
+ *
+ *  @param type       : SDPCM_SET or SDPCM_GET - indicating whether to set or get the I/O control
+ *  @param command    : The IOCTL command number
+ *  @param send_buffer_hnd : A handle for a packet buffer containing the data value to be sent.
+ *  @param interface  : Which interface to send the iovar to (SDPCM_STA_INTERFACE or SDPCM_AP_INTERFACE)
+ *  @param handle     : Receives the handle to pass to @ref wiced_wait_ioctl
+ *
+ *  @return    WICED_SUCCESS or WICED_ERROR
+ */
+wiced_result_t wiced_send_ioctl_start( sdpcm_command_type_t type, uint32_t command, wiced_buffer_t send_buffer_hnd, sdpcm_interface_t interface, /*@out@*/ sdpcm_ioctl_handle_t* handle ) /*@releases send_buffer_hnd@*/
 {
     uint32_t data_length;
-    uint32_t flags;
     uint16_t id;
+    uint8_t  slot;
     wiced_result_t retval;
     sdpcm_control_packet_t* send_packet;
-    sdpcm_common_packet_t*  recv_packet;
-    sdpcm_cdc_header_t* cdc_header;
 
-    /* Acquire mutex which prevents multiple simultaneous IOCTLs */
+    /* Wait for a free entry in the pending IOCTL table */
+    retval = host_rtos_get_semaphore( &wiced_ioctl_slots, NEVER_TIMEOUT, WICED_FALSE );
+    if ( retval != WICED_SUCCESS )
+    {
+        host_buffer_release( send_buffer_hnd, WICED_NETWORK_TX );
+        return retval;
+    }
+
+    /* Claim the entry and a new request ID */
     retval = host_rtos_get_semaphore( &wiced_sdpcm_ioctl_mutex, NEVER_TIMEOUT, WICED_FALSE );
     if ( retval != WICED_SUCCESS )
     {
+        host_rtos_set_semaphore( &wiced_ioctl_slots, WICED_FALSE );
         host_buffer_release( send_buffer_hnd, WICED_NETWORK_TX );
         return retval;
     }
+    for ( slot = 0; wiced_pending_ioctl[slot].id != 0; slot++ )
+    {
+        /* wiced_ioctl_slots guarantees there is a free entry */
+    }
+    if ( ++requested_ioctl_id == 0 )
+    {
+        ++requested_ioctl_id;
+    }
+    id = requested_ioctl_id;
+    wiced_pending_ioctl[slot].id       = id;
+    wiced_pending_ioctl[slot].response = NULL;
+    host_rtos_set_semaphore( &wiced_sdpcm_ioctl_mutex, WICED_FALSE );
 
     /* Get the data length and cast packet to a CDC SDPCM header */
     data_length = host_buffer_get_current_piece_size( send_buffer_hnd ) - sizeof(sdpcm_packet_header_t) - sizeof(sdpcm_cdc_header_t);
@@ -833,7 +1188,7 @@ wiced_result_t wiced_send_ioctl( sdpcm_command_type_t type, uint32_t command, wi
     /* Prepare the CDC header */
     send_packet->cdc_header.cmd    = command;
     send_packet->cdc_header.len    = data_length;
-    send_packet->cdc_header.flags  = ( ( (uint32_t) ++requested_ioctl_id << CDCF_IOC_ID_SHIFT ) & CDCF_IOC_ID_MASK ) | type | (uint32_t) interface << 12;
+    send_packet->cdc_header.flags  = ( ( (uint32_t) id << CDCF_IOC_ID_SHIFT ) & CDCF_IOC_ID_MASK ) | type | (uint32_t) interface << 12;
     send_packet->cdc_header.status = 0;
 
     WICED_LOG( ( "Wcd:> IOCTL pkt 0x%08X: cmd %d, len %d\r\n", (unsigned int)send_buffer_hnd, (int)command, data_length ) );
@@ -841,53 +1196,74 @@ wiced_result_t wiced_send_ioctl( sdpcm_command_type_t type, uint32_t command, wi
     /* Store the length of the data and the IO control header and pass "down" */
     wiced_send_sdpcm_common( send_buffer_hnd, CONTROL_HEADER );
 
-    do
-    {
-        /* Wait till response has been received  */
-        retval = host_rtos_get_semaphore( &wiced_ioctl_sleep, (uint32_t) WICED_IOCTL_TIMEOUT_MS, WICED_FALSE );
-        if ( retval != WICED_SUCCESS )
-        {
-            ++ioctl_abort_count;
-            /* Release the mutex since Wiced_IOCTL_Response will no longer be referenced. */
-            host_rtos_set_semaphore( &wiced_sdpcm_ioctl_mutex, WICED_FALSE );
-            return retval;
-        }
+    *handle = slot;
+    return WICED_SUCCESS;
+}
+
+/** Waits for the response to an IOCTL started with @ref wiced_send_ioctl_start
+ *
+ *  The handle is freed when this function returns, whether or not the response arrived.
+ *
+ *  @Note: The caller is responsible for releasing the response buffer.
+ *
+ *  @param handle     : The handle returned by @ref wiced_send_ioctl_start
+ *  @param timeout_ms : Maximum time to wait for the response
+ *  @param response_buffer_hnd : A pointer which will receive the handle for the packet buffer containing the response data value received..
+ *
+ *  @return    WICED_SUCCESS, WICED_TIMEOUT, or the error status returned by the 802.11 device
+ */
+wiced_result_t wiced_wait_ioctl( sdpcm_ioctl_handle_t handle, uint32_t timeout_ms, /*@null@*/ /*@out@*/ wiced_buffer_t* response_buffer_hnd )
+{
+    sdpcm_pending_ioctl_t* pending = &wiced_pending_ioctl[handle];
+    wiced_buffer_t         response;
+    wiced_result_t         retval;
+    wiced_result_t         wait_result;
+    uint32_t               flags;
+    sdpcm_common_packet_t* recv_packet;
+    sdpcm_cdc_header_t*    cdc_header;
+
+    /* Wait till response has been received  */
+    wait_result = host_rtos_get_semaphore( &pending->sleep, timeout_ms, WICED_FALSE );
+
+    /* Free the table entry - any reply arriving from now on will be dropped */
+    (void) host_rtos_get_semaphore( &wiced_sdpcm_ioctl_mutex, NEVER_TIMEOUT, WICED_FALSE );
+    response          = pending->response;
+    pending->response = NULL;
+    pending->id       = 0;
+    host_rtos_set_semaphore( &wiced_sdpcm_ioctl_mutex, WICED_FALSE );
 
-        /* Cast the response to a CDC + SDPCM header */
-        recv_packet = (sdpcm_common_packet_t*) host_buffer_get_current_piece_data_pointer( wiced_ioctl_response );
-        cdc_header = (sdpcm_cdc_header_t*) &recv_packet->data[ recv_packet->sdpcm_header.sw_header.header_length - SDPCM_HEADER_LEN ];
-        flags = ltoh32( cdc_header->flags );
-        id = (uint16_t) ( ( flags & CDCF_IOC_ID_MASK ) >> CDCF_IOC_ID_SHIFT );
+    if ( ( wait_result != WICED_SUCCESS ) && ( response != NULL ) )
+    {
+        /* The response raced with the timeout - consume the wake-up it posted */
+        (void) host_rtos_get_semaphore( &pending->sleep, 0, WICED_FALSE );
+    }
+    host_rtos_set_semaphore( &wiced_ioctl_slots, WICED_FALSE );
 
-        /* Check that the IOCTL identifier matches the identifier that was sent */
-        if ( id != requested_ioctl_id )
-        {
-            host_buffer_release( wiced_ioctl_response, WICED_NETWORK_RX );
-            WPRINT_WWD_DEBUG(("Received a response for a different IOCTL - retry\r\n"));
-        }
-    } while ( id != requested_ioctl_id );
+    if ( response == NULL )
+    {
+        ++ioctl_abort_count;
+        return ( wait_result != WICED_SUCCESS ) ? wait_result : WICED_ERROR;
+    }
 
+    /* Cast the response to a CDC + SDPCM header */
+    recv_packet = (sdpcm_common_packet_t*) host_buffer_get_current_piece_data_pointer( response );
+    cdc_header = (sdpcm_cdc_header_t*) &recv_packet->data[ recv_packet->sdpcm_header.sw_header.header_length - SDPCM_HEADER_LEN ];
+    flags = ltoh32( cdc_header->flags );
 
     retval = (wiced_result_t) ltoh32( cdc_header->status );
 
     /* Check if the caller wants the response */
     if ( response_buffer_hnd != NULL )
     {
-        *response_buffer_hnd = wiced_ioctl_response;
+        *response_buffer_hnd = response;
         host_buffer_add_remove_at_front( response_buffer_hnd, (int32_t) IOCTL_OFFSET );
     }
     else
     {
-        host_buffer_release( wiced_ioctl_response, WICED_NETWORK_RX );
+        host_buffer_release( response, WICED_NETWORK_RX );
         recv_packet = 0; /* Note: packet will no longer be valid after freeing buffer */
     }
 
-    wiced_ioctl_response = NULL;
-
-    /* Release the mutex since Wiced_IOCTL_Response will no longer be referenced. */
-    host_rtos_set_semaphore( &wiced_sdpcm_ioctl_mutex, WICED_FALSE );
-
-
     /* Check whether the IOCTL response indicates it failed. */
     if ( ( flags & CDCF_IOC_ERROR ) != 0)
     {
@@ -1110,6 +1486,22 @@ uint8_t wiced_get_available_bus_credits( void )
 }
 
 
+/** Reports how often IOCTL waiters and responses missed each other
+ *
+ *  Every aborted wait should eventually be matched by a late reply being dropped,
+ *  unless the WLAN never answered. A late reply count which keeps growing past
+ *  the abort count means responses are being matched to the wrong request.
+ *
+ * @param aborted      : Receives the number of waits which ended without a response
+ * @param late_replies : Receives the number of responses dropped because nobody was waiting
+ */
+void wiced_get_ioctl_statistics( /*@out@*/ uint32_t* aborted, /*@out@*/ uint32_t* late_replies )
+{
+    *aborted      = ioctl_abort_count;
+    *late_replies = ioctl_late_reply_count;
+}
+
+
 /******************************************************
  *             Static Functions
  ******************************************************/
@@ -1209,3 +1601,39 @@ WEAK void host_network_process_raw_packet( wiced_buffer_t buffer, wiced_interfac
 
     host_buffer_release( buffer, WICED_NETWORK_RX );
 }
+
+/** Hands an IOCTL response to the thread waiting for it
+ *
+ *  Looks up the pending IOCTL table by the CDC request ID in the response.
+ *
+ * @param buffer     : The IOCTL response packet buffer
+ * @param cdc_header : The CDC header within the response
+ *
+ * @return WICED_TRUE if the response was claimed by a waiting IOCTL, WICED_FALSE otherwise
+ */
+static wiced_bool_t wiced_process_ioctl_response( /*@only@*/ wiced_buffer_t buffer, sdpcm_cdc_header_t* cdc_header )
+{
+    uint16_t     id     = (uint16_t) ( ( ltoh32( cdc_header->flags ) & CDCF_IOC_ID_MASK ) >> CDCF_IOC_ID_SHIFT );
+    wiced_bool_t result = WICED_FALSE;
+    uint8_t      i;
+
+    if ( id == 0 )
+    {
+        return WICED_FALSE;
+    }
+
+    (void) host_rtos_get_semaphore( &wiced_sdpcm_ioctl_mutex, NEVER_TIMEOUT, WICED_FALSE );
+    for ( i = 0; i < (uint8_t) WICED_MAX_PENDING_IOCTLS; i++ )
+    {
+        if ( ( wiced_pending_ioctl[i].id == id ) && ( wiced_pending_ioctl[i].response == NULL ) )
+        {
+            wiced_pending_ioctl[i].response = buffer;
+            host_rtos_set_semaphore( &wiced_pending_ioctl[i].sleep, WICED_FALSE );
+            result = WICED_TRUE;
+            break;
+        }
+    }
+    host_rtos_set_semaphore( &wiced_sdpcm_ioctl_mutex, WICED_FALSE );
+
+    return result;
+}
@@ -30,6 +30,15 @@ extern "C" {
  *             Constants
  ******************************************************/
 
+/* SDPCM receive glomming (several frames from the WLAN in one superframe) is opt-in:
+ * add WICED_SDPCM_ENABLE_RX_GLOM to GLOBAL_DEFINES. It is left off on buses which cannot read superframes.
+ */
+#ifndef WICED_SDPCM_ENABLE_RX_GLOM
+#define WICED_SDPCM_ENABLE_RX_GLOM  (0)
+#endif /* ifndef WICED_SDPCM_ENABLE_RX_GLOM */
+
+#define WICED_SDPCM_RX_GLOM         ( ( WICED_BUS_SUPPORTS_RX_GLOM != 0 ) && ( WICED_SDPCM_ENABLE_RX_GLOM != 0 ) )
+
 /* CDC flag definition taken from bcmcdc.h */
 #ifndef CDCF_IOC_SET
 #define CDCF_IOC_SET                (0x02)      /** 0=get, 1=set cmd */
@@ -67,6 +76,9 @@ wiced_bool_t swap = WICED_FALSE;
 
 #define IOCTL_OFFSET ( sizeof(wiced_buffer_header_t) + 12 + 16 )
 
+/** Handle of an IOCTL which has been sent but whose response has not yet been collected */
+typedef uint8_t sdpcm_ioctl_handle_t;
+
 /******************************************************
  *             Function declarations
  ******************************************************/
@@ -74,13 +86,19 @@ wiced_bool_t swap = WICED_FALSE;
 extern /*@exposed@*/ /*@null@*/ void* wiced_get_iovar_buffer( /*@returned@*/ /*@out@*/ wiced_buffer_t* buffer, uint16_t data_length, const char* name )  /*@allocates buffer@*/ /*@defines buffer@*/ ;
 extern /*@null@*/ void* wiced_get_ioctl_buffer(  /*@returned@*/ /*@out@*/ wiced_buffer_t* buffer, uint16_t data_length )  /*@allocates buffer@*/ ;
 extern wiced_result_t wiced_send_ioctl( sdpcm_command_type_t type, uint32_t command, wiced_buffer_t send_buffer_hnd, /*@null@*/ /*@out@*/ wiced_buffer_t* response_buffer_hnd, sdpcm_interface_t interface ) /*@releases send_buffer_hnd@*/ ;
+extern wiced_result_t wiced_send_ioctl_start( sdpcm_command_type_t type, uint32_t command, wiced_buffer_t send_buffer_hnd, sdpcm_interface_t interface, /*@out@*/ sdpcm_ioctl_handle_t* handle ) /*@releases send_buffer_hnd@*/ ;
+extern wiced_result_t wiced_wait_ioctl( sdpcm_ioctl_handle_t handle, uint32_t timeout_ms, /*@null@*/ /*@out@*/ wiced_buffer_t* response_buffer_hnd );
 extern wiced_result_t wiced_send_iovar( sdpcm_command_type_t type, wiced_buffer_t send_buffer_hnd, /*@out@*/ /*@null@*/ wiced_buffer_t* response_buffer_hnd, sdpcm_interface_t interface ) /*@releases send_buffer_hnd@*/ ;
 extern void wiced_process_sdpcm( /*@only@*/ wiced_buffer_t buffer );
+#if WICED_SDPCM_RX_GLOM
+extern int8_t wiced_receive_superframe( void );
+#endif /* if WICED_SDPCM_RX_GLOM */
 extern wiced_result_t wiced_init_sdpcm( void );
 extern void wiced_quit_sdpcm( void );
 
 extern void wiced_process_bus_credit_update(uint8_t* data);
 extern uint8_t wiced_get_available_bus_credits( void );
+extern void wiced_get_ioctl_statistics( /*@out@*/ uint32_t* aborted, /*@out@*/ uint32_t* late_replies );
 
 /******************************************************
  *             Global variables
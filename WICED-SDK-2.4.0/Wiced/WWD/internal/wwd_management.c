@@ -149,9 +149,9 @@ wiced_result_t wiced_management_wifi_on( void )
     wiced_wifi_set_mac_address(mac_address);
 #endif
 
-    /* Turn off SDPCM TX Glomming */
-    /* Note: This is only required for later chips.
-     * The 4319 has glomming off by default however the 43362 has it on by default.
+    /* Set SDPCM TX Glomming, i.e. whether the WLAN may pass several frames to the host in one superframe */
+    /* Note: The 4319 has glomming off by default however the 43362 has it on by default.
+     * It is turned off unless the build opts in to receive glomming (WICED_SDPCM_RX_GLOM, see SDPCM.h).
      */
     data = wiced_get_iovar_buffer( &buffer, (uint16_t) 4, IOVAR_STR_TX_GLOM );
     if ( data == NULL )
@@ -159,9 +159,9 @@ wiced_result_t wiced_management_wifi_on( void )
         wiced_assert( "Could not get buffer for IOVAR", 0 != 0 );
         return WICED_ERROR;
     }
-    *data = 0;
+    *data = ( WICED_SDPCM_RX_GLOM ) ? 1 : 0;
     retval = wiced_send_iovar( SDPCM_SET, buffer, 0, SDPCM_STA_INTERFACE );
-    wiced_assert("Could not turn off TX glomming\r\n", (retval == WICED_SUCCESS) || (retval == WICED_UNSUPPORTED) );
+    wiced_assert("Could not set TX glomming\r\n", (retval == WICED_SUCCESS) || (retval == WICED_UNSUPPORTED) );
 
     /* Turn APSTA on */
     data = (uint32_t*) wiced_get_iovar_buffer( &buffer, (uint16_t) 4, IOVAR_STR_APSTA );
@@ -43,6 +43,15 @@
 
 #define WICED_THREAD_POLL_TIMEOUT      (NEVER_TIMEOUT)
 
+/* Timeout while waiting for bus credits. The credit update normally wakes the thread via
+ * the bus interrupt, so this only bounds the stall when that interrupt is missed. */
+#ifndef WICED_THREAD_CREDIT_WAIT_MIN_MS
+#define WICED_THREAD_CREDIT_WAIT_MIN_MS  (2)
+#endif
+#ifndef WICED_THREAD_CREDIT_WAIT_MAX_MS
+#define WICED_THREAD_CREDIT_WAIT_MAX_MS  (100)
+#endif
+
 #ifdef RTOS_USE_STATIC_THREAD_STACK
 static uint8_t wiced_thread_stack[WICED_THREAD_STACK_SIZE];
 #define WICED_THREAD_STACK     wiced_thread_stack
@@ -154,6 +163,47 @@ int8_t wiced_send_one_packet( void ) /*@modifies internalState, wiced_packet_sen
     return ret;
 }
 
+/** Sends queued packets until the queue is empty or the bus credits run out
+ *
+ * Drains the send queue in one pass, bringing the WLAN bus up once for
+ * the whole batch rather than once per packet.
+ *
+ * This function is normally used by the Wiced Thread, but can be
+ * called periodically by systems which have no RTOS to ensure
+ * packets get sent.
+ *
+ * @return    The number of packets sent
+ */
+uint32_t wiced_send_queued_packets( void ) /*@modifies internalState, wiced_packet_send_queue_head, wiced_packet_send_queue_tail@*/
+{
+    wiced_buffer_t tmp_buf_hnd = NULL;
+    wiced_result_t result;
+    uint32_t       sent = 0;
+
+    /* wiced_get_packet_to_send stops handing out packets once the credit window is used up */
+    while ( wiced_get_packet_to_send( &tmp_buf_hnd ) == WICED_SUCCESS )
+    {
+        /* Ensure the wlan backplane bus is up */
+        if ( ( sent == 0 ) && ( WICED_SUCCESS != wiced_bus_ensure_wlan_bus_is_up() ) )
+        {
+            wiced_assert("Could not bring bus back up", 0 != 0 );
+            host_buffer_release( tmp_buf_hnd, WICED_NETWORK_TX );
+            break;
+        }
+
+        WPRINT_WWD_DEBUG(("Wcd:> Sending pkt 0x%08X\n\r", (unsigned int)tmp_buf_hnd ));
+        result = wiced_bus_transfer_buffer( BUS_WRITE, WLAN_FUNCTION, 0, tmp_buf_hnd );
+        host_buffer_release( tmp_buf_hnd, WICED_NETWORK_TX );
+        if ( result != WICED_SUCCESS )
+        {
+            break;
+        }
+        sent++;
+    }
+
+    return sent;
+}
+
 /** Receives a packet if one is waiting
  *
  * Checks the wifi chip fifo to determine if there is any packets waiting
@@ -171,6 +221,15 @@ int8_t wiced_receive_one_packet( void )
 {
     /* Check if there is a packet ready to be received */
     wiced_buffer_t recv_buffer;
+
+#if WICED_SDPCM_RX_GLOM
+    /* A glom descriptor is always followed by its superframe */
+    if ( wiced_receive_superframe( ) != 0 )
+    {
+        return (int8_t) 1;
+    }
+#endif /* if WICED_SDPCM_RX_GLOM */
+
     if ( wiced_read_frame( &recv_buffer ) == WICED_SUCCESS)
     {
         if ( recv_buffer != NULL )
@@ -186,7 +245,7 @@ int8_t wiced_receive_one_packet( void )
 
 /** Sends and Receives all waiting packets
  *
- * Repeatedly calls wiced_send_one_packet and wiced_receive_one_packet
+ * Repeatedly calls wiced_send_queued_packets and wiced_receive_one_packet
  * to send and receive packets, until there are no more packets waiting to
  * be transferred.
  *
@@ -200,10 +259,7 @@ void wiced_poll_all( void ) /*@modifies internalState@*/
     do
     {
         /* Send queued outgoing packets */
-        while ( wiced_send_one_packet( ) != 0 )
-        {
-            /* loop whist packets still queued */
-        }
+        (void) wiced_send_queued_packets( );
     } while ( wiced_receive_one_packet( ) != 0 );
 }
 
@@ -260,9 +316,10 @@ void wiced_thread_notify( void )
 /** The Wiced Thread function
  *
  *  This is the main loop of the Wiced Thread.
- *  It simply calls wiced_poll_all to send/receive all waiting packets, then goes
- *  to sleep.  The sleep has a 100ms timeout, causing the send/receive queues to be
- *  checked 10 times per second in case an interrupt is missed.
+ *  It receives all waiting packets, sends as many queued packets as the bus credits
+ *  allow, then goes to sleep until the next interrupt or queued packet.
+ *  While out of bus credits the sleep has a short timeout which backs off up to
+ *  WICED_THREAD_CREDIT_WAIT_MAX_MS, in case the interrupt carrying the credit update is missed.
  *  Once the quit flag has been set, flags/mutexes are cleaned up, and the function exits.
  *
  * @param thread_input  : unused parameter needed to match thread prototype.
@@ -272,7 +329,7 @@ static void wiced_thread_func( uint32_t /*@unused@*/thread_input )   /*@globals
 {
     uint32_t       int_status;
     int8_t         rx_status;
-    int8_t         tx_status;
+    uint32_t       credit_wait_ms = (uint32_t) WICED_THREAD_CREDIT_WAIT_MIN_MS;
 
     wiced_result_t result;
 
@@ -301,22 +358,32 @@ static void wiced_thread_func( uint32_t /*@unused@*/thread_input )   /*@globals
             }
         }
 
-        /* Send all queued packets */
-        do
+        /* Send all queued packets that the bus credits allow */
+        if ( wiced_send_queued_packets( ) != 0 )
         {
-            tx_status = wiced_send_one_packet( );
+            /* Credits arrived, so any missed interrupt has been recovered from */
+            credit_wait_ms = (uint32_t) WICED_THREAD_CREDIT_WAIT_MIN_MS;
         }
-        while (tx_status != 0);
 
         /* Check if we have run out of bus credits */
         if ( wiced_get_available_bus_credits( ) == 0 )
         {
             /* Keep poking the WLAN until it gives us more credits */
             wiced_bus_poke_wlan( );
-            result = host_rtos_get_semaphore( &wiced_transceive_semaphore, (uint32_t) 100, WICED_FALSE );
+            result = host_rtos_get_semaphore( &wiced_transceive_semaphore, credit_wait_ms, WICED_FALSE );
+            if ( result == WICED_TIMEOUT )
+            {
+                credit_wait_ms *= 2;
+                if ( credit_wait_ms > (uint32_t) WICED_THREAD_CREDIT_WAIT_MAX_MS )
+                {
+                    credit_wait_ms = (uint32_t) WICED_THREAD_CREDIT_WAIT_MAX_MS;
+                }
+            }
         }
         else
         {
+            credit_wait_ms = (uint32_t) WICED_THREAD_CREDIT_WAIT_MIN_MS;
+
             /* Put the bus to sleep and wait for something else to do */
             if ( wiced_wlan_status.keep_wlan_awake == 0 )
             {
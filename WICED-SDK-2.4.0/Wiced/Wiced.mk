@@ -88,6 +88,24 @@ $(NAME)_RESOURCES := images/favicon.ico \
 					 customWeb/ShinHeung/set_wifi_key_SH.html \
                      styles/border_radius.htc
 
+# Store the static s2web pages gzip compressed. Needs a perl with Compress::Raw::Zlib
+ifeq (1,$(COMPRESS_RESOURCES))
+$(NAME)_COMPRESSED_RESOURCES := s2web/index.html \
+                                s2web/s2w_main.html \
+                                s2web/wizfi_ota.html \
+                                s2web/wps_pbc.html \
+                                s2web/wps_pin.html \
+                                s2web/conn_setting.html \
+                                s2web/conn_setting_apmode.html \
+                                s2web/conn_setting_station.html \
+                                s2web/conn_setting_wps.html \
+                                s2web/gpio_control_main.html \
+                                s2web/serial_info_setting.html \
+                                s2web/change_user_info.html \
+                                s2web/set_wifi_key.html
+GLOBAL_DEFINES += WICED_COMPRESSED_RESOURCES
+endif
+
 $(NAME)_INCLUDES := Security/besl/tlv \
                     Security/besl/crypto \
                     Security/besl/include
@@ -172,6 +172,35 @@ wiced_result_t wiced_dct_write_app_section( const void* app_dct, uint32_t size )
 }
 
 
+wiced_result_t wiced_dct_write_wifi_config_and_app_section( const platform_dct_wifi_config_t* wifi_config_dct, const void* app_dct, uint32_t size )
+{
+    /* The app section follows the Wi-Fi config section, so a single write spanning both
+     * commits them together with one DCT copy instead of two */
+    const uint8_t* wifi_section = (const uint8_t*) wiced_dct_get_wifi_config_section( );
+    const uint8_t* app_section  = (const uint8_t*) wiced_dct_get_app_section( );
+    uint32_t       gap          = (uint32_t) ( app_section - wifi_section ) - sizeof( *wifi_config_dct );
+    uint32_t       length       = sizeof( *wifi_config_dct ) + gap + size;
+    uint8_t*       buffer;
+    int            result;
+
+    buffer = (uint8_t*) malloc_named( "dct", length );
+    if ( buffer == NULL )
+    {
+        return WICED_NOMEM;
+    }
+
+    memcpy( buffer, wifi_config_dct, sizeof( *wifi_config_dct ) );
+    memcpy( buffer + sizeof( *wifi_config_dct ), wifi_section + sizeof( *wifi_config_dct ), gap );
+    memcpy( buffer + sizeof( *wifi_config_dct ) + gap, app_dct, size );
+
+    result = bootloader_api->write_wifi_config_dct( 0, buffer, length );
+
+    free( buffer );
+
+    return ( result == 0 ) ? WICED_SUCCESS : WICED_ERROR;
+}
+
+
 #if 1	// kaizen 20130507 - for 2.3.0 Migration
 wiced_result_t wiced_configure_device_start(const configuration_entry_t* config, wiced_interface_t interface, wiced_network_config_t net_config, const wiced_ip_setting_t* ip_settings )
 {
@@ -167,13 +167,20 @@ static int process_get_custom_info    ( const char* params, wiced_tcp_stream_t*
 
 #define slash_redirect "HTTP/1.0 301\r\nLocation: /config/device_settings.html\r\n\r\n"
 
+// s2web pages are gzip compressed when built with COMPRESS_RESOURCES=1. Compressed resources have no terminating null
+#ifdef WICED_COMPRESSED_RESOURCES
+#define S2WEB_STATIC_PAGE(resource) WICED_STATIC_GZIP_URL_CONTENT, .url_content.static_data = {resource, sizeof(resource)}
+#else
+#define S2WEB_STATIC_PAGE(resource) WICED_STATIC_URL_CONTENT,      .url_content.static_data = {resource, sizeof(resource)-1}
+#endif
+
 // kaizen
 START_OF_HTTP_PAGE_DATABASE(config_sta_http_page_database)
 	//{ "/",                               "text/html", 						  WICED_STATIC_URL_CONTENT, 	.url_content.static_data  = {resource_config_DIR_main_html,    			  sizeof(resource_config_DIR_main_html)-1   			} },
 	//{ "/",                               "text/html", 						  WICED_STATIC_URL_CONTENT, 	.url_content.static_data  = {resource_s2web_DIR_wizfi250_main_html,		  sizeof(resource_s2web_DIR_wizfi250_main_html)-1   	} },
-	{ "/",                               "text/html", 						  WICED_STATIC_URL_CONTENT, 	.url_content.static_data  = {resource_s2web_DIR_index_html,		 		  sizeof(resource_s2web_DIR_index_html)-1   	} },
+	{ "/",                               "text/html", 						  S2WEB_STATIC_PAGE(resource_s2web_DIR_index_html) },
 
-	{ "/s2web/s2w_main.html",      		 "text/html", 						  WICED_STATIC_URL_CONTENT, 	.url_content.static_data  = {resource_s2web_DIR_s2w_main_html,			  sizeof(resource_s2web_DIR_s2w_main_html)-1   	} },
+	{ "/s2web/s2w_main.html",      		 "text/html", 						  S2WEB_STATIC_PAGE(resource_s2web_DIR_s2w_main_html) },
 
 	// sekim 20140716 ID1182 add s2web_main
 #if BUILD_WIZFI250
@@ -200,27 +207,27 @@ START_OF_HTTP_PAGE_DATABASE(config_sta_http_page_database)
 	{ "/images/gpio_icon.png",		     "image/png",						  WICED_STATIC_URL_CONTENT,		.url_content.static_data  = {resource_images_DIR_gpio_icon_png,		 	 sizeof(resource_images_DIR_gpio_icon_png)			} },
 	{ "/images/serial_setting_icon.png",	"image/png",					  WICED_STATIC_URL_CONTENT,		.url_content.static_data  = {resource_images_DIR_serial_setting_icon_png,   sizeof(resource_images_DIR_serial_setting_icon_png)		} },
 	{ "/images/user_information_icon.png",	"image/png",					  WICED_STATIC_URL_CONTENT,		.url_content.static_data  = {resource_images_DIR_user_information_icon_png, sizeof(resource_images_DIR_user_information_icon_png)	} },
-	{ "/s2web/wizfi_ota.html",           "text/html",                         WICED_STATIC_URL_CONTENT,     .url_content.static_data  = {resource_s2web_DIR_wizfi_ota_html,          sizeof(resource_s2web_DIR_wizfi_ota_html)-1          } },
+	{ "/s2web/wizfi_ota.html",           "text/html",                         S2WEB_STATIC_PAGE(resource_s2web_DIR_wizfi_ota_html) },
 	{ "/ota_go",                         "text/html",                         WICED_DYNAMIC_URL_CONTENT,    .url_content.dynamic_data = {process_ota_go,                 0 } },
 	// kaizen 20131210 ID1147 Added function about getting mac address
 	{ "/get_info_ota",                   "text/html",                         WICED_DYNAMIC_URL_CONTENT,    .url_content.dynamic_data = {get_info_ota,                   0 } },
 
-    { "/s2web/wps_pbc.html",            "text/html",                          WICED_STATIC_URL_CONTENT,     .url_content.static_data  = {resource_s2web_DIR_wps_pbc_html,            sizeof(resource_s2web_DIR_wps_pbc_html)-1            } },
-    { "/s2web/wps_pin.html",            "text/html",                          WICED_STATIC_URL_CONTENT,     .url_content.static_data  = {resource_s2web_DIR_wps_pin_html,            sizeof(resource_s2web_DIR_wps_pin_html)-1            } },
+    { "/s2web/wps_pbc.html",            "text/html",                          S2WEB_STATIC_PAGE(resource_s2web_DIR_wps_pbc_html) },
+    { "/s2web/wps_pin.html",            "text/html",                          S2WEB_STATIC_PAGE(resource_s2web_DIR_wps_pin_html) },
 	{ "/wps_go",                         "text/html",                         WICED_DYNAMIC_URL_CONTENT,    .url_content.dynamic_data = {process_wps_go,                0 } },
 	// sekim 20130423 serial-to-web demo
 	{ "/s2web/demo.html",                "text/html",                         WICED_STATIC_URL_CONTENT,     .url_content.static_data  = {resource_s2web_DIR_demo_html,                sizeof(resource_s2web_DIR_demo_html)-1                } },
     { "/content.html",                   "text/html",                         WICED_DYNAMIC_URL_CONTENT,    .url_content.dynamic_data = {process_s2web, 0 }, },
     // kaizen 20130712 ID1099 For Setting TCP/UDP Connection using web server
     { "/s2wconfig",   					 "text/html",                         WICED_DYNAMIC_URL_CONTENT,    .url_content.dynamic_data  = {process_config_s2w_value, 0 }, },
-    { "/s2web/conn_setting.html",        "text/html",                         WICED_STATIC_URL_CONTENT,     .url_content.static_data   = {resource_s2web_DIR_conn_setting_html,       sizeof(resource_s2web_DIR_conn_setting_html)-1   		} },
+    { "/s2web/conn_setting.html",        "text/html",                         S2WEB_STATIC_PAGE(resource_s2web_DIR_conn_setting_html) },
     // kaizen 20131113 ID1135 Added AP Mode Setting Using Web Server
     { "/s2wconfig_ap", 					 "text/html",                         WICED_DYNAMIC_URL_CONTENT,    .url_content.dynamic_data  = {process_config_s2w_ap_value, 0 }, },
-    { "/s2web/conn_setting_apmode.html", "text/html",                         WICED_STATIC_URL_CONTENT,     .url_content.static_data   = {resource_s2web_DIR_conn_setting_apmode_html,sizeof(resource_s2web_DIR_conn_setting_apmode_html)-1	} },
+    { "/s2web/conn_setting_apmode.html", "text/html",                         S2WEB_STATIC_PAGE(resource_s2web_DIR_conn_setting_apmode_html) },
     { "/s2w_reset", 					 "text/html",                         WICED_DYNAMIC_URL_CONTENT,    .url_content.dynamic_data  = {process_config_s2w_reset, 0 }, },
 
     // kaizen 20131030 ID1134 Added GPIO Control Page Using Web Server
-    { "/s2web/gpio_control_main.html",   "text/html",                         WICED_STATIC_URL_CONTENT,     .url_content.static_data  = {resource_s2web_DIR_gpio_control_main_html,sizeof(resource_s2web_DIR_gpio_control_main_html)-1	} },
+    { "/s2web/gpio_control_main.html",   "text/html",                         S2WEB_STATIC_PAGE(resource_s2web_DIR_gpio_control_main_html) },
     { "/s2web/gpio_control_set.html",    "text/html",                         WICED_DYNAMIC_URL_CONTENT,    .url_content.dynamic_data = {set_gpio_setting,     0 } },
     { "/s2web/gpio_control_get.html",    "text/html",                         WICED_DYNAMIC_URL_CONTENT,    .url_content.dynamic_data = {get_gpio_setting,     0 } },
     { "/gpio_config_save",               "text/html",                         WICED_DYNAMIC_URL_CONTENT,    .url_content.dynamic_data = {gpio_config_save,     0 } },
@@ -229,20 +236,20 @@ START_OF_HTTP_PAGE_DATABASE(config_sta_http_page_database)
     { "/s2wlogin",              		 "text/html",                         WICED_DYNAMIC_URL_CONTENT,    .url_content.dynamic_data  = {s2wlogin,     0 } },
 
     // kaizen 20131118 ID1139 Added Static IP Setting Page in Station Mode
-    { "/s2web/conn_setting_station.html", "text/html",                        WICED_STATIC_URL_CONTENT,     .url_content.static_data   = {resource_s2web_DIR_conn_setting_station_html,sizeof(resource_s2web_DIR_conn_setting_station_html)-1	} },
+    { "/s2web/conn_setting_station.html", "text/html",                        S2WEB_STATIC_PAGE(resource_s2web_DIR_conn_setting_station_html) },
     { "/s2wconfig_station",               "text/html",                        WICED_DYNAMIC_URL_CONTENT,    .url_content.dynamic_data  = {process_s2wconfig_station,     0 } },
-    { "/s2web/conn_setting_wps.html", 	  "text/html",                        WICED_STATIC_URL_CONTENT,     .url_content.static_data   = {resource_s2web_DIR_conn_setting_wps_html,sizeof(resource_s2web_DIR_conn_setting_wps_html)-1	} },
+    { "/s2web/conn_setting_wps.html", 	  "text/html",                        S2WEB_STATIC_PAGE(resource_s2web_DIR_conn_setting_wps_html) },
 
     // kaizen 20131210 ID1149 Added function in order to change serial configuration
-    { "/s2web/serial_info_setting.html", "text/html",                         WICED_STATIC_URL_CONTENT,     .url_content.static_data  = {resource_s2web_DIR_serial_info_setting_html,	 sizeof(resource_s2web_DIR_serial_info_setting_html)-1	} },
+    { "/s2web/serial_info_setting.html", "text/html",                         S2WEB_STATIC_PAGE(resource_s2web_DIR_serial_info_setting_html) },
     { "/s2w_serial_setting",             "text/html",                         WICED_DYNAMIC_URL_CONTENT,    .url_content.dynamic_data = {process_serial_setting,     0 } },
 
     // kaizen 20131210 ID1150 Added function in order to change user information as userID and userPW.
-    { "/s2web/change_user_info.html", 	 "text/html",                         WICED_STATIC_URL_CONTENT,     .url_content.static_data  = {resource_s2web_DIR_change_user_info_html,	 sizeof(resource_s2web_DIR_change_user_info_html)-1			 } },
+    { "/s2web/change_user_info.html", 	 "text/html",                         S2WEB_STATIC_PAGE(resource_s2web_DIR_change_user_info_html) },
     { "/s2w_user_info_setting",          "text/html",                         WICED_DYNAMIC_URL_CONTENT,    .url_content.dynamic_data = {process_user_info_setting,     0 } },
 
     // kaizen 20140411 ID1169 Modified procedure for joining AP ( For Original )
-    { "/s2web/set_wifi_key.html",	 	 "text/html",                         WICED_STATIC_URL_CONTENT,     .url_content.static_data  = {resource_s2web_DIR_set_wifi_key_html,	 sizeof(resource_s2web_DIR_set_wifi_key_html)-1				 } },
+    { "/s2web/set_wifi_key.html",	 	 "text/html",                         S2WEB_STATIC_PAGE(resource_s2web_DIR_set_wifi_key_html) },
 
 #if 1	// kaizen 20140410 ID1168 Customize for ShinHeung
     { "/customWeb/ShinHeung/image/ShinHeungLogo.jpg",		"image/jpg",	WICED_STATIC_URL_CONTENT,		.url_content.static_data  = {resource_customWeb_DIR_ShinHeung_DIR_image_DIR_ShinHeungLogo_jpg,	sizeof(resource_customWeb_DIR_ShinHeung_DIR_image_DIR_ShinHeungLogo_jpg) 	} },
@@ -161,6 +161,21 @@ extern wiced_result_t wiced_dct_read_app_section( void* app_dct, uint32_t size )
  * @return @ref wiced_result_t
  */
 extern wiced_result_t wiced_dct_write_app_section( const void* app_dct, uint32_t size );
+
+
+/** Writes volatile copies of the DCT Wi-Fi config and app sections in RAM to the flash together
+ *
+ * Both sections are committed by a single DCT update, so this erases the flash once where
+ * separate wiced_dct_write_wifi_config_section() and wiced_dct_write_app_section() calls
+ * erase it twice, and a power failure leaves either both old sections or both new ones.
+ *
+ * @param[in] wifi_config_dct : A pointer to the volatile copy of DCT Wi-Fi config section in RAM
+ * @param[in] app_dct         : A pointer to the volatile copy of DCT app section in RAM
+ * @param[in] size            : The size of the DCT app section
+ *
+ * @return @ref wiced_result_t
+ */
+extern wiced_result_t wiced_dct_write_wifi_config_and_app_section( const platform_dct_wifi_config_t* wifi_config_dct, const void* app_dct, uint32_t size );
 //-------------------------------------
 
 /** @} */
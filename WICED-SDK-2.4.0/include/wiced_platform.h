@@ -255,6 +255,22 @@ wiced_result_t wiced_uart_transmit_bytes( wiced_uart_t uart, const void* data, u
 wiced_result_t wiced_uart_receive_bytes( wiced_uart_t uart, void* data, uint32_t size, uint32_t timeout );
 
 
+/** Receive whatever data is pending on a UART interface
+ *
+ * Waits until at least one byte has been received, then returns every
+ * byte already buffered, up to the size of the caller's buffer.
+ *
+ * @param  uart     : the UART interface
+ * @param  data     : pointer to the buffer which will store incoming data
+ * @param  size     : in: size of the buffer, out: number of bytes received
+ * @param  timeout  : timeout in milisecond for the first byte
+ *
+ * @return    WICED_SUCCESS : on success.
+ * @return    WICED_TIMEOUT : if no data arrived before the timeout
+ */
+wiced_result_t wiced_uart_receive_available_bytes( wiced_uart_t uart, void* data, uint32_t* size, uint32_t timeout );
+
+
 /** @} */
 /*****************************************************************************/
 /** @addtogroup spi       SPI
@@ -348,6 +348,38 @@ wiced_result_t wiced_tcp_enable_tls( wiced_tcp_socket_t* socket, void* context )
 wiced_result_t wiced_tcp_start_tls(wiced_tcp_socket_t* socket, wiced_tls_endpoint_type_t type, wiced_tls_certificate_verification_t verification );
 
 
+/** Start TLS on a TCP Connection without waiting for the handshake
+ *
+ * Sets up the TLS context like @ref wiced_tcp_start_tls but runs none of the
+ * handshake. Call @ref wiced_tcp_tls_handshake_step until it stops returning
+ * WICED_PENDING, e.g. each time data arrives on the socket.
+ *
+ * @param[in,out] socket       : The TCP socket to use for TLS
+ * @param[in]     type         : Identifies whether the device will be TLS client or server
+ * @param[in]     verification : Indicates whether to verify the certificate chain against a root server.
+ *
+ * @return @ref wiced_result_t
+ */
+wiced_result_t wiced_tcp_start_tls_async( wiced_tcp_socket_t* socket, wiced_tls_endpoint_type_t type, wiced_tls_certificate_verification_t verification );
+
+
+/** Run the TLS handshake as far as the data received so far allows
+ *
+ * @param[in,out] socket : The TCP socket passed to @ref wiced_tcp_start_tls_async
+ *
+ * @return WICED_SUCCESS once the handshake is over, WICED_PENDING while it is not,
+ *         any other value if it failed (the TLS context is then already released)
+ */
+wiced_result_t wiced_tcp_tls_handshake_step( wiced_tcp_socket_t* socket );
+
+
+/** Give up on a handshake that is still pending
+ *
+ * @param[in,out] socket : The TCP socket passed to @ref wiced_tcp_start_tls_async
+ */
+void wiced_tcp_tls_handshake_abort( wiced_tcp_socket_t* socket );
+
+
 /*****************************************************************************/
 /** @addtogroup tcppkt       TCP packet comms
  *  @ingroup tcp
@@ -66,6 +66,7 @@ $(eval $(NAME)_MAKEFILE :=$(TEMP_MAKEFILE))
 
 # Expand the list of resources to point to the full location (either component local or the common Resources directory)
 $(eval $(NAME)_RESOURCES_EXPANDED := $(foreach res,$($(NAME)_RESOURCES),$(word 1,$(wildcard $(addsuffix $(res),$(CURDIR) $(SOURCE_ROOT)Resources/)))))
+$(eval $(NAME)_COMPRESSED_RESOURCES_EXPANDED := $(foreach res,$($(NAME)_COMPRESSED_RESOURCES),$(word 1,$(wildcard $(addsuffix $(res),$(CURDIR) $(SOURCE_ROOT)Resources/)))))
 
 $(eval CURDIR := $(OLD_CURDIR))
 
@@ -253,6 +254,7 @@ $(MAKECMDGOALS): | $(CONFIG_FILE_DIR)
 	$(QUIET)$(foreach comp,$(PROCESSED_COMPONENTS), $(call WRITE_FILE_APPEND, $(CONFIG_FILE) ,$(call CONV_COMP,$(comp))_CXXFLAGS         := $(WICED_CXXFLAGS) $($(comp)_CXXFLAGS)))
 	$(QUIET)$(foreach comp,$(PROCESSED_COMPONENTS), $(call WRITE_FILE_APPEND, $(CONFIG_FILE) ,$(call CONV_COMP,$(comp))_ASMFLAGS         := $(WICED_ASMFLAGS) $($(comp)_ASMFLAGS)))
 	$(QUIET)$(foreach comp,$(PROCESSED_COMPONENTS), $(call WRITE_FILE_APPEND, $(CONFIG_FILE) ,$(call CONV_COMP,$(comp))_RESOURCES        := $($(comp)_RESOURCES_EXPANDED)))
+	$(QUIET)$(foreach comp,$(PROCESSED_COMPONENTS), $(call WRITE_FILE_APPEND, $(CONFIG_FILE) ,$(call CONV_COMP,$(comp))_COMPRESSED_RESOURCES := $($(comp)_COMPRESSED_RESOURCES_EXPANDED)))
 	$(QUIET)$(foreach comp,$(PROCESSED_COMPONENTS), $(call WRITE_FILE_APPEND, $(CONFIG_FILE) ,$(call CONV_COMP,$(comp))_MAKEFILE         := $($(comp)_MAKEFILE)))
 	$(QUIET)$(foreach comp,$(PROCESSED_COMPONENTS), $(call WRITE_FILE_APPEND, $(CONFIG_FILE) ,$(call CONV_COMP,$(comp))_PREBUILT_LIBRARY := $(addprefix $($(comp)_LOCATION),$($(comp)_PREBUILT_LIBRARY))))
 	$(QUIET)$(call WRITE_FILE_APPEND, $(CONFIG_FILE) ,APP_WWD_ONLY              := $(APP_WWD_ONLY))
@@ -14,6 +14,8 @@ TEXT_FILTERS   := %.html %.htm %.txt %.eml %.js %.css %.dat %.cer %.pem %.json %
 #BINARY_FILTERS := %.jpg %.jpeg %.png %.ico %.gif
 BINARY_FILTERS := %.jpg %.jpeg %.png %.ico %.gif %.gz
 ALL_RESOURCES := $(sort $(foreach comp,$(COMPONENTS),$($(comp)_RESOURCES)))
+# Text resources listed in a component's <name>_COMPRESSED_RESOURCES are stored gzip compressed
+ALL_COMPRESSED_RESOURCES := $(sort $(foreach comp,$(COMPONENTS),$($(comp)_COMPRESSED_RESOURCES)))
 
 ###############################################################################
 # MACRO: RESOURCE_FILENAME
@@ -31,14 +33,15 @@ RESOURCE_VARIABLE_NAME =$(addprefix resource_,$(subst /,_DIR_,$(subst .,_,$(subs
 ###############################################################################
 # MACRO: BUILD_RESOURCE_RULES
 # Creates targets to build a resource file
-# the first target converts the text resource file to a C file
+# the first target converts the text resource file to a C file, compressing it if
+# it is listed in ALL_COMPRESSED_RESOURCES
 # the second target compiles the C resource file into an object file
 # $(1) is the name of a resource
 define BUILD_RESOURCE_RULES
 $(call RESOURCE_FILENAME, $(1)): $(1) $(STAGING_DIR).d
 $(call RESOURCE_FILENAME, $(1)): $(1)
 	$$(if $(RESOURCES_START_PRINT),,$(eval RESOURCES_START_PRINT:=1) $(QUIET)$(ECHO) Converting resources)
-	$$(if $(filter $(TEXT_FILTERS),$(1)),$(QUIET)$(PERL) $(TOOLS_ROOT)/text_to_c/text_to_c.pl $(call RESOURCE_VARIABLE_NAME, $(1)) $(1) > $$@)
+	$$(if $(filter $(TEXT_FILTERS),$(1)),$(QUIET)$(PERL) $(TOOLS_ROOT)/text_to_c/text_to_c.pl $(if $(filter $(1),$(ALL_COMPRESSED_RESOURCES)),--gzip) $(call RESOURCE_VARIABLE_NAME, $(1)) $(1) > $$@)
 	$$(if $(filter $(BINARY_FILTERS),$(1)),$(QUIET)$(BIN2C) $(1) $$@ $(call RESOURCE_VARIABLE_NAME,$(1)))
 
 $(patsubst %.c,%.o,$(call RESOURCE_FILENAME, $(1))): $(call RESOURCE_FILENAME, $(1))